@@ -0,0 +1,402 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Core
+ * Purpose:  Test concurrent access to the raster block cache.
+ ******************************************************************************
+ * Copyright (c) 2011, The GDAL project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include <iostream>
+#include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <cpl_multiproc.h>
+#include <cpl_atomic_ops.h>
+
+#define NUM_THREADS     4
+#define NUM_LOOPS       20
+#define RASTER_SIZE     256
+#define BLOCK_SIZE      16
+
+static volatile int nThreadsDone = 0;
+static volatile int bErr = FALSE;
+
+/************************************************************************/
+/*                            PixelValue()                              */
+/************************************************************************/
+
+static GByte PixelValue( int iThread, int iX, int iY )
+{
+    return (GByte) ((iThread * 17 + iX * 3 + iY * 7) % 251);
+}
+
+/************************************************************************/
+/*                          CreateDataset()                             */
+/************************************************************************/
+
+static void CreateDataset( int iThread )
+{
+    char** papszOptions = NULL;
+    papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+    papszOptions = CSLSetNameValue(papszOptions, "BLOCKXSIZE", CPLSPrintf("%d", BLOCK_SIZE));
+    papszOptions = CSLSetNameValue(papszOptions, "BLOCKYSIZE", CPLSPrintf("%d", BLOCK_SIZE));
+
+    GDALDatasetH hDS = GDALCreate(GDALGetDriverByName("GTiff"),
+                                  CPLSPrintf("/vsimem/testblockcache_%d.tif", iThread),
+                                  RASTER_SIZE, RASTER_SIZE, 1, GDT_Byte, papszOptions);
+    CSLDestroy(papszOptions);
+
+    GByte* pabyLine = (GByte*) CPLMalloc(RASTER_SIZE);
+    for(int iY = 0; iY < RASTER_SIZE; iY++)
+    {
+        for(int iX = 0; iX < RASTER_SIZE; iX++)
+            pabyLine[iX] = PixelValue(iThread, iX, iY);
+        GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Write, 0, iY, RASTER_SIZE, 1,
+                     pabyLine, RASTER_SIZE, 1, GDT_Byte, 0, 0);
+    }
+    CPLFree(pabyLine);
+    GDALClose(hDS);
+}
+
+/************************************************************************/
+/*                             ReadThread()                             */
+/*                                                                      */
+/*      Each thread reads windows of its own dataset, while the cache   */
+/*      is too small to hold all the blocks, so blocks of the other     */
+/*      threads get evicted all the time.                               */
+/************************************************************************/
+
+static void ReadThread( void* pData )
+{
+    int iThread = *(int*)pData;
+    GDALDatasetH hDS = GDALOpen(CPLSPrintf("/vsimem/testblockcache_%d.tif", iThread),
+                                GA_ReadOnly);
+    GByte* pabyBuffer = (GByte*) CPLMalloc(RASTER_SIZE * RASTER_SIZE);
+
+    for(int iLoop = 0; iLoop < NUM_LOOPS && !bErr; iLoop++)
+    {
+        int nOff = (iLoop * 37) % (RASTER_SIZE / 2);
+        int nSize = RASTER_SIZE - nOff;
+        GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Read, nOff, nOff, nSize, nSize,
+                     pabyBuffer, nSize, nSize, GDT_Byte, 0, 0);
+        for(int iY = 0; iY < nSize && !bErr; iY++)
+        {
+            for(int iX = 0; iX < nSize; iX++)
+            {
+                if( pabyBuffer[iY * nSize + iX] != PixelValue(iThread, nOff + iX, nOff + iY) )
+                {
+                    std::cout << "Thread " << iThread << ": wrong value at (" <<
+                                 nOff + iX << "," << nOff + iY << ")" << std::endl;
+                    bErr = TRUE;
+                    break;
+                }
+            }
+        }
+    }
+
+    CPLFree(pabyBuffer);
+    GDALClose(hDS);
+    CPLAtomicInc(&nThreadsDone);
+}
+
+/************************************************************************/
+/*                          BlockReadThread()                           */
+/*                                                                      */
+/*      Each thread reads random blocks of its own dataset, while the   */
+/*      cache only has room for a few blocks, so that the blocks a      */
+/*      thread is looking up are constantly being evicted by the        */
+/*      other threads.                                                  */
+/************************************************************************/
+
+static void BlockReadThread( void* pData )
+{
+    int iThread = *(int*)pData;
+    GDALDatasetH hDS = GDALOpen(CPLSPrintf("/vsimem/testblockcache_%d.tif", iThread),
+                                GA_ReadOnly);
+    GByte abyBuffer[BLOCK_SIZE * BLOCK_SIZE];
+    int nBlocksPerRow = RASTER_SIZE / BLOCK_SIZE;
+    int nSeed = iThread * 7919 + 1;
+
+    for(int iLoop = 0; iLoop < NUM_LOOPS * 500 && !bErr; iLoop++)
+    {
+        nSeed = (nSeed * 1103515245 + 12345) & 0x7fffffff;
+        /* Favour a few blocks so that they are often found in the cache */
+        int iBlock = (nSeed >> 4) % ((nSeed & 1) ? 4 : nBlocksPerRow * nBlocksPerRow);
+        int nXOff = (iBlock % nBlocksPerRow) * BLOCK_SIZE;
+        int nYOff = (iBlock / nBlocksPerRow) * BLOCK_SIZE;
+
+        GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Read, nXOff, nYOff,
+                     BLOCK_SIZE, BLOCK_SIZE, abyBuffer, BLOCK_SIZE, BLOCK_SIZE,
+                     GDT_Byte, 0, 0);
+        for(int i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++)
+        {
+            if( abyBuffer[i] != PixelValue(iThread, nXOff + i % BLOCK_SIZE,
+                                           nYOff + i / BLOCK_SIZE) )
+            {
+                std::cout << "Thread " << iThread << ": wrong value in block at (" <<
+                             nXOff << "," << nYOff << ")" << std::endl;
+                bErr = TRUE;
+                break;
+            }
+        }
+    }
+
+    GDALClose(hDS);
+    CPLAtomicInc(&nThreadsDone);
+}
+
+/************************************************************************/
+/*                          TestSmallCache()                            */
+/************************************************************************/
+
+static void TestSmallCache()
+{
+    int anThreadIds[NUM_THREADS];
+    int i;
+
+    GDALSetCacheMax(BLOCK_SIZE * BLOCK_SIZE * 4);
+
+    nThreadsDone = 0;
+    for(i = 0; i < NUM_THREADS; i++)
+    {
+        anThreadIds[i] = i;
+        CPLCreateThread(BlockReadThread, &anThreadIds[i]);
+    }
+
+    while( nThreadsDone < NUM_THREADS )
+        CPLSleep(0.01);
+}
+
+/************************************************************************/
+/*                             TestQuota()                              */
+/*                                                                      */
+/*      A full read of a dataset must not use more cache than the       */
+/*      quota set with GDAL_CACHE_DATASET_MAX.                          */
+/************************************************************************/
+
+static void TestQuota()
+{
+    GByte* pabyBuffer = (GByte*) CPLMalloc(RASTER_SIZE * RASTER_SIZE);
+
+    GDALSetCacheMax(RASTER_SIZE * RASTER_SIZE * 4);
+    CPLSetConfigOption("GDAL_CACHE_DATASET_MAX", "10%");
+
+    GDALDatasetH hDS = GDALOpen("/vsimem/testblockcache_0.tif", GA_ReadOnly);
+    GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Read, 0, 0, RASTER_SIZE, RASTER_SIZE,
+                 pabyBuffer, RASTER_SIZE, RASTER_SIZE, GDT_Byte, 0, 0);
+    if( GDALGetCacheUsed64() > RASTER_SIZE * RASTER_SIZE * 4 / 10 )
+    {
+        std::cout << "Cache usage of the dataset above its quota : " <<
+                     (int) GDALGetCacheUsed64() << std::endl;
+        bErr = TRUE;
+    }
+    GDALClose(hDS);
+
+    CPLSetConfigOption("GDAL_CACHE_DATASET_MAX", NULL);
+    CPLFree(pabyBuffer);
+}
+
+/************************************************************************/
+/*                           TestStatistics()                           */
+/*                                                                      */
+/*      Reading a dataset twice with a large enough cache must give     */
+/*      one miss per block on the first pass and one hit per block on   */
+/*      the second one.                                                 */
+/************************************************************************/
+
+static void TestStatistics()
+{
+    GByte* pabyBuffer = (GByte*) CPLMalloc(RASTER_SIZE * RASTER_SIZE);
+    GDALCacheStatistics sStats, sBandStats;
+    const int nBlocks = (RASTER_SIZE / BLOCK_SIZE) * (RASTER_SIZE / BLOCK_SIZE);
+
+    GDALGetCacheStatistics(&sStats);
+    if( sStats.nHits == 0 || sStats.nMisses == 0 || sStats.nEvictions == 0 )
+    {
+        std::cout << "Unexpected global statistics after concurrent reads" << std::endl;
+        bErr = TRUE;
+    }
+
+    GDALSetCacheMax(RASTER_SIZE * RASTER_SIZE * 4);
+    GDALResetCacheStatistics();
+
+    GDALDatasetH hDS = GDALOpen("/vsimem/testblockcache_1.tif", GA_ReadOnly);
+    for(int iPass = 0; iPass < 2; iPass++)
+        GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Read, 0, 0, RASTER_SIZE, RASTER_SIZE,
+                     pabyBuffer, RASTER_SIZE, RASTER_SIZE, GDT_Byte, 0, 0);
+
+    GDALGetDatasetCacheStatistics(hDS, &sStats);
+    GDALGetRasterBandCacheStatistics(GDALGetRasterBand(hDS, 1), &sBandStats);
+    if( sStats.nMisses != nBlocks || sStats.nHits < nBlocks ||
+        sStats.nEvictions != 0 || sStats.nBytesUsed != RASTER_SIZE * RASTER_SIZE ||
+        sBandStats.nHits != sStats.nHits )
+    {
+        std::cout << "Unexpected dataset statistics : " <<
+                     (int) sStats.nHits << " hits, " <<
+                     (int) sStats.nMisses << " misses, " <<
+                     (int) sStats.nEvictions << " evictions" << std::endl;
+        bErr = TRUE;
+    }
+
+    GDALGetCacheStatistics(&sBandStats);
+    if( sBandStats.nMisses != sStats.nMisses || sBandStats.nHits != sStats.nHits )
+    {
+        std::cout << "Global and dataset statistics differ" << std::endl;
+        bErr = TRUE;
+    }
+    GDALClose(hDS);
+
+    CPLFree(pabyBuffer);
+}
+
+/************************************************************************/
+/*                           TestWriteBack()                            */
+/*                                                                      */
+/*      With GDAL_CACHE_WRITEBACK enabled, the blocks written in a      */
+/*      dataset must be written back by the background thread without   */
+/*      any eviction or flush from the writing thread.                  */
+/************************************************************************/
+
+static void TestWriteBack()
+{
+    if( !CSLTestBoolean(CPLGetConfigOption("GDAL_CACHE_WRITEBACK", "NO")) )
+        return;
+
+    const int nBlocks = (RASTER_SIZE / BLOCK_SIZE) * (RASTER_SIZE / BLOCK_SIZE);
+    GDALCacheStatistics sStats;
+    int i;
+
+    GDALSetCacheMax(RASTER_SIZE * RASTER_SIZE * 4);
+    CPLSetConfigOption("GDAL_CACHE_WRITEBACK_HIGH", "10%");
+    CPLSetConfigOption("GDAL_CACHE_WRITEBACK_LOW", "0");
+
+    char** papszOptions = NULL;
+    papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+    papszOptions = CSLSetNameValue(papszOptions, "BLOCKXSIZE", CPLSPrintf("%d", BLOCK_SIZE));
+    papszOptions = CSLSetNameValue(papszOptions, "BLOCKYSIZE", CPLSPrintf("%d", BLOCK_SIZE));
+    GDALDatasetH hDS = GDALCreate(GDALGetDriverByName("GTiff"),
+                                  "/vsimem/testblockcache_wb.tif",
+                                  RASTER_SIZE, RASTER_SIZE, 1, GDT_Byte, papszOptions);
+    CSLDestroy(papszOptions);
+
+    GByte* pabyBuffer = (GByte*) CPLMalloc(RASTER_SIZE * RASTER_SIZE);
+    for(int iY = 0; iY < RASTER_SIZE; iY++)
+        for(int iX = 0; iX < RASTER_SIZE; iX++)
+            pabyBuffer[iY * RASTER_SIZE + iX] = PixelValue(NUM_THREADS, iX, iY);
+    GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Write, 0, 0, RASTER_SIZE, RASTER_SIZE,
+                 pabyBuffer, RASTER_SIZE, RASTER_SIZE, GDT_Byte, 0, 0);
+
+    for(i = 0; i < 500; i++)
+    {
+        GDALGetDatasetCacheStatistics(hDS, &sStats);
+        if( sStats.nDirtyFlushes == nBlocks )
+            break;
+        CPLSleep(0.01);
+    }
+    if( sStats.nDirtyFlushes != nBlocks || sStats.nEvictions != 0 )
+    {
+        std::cout << "Dirty blocks not written back : " <<
+                     (int) sStats.nDirtyFlushes << " written, " <<
+                     (int) sStats.nEvictions << " evictions" << std::endl;
+        bErr = TRUE;
+    }
+    GDALClose(hDS);
+
+    hDS = GDALOpen("/vsimem/testblockcache_wb.tif", GA_ReadOnly);
+    memset(pabyBuffer, 0, RASTER_SIZE * RASTER_SIZE);
+    GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Read, 0, 0, RASTER_SIZE, RASTER_SIZE,
+                 pabyBuffer, RASTER_SIZE, RASTER_SIZE, GDT_Byte, 0, 0);
+    for(i = 0; i < RASTER_SIZE * RASTER_SIZE; i++)
+    {
+        if( pabyBuffer[i] != PixelValue(NUM_THREADS, i % RASTER_SIZE, i / RASTER_SIZE) )
+        {
+            std::cout << "Wrong value written back at offset " << i << std::endl;
+            bErr = TRUE;
+            break;
+        }
+    }
+    GDALClose(hDS);
+
+    CPLSetConfigOption("GDAL_CACHE_WRITEBACK_HIGH", NULL);
+    CPLSetConfigOption("GDAL_CACHE_WRITEBACK_LOW", NULL);
+    VSIUnlink("/vsimem/testblockcache_wb.tif");
+    CPLFree(pabyBuffer);
+}
+
+/************************************************************************/
+/*                                main()                                */
+/*                                                                      */
+/*      The eviction policy (LRU, CLOCK or 2Q) can be passed as         */
+/*      argument, optionally followed by WRITEBACK to enable the        */
+/*      background write-back of dirty blocks.                          */
+/************************************************************************/
+
+int main(int argc, char* argv[])
+{
+    int anThreadIds[NUM_THREADS];
+    int i;
+
+    if( argc >= 2 )
+        CPLSetConfigOption("GDAL_CACHE_POLICY", argv[1]);
+    if( argc >= 3 && EQUAL(argv[2], "WRITEBACK") )
+        CPLSetConfigOption("GDAL_CACHE_WRITEBACK", "YES");
+
+    GDALAllRegister();
+
+    for(i = 0; i < NUM_THREADS; i++)
+        CreateDataset(i);
+
+    /* Room for only a fraction of the blocks of a single dataset */
+    GDALSetCacheMax(RASTER_SIZE * RASTER_SIZE / 4);
+
+    for(i = 0; i < NUM_THREADS; i++)
+    {
+        anThreadIds[i] = i;
+        CPLCreateThread(ReadThread, &anThreadIds[i]);
+    }
+
+    while( nThreadsDone < NUM_THREADS )
+        CPLSleep(0.01);
+
+    if( GDALGetCacheUsed64() > GDALGetCacheMax64() )
+    {
+        std::cout << "Cache usage above the cache limit" << std::endl;
+        bErr = TRUE;
+    }
+
+    TestStatistics();
+    TestSmallCache();
+    TestQuota();
+    TestWriteBack();
+
+    for(i = 0; i < NUM_THREADS; i++)
+        VSIUnlink(CPLSPrintf("/vsimem/testblockcache_%d.tif", i));
+
+    GDALDestroyDriverManager();
+
+    if (bErr == FALSE)
+        printf("success !\n");
+    else
+        printf("fail !\n");
+
+    return (bErr == FALSE) ? 0 : -1;
+}
@@ -437,6 +437,94 @@ void check_GDT_CFloat32and64()
     }
 }
 
+/* Check that converting a packed array, which uses the vectorized code */
+/* paths when they are available, gives the same words as converting */
+/* the values one at a time. The word count is not a multiple of 8 so */
+/* that the tail of the array goes through the generic code. */
+
+template <class InType>
+void CheckPacked(GDALDataType intype, const double* padfValues, int nValues,
+                 GDALDataType outtype, int numLine)
+{
+    const int nInSize = GDALGetDataTypeSize(intype) / 8;
+    const int nOutSize = GDALGetDataTypeSize(outtype) / 8;
+    const int nCount = 8 * 5 + 3;
+    InType* pafIn = (InType*)malloc(nCount * sizeof(InType));
+    char* pPacked = (char*)malloc(nCount * nOutSize);
+    char* pOne = (char*)malloc(nCount * nOutSize);
+    int j;
+
+    for (j = 0; j < nCount; j++)
+        pafIn[j] = (InType)padfValues[j % nValues];
+
+    memset(pPacked, 0xff, nCount * nOutSize);
+    memset(pOne, 0, nCount * nOutSize);
+
+    GDALCopyWords(pafIn, intype, nInSize, pPacked, outtype, nOutSize, nCount);
+    for (j = 0; j < nCount; j++)
+        GDALCopyWords(pafIn + j, intype, nInSize, pOne + j * nOutSize,
+                      outtype, nOutSize, 1);
+
+    for (j = 0; j < nCount; j++)
+    {
+        if (memcmp(pPacked + j * nOutSize, pOne + j * nOutSize, nOutSize) != 0)
+        {
+            std::cout << "Test failed at line " << numLine <<
+                         " (intype=" << GDALGetDataTypeName(intype) <<
+                         ",inval=" << (double)pafIn[j] <<
+                         ",outtype=" << GDALGetDataTypeName(outtype) <<
+                         ",index=" << j <<
+                         "): packed and single word conversions differ" << std::endl;
+            bErr = TRUE;
+            break;
+        }
+    }
+
+    free(pafIn);
+    free(pPacked);
+    free(pOne);
+}
+
+void check_packed()
+{
+    static const double adfByte[] =
+        { 0, 1, 2, 3, 17, 127, 128, 200, 254, 255 };
+    const int nByte = sizeof(adfByte) / sizeof(adfByte[0]);
+    static const double adfUInt16[] =
+        { 0, 1, 127, 255, 256, 1000, 12345, 32767, 32768, 40000, 65534, 65535 };
+    const int nUInt16 = sizeof(adfUInt16) / sizeof(adfUInt16[0]);
+    static const double adfInt16[] =
+        { 0, 1, -1, 127, -128, 255, 256, -1000, 12345, 32767, -32767, -32768 };
+    const int nInt16 = sizeof(adfInt16) / sizeof(adfInt16[0]);
+    static const double adfReal[] =
+        { 0, 0.49, 0.5, 0.51, 1.5, 2.5, 127.5, 254.5, 255.49, 255.5,
+          256, 1000.7, -0.49, -0.5, -0.51, -1.5, -2.5, -200, 32766.5,
+          32767.5, -32767.5, -32768.5, 65534.5, 65535.5, 70000, -70000,
+          1e30, -1e30, 12.25, 99.75 };
+    const int nReal = sizeof(adfReal) / sizeof(adfReal[0]);
+    double adfRealNaN[nReal + 1];
+
+    memcpy(adfRealNaN, adfReal, sizeof(adfReal));
+    adfRealNaN[nReal] = sqrt(-1.0);
+
+    GDALDataType aeReal[] = { GDT_Float32, GDT_Float64 };
+    GDALDataType aeInt[] = { GDT_Byte, GDT_UInt16, GDT_Int16 };
+    int j;
+
+    for (j = 0; j < 2; j++)
+    {
+        CheckPacked<GByte>(GDT_Byte, adfByte, nByte, aeReal[j], __LINE__);
+        CheckPacked<GUInt16>(GDT_UInt16, adfUInt16, nUInt16, aeReal[j], __LINE__);
+        CheckPacked<GInt16>(GDT_Int16, adfInt16, nInt16, aeReal[j], __LINE__);
+    }
+
+    for (j = 0; j < 3; j++)
+    {
+        CheckPacked<float>(GDT_Float32, adfReal, nReal, aeInt[j], __LINE__);
+        CheckPacked<float>(GDT_Float32, adfRealNaN, nReal + 1, aeInt[j], __LINE__);
+    }
+}
+
 int main(int argc, char* argv[])
 {
     pIn = (char*)malloc(128);
@@ -451,6 +539,7 @@ int main(int argc, char* argv[])
     check_GDT_CInt16();
     check_GDT_CInt32();
     check_GDT_CFloat32and64();
+    check_packed();
     
     free(pIn);
     free(pOut);
@@ -0,0 +1,436 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Core
+ * Purpose:  Test that batched multi-window RasterIO requests give the same
+ *           result as one RasterIO() call per window.
+ ******************************************************************************
+ * Copyright (c) 2011, The GDAL project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include <iostream>
+#include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+
+#define RASTER_XSIZE    500
+#define RASTER_YSIZE    400
+#define RASTER_BANDS    3
+
+static int bErr = FALSE;
+
+/* Windows of various shapes: within one block, spanning several blocks, */
+/* subsampled, oversampled, overlapping, out of block order and empty.   */
+static const int anWindows[][6] = {
+    /* nXOff, nYOff, nXSize, nYSize, nBufXSize, nBufYSize */
+    { 300, 250, 10, 10, 10, 10 },
+    { 0, 0, 1, 1, 1, 1 },
+    { 3, 5, 17, 9, 17, 9 },
+    { 120, 100, 150, 97, 150, 97 },
+    { 0, 0, RASTER_XSIZE, RASTER_YSIZE, 123, 77 },
+    { 45, 33, 20, 11, 61, 40 },
+    { 130, 110, 150, 97, 150, 97 },
+    { 499, 0, 1, 400, 1, 400 },
+    { 0, 399, 500, 1, 500, 1 },
+    { 250, 200, 0, 0, 0, 0 },
+    { 10, 390, 64, 10, 64, 10 },
+    { 301, 251, 10, 10, 5, 5 },
+    { 250, 220, 60, 40, 60, 40 }
+};
+
+#define WINDOW_COUNT ((int) (sizeof(anWindows) / sizeof(anWindows[0])))
+
+/************************************************************************/
+/*                            PixelValue()                              */
+/************************************************************************/
+
+static GByte PixelValue( int iBand, int iX, int iY )
+{
+    return (GByte) ((iBand * 31 + iX * 7 + iY * 13 + iX * iY) % 251);
+}
+
+/************************************************************************/
+/*                          CreateDataset()                             */
+/************************************************************************/
+
+static GDALDatasetH CreateDataset( const char* pszDriver,
+                                   const char* pszFilename,
+                                   char** papszOptions )
+{
+    GDALDatasetH hDS = GDALCreate( GDALGetDriverByName(pszDriver), pszFilename,
+                                   RASTER_XSIZE, RASTER_YSIZE, RASTER_BANDS,
+                                   GDT_Byte, papszOptions );
+    GByte* pabyLine = (GByte*) CPLMalloc(RASTER_XSIZE);
+
+    for( int iBand = 0; iBand < RASTER_BANDS; iBand++ )
+    {
+        GDALRasterBandH hBand = GDALGetRasterBand(hDS, iBand + 1);
+        for( int iY = 0; iY < RASTER_YSIZE; iY++ )
+        {
+            for( int iX = 0; iX < RASTER_XSIZE; iX++ )
+                pabyLine[iX] = PixelValue(iBand, iX, iY);
+            GDALRasterIO(hBand, GF_Write, 0, iY, RASTER_XSIZE, 1,
+                         pabyLine, RASTER_XSIZE, 1, GDT_Byte, 0, 0);
+        }
+    }
+
+    CPLFree(pabyLine);
+
+    return hDS;
+}
+
+/************************************************************************/
+/*                          AllocWindows()                              */
+/*                                                                      */
+/*      Allocate the windows and their buffers, for nBands bands of     */
+/*      eBufType, and fill the buffers with a value that differs from   */
+/*      the pixel values.                                               */
+/************************************************************************/
+
+static GDALRasterIOWindow* AllocWindows( GDALDataType eBufType, int nBands )
+{
+    GDALRasterIOWindow* pasWindows = (GDALRasterIOWindow*)
+        CPLCalloc(WINDOW_COUNT, sizeof(GDALRasterIOWindow));
+    int nPixelSize = GDALGetDataTypeSize(eBufType) / 8;
+
+    for( int i = 0; i < WINDOW_COUNT; i++ )
+    {
+        GDALRasterIOWindow* psWindow = pasWindows + i;
+        psWindow->nXOff = anWindows[i][0];
+        psWindow->nYOff = anWindows[i][1];
+        psWindow->nXSize = anWindows[i][2];
+        psWindow->nYSize = anWindows[i][3];
+        psWindow->nBufXSize = anWindows[i][4];
+        psWindow->nBufYSize = anWindows[i][5];
+
+        size_t nBytes = (size_t)psWindow->nBufXSize * psWindow->nBufYSize *
+            nPixelSize * nBands;
+        psWindow->pData = CPLMalloc(MAX(nBytes, 1));
+        memset(psWindow->pData, 0xFE, MAX(nBytes, 1));
+    }
+
+    return pasWindows;
+}
+
+static void FreeWindows( GDALRasterIOWindow* pasWindows )
+{
+    for( int i = 0; i < WINDOW_COUNT; i++ )
+        CPLFree(pasWindows[i].pData);
+    CPLFree(pasWindows);
+}
+
+/************************************************************************/
+/*                          CompareWindows()                            */
+/************************************************************************/
+
+static void CompareWindows( const char* pszTest,
+                            GDALRasterIOWindow* pasWindows,
+                            GDALRasterIOWindow* pasRefWindows,
+                            GDALDataType eBufType, int nBands )
+{
+    int nPixelSize = GDALGetDataTypeSize(eBufType) / 8;
+
+    for( int i = 0; i < WINDOW_COUNT; i++ )
+    {
+        size_t nBytes = (size_t)pasWindows[i].nBufXSize *
+            pasWindows[i].nBufYSize * nPixelSize * nBands;
+        if( memcmp(pasWindows[i].pData, pasRefWindows[i].pData, nBytes) != 0 )
+        {
+            std::cout << pszTest << ": window " << i
+                      << " differs from RasterIO()" << std::endl;
+            bErr = TRUE;
+        }
+    }
+}
+
+/************************************************************************/
+/*                          DropCachedBlocks()                          */
+/*                                                                      */
+/*      Drop the blocks read by the reference requests, so that the     */
+/*      batched requests have to fetch them themselves.                 */
+/************************************************************************/
+
+static void DropCachedBlocks()
+{
+    int nCacheMax = GDALGetCacheMax();
+    GDALSetCacheMax(0);
+    GDALSetCacheMax(nCacheMax);
+}
+
+/************************************************************************/
+/*                            TestBandRead()                            */
+/************************************************************************/
+
+static void TestBandRead( const char* pszTest, GDALDatasetH hDS,
+                          GDALDataType eBufType )
+{
+    GDALRasterBandH hBand = GDALGetRasterBand(hDS, 2);
+    GDALRasterIOWindow* pasWindows = AllocWindows(eBufType, 1);
+    GDALRasterIOWindow* pasRefWindows = AllocWindows(eBufType, 1);
+
+    for( int i = 0; i < WINDOW_COUNT; i++ )
+    {
+        GDALRasterIOWindow* psWindow = pasRefWindows + i;
+        if( psWindow->nBufXSize == 0 )
+            continue;
+        GDALRasterIO(hBand, GF_Read, psWindow->nXOff, psWindow->nYOff,
+                     psWindow->nXSize, psWindow->nYSize, psWindow->pData,
+                     psWindow->nBufXSize, psWindow->nBufYSize, eBufType,
+                     0, 0);
+    }
+
+    DropCachedBlocks();
+
+    if( GDALRasterIOMulti(hBand, GF_Read, WINDOW_COUNT, pasWindows,
+                          eBufType, 0, 0) != CE_None )
+    {
+        std::cout << pszTest << ": GDALRasterIOMulti() failed" << std::endl;
+        bErr = TRUE;
+    }
+    else
+        CompareWindows(pszTest, pasWindows, pasRefWindows, eBufType, 1);
+
+    FreeWindows(pasWindows);
+    FreeWindows(pasRefWindows);
+}
+
+/************************************************************************/
+/*                          TestDatasetRead()                           */
+/*                                                                      */
+/*      Read two bands out of order into pixel interleaved buffers.     */
+/************************************************************************/
+
+static void TestDatasetRead( const char* pszTest, GDALDatasetH hDS )
+{
+    int anBandMap[2] = { 3, 1 };
+    GDALRasterIOWindow* pasWindows = AllocWindows(GDT_Byte, 2);
+    GDALRasterIOWindow* pasRefWindows = AllocWindows(GDT_Byte, 2);
+
+    for( int i = 0; i < WINDOW_COUNT; i++ )
+    {
+        GDALRasterIOWindow* psWindow = pasRefWindows + i;
+        if( psWindow->nBufXSize == 0 )
+            continue;
+        GDALDatasetRasterIO(hDS, GF_Read, psWindow->nXOff, psWindow->nYOff,
+                            psWindow->nXSize, psWindow->nYSize,
+                            psWindow->pData,
+                            psWindow->nBufXSize, psWindow->nBufYSize,
+                            GDT_Byte, 2, anBandMap,
+                            2, 2 * psWindow->nBufXSize, 1);
+    }
+
+    DropCachedBlocks();
+
+    /* The line spacing depends on the window, so it is defaulted */
+    CPLErr eErr = GDALDatasetRasterIOMulti(hDS, GF_Read, WINDOW_COUNT,
+                                           pasWindows, GDT_Byte,
+                                           2, anBandMap, 2, 0, 1);
+    if( eErr == CE_None )
+    {
+        /* The same windows, band sequential */
+        GDALRasterIOWindow* pasBSQWindows = AllocWindows(GDT_Byte, 2);
+        DropCachedBlocks();
+        eErr = GDALDatasetRasterIOMulti(hDS, GF_Read, WINDOW_COUNT,
+                                        pasBSQWindows, GDT_Byte,
+                                        2, anBandMap, 0, 0, 0);
+        for( int i = 0; i < WINDOW_COUNT && eErr == CE_None; i++ )
+        {
+            GDALRasterIOWindow* psWindow = pasBSQWindows + i;
+            int nPixels = psWindow->nBufXSize * psWindow->nBufYSize;
+            for( int j = 0; j < nPixels; j++ )
+            {
+                if( ((GByte*) psWindow->pData)[j] !=
+                        ((GByte*) pasRefWindows[i].pData)[2 * j]
+                    || ((GByte*) psWindow->pData)[nPixels + j] !=
+                        ((GByte*) pasRefWindows[i].pData)[2 * j + 1] )
+                {
+                    std::cout << pszTest << ": band sequential window " << i
+                              << " differs from RasterIO()" << std::endl;
+                    bErr = TRUE;
+                    break;
+                }
+            }
+        }
+        FreeWindows(pasBSQWindows);
+    }
+
+    if( eErr != CE_None )
+    {
+        std::cout << pszTest << ": GDALDatasetRasterIOMulti() failed"
+                  << std::endl;
+        bErr = TRUE;
+    }
+    else
+        CompareWindows(pszTest, pasWindows, pasRefWindows, GDT_Byte, 2);
+
+    FreeWindows(pasWindows);
+    FreeWindows(pasRefWindows);
+}
+
+/************************************************************************/
+/*                             TestWrite()                              */
+/*                                                                      */
+/*      Write the windows, some of which overlap, in one batch and one  */
+/*      by one into two copies of the dataset, and compare them.        */
+/************************************************************************/
+
+static void TestWrite( const char* pszDriver, char** papszOptions )
+{
+    GDALDatasetH hDS = CreateDataset(pszDriver,
+                                     "/vsimem/testrasteriomulti_1.tif",
+                                     papszOptions);
+    GDALDatasetH hRefDS = CreateDataset(pszDriver,
+                                        "/vsimem/testrasteriomulti_2.tif",
+                                        papszOptions);
+    GDALRasterIOWindow* pasWindows = AllocWindows(GDT_Byte, 1);
+    int i, iY;
+
+    for( i = 0; i < WINDOW_COUNT; i++ )
+    {
+        GDALRasterIOWindow* psWindow = pasWindows + i;
+        /* Only full resolution windows: writing a decimated window */
+        /* leaves pixels unwritten, which is also what RasterIO() does, */
+        /* but does not test much. */
+        psWindow->nBufXSize = psWindow->nXSize;
+        psWindow->nBufYSize = psWindow->nYSize;
+        CPLFree(psWindow->pData);
+        psWindow->pData = CPLMalloc(
+            MAX(psWindow->nBufXSize * psWindow->nBufYSize, 1));
+        for( int j = 0; j < psWindow->nBufXSize * psWindow->nBufYSize; j++ )
+            ((GByte*) psWindow->pData)[j] = (GByte) (i * 17 + j);
+
+        if( psWindow->nBufXSize > 0 )
+            GDALRasterIO(GDALGetRasterBand(hRefDS, 1), GF_Write,
+                         psWindow->nXOff, psWindow->nYOff,
+                         psWindow->nXSize, psWindow->nYSize, psWindow->pData,
+                         psWindow->nBufXSize, psWindow->nBufYSize, GDT_Byte,
+                         0, 0);
+    }
+
+    if( GDALRasterIOMulti(GDALGetRasterBand(hDS, 1), GF_Write, WINDOW_COUNT,
+                          pasWindows, GDT_Byte, 0, 0) != CE_None )
+    {
+        std::cout << pszDriver << " write: GDALRasterIOMulti() failed"
+                  << std::endl;
+        bErr = TRUE;
+    }
+
+    GDALFlushCache(hDS);
+    GDALFlushCache(hRefDS);
+
+    GByte* pabyLine = (GByte*) CPLMalloc(RASTER_XSIZE);
+    GByte* pabyRefLine = (GByte*) CPLMalloc(RASTER_XSIZE);
+    for( iY = 0; iY < RASTER_YSIZE && !bErr; iY++ )
+    {
+        GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Read, 0, iY,
+                     RASTER_XSIZE, 1, pabyLine, RASTER_XSIZE, 1, GDT_Byte,
+                     0, 0);
+        GDALRasterIO(GDALGetRasterBand(hRefDS, 1), GF_Read, 0, iY,
+                     RASTER_XSIZE, 1, pabyRefLine, RASTER_XSIZE, 1, GDT_Byte,
+                     0, 0);
+        if( memcmp(pabyLine, pabyRefLine, RASTER_XSIZE) != 0 )
+        {
+            std::cout << pszDriver << " write: line " << iY
+                      << " differs from RasterIO()" << std::endl;
+            bErr = TRUE;
+        }
+    }
+    CPLFree(pabyLine);
+    CPLFree(pabyRefLine);
+
+    FreeWindows(pasWindows);
+    GDALClose(hDS);
+    GDALClose(hRefDS);
+    VSIUnlink("/vsimem/testrasteriomulti_1.tif");
+    VSIUnlink("/vsimem/testrasteriomulti_2.tif");
+}
+
+/************************************************************************/
+/*                             TestRead()                               */
+/************************************************************************/
+
+static void TestRead( const char* pszDriver, char** papszOptions,
+                      const char* pszNumThreads )
+{
+    CPLString osTest;
+    osTest.Printf("%s %s NUM_THREADS=%s", pszDriver,
+                  papszOptions ? papszOptions[0] : "", pszNumThreads);
+
+    GDALDatasetH hDS = CreateDataset(pszDriver,
+                                     "/vsimem/testrasteriomulti.tif",
+                                     papszOptions);
+    if( EQUAL(pszDriver, "GTiff") )
+    {
+        /* Read back from the file */
+        GDALClose(hDS);
+        hDS = GDALOpen("/vsimem/testrasteriomulti.tif", GA_ReadOnly);
+    }
+
+    CPLSetConfigOption("GDAL_NUM_THREADS", pszNumThreads);
+    TestBandRead(osTest, hDS, GDT_Byte);
+    TestBandRead((osTest + " UInt16").c_str(), hDS, GDT_UInt16);
+    TestDatasetRead((osTest + " dataset").c_str(), hDS);
+    CPLSetConfigOption("GDAL_NUM_THREADS", NULL);
+
+    GDALClose(hDS);
+    VSIUnlink("/vsimem/testrasteriomulti.tif");
+}
+
+int main(int argc, char* argv[])
+{
+    GDALAllRegister();
+
+    char** papszTiled = NULL;
+    papszTiled = CSLAddString(papszTiled, "TILED=YES");
+    papszTiled = CSLAddString(papszTiled, "BLOCKXSIZE=64");
+    papszTiled = CSLAddString(papszTiled, "BLOCKYSIZE=32");
+    papszTiled = CSLAddString(papszTiled, "COMPRESS=DEFLATE");
+
+    char** papszPixel = NULL;
+    papszPixel = CSLAddString(papszPixel, "INTERLEAVE=PIXEL");
+    papszPixel = CSLAddString(papszPixel, "TILED=YES");
+
+    char** papszStriped = NULL;
+    papszStriped = CSLAddString(papszStriped, "INTERLEAVE=BAND");
+    papszStriped = CSLAddString(papszStriped, "BLOCKYSIZE=16");
+
+    TestRead("MEM", NULL, "1");
+    TestRead("GTiff", papszTiled, "1");
+    TestRead("GTiff", papszTiled, "4");
+    TestRead("GTiff", papszPixel, "4");
+    TestRead("GTiff", papszStriped, "1");
+
+    TestWrite("MEM", NULL);
+    TestWrite("GTiff", papszTiled);
+
+    CSLDestroy(papszTiled);
+    CSLDestroy(papszPixel);
+    CSLDestroy(papszStriped);
+
+    GDALDestroyDriverManager();
+
+    if (bErr == FALSE)
+        printf("success !\n");
+    else
+        printf("fail !\n");
+
+    return (bErr == FALSE) ? 0 : -1;
+}
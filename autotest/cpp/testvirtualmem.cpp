@@ -0,0 +1,329 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Core
+ * Purpose:  Test the virtual memory mappings of raster bands.
+ ******************************************************************************
+ * Copyright (c) 2011, The GDAL project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include <iostream>
+#include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <cpl_virtualmem.h>
+
+#define RASTER_XSIZE    500
+#define RASTER_YSIZE    400
+
+static int bErr = FALSE;
+
+/************************************************************************/
+/*                            PixelValue()                              */
+/************************************************************************/
+
+static GByte PixelValue( int iBand, int iX, int iY )
+{
+    return (GByte) ((iBand * 31 + iX * 7 + iY * 13 + iX * iY) % 251);
+}
+
+/************************************************************************/
+/*                          CreateDataset()                             */
+/************************************************************************/
+
+static GDALDatasetH CreateDataset( const char* pszFilename, int nBands,
+                                   char** papszOptions )
+{
+    GDALDatasetH hDS = GDALCreate( GDALGetDriverByName("GTiff"), pszFilename,
+                                   RASTER_XSIZE, RASTER_YSIZE, nBands,
+                                   GDT_Byte, papszOptions );
+    GByte* pabyLine = (GByte*) CPLMalloc(RASTER_XSIZE);
+
+    for( int iBand = 0; iBand < nBands; iBand++ )
+    {
+        GDALRasterBandH hBand = GDALGetRasterBand(hDS, iBand + 1);
+        for( int iY = 0; iY < RASTER_YSIZE; iY++ )
+        {
+            for( int iX = 0; iX < RASTER_XSIZE; iX++ )
+                pabyLine[iX] = PixelValue(iBand, iX, iY);
+            GDALRasterIO(hBand, GF_Write, 0, iY, RASTER_XSIZE, 1,
+                         pabyLine, RASTER_XSIZE, 1, GDT_Byte, 0, 0);
+        }
+    }
+
+    CPLFree(pabyLine);
+
+    return hDS;
+}
+
+/************************************************************************/
+/*                           CompareBuffer()                            */
+/*                                                                      */
+/*      Compare the content of a mapping with the result of the         */
+/*      equivalent RasterIO() request.                                  */
+/************************************************************************/
+
+static void CompareBuffer( const char* pszTest, GDALRasterBandH hBand,
+                           CPLVirtualMem* psVMem,
+                           int nXOff, int nYOff, int nXSize, int nYSize,
+                           int nBufXSize, int nBufYSize,
+                           GDALDataType eBufType )
+{
+    if( psVMem == NULL )
+    {
+        std::cout << pszTest << ": mapping creation failed" << std::endl;
+        bErr = TRUE;
+        return;
+    }
+
+    size_t nBytes = (size_t)nBufXSize * nBufYSize *
+        (GDALGetDataTypeSize(eBufType) / 8);
+    GByte* pabyRef = (GByte*) CPLMalloc(nBytes);
+
+    GDALRasterIO(hBand, GF_Read, nXOff, nYOff, nXSize, nYSize,
+                 pabyRef, nBufXSize, nBufYSize, eBufType, 0, 0);
+
+    if( CPLVirtualMemGetSize(psVMem) < nBytes ||
+        memcmp(CPLVirtualMemGetAddr(psVMem), pabyRef, nBytes) != 0 )
+    {
+        std::cout << pszTest << ": mapping differs from RasterIO()"
+                  << std::endl;
+        bErr = TRUE;
+    }
+
+    CPLFree(pabyRef);
+}
+
+/************************************************************************/
+/*                             TestRead()                               */
+/*                                                                      */
+/*      Read mappings with a cache of a few pages, so that pages get    */
+/*      evicted and mapped again.                                       */
+/************************************************************************/
+
+static void TestRead()
+{
+    char** papszOptions = NULL;
+    papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+    papszOptions = CSLSetNameValue(papszOptions, "COMPRESS", "DEFLATE");
+    GDALDatasetH hDS = CreateDataset("/vsimem/testvirtualmem_read.tif", 1,
+                                     papszOptions);
+    CSLDestroy(papszOptions);
+
+    GDALRasterBandH hBand = GDALGetRasterBand(hDS, 1);
+    size_t nPageSize = CPLGetPageSize();
+    CPLVirtualMem* psVMem;
+
+    psVMem = GDALRasterBandGetVirtualMem(hBand, GF_Read,
+                                         0, 0, RASTER_XSIZE, RASTER_YSIZE,
+                                         RASTER_XSIZE, RASTER_YSIZE,
+                                         GDT_Byte, 4 * nPageSize, 0, NULL);
+    CompareBuffer("full band", hBand, psVMem,
+                  0, 0, RASTER_XSIZE, RASTER_YSIZE,
+                  RASTER_XSIZE, RASTER_YSIZE, GDT_Byte);
+    if( psVMem != NULL )
+        CPLVirtualMemFree(psVMem);
+
+    psVMem = GDALRasterBandGetVirtualMem(hBand, GF_Read,
+                                         13, 27, 401, 301, 170, 113,
+                                         GDT_Int16, 4 * nPageSize, 0, NULL);
+    CompareBuffer("subsampled window", hBand, psVMem,
+                  13, 27, 401, 301, 170, 113, GDT_Int16);
+    if( psVMem != NULL )
+        CPLVirtualMemFree(psVMem);
+
+    int nPixelSpace = 0;
+    GIntBig nLineSpace = 0;
+    psVMem = GDALGetVirtualMemAuto(hBand, GF_Read, &nPixelSpace, &nLineSpace,
+                                   NULL);
+    if( nPixelSpace != 1 || nLineSpace != RASTER_XSIZE )
+    {
+        std::cout << "auto mapping of tiled file: wrong layout" << std::endl;
+        bErr = TRUE;
+    }
+    CompareBuffer("auto mapping of tiled file", hBand, psVMem,
+                  0, 0, RASTER_XSIZE, RASTER_YSIZE,
+                  RASTER_XSIZE, RASTER_YSIZE, GDT_Byte);
+    if( psVMem != NULL )
+        CPLVirtualMemFree(psVMem);
+
+    GDALClose(hDS);
+    VSIUnlink("/vsimem/testvirtualmem_read.tif");
+}
+
+/************************************************************************/
+/*                             TestWrite()                              */
+/*                                                                      */
+/*      Modify the band through a mapping, and check that the pages     */
+/*      are written back when evicted and when the mapping is freed.    */
+/************************************************************************/
+
+static void TestWrite()
+{
+    char** papszOptions = NULL;
+    papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+    GDALDatasetH hDS = CreateDataset("/vsimem/testvirtualmem_write.tif", 1,
+                                     papszOptions);
+    CSLDestroy(papszOptions);
+
+    GDALRasterBandH hBand = GDALGetRasterBand(hDS, 1);
+    CPLVirtualMem* psVMem;
+
+    psVMem = GDALRasterBandGetVirtualMem(hBand, GF_Write,
+                                         0, 0, RASTER_XSIZE, RASTER_YSIZE,
+                                         RASTER_XSIZE, RASTER_YSIZE,
+                                         GDT_Byte, 4 * CPLGetPageSize(), 0,
+                                         NULL);
+    if( psVMem == NULL )
+    {
+        std::cout << "write mapping creation failed" << std::endl;
+        bErr = TRUE;
+        GDALClose(hDS);
+        VSIUnlink("/vsimem/testvirtualmem_write.tif");
+        return;
+    }
+
+    GByte* pabyData = (GByte*) CPLVirtualMemGetAddr(psVMem);
+    int iX, iY;
+    for( iY = 0; iY < RASTER_YSIZE; iY += 3 )
+    {
+        for( iX = 0; iX < RASTER_XSIZE; iX += 5 )
+            pabyData[iY * RASTER_XSIZE + iX] = 255 - PixelValue(0, iX, iY);
+    }
+    CPLVirtualMemFree(psVMem);
+
+    GDALClose(hDS);
+
+    hDS = GDALOpen("/vsimem/testvirtualmem_write.tif", GA_ReadOnly);
+    hBand = GDALGetRasterBand(hDS, 1);
+    GByte* pabyLine = (GByte*) CPLMalloc(RASTER_XSIZE);
+    for( iY = 0; iY < RASTER_YSIZE && !bErr; iY++ )
+    {
+        GDALRasterIO(hBand, GF_Read, 0, iY, RASTER_XSIZE, 1,
+                     pabyLine, RASTER_XSIZE, 1, GDT_Byte, 0, 0);
+        for( iX = 0; iX < RASTER_XSIZE; iX++ )
+        {
+            GByte nExpected = PixelValue(0, iX, iY);
+            if( (iY % 3) == 0 && (iX % 5) == 0 )
+                nExpected = 255 - nExpected;
+            if( pabyLine[iX] != nExpected )
+            {
+                std::cout << "write mapping: wrong value at (" << iX << ","
+                          << iY << ")" << std::endl;
+                bErr = TRUE;
+                break;
+            }
+        }
+    }
+    CPLFree(pabyLine);
+
+    GDALClose(hDS);
+    VSIUnlink("/vsimem/testvirtualmem_write.tif");
+}
+
+/************************************************************************/
+/*                           TestFileMapping()                          */
+/*                                                                      */
+/*      An uncompressed striped pixel interleaved GeoTIFF file is       */
+/*      mapped directly by GetVirtualMemAuto().                         */
+/************************************************************************/
+
+static void TestFileMapping()
+{
+    const char* pszFilename = "tmp/testvirtualmem.tif";
+    GDALDatasetH hDS = CreateDataset(pszFilename, 3, NULL);
+    if( hDS == NULL )
+    {
+        std::cout << "cannot create " << pszFilename << std::endl;
+        bErr = TRUE;
+        return;
+    }
+    GDALClose(hDS);
+
+    hDS = GDALOpen(pszFilename, GA_ReadOnly);
+    GDALRasterBandH hBand = GDALGetRasterBand(hDS, 2);
+    int nPixelSpace = 0;
+    GIntBig nLineSpace = 0;
+    CPLVirtualMem* psVMem = GDALGetVirtualMemAuto(hBand, GF_Read,
+                                                  &nPixelSpace, &nLineSpace,
+                                                  NULL);
+    if( psVMem == NULL )
+    {
+        std::cout << "file mapping creation failed" << std::endl;
+        bErr = TRUE;
+    }
+    else
+    {
+        if( nPixelSpace != 3 || nLineSpace != 3 * RASTER_XSIZE )
+        {
+            std::cout << "file mapping: wrong layout" << std::endl;
+            bErr = TRUE;
+        }
+        else
+        {
+            const GByte* pabyData =
+                (const GByte*) CPLVirtualMemGetAddr(psVMem);
+            for( int iY = 0; iY < RASTER_YSIZE && !bErr; iY++ )
+            {
+                for( int iX = 0; iX < RASTER_XSIZE; iX++ )
+                {
+                    if( pabyData[iY * nLineSpace + iX * nPixelSpace] !=
+                        PixelValue(1, iX, iY) )
+                    {
+                        std::cout << "file mapping: wrong value at (" << iX
+                                  << "," << iY << ")" << std::endl;
+                        bErr = TRUE;
+                        break;
+                    }
+                }
+            }
+        }
+        CPLVirtualMemFree(psVMem);
+    }
+
+    GDALClose(hDS);
+    GDALDeleteDataset(GDALGetDriverByName("GTiff"), pszFilename);
+}
+
+int main(int argc, char* argv[])
+{
+    GDALAllRegister();
+
+    if( !CPLIsVirtualMemAvailable() )
+    {
+        printf("skipped: virtual memory not available on this platform\n");
+        GDALDestroyDriverManager();
+        return 0;
+    }
+
+    TestRead();
+    TestWrite();
+    TestFileMapping();
+
+    GDALDestroyDriverManager();
+
+    if (bErr == FALSE)
+        printf("success !\n");
+    else
+        printf("fail !\n");
+
+    return (bErr == FALSE) ? 0 : -1;
+}
@@ -30,6 +30,7 @@
 
 import os
 import sys
+import struct
 
 sys.path.append( '../pymod' )
 
@@ -298,13 +299,202 @@ def rasterio_6():
 
     return 'success'
 
+###############################################################################
+# Reference computation of a resampled read of a window of a list of rows,
+# with the weights of the AVERAGE, BILINEAR and CUBIC filters of
+# GDAL_RASTERIO_RESAMPLING.
+
+def rasterio_resample_weights(resampling, off, size, limit, dst_size):
+
+    scale = float(size) / dst_size
+    kernel_scale = max(1.0, scale)
+    if resampling == 'AVERAGE':
+        radius = scale / 2
+    elif resampling == 'BILINEAR':
+        radius = kernel_scale
+    else:
+        radius = 2 * kernel_scale
+
+    weights = []
+    for i in range(dst_size):
+        center = off + (i + 0.5) * scale
+        w = {}
+        for j in range(max(0, int(center - radius) - 1), min(limit, int(center + radius) + 2)):
+            if resampling == 'AVERAGE':
+                v = min(j + 1.0, center + radius) - max(float(j), center - radius)
+            else:
+                x = abs((j + 0.5 - center) / kernel_scale)
+                if resampling == 'BILINEAR':
+                    v = 1.0 - x
+                elif x < 1.0:
+                    v = (1.5 * x - 2.5) * x * x + 1.0
+                elif x < 2.0:
+                    v = ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0
+                else:
+                    v = 0.0
+            if v > 0.0 or (resampling == 'CUBIC' and x < 2.0):
+                w[j] = v
+        weights.append(w)
+    return weights
+
+def rasterio_resample_ref(rows, resampling, xoff, yoff, xsize, ysize,
+                          buf_xsize, buf_ysize, nodata = None):
+
+    xweights = rasterio_resample_weights(resampling, xoff, xsize, len(rows[0]), buf_xsize)
+    yweights = rasterio_resample_weights(resampling, yoff, ysize, len(rows), buf_ysize)
+    result = []
+    for wy in yweights:
+        for wx in xweights:
+            total = 0.0
+            weight_sum = 0.0
+            for (j, vy) in wy.items():
+                for (i, vx) in wx.items():
+                    if rows[j][i] != nodata:
+                        total += vx * vy * rows[j][i]
+                        weight_sum += vx * vy
+            if weight_sum == 0.0:
+                result.append(nodata)
+            else:
+                result.append(total / weight_sum)
+    return result
+
+def rasterio_check_resampled(got, expected, msg, tolerance = 1e-6):
+
+    for i in range(len(expected)):
+        if abs(got[i] - expected[i]) > tolerance:
+            gdaltest.post_reason('%s: got %f instead of %f at %d' % (msg, got[i], expected[i], i))
+            return 'fail'
+    return 'success'
+
+###############################################################################
+# Test GDAL_RASTERIO_RESAMPLING=AVERAGE on integer and non integer factors,
+# ignoring nodata pixels, and from overviews.
+
+def rasterio_7():
+
+    rows = [ [ float((x * 7 + y * 13 + x * y) % 101) for x in range(64) ] for y in range(48) ]
+    nodata_rows = [ [ rows[y][x] for x in range(64) ] for y in range(48) ]
+    for y in range(48):
+        for x in range(64):
+            if (x * x + 3 * y * y) % 5 < 2 or (x >= 20 and x < 30 and y >= 10 and y < 20):
+                nodata_rows[y][x] = 255.0
+
+    gdal.SetConfigOption('GDAL_RASTERIO_RESAMPLING', 'AVERAGE')
+
+    for drv_name in [ 'MEM', 'GTiff' ]:
+        for (data, nodata) in [ (rows, None), (nodata_rows, 255.0) ]:
+            ds = gdal.GetDriverByName(drv_name).Create('/vsimem/rasterio_7.tif', 64, 48, 1, gdal.GDT_Float32)
+            if nodata is not None:
+                ds.GetRasterBand(1).SetNoDataValue(nodata)
+            values = []
+            for row in data:
+                values.extend(row)
+            ds.GetRasterBand(1).WriteRaster(0, 0, 64, 48, struct.pack('d' * len(values), *values),
+                                            buf_type = gdal.GDT_Float64)
+
+            for (xoff, yoff, xsize, ysize, buf_xsize, buf_ysize) in [
+                    (0, 0, 64, 48, 32, 24),
+                    (0, 0, 64, 48, 25, 19),
+                    (10, 8, 40, 30, 16, 12),
+                    (20, 10, 10, 10, 2, 2) ]:
+                got = struct.unpack('d' * (buf_xsize * buf_ysize),
+                    ds.GetRasterBand(1).ReadRaster(xoff, yoff, xsize, ysize, buf_xsize, buf_ysize,
+                                                   buf_type = gdal.GDT_Float64))
+                expected = rasterio_resample_ref(data, 'AVERAGE', xoff, yoff, xsize, ysize,
+                                                 buf_xsize, buf_ysize, nodata)
+                if rasterio_check_resampled(got, expected, '%s %s' % (drv_name, str((xoff, yoff, xsize, ysize, buf_xsize, buf_ysize)))) != 'success':
+                    gdal.SetConfigOption('GDAL_RASTERIO_RESAMPLING', None)
+                    return 'fail'
+
+            ds = None
+            if drv_name == 'GTiff':
+                gdal.GetDriverByName('GTiff').Delete('/vsimem/rasterio_7.tif')
+
+    # A 4x4 average from the 2x2 overview gives the same result as from
+    # the full resolution band.
+    ds = gdal.GetDriverByName('GTiff').Create('/vsimem/rasterio_7.tif', 64, 48, 1, gdal.GDT_Float32)
+    values = []
+    for row in rows:
+        values.extend(row)
+    ds.GetRasterBand(1).WriteRaster(0, 0, 64, 48, struct.pack('d' * len(values), *values),
+                                    buf_type = gdal.GDT_Float64)
+    ds.BuildOverviews('AVERAGE', overviewlist = [2])
+    # Make sure that the overview is used
+    ovr = ds.GetRasterBand(1).GetOverview(0)
+    ovr_values = struct.unpack('d' * (32 * 24), ovr.ReadRaster(0, 0, 32, 24, buf_type = gdal.GDT_Float64))
+    ovr = None
+    got = struct.unpack('d' * (16 * 12),
+        ds.GetRasterBand(1).ReadRaster(0, 0, 64, 48, 16, 12, buf_type = gdal.GDT_Float64))
+    ds = None
+    gdal.GetDriverByName('GTiff').Delete('/vsimem/rasterio_7.tif')
+
+    gdal.SetConfigOption('GDAL_RASTERIO_RESAMPLING', None)
+
+    expected = rasterio_resample_ref(rows, 'AVERAGE', 0, 0, 64, 48, 16, 12)
+    if rasterio_check_resampled(got, expected, 'overview', 1e-4) != 'success':
+        return 'fail'
+    ovr_rows = [ list(ovr_values[y * 32:(y + 1) * 32]) for y in range(24) ]
+    expected = rasterio_resample_ref(ovr_rows, 'AVERAGE', 0, 0, 32, 24, 16, 12)
+    if rasterio_check_resampled(got, expected, 'overview (2)') != 'success':
+        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test GDAL_RASTERIO_RESAMPLING=BILINEAR and CUBIC when downsampling and
+# upsampling, and that dataset reads match band reads.
+
+def rasterio_8():
+
+    rows = [ [ float((x * 7 + y * 13 + x * y) % 101) for x in range(64) ] for y in range(48) ]
+    values = []
+    for row in rows:
+        values.extend(row)
+
+    ds = gdal.GetDriverByName('GTiff').Create('/vsimem/rasterio_8.tif', 64, 48, 2, gdal.GDT_Float32,
+                                              options = [ 'INTERLEAVE=PIXEL' ])
+    for i in range(2):
+        ds.GetRasterBand(i + 1).WriteRaster(0, 0, 64, 48, struct.pack('d' * len(values), *values),
+                                            buf_type = gdal.GDT_Float64)
+
+    for resampling in [ 'BILINEAR', 'CUBIC' ]:
+        gdal.SetConfigOption('GDAL_RASTERIO_RESAMPLING', resampling)
+        for (xoff, yoff, xsize, ysize, buf_xsize, buf_ysize) in [
+                (0, 0, 64, 48, 25, 19),
+                (10, 8, 40, 30, 16, 12),
+                (10, 8, 20, 15, 50, 37) ]:
+            got = ds.ReadRaster(xoff, yoff, xsize, ysize, buf_xsize, buf_ysize,
+                                buf_type = gdal.GDT_Float64)
+            got_band = ds.GetRasterBand(2).ReadRaster(xoff, yoff, xsize, ysize, buf_xsize, buf_ysize,
+                                                      buf_type = gdal.GDT_Float64)
+            if got[len(got) // 2:] != got_band:
+                gdaltest.post_reason('dataset and band %s reads differ' % resampling)
+                gdal.SetConfigOption('GDAL_RASTERIO_RESAMPLING', None)
+                return 'fail'
+
+            got = struct.unpack('d' * (buf_xsize * buf_ysize), got_band)
+            expected = rasterio_resample_ref(rows, resampling, xoff, yoff, xsize, ysize,
+                                             buf_xsize, buf_ysize)
+            if rasterio_check_resampled(got, expected, '%s %s' % (resampling, str((xoff, yoff, xsize, ysize, buf_xsize, buf_ysize)))) != 'success':
+                gdal.SetConfigOption('GDAL_RASTERIO_RESAMPLING', None)
+                return 'fail'
+
+    gdal.SetConfigOption('GDAL_RASTERIO_RESAMPLING', None)
+
+    ds = None
+    gdal.GetDriverByName('GTiff').Delete('/vsimem/rasterio_8.tif')
+
+    return 'success'
+
 gdaltest_list = [
     rasterio_1,
     rasterio_2,
     rasterio_3,
     rasterio_4,
     rasterio_5,
-    rasterio_6 ]
+    rasterio_6,
+    rasterio_7,
+    rasterio_8 ]
 
 if __name__ == '__main__':
 
@@ -1794,6 +1794,156 @@ def tiff_ovr_46():
 
     return 'success'
 
+###############################################################################
+# Create a test file whose pixel values vary from one pixel to the next, so
+# that the overviews depend on the exact source windows and weights.
+
+def tiff_ovr_create_pattern(filename, xsize, ysize, nbands, datatype = gdal.GDT_Byte, options = []):
+
+    ds = gdaltest.tiff_drv.Create(filename, xsize, ysize, nbands, datatype, options = options)
+    for i in range(nbands):
+        data = array.array('B', [ (x * 7 + y * 13 + x * y + i * 31) % 251
+                                  for y in range(ysize) for x in range(xsize) ])
+        ds.GetRasterBand(i+1).WriteRaster(0, 0, xsize, ysize, data.tostring(),
+                                          buf_type = gdal.GDT_Byte)
+    return ds
+
+def tiff_ovr_read_overviews(ds):
+
+    result = []
+    for i in range(ds.RasterCount):
+        band = ds.GetRasterBand(i+1)
+        for j in range(band.GetOverviewCount()):
+            ovr = band.GetOverview(j)
+            result.append(ovr.ReadRaster(0, 0, ovr.XSize, ovr.YSize))
+    return result
+
+###############################################################################
+# Test that computing overviews in worker threads (GDAL_NUM_THREADS) gives
+# the same result as computing them in the calling thread, through
+# GDALRegenerateOverviews() and GDALRegenerateOverviewsMultiBand().
+
+def tiff_ovr_47():
+
+    for options in [ [], [ 'COMPRESS=DEFLATE', 'INTERLEAVE=PIXEL' ] ]:
+        for resampling in [ 'NEAREST', 'AVERAGE', 'GAUSS', 'CUBIC', 'MODE', 'AVERAGE_MP' ]:
+            results = {}
+            for num_threads in [ '1', '4' ]:
+                ds = tiff_ovr_create_pattern('/vsimem/tiff_ovr_47.tif', 401, 333, 3, options = options)
+                gdal.SetConfigOption('GDAL_NUM_THREADS', num_threads)
+                ds.BuildOverviews( resampling, overviewlist = [2, 3, 8] )
+                gdal.SetConfigOption('GDAL_NUM_THREADS', None)
+                results[num_threads] = tiff_ovr_read_overviews(ds)
+                ds = None
+                gdaltest.tiff_drv.Delete('/vsimem/tiff_ovr_47.tif')
+
+            if results['1'] != results['4']:
+                gdaltest.post_reason('threaded %s overviews differ with %s' % (resampling, str(options)))
+                return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test that the SSE2 AVERAGE and GAUSS kernels, used for Byte, UInt16 and
+# Int16 sources, give the same result as the generic code, used for Float32
+# sources, with and without nodata pixels.  The strip height is set so that
+# all the files are processed by chunks of the same height.
+
+def tiff_ovr_48():
+
+    import struct
+
+    for (xsize, ysize) in [ (402, 334), (401, 333) ]:
+        for nodata in [ None, 251 ]:
+            data = []
+            for y in range(ysize):
+                for x in range(xsize):
+                    if nodata is not None and (x * x + 3 * y * y + x * y) % 5 < 2:
+                        data.append(nodata)
+                    else:
+                        data.append((x * 7 + y * 13 + x * y) % 251)
+            data = array.array('B', data).tostring()
+
+            for resampling in [ 'AVERAGE', 'GAUSS' ]:
+                results = {}
+                for datatype in [ gdal.GDT_Float32, gdal.GDT_Byte, gdal.GDT_UInt16, gdal.GDT_Int16 ]:
+                    ds = gdaltest.tiff_drv.Create('/vsimem/tiff_ovr_48.tif', xsize, ysize, 1, datatype,
+                                                  options = [ 'BLOCKYSIZE=32' ])
+                    if nodata is not None:
+                        ds.GetRasterBand(1).SetNoDataValue(nodata)
+                    ds.GetRasterBand(1).WriteRaster(0, 0, xsize, ysize, data, buf_type = gdal.GDT_Byte)
+                    ds.BuildOverviews( resampling, overviewlist = [2] )
+                    ovr = ds.GetRasterBand(1).GetOverview(0)
+                    results[datatype] = struct.unpack('f' * (ovr.XSize * ovr.YSize),
+                        ovr.ReadRaster(0, 0, ovr.XSize, ovr.YSize, buf_type = gdal.GDT_Float32))
+                    ovr = None
+                    ds = None
+                    gdaltest.tiff_drv.Delete('/vsimem/tiff_ovr_48.tif')
+
+                expected = tuple([ float(int(v + 0.5)) for v in results[gdal.GDT_Float32] ])
+                for datatype in [ gdal.GDT_Byte, gdal.GDT_UInt16, gdal.GDT_Int16 ]:
+                    if results[datatype] != expected:
+                        gdaltest.post_reason('%s overview of %s %dx%d (nodata=%s) differs from Float32 one' %
+                            (resampling, gdal.GetDataTypeName(datatype), xsize, ysize, str(nodata)))
+                        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test that building several AVERAGE and GAUSS overviews at once, in a single
+# pass over the base band, gives the same result as computing each level from
+# the previous one, as done by cascading generation.
+
+def tiff_ovr_49():
+
+    for resampling in [ 'AVERAGE', 'GAUSS' ]:
+        for datatype in [ gdal.GDT_Byte, gdal.GDT_Float32 ]:
+            ds = tiff_ovr_create_pattern('/vsimem/tiff_ovr_49.tif', 401, 333, 1, datatype,
+                                         options = [ 'BLOCKYSIZE=20' ])
+            ds.BuildOverviews( resampling, overviewlist = [2, 4, 8] )
+            got = tiff_ovr_read_overviews(ds)
+
+            # Build each level from a standalone copy of the previous one,
+            # with the same block size so that it is processed by the same
+            # chunks.
+            expected = []
+            src_band = ds.GetRasterBand(1)
+            src_ds = None
+            for i in range(3):
+                (blockxsize, blockysize) = src_band.GetBlockSize()
+                if blockxsize == src_band.XSize:
+                    options = [ 'BLOCKYSIZE=%d' % blockysize ]
+                else:
+                    options = [ 'TILED=YES', 'BLOCKXSIZE=%d' % blockxsize,
+                                'BLOCKYSIZE=%d' % blockysize ]
+                level_ds = gdaltest.tiff_drv.Create('/vsimem/tiff_ovr_49_%d.tif' % i,
+                                                    src_band.XSize, src_band.YSize, 1,
+                                                    datatype, options = options)
+                level_ds.GetRasterBand(1).WriteRaster(0, 0, src_band.XSize, src_band.YSize,
+                    src_band.ReadRaster(0, 0, src_band.XSize, src_band.YSize))
+                level_ds.BuildOverviews( resampling, overviewlist = [2] )
+                ovr = level_ds.GetRasterBand(1).GetOverview(0)
+                expected.append(ovr.ReadRaster(0, 0, ovr.XSize, ovr.YSize))
+
+                src_band = ovr
+                src_ds = level_ds
+
+            src_band = None
+            ovr = None
+            src_ds = None
+            level_ds = None
+            for i in range(3):
+                gdaltest.tiff_drv.Delete('/vsimem/tiff_ovr_49_%d.tif' % i)
+            ds = None
+            gdaltest.tiff_drv.Delete('/vsimem/tiff_ovr_49.tif')
+
+            if got != expected:
+                gdaltest.post_reason('single pass %s overviews of %s differ from cascaded ones' %
+                                     (resampling, gdal.GetDataTypeName(datatype)))
+                return 'fail'
+
+    return 'success'
+
 ###############################################################################
 # Cleanup
 
@@ -1884,6 +2034,9 @@ gdaltest_list_internal = [
     tiff_ovr_44,
     tiff_ovr_45,
     tiff_ovr_46,
+    tiff_ovr_47,
+    tiff_ovr_48,
+    tiff_ovr_49,
     tiff_ovr_cleanup ]
 
 def tiff_ovr_invert_endianness():
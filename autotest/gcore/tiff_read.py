@@ -906,6 +906,132 @@ def tiff_read_rpc_txt():
 
     return 'success'
 
+###############################################################################
+# Test that decoding the blocks of a RasterIO window in worker threads
+# (GDAL_NUM_THREADS) gives the same pixels as decoding them one at a time,
+# for the full resolution bands, the overviews and the mask.
+
+def tiff_read_decompression_threads():
+
+    data = ''.join([chr((x * 7 + y * 13 + x * y) % 251)
+                    for y in range(300) for x in range(300)])
+
+    ds = gdal.GetDriverByName('GTiff').Create('tmp/tiff_read_threads.tif',
+                                              300, 300, 3,
+                                              options = ['TILED=YES',
+                                                         'BLOCKXSIZE=32',
+                                                         'BLOCKYSIZE=32',
+                                                         'COMPRESS=DEFLATE',
+                                                         'PREDICTOR=2'])
+    for i in range(3):
+        ds.GetRasterBand(i+1).WriteRaster(0, 0, 300, 300, data[i*300:] + data[:i*300])
+    ds.CreateMaskBand(gdal.GMF_PER_DATASET)
+    ds.GetRasterBand(1).GetMaskBand().WriteRaster(0, 0, 300, 300, data)
+    ds.BuildOverviews('AVERAGE', [2, 4])
+    ds = None
+
+    results = {}
+    for num_threads in ['1', '4']:
+        gdal.SetConfigOption('GDAL_NUM_THREADS', num_threads)
+        ds = gdal.Open('tmp/tiff_read_threads.tif')
+        results[num_threads] = (
+            ds.ReadRaster(0, 0, 300, 300),
+            ds.ReadRaster(0, 0, 300, 300, buf_pixel_space = 3,
+                          buf_line_space = 3 * 300, buf_band_space = 1),
+            ds.GetRasterBand(2).ReadRaster(17, 45, 250, 200),
+            ds.GetRasterBand(3).GetOverview(0).ReadRaster(0, 0, 150, 150),
+            ds.GetRasterBand(1).GetOverview(1).ReadRaster(0, 0, 75, 75),
+            ds.GetRasterBand(1).GetMaskBand().ReadRaster(0, 0, 300, 300))
+        ds = None
+    gdal.SetConfigOption('GDAL_NUM_THREADS', None)
+
+    gdal.GetDriverByName('GTiff').Delete('tmp/tiff_read_threads.tif')
+
+    for i in range(len(results['1'])):
+        if results['1'][i] != results['4'][i]:
+            gdaltest.post_reason('threaded decoding result %d differs' % i)
+            return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test that subsampled reads with GTIFF_DIRECT_IO=YES use the overviews, as
+# the reads through the block cache do.
+
+def tiff_read_direct_io_overviews():
+
+    # Pixel values varying from one pixel to the next, so that averaged
+    # overviews differ from a decimation of the full resolution.
+    data = ''.join([chr((x * 7 + y * 13 + x * y) % 251)
+                    for y in range(400) for x in range(400)])
+
+    ds = gdal.GetDriverByName('GTiff').Create('tmp/tiff_read_direct_io.tif',
+                                              400, 400, 1,
+                                              options = ['TILED=YES'])
+    ds.WriteRaster(0, 0, 400, 400, data)
+    ds.BuildOverviews('AVERAGE', [2, 4])
+    ds = None
+
+    results = {}
+    for direct_io in ['NO', 'YES']:
+        gdal.SetConfigOption('GTIFF_DIRECT_IO', direct_io)
+        ds = gdal.Open('tmp/tiff_read_direct_io.tif')
+        results[direct_io] = (
+            ds.GetRasterBand(1).Checksum(),
+            ds.GetRasterBand(1).ReadRaster(0, 0, 400, 400, 100, 100),
+            ds.ReadRaster(0, 0, 400, 400, 200, 200),
+            ds.ReadRaster(30, 10, 300, 350, 131, 77))
+        ds = None
+    gdal.SetConfigOption('GTIFF_DIRECT_IO', None)
+
+    gdal.GetDriverByName('GTiff').Delete('tmp/tiff_read_direct_io.tif')
+
+    for i in range(4):
+        if results['NO'][i] != results['YES'][i]:
+            gdaltest.post_reason('direct I/O result %d differs' % i)
+            return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test that the pixel interleaved dataset read path fills the missing blocks
+# of a sparse file with the nodata value, as band reads do.
+
+def tiff_read_interleaved_sparse():
+
+    ds = gdal.GetDriverByName('GTiff').Create('tmp/tiff_read_sparse.tif',
+                                              512, 512, 3,
+                                              options = ['TILED=YES',
+                                                         'SPARSE_OK=YES'])
+    for i in range(3):
+        ds.GetRasterBand(i+1).SetNoDataValue(200)
+    ds.WriteRaster(0, 0, 256, 256, '\x01' * (256 * 256 * 3))
+    ds = None
+
+    for num_threads in [None, '4']:
+        gdal.SetConfigOption('GDAL_NUM_THREADS', num_threads)
+        ds = gdal.Open('tmp/tiff_read_sparse.tif')
+        data = ds.ReadRaster(0, 0, 512, 512, buf_pixel_space = 3,
+                             buf_line_space = 3 * 512, buf_band_space = 1)
+        band_data = ds.GetRasterBand(2).ReadRaster(0, 0, 512, 512)
+        ds = None
+        gdal.SetConfigOption('GDAL_NUM_THREADS', None)
+
+        if data[3 * (400 * 512 + 400) + 1] != '\xc8' \
+           or band_data[400 * 512 + 400] != '\xc8':
+            gdaltest.post_reason('missing block not filled with nodata')
+            print(num_threads)
+            return 'fail'
+
+        if data[3 * (10 * 512 + 10) + 1] != '\x01':
+            gdaltest.post_reason('wrong value in written block')
+            print(num_threads)
+            return 'fail'
+
+    gdal.GetDriverByName('GTiff').Delete('tmp/tiff_read_sparse.tif')
+
+    return 'success'
+
 ###############################################################################
 # Test reading a YCbCr JPEG all-in-one-strip multiband TIFF (#3259, #3894)
 
@@ -972,6 +1098,9 @@ gdaltest_list.append( (tiff_read_corrupted_gtiff) )
 gdaltest_list.append( (tiff_read_tag_without_null_byte) )
 gdaltest_list.append( (tiff_read_buggy_packbits) )
 gdaltest_list.append( (tiff_read_rpc_txt) )
+gdaltest_list.append( (tiff_read_decompression_threads) )
+gdaltest_list.append( (tiff_read_direct_io_overviews) )
+gdaltest_list.append( (tiff_read_interleaved_sparse) )
 gdaltest_list.append( (tiff_read_online_1) )
 
 if __name__ == '__main__':
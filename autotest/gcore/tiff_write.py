@@ -4129,6 +4129,54 @@ def tiff_write_104():
 
     return 'success'
 
+###############################################################################
+# Test that compressing blocks in worker threads (NUM_THREADS creation
+# option) writes the same file as compressing them in the calling thread.
+
+def tiff_write_105():
+
+    src_ds = gdal.Open('data/rgbsmall.tif')
+
+    for compression in [ 'DEFLATE', 'LZW', 'PACKBITS' ]:
+        for options in [ [],
+                         [ 'PREDICTOR=2', 'BLOCKYSIZE=3' ],
+                         [ 'TILED=YES', 'BLOCKXSIZE=16', 'BLOCKYSIZE=16' ],
+                         [ 'TILED=YES', 'BLOCKXSIZE=16', 'BLOCKYSIZE=16', 'INTERLEAVE=BAND' ] ]:
+            options = options + [ 'COMPRESS=' + compression ]
+
+            ds = gdaltest.tiff_drv.CreateCopy('tmp/tiff_write_105_ref.tif', src_ds, options = options)
+            ds = None
+            ds = gdaltest.tiff_drv.CreateCopy('tmp/tiff_write_105.tif', src_ds, options = options + [ 'NUM_THREADS=4' ])
+            ds = None
+
+            # Also write the blocks through the block cache, band per band
+            ds = gdaltest.tiff_drv.Create('tmp/tiff_write_105_create.tif', src_ds.RasterXSize, src_ds.RasterYSize, src_ds.RasterCount, options = options + [ 'NUM_THREADS=4' ])
+            for i in range(src_ds.RasterCount):
+                ds.GetRasterBand(i+1).WriteRaster(0, 0, src_ds.RasterXSize, src_ds.RasterYSize,
+                                                  src_ds.GetRasterBand(i+1).ReadRaster(0, 0, src_ds.RasterXSize, src_ds.RasterYSize))
+            ds = None
+
+            ref_data = open('tmp/tiff_write_105_ref.tif', 'rb').read()
+            data = open('tmp/tiff_write_105.tif', 'rb').read()
+            if data != ref_data:
+                gdaltest.post_reason('threaded CreateCopy differs from serial one with %s' % str(options))
+                return 'fail'
+
+            ref_ds = gdal.Open('tmp/tiff_write_105_ref.tif')
+            ds = gdal.Open('tmp/tiff_write_105_create.tif')
+            for i in range(src_ds.RasterCount):
+                if ds.GetRasterBand(i+1).Checksum() != ref_ds.GetRasterBand(i+1).Checksum():
+                    gdaltest.post_reason('threaded Create() gives wrong checksum with %s' % str(options))
+                    return 'fail'
+            ds = None
+            ref_ds = None
+
+    gdaltest.tiff_drv.Delete('tmp/tiff_write_105_ref.tif')
+    gdaltest.tiff_drv.Delete('tmp/tiff_write_105.tif')
+    gdaltest.tiff_drv.Delete('tmp/tiff_write_105_create.tif')
+
+    return 'success'
+
 ###############################################################################
 def tiff_write_cleanup():
     gdaltest.tiff_drv = None
@@ -4246,6 +4294,7 @@ gdaltest_list = [
     tiff_write_102,
     tiff_write_103,
     tiff_write_104,
+    tiff_write_105,
     tiff_write_cleanup ]
 
 if __name__ == '__main__':
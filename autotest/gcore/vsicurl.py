@@ -30,6 +30,8 @@
 
 import os
 import sys
+import array
+import shutil
 from osgeo import gdal
 from osgeo import ogr
 from sys import version_info
@@ -37,6 +39,7 @@ from sys import version_info
 sys.path.append( '../pymod' )
 
 import gdaltest
+import test_cli_utilities
 
 ###############################################################################
 #
@@ -286,6 +289,329 @@ def vsicurl_11():
 
     return 'success'
 
+###############################################################################
+# Helpers for the tests against the local web server of ../pymod/webserver.py,
+# that serves the files of this directory under /files/ with byte ranges.
+
+def vsicurl_launch_webserver():
+
+    try:
+        drv = gdal.GetDriverByName( 'HTTP' )
+    except:
+        drv = None
+
+    if drv is None:
+        return (None, 0)
+
+    import webserver
+    return webserver.launch()
+
+def vsicurl_stop_webserver(process, port):
+
+    import webserver
+    webserver.server_stop(process, port)
+
+def vsicurl_file_request_count(port):
+
+    handle = gdaltest.gdalurlopen('http://127.0.0.1:%d/file_request_count' % port)
+    return int(handle.read())
+
+def vsicurl_create_tiled_file(filename, offset = 0):
+
+    ds = gdal.GetDriverByName('GTiff').Create(filename, 600, 500, 3,
+                                              options = [ 'TILED=YES', 'BLOCKXSIZE=64',
+                                                          'BLOCKYSIZE=64', 'INTERLEAVE=BAND',
+                                                          'COMPRESS=DEFLATE' ])
+    for i in range(3):
+        data = array.array('B', [ (x * 7 + y * 13 + x * y + i * 31 + offset) % 251
+                                  for y in range(500) for x in range(600) ])
+        ds.GetRasterBand(i+1).WriteRaster(0, 0, 600, 500, data.tostring())
+    ds = None
+
+def vsicurl_checksums(filename, env = {}):
+
+    for key in env:
+        os.environ[key] = env[key]
+    ret = gdaltest.runexternal(test_cli_utilities.get_gdalinfo_path() + ' -checksum ' + filename)
+    for key in env:
+        del os.environ[key]
+
+    checksums = []
+    for line in ret.split('\n'):
+        pos = line.find('Checksum=')
+        if pos >= 0:
+            checksums.append(int(line[pos + len('Checksum='):]))
+    return checksums
+
+###############################################################################
+# Test reading a tiled GeoTIFF file, whose blocks are prefetched with
+# GDAL_NUM_THREADS by concurrent range requests, and large reads split into
+# concurrent downloads, with various merge gaps and connection counts.
+
+def vsicurl_12():
+
+    # A copy of the files for each case, so that nothing is cached
+    options = [ [],
+                [ ('GDAL_NUM_THREADS', '2') ],
+                [ ('GDAL_NUM_THREADS', '2'),
+                  ('CPL_VSIL_CURL_MERGE_GAP', '0') ],
+                [ ('GDAL_NUM_THREADS', '2'),
+                  ('CPL_VSIL_CURL_MAX_CONNECTIONS', '1') ],
+                [ ('GDAL_NUM_THREADS', '2'),
+                  ('CPL_VSIL_CURL_MAX_CONNECTIONS', '3'),
+                  ('CPL_VSIL_CURL_MERGE_GAP', '1000000'),
+                  ('CPL_VSIL_CURL_MAX_READAHEAD', '100000') ] ]
+
+    vsicurl_create_tiled_file('tmp/vsicurl_12.tif')
+    ref_ds = gdal.Open('tmp/vsicurl_12.tif')
+    ref_data = ref_ds.ReadRaster(0, 0, 600, 500)
+    ref_window = ref_ds.ReadRaster(70, 130, 400, 300)
+    # Blocks far apart from each other in the file
+    ref_column = ref_ds.GetRasterBand(2).ReadRaster(0, 0, 100, 500)
+    ref_ds = None
+
+    content = os.urandom(3 * 1024 * 1024 + 1000)
+    for i in range(len(options)):
+        shutil.copy('tmp/vsicurl_12.tif', 'tmp/vsicurl_12_%d.tif' % i)
+        f = open('tmp/vsicurl_12_%d.bin' % i, 'wb')
+        f.write(content)
+        f.close()
+
+    (process, port) = vsicurl_launch_webserver()
+    if port == 0:
+        ret = 'skip'
+    else:
+        ret = 'success'
+
+    for i in range(len(options)):
+        if ret != 'success':
+            break
+
+        for (key, value) in options[i]:
+            gdal.SetConfigOption(key, value)
+
+        url = '/vsicurl/http://127.0.0.1:%d/files/tmp/vsicurl_12_%d.tif' % (port, i)
+        ds = gdal.Open(url)
+        if ds is None:
+            gdaltest.post_reason('cannot open %s' % url)
+            ret = 'fail'
+        else:
+            if ds.GetRasterBand(2).ReadRaster(0, 0, 100, 500) != ref_column:
+                gdaltest.post_reason('wrong column with %s' % str(options[i]))
+                ret = 'fail'
+            if ds.ReadRaster(70, 130, 400, 300) != ref_window:
+                gdaltest.post_reason('wrong window with %s' % str(options[i]))
+                ret = 'fail'
+            if ds.ReadRaster(0, 0, 600, 500) != ref_data:
+                gdaltest.post_reason('wrong data with %s' % str(options[i]))
+                ret = 'fail'
+            ds = None
+
+        url = '/vsicurl/http://127.0.0.1:%d/files/tmp/vsicurl_12_%d.bin' % (port, i)
+        f = gdal.VSIFOpenL(url, 'rb')
+        if f is None:
+            gdaltest.post_reason('cannot open %s' % url)
+            ret = 'fail'
+        else:
+            gdal.VSIFSeekL(f, 1500000, 0)
+            if gdal.VSIFReadL(1, 100000, f) != content[1500000:1600000]:
+                gdaltest.post_reason('wrong range with %s' % str(options[i]))
+                ret = 'fail'
+            gdal.VSIFSeekL(f, 0, 0)
+            if gdal.VSIFReadL(1, len(content), f) != content:
+                gdaltest.post_reason('wrong content with %s' % str(options[i]))
+                ret = 'fail'
+            gdal.VSIFCloseL(f)
+
+        for (key, value) in options[i]:
+            gdal.SetConfigOption(key, None)
+
+    if port != 0:
+        vsicurl_stop_webserver(process, port)
+
+    gdal.GetDriverByName('GTiff').Delete('tmp/vsicurl_12.tif')
+    for i in range(len(options)):
+        os.unlink('tmp/vsicurl_12_%d.tif' % i)
+        os.unlink('tmp/vsicurl_12_%d.bin' % i)
+
+    return ret
+
+###############################################################################
+# Test that the region cache serves data read again without new requests, and
+# that a region cache much smaller than the file still gives the right data.
+
+def vsicurl_13():
+
+    vsicurl_create_tiled_file('tmp/vsicurl_13.tif')
+    expected = vsicurl_checksums('tmp/vsicurl_13.tif')
+    for i in range(1, 3):
+        shutil.copy('tmp/vsicurl_13.tif', 'tmp/vsicurl_13_%d.tif' % i)
+
+    (process, port) = vsicurl_launch_webserver()
+    if port == 0:
+        gdal.GetDriverByName('GTiff').Delete('tmp/vsicurl_13.tif')
+        for i in range(1, 3):
+            os.unlink('tmp/vsicurl_13_%d.tif' % i)
+        return 'skip'
+
+    ret = 'success'
+    url = '/vsicurl/http://127.0.0.1:%d/files/tmp/vsicurl_13' % port
+
+    ds = gdal.Open(url + '.tif')
+    data = ds.ReadRaster(0, 0, 600, 500)
+    ds = None
+    count = vsicurl_file_request_count(port)
+    ds = gdal.Open(url + '.tif')
+    if ds.ReadRaster(0, 0, 600, 500) != data:
+        gdaltest.post_reason('wrong data when read from the cache')
+        ret = 'fail'
+    ds = None
+    if vsicurl_file_request_count(port) != count:
+        gdaltest.post_reason('data read again was not served from the cache')
+        ret = 'fail'
+
+    # The minimum cache size of one chunk, and a few chunks
+    got = vsicurl_checksums(url + '_1.tif', { 'CPL_VSIL_CURL_CACHE_SIZE' : '1' })
+    if got != expected:
+        gdaltest.post_reason('wrong checksums with a tiny region cache')
+        print(got)
+        ret = 'fail'
+
+    got = vsicurl_checksums(url + '_2.tif', { 'CPL_VSIL_CURL_CACHE_SIZE' : '100000' })
+    if got != expected:
+        gdaltest.post_reason('wrong checksums with a small region cache')
+        print(got)
+        ret = 'fail'
+
+    vsicurl_stop_webserver(process, port)
+
+    gdal.GetDriverByName('GTiff').Delete('tmp/vsicurl_13.tif')
+    for i in range(1, 3):
+        os.unlink('tmp/vsicurl_13_%d.tif' % i)
+
+    return ret
+
+###############################################################################
+# Test the persistent disk cache of CPL_VSIL_CURL_USE_CACHE: data is served
+# from it by later processes, also when its journal is torn or missing, it
+# is not used once the remote file has changed, and it is kept under
+# CPL_VSIL_CURL_CACHE_DISK_SIZE.
+
+def vsicurl_14():
+
+    cache_dir = 'tmp/vsicurl_14_cache'
+    env = { 'CPL_VSIL_CURL_USE_CACHE' : 'YES',
+            'CPL_VSIL_CURL_CACHE_DIR' : cache_dir }
+
+    vsicurl_create_tiled_file('tmp/vsicurl_14.tif')
+    expected = vsicurl_checksums('tmp/vsicurl_14.tif')
+    vsicurl_create_tiled_file('tmp/vsicurl_14_1.tif', 1)
+    expected_1 = vsicurl_checksums('tmp/vsicurl_14_1.tif')
+
+    (process, port) = vsicurl_launch_webserver()
+    if port == 0:
+        gdal.GetDriverByName('GTiff').Delete('tmp/vsicurl_14.tif')
+        gdal.GetDriverByName('GTiff').Delete('tmp/vsicurl_14_1.tif')
+        return 'skip'
+
+    url = '/vsicurl/http://127.0.0.1:%d/files/tmp/vsicurl_14' % port
+
+    ret = 'success'
+
+    got = vsicurl_checksums(url + '.tif', env)
+    if got != expected:
+        gdaltest.post_reason('wrong checksums')
+        print(got)
+        ret = 'fail'
+
+    for step in [ 'unchanged', 'torn journal', 'missing journal' ]:
+        if step == 'torn journal':
+            f = open(cache_dir + '/index.log', 'ab')
+            f.write('A 12/3456'.encode('ascii'))
+            f.close()
+        elif step == 'missing journal':
+            os.unlink(cache_dir + '/index.log')
+
+        count = vsicurl_file_request_count(port)
+        got = vsicurl_checksums(url + '.tif', env)
+        if got != expected:
+            gdaltest.post_reason('wrong checksums from the disk cache (%s)' % step)
+            print(got)
+            ret = 'fail'
+        if vsicurl_file_request_count(port) != count:
+            gdaltest.post_reason('data was not served from the disk cache (%s)' % step)
+            ret = 'fail'
+
+    # Change the remote file, keeping its size
+    st = os.stat('tmp/vsicurl_14.tif')
+    shutil.copy('tmp/vsicurl_14_1.tif', 'tmp/vsicurl_14.tif')
+    os.utime('tmp/vsicurl_14.tif', (st.st_atime + 10, st.st_mtime + 10))
+    got = vsicurl_checksums(url + '.tif', env)
+    if got != expected_1:
+        gdaltest.post_reason('stale chunks were served from the disk cache')
+        print(got)
+        ret = 'fail'
+
+    # Records appended by other processes are merged when the journal
+    # gets long enough to be compacted
+    f = open(cache_dir + '/index.log', 'ab')
+    for i in range(3000):
+        f.write('U 00/00000000_0 $\n'.encode('ascii'))
+    f.close()
+    got = vsicurl_checksums(url + '.tif', env)
+    if got != expected_1:
+        gdaltest.post_reason('wrong checksums after compaction')
+        print(got)
+        ret = 'fail'
+
+    chunks = []
+    for (dirpath, dirnames, filenames) in os.walk(cache_dir):
+        if dirpath != cache_dir:
+            for filename in filenames:
+                chunks.append(os.path.basename(dirpath) + '/' + filename)
+    f = open(cache_dir + '/index.log', 'rb')
+    lines = f.read().decode('ascii').split('\n')
+    f.close()
+    records = sorted([ line.split(' ')[1] for line in lines if line.startswith('A ') ])
+    if not lines[0].startswith('G ') or len(lines) > 1000 or \
+       records != sorted(chunks):
+        gdaltest.post_reason('journal not compacted')
+        print(lines[0])
+        print(len(lines))
+        ret = 'fail'
+    if sorted(os.listdir(cache_dir))[-1] != 'index.log':
+        gdaltest.post_reason('lock or temporary file left behind')
+        print(os.listdir(cache_dir))
+        ret = 'fail'
+
+    # Chunk files missing from the journal, for example because records
+    # were appended by another process during a compaction, are still
+    # evicted to bound the cache size
+    open(cache_dir + '/index.log', 'wb').close()
+    env['CPL_VSIL_CURL_CACHE_DISK_SIZE'] = '200000'
+    got = vsicurl_checksums(url + '_1.tif', env)
+    if got != expected_1:
+        gdaltest.post_reason('wrong checksums with a small disk cache')
+        print(got)
+        ret = 'fail'
+
+    size = 0
+    for (dirpath, dirnames, filenames) in os.walk(cache_dir):
+        for filename in filenames:
+            if filename != 'index.log':
+                size = size + os.stat(os.path.join(dirpath, filename)).st_size
+    if size == 0 or size > 200000:
+        gdaltest.post_reason('disk cache size is %d' % size)
+        ret = 'fail'
+
+    vsicurl_stop_webserver(process, port)
+
+    gdal.GetDriverByName('GTiff').Delete('tmp/vsicurl_14.tif')
+    gdal.GetDriverByName('GTiff').Delete('tmp/vsicurl_14_1.tif')
+    shutil.rmtree(cache_dir)
+
+    return ret
+
 gdaltest_list = [ vsicurl_1,
                   vsicurl_2,
                   vsicurl_3,
@@ -296,7 +622,10 @@ gdaltest_list = [ vsicurl_1,
                   vsicurl_8,
                   vsicurl_9,
                   vsicurl_10,
-                  vsicurl_11 ]
+                  vsicurl_11,
+                  vsicurl_12,
+                  vsicurl_13,
+                  vsicurl_14 ]
 
 if __name__ == '__main__':
 
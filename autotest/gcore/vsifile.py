@@ -136,9 +136,246 @@ def vsifile_3():
 
     return 'success'
 
+###############################################################################
+# Test /vsicache/ : random reads of several files, through several handles,
+# with a cache much smaller than the files so that chunks get evicted.
+
+def vsifile_4():
+
+    import random
+
+    rnd = random.Random(4)
+    files = {}
+    for i in range(2):
+        filename = 'tmp/vsifile_4_%d.bin' % i
+        data = ''.join([chr(rnd.randint(0, 255)) for j in range(100000 + i * 777)])
+        fp = open(filename, 'wb')
+        fp.write(data)
+        fp.close()
+        files[filename] = data
+
+    gdal.SetConfigOption('VSI_CACHE_CHUNK_SIZE', '1000')
+    gdal.SetConfigOption('VSI_CACHE_SIZE', '20000')
+
+    handles = []
+    for filename in files:
+        handles.append((filename, gdal.VSIFOpenL('/vsicache/' + filename, 'rb')))
+        handles.append((filename, gdal.VSIFOpenL('/vsicache/' + filename, 'rb')))
+
+    gdal.SetConfigOption('VSI_CACHE_CHUNK_SIZE', None)
+    gdal.SetConfigOption('VSI_CACHE_SIZE', None)
+
+    ret = 'success'
+    for i in range(2000):
+        (filename, fp) = handles[rnd.randint(0, len(handles) - 1)]
+        data = files[filename]
+        offset = rnd.randint(0, len(data) + 10)
+        size = rnd.randint(1, 5000)
+        gdal.VSIFSeekL(fp, offset, 0)
+        got = gdal.VSIFReadL(1, size, fp)
+        if got != data[offset:offset + size]:
+            gdaltest.post_reason('wrong data read at %d' % offset)
+            ret = 'fail'
+            break
+
+    for (filename, fp) in handles:
+        gdal.VSIFCloseL(fp)
+
+    statBuf = gdal.VSIStatL('/vsicache/tmp/vsifile_4_1.bin')
+    if ret == 'success' and (statBuf is None or statBuf.size != 100777):
+        gdaltest.post_reason('wrong file size')
+        ret = 'fail'
+
+    for filename in files:
+        gdal.Unlink(filename)
+
+    return ret
+
+###############################################################################
+# Test the seek index of /vsigzip/ (CPL_VSIL_GZIP_SEEK_INDEX) : written by a
+# full read, used by later opens, and rebuilt when out of date or corrupted.
+
+def vsifile_gzip_create(filename, seed):
+
+    import gzip
+    import random
+
+    rnd = random.Random(seed)
+    data = ''.join(['%d,%d,%d\n' % (i, rnd.randint(0, 1000000), rnd.randint(0, 100))
+                    for i in range(150000)])
+    fp = gzip.open(filename, 'wb')
+    fp.write(data)
+    fp.close()
+    return data
+
+def vsifile_gzip_random_reads(filename, data, seed):
+
+    import random
+
+    rnd = random.Random(seed)
+    fp = gdal.VSIFOpenL('/vsigzip/' + filename, 'rb')
+    if fp is None:
+        return False
+    ret = True
+    for i in range(200):
+        offset = rnd.randint(0, len(data))
+        size = rnd.randint(1, 5000)
+        gdal.VSIFSeekL(fp, offset, 0)
+        if gdal.VSIFReadL(1, size, fp) != data[offset:offset + size]:
+            print('wrong data read at %d' % offset)
+            ret = False
+            break
+    gdal.VSIFCloseL(fp)
+    return ret
+
+def vsifile_gzip_read_all(filename):
+
+    fp = gdal.VSIFOpenL('/vsigzip/' + filename, 'rb')
+    data = gdal.VSIFReadL(1, 10000000, fp)
+    gdal.VSIFCloseL(fp)
+    return data
+
+def vsifile_gzip_read_file(filename):
+
+    fp = open(filename, 'rb')
+    data = fp.read()
+    fp.close()
+    return data
+
+def vsifile_gzip_write_file(filename, data):
+
+    fp = open(filename, 'wb')
+    fp.write(data)
+    fp.close()
+
+def vsifile_5():
+
+    import struct
+
+    filename = 'tmp/vsifile_5.gz'
+    other_filename = 'tmp/vsifile_5_other.gz'
+    index_filename = filename + '.idx'
+
+    data = vsifile_gzip_create(filename, 5)
+    other_data = vsifile_gzip_create(other_filename, 55)
+
+    gdal.SetConfigOption('CPL_VSIL_GZIP_SEEK_INDEX', 'YES')
+    gdal.SetConfigOption('CPL_VSIL_GZIP_SEEK_INDEX_SPACING', '100000')
+
+    ret = 'success'
+
+    # A full read writes the index
+    if ret == 'success' and vsifile_gzip_read_all(filename) != data:
+        gdaltest.post_reason('wrong data')
+        ret = 'fail'
+    if ret == 'success' and not os.path.exists(index_filename):
+        gdaltest.post_reason('index not written')
+        ret = 'fail'
+
+    if ret == 'success':
+        index = vsifile_gzip_read_file(index_filename)
+        (table_offset, points) = struct.unpack('<QI', index[-16:-4])
+        outs = [ struct.unpack('<Q', index[table_offset + i * 48 + 16:table_offset + i * 48 + 24])[0]
+                 for i in range(points) ]
+        if points < 5:
+            gdaltest.post_reason('too few access points')
+            print(points)
+            ret = 'fail'
+
+    # Random reads from a new handle use it, without rewriting it
+    if ret == 'success':
+        # Evict the handle of the last opened .gz file, and its snapshots
+        if vsifile_gzip_read_all(other_filename) != other_data:
+            gdaltest.post_reason('wrong data')
+            ret = 'fail'
+        elif not vsifile_gzip_random_reads(filename, data, 1):
+            gdaltest.post_reason('wrong data with the index')
+            ret = 'fail'
+        elif vsifile_gzip_read_file(index_filename) != index:
+            gdaltest.post_reason('index rewritten')
+            ret = 'fail'
+
+    # Check that the index is actually used, by damaging the windows of its
+    # access points, which are not covered by the CRC of the table
+    if ret == 'success':
+        vsifile_gzip_write_file(index_filename, 'x' * table_offset + index[table_offset:])
+        vsifile_gzip_read_all(other_filename)
+        fp = gdal.VSIFOpenL('/vsigzip/' + filename, 'rb')
+        offset = outs[points // 2] + 1000
+        gdal.VSIFSeekL(fp, offset, 0)
+        got = gdal.VSIFReadL(1, 1000, fp)
+        gdal.VSIFCloseL(fp)
+        if got == data[offset:offset + 1000]:
+            gdaltest.post_reason('index not used')
+            ret = 'fail'
+        vsifile_gzip_write_file(index_filename, index)
+
+    # A corrupted index is ignored, and rebuilt by the next full read
+    if ret == 'success':
+        vsifile_gzip_write_file(index_filename, index[0:len(index) // 2])
+        vsifile_gzip_read_all(other_filename)
+        if not vsifile_gzip_random_reads(filename, data, 2):
+            gdaltest.post_reason('wrong data with a corrupted index')
+            ret = 'fail'
+        elif vsifile_gzip_read_all(filename) != data:
+            gdaltest.post_reason('wrong data')
+            ret = 'fail'
+        elif vsifile_gzip_read_file(index_filename) != index:
+            gdaltest.post_reason('index not rebuilt')
+            ret = 'fail'
+
+    # An index announcing more access points than the .gz file can hold,
+    # with a table offset chosen so that the sizes add up modulo 2^64
+    if ret == 'success':
+        huge_points = 0x10000000
+        table_offset = (len(index) - 48 - huge_points * 48) % (1 << 64)
+        vsifile_gzip_write_file(index_filename, index[0:-48] + index[-48:-16] +
+                                struct.pack('<QII', table_offset, huge_points, 0))
+        vsifile_gzip_read_all(other_filename)
+        if not vsifile_gzip_random_reads(filename, data, 5):
+            gdaltest.post_reason('wrong data with an index with too many points')
+            ret = 'fail'
+        elif vsifile_gzip_read_all(filename) != data:
+            gdaltest.post_reason('wrong data')
+            ret = 'fail'
+        elif vsifile_gzip_read_file(index_filename) != index:
+            gdaltest.post_reason('index not rebuilt')
+            ret = 'fail'
+
+    # The index of a replaced .gz file is out of date
+    if ret == 'success':
+        data = vsifile_gzip_create(filename, 6)
+        st = os.stat(filename)
+        os.utime(filename, (st.st_atime, st.st_mtime + 10))
+        vsifile_gzip_read_all(other_filename)
+        if not vsifile_gzip_random_reads(filename, data, 3):
+            gdaltest.post_reason('wrong data with an out of date index')
+            ret = 'fail'
+        elif vsifile_gzip_read_all(filename) != data:
+            gdaltest.post_reason('wrong data')
+            ret = 'fail'
+        elif vsifile_gzip_read_file(index_filename) == index:
+            gdaltest.post_reason('index not rebuilt')
+            ret = 'fail'
+        elif not vsifile_gzip_random_reads(filename, data, 4):
+            gdaltest.post_reason('wrong data with the rebuilt index')
+            ret = 'fail'
+
+    gdal.SetConfigOption('CPL_VSIL_GZIP_SEEK_INDEX', None)
+    gdal.SetConfigOption('CPL_VSIL_GZIP_SEEK_INDEX_SPACING', None)
+
+    for name in [ filename, other_filename ]:
+        for ext in [ '', '.idx', '.properties' ]:
+            if os.path.exists(name + ext):
+                os.unlink(name + ext)
+
+    return ret
+
 gdaltest_list = [ vsifile_1,
                   vsifile_2,
-                  vsifile_3 ]
+                  vsifile_3,
+                  vsifile_4,
+                  vsifile_5 ]
 
 if __name__ == '__main__':
 
@@ -35,6 +35,8 @@ except:
     from http.server import BaseHTTPRequestHandler, HTTPServer
 from threading import Thread
 
+import os
+import re
 import time
 import sys
 import gdaltest
@@ -45,11 +47,82 @@ class GDAL_Handler(BaseHTTPRequestHandler):
     def log_request(self, code='-', size='-'):
         return
 
+    # Serve the files of the test directory under /files/, with support
+    # for HEAD requests and byte ranges, as used by /vsicurl/.
+    def send_file(self, head):
+
+        filename = self.path[len('/files/'):]
+        if filename.find('..') >= 0 or not os.path.isfile(filename):
+            # Not send_error(), as the side car files looked for when
+            # opening a dataset are expected to be missing
+            self.send_response(404)
+            self.send_header('Content-Length', '0')
+            self.end_headers()
+            return
+
+        f = open(filename, 'rb')
+        content = f.read()
+        f.close()
+        st = os.stat(filename)
+
+        range_header = self.headers.get('Range')
+        if range_header is None:
+            self.send_response(200)
+        else:
+            m = re.match('bytes=([0-9]+)-([0-9]*)', range_header)
+            start = int(m.group(1))
+            end = len(content) - 1
+            if m.group(2) != '':
+                end = min(end, int(m.group(2)))
+            if start >= len(content):
+                self.send_response(416)
+                self.send_header('Content-Range', 'bytes */%d' % len(content))
+                self.send_header('Content-Length', '0')
+                self.end_headers()
+                return
+            self.send_response(206)
+            self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, end, len(content)))
+            content = content[start:end+1]
+
+        if not head:
+            self.server.file_request_count = self.server.file_request_count + 1
+        self.send_header('Content-Length', str(len(content)))
+        self.send_header('Accept-Ranges', 'bytes')
+        self.send_header('ETag', '"%x-%x"' % (st.st_size, int(st.st_mtime * 1000000)))
+        self.send_header('Last-Modified', self.date_time_string(int(st.st_mtime)))
+        self.end_headers()
+        if not head:
+            self.wfile.write(content)
+
+    def do_HEAD(self):
+
+        if self.path.startswith('/files/'):
+            self.send_file(True)
+            return
+
+        self.send_response(404)
+        self.send_header('Content-Length', '0')
+        self.end_headers()
+
     def do_GET(self):
 
         try:
             #print(self.path)
 
+            if self.path.startswith('/files/'):
+                self.send_file(False)
+                return
+
+            # Number of GET requests of files served so far
+            if self.path == '/file_request_count':
+                content = ('%d' % self.server.file_request_count).encode('ascii')
+                self.send_response(200)
+                self.send_header('Content-type', 'text/plain')
+                self.send_header('Content-Length', str(len(content)))
+                self.end_headers()
+                self.wfile.write(content)
+                return
+
             if self.path == '/shutdown':
                 self.send_response(200)
                 self.send_header('Content-type', 'text/html')
@@ -108,6 +181,7 @@ class GDAL_HttpServer(HTTPServer):
         HTTPServer.__init__(self, server_address, handlerClass)
         self.running = False
         self.stop_requested = False
+        self.file_request_count = 0
 
     def is_running(self):
         return self.running
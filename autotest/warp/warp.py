@@ -33,6 +33,7 @@
 import os
 import sys
 import shutil
+import struct
 
 sys.path.append( '../pymod' )
 
@@ -857,6 +858,221 @@ def warp_27():
 
     return 'success'
 
+###############################################################################
+# Test that splitting the rows of the warp kernel across worker threads
+# (NUM_THREADS warp option) gives the same result as a serial warp.
+
+def warp_28():
+
+    if test_cli_utilities.get_gdal_translate_path() is None:
+        return 'skip'
+
+    if test_cli_utilities.get_gdalwarp_path() is None:
+        return 'skip'
+
+    gdaltest.runexternal(test_cli_utilities.get_gdal_translate_path() + ' -of VRT ../gcore/data/utmsmall.tif tmp/warp_28_gcp.vrt -gcp 0 0 0 100 -gcp 100 0 110 95 -gcp 0 100 -5 0 -gcp 100 100 100 -10 -gcp 50 50 45 52')
+
+    for resampling in [ 'near', 'bilinear', 'cubic', 'cubicspline', 'lanczos' ]:
+
+        for num_threads in [ '1', '4' ]:
+            try:
+                os.remove('tmp/warp_28_%s.tif' % num_threads)
+            except:
+                pass
+            gdaltest.runexternal(test_cli_utilities.get_gdalwarp_path() + ' -tps -ts 150 150 -r %s -wo NUM_THREADS=%s tmp/warp_28_gcp.vrt tmp/warp_28_%s.tif' % (resampling, num_threads, num_threads))
+
+        ds_ref = gdal.Open('tmp/warp_28_1.tif')
+        ds = gdal.Open('tmp/warp_28_4.tif')
+        if ds_ref is None or ds is None:
+            gdaltest.post_reason('warp failed')
+            return 'fail'
+        data_ref = ds_ref.ReadRaster(0, 0, ds_ref.RasterXSize, ds_ref.RasterYSize)
+        data = ds.ReadRaster(0, 0, ds.RasterXSize, ds.RasterYSize)
+        cs = ds.GetRasterBand(1).Checksum()
+        ds_ref = None
+        ds = None
+
+        if cs == 0:
+            gdaltest.post_reason('empty warp result with -r %s' % resampling)
+            return 'fail'
+
+        if data != data_ref:
+            gdaltest.post_reason('threaded warp differs from serial warp with -r %s' % resampling)
+            return 'fail'
+
+    os.remove('tmp/warp_28_gcp.vrt')
+    os.remove('tmp/warp_28_1.tif')
+    os.remove('tmp/warp_28_4.tif')
+
+    return 'success'
+
+###############################################################################
+# Compare the specialized Byte and Int16 bilinear, cubic and cubic spline
+# kernels, which use SSE2 when available, with the generic kernel selected
+# by a Float32 working data type. The generic kernel does not flip the
+# filter over the edges of the source image, so only the interior is
+# compared.
+
+def warp_29():
+
+    for alg in [ 'blinear', 'cubic', 'cubicspline' ]:
+        for (suffix, working_type) in [ ('', 'Byte'), ('_short', 'Int16') ]:
+            vrt = open('data/utmsmall_%s%s.vrt' % (alg, suffix), 'rt').read()
+            vrt = vrt.replace('<WorkingDataType>%s<' % working_type,
+                              '<WorkingDataType>Float32<')
+            open('tmp/warp_29.vrt', 'wt').write(vrt)
+
+            ds = gdal.Open('data/utmsmall_%s%s.vrt' % (alg, suffix))
+            ref_ds = gdal.Open('tmp/warp_29.vrt')
+            maxdiff = gdaltest.compare_ds(ds, ref_ds, 12, 12, 476, 476, verbose = 0)
+            ds = None
+            ref_ds = None
+
+            if maxdiff > 1:
+                gdaltest.post_reason('specialized %s %s kernel differs from generic kernel' % (alg, working_type))
+                return 'fail'
+
+    os.remove('tmp/warp_29.vrt')
+
+    return 'success'
+
+###############################################################################
+# Compare the precomputed weights of the generic cubic spline kernel with
+# the weights computed on the fly by the specialized Byte kernel, when
+# downsampling (single row of weights) and upsampling (one row per
+# subpixel phase).
+
+def warp_30():
+
+    for name in [ 'utmsmall_ds_cubicspline', 'utmsmall_cubicspline' ]:
+        vrt = open('data/%s.vrt' % name, 'rt').read()
+        vrt = vrt.replace('<WorkingDataType>Byte<', '<WorkingDataType>Float32<')
+        open('tmp/warp_30.vrt', 'wt').write(vrt)
+
+        ds = gdal.Open('data/%s.vrt' % name)
+        ref_ds = gdal.Open('tmp/warp_30.vrt')
+        if ds.RasterXSize > 100:
+            maxdiff = gdaltest.compare_ds(ds, ref_ds, 12, 12, ds.RasterXSize - 24, ds.RasterYSize - 24, verbose = 0)
+        else:
+            maxdiff = gdaltest.compare_ds(ds, ref_ds, verbose = 0)
+        ds = None
+        ref_ds = None
+
+        if maxdiff > 1:
+            gdaltest.post_reason('precomputed weights differ from direct computation for %s' % name)
+            return 'fail'
+
+    os.remove('tmp/warp_30.vrt')
+
+    return 'success'
+
+###############################################################################
+# Test that warping several chunks concurrently (-multi with the
+# MULTI_CHUNK_COUNT warp option) gives the same result as warping them one
+# after the other. With N chunks in flight, each chunk gets 2/N of the warp
+# memory, so the memory limit is scaled to keep the same chunks.
+
+def warp_31():
+
+    if test_cli_utilities.get_gdal_translate_path() is None:
+        return 'skip'
+
+    if test_cli_utilities.get_gdalwarp_path() is None:
+        return 'skip'
+
+    gdaltest.runexternal(test_cli_utilities.get_gdal_translate_path() + ' -of VRT ../gcore/data/utmsmall.tif tmp/warp_31_gcp.vrt -gcp 0 0 0 100 -gcp 100 0 110 95 -gcp 0 100 -5 0 -gcp 100 100 100 -10 -gcp 50 50 45 52')
+
+    gdaltest.runexternal(test_cli_utilities.get_gdalwarp_path() + ' -et 0 -tps -ts 1000 1000 -r bilinear -wm 0.1 tmp/warp_31_gcp.vrt tmp/warp_31_ref.tif')
+    ds_ref = gdal.Open('tmp/warp_31_ref.tif')
+    data_ref = ds_ref.ReadRaster(0, 0, ds_ref.RasterXSize, ds_ref.RasterYSize)
+    ds_ref = None
+
+    for (count, wm) in [ (2, '0.1'), (4, '0.2'), (8, '0.4') ]:
+        try:
+            os.remove('tmp/warp_31.tif')
+        except:
+            pass
+        gdaltest.runexternal(test_cli_utilities.get_gdalwarp_path() + ' -et 0 -tps -ts 1000 1000 -r bilinear -multi -wm %s -wo MULTI_CHUNK_COUNT=%d tmp/warp_31_gcp.vrt tmp/warp_31.tif' % (wm, count))
+
+        ds = gdal.Open('tmp/warp_31.tif')
+        if ds is None:
+            gdaltest.post_reason('warp failed')
+            return 'fail'
+        data = ds.ReadRaster(0, 0, ds.RasterXSize, ds.RasterYSize)
+        ds = None
+
+        if data != data_ref:
+            gdaltest.post_reason('warp with %d chunks in flight differs from serial warp' % count)
+            return 'fail'
+
+    os.remove('tmp/warp_31_gcp.vrt')
+    os.remove('tmp/warp_31_ref.tif')
+    os.remove('tmp/warp_31.tif')
+
+    return 'success'
+
+###############################################################################
+# Test the grid mode of the approximate transformer (GDAL_APPROX_GRID_CELL_SIZE).
+# The source bands hold the pixel and line coordinates of the pixel centers,
+# so that bilinear resampling gives the source coordinates computed by the
+# transformer. They must not be further than the error threshold from the
+# exact ones.
+
+def warp_32():
+
+    if test_cli_utilities.get_gdalwarp_path() is None:
+        return 'skip'
+
+    ds = gdal.GetDriverByName('GTiff').Create('tmp/warp_32_src.tif', 100, 100, 2, gdal.GDT_Float32)
+    ds.GetRasterBand(1).WriteRaster(0, 0, 100, 100,
+        struct.pack('f' * 10000, *[ (i % 100) + 0.5 for i in range(10000) ]))
+    ds.GetRasterBand(2).WriteRaster(0, 0, 100, 100,
+        struct.pack('f' * 10000, *[ (i // 100) + 0.5 for i in range(10000) ]))
+    gcps = []
+    for (pixel, line, x, y) in [ (0, 0, 0, 100), (100, 0, 100, 100),
+                                 (0, 100, 0, 0), (100, 100, 100, 0),
+                                 (50, 50, 45, 55), (50, 0, 50, 97),
+                                 (0, 50, 3, 50) ]:
+        gcps.append(gdal.GCP(x, y, 0, pixel, line))
+    ds.SetGCPs(gcps, '')
+    ds = None
+
+    results = []
+    for options in [ '-et 0',
+                     '-et 0.125 --config GDAL_APPROX_GRID_CELL_SIZE 64',
+                     '-et 0.125 --config GDAL_APPROX_GRID_CELL_SIZE 400' ]:
+        try:
+            os.remove('tmp/warp_32.tif')
+        except:
+            pass
+        gdaltest.runexternal(test_cli_utilities.get_gdalwarp_path() + ' %s -order 2 -te 10 10 90 90 -ts 400 400 -r bilinear tmp/warp_32_src.tif tmp/warp_32.tif' % options)
+
+        ds = gdal.Open('tmp/warp_32.tif')
+        if ds is None:
+            gdaltest.post_reason('warp failed')
+            return 'fail'
+        result = []
+        for i in range(2):
+            data = ds.GetRasterBand(i + 1).ReadRaster(0, 0, 400, 400)
+            result.append(struct.unpack('f' * 160000, data))
+        ds = None
+        results.append(result)
+
+    for i in range(1, len(results)):
+        maxerror = 0
+        for j in range(160000):
+            maxerror = max(maxerror,
+                           abs(results[i][0][j] - results[0][0][j])
+                           + abs(results[i][1][j] - results[0][1][j]))
+        if maxerror > 0.125 + 1e-5:
+            gdaltest.post_reason('grid approximation error %f exceeds 0.125' % maxerror)
+            return 'fail'
+
+    os.remove('tmp/warp_32_src.tif')
+    os.remove('tmp/warp_32.tif')
+
+    return 'success'
+
 ###############################################################################
 
 gdaltest_list = [
@@ -892,6 +1108,11 @@ gdaltest_list = [
     warp_25,
     warp_26,
     warp_27,
+    warp_28,
+    warp_29,
+    warp_30,
+    warp_31,
+    warp_32,
     ]
 
 if __name__ == '__main__':
@@ -214,6 +214,8 @@ GDALCreateApproxTransformer( GDALTransformerFunc pfnRawTransformer,
                              void *pRawTransformerArg, double dfMaxError );
 void CPL_DLL GDALApproxTransformerOwnsSubtransformer( void *pCBData, 
                                                       int bOwnFlag );
+void CPL_DLL GDALApproxTransformerSetGridCellSize( void *pCBData,
+                                                   double dfCellSize );
 void CPL_DLL GDALDestroyApproxTransformer( void *pApproxArg );
 int  CPL_DLL GDALApproxTransform(
     void *pTransformArg, int bDstToSrc, int nPointCount,
@@ -36,6 +36,7 @@
 #include "gdal_alg_priv.h"
 #include "cpl_list.h"
 #include "cpl_multiproc.h"
+#include "cpl_hash_set.h"
 
 CPL_CVSID("$Id$");
 CPL_C_START
@@ -1658,6 +1659,43 @@ int GDALGenImgProjTransform( void *pTransformArg, int bDstToSrc,
     return TRUE;
 }
 
+/************************************************************************/
+/*                          GDALFormatDouble()                          */
+/*                                                                      */
+/*      Format a value for serialization.  %.16g is kept when it reads  */
+/*      back exactly, otherwise %.17g is used so that a deserialized    */
+/*      clone (as used by the warp kernel worker threads) computes      */
+/*      exactly the same values as the original.                        */
+/************************************************************************/
+
+static void GDALFormatDouble( double dfValue, char *pszOut )
+
+{
+    sprintf( pszOut, "%.16g", dfValue );
+    if( CPLAtof( pszOut ) != dfValue )
+        sprintf( pszOut, "%.17g", dfValue );
+}
+
+/************************************************************************/
+/*                       GDALFormatGeoTransform()                       */
+/************************************************************************/
+
+static void GDALFormatGeoTransform( const double *padfGT, char *pszOut )
+
+{
+    pszOut[0] = '\0';
+    for( int i = 0; i < 6; i++ )
+    {
+        char szValue[64];
+
+        GDALFormatDouble( padfGT[i], szValue );
+
+        if( i > 0 )
+            strcat( pszOut, "," );
+        strcat( pszOut, szValue );
+    }
+}
+
 /************************************************************************/
 /*                 GDALSerializeGenImgProjTransformer()                 */
 /************************************************************************/
@@ -1746,44 +1784,20 @@ GDALSerializeGenImgProjTransformer( void *pTransformArg )
 /* -------------------------------------------------------------------- */
     else
     {
-        sprintf( szWork, "%.16g,%.16g,%.16g,%.16g,%.16g,%.16g", 
-                 psInfo->adfSrcGeoTransform[0],
-                 psInfo->adfSrcGeoTransform[1],
-                 psInfo->adfSrcGeoTransform[2],
-                 psInfo->adfSrcGeoTransform[3],
-                 psInfo->adfSrcGeoTransform[4],
-                 psInfo->adfSrcGeoTransform[5] );
+        GDALFormatGeoTransform( psInfo->adfSrcGeoTransform, szWork );
         CPLCreateXMLElementAndValue( psTree, "SrcGeoTransform", szWork );
         
-        sprintf( szWork, "%.16g,%.16g,%.16g,%.16g,%.16g,%.16g", 
-                 psInfo->adfSrcInvGeoTransform[0],
-                 psInfo->adfSrcInvGeoTransform[1],
-                 psInfo->adfSrcInvGeoTransform[2],
-                 psInfo->adfSrcInvGeoTransform[3],
-                 psInfo->adfSrcInvGeoTransform[4],
-                 psInfo->adfSrcInvGeoTransform[5] );
+        GDALFormatGeoTransform( psInfo->adfSrcInvGeoTransform, szWork );
         CPLCreateXMLElementAndValue( psTree, "SrcInvGeoTransform", szWork );
     }
     
 /* -------------------------------------------------------------------- */
 /*      Handle destination geotransforms.                               */
 /* -------------------------------------------------------------------- */
-    sprintf( szWork, "%.16g,%.16g,%.16g,%.16g,%.16g,%.16g", 
-             psInfo->adfDstGeoTransform[0],
-             psInfo->adfDstGeoTransform[1],
-             psInfo->adfDstGeoTransform[2],
-             psInfo->adfDstGeoTransform[3],
-             psInfo->adfDstGeoTransform[4],
-             psInfo->adfDstGeoTransform[5] );
+    GDALFormatGeoTransform( psInfo->adfDstGeoTransform, szWork );
     CPLCreateXMLElementAndValue( psTree, "DstGeoTransform", szWork );
     
-    sprintf( szWork, "%.16g,%.16g,%.16g,%.16g,%.16g,%.16g", 
-             psInfo->adfDstInvGeoTransform[0],
-             psInfo->adfDstInvGeoTransform[1],
-             psInfo->adfDstInvGeoTransform[2],
-             psInfo->adfDstInvGeoTransform[3],
-             psInfo->adfDstInvGeoTransform[4],
-             psInfo->adfDstInvGeoTransform[5] );
+    GDALFormatGeoTransform( psInfo->adfDstInvGeoTransform, szWork );
     CPLCreateXMLElementAndValue( psTree, "DstInvGeoTransform", szWork );
 
 /* -------------------------------------------------------------------- */
@@ -2195,8 +2209,18 @@ typedef struct
     double	      dfMaxError;
 
     int               bOwnSubtransformer;
+
+    /* Grid mode: size of the root cells, and cache of their quadtrees */
+    double            dfGridCellSize;
+    CPLHashSet       *hGridCells;
+    void             *hGridMutex;
 } ApproxTransformInfo;
 
+static int GDALApproxGridTransform( ApproxTransformInfo *psATInfo,
+                                    int bDstToSrc, int nPoints,
+                                    double *x, double *y, double *z,
+                                    int *panSuccess );
+
 /************************************************************************/
 /*                   GDALSerializeApproxTransformer()                   */
 /************************************************************************/
@@ -2213,8 +2237,16 @@ GDALSerializeApproxTransformer( void *pTransformArg )
 /* -------------------------------------------------------------------- */
 /*      Attach max error.                                               */
 /* -------------------------------------------------------------------- */
-    CPLCreateXMLElementAndValue( psTree, "MaxError", 
-                                 CPLString().Printf("%g",psInfo->dfMaxError) );
+    char szWork[64];
+
+    GDALFormatDouble( psInfo->dfMaxError, szWork );
+    CPLCreateXMLElementAndValue( psTree, "MaxError", szWork );
+
+    if( psInfo->dfGridCellSize > 0.0 )
+    {
+        GDALFormatDouble( psInfo->dfGridCellSize, szWork );
+        CPLCreateXMLElementAndValue( psTree, "GridCellSize", szWork );
+    }
 
 /* -------------------------------------------------------------------- */
 /*      Capture underlying transformer.                                 */
@@ -2264,6 +2296,10 @@ GDALSerializeApproxTransformer( void *pTransformArg )
  * circumstances as little internal validation is done, in order to keep things
  * fast. 
  *
+ * The transformer can alternatively operate in grid mode, see
+ * GDALApproxTransformerSetGridCellSize().  Grid mode is enabled by default
+ * when the GDAL_APPROX_GRID_CELL_SIZE configuration option is set.
+ *
  * @param pfnBaseTransformer the high precision transformer which should be
  * approximated. 
  * @param pBaseTransformArg the callback argument for the high precision 
@@ -2286,6 +2322,10 @@ void *GDALCreateApproxTransformer( GDALTransformerFunc pfnBaseTransformer,
     psATInfo->pBaseCBData = pBaseTransformArg;
     psATInfo->dfMaxError = dfMaxError;
     psATInfo->bOwnSubtransformer = FALSE;
+    psATInfo->dfGridCellSize = 
+        atof( CPLGetConfigOption( "GDAL_APPROX_GRID_CELL_SIZE", "0" ) );
+    psATInfo->hGridCells = NULL;
+    psATInfo->hGridMutex = NULL;
 
     strcpy( psATInfo->sTI.szSignature, "GTI" );
     psATInfo->sTI.pszClassName = "GDALApproxTransformer";
@@ -2308,6 +2348,49 @@ void GDALApproxTransformerOwnsSubtransformer( void *pCBData, int bOwnFlag )
     psATInfo->bOwnSubtransformer = bOwnFlag;
 }
 
+/************************************************************************/
+/*                GDALApproxTransformerSetGridCellSize()                */
+/************************************************************************/
+
+/**
+ * Switch an approximate transformer to grid mode.
+ *
+ * In grid mode, the input space is divided into square root cells of
+ * dfCellSize units.  The first time a point falls in a root cell, the corners,
+ * edge midpoints and center of the cell are transformed with the high
+ * precision transformer, and the cell is recursively split in four until the
+ * bilinear interpolation of the corners is within the maximum error at the
+ * midpoints and center (or the cell is 1/16th of the root cell size, in which
+ * case its points are transformed exactly).  The resulting quadtrees are
+ * cached, so that later points are served by interpolation only.
+ *
+ * Unlike the default mode, grid mode does not require the points to lie on
+ * a line, and approximates both dimensions, which greatly reduces the number
+ * of calls to expensive transformers (RPC, geolocation arrays, reprojection
+ * near the poles) when warping.  For the warper, whose input space is in
+ * pixels, a cell size of 64 is a reasonable value.  Points with a non-zero
+ * z value are transformed in the default mode.
+ *
+ * @param pCBData callback data returned by GDALCreateApproxTransformer().
+ * @param dfCellSize size of the root cells, or 0 to use the default mode.
+ */
+
+void GDALApproxTransformerSetGridCellSize( void *pCBData, double dfCellSize )
+
+{
+    VALIDATE_POINTER0( pCBData, "GDALApproxTransformerSetGridCellSize" );
+
+    ApproxTransformInfo	*psATInfo = (ApproxTransformInfo *) pCBData;
+
+    if( psATInfo->hGridCells != NULL )
+    {
+        CPLHashSetDestroy( psATInfo->hGridCells );
+        psATInfo->hGridCells = NULL;
+    }
+
+    psATInfo->dfGridCellSize = MAX(dfCellSize, 0.0);
+}
+
 /************************************************************************/
 /*                    GDALDestroyApproxTransformer()                    */
 /************************************************************************/
@@ -2331,6 +2414,11 @@ void GDALDestroyApproxTransformer( void * pCBData )
     if( psATInfo->bOwnSubtransformer ) 
         GDALDestroyTransformer( psATInfo->pBaseCBData );
 
+    if( psATInfo->hGridCells != NULL )
+        CPLHashSetDestroy( psATInfo->hGridCells );
+    if( psATInfo->hGridMutex != NULL )
+        CPLDestroyMutex( psATInfo->hGridMutex );
+
     CPLFree( pCBData );
 }
 
@@ -2355,6 +2443,18 @@ int GDALApproxTransform( void *pCBData, int bDstToSrc, int nPoints,
     double x2[3], y2[3], z2[3], dfDeltaX, dfDeltaY, dfError, dfDist, dfDeltaZ;
     int nMiddle, anSuccess2[3], i, bSuccess;
 
+/* -------------------------------------------------------------------- */
+/*      Use the grid mode if enabled and all points are at z=0.         */
+/* -------------------------------------------------------------------- */
+    if( psATInfo->dfGridCellSize > 0.0 && psATInfo->dfMaxError > 0.0 )
+    {
+        for( i = 0; i < nPoints && z[i] == 0.0; i++ ) {}
+
+        if( i == nPoints )
+            return GDALApproxGridTransform( psATInfo, bDstToSrc, nPoints,
+                                            x, y, z, panSuccess );
+    }
+
     nMiddle = (nPoints-1)/2;
 
 /* -------------------------------------------------------------------- */
@@ -2445,6 +2545,454 @@ int GDALApproxTransform( void *pCBData, int bDstToSrc, int nPoints,
     return TRUE;
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*      Grid mode of the approximate transformer.                       */
+/* ==================================================================== */
+/************************************************************************/
+
+/* Cells are not split more than this number of times; points of cells */
+/* at this depth that are still not within the error are transformed */
+/* exactly. */
+#define APPROX_GRID_MAX_DEPTH   4
+
+/* Number of root cells after which the cache is emptied. */
+#define APPROX_GRID_MAX_CELLS   1024
+
+typedef struct _ApproxGridCell ApproxGridCell;
+
+struct _ApproxGridCell
+{
+    /* Position of the root cell, in units of the root cell size */
+    int             iCellX;
+    int             iCellY;
+    int             bDstToSrc;
+
+    double          dfX0;
+    double          dfY0;
+    double          dfSize;
+
+    /* Transformed corners : top-left, top-right, bottom-left, bottom-right */
+    double          adfX[4];
+    double          adfY[4];
+    double          adfZ[4];
+
+    /* TRUE if the points of this leaf must be transformed exactly */
+    int             bExact;
+
+    ApproxGridCell *apsChildren[4];
+};
+
+/************************************************************************/
+/*                       GDALApproxGridCellHash()                       */
+/************************************************************************/
+
+static unsigned long GDALApproxGridCellHash( const void *elt )
+
+{
+    const ApproxGridCell *psCell = (const ApproxGridCell *) elt;
+
+    return ((unsigned long) psCell->iCellX * 73856093UL)
+        ^ ((unsigned long) psCell->iCellY * 19349663UL)
+        ^ (unsigned long) psCell->bDstToSrc;
+}
+
+/************************************************************************/
+/*                      GDALApproxGridCellEqual()                       */
+/************************************************************************/
+
+static int GDALApproxGridCellEqual( const void *elt1, const void *elt2 )
+
+{
+    const ApproxGridCell *psCell1 = (const ApproxGridCell *) elt1;
+    const ApproxGridCell *psCell2 = (const ApproxGridCell *) elt2;
+
+    return psCell1->iCellX == psCell2->iCellX
+        && psCell1->iCellY == psCell2->iCellY
+        && psCell1->bDstToSrc == psCell2->bDstToSrc;
+}
+
+/************************************************************************/
+/*                       GDALApproxGridCellFree()                       */
+/************************************************************************/
+
+static void GDALApproxGridCellFree( void *elt )
+
+{
+    ApproxGridCell *psCell = (ApproxGridCell *) elt;
+    int i;
+
+    for( i = 0; i < 4; i++ )
+    {
+        if( psCell->apsChildren[i] != NULL )
+            GDALApproxGridCellFree( psCell->apsChildren[i] );
+    }
+
+    CPLFree( psCell );
+}
+
+/************************************************************************/
+/*                     GDALApproxGridCellInterpolate()                  */
+/*                                                                      */
+/*      Bilinear interpolation of the transformed corners at the        */
+/*      relative position (dfU, dfV) within the cell.                   */
+/************************************************************************/
+
+static void GDALApproxGridCellInterpolate( const ApproxGridCell *psCell,
+                                           double dfU, double dfV,
+                                           double *pdfX, double *pdfY,
+                                           double *pdfZ )
+
+{
+    double dfW0 = (1.0 - dfU) * (1.0 - dfV);
+    double dfW1 = dfU * (1.0 - dfV);
+    double dfW2 = (1.0 - dfU) * dfV;
+    double dfW3 = dfU * dfV;
+
+    *pdfX = dfW0 * psCell->adfX[0] + dfW1 * psCell->adfX[1]
+        + dfW2 * psCell->adfX[2] + dfW3 * psCell->adfX[3];
+    *pdfY = dfW0 * psCell->adfY[0] + dfW1 * psCell->adfY[1]
+        + dfW2 * psCell->adfY[2] + dfW3 * psCell->adfY[3];
+    *pdfZ = dfW0 * psCell->adfZ[0] + dfW1 * psCell->adfZ[1]
+        + dfW2 * psCell->adfZ[2] + dfW3 * psCell->adfZ[3];
+}
+
+/************************************************************************/
+/*                      GDALApproxGridCellBuild()                       */
+/*                                                                      */
+/*      Given a cell whose corners are already transformed, decide      */
+/*      whether it can be interpolated, or split it.  The cell is       */
+/*      sampled on a 3x3 grid, whose points are reused as the           */
+/*      corners of the children.                                        */
+/************************************************************************/
+
+static void GDALApproxGridCellBuild( ApproxTransformInfo *psATInfo,
+                                     ApproxGridCell *psCell,
+                                     const int *panCornerSuccess,
+                                     int nDepth )
+
+{
+    static const int anU[5] = { 1, 0, 1, 2, 1 };
+    static const int anV[5] = { 0, 1, 1, 1, 2 };
+    static const int anCorner[4] = { 0, 2, 6, 8 };
+    static const int anMiddle[5] = { 1, 3, 4, 5, 7 };
+    double  dfHalf = psCell->dfSize / 2;
+    double  x[5], y[5], z[5];
+    int     anSuccess[5], i, bAllSuccess;
+
+/* -------------------------------------------------------------------- */
+/*      Transform the edge midpoints and the center.                    */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < 5; i++ )
+    {
+        x[i] = psCell->dfX0 + anU[i] * dfHalf;
+        y[i] = psCell->dfY0 + anV[i] * dfHalf;
+        z[i] = 0.0;
+        anSuccess[i] = FALSE;
+    }
+
+    bAllSuccess = 
+        psATInfo->pfnBaseTransformer( psATInfo->pBaseCBData,
+                                      psCell->bDstToSrc, 5,
+                                      x, y, z, anSuccess );
+
+    for( i = 0; i < 5; i++ )
+        bAllSuccess &= anSuccess[i];
+    for( i = 0; i < 4; i++ )
+        bAllSuccess &= panCornerSuccess[i];
+
+/* -------------------------------------------------------------------- */
+/*      Is the interpolation error acceptable at those points?          */
+/* -------------------------------------------------------------------- */
+    if( bAllSuccess )
+    {
+        double dfMaxError = 0.0;
+
+        for( i = 0; i < 5; i++ )
+        {
+            double dfX, dfY, dfZ;
+
+            GDALApproxGridCellInterpolate( psCell, anU[i] * 0.5, anV[i] * 0.5,
+                                           &dfX, &dfY, &dfZ );
+            dfMaxError = MAX( dfMaxError, 
+                              fabs(dfX - x[i]) + fabs(dfY - y[i]) );
+        }
+
+        if( dfMaxError <= psATInfo->dfMaxError )
+            return;
+    }
+
+    if( nDepth == APPROX_GRID_MAX_DEPTH )
+    {
+        psCell->bExact = TRUE;
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Split the cell.                                                 */
+/* -------------------------------------------------------------------- */
+    double  adfGridX[9], adfGridY[9], adfGridZ[9];
+    int     anGridSuccess[9];
+
+    for( i = 0; i < 4; i++ )
+    {
+        adfGridX[anCorner[i]] = psCell->adfX[i];
+        adfGridY[anCorner[i]] = psCell->adfY[i];
+        adfGridZ[anCorner[i]] = psCell->adfZ[i];
+        anGridSuccess[anCorner[i]] = panCornerSuccess[i];
+    }
+    for( i = 0; i < 5; i++ )
+    {
+        adfGridX[anMiddle[i]] = x[i];
+        adfGridY[anMiddle[i]] = y[i];
+        adfGridZ[anMiddle[i]] = z[i];
+        anGridSuccess[anMiddle[i]] = anSuccess[i];
+    }
+
+    for( i = 0; i < 4; i++ )
+    {
+        ApproxGridCell *psChild = (ApproxGridCell *)
+            CPLCalloc( 1, sizeof(ApproxGridCell) );
+        int     iCol = i % 2, iRow = i / 2, iCorner;
+        int     anChildSuccess[4];
+
+        psChild->iCellX = psCell->iCellX;
+        psChild->iCellY = psCell->iCellY;
+        psChild->bDstToSrc = psCell->bDstToSrc;
+        psChild->dfX0 = psCell->dfX0 + iCol * dfHalf;
+        psChild->dfY0 = psCell->dfY0 + iRow * dfHalf;
+        psChild->dfSize = dfHalf;
+
+        for( iCorner = 0; iCorner < 4; iCorner++ )
+        {
+            int iGrid = (iRow + iCorner / 2) * 3 + iCol + iCorner % 2;
+
+            psChild->adfX[iCorner] = adfGridX[iGrid];
+            psChild->adfY[iCorner] = adfGridY[iGrid];
+            psChild->adfZ[iCorner] = adfGridZ[iGrid];
+            anChildSuccess[iCorner] = anGridSuccess[iGrid];
+        }
+
+        GDALApproxGridCellBuild( psATInfo, psChild, anChildSuccess, 
+                                 nDepth + 1 );
+        psCell->apsChildren[i] = psChild;
+    }
+}
+
+/************************************************************************/
+/*                      GDALApproxGridGetRootCell()                     */
+/************************************************************************/
+
+static ApproxGridCell *GDALApproxGridGetRootCell( ApproxTransformInfo *psATInfo,
+                                                  int bDstToSrc,
+                                                  int iCellX, int iCellY )
+
+{
+    ApproxGridCell sKey, *psCell;
+
+    sKey.iCellX = iCellX;
+    sKey.iCellY = iCellY;
+    sKey.bDstToSrc = bDstToSrc;
+
+    psCell = (ApproxGridCell *) CPLHashSetLookup( psATInfo->hGridCells, &sKey );
+    if( psCell != NULL )
+        return psCell;
+
+/* -------------------------------------------------------------------- */
+/*      Bound the memory used by the cache.                             */
+/* -------------------------------------------------------------------- */
+    if( CPLHashSetSize( psATInfo->hGridCells ) >= APPROX_GRID_MAX_CELLS )
+    {
+        CPLHashSetDestroy( psATInfo->hGridCells );
+        psATInfo->hGridCells = CPLHashSetNew( GDALApproxGridCellHash,
+                                              GDALApproxGridCellEqual,
+                                              GDALApproxGridCellFree );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Transform the corners, and build the quadtree.                  */
+/* -------------------------------------------------------------------- */
+    double  dfSize = psATInfo->dfGridCellSize;
+    int     anSuccess[4], i;
+
+    psCell = (ApproxGridCell *) CPLCalloc( 1, sizeof(ApproxGridCell) );
+    psCell->iCellX = iCellX;
+    psCell->iCellY = iCellY;
+    psCell->bDstToSrc = bDstToSrc;
+    psCell->dfX0 = iCellX * dfSize;
+    psCell->dfY0 = iCellY * dfSize;
+    psCell->dfSize = dfSize;
+
+    for( i = 0; i < 4; i++ )
+    {
+        psCell->adfX[i] = psCell->dfX0 + (i % 2) * dfSize;
+        psCell->adfY[i] = psCell->dfY0 + (i / 2) * dfSize;
+        psCell->adfZ[i] = 0.0;
+        anSuccess[i] = FALSE;
+    }
+
+    if( !psATInfo->pfnBaseTransformer( psATInfo->pBaseCBData, bDstToSrc, 4,
+                                       psCell->adfX, psCell->adfY,
+                                       psCell->adfZ, anSuccess ) )
+    {
+        for( i = 0; i < 4; i++ )
+            anSuccess[i] = FALSE;
+    }
+
+    GDALApproxGridCellBuild( psATInfo, psCell, anSuccess, 0 );
+
+    CPLHashSetInsert( psATInfo->hGridCells, psCell );
+
+    return psCell;
+}
+
+/************************************************************************/
+/*                      GDALApproxGridTransform()                       */
+/************************************************************************/
+
+static int GDALApproxGridTransform( ApproxTransformInfo *psATInfo,
+                                    int bDstToSrc, int nPoints,
+                                    double *x, double *y, double *z,
+                                    int *panSuccess )
+
+{
+    double  dfSize = psATInfo->dfGridCellSize;
+    int    *panExact = NULL;
+    int     nExact = 0, i;
+    ApproxGridCell *psRoot = NULL, *psLeaf = NULL;
+
+    /* The cache may be shared by the warper I/O and computation threads */
+    CPLMutexHolderD( &(psATInfo->hGridMutex) );
+
+    if( psATInfo->hGridCells == NULL )
+        psATInfo->hGridCells = CPLHashSetNew( GDALApproxGridCellHash,
+                                              GDALApproxGridCellEqual,
+                                              GDALApproxGridCellFree );
+
+    for( i = 0; i < nPoints; i++ )
+    {
+/* -------------------------------------------------------------------- */
+/*      Most of the time the point is in the same leaf as the previous  */
+/*      one.                                                            */
+/* -------------------------------------------------------------------- */
+        if( psLeaf != NULL
+            && x[i] >= psLeaf->dfX0 && x[i] < psLeaf->dfX0 + psLeaf->dfSize
+            && y[i] >= psLeaf->dfY0 && y[i] < psLeaf->dfY0 + psLeaf->dfSize )
+        {
+            GDALApproxGridCellInterpolate( 
+                psLeaf, (x[i] - psLeaf->dfX0) / psLeaf->dfSize,
+                (y[i] - psLeaf->dfY0) / psLeaf->dfSize, x + i, y + i, z + i );
+            panSuccess[i] = TRUE;
+            continue;
+        }
+
+        double  dfCellX = floor( x[i] / dfSize );
+        double  dfCellY = floor( y[i] / dfSize );
+
+/* -------------------------------------------------------------------- */
+/*      Points out of the range of the cell indices, or invalid, are    */
+/*      transformed exactly.                                            */
+/* -------------------------------------------------------------------- */
+        if( !(fabs(dfCellX) < INT_MAX / 2 && fabs(dfCellY) < INT_MAX / 2) )
+        {
+            if( panExact == NULL )
+                panExact = (int *) CPLMalloc( sizeof(int) * nPoints );
+            panExact[nExact++] = i;
+            continue;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Find the root cell, which is often the one of the previous      */
+/*      point, and then the leaf.                                       */
+/* -------------------------------------------------------------------- */
+        int     iCellX = (int) dfCellX, iCellY = (int) dfCellY;
+
+        if( psRoot == NULL || psRoot->iCellX != iCellX 
+            || psRoot->iCellY != iCellY )
+        {
+            /* This may empty the cache */
+            psLeaf = NULL;
+            psRoot = GDALApproxGridGetRootCell( psATInfo, bDstToSrc,
+                                                iCellX, iCellY );
+        }
+
+        ApproxGridCell *psCell = psRoot;
+        double  dfU = (x[i] - psCell->dfX0) / psCell->dfSize;
+        double  dfV = (y[i] - psCell->dfY0) / psCell->dfSize;
+
+        while( psCell->apsChildren[0] != NULL )
+        {
+            int iChild = 0;
+
+            dfU *= 2;
+            dfV *= 2;
+            if( dfU >= 1.0 )
+            {
+                iChild += 1;
+                dfU -= 1.0;
+            }
+            if( dfV >= 1.0 )
+            {
+                iChild += 2;
+                dfV -= 1.0;
+            }
+            psCell = psCell->apsChildren[iChild];
+        }
+
+        if( psCell->bExact )
+        {
+            if( panExact == NULL )
+                panExact = (int *) CPLMalloc( sizeof(int) * nPoints );
+            panExact[nExact++] = i;
+            continue;
+        }
+
+        GDALApproxGridCellInterpolate( psCell, dfU, dfV, x + i, y + i, z + i );
+        panSuccess[i] = TRUE;
+        psLeaf = psCell;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Transform the remaining points with the exact transformer, in   */
+/*      a single call.                                                  */
+/* -------------------------------------------------------------------- */
+    int bSuccess = TRUE;
+
+    if( nExact > 0 )
+    {
+        double *padfX = (double *) CPLMalloc( sizeof(double) * nExact * 3 );
+        double *padfY = padfX + nExact;
+        double *padfZ = padfY + nExact;
+        int    *panExactSuccess = (int *) CPLMalloc( sizeof(int) * nExact );
+
+        for( i = 0; i < nExact; i++ )
+        {
+            padfX[i] = x[panExact[i]];
+            padfY[i] = y[panExact[i]];
+            padfZ[i] = z[panExact[i]];
+        }
+
+        bSuccess = psATInfo->pfnBaseTransformer( psATInfo->pBaseCBData,
+                                                 bDstToSrc, nExact,
+                                                 padfX, padfY, padfZ,
+                                                 panExactSuccess );
+
+        for( i = 0; i < nExact; i++ )
+        {
+            x[panExact[i]] = padfX[i];
+            y[panExact[i]] = padfY[i];
+            z[panExact[i]] = padfZ[i];
+            panSuccess[panExact[i]] = bSuccess && panExactSuccess[i];
+        }
+
+        CPLFree( padfX );
+        CPLFree( panExactSuccess );
+        CPLFree( panExact );
+    }
+
+    return bSuccess;
+}
+
 /************************************************************************/
 /*                  GDALDeserializeApproxTransformer()                  */
 /************************************************************************/
@@ -2481,6 +3029,12 @@ GDALDeserializeApproxTransformer( CPLXMLNode *psTree )
                                                            dfMaxError );
         GDALApproxTransformerOwnsSubtransformer( pApproxCBData, TRUE );
 
+        const char *pszGridCellSize = 
+            CPLGetXMLValue( psTree, "GridCellSize", NULL );
+        if( pszGridCellSize != NULL )
+            GDALApproxTransformerSetGridCellSize( pApproxCBData,
+                                                  atof(pszGridCellSize) );
+
         return pApproxCBData;
     }
 }
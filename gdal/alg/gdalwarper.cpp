@@ -837,6 +837,19 @@ GDALWarpDstAlphaMasker( void *pMaskFuncArg, int nBandCount, GDALDataType eType,
  * avoids partial writes of compressed blocks and lost space when they are rewritten
  * at the end of the file. However sticking to target block size may cause major
  * processing slowdown for some particular reprojections.
+ *
+ * - NUM_THREADS: (GDAL >= 1.9.0) Number of threads among which the lines of
+ * each chunk are split when running the warp kernel, or ALL_CPUS to use all
+ * the available processors.  Defaults to the value of the GDAL_NUM_THREADS
+ * configuration option, or 1.  Each thread uses its own copy of the
+ * transformer, so this is only honoured for transformers that can be
+ * serialized (GDALSerializeTransformer()).
+ *
+ * - MULTI_CHUNK_COUNT: (GDAL >= 1.9.0) Number of chunks that
+ * GDALWarpOperation::ChunkAndWarpMulti() keeps in flight, so that reading
+ * and writing of some chunks overlaps with the warping of another one.
+ * Defaults to 2.  Above 2, chunks are made smaller so that the total memory
+ * used stays the same as with 2 chunks.
  */
 
 /************************************************************************/
@@ -296,6 +296,8 @@ public:
     
     double              *padfDstNoDataReal;
 
+    void                *psThreadData;
+
                        GDALWarpKernel();
     virtual           ~GDALWarpKernel();
 
@@ -328,8 +330,6 @@ private:
     CPLErr          CreateKernelMask( GDALWarpKernel *, int iBand, 
                                       const char *pszType );
 
-    void            *hThread1Mutex;
-    void            *hThread2Mutex;
     void            *hIOMutex;
     void            *hWarpMutex;
 
@@ -340,6 +340,8 @@ private:
     int             bReportTimings;
     unsigned long   nLastTimeReported;
 
+    void           *psThreadData;
+
     void            WipeChunkList();
     CPLErr          CollectChunkList( int nDstXOff, int nDstYOff, 
                                       int nDstXSize, int nDstYSize );
@@ -32,6 +32,9 @@
 #include "gdalwarper.h"
 #include "cpl_string.h"
 #include "gdalwarpkernel_opencl.h"
+#include "cpl_atomic_ops.h"
+#include "cpl_worker_thread_pool.h"
+#include "gdalsse_priv.h"
 
 CPL_CVSID("$Id$");
 
@@ -50,6 +53,12 @@ int GWKGetFilterRadius(GDALResampleAlg eResampleAlg)
     return anGWKFilterRadius[eResampleAlg];
 }
 
+/* Used in gdalwarpoperation.cpp */
+void* GWKThreadsCreate(char** papszWarpOptions,
+                       GDALTransformerFunc pfnTransformer,
+                       void* pTransformerArg);
+void GWKThreadsEnd(void* psThreadDataIn);
+
 #ifdef HAVE_OPENCL
 static CPLErr GWKOpenCLCase( GDALWarpKernel * );
 #endif
@@ -508,6 +517,7 @@ GDALWarpKernel::GDALWarpKernel()
     pfnTransformer = NULL;
     pTransformerArg = NULL;
     papszWarpOptions = NULL;
+    psThreadData = NULL;
 }
 
 /************************************************************************/
@@ -1412,6 +1422,161 @@ static int GWKGetPixelFloat( GDALWarpKernel *poWK, int iBand,
     return *pdfDensity != 0.0;
 }
 
+/************************************************************************/
+/*                           GWKLoadSSE2()                              */
+/*                                                                      */
+/*      Load 2 or 4 consecutive source samples as doubles.              */
+/************************************************************************/
+
+#ifdef USE_SSE2
+
+static CPL_INLINE __m128d GWKLoad2SSE2( const GByte* pSrc )
+{
+    return _mm_set_pd( (double) pSrc[1], (double) pSrc[0] );
+}
+
+static CPL_INLINE __m128d GWKLoad2SSE2( const GInt16* pSrc )
+{
+    return _mm_set_pd( (double) pSrc[1], (double) pSrc[0] );
+}
+
+static CPL_INLINE __m128d GWKLoad2SSE2( const GUInt16* pSrc )
+{
+    return _mm_set_pd( (double) pSrc[1], (double) pSrc[0] );
+}
+
+static CPL_INLINE __m128d GWKLoad2SSE2( const float* pSrc )
+{
+    return _mm_set_pd( (double) pSrc[1], (double) pSrc[0] );
+}
+
+static CPL_INLINE void GWKLoad4SSE2( const GByte* pSrc,
+                                     __m128d& xmmLow, __m128d& xmmHigh )
+{
+    int nVal;
+    memcpy( &nVal, pSrc, 4 );
+    __m128i xmmZero = _mm_setzero_si128();
+    __m128i xmm = _mm_cvtsi32_si128( nVal );
+    xmm = _mm_unpacklo_epi8( xmm, xmmZero );
+    xmm = _mm_unpacklo_epi16( xmm, xmmZero );
+    xmmLow = _mm_cvtepi32_pd( xmm );
+    xmmHigh = _mm_cvtepi32_pd( _mm_shuffle_epi32( xmm, _MM_SHUFFLE(3,2,3,2) ) );
+}
+
+static CPL_INLINE void GWKLoad4SSE2( const GInt16* pSrc,
+                                     __m128d& xmmLow, __m128d& xmmHigh )
+{
+    __m128i xmm = _mm_loadl_epi64( (const __m128i*) pSrc );
+    /* Sign extend to 32 bits */
+    xmm = _mm_srai_epi32( _mm_unpacklo_epi16( xmm, xmm ), 16 );
+    xmmLow = _mm_cvtepi32_pd( xmm );
+    xmmHigh = _mm_cvtepi32_pd( _mm_shuffle_epi32( xmm, _MM_SHUFFLE(3,2,3,2) ) );
+}
+
+static CPL_INLINE void GWKLoad4SSE2( const GUInt16* pSrc,
+                                     __m128d& xmmLow, __m128d& xmmHigh )
+{
+    __m128i xmm = _mm_loadl_epi64( (const __m128i*) pSrc );
+    xmm = _mm_unpacklo_epi16( xmm, _mm_setzero_si128() );
+    xmmLow = _mm_cvtepi32_pd( xmm );
+    xmmHigh = _mm_cvtepi32_pd( _mm_shuffle_epi32( xmm, _MM_SHUFFLE(3,2,3,2) ) );
+}
+
+static CPL_INLINE void GWKLoad4SSE2( const float* pSrc,
+                                     __m128d& xmmLow, __m128d& xmmHigh )
+{
+    __m128 xmm = _mm_loadu_ps( pSrc );
+    xmmLow = _mm_cvtps_pd( xmm );
+    xmmHigh = _mm_cvtps_pd( _mm_movehl_ps( xmm, xmm ) );
+}
+
+#endif /* USE_SSE2 */
+
+/************************************************************************/
+/*                          GWKBilinear2x2()                            */
+/*                                                                      */
+/*      Bilinear interpolation of a 2x2 neighbourhood fully inside      */
+/*      the source window, with dfRatioX/dfRatioY the weights of the    */
+/*      left column and top row.                                        */
+/************************************************************************/
+
+template<class T>
+static CPL_INLINE double GWKBilinear2x2( const T* pSrc, int nSrcXSize,
+                                         double dfRatioX, double dfRatioY )
+{
+#ifdef USE_SSE2
+    __m128d xmmTop = GWKLoad2SSE2( pSrc );
+    __m128d xmmBottom = GWKLoad2SSE2( pSrc + nSrcXSize );
+    __m128d xmmRatioY = _mm_set1_pd( dfRatioY );
+
+    /* Interpolate vertically both columns at once */
+    __m128d xmmCol = _mm_add_pd(
+        _mm_mul_pd( xmmTop, xmmRatioY ),
+        _mm_mul_pd( xmmBottom, _mm_sub_pd( _mm_set1_pd(1.0), xmmRatioY ) ) );
+    xmmCol = _mm_mul_pd( xmmCol, _mm_set_pd( 1.0 - dfRatioX, dfRatioX ) );
+    xmmCol = _mm_add_sd( xmmCol, _mm_unpackhi_pd( xmmCol, xmmCol ) );
+
+    return _mm_cvtsd_f64( xmmCol );
+#else
+    return ( pSrc[0] * dfRatioX + pSrc[1] * (1.0 - dfRatioX) ) * dfRatioY
+        + ( pSrc[nSrcXSize] * dfRatioX + pSrc[nSrcXSize+1] * (1.0 - dfRatioX) )
+        * (1.0 - dfRatioY);
+#endif
+}
+
+/************************************************************************/
+/*                          GWKConvolve4x4()                            */
+/*                                                                      */
+/*      Apply a separable 4x4 kernel, given its 4 horizontal and 4      */
+/*      vertical weights, to the neighbourhood whose top left corner    */
+/*      is pSrc.                                                        */
+/************************************************************************/
+
+template<class T>
+static CPL_INLINE double GWKConvolve4x4( const T* pSrc, int nSrcXSize,
+                                         const double* padfWeightsX,
+                                         const double* padfWeightsY )
+{
+#ifdef USE_SSE2
+    __m128d xmmAcc01 = _mm_setzero_pd();
+    __m128d xmmAcc23 = _mm_setzero_pd();
+    int j;
+
+    /* Vertical pass on the 4 columns, 2 columns per register */
+    for( j = 0; j < 4; j++ )
+    {
+        __m128d xmmLow, xmmHigh;
+        __m128d xmmWeightY = _mm_set1_pd( padfWeightsY[j] );
+
+        GWKLoad4SSE2( pSrc + j * nSrcXSize, xmmLow, xmmHigh );
+        xmmAcc01 = _mm_add_pd( xmmAcc01, _mm_mul_pd( xmmLow, xmmWeightY ) );
+        xmmAcc23 = _mm_add_pd( xmmAcc23, _mm_mul_pd( xmmHigh, xmmWeightY ) );
+    }
+
+    /* Horizontal pass */
+    xmmAcc01 = _mm_add_pd(
+        _mm_mul_pd( xmmAcc01, _mm_loadu_pd( padfWeightsX ) ),
+        _mm_mul_pd( xmmAcc23, _mm_loadu_pd( padfWeightsX + 2 ) ) );
+    xmmAcc01 = _mm_add_sd( xmmAcc01, _mm_unpackhi_pd( xmmAcc01, xmmAcc01 ) );
+
+    return _mm_cvtsd_f64( xmmAcc01 );
+#else
+    double dfAccumulator = 0.0;
+    int j;
+
+    for( j = 0; j < 4; j++ )
+    {
+        const T* pRow = pSrc + j * nSrcXSize;
+
+        dfAccumulator += padfWeightsY[j] *
+            ( padfWeightsX[0] * pRow[0] + padfWeightsX[1] * pRow[1]
+              + padfWeightsX[2] * pRow[2] + padfWeightsX[3] * pRow[3] );
+    }
+
+    return dfAccumulator;
+#endif
+}
+
 /************************************************************************/
 /*                        GWKBilinearResample()                         */
 /*     Set of bilinear interpolators                                    */
@@ -1579,6 +1744,24 @@ static int GWKBilinearResampleNoMasksByte( GDALWarpKernel *poWK, int iBand,
     double  dfRatioX = 1.5 - (dfSrcX - iSrcX);
     double  dfRatioY = 1.5 - (dfSrcY - iSrcY);
 
+    // Fast path when the four pixels are inside the source window
+    if( iSrcX >= 0 && iSrcX + 1 < poWK->nSrcXSize
+        && iSrcY >= 0 && iSrcY + 1 < poWK->nSrcYSize )
+    {
+        double dfValue =
+            GWKBilinear2x2( poWK->papabySrcImage[iBand] + iSrcOffset,
+                            poWK->nSrcXSize, dfRatioX, dfRatioY );
+
+        if ( dfValue < 0.0 )
+            *pbValue = 0;
+        else if ( dfValue > 255.0 )
+            *pbValue = 255;
+        else
+            *pbValue = (GByte)(0.5 + dfValue);
+
+        return TRUE;
+    }
+
     // Upper Left Pixel
     if( iSrcX >= 0 && iSrcX < poWK->nSrcXSize
         && iSrcY >= 0 && iSrcY < poWK->nSrcYSize )
@@ -1672,6 +1855,16 @@ static int GWKBilinearResampleNoMasksShort( GDALWarpKernel *poWK, int iBand,
     double  dfRatioX = 1.5 - (dfSrcX - iSrcX);
     double  dfRatioY = 1.5 - (dfSrcY - iSrcY);
 
+    // Fast path when the four pixels are inside the source window
+    if( iSrcX >= 0 && iSrcX + 1 < poWK->nSrcXSize
+        && iSrcY >= 0 && iSrcY + 1 < poWK->nSrcYSize )
+    {
+        *piValue = (GInt16)(0.5 +
+            GWKBilinear2x2( ((GInt16 *)poWK->papabySrcImage[iBand]) + iSrcOffset,
+                            poWK->nSrcXSize, dfRatioX, dfRatioY ));
+        return TRUE;
+    }
+
     // Upper Left Pixel
     if( iSrcX >= 0 && iSrcX < poWK->nSrcXSize
         && iSrcY >= 0 && iSrcY < poWK->nSrcYSize )
@@ -1754,6 +1947,18 @@ static int GWKBilinearResampleNoMasksShort( GDALWarpKernel *poWK, int iBand,
     + (   -f0          + f2     ) * distance1                       \
     +               f1                         )
 
+/* Weights of f0..f3 in CubicConvolution(), for use with GWKConvolve4x4() */
+static CPL_INLINE void GWKCubicComputeWeights( double dfX, double *padfWeights )
+{
+    double dfX2 = dfX * dfX;
+    double dfX3 = dfX2 * dfX;
+
+    padfWeights[0] = -dfX3 + 2.0 * dfX2 - dfX;
+    padfWeights[1] = dfX3 - 2.0 * dfX2 + 1.0;
+    padfWeights[2] = -dfX3 + dfX2 + dfX;
+    padfWeights[3] = dfX3 - dfX2;
+}
+
 static int GWKCubicResample( GDALWarpKernel *poWK, int iBand,
                              double dfSrcX, double dfSrcY,
                              double *pdfDensity,
@@ -1779,6 +1984,62 @@ static int GWKCubicResample( GDALWarpKernel *poWK, int iBand,
         return GWKBilinearResample( poWK, iBand, dfSrcX, dfSrcY,
                                     pdfDensity, pdfReal, pdfImag );
 
+/* -------------------------------------------------------------------- */
+/*      Without any source mask, real data types can be convolved       */
+/*      directly from the source buffer.                                */
+/* -------------------------------------------------------------------- */
+    if( poWK->panUnifiedSrcValid == NULL
+        && poWK->pafUnifiedSrcDensity == NULL
+        && (poWK->papanBandSrcValid == NULL
+            || poWK->papanBandSrcValid[iBand] == NULL) )
+    {
+        double  adfWeightsX[4], adfWeightsY[4];
+        GByte  *pabySrc = poWK->papabySrcImage[iBand];
+        int     iSrcTopLeft = iSrcOffset - 1 - poWK->nSrcXSize;
+        int     bDone = TRUE;
+
+        GWKCubicComputeWeights( dfDeltaX, adfWeightsX );
+        GWKCubicComputeWeights( dfDeltaY, adfWeightsY );
+
+        switch( poWK->eWorkingDataType )
+        {
+          case GDT_Byte:
+            *pdfReal = GWKConvolve4x4( pabySrc + iSrcTopLeft,
+                                       poWK->nSrcXSize,
+                                       adfWeightsX, adfWeightsY );
+            break;
+
+          case GDT_Int16:
+            *pdfReal = GWKConvolve4x4( ((GInt16 *) pabySrc) + iSrcTopLeft,
+                                       poWK->nSrcXSize,
+                                       adfWeightsX, adfWeightsY );
+            break;
+
+          case GDT_UInt16:
+            *pdfReal = GWKConvolve4x4( ((GUInt16 *) pabySrc) + iSrcTopLeft,
+                                       poWK->nSrcXSize,
+                                       adfWeightsX, adfWeightsY );
+            break;
+
+          case GDT_Float32:
+            *pdfReal = GWKConvolve4x4( ((float *) pabySrc) + iSrcTopLeft,
+                                       poWK->nSrcXSize,
+                                       adfWeightsX, adfWeightsY );
+            break;
+
+          default:
+            bDone = FALSE;
+            break;
+        }
+
+        if( bDone )
+        {
+            *pdfImag = 0.0;
+            *pdfDensity = 1.0;
+            return TRUE;
+        }
+    }
+
     for ( i = -1; i < 3; i++ )
     {
         if ( !GWKGetPixelRow(poWK, iBand, iSrcOffset + i * poWK->nSrcXSize - 1,
@@ -1830,12 +2091,7 @@ static int GWKCubicResampleNoMasksByte( GDALWarpKernel *poWK, int iBand,
     int     iSrcOffset = iSrcX + iSrcY * poWK->nSrcXSize;
     double  dfDeltaX = dfSrcX - 0.5 - iSrcX;
     double  dfDeltaY = dfSrcY - 0.5 - iSrcY;
-    double  dfDeltaX2 = dfDeltaX * dfDeltaX;
-    double  dfDeltaY2 = dfDeltaY * dfDeltaY;
-    double  dfDeltaX3 = dfDeltaX2 * dfDeltaX;
-    double  dfDeltaY3 = dfDeltaY2 * dfDeltaY;
-    double  adfValue[4];
-    int     i;
+    double  adfWeightsX[4], adfWeightsY[4];
 
     // Get the bilinear interpolation at the image borders
     if ( iSrcX - 1 < 0 || iSrcX + 2 >= poWK->nSrcXSize
@@ -1843,19 +2099,12 @@ static int GWKCubicResampleNoMasksByte( GDALWarpKernel *poWK, int iBand,
         return GWKBilinearResampleNoMasksByte( poWK, iBand, dfSrcX, dfSrcY,
                                                pbValue);
 
-    for ( i = -1; i < 3; i++ )
-    {
-        int     iOffset = iSrcOffset + i * poWK->nSrcXSize;
-
-        adfValue[i + 1] = CubicConvolution(dfDeltaX, dfDeltaX2, dfDeltaX3,
-                            (double)poWK->papabySrcImage[iBand][iOffset - 1],
-                            (double)poWK->papabySrcImage[iBand][iOffset],
-                            (double)poWK->papabySrcImage[iBand][iOffset + 1],
-                            (double)poWK->papabySrcImage[iBand][iOffset + 2]);
-    }
+    GWKCubicComputeWeights( dfDeltaX, adfWeightsX );
+    GWKCubicComputeWeights( dfDeltaY, adfWeightsY );
 
-    double dfValue = CubicConvolution(dfDeltaY, dfDeltaY2, dfDeltaY3,
-                        adfValue[0], adfValue[1], adfValue[2], adfValue[3]);
+    double dfValue = GWKConvolve4x4(
+        poWK->papabySrcImage[iBand] + iSrcOffset - 1 - poWK->nSrcXSize,
+        poWK->nSrcXSize, adfWeightsX, adfWeightsY );
 
     if ( dfValue < 0.0 )
         *pbValue = 0;
@@ -1877,12 +2126,7 @@ static int GWKCubicResampleNoMasksShort( GDALWarpKernel *poWK, int iBand,
     int     iSrcOffset = iSrcX + iSrcY * poWK->nSrcXSize;
     double  dfDeltaX = dfSrcX - 0.5 - iSrcX;
     double  dfDeltaY = dfSrcY - 0.5 - iSrcY;
-    double  dfDeltaX2 = dfDeltaX * dfDeltaX;
-    double  dfDeltaY2 = dfDeltaY * dfDeltaY;
-    double  dfDeltaX3 = dfDeltaX2 * dfDeltaX;
-    double  dfDeltaY3 = dfDeltaY2 * dfDeltaY;
-    double  adfValue[4];
-    int     i;
+    double  adfWeightsX[4], adfWeightsY[4];
 
     // Get the bilinear interpolation at the image borders
     if ( iSrcX - 1 < 0 || iSrcX + 2 >= poWK->nSrcXSize
@@ -1890,19 +2134,13 @@ static int GWKCubicResampleNoMasksShort( GDALWarpKernel *poWK, int iBand,
         return GWKBilinearResampleNoMasksShort( poWK, iBand, dfSrcX, dfSrcY,
                                                 piValue);
 
-    for ( i = -1; i < 3; i++ )
-    {
-        int     iOffset = iSrcOffset + i * poWK->nSrcXSize;
-
-        adfValue[i + 1] =CubicConvolution(dfDeltaX, dfDeltaX2, dfDeltaX3,
-                (double)((GInt16 *)poWK->papabySrcImage[iBand])[iOffset - 1],
-                (double)((GInt16 *)poWK->papabySrcImage[iBand])[iOffset],
-                (double)((GInt16 *)poWK->papabySrcImage[iBand])[iOffset + 1],
-                (double)((GInt16 *)poWK->papabySrcImage[iBand])[iOffset + 2]);
-    }
+    GWKCubicComputeWeights( dfDeltaX, adfWeightsX );
+    GWKCubicComputeWeights( dfDeltaY, adfWeightsY );
 
-    *piValue = (GInt16)CubicConvolution(dfDeltaY, dfDeltaY2, dfDeltaY3,
-                        adfValue[0], adfValue[1], adfValue[2], adfValue[3]);
+    *piValue = (GInt16)GWKConvolve4x4(
+        ((GInt16 *)poWK->papabySrcImage[iBand])
+        + iSrcOffset - 1 - poWK->nSrcXSize,
+        poWK->nSrcXSize, adfWeightsX, adfWeightsY );
     
     return TRUE;
 }
@@ -1959,11 +2197,67 @@ static double GWKBSpline( double x )
 }
 
 
+/************************************************************************/
+/*                     GWKResampleComputeWeights()                      */
+/*                                                                      */
+/*      Build the table of filter weights for the taps nFiltInit to     */
+/*      nRadius along one axis.  When downsampling, the weights do      */
+/*      not depend on the subpixel position of the sample, so a         */
+/*      single row is computed.  Otherwise one row is computed for      */
+/*      each of GWK_WEIGHT_PHASES + 1 evenly spaced subpixel            */
+/*      positions, and GWKResample() uses the nearest one.              */
+/************************************************************************/
+
+#define GWK_WEIGHT_PHASES 1024
+
+static double *GWKResampleComputeWeights( int eResample, double dfScale,
+                                          double dfFilter,
+                                          int nFiltInit, int nRadius,
+                                          int *pnPhases )
+{
+    int     nDist = ( nRadius + 1 ) * 2;
+    int     nPhases = ( dfScale < 1.0 ) ? 1 : GWK_WEIGHT_PHASES + 1;
+    int     iPhase, i;
+
+    if ( eResample != GRA_CubicSpline && eResample != GRA_Lanczos )
+    {
+        *pnPhases = 0;
+        return NULL;
+    }
+
+    double *padfWeights = (double *)
+        CPLCalloc( nPhases * nDist, sizeof(double) );
+
+    for ( iPhase = 0; iPhase < nPhases; iPhase++ )
+    {
+        double  dfDelta = iPhase / (double) GWK_WEIGHT_PHASES;
+        double *padfRow = padfWeights + iPhase * nDist;
+
+        for ( i = nFiltInit; i <= nRadius; i++ )
+        {
+            if ( eResample == GRA_CubicSpline )
+                padfRow[i - nFiltInit] = ( dfScale < 1.0 ) ?
+                    GWKBSpline((double)i * dfScale) * dfScale :
+                    GWKBSpline((double)i - dfDelta);
+            else
+                padfRow[i - nFiltInit] = ( dfScale < 1.0 ) ?
+                    GWKLanczosSinc(i * dfScale, dfFilter) * dfScale :
+                    GWKLanczosSinc(i - dfDelta, dfFilter);
+        }
+    }
+
+    *pnPhases = nPhases;
+    return padfWeights;
+}
+
 typedef struct
 {
-    // Space for saved X weights
+    // Precomputed X and Y weights, nPhasesX (resp. nPhasesY) rows
+    // of ( nXRadius + 1 ) * 2 (resp. ( nYRadius + 1 ) * 2) values
     double  *padfWeightsX;
-    char    *panCalcX;
+    int      nPhasesX;
+    double  *padfWeightsY;
+    int      nPhasesY;
 
     // Space for saving a row of pixels
     double  *padfRowDensity;
@@ -1978,9 +2272,15 @@ static GWKResampleWrkStruct* GWKResampleCreateWrkStruct(GDALWarpKernel *poWK)
     GWKResampleWrkStruct* psWrkStruct =
             (GWKResampleWrkStruct*)CPLMalloc(sizeof(GWKResampleWrkStruct));
 
-    // Alloc space for saved X weights
-    psWrkStruct->padfWeightsX = (double *)CPLCalloc( nXDist, sizeof(double) );
-    psWrkStruct->panCalcX = (char *)CPLMalloc( nXDist * sizeof(char) );
+    // Precompute the X and Y weights
+    psWrkStruct->padfWeightsX =
+        GWKResampleComputeWeights( poWK->eResample, poWK->dfXScale,
+                                   poWK->dfXFilter, poWK->nFiltInitX,
+                                   poWK->nXRadius, &psWrkStruct->nPhasesX );
+    psWrkStruct->padfWeightsY =
+        GWKResampleComputeWeights( poWK->eResample, poWK->dfYScale,
+                                   poWK->dfYFilter, poWK->nFiltInitY,
+                                   poWK->nYRadius, &psWrkStruct->nPhasesY );
 
     // Alloc space for saving a row of pixels
     psWrkStruct->padfRowDensity = (double *)CPLCalloc( nXDist, sizeof(double) );
@@ -1993,7 +2293,7 @@ static GWKResampleWrkStruct* GWKResampleCreateWrkStruct(GDALWarpKernel *poWK)
 static void GWKResampleDeleteWrkStruct(GWKResampleWrkStruct* psWrkStruct)
 {
     CPLFree( psWrkStruct->padfWeightsX );
-    CPLFree( psWrkStruct->panCalcX );
+    CPLFree( psWrkStruct->padfWeightsY );
     CPLFree( psWrkStruct->padfRowDensity );
     CPLFree( psWrkStruct->padfRowReal );
     CPLFree( psWrkStruct->padfRowImag );
@@ -2002,6 +2302,10 @@ static void GWKResampleDeleteWrkStruct(GWKResampleWrkStruct* psWrkStruct)
 
 /************************************************************************/
 /*                           GWKResample()                              */
+/*                                                                      */
+/*      The filter is applied separably: each kernel row is first       */
+/*      reduced with the X weights, and the row sums are then           */
+/*      combined with the Y weights.                                    */
 /************************************************************************/
 
 static int GWKResample( GDALWarpKernel *poWK, int iBand, 
@@ -2023,46 +2327,46 @@ static int GWKResample( GDALWarpKernel *poWK, int iBand,
     int     iSrcOffset = iSrcX + iSrcY * nSrcXSize;
     double  dfDeltaX = dfSrcX - 0.5 - iSrcX;
     double  dfDeltaY = dfSrcY - 0.5 - iSrcY;
-    int     eResample = poWK->eResample;
 
-    double  dfXScale, dfYScale;
-    double  dfXFilter, dfYFilter;
     int     nXRadius, nFiltInitX;
     int     nYRadius, nFiltInitY;
 
-    dfXScale = poWK->dfXScale;
-    dfYScale = poWK->dfYScale;
     nXRadius = poWK->nXRadius;
     nYRadius = poWK->nYRadius;
     nFiltInitX = poWK->nFiltInitX;
     nFiltInitY = poWK->nFiltInitY;
-    dfXFilter = poWK->dfXFilter;
-    dfYFilter = poWK->dfYFilter;
 
     int     i, j;
     int     nXDist = ( nXRadius + 1 ) * 2;
+    int     nYDist = ( nYRadius + 1 ) * 2;
 
-    // Space for saved X weights
-    double  *padfWeightsX = psWrkStruct->padfWeightsX;
-    char    *panCalcX = psWrkStruct->panCalcX;
+    if ( psWrkStruct->padfWeightsX == NULL
+         || psWrkStruct->padfWeightsY == NULL )
+        return FALSE;
+
+    // Select the precomputed weights for the subpixel position
+    const double *padfWeightsX = psWrkStruct->padfWeightsX;
+    const double *padfWeightsY = psWrkStruct->padfWeightsY;
+    if ( psWrkStruct->nPhasesX > 1 )
+        padfWeightsX += nXDist * (int)(dfDeltaX * GWK_WEIGHT_PHASES + 0.5);
+    if ( psWrkStruct->nPhasesY > 1 )
+        padfWeightsY += nYDist * (int)(dfDeltaY * GWK_WEIGHT_PHASES + 0.5);
 
     // Space for saving a row of pixels
     double  *padfRowDensity = psWrkStruct->padfRowDensity;
     double  *padfRowReal = psWrkStruct->padfRowReal;
     double  *padfRowImag = psWrkStruct->padfRowImag;
 
-    // Mark as needing calculation (don't calculate the weights yet,
-    // because a mask may render it unnecessary)
-    memset( panCalcX, FALSE, nXDist * sizeof(char) );
-
     // Loop over pixel rows in the kernel
     for ( j = nFiltInitY; j <= nYRadius; ++j )
     {
         int     iRowOffset, nXMin = nFiltInitX, nXMax = nXRadius;
-        double  dfWeight1;
+        double  dfWeight1 = padfWeightsY[j - nFiltInitY];
+        double  dfRowReal = 0.0, dfRowImag = 0.0;
+        double  dfRowDensity = 0.0, dfRowWeight = 0.0;
         
-        // Skip sampling over edge of image
-        if ( iSrcY + j < 0 || iSrcY + j >= nSrcYSize )
+        // Skip sampling over edge of image, or rows that do not contribute
+        if ( iSrcY + j < 0 || iSrcY + j >= nSrcYSize || dfWeight1 == 0.0 )
             continue;
 
         // Invariant; needs calculation only once per row
@@ -2085,19 +2389,6 @@ static int GWKResample( GDALWarpKernel *poWK, int iBand,
                               padfRowDensity, padfRowReal, padfRowImag ) )
             continue;
 
-        // Select the resampling algorithm
-        if ( eResample == GRA_CubicSpline )
-            // Calculate the Y weight
-            dfWeight1 = ( dfYScale < 1.0 ) ?
-                GWKBSpline(((double)j) * dfYScale) * dfYScale :
-                GWKBSpline(((double)j) - dfDeltaY);
-        else if ( eResample == GRA_Lanczos )
-            dfWeight1 = ( dfYScale < 1.0 ) ?
-                GWKLanczosSinc(j * dfYScale, dfYFilter) * dfYScale :
-                GWKLanczosSinc(j - dfDeltaY, dfYFilter);
-        else
-            return FALSE;
-        
         // Iterate over pixels in row
         for (i = nXMin; i <= nXMax; ++i )
         {
@@ -2108,36 +2399,19 @@ static int GWKResample( GDALWarpKernel *poWK, int iBand,
                  || padfRowDensity[i-nXMin] < 0.000000001 )
                 continue;
 
-            // Make or use a cached set of weights for this row
-            if ( panCalcX[i-nFiltInitX] )
-                // Use saved weight value instead of recomputing it
-                dfWeight2 = dfWeight1 * padfWeightsX[i-nFiltInitX];
-            else
-            {
-                // Choose among possible algorithms
-                if ( eResample == GRA_CubicSpline )
-                    // Calculate & save the X weight
-                    padfWeightsX[i-nFiltInitX] = dfWeight2 = (dfXScale < 1.0 ) ?
-                        GWKBSpline((double)i * dfXScale) * dfXScale :
-                        GWKBSpline(dfDeltaX - (double)i);
-                else if ( eResample == GRA_Lanczos )
-                    // Calculate & save the X weight
-                    padfWeightsX[i-nFiltInitX] = dfWeight2 = (dfXScale < 1.0 ) ?
-                        GWKLanczosSinc(i * dfXScale, dfXFilter) * dfXScale :
-                        GWKLanczosSinc(i - dfDeltaX, dfXFilter);
-                else
-                    return FALSE;
-                
-                dfWeight2 *= dfWeight1;
-                panCalcX[i-nFiltInitX] = TRUE;
-            }
-            
+            dfWeight2 = padfWeightsX[i-nFiltInitX];
+
             // Accumulate!
-            dfAccumulatorReal += padfRowReal[i-nXMin] * dfWeight2;
-            dfAccumulatorImag += padfRowImag[i-nXMin] * dfWeight2;
-            dfAccumulatorDensity += padfRowDensity[i-nXMin] * dfWeight2;
-            dfAccumulatorWeight += dfWeight2;
+            dfRowReal += padfRowReal[i-nXMin] * dfWeight2;
+            dfRowImag += padfRowImag[i-nXMin] * dfWeight2;
+            dfRowDensity += padfRowDensity[i-nXMin] * dfWeight2;
+            dfRowWeight += dfWeight2;
         }
+
+        dfAccumulatorReal += dfRowReal * dfWeight1;
+        dfAccumulatorImag += dfRowImag * dfWeight1;
+        dfAccumulatorDensity += dfRowDensity * dfWeight1;
+        dfAccumulatorWeight += dfRowWeight * dfWeight1;
     }
 
     if ( dfAccumulatorWeight < 0.000001 || dfAccumulatorDensity < 0.000001 )
@@ -2191,6 +2465,34 @@ static int GWKCubicSplineResampleNoMasksByte( GDALWarpKernel *poWK, int iBand,
          || nXRadius > nSrcXSize || nYRadius > nSrcYSize )
         return GWKBilinearResampleNoMasksByte( poWK, iBand, dfSrcX, dfSrcY, pbValue);
 
+    // Without upscaling, the kernel is 4x4 and can be convolved directly
+    // when it does not need to be flipped over the edges of the image
+    if ( nXRadius == 2 && nYRadius == 2
+         && iSrcX - 1 >= 0 && iSrcX + 2 < nSrcXSize
+         && iSrcY - 1 >= 0 && iSrcY + 2 < nSrcYSize )
+    {
+        double  adfWeightsY[4];
+        int     i;
+
+        for ( i = 0; i < 4; i++ )
+        {
+            padfBSpline[i] = GWKBSpline(dfDeltaX - (double)(i - 1));
+            adfWeightsY[i] = GWKBSpline((double)(i - 1) - dfDeltaY);
+        }
+
+        dfAccumulator = GWKConvolve4x4( pabySrcBand + iSrcOffset - 1 - nSrcXSize,
+                                        nSrcXSize, padfBSpline, adfWeightsY );
+
+        if ( dfAccumulator < 0.0 )
+            *pbValue = 0;
+        else if ( dfAccumulator > 255.0 )
+            *pbValue = 255;
+        else
+            *pbValue = (GByte)(0.5 + dfAccumulator);
+
+        return TRUE;
+    }
+
     // Loop over all rows in the kernel
     int     j, jC;
     for ( jC = 0, j = 1 - nYRadius; j <= nYRadius; ++j, ++jC )
@@ -2280,6 +2582,29 @@ static int GWKCubicSplineResampleNoMasksShort( GDALWarpKernel *poWK, int iBand,
          || nXRadius > nSrcXSize || nYRadius > nSrcYSize )
         return GWKBilinearResampleNoMasksShort( poWK, iBand, dfSrcX, dfSrcY, piValue);
 
+    // Without upscaling, the kernel is 4x4 and can be convolved directly
+    // when it does not need to be flipped over the edges of the image
+    if ( nXRadius == 2 && nYRadius == 2
+         && iSrcX - 1 >= 0 && iSrcX + 2 < nSrcXSize
+         && iSrcY - 1 >= 0 && iSrcY + 2 < nSrcYSize )
+    {
+        double  adfWeightsY[4];
+        int     i;
+
+        for ( i = 0; i < 4; i++ )
+        {
+            padfBSpline[i] = GWKBSpline(dfDeltaX - (double)(i - 1));
+            adfWeightsY[i] = GWKBSpline((double)(i - 1) - dfDeltaY);
+        }
+
+        dfAccumulator = GWKConvolve4x4( pabySrcBand + iSrcOffset - 1 - nSrcXSize,
+                                        nSrcXSize, padfBSpline, adfWeightsY );
+
+        *piValue = (GInt16)(0.5 + dfAccumulator);
+
+        return TRUE;
+    }
+
     // Loop over all pixels in the kernel
     int     j, jC;
     for ( jC = 0, j = 1 - nYRadius; j <= nYRadius; ++j, ++jC )
@@ -2651,89 +2976,395 @@ free_warper:
 }
 #endif /* defined(HAVE_OPENCL) */
 
+/************************************************************************/
+/*                            GWKJobStruct                              */
+/*                                                                      */
+/*      Describes the range of destination lines processed by one       */
+/*      thread of a multi-threaded warp.                                */
+/************************************************************************/
 
-#define COMPUTE_iSrcOffset(_pabSuccess, _iDstX, _padfX, _padfY, _poWK, _nSrcXSize, _nSrcYSize) \
-            if( !_pabSuccess[_iDstX] ) \
-                continue; \
-\
-/* -------------------------------------------------------------------- */ \
-/*      Figure out what pixel we want in our source raster, and skip    */ \
-/*      further processing if it is well off the source image.          */ \
-/* -------------------------------------------------------------------- */ \
-            /* We test against the value before casting to avoid the */ \
-            /* problem of asymmetric truncation effects around zero.  That is */ \
-            /* -0.5 will be 0 when cast to an int. */ \
-            if( _padfX[_iDstX] < _poWK->nSrcXOff \
-                || _padfY[_iDstX] < _poWK->nSrcYOff ) \
-                continue; \
-\
-            int iSrcX, iSrcY, iSrcOffset;\
-\
-            iSrcX = ((int) (_padfX[_iDstX] + 1e-10)) - _poWK->nSrcXOff;\
-            iSrcY = ((int) (_padfY[_iDstX] + 1e-10)) - _poWK->nSrcYOff;\
-\
-            /* If operating outside natural projection area, padfX/Y can be */ \
-            /* a very huge positive number, that becomes -2147483648 in the */ \
-            /* int trucation. So it is necessary to test now for non negativeness. */ \
-            if( iSrcX < 0 || iSrcX >= _nSrcXSize || iSrcY < 0 || iSrcY >= _nSrcYSize )\
-                continue;\
-\
-            iSrcOffset = iSrcX + iSrcY * _nSrcXSize;
+typedef struct _GWKJobStruct GWKJobStruct;
+
+struct _GWKJobStruct
+{
+    GDALWarpKernel     *poWK;
+    int                 iYMin;
+    int                 iYMax;
+    volatile int       *pnCounter;
+    volatile int       *pbStop;
+    int                 bReportProgress;
+    int               (*pfnProgress)(GWKJobStruct* psJob);
+    GDALTransformerFunc pfnTransformer;
+    void               *pTransformerArg;
+};
+
+typedef struct
+{
+    CPLWorkerThreadPool *poPool;
+    int                  nThreads;
+
+    /* Transformers used by the nThreads-1 worker threads. The calling */
+    /* thread uses the transformer of the kernel itself. */
+    GDALTransformerFunc  pfnTransformer;
+    void               **papTransformerArg;
+} GWKThreadData;
 
 /************************************************************************/
-/*                           GWKGeneralCase()                           */
+/*                          GWKThreadsCreate()                          */
 /*                                                                      */
-/*      This is the most general case.  It attempts to handle all       */
-/*      possible features with relatively little concern for            */
-/*      efficiency.                                                     */
+/*      Used in gdalwarpoperation.cpp to setup the worker threads       */
+/*      according to the NUM_THREADS warp option (or the               */
+/*      GDAL_NUM_THREADS configuration option). Each worker thread      */
+/*      gets its own copy of the transformer since most transformers    */
+/*      keep per call state.                                            */
 /************************************************************************/
 
-static CPLErr GWKGeneralCase( GDALWarpKernel *poWK )
+void* GWKThreadsCreate( char** papszWarpOptions,
+                        GDALTransformerFunc pfnTransformer,
+                        void* pTransformerArg )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    const char* pszWarpThreads =
+        CSLFetchNameValue( papszWarpOptions, "NUM_THREADS" );
+    if( pszWarpThreads == NULL )
+        pszWarpThreads = CPLGetConfigOption( "GDAL_NUM_THREADS", "1" );
+
+    int nThreads;
+    if( EQUAL(pszWarpThreads, "ALL_CPUS") )
+        nThreads = CPLGetNumCPUs();
+    else
+        nThreads = atoi( pszWarpThreads );
+    if( nThreads > 128 )
+        nThreads = 128;
+    if( nThreads <= 1 || pfnTransformer == NULL )
+        return NULL;
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKGeneralCase()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+/* -------------------------------------------------------------------- */
+/*      Clone the transformer through its serialized form.  If this     */
+/*      is not possible, we cannot safely use several threads.          */
+/* -------------------------------------------------------------------- */
+    CPLPushErrorHandler( CPLQuietErrorHandler );
+    CPLXMLNode *psTransformerTree =
+        GDALSerializeTransformer( pfnTransformer, pTransformerArg );
+    CPLPopErrorHandler();
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
+    if( psTransformerTree == NULL )
     {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
+        CPLDebug( "WARP",
+                  "Transformer cannot be serialized, "
+                  "ignoring NUM_THREADS=%d.", nThreads );
+        return NULL;
     }
 
-/* -------------------------------------------------------------------- */
-/*      Allocate x,y,z coordinate arrays for transformation ... one     */
-/*      scanlines worth of positions.                                   */
-/* -------------------------------------------------------------------- */
-    double *padfX, *padfY, *padfZ;
-    int    *pabSuccess;
-
-    padfX = (double *) CPLMalloc(sizeof(double) * nDstXSize);
-    padfY = (double *) CPLMalloc(sizeof(double) * nDstXSize);
-    padfZ = (double *) CPLMalloc(sizeof(double) * nDstXSize);
-    pabSuccess = (int *) CPLMalloc(sizeof(int) * nDstXSize);
+    GWKThreadData* psThreadData = (GWKThreadData*)
+        CPLCalloc( 1, sizeof(GWKThreadData) );
+    psThreadData->papTransformerArg = (void**)
+        CPLCalloc( nThreads - 1, sizeof(void*) );
+    psThreadData->nThreads = 1;
 
-    GWKResampleWrkStruct* psWrkStruct = NULL;
-    if (poWK->eResample == GRA_CubicSpline
-        || poWK->eResample == GRA_Lanczos )
+    int i;
+    for( i = 0; i < nThreads - 1; i++ )
     {
-        psWrkStruct = GWKResampleCreateWrkStruct(poWK);
+        GDALTransformerFunc pfnClone = NULL;
+        void* pCloneArg = NULL;
+
+        if( GDALDeserializeTransformer( psTransformerTree, &pfnClone,
+                                        &pCloneArg ) != CE_None
+            || pCloneArg == NULL )
+            break;
+
+        psThreadData->pfnTransformer = pfnClone;
+        psThreadData->papTransformerArg[i] = pCloneArg;
+        psThreadData->nThreads ++;
     }
 
-/* ==================================================================== */
-/*      Loop over output lines.                                         */
-/* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
-    {
-        int iDstX;
+    CPLDestroyXMLNode( psTransformerTree );
+
+/* -------------------------------------------------------------------- */
+/*      Start the worker threads.                                       */
+/* -------------------------------------------------------------------- */
+    if( psThreadData->nThreads > 1 )
+    {
+        psThreadData->poPool = new CPLWorkerThreadPool();
+        if( !psThreadData->poPool->Setup( psThreadData->nThreads - 1 ) )
+        {
+            CPLDebug( "WARP", "Cannot start worker threads, "
+                      "running single threaded." );
+            GWKThreadsEnd( psThreadData );
+            return NULL;
+        }
+    }
+    else
+    {
+        GWKThreadsEnd( psThreadData );
+        return NULL;
+    }
+
+    CPLDebug( "WARP", "Using %d threads", psThreadData->nThreads );
+
+    return psThreadData;
+}
+
+/************************************************************************/
+/*                           GWKThreadsEnd()                            */
+/************************************************************************/
+
+void GWKThreadsEnd( void* psThreadDataIn )
+
+{
+    GWKThreadData* psThreadData = (GWKThreadData*) psThreadDataIn;
+    int i;
+
+    if( psThreadData == NULL )
+        return;
+
+    delete psThreadData->poPool;
+
+    for( i = 0; i < psThreadData->nThreads - 1; i++ )
+    {
+        if( psThreadData->papTransformerArg[i] != NULL )
+            GDALDestroyTransformer( psThreadData->papTransformerArg[i] );
+    }
+    CPLFree( psThreadData->papTransformerArg );
+    CPLFree( psThreadData );
+}
+
+/************************************************************************/
+/*                            GWKProgress()                             */
+/*                                                                      */
+/*      Called by each job after completing a line.  Only the job       */
+/*      running in the calling thread reports progress, using the       */
+/*      number of lines completed by all jobs.  Returns TRUE if the     */
+/*      job must stop.                                                  */
+/************************************************************************/
+
+static int GWKProgress( GWKJobStruct* psJob )
+
+{
+    GDALWarpKernel *poWK = psJob->poWK;
+    int nCounter = CPLAtomicInc( psJob->pnCounter );
+
+    if( *(psJob->pbStop) )
+        return TRUE;
+
+    if( !psJob->bReportProgress )
+        return FALSE;
+
+    if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
+                            (nCounter / (double) poWK->nDstYSize),
+                            "", poWK->pProgress ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        *(psJob->pbStop) = TRUE;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/************************************************************************/
+/*                               GWKRun()                               */
+/*                                                                      */
+/*      Run one of the kernel functions over the destination lines,     */
+/*      splitting them between the worker threads if there are any.     */
+/************************************************************************/
+
+static CPLErr GWKRun( GDALWarpKernel *poWK,
+                      const char* pszFuncName,
+                      void (*pfnFunc) (void *pUserData) )
+
+{
+    int nDstYSize = poWK->nDstYSize;
+    GWKThreadData* psThreadData = (GWKThreadData*) poWK->psThreadData;
+    int nThreads = 1;
+
+    CPLDebug( "GDAL", "GDALWarpKernel()::%s()\n"
+              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
+              pszFuncName,
+              poWK->nSrcXOff, poWK->nSrcYOff, 
+              poWK->nSrcXSize, poWK->nSrcYSize,
+              poWK->nDstXOff, poWK->nDstYOff, 
+              poWK->nDstXSize, poWK->nDstYSize );
+
+    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+    if( psThreadData != NULL )
+    {
+        nThreads = MIN( psThreadData->nThreads, nDstYSize / 2 );
+        if( nThreads < 1 )
+            nThreads = 1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The destination validity mask packs 32 pixels per word, so      */
+/*      each job must start on a word boundary to avoid two threads     */
+/*      updating the same word.                                         */
+/* -------------------------------------------------------------------- */
+    int nLineAlign = 1;
+    if( poWK->panDstValid != NULL )
+    {
+        int nCommon = 32;
+        while( (poWK->nDstXSize % nCommon) != 0 )
+            nCommon /= 2;
+        nLineAlign = 32 / nCommon;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Prepare the jobs.                                               */
+/* -------------------------------------------------------------------- */
+    volatile int nCounter = 0;
+    volatile int bStop = FALSE;
+    GWKJobStruct* pasJobs = (GWKJobStruct*)
+        CPLCalloc( nThreads, sizeof(GWKJobStruct) );
+    int i, iYMin = 0;
+
+    for( i = 0; i < nThreads; i++ )
+    {
+        int iYMax = nDstYSize;
+
+        if( i < nThreads - 1 )
+        {
+            iYMax = (int) (((GIntBig) nDstYSize * (i + 1)) / nThreads);
+            iYMax = (iYMax / nLineAlign) * nLineAlign;
+            if( iYMax < iYMin )
+                iYMax = iYMin;
+        }
+
+        pasJobs[i].poWK = poWK;
+        pasJobs[i].iYMin = iYMin;
+        pasJobs[i].iYMax = iYMax;
+        pasJobs[i].pnCounter = &nCounter;
+        pasJobs[i].pbStop = &bStop;
+        pasJobs[i].bReportProgress = (i == 0);
+        pasJobs[i].pfnProgress = GWKProgress;
+        if( i == 0 )
+        {
+            pasJobs[i].pfnTransformer = poWK->pfnTransformer;
+            pasJobs[i].pTransformerArg = poWK->pTransformerArg;
+        }
+        else
+        {
+            pasJobs[i].pfnTransformer = psThreadData->pfnTransformer;
+            pasJobs[i].pTransformerArg = psThreadData->papTransformerArg[i-1];
+        }
+
+        iYMin = iYMax;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Queue all jobs but the first one, which is run by the           */
+/*      calling thread so that progress and errors are reported from    */
+/*      it.                                                             */
+/* -------------------------------------------------------------------- */
+    for( i = 1; i < nThreads; i++ )
+        psThreadData->poPool->SubmitJob( pfnFunc, &(pasJobs[i]) );
+
+    pfnFunc( &(pasJobs[0]) );
+
+    if( nThreads > 1 )
+    {
+        psThreadData->poPool->WaitCompletion();
+
+        if( !bStop
+            && !poWK->pfnProgress( poWK->dfProgressBase +
+                                   poWK->dfProgressScale,
+                                   "", poWK->pProgress ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            bStop = TRUE;
+        }
+    }
+
+    CPLFree( pasJobs );
+
+    return bStop ? CE_Failure : CE_None;
+}
+
+
+#define COMPUTE_iSrcOffset(_pabSuccess, _iDstX, _padfX, _padfY, _poWK, _nSrcXSize, _nSrcYSize) \
+            if( !_pabSuccess[_iDstX] ) \
+                continue; \
+\
+/* -------------------------------------------------------------------- */ \
+/*      Figure out what pixel we want in our source raster, and skip    */ \
+/*      further processing if it is well off the source image.          */ \
+/* -------------------------------------------------------------------- */ \
+            /* We test against the value before casting to avoid the */ \
+            /* problem of asymmetric truncation effects around zero.  That is */ \
+            /* -0.5 will be 0 when cast to an int. */ \
+            if( _padfX[_iDstX] < _poWK->nSrcXOff \
+                || _padfY[_iDstX] < _poWK->nSrcYOff ) \
+                continue; \
+\
+            int iSrcX, iSrcY, iSrcOffset;\
+\
+            iSrcX = ((int) (_padfX[_iDstX] + 1e-10)) - _poWK->nSrcXOff;\
+            iSrcY = ((int) (_padfY[_iDstX] + 1e-10)) - _poWK->nSrcYOff;\
+\
+            /* If operating outside natural projection area, padfX/Y can be */ \
+            /* a very huge positive number, that becomes -2147483648 in the */ \
+            /* int trucation. So it is necessary to test now for non negativeness. */ \
+            if( iSrcX < 0 || iSrcX >= _nSrcXSize || iSrcY < 0 || iSrcY >= _nSrcYSize )\
+                continue;\
+\
+            iSrcOffset = iSrcX + iSrcY * _nSrcXSize;
+
+/************************************************************************/
+/*                           GWKGeneralCase()                           */
+/*                                                                      */
+/*      This is the most general case.  It attempts to handle all       */
+/*      possible features with relatively little concern for            */
+/*      efficiency.                                                     */
+/************************************************************************/
+
+static void GWKGeneralCaseThread( void* pData );
+
+static CPLErr GWKGeneralCase( GDALWarpKernel *poWK )
+
+{
+    return GWKRun( poWK, "GWKGeneralCase", GWKGeneralCaseThread );
+}
+
+static void GWKGeneralCaseThread( void* pData )
+
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
+
+/* -------------------------------------------------------------------- */
+/*      Allocate x,y,z coordinate arrays for transformation ... one     */
+/*      scanlines worth of positions.                                   */
+/* -------------------------------------------------------------------- */
+    double *padfX, *padfY, *padfZ;
+    int    *pabSuccess;
+
+    padfX = (double *) CPLMalloc(sizeof(double) * nDstXSize);
+    padfY = (double *) CPLMalloc(sizeof(double) * nDstXSize);
+    padfZ = (double *) CPLMalloc(sizeof(double) * nDstXSize);
+    pabSuccess = (int *) CPLMalloc(sizeof(int) * nDstXSize);
+
+    GWKResampleWrkStruct* psWrkStruct = NULL;
+    if (poWK->eResample == GRA_CubicSpline
+        || poWK->eResample == GRA_Lanczos )
+    {
+        psWrkStruct = GWKResampleCreateWrkStruct(poWK);
+    }
+
+/* ==================================================================== */
+/*      Loop over output lines.                                         */
+/* ==================================================================== */
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
+    {
+        int iDstX;
 
 /* -------------------------------------------------------------------- */
 /*      Setup points to transform to source image space.                */
@@ -2749,8 +3380,8 @@ static CPLErr GWKGeneralCase( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -2868,13 +3499,8 @@ static CPLErr GWKGeneralCase( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -2886,8 +3512,6 @@ static CPLErr GWKGeneralCase( GDALWarpKernel *poWK )
     CPLFree( pabSuccess );
     if (psWrkStruct)
         GWKResampleDeleteWrkStruct(psWrkStruct);
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -2898,26 +3522,24 @@ static CPLErr GWKGeneralCase( GDALWarpKernel *poWK )
 /*      possible for this particular transformation type.               */
 /************************************************************************/
 
+static void GWKNearestNoMasksByteThread( void* pData );
+
 static CPLErr GWKNearestNoMasksByte( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKNearestNoMasksByte", GWKNearestNoMasksByteThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKNearestNoMasksByte()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKNearestNoMasksByteThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -2934,7 +3556,7 @@ static CPLErr GWKNearestNoMasksByte( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -2952,8 +3574,8 @@ static CPLErr GWKNearestNoMasksByte( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -2983,13 +3605,8 @@ static CPLErr GWKNearestNoMasksByte( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -2999,8 +3616,6 @@ static CPLErr GWKNearestNoMasksByte( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -3011,26 +3626,24 @@ static CPLErr GWKNearestNoMasksByte( GDALWarpKernel *poWK )
 /*      for this particular transformation type.                        */
 /************************************************************************/
 
+static void GWKBilinearNoMasksByteThread( void* pData );
+
 static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKBilinearNoMasksByte", GWKBilinearNoMasksByteThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKBilinearNoMasksByte()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKBilinearNoMasksByteThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -3047,7 +3660,7 @@ static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -3065,8 +3678,8 @@ static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -3095,13 +3708,8 @@ static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -3111,8 +3719,6 @@ static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -3123,26 +3729,24 @@ static CPLErr GWKBilinearNoMasksByte( GDALWarpKernel *poWK )
 /*      for this particular transformation type.                        */
 /************************************************************************/
 
+static void GWKCubicNoMasksByteThread( void* pData );
+
 static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKCubicNoMasksByte", GWKCubicNoMasksByteThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKCubicNoMasksByte()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKCubicNoMasksByteThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -3159,7 +3763,7 @@ static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -3177,8 +3781,8 @@ static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -3207,13 +3811,8 @@ static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -3223,8 +3822,6 @@ static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -3235,26 +3832,24 @@ static CPLErr GWKCubicNoMasksByte( GDALWarpKernel *poWK )
 /*      for this particular transformation type.                        */
 /************************************************************************/
 
+static void GWKCubicSplineNoMasksByteThread( void* pData );
+
 static CPLErr GWKCubicSplineNoMasksByte( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
-
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKCubicSplineNoMasksByte()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
-
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+    return GWKRun( poWK, "GWKCubicSplineNoMasksByte", GWKCubicSplineNoMasksByteThread );
+}
+
+static void GWKCubicSplineNoMasksByteThread( void* pData )
+
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -3274,7 +3869,7 @@ static CPLErr GWKCubicSplineNoMasksByte( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -3292,8 +3887,8 @@ static CPLErr GWKCubicSplineNoMasksByte( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -3323,13 +3918,8 @@ static CPLErr GWKCubicSplineNoMasksByte( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -3340,8 +3930,6 @@ static CPLErr GWKCubicSplineNoMasksByte( GDALWarpKernel *poWK )
     CPLFree( padfZ );
     CPLFree( pabSuccess );
     CPLFree( padfBSpline );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -3352,26 +3940,24 @@ static CPLErr GWKCubicSplineNoMasksByte( GDALWarpKernel *poWK )
 /*      particular transformation type.                                 */
 /************************************************************************/
 
+static void GWKNearestByteThread( void* pData );
+
 static CPLErr GWKNearestByte( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKNearestByte", GWKNearestByteThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKNearestByte()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKNearestByteThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -3388,7 +3974,7 @@ static CPLErr GWKNearestByte( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -3406,8 +3992,8 @@ static CPLErr GWKNearestByte( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -3490,13 +4076,8 @@ static CPLErr GWKNearestByte( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     } /* Next iDstY */
 
 /* -------------------------------------------------------------------- */
@@ -3506,8 +4087,6 @@ static CPLErr GWKNearestByte( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -3519,26 +4098,24 @@ static CPLErr GWKNearestByte( GDALWarpKernel *poWK )
 /*      transformation type.                                            */
 /************************************************************************/
 
+static void GWKNearestNoMasksShortThread( void* pData );
+
 static CPLErr GWKNearestNoMasksShort( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKNearestNoMasksShort", GWKNearestNoMasksShortThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKNearestNoMasksShort()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKNearestNoMasksShortThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -3555,7 +4132,7 @@ static CPLErr GWKNearestNoMasksShort( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -3573,8 +4150,8 @@ static CPLErr GWKNearestNoMasksShort( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -3602,13 +4179,8 @@ static CPLErr GWKNearestNoMasksShort( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -3618,8 +4190,6 @@ static CPLErr GWKNearestNoMasksShort( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -3630,26 +4200,24 @@ static CPLErr GWKNearestNoMasksShort( GDALWarpKernel *poWK )
 /*      for this particular transformation type.                        */
 /************************************************************************/
 
+static void GWKBilinearNoMasksShortThread( void* pData );
+
 static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKBilinearNoMasksShort", GWKBilinearNoMasksShortThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKBilinearNoMasksShort()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKBilinearNoMasksShortThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -3666,7 +4234,7 @@ static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -3684,8 +4252,8 @@ static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -3716,13 +4284,8 @@ static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -3732,8 +4295,6 @@ static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -3744,26 +4305,24 @@ static CPLErr GWKBilinearNoMasksShort( GDALWarpKernel *poWK )
 /*      for this particular transformation type.                        */
 /************************************************************************/
 
+static void GWKCubicNoMasksShortThread( void* pData );
+
 static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKCubicNoMasksShort", GWKCubicNoMasksShortThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKCubicNoMasksShort()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKCubicNoMasksShortThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -3780,7 +4339,7 @@ static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -3798,8 +4357,8 @@ static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -3830,13 +4389,8 @@ static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -3846,8 +4400,6 @@ static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -3858,26 +4410,24 @@ static CPLErr GWKCubicNoMasksShort( GDALWarpKernel *poWK )
 /*      for this particular transformation type.                        */
 /************************************************************************/
 
+static void GWKCubicSplineNoMasksShortThread( void* pData );
+
 static CPLErr GWKCubicSplineNoMasksShort( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKCubicSplineNoMasksShort", GWKCubicSplineNoMasksShortThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKCubicSplineNoMasksShort()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKCubicSplineNoMasksShortThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -3898,7 +4448,7 @@ static CPLErr GWKCubicSplineNoMasksShort( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -3916,8 +4466,8 @@ static CPLErr GWKCubicSplineNoMasksShort( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -3949,13 +4499,8 @@ static CPLErr GWKCubicSplineNoMasksShort( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -3966,8 +4511,6 @@ static CPLErr GWKCubicSplineNoMasksShort( GDALWarpKernel *poWK )
     CPLFree( padfZ );
     CPLFree( pabSuccess );
     CPLFree( padfBSpline );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -3978,26 +4521,24 @@ static CPLErr GWKCubicSplineNoMasksShort( GDALWarpKernel *poWK )
 /*      for this particular transformation type.                        */
 /************************************************************************/
 
+static void GWKNearestShortThread( void* pData );
+
 static CPLErr GWKNearestShort( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKNearestShort", GWKNearestShortThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKNearestShort()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKNearestShortThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -4014,7 +4555,7 @@ static CPLErr GWKNearestShort( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -4032,8 +4573,8 @@ static CPLErr GWKNearestShort( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -4116,13 +4657,8 @@ static CPLErr GWKNearestShort( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     } /* Next iDstY */
 
 /* -------------------------------------------------------------------- */
@@ -4132,8 +4668,6 @@ static CPLErr GWKNearestShort( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -4144,26 +4678,24 @@ static CPLErr GWKNearestShort( GDALWarpKernel *poWK )
 /*      as possible for this particular transformation type.            */
 /************************************************************************/
 
+static void GWKNearestNoMasksFloatThread( void* pData );
+
 static CPLErr GWKNearestNoMasksFloat( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKNearestNoMasksFloat", GWKNearestNoMasksFloatThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKNearestNoMasksFloat()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKNearestNoMasksFloatThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -4180,7 +4712,7 @@ static CPLErr GWKNearestNoMasksFloat( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -4198,8 +4730,8 @@ static CPLErr GWKNearestNoMasksFloat( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -4227,13 +4759,8 @@ static CPLErr GWKNearestNoMasksFloat( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -4243,8 +4770,6 @@ static CPLErr GWKNearestNoMasksFloat( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
 /************************************************************************/
@@ -4255,26 +4780,24 @@ static CPLErr GWKNearestNoMasksFloat( GDALWarpKernel *poWK )
 /*      for this particular transformation type.                        */
 /************************************************************************/
 
+static void GWKNearestFloatThread( void* pData );
+
 static CPLErr GWKNearestFloat( GDALWarpKernel *poWK )
 
 {
-    int iDstY;
-    int nDstXSize = poWK->nDstXSize, nDstYSize = poWK->nDstYSize;
-    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
-    CPLErr eErr = CE_None;
+    return GWKRun( poWK, "GWKNearestFloat", GWKNearestFloatThread );
+}
 
-    CPLDebug( "GDAL", "GDALWarpKernel()::GWKNearestFloat()\n"
-              "Src=%d,%d,%dx%d Dst=%d,%d,%dx%d",
-              poWK->nSrcXOff, poWK->nSrcYOff, 
-              poWK->nSrcXSize, poWK->nSrcYSize,
-              poWK->nDstXOff, poWK->nDstYOff, 
-              poWK->nDstXSize, poWK->nDstYSize );
+static void GWKNearestFloatThread( void* pData )
 
-    if( !poWK->pfnProgress( poWK->dfProgressBase, "", poWK->pProgress ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
+{
+    GWKJobStruct* psJob = (GWKJobStruct*) pData;
+    GDALWarpKernel *poWK = psJob->poWK;
+    int iYMin = psJob->iYMin, iYMax = psJob->iYMax;
+
+    int iDstY;
+    int nDstXSize = poWK->nDstXSize;
+    int nSrcXSize = poWK->nSrcXSize, nSrcYSize = poWK->nSrcYSize;
 
 /* -------------------------------------------------------------------- */
 /*      Allocate x,y,z coordinate arrays for transformation ... one     */
@@ -4291,7 +4814,7 @@ static CPLErr GWKNearestFloat( GDALWarpKernel *poWK )
 /* ==================================================================== */
 /*      Loop over output lines.                                         */
 /* ==================================================================== */
-    for( iDstY = 0; iDstY < nDstYSize && eErr == CE_None; iDstY++ )
+    for( iDstY = iYMin; iDstY < iYMax; iDstY++ )
     {
         int iDstX;
 
@@ -4309,8 +4832,8 @@ static CPLErr GWKNearestFloat( GDALWarpKernel *poWK )
 /*      Transform the points from destination pixel/line coordinates    */
 /*      to source pixel/line coordinates.                               */
 /* -------------------------------------------------------------------- */
-        poWK->pfnTransformer( poWK->pTransformerArg, TRUE, nDstXSize, 
-                              padfX, padfY, padfZ, pabSuccess );
+        psJob->pfnTransformer( psJob->pTransformerArg, TRUE, nDstXSize,
+                               padfX, padfY, padfZ, pabSuccess );
 
 /* ==================================================================== */
 /*      Loop over pixels in output scanline.                            */
@@ -4394,13 +4917,8 @@ static CPLErr GWKNearestFloat( GDALWarpKernel *poWK )
 /* -------------------------------------------------------------------- */
 /*      Report progress to the user, and optionally cancel out.         */
 /* -------------------------------------------------------------------- */
-        if( !poWK->pfnProgress( poWK->dfProgressBase + poWK->dfProgressScale *
-                                ((iDstY+1) / (double) nDstYSize), 
-                                "", poWK->pProgress ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        if( psJob->pfnProgress( psJob ) )
+            break;
     }
 
 /* -------------------------------------------------------------------- */
@@ -4410,7 +4928,5 @@ static CPLErr GWKNearestFloat( GDALWarpKernel *poWK )
     CPLFree( padfY );
     CPLFree( padfZ );
     CPLFree( pabSuccess );
-
-    return eErr;
 }
 
@@ -31,11 +31,16 @@
 #include "cpl_string.h"
 #include "cpl_multiproc.h"
 #include "ogr_api.h"
+#include "cpl_worker_thread_pool.h"
 
 CPL_CVSID("$Id$");
 
 /* Defined in gdalwarpkernel.cpp */
 int GWKGetFilterRadius(GDALResampleAlg eResampleAlg);
+void* GWKThreadsCreate(char** papszWarpOptions,
+                       GDALTransformerFunc pfnTransformer,
+                       void* pTransformerArg);
+void GWKThreadsEnd(void* psThreadDataIn);
 
 
 /************************************************************************/
@@ -121,8 +126,6 @@ GDALWarpOperation::GDALWarpOperation()
 {
     psOptions = NULL;
 
-    hThread1Mutex = NULL;
-    hThread2Mutex = NULL;
     hIOMutex = NULL;
     hWarpMutex = NULL;
 
@@ -132,6 +135,8 @@ GDALWarpOperation::GDALWarpOperation()
 
     bReportTimings = FALSE;
     nLastTimeReported = 0;
+
+    psThreadData = NULL;
 }
 
 /************************************************************************/
@@ -143,10 +148,8 @@ GDALWarpOperation::~GDALWarpOperation()
 {
     WipeOptions();
 
-    if( hThread1Mutex != NULL )
+    if( hIOMutex != NULL )
     {
-        CPLDestroyMutex( hThread1Mutex );
-        CPLDestroyMutex( hThread2Mutex );
         CPLDestroyMutex( hIOMutex );
         CPLDestroyMutex( hWarpMutex );
     }
@@ -171,6 +174,12 @@ const GDALWarpOptions *GDALWarpOperation::GetOptions()
 void GDALWarpOperation::WipeOptions()
 
 {
+    if( psThreadData != NULL )
+    {
+        GWKThreadsEnd( psThreadData );
+        psThreadData = NULL;
+    }
+
     if( psOptions != NULL )
     {
         GDALDestroyWarpOptions( psOptions );
@@ -534,6 +543,14 @@ CPLErr GDALWarpOperation::Initialize( const GDALWarpOptions *psNewOptions )
     bReportTimings = CSLFetchBoolean( psOptions->papszWarpOptions, 
                                       "REPORT_TIMINGS", FALSE );
 
+/* -------------------------------------------------------------------- */
+/*      Setup the worker threads used by the warp kernel, if            */
+/*      NUM_THREADS is requested.                                       */
+/* -------------------------------------------------------------------- */
+    psThreadData = GWKThreadsCreate( psOptions->papszWarpOptions,
+                                     psOptions->pfnTransformer,
+                                     psOptions->pTransformerArg );
+
 /* -------------------------------------------------------------------- */
 /*      Support creating cutline from text warpoption.                  */
 /* -------------------------------------------------------------------- */
@@ -740,10 +757,9 @@ CPLErr GDALChunkAndWarpImage( GDALWarpOperationH hOperation,
 
 typedef struct
 {
-    void              *hThreadMutex;
     GDALWarpOperation *poOperation;
     int               *panChunkInfo;
-    int                bFinished;
+    volatile int      *pbStop;
     CPLErr             eErr;
     double             dfProgressBase;
     double             dfProgressScale;
@@ -753,12 +769,12 @@ typedef struct
 static void ChunkThreadMain( void *pThreadData )
 
 {
-    volatile ChunkThreadData* psData = (volatile ChunkThreadData*) pThreadData;
+    ChunkThreadData* psData = (ChunkThreadData*) pThreadData;
 
-    if( !CPLAcquireMutex( psData->hThreadMutex, 2.0 ) )
+    /* Do not start new chunks once one of them has failed. */
+    if( *(psData->pbStop) )
     {
-        CPLError( CE_Failure, CPLE_AppDefined, 
-                  "Failed to acquire thread mutex in ChunkThreadMain()." );
+        psData->eErr = CE_Failure;
         return;
     }
 
@@ -771,11 +787,8 @@ static void ChunkThreadMain( void *pThreadData )
                                  psData->dfProgressBase,
                                  psData->dfProgressScale);
 
-    /* Marks that we are done. */
-    psData->bFinished = TRUE;
-
-    /* Release mutex so parent knows we are done. */
-    CPLReleaseMutex( psData->hThreadMutex );
+    if( psData->eErr != CE_None )
+        *(psData->pbStop) = TRUE;
 }
 
 /************************************************************************/
@@ -792,7 +805,15 @@ static void ChunkThreadMain( void *pThreadData )
  *
  * Externally this method operates the same as ChunkAndWarpImage(), but
  * internally this method uses multiple threads to interleave input/output
- * for one region while the processing is being done for another.
+ * for some regions while the processing is being done for another.
+ *
+ * The number of chunks in flight is controlled by the MULTI_CHUNK_COUNT
+ * warp option (2 by default).  Reading and writing remain serialized, as
+ * is the warping itself (use the NUM_THREADS warp option to parallelize
+ * it), but with more chunks in flight reads can run further ahead of the
+ * warper.  When more than 2 chunks are in flight, the chunks are made
+ * smaller so that they do not use more memory altogether than 2 chunks of
+ * GDALWarpOptions::dfWarpMemoryLimit bytes.
  *
  * @param nDstXOff X offset to window of destination data to be produced.
  * @param nDstYOff Y offset to window of destination data to be produced.
@@ -806,113 +827,101 @@ CPLErr GDALWarpOperation::ChunkAndWarpMulti(
     int nDstXOff, int nDstYOff,  int nDstXSize, int nDstYSize )
 
 {
-    hThread1Mutex = CPLCreateMutex();
-    hThread2Mutex = CPLCreateMutex();
-    hIOMutex = CPLCreateMutex();
-    hWarpMutex = CPLCreateMutex();
+    int nChunksInFlight = atoi(
+        CSLFetchNameValueDef( psOptions->papszWarpOptions,
+                              "MULTI_CHUNK_COUNT", "2" ) );
+    if( nChunksInFlight < 2 )
+        nChunksInFlight = 2;
 
-    CPLReleaseMutex( hThread1Mutex );
-    CPLReleaseMutex( hThread2Mutex );
-    CPLReleaseMutex( hIOMutex );
-    CPLReleaseMutex( hWarpMutex );
+    if( hIOMutex == NULL )
+    {
+        hIOMutex = CPLCreateMutex();
+        hWarpMutex = CPLCreateMutex();
+
+        CPLReleaseMutex( hIOMutex );
+        CPLReleaseMutex( hWarpMutex );
+    }
 
 /* -------------------------------------------------------------------- */
-/*      Collect the list of chunks to operate on.                       */
+/*      Collect the list of chunks to operate on, keeping the memory    */
+/*      used by all the chunks in flight bounded.                       */
 /* -------------------------------------------------------------------- */
+    double dfWarpMemoryLimit = psOptions->dfWarpMemoryLimit;
+    if( nChunksInFlight > 2 )
+        psOptions->dfWarpMemoryLimit = 
+            MAX( dfWarpMemoryLimit * 2 / nChunksInFlight, 100000.0 );
+
     WipeChunkList();
     CollectChunkList( nDstXOff, nDstYOff, nDstXSize, nDstYSize );
 
+    psOptions->dfWarpMemoryLimit = dfWarpMemoryLimit;
+
     /* Sort chucks from top to bottom, and for equal y, from left to right */
     qsort(panChunkList, nChunkListCount, sizeof(WarpChunk), OrderWarpChunk); 
 
+    if( nChunksInFlight > nChunkListCount )
+        nChunksInFlight = MAX(nChunkListCount, 1);
+
 /* -------------------------------------------------------------------- */
-/*      Process them one at a time, updating the progress               */
-/*      information for each region.                                    */
+/*      Start the threads.  Each one picks the next chunk from the      */
+/*      queue when it is done with the previous one.                    */
 /* -------------------------------------------------------------------- */
-    ChunkThreadData volatile asThreadData[2];
-    memset((void*)&asThreadData, 0, sizeof(asThreadData));
-    asThreadData[0].hThreadMutex = hThread1Mutex;
-    asThreadData[0].poOperation = this;
-    asThreadData[0].bFinished = TRUE;
-    asThreadData[1].hThreadMutex = hThread2Mutex;
-    asThreadData[1].poOperation = this;
-    asThreadData[1].bFinished = TRUE;
+    CPLWorkerThreadPool oPool;
 
-    int iChunk;
-    double dfPixelsProcessed=0.0, dfTotalPixels = nDstXSize*(double)nDstYSize;
-    CPLErr eErr = CE_None;
-
-    for( iChunk = 0; iChunk < nChunkListCount+1; iChunk++ )
+    if( !oPool.Setup( nChunksInFlight ) )
     {
-        int    iThread = iChunk % 2;
+        CPLError( CE_Failure, CPLE_AppDefined, 
+                  "Failed to start threads in ChunkAndWarpMulti()" );
+        WipeChunkList();
+        return CE_Failure;
+    }
+
+    CPLDebug( "GDAL", "Warping %d chunks with %d chunks in flight.",
+              nChunkListCount, nChunksInFlight );
 
 /* -------------------------------------------------------------------- */
-/*      Launch thread for this chunk.                                   */
+/*      Queue all the chunks, with their share of the progress.         */
 /* -------------------------------------------------------------------- */
-        if( iChunk < nChunkListCount )
-        {
-            int *panThisChunk = panChunkList + iChunk*8;
-            double dfChunkPixels = panThisChunk[2] * (double) panThisChunk[3];
+    ChunkThreadData *pasThreadData = (ChunkThreadData *)
+        CPLCalloc( MAX(nChunkListCount, 1), sizeof(ChunkThreadData) );
+    volatile int bStop = FALSE;
 
-            asThreadData[iThread].dfProgressBase = dfPixelsProcessed / dfTotalPixels;
-            asThreadData[iThread].dfProgressScale = dfChunkPixels / dfTotalPixels;
+    int iChunk;
+    double dfPixelsProcessed=0.0, dfTotalPixels = nDstXSize*(double)nDstYSize;
+    CPLErr eErr = CE_None;
 
-            dfPixelsProcessed += dfChunkPixels;
+    for( iChunk = 0; iChunk < nChunkListCount; iChunk++ )
+    {
+        int *panThisChunk = panChunkList + iChunk*8;
+        double dfChunkPixels = panThisChunk[2] * (double) panThisChunk[3];
 
-            asThreadData[iThread].panChunkInfo = panThisChunk;
-            asThreadData[iThread].bFinished = FALSE;
+        pasThreadData[iChunk].poOperation = this;
+        pasThreadData[iChunk].panChunkInfo = panThisChunk;
+        pasThreadData[iChunk].pbStop = &bStop;
+        pasThreadData[iChunk].dfProgressBase = dfPixelsProcessed / dfTotalPixels;
+        pasThreadData[iChunk].dfProgressScale = dfChunkPixels / dfTotalPixels;
 
-            CPLDebug( "GDAL", "Start chunk %d.", iChunk );
-            if( CPLCreateThread( ChunkThreadMain, (void*) &asThreadData[iThread]) == -1 )
-            {
-                CPLError( CE_Failure, CPLE_AppDefined, 
-                          "CPLCreateThread() failed in ChunkAndWarpMulti()" );
-                return CE_Failure;
-            }
+        dfPixelsProcessed += dfChunkPixels;
 
-            /* Eventually we need a mechanism to ensure we wait for this 
-               thread to acquire the IO mutex before proceeding. */
-            if( iChunk == 0 )
-                CPLSleep( 0.25 );
-        }
+        oPool.SubmitJob( ChunkThreadMain, &pasThreadData[iChunk] );
+    }
 
-        
 /* -------------------------------------------------------------------- */
-/*      Wait for previous chunks thread to complete.                    */
+/*      Wait for all chunks to complete, and report the first error.    */
 /* -------------------------------------------------------------------- */
-        if( iChunk > 0 )
-        {
-            iThread = (iChunk-1) % 2;
-            
-            /* Wait for thread to finish. */
-            while( !(asThreadData[iThread].bFinished) )
-            {
-                if( CPLAcquireMutex( asThreadData[iThread].hThreadMutex, 1.0 ) )
-                    CPLReleaseMutex( asThreadData[iThread].hThreadMutex );
-            }
-
-            CPLDebug( "GDAL", "Finished chunk %d.", iChunk-1 );
+    oPool.WaitCompletion();
 
-            eErr = asThreadData[iThread].eErr;
-
-            if( eErr != CE_None )
-                break;
-        }
-    }
-
-    /* -------------------------------------------------------------------- */
-    /*      Wait for all threads to complete.                               */
-    /* -------------------------------------------------------------------- */
-    int iThread;
-    for(iThread = 0; iThread < 2; iThread ++)
+    for( iChunk = 0; iChunk < nChunkListCount; iChunk++ )
     {
-        while( !(asThreadData[iThread].bFinished) )
+        if( pasThreadData[iChunk].eErr != CE_None )
         {
-            if( CPLAcquireMutex( asThreadData[iThread].hThreadMutex, 1.0 ) )
-                CPLReleaseMutex( asThreadData[iThread].hThreadMutex );
+            eErr = pasThreadData[iChunk].eErr;
+            break;
         }
     }
 
+    CPLFree( pasThreadData );
+
     WipeChunkList();
 
     return eErr;
@@ -1462,6 +1471,7 @@ CPLErr GDALWarpOperation::WarpRegionToBuffer(
     oWK.dfProgressScale = dfProgressScale;
 
     oWK.papszWarpOptions = psOptions->papszWarpOptions;
+    oWK.psThreadData = psThreadData;
     
     oWK.padfDstNoDataReal = psOptions->padfDstNoDataReal;
 
@@ -51,6 +51,7 @@
 #include "gt_wkt_srs.h"
 #include "tifvsi.h"
 #include "cpl_multiproc.h"
+#include "cpl_worker_thread_pool.h"
 
 CPL_CVSID("$Id$");
 
@@ -214,6 +215,84 @@ enum
 class GTiffRasterBand;
 class GTiffRGBABand;
 class GTiffBitmapBand;
+class GTiffDataset;
+
+/************************************************************************/
+/*                         GTiffCompressionJob                          */
+/*                                                                      */
+/*      A strip or tile compressed by a worker thread into a            */
+/*      temporary in-memory TIFF file, and whose compressed bytes are   */
+/*      then written with TIFFWriteRawStrip/Tile() by the main thread.  */
+/************************************************************************/
+
+typedef struct
+{
+    GTiffDataset   *poDS;
+    char           *pszTmpFilename;
+    int             nStripOrTile;
+
+    /* Parameters of the temporary file, captured at submission time */
+    int             bBigEndian;
+    int             nWidth;
+    int             nHeight;
+    uint16          nBitsPerSample;
+    uint16          nSamplesPerPixel;
+    uint16          nSampleFormat;
+    uint16          nCompression;
+    uint16          nPredictor;
+    int             nZLevel;
+    int             nLZMAPreset;
+
+    GByte          *pabyBuffer;
+    int             nBufferSize;
+    int             nBufferAllocSize;
+
+    GByte          *pabyCompressedBuffer;
+    int             nCompressedBufferSize;
+
+    volatile int    bReady;
+} GTiffCompressionJob;
+
+/************************************************************************/
+/*                        GTiffDecompressHandle                         */
+/*                                                                      */
+/*      A private libtiff handle on the file of a dataset, used by a    */
+/*      worker thread to decode blocks whose raw bytes have already     */
+/*      been fetched by the main thread.                                */
+/************************************************************************/
+
+typedef struct
+{
+    TIFF           *hTIFF;
+    VSILFILE       *fp;
+    toff_t          nPos;
+
+    /* Raw bytes of the block being decoded, served from memory */
+    const GByte    *pabyRaw;
+    toff_t          nRawOffset;
+    toff_t          nRawSize;
+} GTiffDecompressHandle;
+
+typedef struct
+{
+    GTiffDataset   *poDS;
+    int             nBlockId;
+    int             nBlockXOff;
+    int             nBlockYOff;
+
+    toff_t          nRawOffset;
+    int             nRawSize;
+    GByte          *pabyRaw;
+
+    GByte          *pabyData;
+    int             nBlockReqSize;
+
+    int             bSuccess;
+} GTiffDecompressionJob;
+
+/* Number of raw blocks fetched by a single multi-range read when */
+/* prefetching */
+#define GTIFF_PREFETCH_BATCH_SIZE 32
 
 class GTiffDataset : public GDALPamDataset
 {
@@ -313,6 +392,51 @@ class GTiffDataset : public GDALPamDataset
     int          WriteEncodedTile(uint32 tile, GByte* pabyData, int bPreserveDataBuffer);
     int          WriteEncodedStrip(uint32 strip, GByte* pabyData, int bPreserveDataBuffer);
 
+    CPLWorkerThreadPool *poCompressThreadPool;
+    GTiffCompressionJob *pasCompressionJobs;
+    int          nCompressionJobs;
+    int          nFirstPendingCompressionJob;
+    int          nPendingCompressionJobs;
+    void        *hCompressMutex;
+    void        *hCompressCond;
+
+    void         InitCompressionThreads( char** papszOptions );
+    void         SetupCompressionJobs( CPLWorkerThreadPool* poThreadPool );
+    int          SubmitCompressionJob( int nStripOrTile, GByte* pabyData,
+                                       int cc, int nHeight );
+    CPLErr       WaitCompressionJobs( int nKeep = 0 );
+    int          IsCompressionJobPending( int nStripOrTile );
+    static void  ThreadCompressionFunc( void* pData );
+
+    CPLWorkerThreadPool *poDecompressThreadPool;
+    int          bDecompressThreadPoolInit;
+    CPLString    osDecompressFilename;
+    GTiffDecompressHandle **papsDecompressHandles;
+    int          nDecompressHandles;
+    void        *hDecompressMutex;
+
+    int          InitDecompressionThreads();
+    int          CreateDecompressionThreadPool();
+    GTiffDecompressHandle *AcquireDecompressHandle();
+    void         ReleaseDecompressHandle( GTiffDecompressHandle* psHandle );
+    static void  ThreadDecompressionFunc( void* pData );
+
+    int          CanDirectIO( int nXOff, int nYOff, int nXSize, int nYSize,
+                              int nBufXSize, int nBufYSize,
+                              int nBandCount, int *panBandMap );
+    CPLErr       DirectIO( int nXOff, int nYOff, int nXSize, int nYSize,
+                           void * pData, int nBufXSize, int nBufYSize,
+                           GDALDataType eBufType,
+                           int nBandCount, int *panBandMap,
+                           int nPixelSpace, int nLineSpace, int nBandSpace );
+
+    int          CanInterleavedIO( int nBandCount, int *panBandMap );
+    CPLErr       InterleavedIO( int nXOff, int nYOff, int nXSize, int nYSize,
+                                void * pData, GDALDataType eBufType,
+                                int nBandCount, int *panBandMap,
+                                int nPixelSpace, int nLineSpace,
+                                int nBandSpace );
+
     GTiffDataset* poMaskDS;
     GTiffDataset* poBaseDS;
 
@@ -407,6 +531,10 @@ class GTiffDataset : public GDALPamDataset
                                     void * pProgressData );
     virtual void    FlushCache( void );
 
+    virtual CPLErr  IRasterIO( GDALRWFlag, int, int, int, int,
+                               void *, int, int, GDALDataType,
+                               int, int *, int, int, int );
+
     virtual CPLErr  SetMetadata( char **, const char * = "" );
     virtual char  **GetMetadata( const char * pszDomain = "" );
     virtual CPLErr  SetMetadataItem( const char*, const char*, 
@@ -478,6 +606,17 @@ protected:
     void NullBlock( void *pData );
     CPLErr FillCacheForOtherBands( int nBlockXOff, int nBlockYOff );
 
+    int    CanPrefetchBlocks();
+    int    GetPrefetchBlockRows( int nXOff, int nXSize );
+    void   PrefetchBlocks( int nBlockX1, int nBlockX2,
+                           int nBlockY1, int nBlockY2 );
+    void   PrefetchBlocks( int nBlockCount,
+                           const int *panBlockXOff, const int *panBlockYOff );
+
+    CPLVirtualMem *GetVirtualMemAutoFromStrips( GDALRWFlag eRWFlag,
+                                                int *pnPixelSpace,
+                                                GIntBig *pnLineSpace );
+
 public:
                    GTiffRasterBand( GTiffDataset *, int );
 
@@ -489,6 +628,11 @@ public:
                                   void * pData, int nBufXSize, int nBufYSize,
                                   GDALDataType eBufType,
                                   int nPixelSpace, int nLineSpace );
+    virtual CPLErr IRasterIOMulti( GDALRWFlag eRWFlag,
+                                   int nWindowCount,
+                                   GDALRasterIOWindow *pasWindows,
+                                   GDALDataType eBufType,
+                                   int nPixelSpace, int nLineSpace );
 
     virtual GDALColorInterp GetColorInterpretation();
     virtual GDALColorTable *GetColorTable();
@@ -516,6 +660,11 @@ public:
     virtual GDALRasterBand *GetMaskBand();
     virtual int             GetMaskFlags();
     virtual CPLErr          CreateMaskBand( int nFlags );
+
+    virtual CPLVirtualMem  *GetVirtualMemAuto( GDALRWFlag eRWFlag,
+                                               int *pnPixelSpace,
+                                               GIntBig *pnLineSpace,
+                                               char **papszOptions );
 };
 
 /************************************************************************/
@@ -693,6 +842,15 @@ CPLErr GTiffRasterBand::IRasterIO( GDALRWFlag eRWFlag,
 {
     CPLErr eErr;
 
+    if( eRWFlag == GF_Read &&
+        GDALGetRasterIOResampling( eRWFlag, eDataType, nXSize, nYSize,
+                                   nBufXSize, nBufYSize ) == NULL &&
+        poGDS->CanDirectIO( nXOff, nYOff, nXSize, nYSize,
+                            nBufXSize, nBufYSize, 1, &nBand ) )
+        return poGDS->DirectIO( nXOff, nYOff, nXSize, nYSize,
+                                pData, nBufXSize, nBufYSize, eBufType,
+                                1, &nBand, nPixelSpace, nLineSpace, 0 );
+
     if (poGDS->nBands != 1 &&
         poGDS->nPlanarConfig == PLANARCONFIG_CONTIG &&
         eRWFlag == GF_Read &&
@@ -719,6 +877,46 @@ CPLErr GTiffRasterBand::IRasterIO( GDALRWFlag eRWFlag,
         }
     }
 
+/* -------------------------------------------------------------------- */
+/*      With GDAL_NUM_THREADS, decode the blocks of the window in       */
+/*      worker threads ahead of the generic implementation. This is     */
+/*      done by rows of blocks that fit in half of the block cache.     */
+/* -------------------------------------------------------------------- */
+    int nBlockRowsPerChunk = 0;
+    if( eRWFlag == GF_Read && nXSize == nBufXSize && nYSize == nBufYSize )
+        nBlockRowsPerChunk = GetPrefetchBlockRows( nXOff, nXSize );
+
+    if( nBlockRowsPerChunk > 0 )
+    {
+        int nBlockY1 = nYOff / nBlockYSize;
+        int nBlockY2 = (nYOff + nYSize - 1) / nBlockYSize;
+
+        eErr = CE_None;
+        for( int iBlockY = nBlockY1;
+             iBlockY <= nBlockY2 && eErr == CE_None;
+             iBlockY += nBlockRowsPerChunk )
+        {
+            int iLastBlockY = MIN( nBlockY2, iBlockY + nBlockRowsPerChunk - 1 );
+            int nChunkYOff = MAX( nYOff, iBlockY * nBlockYSize );
+            int nChunkYEnd = MIN( nYOff + nYSize,
+                                  (iLastBlockY + 1) * nBlockYSize );
+
+            PrefetchBlocks( nXOff / nBlockXSize,
+                            (nXOff + nXSize - 1) / nBlockXSize,
+                            iBlockY, iLastBlockY );
+
+            eErr = GDALPamRasterBand::IRasterIO(
+                eRWFlag, nXOff, nChunkYOff, nXSize, nChunkYEnd - nChunkYOff,
+                ((GByte *) pData) + (GIntBig)(nChunkYOff - nYOff) * nLineSpace,
+                nBufXSize, nChunkYEnd - nChunkYOff, eBufType,
+                nPixelSpace, nLineSpace );
+        }
+
+        poGDS->bLoadingOtherBands = FALSE;
+
+        return eErr;
+    }
+
     eErr = GDALPamRasterBand::IRasterIO(eRWFlag, nXOff, nYOff, nXSize, nYSize,
                                         pData, nBufXSize, nBufYSize, eBufType,
                                         nPixelSpace, nLineSpace);
@@ -728,6 +926,429 @@ CPLErr GTiffRasterBand::IRasterIO( GDALRWFlag eRWFlag,
     return eErr;
 }
 
+/************************************************************************/
+/*                           IRasterIOMulti()                           */
+/*                                                                      */
+/*      Prefetch the blocks of all the windows at once, so that they    */
+/*      are read in file order and decoded in worker threads, before    */
+/*      the windows are copied from the block cache.                    */
+/************************************************************************/
+
+static int GTiffBlockIdCompare( const void* a, const void* b )
+{
+    GIntBig nA = *(const GIntBig*) a;
+    GIntBig nB = *(const GIntBig*) b;
+
+    return nA < nB ? -1 : (nA > nB ? 1 : 0);
+}
+
+CPLErr GTiffRasterBand::IRasterIOMulti( GDALRWFlag eRWFlag,
+                                        int nWindowCount,
+                                        GDALRasterIOWindow *pasWindows,
+                                        GDALDataType eBufType,
+                                        int nPixelSpace, int nLineSpace )
+
+{
+    if( eRWFlag == GF_Read && nWindowCount > 1 && CanPrefetchBlocks()
+        && InitBlockInfo() )
+    {
+/* -------------------------------------------------------------------- */
+/*      Collect the distinct blocks of the full resolution windows.     */
+/* -------------------------------------------------------------------- */
+        GIntBig nBlockCount = 0;
+        int iWindow;
+
+        for( iWindow = 0; iWindow < nWindowCount; iWindow++ )
+        {
+            GDALRasterIOWindow *psWindow = pasWindows + iWindow;
+            if( psWindow->nXSize < 1 || psWindow->nYSize < 1
+                || psWindow->nXSize != psWindow->nBufXSize
+                || psWindow->nYSize != psWindow->nBufYSize )
+                continue;
+
+            nBlockCount += (GIntBig)
+                ((psWindow->nXOff + psWindow->nXSize - 1) / nBlockXSize
+                 - psWindow->nXOff / nBlockXSize + 1) *
+                ((psWindow->nYOff + psWindow->nYSize - 1) / nBlockYSize
+                 - psWindow->nYOff / nBlockYSize + 1);
+        }
+
+        GIntBig *panBlockIds = NULL;
+        if( nBlockCount > 1 && nBlockCount < INT_MAX / (int) sizeof(GIntBig) )
+            panBlockIds = (GIntBig *)
+                VSIMalloc2( (size_t) nBlockCount, sizeof(GIntBig) );
+
+        if( panBlockIds != NULL )
+        {
+            int iBlock = 0;
+
+            for( iWindow = 0; iWindow < nWindowCount; iWindow++ )
+            {
+                GDALRasterIOWindow *psWindow = pasWindows + iWindow;
+                if( psWindow->nXSize < 1 || psWindow->nYSize < 1
+                    || psWindow->nXSize != psWindow->nBufXSize
+                    || psWindow->nYSize != psWindow->nBufYSize )
+                    continue;
+
+                for( int iBlockY = psWindow->nYOff / nBlockYSize;
+                     iBlockY <= (psWindow->nYOff + psWindow->nYSize - 1) / nBlockYSize;
+                     iBlockY++ )
+                {
+                    for( int iBlockX = psWindow->nXOff / nBlockXSize;
+                         iBlockX <= (psWindow->nXOff + psWindow->nXSize - 1) / nBlockXSize;
+                         iBlockX++ )
+                        panBlockIds[iBlock++] =
+                            (GIntBig) iBlockY * nBlocksPerRow + iBlockX;
+                }
+            }
+
+            qsort( panBlockIds, iBlock, sizeof(GIntBig), GTiffBlockIdCompare );
+
+            int nDistinctBlocks = 0;
+            for( int i = 0; i < iBlock; i++ )
+            {
+                if( nDistinctBlocks == 0
+                    || panBlockIds[nDistinctBlocks-1] != panBlockIds[i] )
+                    panBlockIds[nDistinctBlocks++] = panBlockIds[i];
+            }
+
+/* -------------------------------------------------------------------- */
+/*      Prefetch them if they fit in half of the block cache.           */
+/* -------------------------------------------------------------------- */
+            GIntBig nRequiredMem = (GIntBig) nDistinctBlocks *
+                (TIFFIsTiled( poGDS->hTIFF ) ? TIFFTileSize( poGDS->hTIFF )
+                                             : TIFFStripSize( poGDS->hTIFF ));
+            int *panBlockXOff = (int *) VSIMalloc2( nDistinctBlocks, sizeof(int) );
+            int *panBlockYOff = (int *) VSIMalloc2( nDistinctBlocks, sizeof(int) );
+
+            if( nDistinctBlocks > 1
+                && nRequiredMem <= GDALGetCacheMax64() / 2
+                && panBlockXOff != NULL && panBlockYOff != NULL )
+            {
+                for( int i = 0; i < nDistinctBlocks; i++ )
+                {
+                    panBlockXOff[i] = (int) (panBlockIds[i] % nBlocksPerRow);
+                    panBlockYOff[i] = (int) (panBlockIds[i] / nBlocksPerRow);
+                }
+
+                PrefetchBlocks( nDistinctBlocks, panBlockXOff, panBlockYOff );
+            }
+
+            VSIFree( panBlockXOff );
+            VSIFree( panBlockYOff );
+            VSIFree( panBlockIds );
+        }
+    }
+
+    return GDALPamRasterBand::IRasterIOMulti( eRWFlag, nWindowCount, pasWindows,
+                                              eBufType, nPixelSpace, nLineSpace );
+}
+
+/************************************************************************/
+/*                         CanPrefetchBlocks()                          */
+/*                                                                      */
+/*      Only plain compressed blocks of whole bytes, read through       */
+/*      IReadBlock() without any further translation, qualify.          */
+/************************************************************************/
+
+int GTiffRasterBand::CanPrefetchBlocks()
+
+{
+    if( poGDS->GetAccess() != GA_ReadOnly
+        || poGDS->bTreatAsRGBA
+        || poGDS->bTreatAsSplit
+        || poGDS->bTreatAsSplitBitmap
+        || poGDS->nCompression == COMPRESSION_NONE
+        || poGDS->nCompression == COMPRESSION_OJPEG )
+        return FALSE;
+
+    if( poGDS->nBitsPerSample != 8 &&
+        poGDS->nBitsPerSample != 16 &&
+        poGDS->nBitsPerSample != 32 &&
+        poGDS->nBitsPerSample != 64 &&
+        poGDS->nBitsPerSample != 128 )
+        return FALSE;
+
+    if( GDALGetDataTypeSize(eDataType) != poGDS->nBitsPerSample )
+        return FALSE;
+
+    return poGDS->InitDecompressionThreads();
+}
+
+/************************************************************************/
+/*                        GetPrefetchBlockRows()                        */
+/*                                                                      */
+/*      Return how many rows of blocks covering [nXOff,nXOff+nXSize[    */
+/*      can be prefetched at once, or 0 if prefetching does not apply.  */
+/************************************************************************/
+
+int GTiffRasterBand::GetPrefetchBlockRows( int nXOff, int nXSize )
+
+{
+    if( !CanPrefetchBlocks() )
+        return 0;
+
+    int nBlockX1 = nXOff / nBlockXSize;
+    int nBlockX2 = (nXOff + nXSize - 1) / nBlockXSize;
+    GIntBig nBlockRowMem = (GIntBig)(nBlockX2 - nBlockX1 + 1) *
+        (TIFFIsTiled( poGDS->hTIFF ) ? TIFFTileSize( poGDS->hTIFF )
+                                     : TIFFStripSize( poGDS->hTIFF ));
+
+    if( nBlockRowMem <= 0 || nBlockRowMem > GDALGetCacheMax64() / 2 )
+        return 0;
+
+    return (int) MIN( INT_MAX, GDALGetCacheMax64() / 2 / nBlockRowMem );
+}
+
+/************************************************************************/
+/*                        GTiffPrefetchJobCompare()                     */
+/************************************************************************/
+
+static int GTiffPrefetchJobCompare( const void* a, const void* b )
+{
+    const GTiffDecompressionJob* psA = (const GTiffDecompressionJob*) a;
+    const GTiffDecompressionJob* psB = (const GTiffDecompressionJob*) b;
+
+    if( psA->nRawOffset < psB->nRawOffset )
+        return -1;
+    if( psA->nRawOffset > psB->nRawOffset )
+        return 1;
+    return 0;
+}
+
+/************************************************************************/
+/*                           PrefetchBlocks()                           */
+/************************************************************************/
+
+void GTiffRasterBand::PrefetchBlocks( int nBlockX1, int nBlockX2,
+                                      int nBlockY1, int nBlockY2 )
+
+{
+    int nBlockCount = (nBlockX2 - nBlockX1 + 1) * (nBlockY2 - nBlockY1 + 1);
+    int *panBlockXOff = (int *) VSIMalloc2( nBlockCount, sizeof(int) );
+    int *panBlockYOff = (int *) VSIMalloc2( nBlockCount, sizeof(int) );
+
+    if( panBlockXOff != NULL && panBlockYOff != NULL )
+    {
+        int iBlock = 0;
+        for( int iBlockY = nBlockY1; iBlockY <= nBlockY2; iBlockY++ )
+        {
+            for( int iBlockX = nBlockX1; iBlockX <= nBlockX2; iBlockX++ )
+            {
+                panBlockXOff[iBlock] = iBlockX;
+                panBlockYOff[iBlock] = iBlockY;
+                iBlock++;
+            }
+        }
+
+        PrefetchBlocks( nBlockCount, panBlockXOff, panBlockYOff );
+    }
+
+    VSIFree( panBlockXOff );
+    VSIFree( panBlockYOff );
+}
+
+/************************************************************************/
+/*                           PrefetchBlocks()                           */
+/*                                                                      */
+/*      Fetch the raw bytes of the given blocks that are not cached     */
+/*      yet, in file offset order, have the worker threads decode       */
+/*      them, and push the result into the block cache.  A block that   */
+/*      fails here is left to IReadBlock() to report.                   */
+/************************************************************************/
+
+void GTiffRasterBand::PrefetchBlocks( int nBlockCount,
+                                      const int *panBlockXOff,
+                                      const int *panBlockYOff )
+
+{
+    if (!poGDS->SetDirectory())
+        return;
+
+    int bTiled = TIFFIsTiled( poGDS->hTIFF );
+    int nBlockBufSize = bTiled ? TIFFTileSize( poGDS->hTIFF )
+                               : TIFFStripSize( poGDS->hTIFF );
+    int bInterleaved = poGDS->nBands != 1
+        && poGDS->nPlanarConfig == PLANARCONFIG_CONTIG;
+
+    toff_t *panOffsets = NULL, *panByteCounts = NULL;
+    if( !TIFFGetField( poGDS->hTIFF,
+                       bTiled ? TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS,
+                       &panOffsets )
+        || !TIFFGetField( poGDS->hTIFF,
+                          bTiled ? TIFFTAG_TILEBYTECOUNTS
+                                 : TIFFTAG_STRIPBYTECOUNTS,
+                          &panByteCounts )
+        || panOffsets == NULL || panByteCounts == NULL )
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Collect the blocks that are not in the cache yet.               */
+/* -------------------------------------------------------------------- */
+    GTiffDecompressionJob* pasJobs = (GTiffDecompressionJob*)
+        VSICalloc( nBlockCount, sizeof(GTiffDecompressionJob) );
+    if( pasJobs == NULL )
+        return;
+
+    int nJobs = 0;
+    for( int iBlock = 0; iBlock < nBlockCount; iBlock++ )
+    {
+        int iBlockX = panBlockXOff[iBlock];
+        int iBlockY = panBlockYOff[iBlock];
+
+        GDALRasterBlock *poBlock = TryGetLockedBlockRef( iBlockX, iBlockY );
+        if( poBlock != NULL )
+        {
+            poBlock->DropLock();
+            continue;
+        }
+
+        int nBlockId = iBlockX + iBlockY * nBlocksPerRow;
+        if( poGDS->nPlanarConfig == PLANARCONFIG_SEPARATE )
+            nBlockId += (nBand-1) * poGDS->nBlocksPerBand;
+
+        if( panByteCounts[nBlockId] == 0
+            || panByteCounts[nBlockId] > INT_MAX )
+            continue;
+
+        GTiffDecompressionJob* psJob = pasJobs + nJobs++;
+        psJob->poDS = poGDS;
+        psJob->nBlockId = nBlockId;
+        psJob->nBlockXOff = iBlockX;
+        psJob->nBlockYOff = iBlockY;
+        psJob->nRawOffset = panOffsets[nBlockId];
+        psJob->nRawSize = (int) panByteCounts[nBlockId];
+
+        /* See IReadBlock() for partially encoded bottom blocks */
+        psJob->nBlockReqSize = nBlockBufSize;
+        if( (iBlockY+1) * nBlockYSize > nRasterYSize )
+            psJob->nBlockReqSize = (nBlockBufSize / nBlockYSize) 
+                * (nBlockYSize - (((iBlockY+1) * nBlockYSize)
+                                  % nRasterYSize));
+    }
+
+    if( nJobs < 2 )
+    {
+        CPLFree( pasJobs );
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Read the raw blocks in file order, a batch at a time through a  */
+/*      multi-range read so that remote files fetch the whole batch     */
+/*      concurrently, and hand each batch to the workers as soon as it  */
+/*      is in memory.                                                   */
+/* -------------------------------------------------------------------- */
+    qsort( pasJobs, nJobs, sizeof(GTiffDecompressionJob),
+           GTiffPrefetchJobCompare );
+
+    VSILFILE *fp = (VSILFILE *) TIFFClientdata( poGDS->hTIFF );
+    void **papRawBuffers = (void **)
+        CPLMalloc( GTIFF_PREFETCH_BATCH_SIZE * sizeof(void*) );
+    vsi_l_offset *panRawOffsets = (vsi_l_offset *)
+        CPLMalloc( GTIFF_PREFETCH_BATCH_SIZE * sizeof(vsi_l_offset) );
+    size_t *panRawSizes = (size_t *)
+        CPLMalloc( GTIFF_PREFETCH_BATCH_SIZE * sizeof(size_t) );
+
+    int iJob;
+    for( int iBatch = 0; iBatch < nJobs; iBatch += GTIFF_PREFETCH_BATCH_SIZE )
+    {
+        int nBatchEnd = MIN( nJobs, iBatch + GTIFF_PREFETCH_BATCH_SIZE );
+        int nRanges = 0;
+
+        for( iJob = iBatch; iJob < nBatchEnd; iJob++ )
+        {
+            GTiffDecompressionJob* psJob = pasJobs + iJob;
+
+            psJob->pabyRaw = (GByte*) VSIMalloc( psJob->nRawSize );
+            psJob->pabyData = (GByte*) VSICalloc( 1, nBlockBufSize );
+            if( psJob->pabyRaw == NULL || psJob->pabyData == NULL )
+                continue;
+
+            papRawBuffers[nRanges] = psJob->pabyRaw;
+            panRawOffsets[nRanges] = psJob->nRawOffset;
+            panRawSizes[nRanges] = psJob->nRawSize;
+            nRanges++;
+        }
+
+        if( nRanges == 0
+            || VSIFReadMultiRangeL( nRanges, papRawBuffers, panRawOffsets,
+                                    panRawSizes, fp ) != 0 )
+            continue;
+
+        for( iJob = iBatch; iJob < nBatchEnd; iJob++ )
+        {
+            GTiffDecompressionJob* psJob = pasJobs + iJob;
+            if( psJob->pabyRaw != NULL && psJob->pabyData != NULL )
+                poGDS->poDecompressThreadPool->SubmitJob(
+                    GTiffDataset::ThreadDecompressionFunc, psJob );
+        }
+    }
+
+    CPLFree( papRawBuffers );
+    CPLFree( panRawOffsets );
+    CPLFree( panRawSizes );
+
+    poGDS->poDecompressThreadPool->WaitCompletion();
+
+/* -------------------------------------------------------------------- */
+/*      Push the decoded blocks into the cache, of all the bands for    */
+/*      pixel interleaved data unless the cache is too small for it.    */
+/* -------------------------------------------------------------------- */
+    int nWordBytes = GDALGetDataTypeSize(eDataType) / 8;
+    int nBlockPixels = nBlockXSize * nBlockYSize;
+
+    for( iJob = 0; iJob < nJobs; iJob++ )
+    {
+        GTiffDecompressionJob* psJob = pasJobs + iJob;
+
+        if( psJob->bSuccess )
+        {
+            int iFirstBand = nBand, iLastBand = nBand;
+            if( bInterleaved && !poGDS->bLoadingOtherBands )
+            {
+                iFirstBand = 1;
+                iLastBand = poGDS->nBands;
+            }
+
+            for( int iBand = iFirstBand; iBand <= iLastBand; iBand++ )
+            {
+                GTiffRasterBand* poBand =
+                    (GTiffRasterBand*) poGDS->GetRasterBand( iBand );
+                GDALRasterBlock* poBlock =
+                    poBand->TryGetLockedBlockRef( psJob->nBlockXOff,
+                                                  psJob->nBlockYOff );
+                if( poBlock != NULL )
+                {
+                    poBlock->DropLock();
+                    continue;
+                }
+
+                poBlock = poBand->GetLockedBlockRef( psJob->nBlockXOff,
+                                                     psJob->nBlockYOff, TRUE );
+                if( poBlock == NULL )
+                    continue;
+
+                if( bInterleaved )
+                    GDALCopyWords( psJob->pabyData + (iBand-1) * nWordBytes,
+                                   eDataType, poGDS->nBands * nWordBytes,
+                                   poBlock->GetDataRef(), eDataType,
+                                   nWordBytes, nBlockPixels );
+                else
+                    memcpy( poBlock->GetDataRef(), psJob->pabyData,
+                            nBlockPixels * nWordBytes );
+
+                poBlock->DropLock();
+            }
+        }
+
+        VSIFree( psJob->pabyRaw );
+        VSIFree( psJob->pabyData );
+    }
+
+    CPLFree( pasJobs );
+}
+
 /************************************************************************/
 /*                             IReadBlock()                             */
 /************************************************************************/
@@ -2821,6 +3442,20 @@ GTiffDataset::GTiffDataset()
     nTempWriteBufferSize = 0;
     pabyTempWriteBuffer = NULL;
 
+    poCompressThreadPool = NULL;
+    pasCompressionJobs = NULL;
+    nCompressionJobs = 0;
+    nFirstPendingCompressionJob = 0;
+    nPendingCompressionJobs = 0;
+    hCompressMutex = NULL;
+    hCompressCond = NULL;
+
+    poDecompressThreadPool = NULL;
+    bDecompressThreadPoolInit = FALSE;
+    papsDecompressHandles = NULL;
+    nDecompressHandles = 0;
+    hDecompressMutex = NULL;
+
     poMaskDS = NULL;
     poBaseDS = NULL;
 
@@ -2972,267 +3607,1656 @@ int GTiffDataset::Finalize()
     CPLFree(pabyTempWriteBuffer);
     pabyTempWriteBuffer = NULL;
 
+/* -------------------------------------------------------------------- */
+/*      Release compression jobs.  All of them have been written out    */
+/*      by the above FlushCache(). The thread pool is owned by the      */
+/*      base dataset, which has finalized its overviews and mask by     */
+/*      now.                                                            */
+/* -------------------------------------------------------------------- */
+    if( pasCompressionJobs != NULL )
+    {
+        if( nPendingCompressionJobs > 0 )
+            poCompressThreadPool->WaitCompletion();
+
+        for( int i = 0; i < nCompressionJobs; i++ )
+        {
+            CPLFree( pasCompressionJobs[i].pszTmpFilename );
+            CPLFree( pasCompressionJobs[i].pabyBuffer );
+            VSIFree( pasCompressionJobs[i].pabyCompressedBuffer );
+        }
+        CPLFree( pasCompressionJobs );
+        pasCompressionJobs = NULL;
+        nCompressionJobs = 0;
+        nPendingCompressionJobs = 0;
+
+        CPLDestroyCond( hCompressCond );
+        hCompressCond = NULL;
+        CPLDestroyMutex( hCompressMutex );
+        hCompressMutex = NULL;
+    }
+
+    if( bBase && poCompressThreadPool != NULL )
+        delete poCompressThreadPool;
+    poCompressThreadPool = NULL;
+
+/* -------------------------------------------------------------------- */
+/*      Release decompression threads and their libtiff handles.        */
+/*      The thread pool of overviews and masks is owned by their base   */
+/*      dataset, which deletes them before its own pool.                */
+/* -------------------------------------------------------------------- */
+    if( poBaseDS == NULL )
+        delete poDecompressThreadPool;
+    poDecompressThreadPool = NULL;
+
+    for( int i = 0; i < nDecompressHandles; i++ )
+    {
+        XTIFFClose( papsDecompressHandles[i]->hTIFF );
+        VSIFCloseL( papsDecompressHandles[i]->fp );
+        CPLFree( papsDecompressHandles[i] );
+    }
+    CPLFree( papsDecompressHandles );
+    papsDecompressHandles = NULL;
+    nDecompressHandles = 0;
+
+    if( hDecompressMutex != NULL )
+        CPLDestroyMutex( hDecompressMutex );
+    hDecompressMutex = NULL;
+
     if( *ppoActiveDSRef == this )
         *ppoActiveDSRef = NULL;
     ppoActiveDSRef = NULL;
 
-    bIsFinalized = TRUE;
+    bIsFinalized = TRUE;
+
+    return bHasDroppedRef;
+}
+
+/************************************************************************/
+/*                        CloseDependentDatasets()                      */
+/************************************************************************/
+
+int GTiffDataset::CloseDependentDatasets()
+{
+    if (!bBase)
+        return FALSE;
+
+    int bHasDroppedRef = GDALPamDataset::CloseDependentDatasets();
+
+    bHasDroppedRef |= Finalize();
+
+    return bHasDroppedRef;
+}
+
+/************************************************************************/
+/*                           FillEmptyTiles()                           */
+/************************************************************************/
+
+void GTiffDataset::FillEmptyTiles()
+
+{
+    toff_t *panByteCounts = NULL;
+    int    nBlockCount, iBlock;
+
+    if (!SetDirectory())
+        return;
+
+    /* Blocks still being compressed have a zero byte count */
+    WaitCompressionJobs();
+
+/* -------------------------------------------------------------------- */
+/*      How many blocks are there in this file?                         */
+/* -------------------------------------------------------------------- */
+    if( nPlanarConfig == PLANARCONFIG_SEPARATE )
+        nBlockCount = nBlocksPerBand * nBands;
+    else
+        nBlockCount = nBlocksPerBand;
+
+/* -------------------------------------------------------------------- */
+/*      Fetch block maps.                                               */
+/* -------------------------------------------------------------------- */
+    if( TIFFIsTiled( hTIFF ) )
+        TIFFGetField( hTIFF, TIFFTAG_TILEBYTECOUNTS, &panByteCounts );
+    else
+        TIFFGetField( hTIFF, TIFFTAG_STRIPBYTECOUNTS, &panByteCounts );
+
+    if (panByteCounts == NULL)
+    {
+        /* Got here with libtiff 3.9.3 and tiff_write_8 test */
+        CPLError(CE_Failure, CPLE_AppDefined, "FillEmptyTiles() failed because panByteCounts == NULL");
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Prepare a blank data buffer to write for uninitialized blocks.  */
+/* -------------------------------------------------------------------- */
+    int nBlockBytes;
+
+    if( TIFFIsTiled( hTIFF ) )
+        nBlockBytes = TIFFTileSize(hTIFF);
+    else
+        nBlockBytes = TIFFStripSize(hTIFF);
+
+    GByte *pabyData = (GByte *) VSICalloc(nBlockBytes,1);
+    if (pabyData == NULL)
+    {
+        CPLError(CE_Failure, CPLE_OutOfMemory,
+                 "Cannot allocate %d bytes", nBlockBytes);
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Check all blocks, writing out data for uninitialized blocks.    */
+/* -------------------------------------------------------------------- */
+    for( iBlock = 0; iBlock < nBlockCount; iBlock++ )
+    {
+        if( panByteCounts[iBlock] == 0 )
+        {
+            if( WriteEncodedTileOrStrip( iBlock, pabyData, FALSE ) != CE_None )
+                break;
+        }
+    }
+
+    CPLFree( pabyData );
+}
+
+/************************************************************************/
+/*                        WriteEncodedTile()                            */
+/************************************************************************/
+
+int GTiffDataset::WriteEncodedTile(uint32 tile, GByte *pabyData,
+                                   int bPreserveDataBuffer)
+{
+    int cc = TIFFTileSize( hTIFF );
+    int bNeedTileFill = FALSE;
+    int iRow=0, iColumn=0;
+    int nBlocksPerRow=1, nBlocksPerColumn=1;
+
+    /* 
+    ** Do we need to spread edge values right or down for a partial 
+    ** JPEG encoded tile?  We do this to avoid edge artifacts. 
+    */
+    if( nCompression == COMPRESSION_JPEG )
+    {
+        nBlocksPerRow = (nRasterXSize + nBlockXSize - 1) / nBlockXSize;
+        nBlocksPerColumn = (nRasterYSize + nBlockYSize - 1) / nBlockYSize;
+
+        iColumn = (tile % nBlocksPerBand) % nBlocksPerRow;
+        iRow = (tile % nBlocksPerBand) / nBlocksPerRow;
+
+        // Is this a partial right edge tile?
+        if( iRow == nBlocksPerRow - 1
+            && nRasterXSize % nBlockXSize != 0 )
+            bNeedTileFill = TRUE;
+
+        // Is this a partial bottom edge tile?
+        if( iColumn == nBlocksPerColumn - 1
+            && nRasterYSize % nBlockYSize != 0 )
+            bNeedTileFill = TRUE;
+    }
+
+    /*
+    ** Hand the tile to a worker thread if multi-threaded compression
+    ** is enabled. The data is copied, so the buffer is preserved.
+    */
+    if( poCompressThreadPool != NULL && !bNeedTileFill )
+    {
+        if( !SubmitCompressionJob( tile, pabyData, cc, nBlockYSize ) )
+            return -1;
+        return cc;
+    }
+
+    /* 
+    ** If we need to fill out the tile, or if we want to prevent
+    ** TIFFWriteEncodedTile from altering the buffer as part of
+    ** byte swapping the data on write then we will need a temporary
+    ** working buffer.  If not, we can just do a direct write. 
+    */
+    if (bPreserveDataBuffer 
+        && (TIFFIsByteSwapped(hTIFF) || bNeedTileFill) )
+    {
+        if (cc != nTempWriteBufferSize)
+        {
+            pabyTempWriteBuffer = CPLRealloc(pabyTempWriteBuffer, cc);
+            nTempWriteBufferSize = cc;
+        }
+        memcpy(pabyTempWriteBuffer, pabyData, cc);
+
+        pabyData = (GByte *) pabyTempWriteBuffer;
+    }
+
+    /*
+    ** Perform tile fill if needed.
+    */
+    if( bNeedTileFill )
+    {
+        int nRightPixelsToFill = 0;
+        int nBottomPixelsToFill = 0;
+        int nPixelSize = cc / (nBlockXSize * nBlockYSize);
+        unsigned int iX, iY, iSrcX, iSrcY;
+        
+        CPLDebug( "GTiff", "Filling out jpeg edge tile on write." );
+
+        if( iColumn == nBlocksPerRow - 1 )
+            nRightPixelsToFill = nBlockXSize * (iColumn+1) - nRasterXSize;
+        if( iRow == nBlocksPerColumn - 1 )
+            nBottomPixelsToFill = nBlockYSize * (iRow+1) - nRasterYSize;
+
+        // Fill out to the right. 
+        iSrcX = nBlockXSize - nRightPixelsToFill - 1;
+
+        for( iX = iSrcX+1; iX < nBlockXSize; iX++ )
+        {
+            for( iY = 0; iY < nBlockYSize; iY++ )
+            {
+                memcpy( pabyData + (nBlockXSize * iY + iX) * nPixelSize, 
+                        pabyData + (nBlockXSize * iY + iSrcX) * nPixelSize, 
+                        nPixelSize );
+            }
+        }
+
+        // now fill out the bottom.
+        iSrcY = nBlockYSize - nBottomPixelsToFill - 1;
+        for( iY = iSrcY+1; iY < nBlockYSize; iY++ )
+        {
+            memcpy( pabyData + nBlockXSize * nPixelSize * iY, 
+                    pabyData + nBlockXSize * nPixelSize * iSrcY, 
+                    nPixelSize * nBlockXSize );
+        }
+    }
+
+    return TIFFWriteEncodedTile(hTIFF, tile, pabyData, cc);
+}
+
+/************************************************************************/
+/*                        WriteEncodedStrip()                           */
+/************************************************************************/
+
+int  GTiffDataset::WriteEncodedStrip(uint32 strip, GByte* pabyData,
+                                     int bPreserveDataBuffer)
+{
+    int cc = TIFFStripSize( hTIFF );
+    
+/* -------------------------------------------------------------------- */
+/*      If this is the last strip in the image, and is partial, then    */
+/*      we need to trim the number of scanlines written to the          */
+/*      amount of valid data we have. (#2748)                           */
+/* -------------------------------------------------------------------- */
+    int nStripWithinBand = strip % nBlocksPerBand;
+    
+    if( (int) ((nStripWithinBand+1) * nRowsPerStrip) > GetRasterYSize() )
+    {
+        cc = (cc / nRowsPerStrip)
+            * (GetRasterYSize() - nStripWithinBand * nRowsPerStrip);
+        CPLDebug( "GTiff", "Adjusted bytes to write from %d to %d.", 
+                  (int) TIFFStripSize(hTIFF), cc );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Hand the strip to a worker thread if multi-threaded             */
+/*      compression is enabled.                                         */
+/* -------------------------------------------------------------------- */
+    if( poCompressThreadPool != NULL )
+    {
+        if( !SubmitCompressionJob( strip, pabyData, cc,
+                                   cc / (int) TIFFScanlineSize(hTIFF) ) )
+            return -1;
+        return cc;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      TIFFWriteEncodedStrip can alter the passed buffer if            */
+/*      byte-swapping is necessary so we use a temporary buffer         */
+/*      before calling it.                                              */
+/* -------------------------------------------------------------------- */
+    if (bPreserveDataBuffer && TIFFIsByteSwapped(hTIFF))
+    {
+        if (cc != nTempWriteBufferSize)
+        {
+            pabyTempWriteBuffer = CPLRealloc(pabyTempWriteBuffer, cc);
+            nTempWriteBufferSize = cc;
+        }
+        memcpy(pabyTempWriteBuffer, pabyData, cc);
+        return TIFFWriteEncodedStrip(hTIFF, strip, pabyTempWriteBuffer, cc);
+    }
+    else
+        return TIFFWriteEncodedStrip(hTIFF, strip, pabyData, cc);
+}
+
+/************************************************************************/
+/*                  WriteEncodedTileOrStrip()                           */
+/************************************************************************/
+
+CPLErr  GTiffDataset::WriteEncodedTileOrStrip(uint32 tile_or_strip, void* data,
+                                              int bPreserveDataBuffer)
+{
+    CPLErr eErr = CE_None;
+
+    if( TIFFIsTiled( hTIFF ) )
+    {
+        if( WriteEncodedTile(tile_or_strip, (GByte*) data, 
+                             bPreserveDataBuffer) == -1 )
+        {
+            eErr = CE_Failure;
+        }
+    }
+    else
+    {
+        if( WriteEncodedStrip(tile_or_strip, (GByte *) data, 
+                              bPreserveDataBuffer) == -1 )
+        {
+            eErr = CE_Failure;
+        }
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                       InitCompressionThreads()                       */
+/*                                                                      */
+/*      Start the worker threads requested by the NUM_THREADS           */
+/*      creation option, if the compression method can use them.        */
+/************************************************************************/
+
+void GTiffDataset::InitCompressionThreads( char** papszOptions )
+
+{
+    const char* pszValue = CSLFetchNameValue( papszOptions, "NUM_THREADS" );
+    if( pszValue == NULL )
+        return;
+
+    int nThreads;
+    if( EQUAL(pszValue, "ALL_CPUS") )
+        nThreads = CPLGetNumCPUs();
+    else
+        nThreads = atoi( pszValue );
+    if( nThreads > 128 )
+        nThreads = 128;
+    if( nThreads <= 1 )
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      JPEG blocks share the JPEGTABLES of the main file and edge      */
+/*      tiles are filled out on write, so they are not compressed in    */
+/*      a separate file.                                                */
+/* -------------------------------------------------------------------- */
+    if( nCompression != COMPRESSION_ADOBE_DEFLATE &&
+        nCompression != COMPRESSION_LZW &&
+        nCompression != COMPRESSION_PACKBITS &&
+        nCompression != COMPRESSION_LZMA )
+    {
+        CPLDebug( "GTiff",
+                  "NUM_THREADS ignored with compression %d.",
+                  (int) nCompression );
+        return;
+    }
+
+    poCompressThreadPool = new CPLWorkerThreadPool();
+    if( !poCompressThreadPool->Setup( nThreads ) )
+    {
+        delete poCompressThreadPool;
+        poCompressThreadPool = NULL;
+        return;
+    }
+
+    CPLDebug( "GTiff", "Using %d threads for compression.", nThreads );
+
+    SetupCompressionJobs( poCompressThreadPool );
+}
+
+/************************************************************************/
+/*                        SetupCompressionJobs()                        */
+/*                                                                      */
+/*      Allocate the ring of compression jobs of this dataset.  The     */
+/*      thread pool is shared with the overviews and the mask.          */
+/************************************************************************/
+
+void GTiffDataset::SetupCompressionJobs( CPLWorkerThreadPool* poThreadPool )
+
+{
+    if( nCompression != COMPRESSION_ADOBE_DEFLATE &&
+        nCompression != COMPRESSION_LZW &&
+        nCompression != COMPRESSION_PACKBITS &&
+        nCompression != COMPRESSION_LZMA )
+        return;
+
+    poCompressThreadPool = poThreadPool;
+
+/* -------------------------------------------------------------------- */
+/*      Keep twice as many blocks in flight as there are threads, so    */
+/*      that the workers are kept busy while the main thread writes     */
+/*      the oldest block out.                                           */
+/* -------------------------------------------------------------------- */
+    nCompressionJobs = 2 * poThreadPool->GetThreadCount();
+    pasCompressionJobs = (GTiffCompressionJob*)
+        CPLCalloc( nCompressionJobs, sizeof(GTiffCompressionJob) );
+    for( int i = 0; i < nCompressionJobs; i++ )
+    {
+        pasCompressionJobs[i].poDS = this;
+        pasCompressionJobs[i].pszTmpFilename =
+            CPLStrdup( CPLSPrintf( "/vsimem/gtiff/thread/job/%p", 
+                                   &pasCompressionJobs[i] ) );
+    }
+    nFirstPendingCompressionJob = 0;
+    nPendingCompressionJobs = 0;
+
+    hCompressMutex = CPLCreateMutex();
+    CPLReleaseMutex( hCompressMutex );
+    hCompressCond = CPLCreateCond();
+}
+
+/************************************************************************/
+/*                       ThreadCompressionFunc()                        */
+/*                                                                      */
+/*      Worker thread side: compress a single block as the only strip   */
+/*      of a temporary in-memory TIFF file, and keep its bytes.         */
+/************************************************************************/
+
+void GTiffDataset::ThreadCompressionFunc( void* pData )
+
+{
+    GTiffCompressionJob* psJob = (GTiffCompressionJob*) pData;
+    GTiffDataset* poDS = psJob->poDS;
+    TIFF* hTIFFTmp;
+    toff_t nOffset = 0, nSize = 0;
+
+    hTIFFTmp = VSI_TIFFOpen( psJob->pszTmpFilename,
+                             psJob->bBigEndian ? "wb" : "wl" );
+    if( hTIFFTmp != NULL )
+    {
+        TIFFSetField( hTIFFTmp, TIFFTAG_IMAGEWIDTH, psJob->nWidth );
+        TIFFSetField( hTIFFTmp, TIFFTAG_IMAGELENGTH, psJob->nHeight );
+        TIFFSetField( hTIFFTmp, TIFFTAG_ROWSPERSTRIP, psJob->nHeight );
+        TIFFSetField( hTIFFTmp, TIFFTAG_BITSPERSAMPLE,
+                      psJob->nBitsPerSample );
+        TIFFSetField( hTIFFTmp, TIFFTAG_SAMPLESPERPIXEL,
+                      psJob->nSamplesPerPixel );
+        TIFFSetField( hTIFFTmp, TIFFTAG_SAMPLEFORMAT, psJob->nSampleFormat );
+        TIFFSetField( hTIFFTmp, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG );
+        TIFFSetField( hTIFFTmp, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK );
+        TIFFSetField( hTIFFTmp, TIFFTAG_COMPRESSION, psJob->nCompression );
+        if( psJob->nPredictor != PREDICTOR_NONE )
+            TIFFSetField( hTIFFTmp, TIFFTAG_PREDICTOR, psJob->nPredictor );
+        if( psJob->nZLevel > 0
+            && psJob->nCompression == COMPRESSION_ADOBE_DEFLATE )
+            TIFFSetField( hTIFFTmp, TIFFTAG_ZIPQUALITY, psJob->nZLevel );
+        if( psJob->nLZMAPreset > 0
+            && psJob->nCompression == COMPRESSION_LZMA )
+            TIFFSetField( hTIFFTmp, TIFFTAG_LZMAPRESET, psJob->nLZMAPreset );
+
+        if( TIFFWriteEncodedStrip( hTIFFTmp, 0, psJob->pabyBuffer,
+                                   psJob->nBufferSize ) >= 0 )
+        {
+            toff_t *panOffsets = NULL, *panByteCounts = NULL;
+
+            if( TIFFGetField( hTIFFTmp, TIFFTAG_STRIPOFFSETS, &panOffsets )
+                && TIFFGetField( hTIFFTmp, TIFFTAG_STRIPBYTECOUNTS,
+                                 &panByteCounts ) )
+            {
+                nOffset = panOffsets[0];
+                nSize = panByteCounts[0];
+            }
+        }
+        XTIFFClose( hTIFFTmp );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Take the file buffer over, and move the strip to its start.     */
+/* -------------------------------------------------------------------- */
+    vsi_l_offset nDataLength = 0;
+    GByte* pabyFile = VSIGetMemFileBuffer( psJob->pszTmpFilename,
+                                           &nDataLength, TRUE );
+
+    VSIFree( psJob->pabyCompressedBuffer );
+    psJob->pabyCompressedBuffer = NULL;
+    psJob->nCompressedBufferSize = 0;
+
+    if( pabyFile != NULL && nSize > 0 && nOffset + nSize <= nDataLength )
+    {
+        memmove( pabyFile, pabyFile + (size_t)nOffset, (size_t)nSize );
+        psJob->pabyCompressedBuffer = pabyFile;
+        psJob->nCompressedBufferSize = (int) nSize;
+    }
+    else
+    {
+        VSIFree( pabyFile );
+    }
+    VSIUnlink( psJob->pszTmpFilename );
+
+    CPLAcquireMutex( poDS->hCompressMutex, 1000.0 );
+    psJob->bReady = TRUE;
+    CPLCondBroadcast( poDS->hCompressCond );
+    CPLReleaseMutex( poDS->hCompressMutex );
+}
+
+/************************************************************************/
+/*                        SubmitCompressionJob()                        */
+/*                                                                      */
+/*      Queue a copy of a strip or tile for compression.  If all jobs   */
+/*      are in flight, the oldest one is written out first so that     */
+/*      blocks reach the file in submission order.                      */
+/************************************************************************/
+
+int GTiffDataset::SubmitCompressionJob( int nStripOrTile, GByte* pabyData,
+                                        int cc, int nHeight )
+
+{
+    if( nPendingCompressionJobs == nCompressionJobs
+        && WaitCompressionJobs( nCompressionJobs - 1 ) != CE_None )
+        return FALSE;
+
+    GTiffCompressionJob* psJob = pasCompressionJobs + 
+        (nFirstPendingCompressionJob + nPendingCompressionJobs)
+            % nCompressionJobs;
+
+    if( cc > psJob->nBufferAllocSize )
+    {
+        GByte* pabyNewBuffer = (GByte*) VSIRealloc( psJob->pabyBuffer, cc );
+        if( pabyNewBuffer == NULL )
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory,
+                      "Cannot allocate %d bytes", cc );
+            return FALSE;
+        }
+        psJob->pabyBuffer = pabyNewBuffer;
+        psJob->nBufferAllocSize = cc;
+    }
+    memcpy( psJob->pabyBuffer, pabyData, cc );
+    psJob->nBufferSize = cc;
+    psJob->nStripOrTile = nStripOrTile;
+
+    uint16 nPredictor = PREDICTOR_NONE;
+    TIFFGetField( hTIFF, TIFFTAG_PREDICTOR, &nPredictor );
+
+    psJob->bBigEndian = TIFFIsBigEndian( hTIFF );
+    psJob->nWidth = nBlockXSize;
+    psJob->nHeight = nHeight;
+    psJob->nBitsPerSample = nBitsPerSample;
+    psJob->nSamplesPerPixel =
+        nPlanarConfig == PLANARCONFIG_SEPARATE ? 1 : nSamplesPerPixel;
+    psJob->nSampleFormat = nSampleFormat;
+    psJob->nCompression = nCompression;
+    psJob->nPredictor = nPredictor;
+    psJob->nZLevel = nZLevel;
+    psJob->nLZMAPreset = nLZMAPreset;
+    psJob->bReady = FALSE;
+
+    nPendingCompressionJobs++;
+
+    poCompressThreadPool->SubmitJob( ThreadCompressionFunc, psJob );
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                        WaitCompressionJobs()                         */
+/*                                                                      */
+/*      Write out the oldest pending compressed blocks, in order,       */
+/*      until at most nKeep of them remain in flight.  The current      */
+/*      directory of hTIFF must be the one of this dataset.             */
+/************************************************************************/
+
+CPLErr GTiffDataset::WaitCompressionJobs( int nKeep )
+
+{
+    CPLErr eErr = CE_None;
+
+    while( nPendingCompressionJobs > nKeep )
+    {
+        GTiffCompressionJob* psJob =
+            pasCompressionJobs + nFirstPendingCompressionJob;
+
+        CPLAcquireMutex( hCompressMutex, 1000.0 );
+        while( !psJob->bReady )
+            CPLCondWait( hCompressCond, hCompressMutex );
+        CPLReleaseMutex( hCompressMutex );
+
+        int nWritten = -1;
+        if( psJob->nCompressedBufferSize > 0 )
+        {
+            if( TIFFIsTiled( hTIFF ) )
+                nWritten = TIFFWriteRawTile( hTIFF, psJob->nStripOrTile,
+                                             psJob->pabyCompressedBuffer,
+                                             psJob->nCompressedBufferSize );
+            else
+                nWritten = TIFFWriteRawStrip( hTIFF, psJob->nStripOrTile,
+                                              psJob->pabyCompressedBuffer,
+                                              psJob->nCompressedBufferSize );
+        }
+
+        if( nWritten != psJob->nCompressedBufferSize || nWritten <= 0 )
+        {
+            CPLError( CE_Failure, CPLE_AppDefined,
+                      "Writing compressed block %d failed.",
+                      psJob->nStripOrTile );
+            bWriteErrorInFlushBlockBuf = TRUE;
+            eErr = CE_Failure;
+        }
+
+        VSIFree( psJob->pabyCompressedBuffer );
+        psJob->pabyCompressedBuffer = NULL;
+        psJob->nCompressedBufferSize = 0;
+
+        nFirstPendingCompressionJob =
+            (nFirstPendingCompressionJob + 1) % nCompressionJobs;
+        nPendingCompressionJobs--;
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                      IsCompressionJobPending()                       */
+/************************************************************************/
+
+int GTiffDataset::IsCompressionJobPending( int nStripOrTile )
+
+{
+    for( int i = 0; i < nPendingCompressionJobs; i++ )
+    {
+        if( pasCompressionJobs[(nFirstPendingCompressionJob + i)
+                               % nCompressionJobs].nStripOrTile
+            == nStripOrTile )
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/************************************************************************/
+/*                             IRasterIO()                              */
+/*                                                                      */
+/*      Pixel interleaved reads go through BlockBasedRasterIO(), and    */
+/*      thus do not reach GTiffRasterBand::IRasterIO(). Use direct I/O  */
+/*      or prefetch the blocks here in that case, and read the blocks   */
+/*      of multi band requests without splitting them band per band.   */
+/************************************************************************/
+
+CPLErr GTiffDataset::IRasterIO( GDALRWFlag eRWFlag,
+                                int nXOff, int nYOff, int nXSize, int nYSize,
+                                void * pData, int nBufXSize, int nBufYSize,
+                                GDALDataType eBufType, 
+                                int nBandCount, int *panBandMap,
+                                int nPixelSpace, int nLineSpace, int nBandSpace )
+
+{
+    int nBlockRowsPerChunk = 0;
+    GTiffRasterBand* poFirstBand = NULL;
+    int bInterleavedIO = FALSE;
+
+    if( eRWFlag == GF_Read &&
+        GDALGetRasterIOResampling( eRWFlag,
+                                   GetRasterBand(1)->GetRasterDataType(),
+                                   nXSize, nYSize, nBufXSize, nBufYSize ) == NULL &&
+        CanDirectIO( nXOff, nYOff, nXSize, nYSize, nBufXSize, nBufYSize,
+                     nBandCount, panBandMap ) )
+        return DirectIO( nXOff, nYOff, nXSize, nYSize,
+                         pData, nBufXSize, nBufYSize, eBufType,
+                         nBandCount, panBandMap,
+                         nPixelSpace, nLineSpace, nBandSpace );
+
+    if( eRWFlag == GF_Read && nXSize == nBufXSize && nYSize == nBufYSize &&
+        nBands > 1 && nPlanarConfig == PLANARCONFIG_CONTIG )
+    {
+        poFirstBand = (GTiffRasterBand*) GetRasterBand(1);
+        nBlockRowsPerChunk = poFirstBand->GetPrefetchBlockRows( nXOff, nXSize );
+        bInterleavedIO = CanInterleavedIO( nBandCount, panBandMap );
+    }
+
+    if( nBlockRowsPerChunk == 0 && bInterleavedIO )
+        return InterleavedIO( nXOff, nYOff, nXSize, nYSize, pData, eBufType,
+                              nBandCount, panBandMap,
+                              nPixelSpace, nLineSpace, nBandSpace );
+
+    if( nBlockRowsPerChunk == 0 )
+        return GDALPamDataset::IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize,
+                                          pData, nBufXSize, nBufYSize,
+                                          eBufType, nBandCount, panBandMap,
+                                          nPixelSpace, nLineSpace, nBandSpace );
+
+    int nBlockY1 = nYOff / nBlockYSize;
+    int nBlockY2 = (nYOff + nYSize - 1) / nBlockYSize;
+    CPLErr eErr = CE_None;
+
+    for( int iBlockY = nBlockY1;
+         iBlockY <= nBlockY2 && eErr == CE_None;
+         iBlockY += nBlockRowsPerChunk )
+    {
+        int iLastBlockY = MIN( nBlockY2, iBlockY + nBlockRowsPerChunk - 1 );
+        int nChunkYOff = MAX( nYOff, iBlockY * (int) nBlockYSize );
+        int nChunkYEnd = MIN( nYOff + nYSize,
+                              (iLastBlockY + 1) * (int) nBlockYSize );
+
+        poFirstBand->PrefetchBlocks( nXOff / nBlockXSize,
+                                     (nXOff + nXSize - 1) / nBlockXSize,
+                                     iBlockY, iLastBlockY );
+
+        if( bInterleavedIO )
+            eErr = InterleavedIO(
+                nXOff, nChunkYOff, nXSize, nChunkYEnd - nChunkYOff,
+                ((GByte *) pData) + (GIntBig)(nChunkYOff - nYOff) * nLineSpace,
+                eBufType, nBandCount, panBandMap,
+                nPixelSpace, nLineSpace, nBandSpace );
+        else
+            eErr = GDALPamDataset::IRasterIO(
+                eRWFlag, nXOff, nChunkYOff, nXSize, nChunkYEnd - nChunkYOff,
+                ((GByte *) pData) + (GIntBig)(nChunkYOff - nYOff) * nLineSpace,
+                nBufXSize, nChunkYEnd - nChunkYOff, eBufType,
+                nBandCount, panBandMap, nPixelSpace, nLineSpace, nBandSpace );
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                       GTiffGetDirectIOBlockSize()                    */
+/*                                                                      */
+/*      Geometry of the strips or tiles as stored in the file, which    */
+/*      may differ from the GDAL block size in the split band case.     */
+/************************************************************************/
+
+static void GTiffGetDirectIOBlockSize( TIFF *hTIFF,
+                                       int nRasterXSize, int nRasterYSize,
+                                       uint32 *pnBlockXSize,
+                                       uint32 *pnBlockYSize )
+
+{
+    if( TIFFIsTiled( hTIFF ) )
+    {
+        TIFFGetField( hTIFF, TIFFTAG_TILEWIDTH, pnBlockXSize );
+        TIFFGetField( hTIFF, TIFFTAG_TILELENGTH, pnBlockYSize );
+    }
+    else
+    {
+        *pnBlockXSize = nRasterXSize;
+        TIFFGetFieldDefaulted( hTIFF, TIFFTAG_ROWSPERSTRIP, pnBlockYSize );
+        if( *pnBlockYSize > (uint32) nRasterYSize )
+            *pnBlockYSize = nRasterYSize;
+    }
+}
+
+/************************************************************************/
+/*                            GTiffDirectRead()                         */
+/************************************************************************/
+
+static CPLErr GTiffDirectRead( VSILFILE *fp, vsi_l_offset nOffset,
+                               void *pBuffer, size_t nSize )
+
+{
+    if( nSize == 0 )
+        return CE_None;
+
+    if( VSIFSeekL( fp, nOffset, SEEK_SET ) != 0
+        || VSIFReadL( pBuffer, 1, nSize, fp ) != nSize )
+    {
+        CPLError( CE_Failure, CPLE_FileIO,
+                  "Failed to read %lu bytes at offset " CPL_FRMT_GUIB ".",
+                  (unsigned long) nSize, nOffset );
+        return CE_Failure;
+    }
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                            CanDirectIO()                             */
+/*                                                                      */
+/*      With GTIFF_DIRECT_IO=YES, uncompressed files opened in read     */
+/*      only mode are read straight from the file into the caller       */
+/*      buffer, bypassing the block cache. All the strips or tiles      */
+/*      intersecting the window must have been fully written.           */
+/*                                                                      */
+/*      Subsampled requests are left to the generic code when there     */
+/*      are overviews, so that they are read from the overviews just    */
+/*      as without direct I/O.                                          */
+/************************************************************************/
+
+int GTiffDataset::CanDirectIO( int nXOff, int nYOff, int nXSize, int nYSize,
+                               int nBufXSize, int nBufYSize,
+                               int nBandCount, int *panBandMap )
+
+{
+    if( !CSLTestBoolean( CPLGetConfigOption( "GTIFF_DIRECT_IO", "NO" ) ) )
+        return FALSE;
+
+    if( (nBufXSize < nXSize || nBufYSize < nYSize)
+        && GetRasterBand(1)->GetOverviewCount() > 0 )
+        return FALSE;
+
+    if( eAccess != GA_ReadOnly
+        || nCompression != COMPRESSION_NONE
+        || bTreatAsRGBA
+        || bTreatAsSplitBitmap
+        || nBands == 0 )
+        return FALSE;
+
+    if( nBitsPerSample != 8 &&
+        nBitsPerSample != 16 &&
+        nBitsPerSample != 32 &&
+        nBitsPerSample != 64 &&
+        nBitsPerSample != 128 )
+        return FALSE;
+
+    if( GDALGetDataTypeSize( GetRasterBand(1)->GetRasterDataType() )
+        != nBitsPerSample )
+        return FALSE;
+
+    if( !SetDirectory() )
+        return FALSE;
+
+    int bTiled = TIFFIsTiled( hTIFF );
+    toff_t *panOffsets = NULL, *panByteCounts = NULL;
+    if( !TIFFGetField( hTIFF,
+                       bTiled ? TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS,
+                       &panOffsets )
+        || !TIFFGetField( hTIFF,
+                          bTiled ? TIFFTAG_TILEBYTECOUNTS
+                                 : TIFFTAG_STRIPBYTECOUNTS,
+                          &panByteCounts )
+        || panOffsets == NULL || panByteCounts == NULL )
+        return FALSE;
+
+    uint32 nTIFFBlockXSize = 0, nTIFFBlockYSize = 0;
+    GTiffGetDirectIOBlockSize( hTIFF, nRasterXSize, nRasterYSize,
+                               &nTIFFBlockXSize, &nTIFFBlockYSize );
+    if( nTIFFBlockXSize == 0 || nTIFFBlockYSize == 0 )
+        return FALSE;
+
+    int bContig = nPlanarConfig == PLANARCONFIG_CONTIG;
+    int nPixelStride = (bContig ? nSamplesPerPixel : 1) * nBitsPerSample / 8;
+    int nPlanes = bContig ? 1 : nBandCount;
+
+    for( int iPlane = 0; iPlane < nPlanes; iPlane++ )
+    {
+        uint16 nSample = (uint16) (bContig ? 0 : panBandMap[iPlane] - 1);
+        uint32 iY, iX;
+
+        for( iY = nYOff / nTIFFBlockYSize * nTIFFBlockYSize;
+             iY < (uint32) (nYOff + nYSize); iY += nTIFFBlockYSize )
+        {
+            for( iX = nXOff / nTIFFBlockXSize * nTIFFBlockXSize;
+                 iX < (uint32) (nXOff + nXSize); iX += nTIFFBlockXSize )
+            {
+                uint32 nBlockId = bTiled
+                    ? TIFFComputeTile( hTIFF, iX, iY, 0, nSample )
+                    : TIFFComputeStrip( hTIFF, iY, nSample );
+                uint32 nRows = bTiled ? nTIFFBlockYSize
+                    : MIN( nTIFFBlockYSize, nRasterYSize - iY );
+                toff_t nExpectedSize =
+                    (toff_t) nRows * nTIFFBlockXSize * nPixelStride;
+
+                if( panOffsets[nBlockId] == 0
+                    || panByteCounts[nBlockId] < nExpectedSize )
+                    return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                              DirectIO()                              */
+/*                                                                      */
+/*      Read a window, possibly subsampled with the same nearest        */
+/*      neighbour rule as GDALRasterBand::IRasterIO(), directly from    */
+/*      the strip or tile offsets. When no translation is needed the    */
+/*      data lands in the caller buffer and reads contiguous both in    */
+/*      the file and in the buffer are merged into a single one.        */
+/*      CanDirectIO() must have been called first.                      */
+/************************************************************************/
+
+CPLErr GTiffDataset::DirectIO( int nXOff, int nYOff, int nXSize, int nYSize,
+                               void * pData, int nBufXSize, int nBufYSize,
+                               GDALDataType eBufType,
+                               int nBandCount, int *panBandMap,
+                               int nPixelSpace, int nLineSpace,
+                               int nBandSpace )
+
+{
+    GDALDataType eDataType = GetRasterBand(1)->GetRasterDataType();
+    VSILFILE *fp = (VSILFILE *) TIFFClientdata( hTIFF );
+    int bTiled = TIFFIsTiled( hTIFF );
+    int nWordBytes = nBitsPerSample / 8;
+    int bContig = nPlanarConfig == PLANARCONFIG_CONTIG;
+    int nPixelStride = (bContig ? nSamplesPerPixel : 1) * nWordBytes;
+    int bSwap = TIFFIsByteSwapped( hTIFF ) && nWordBytes > 1;
+    int nSwapWordSize = GDALDataTypeIsComplex( eDataType ) ? nWordBytes / 2
+                                                           : nWordBytes;
+
+    toff_t *panOffsets = NULL;
+    TIFFGetField( hTIFF, bTiled ? TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS,
+                  &panOffsets );
+
+    uint32 nTIFFBlockXSize = 0, nTIFFBlockYSize = 0;
+    GTiffGetDirectIOBlockSize( hTIFF, nRasterXSize, nRasterYSize,
+                               &nTIFFBlockXSize, &nTIFFBlockYSize );
+
+/* -------------------------------------------------------------------- */
+/*      Split the buffer columns in runs served by the same strip or    */
+/*      tile. When subsampling, also compute the source column of       */
+/*      each buffer column.                                             */
+/* -------------------------------------------------------------------- */
+    double dfSrcXInc = nXSize / (double) nBufXSize;
+    double dfSrcYInc = nYSize / (double) nBufYSize;
+    int bSubsampleX = nBufXSize != nXSize;
+    int *panSrcX = NULL;
+    int *panRunStart = (int *) VSIMalloc2( nBufXSize + 1, sizeof(int) );
+    int nRuns = 0;
+    int iBufX, iBufY;
+
+    if( bSubsampleX )
+        panSrcX = (int *) VSIMalloc2( nBufXSize, sizeof(int) );
+
+    if( panRunStart == NULL || (bSubsampleX && panSrcX == NULL) )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Cannot allocate direct I/O column map." );
+        CPLFree( panSrcX );
+        CPLFree( panRunStart );
+        return CE_Failure;
+    }
+
+    if( bSubsampleX )
+    {
+        for( iBufX = 0; iBufX < nBufXSize; iBufX++ )
+        {
+            panSrcX[iBufX] = MIN( nXOff + nXSize - 1,
+                                  (int) ((iBufX + 0.5) * dfSrcXInc + nXOff) );
+            if( iBufX == 0
+                || panSrcX[iBufX] / nTIFFBlockXSize
+                   != panSrcX[iBufX - 1] / nTIFFBlockXSize )
+                panRunStart[nRuns++] = iBufX;
+        }
+    }
+    else
+    {
+        for( iBufX = 0; iBufX < nBufXSize;
+             iBufX += nTIFFBlockXSize - (nXOff + iBufX) % nTIFFBlockXSize )
+            panRunStart[nRuns++] = iBufX;
+    }
+    panRunStart[nRuns] = nBufXSize;
+
+/* -------------------------------------------------------------------- */
+/*      Spans of a single sample that need no translation are read      */
+/*      straight into the caller buffer.                                */
+/* -------------------------------------------------------------------- */
+    int bReadInPlace = !bSwap && eBufType == eDataType
+        && nPixelSpace == nWordBytes && nPixelStride == nWordBytes
+        && !bSubsampleX;
+
+    GByte *pabyPending = NULL;
+    vsi_l_offset nPendingOffset = 0;
+    size_t nPendingSize = 0;
+
+    GByte *pabySpan = NULL;
+    size_t nSpanAlloc = 0;
+
+    int nPlanes = bContig ? 1 : nBandCount;
+    int nBandsPerPlane = bContig ? nBandCount : 1;
+    CPLErr eErr = CE_None;
+
+    for( int iPlane = 0; iPlane < nPlanes && eErr == CE_None; iPlane++ )
+    {
+        uint16 nSample = (uint16) (bContig ? 0 : panBandMap[iPlane] - 1);
+
+        for( iBufY = 0; iBufY < nBufYSize && eErr == CE_None; iBufY++ )
+        {
+            int iSrcY = MIN( nYOff + nYSize - 1,
+                             (int) ((iBufY + 0.5) * dfSrcYInc + nYOff) );
+            GByte *pabyDstLine = ((GByte *) pData)
+                + (GIntBig) iPlane * nBandSpace
+                + (GIntBig) iBufY * nLineSpace;
+
+            for( int iRun = 0; iRun < nRuns && eErr == CE_None; iRun++ )
+            {
+                iBufX = panRunStart[iRun];
+                int iBufXEnd = panRunStart[iRun + 1];
+                int iFirstSrcX = bSubsampleX ? panSrcX[iBufX] : nXOff + iBufX;
+                int nSrcXCount = bSubsampleX
+                    ? panSrcX[iBufXEnd - 1] - iFirstSrcX + 1
+                    : iBufXEnd - iBufX;
+                uint32 nBlockId = bTiled
+                    ? TIFFComputeTile( hTIFF, iFirstSrcX, iSrcY, 0, nSample )
+                    : TIFFComputeStrip( hTIFF, iSrcY, nSample );
+                vsi_l_offset nOffset = panOffsets[nBlockId]
+                    + ((vsi_l_offset) (iSrcY % nTIFFBlockYSize)
+                       * nTIFFBlockXSize + iFirstSrcX % nTIFFBlockXSize)
+                    * nPixelStride;
+                size_t nSize = (size_t) nSrcXCount * nPixelStride;
+                GByte *pabyDst = pabyDstLine + (GIntBig) iBufX * nPixelSpace;
+
+                if( bReadInPlace )
+                {
+                    if( pabyPending != NULL
+                        && nPendingOffset + nPendingSize == nOffset
+                        && pabyPending + nPendingSize == pabyDst )
+                    {
+                        nPendingSize += nSize;
+                    }
+                    else
+                    {
+                        if( pabyPending != NULL )
+                            eErr = GTiffDirectRead( fp, nPendingOffset,
+                                                    pabyPending, nPendingSize );
+                        pabyPending = pabyDst;
+                        nPendingOffset = nOffset;
+                        nPendingSize = nSize;
+                    }
+                    continue;
+                }
+
+/* -------------------------------------------------------------------- */
+/*      Otherwise read the span and translate it.                       */
+/* -------------------------------------------------------------------- */
+                if( nSize > nSpanAlloc )
+                {
+                    GByte *pabyNew = (GByte *) VSIRealloc( pabySpan, nSize );
+                    if( pabyNew == NULL )
+                    {
+                        CPLError( CE_Failure, CPLE_OutOfMemory,
+                                  "Cannot allocate %lu bytes.",
+                                  (unsigned long) nSize );
+                        eErr = CE_Failure;
+                        break;
+                    }
+                    pabySpan = pabyNew;
+                    nSpanAlloc = nSize;
+                }
+
+                eErr = GTiffDirectRead( fp, nOffset, pabySpan, nSize );
+                if( eErr != CE_None )
+                    break;
+
+                if( bSwap )
+                    GDALSwapWords( pabySpan, nSwapWordSize,
+                                   (int) (nSize / nSwapWordSize),
+                                   nSwapWordSize );
+
+                for( int iBand = 0; iBand < nBandsPerPlane; iBand++ )
+                {
+                    GByte *pabySrc = pabySpan;
+                    GByte *pabyBandDst = pabyDst;
+
+                    if( bContig )
+                    {
+                        pabySrc += (panBandMap[iBand] - 1) * nWordBytes;
+                        pabyBandDst += (GIntBig) iBand * nBandSpace;
+                    }
+
+                    if( !bSubsampleX )
+                    {
+                        GDALCopyWords( pabySrc, eDataType, nPixelStride,
+                                       pabyBandDst, eBufType, nPixelSpace,
+                                       iBufXEnd - iBufX );
+                        continue;
+                    }
+
+                    for( int i = iBufX; i < iBufXEnd; i++ )
+                    {
+                        GByte *pabyPixel = pabySrc
+                            + (panSrcX[i] - iFirstSrcX) * nPixelStride;
+                        GByte *pabyPixelDst = pabyBandDst
+                            + (GIntBig) (i - iBufX) * nPixelSpace;
+
+                        if( eBufType == eDataType )
+                            memcpy( pabyPixelDst, pabyPixel, nWordBytes );
+                        else
+                            GDALCopyWords( pabyPixel, eDataType, 0,
+                                           pabyPixelDst, eBufType, 0, 1 );
+                    }
+                }
+            }
+        }
+    }
+
+    if( eErr == CE_None && pabyPending != NULL )
+        eErr = GTiffDirectRead( fp, nPendingOffset, pabyPending, nPendingSize );
+
+    VSIFree( pabySpan );
+    CPLFree( panSrcX );
+    CPLFree( panRunStart );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                          CanInterleavedIO()                          */
+/*                                                                      */
+/*      Multi band reads of a pixel interleaved file whose bands are    */
+/*      plain GTiffRasterBand objects qualify.                          */
+/************************************************************************/
+
+int GTiffDataset::CanInterleavedIO( int nBandCount, int *panBandMap )
+
+{
+    if( eAccess != GA_ReadOnly
+        || nBandCount < 2
+        || nBands != nSamplesPerPixel
+        || nPlanarConfig != PLANARCONFIG_CONTIG
+        || bTreatAsRGBA
+        || bTreatAsSplit
+        || bTreatAsSplitBitmap )
+        return FALSE;
+
+    if( nBitsPerSample != 8 &&
+        nBitsPerSample != 16 &&
+        nBitsPerSample != 32 &&
+        nBitsPerSample != 64 &&
+        nBitsPerSample != 128 )
+        return FALSE;
+
+    if( GDALGetDataTypeSize( GetRasterBand(1)->GetRasterDataType() )
+        != nBitsPerSample )
+        return FALSE;
+
+    return SetDirectory();
+}
+
+/************************************************************************/
+/*                           InterleavedIO()                            */
+/*                                                                      */
+/*      Read a window at full resolution block by block. The blocks     */
+/*      fully covered by the window are copied from the pixel           */
+/*      interleaved block buffer, whole pixels at once when the         */
+/*      buffer has the same layout, instead of being split into the     */
+/*      block cache of each band and gathered back. The other blocks,   */
+/*      likely to be needed again by the neighbouring windows, the      */
+/*      blocks already cached and the missing blocks of sparse files    */
+/*      go through the block cache.                                     */
+/*      CanInterleavedIO() must have been called first.                 */
+/************************************************************************/
+
+CPLErr GTiffDataset::InterleavedIO( int nXOff, int nYOff,
+                                    int nXSize, int nYSize,
+                                    void * pData, GDALDataType eBufType,
+                                    int nBandCount, int *panBandMap,
+                                    int nPixelSpace, int nLineSpace,
+                                    int nBandSpace )
+
+{
+    GDALDataType eDataType = GetRasterBand(1)->GetRasterDataType();
+    int nWordBytes = nBitsPerSample / 8;
+    int nPixelStride = nBands * nWordBytes;
+    int nBlocksPerRow = (nRasterXSize + nBlockXSize - 1) / nBlockXSize;
+    int iBand;
+
+    int bSameLayout = eBufType == eDataType && nBandCount == nBands
+        && nPixelSpace == nPixelStride && nBandSpace == nWordBytes;
+    for( iBand = 0; iBand < nBandCount && bSameLayout; iBand++ )
+    {
+        if( panBandMap[iBand] != iBand + 1 )
+            bSameLayout = FALSE;
+    }
+
+    int nBlockX1 = nXOff / nBlockXSize;
+    int nBlockX2 = (nXOff + nXSize - 1) / nBlockXSize;
+    int nBlockY1 = nYOff / nBlockYSize;
+    int nBlockY2 = (nYOff + nYSize - 1) / nBlockYSize;
+    CPLErr eErr = CE_None;
+
+    for( int iBlockY = nBlockY1; iBlockY <= nBlockY2 && eErr == CE_None;
+         iBlockY++ )
+    {
+        int nBlockYStart = iBlockY * nBlockYSize;
+        int nBlockYEnd = MIN( nRasterYSize, nBlockYStart + (int) nBlockYSize );
+        int nChunkYOff = MAX( nYOff, nBlockYStart );
+        int nChunkYEnd = MIN( nYOff + nYSize, nBlockYEnd );
+
+        for( int iBlockX = nBlockX1; iBlockX <= nBlockX2 && eErr == CE_None;
+             iBlockX++ )
+        {
+            int nBlockXStart = iBlockX * nBlockXSize;
+            int nBlockXEnd = MIN( nRasterXSize,
+                                  nBlockXStart + (int) nBlockXSize );
+            int nChunkXOff = MAX( nXOff, nBlockXStart );
+            int nChunkXEnd = MIN( nXOff + nXSize, nBlockXEnd );
+            GByte *pabyChunkData = ((GByte *) pData)
+                + (GIntBig) (nChunkYOff - nYOff) * nLineSpace
+                + (GIntBig) (nChunkXOff - nXOff) * nPixelSpace;
+
+            int nBlockId = iBlockX + iBlockY * nBlocksPerRow;
+            int bUseCache = nChunkXOff != nBlockXStart
+                || nChunkXEnd != nBlockXEnd
+                || nChunkYOff != nBlockYStart
+                || nChunkYEnd != nBlockYEnd;
+
+            /* Missing (sparse) blocks are filled with the nodata value */
+            /* by IReadBlock(), not by LoadBlockBuf(). */
+            if( !bUseCache && !IsBlockAvailable( nBlockId ) )
+                bUseCache = TRUE;
+
+            for( iBand = 0; iBand < nBandCount && !bUseCache; iBand++ )
+            {
+                GTiffRasterBand *poBand =
+                    (GTiffRasterBand *) GetRasterBand( panBandMap[iBand] );
+                GDALRasterBlock *poBlock =
+                    poBand->TryGetLockedBlockRef( iBlockX, iBlockY );
+                if( poBlock == NULL )
+                    break;
+                poBlock->DropLock();
+                if( iBand == nBandCount - 1 )
+                    bUseCache = TRUE;
+            }
+
+            if( bUseCache )
+            {
+                for( iBand = 0; iBand < nBandCount && eErr == CE_None;
+                     iBand++ )
+                {
+                    GTiffRasterBand *poBand =
+                        (GTiffRasterBand *) GetRasterBand( panBandMap[iBand] );
+
+                    eErr = poBand->GDALRasterBand::IRasterIO(
+                        GF_Read, nChunkXOff, nChunkYOff,
+                        nChunkXEnd - nChunkXOff, nChunkYEnd - nChunkYOff,
+                        pabyChunkData + (GIntBig) iBand * nBandSpace,
+                        nChunkXEnd - nChunkXOff, nChunkYEnd - nChunkYOff,
+                        eBufType, nPixelSpace, nLineSpace );
+                }
+                continue;
+            }
+
+/* -------------------------------------------------------------------- */
+/*      Copy the block from the interleaved block buffer.               */
+/* -------------------------------------------------------------------- */
+            eErr = LoadBlockBuf( nBlockId );
+            if( eErr != CE_None )
+                break;
+
+            for( int iY = nChunkYOff; iY < nChunkYEnd; iY++ )
+            {
+                GByte *pabySrc = pabyBlockBuf
+                    + (GIntBig) (iY - nBlockYStart) * nBlockXSize
+                    * nPixelStride;
+                GByte *pabyDst = pabyChunkData
+                    + (GIntBig) (iY - nChunkYOff) * nLineSpace;
+
+                if( bSameLayout )
+                {
+                    memcpy( pabyDst, pabySrc,
+                            (size_t) (nChunkXEnd - nChunkXOff)
+                            * nPixelStride );
+                    continue;
+                }
+
+                for( iBand = 0; iBand < nBandCount; iBand++ )
+                    GDALCopyWords( pabySrc + (panBandMap[iBand] - 1)
+                                   * nWordBytes,
+                                   eDataType, nPixelStride,
+                                   pabyDst + (GIntBig) iBand * nBandSpace,
+                                   eBufType, nPixelSpace,
+                                   nChunkXEnd - nChunkXOff );
+            }
+        }
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         GetVirtualMemAuto()                          */
+/************************************************************************/
+
+CPLVirtualMem *GTiffRasterBand::GetVirtualMemAuto( GDALRWFlag eRWFlag,
+                                                   int *pnPixelSpace,
+                                                   GIntBig *pnLineSpace,
+                                                   char **papszOptions )
+
+{
+    CPLVirtualMem *psVMem = NULL;
+
+    if( !CSLTestBoolean( CSLFetchNameValueDef( papszOptions,
+                                               "USE_DEFAULT_IMPLEMENTATION",
+                                               "NO" ) ) )
+        psVMem = GetVirtualMemAutoFromStrips( eRWFlag, pnPixelSpace,
+                                              pnLineSpace );
+
+    if( psVMem == NULL )
+        psVMem = GDALPamRasterBand::GetVirtualMemAuto( eRWFlag, pnPixelSpace,
+                                                       pnLineSpace,
+                                                       papszOptions );
+
+    return psVMem;
+}
+
+/************************************************************************/
+/*                    GetVirtualMemAutoFromStrips()                     */
+/*                                                                      */
+/*      Map the file itself when the band is made of uncompressed       */
+/*      strips in native byte order stored back to back, as written     */
+/*      by default by the driver. Return NULL otherwise.                */
+/************************************************************************/
+
+CPLVirtualMem *GTiffRasterBand::GetVirtualMemAutoFromStrips(
+    GDALRWFlag eRWFlag, int *pnPixelSpace, GIntBig *pnLineSpace )
+
+{
+    TIFF *hTIFF = poGDS->hTIFF;
+    int nWordBytes = poGDS->nBitsPerSample / 8;
+
+    if( !CPLIsVirtualMemFileMapAvailable()
+        || poGDS->nCompression != COMPRESSION_NONE
+        || poGDS->bTreatAsRGBA
+        || poGDS->bTreatAsSplitBitmap
+        || TIFFIsTiled( hTIFF )
+        || (TIFFIsByteSwapped( hTIFF ) && nWordBytes > 1) )
+        return NULL;
+
+    if( poGDS->nBitsPerSample != 8 &&
+        poGDS->nBitsPerSample != 16 &&
+        poGDS->nBitsPerSample != 32 &&
+        poGDS->nBitsPerSample != 64 &&
+        poGDS->nBitsPerSample != 128 )
+        return NULL;
+
+    if( GDALGetDataTypeSize( eDataType ) != poGDS->nBitsPerSample )
+        return NULL;
+
+    VSILFILE *fp = (VSILFILE *) TIFFClientdata( hTIFF );
+    if( VSIFGetNativeFileDescriptorL( fp ) == NULL )
+        return NULL;
+
+    /* Pending blocks must reach the file, and the cached ones must */
+    /* not diverge from the mapping */
+    if( poGDS->GetAccess() == GA_Update )
+        poGDS->FlushCache();
+
+    if( !poGDS->SetDirectory() )
+        return NULL;
+
+    toff_t *panOffsets = NULL, *panByteCounts = NULL;
+    if( !TIFFGetField( hTIFF, TIFFTAG_STRIPOFFSETS, &panOffsets )
+        || !TIFFGetField( hTIFF, TIFFTAG_STRIPBYTECOUNTS, &panByteCounts )
+        || panOffsets == NULL || panByteCounts == NULL )
+        return NULL;
+
+    uint32 nTIFFBlockXSize = 0, nRowsPerStrip = 0;
+    GTiffGetDirectIOBlockSize( hTIFF, nRasterXSize, nRasterYSize,
+                               &nTIFFBlockXSize, &nRowsPerStrip );
+    if( nRowsPerStrip == 0 )
+        return NULL;
+
+/* -------------------------------------------------------------------- */
+/*      Check that the strips of the band are complete and contiguous.  */
+/* -------------------------------------------------------------------- */
+    int bContig = poGDS->nPlanarConfig == PLANARCONFIG_CONTIG;
+    int nPixelStride = (bContig ? poGDS->nSamplesPerPixel : 1) * nWordBytes;
+    toff_t nLineSize = (toff_t) nRasterXSize * nPixelStride;
+    int nStripsPerBand = (nRasterYSize + nRowsPerStrip - 1) / nRowsPerStrip;
+    int iFirstStrip = bContig ? 0 : (nBand - 1) * nStripsPerBand;
+
+    for( int iStrip = 0; iStrip < nStripsPerBand; iStrip++ )
+    {
+        toff_t nRows = MIN( nRowsPerStrip,
+                            nRasterYSize - iStrip * nRowsPerStrip );
 
-    return bHasDroppedRef;
-}
+        if( panOffsets[iFirstStrip + iStrip] == 0
+            || panByteCounts[iFirstStrip + iStrip] < nRows * nLineSize
+            || panOffsets[iFirstStrip + iStrip] != panOffsets[iFirstStrip]
+                   + (toff_t) iStrip * nRowsPerStrip * nLineSize )
+            return NULL;
+    }
 
-/************************************************************************/
-/*                        CloseDependentDatasets()                      */
-/************************************************************************/
+    vsi_l_offset nStart = panOffsets[iFirstStrip]
+        + (bContig ? (nBand - 1) * nWordBytes : 0);
+    vsi_l_offset nLength = (vsi_l_offset) (nRasterYSize - 1) * nLineSize
+        + (vsi_l_offset) (nRasterXSize - 1) * nPixelStride + nWordBytes;
 
-int GTiffDataset::CloseDependentDatasets()
-{
-    if (!bBase)
-        return FALSE;
+    CPLPushErrorHandler( CPLQuietErrorHandler );
+    CPLVirtualMem *psVMem = CPLVirtualMemFileMapNew(
+        fp, nStart, nLength,
+        eRWFlag == GF_Write ? VIRTUALMEM_READWRITE : VIRTUALMEM_READONLY,
+        NULL, NULL );
+    CPLPopErrorHandler();
 
-    int bHasDroppedRef = GDALPamDataset::CloseDependentDatasets();
+    if( psVMem == NULL )
+        return NULL;
 
-    bHasDroppedRef |= Finalize();
+    if( pnPixelSpace != NULL )
+        *pnPixelSpace = nPixelStride;
+    if( pnLineSpace != NULL )
+        *pnLineSpace = (GIntBig) nLineSize;
 
-    return bHasDroppedRef;
+    return psVMem;
 }
 
 /************************************************************************/
-/*                           FillEmptyTiles()                           */
+/*                      InitDecompressionThreads()                      */
+/*                                                                      */
+/*      Lazily start the worker threads requested with the              */
+/*      GDAL_NUM_THREADS configuration option for decoding blocks.      */
+/*      Overviews and masks use the thread pool of their base           */
+/*      dataset, and only have their own libtiff handles.               */
 /************************************************************************/
 
-void GTiffDataset::FillEmptyTiles()
+int GTiffDataset::InitDecompressionThreads()
 
 {
-    toff_t *panByteCounts = NULL;
-    int    nBlockCount, iBlock;
+    if( bDecompressThreadPoolInit )
+        return poDecompressThreadPool != NULL;
 
-    if (!SetDirectory())
-        return;
+    bDecompressThreadPoolInit = TRUE;
 
-/* -------------------------------------------------------------------- */
-/*      How many blocks are there in this file?                         */
-/* -------------------------------------------------------------------- */
-    if( nPlanarConfig == PLANARCONFIG_SEPARATE )
-        nBlockCount = nBlocksPerBand * nBands;
-    else
-        nBlockCount = nBlocksPerBand;
+    if( poBaseDS != NULL )
+    {
+        if( !poBaseDS->InitDecompressionThreads() )
+            return FALSE;
 
-/* -------------------------------------------------------------------- */
-/*      Fetch block maps.                                               */
-/* -------------------------------------------------------------------- */
-    if( TIFFIsTiled( hTIFF ) )
-        TIFFGetField( hTIFF, TIFFTAG_TILEBYTECOUNTS, &panByteCounts );
+        poDecompressThreadPool = poBaseDS->poDecompressThreadPool;
+    }
     else
-        TIFFGetField( hTIFF, TIFFTAG_STRIPBYTECOUNTS, &panByteCounts );
-
-    if (panByteCounts == NULL)
     {
-        /* Got here with libtiff 3.9.3 and tiff_write_8 test */
-        CPLError(CE_Failure, CPLE_AppDefined, "FillEmptyTiles() failed because panByteCounts == NULL");
-        return;
+        if( !CreateDecompressionThreadPool() )
+            return FALSE;
     }
 
-/* -------------------------------------------------------------------- */
-/*      Prepare a blank data buffer to write for uninitialized blocks.  */
-/* -------------------------------------------------------------------- */
-    int nBlockBytes;
+    osDecompressFilename = TIFFFileName( hTIFF );
+    hDecompressMutex = CPLCreateMutex();
+    CPLReleaseMutex( hDecompressMutex );
 
-    if( TIFFIsTiled( hTIFF ) )
-        nBlockBytes = TIFFTileSize(hTIFF);
+    return TRUE;
+}
+
+/************************************************************************/
+/*                   CreateDecompressionThreadPool()                    */
+/************************************************************************/
+
+int GTiffDataset::CreateDecompressionThreadPool()
+
+{
+    const char* pszValue = CPLGetConfigOption( "GDAL_NUM_THREADS", "1" );
+    int nThreads;
+    if( EQUAL(pszValue, "ALL_CPUS") )
+        nThreads = CPLGetNumCPUs();
     else
-        nBlockBytes = TIFFStripSize(hTIFF);
+        nThreads = atoi( pszValue );
+    if( nThreads > 128 )
+        nThreads = 128;
+    if( nThreads <= 1 )
+        return FALSE;
 
-    GByte *pabyData = (GByte *) VSICalloc(nBlockBytes,1);
-    if (pabyData == NULL)
+    poDecompressThreadPool = new CPLWorkerThreadPool();
+    if( !poDecompressThreadPool->Setup( nThreads ) )
     {
-        CPLError(CE_Failure, CPLE_OutOfMemory,
-                 "Cannot allocate %d bytes", nBlockBytes);
-        return;
+        delete poDecompressThreadPool;
+        poDecompressThreadPool = NULL;
+        return FALSE;
     }
 
-/* -------------------------------------------------------------------- */
-/*      Check all blocks, writing out data for uninitialized blocks.    */
-/* -------------------------------------------------------------------- */
-    for( iBlock = 0; iBlock < nBlockCount; iBlock++ )
-    {
-        if( panByteCounts[iBlock] == 0 )
-        {
-            if( WriteEncodedTileOrStrip( iBlock, pabyData, FALSE ) != CE_None )
-                break;
-        }
-    }
+    CPLDebug( "GTiff", "Using %d threads for decompression.", nThreads );
 
-    CPLFree( pabyData );
+    return TRUE;
 }
 
 /************************************************************************/
-/*                        WriteEncodedTile()                            */
+/*                 libtiff I/O procs of decompress handles              */
 /************************************************************************/
 
-int GTiffDataset::WriteEncodedTile(uint32 tile, GByte *pabyData,
-                                   int bPreserveDataBuffer)
+static tsize_t GTiffDecompressReadProc( thandle_t th, tdata_t buf,
+                                        tsize_t size )
 {
-    int cc = TIFFTileSize( hTIFF );
-    int bNeedTileFill = FALSE;
-    int iRow=0, iColumn=0;
-    int nBlocksPerRow=1, nBlocksPerColumn=1;
+    GTiffDecompressHandle* psHandle = (GTiffDecompressHandle*) th;
 
-    /* 
-    ** Do we need to spread edge values right or down for a partial 
-    ** JPEG encoded tile?  We do this to avoid edge artifacts. 
-    */
-    if( nCompression == COMPRESSION_JPEG )
+    if( psHandle->pabyRaw != NULL
+        && psHandle->nPos >= psHandle->nRawOffset
+        && psHandle->nPos + size <= psHandle->nRawOffset + psHandle->nRawSize )
     {
-        nBlocksPerRow = (nRasterXSize + nBlockXSize - 1) / nBlockXSize;
-        nBlocksPerColumn = (nRasterYSize + nBlockYSize - 1) / nBlockYSize;
+        memcpy( buf, psHandle->pabyRaw + (psHandle->nPos - psHandle->nRawOffset),
+                size );
+        psHandle->nPos += size;
+        return size;
+    }
 
-        iColumn = (tile % nBlocksPerBand) % nBlocksPerRow;
-        iRow = (tile % nBlocksPerBand) / nBlocksPerRow;
+    if( VSIFSeekL( psHandle->fp, psHandle->nPos, SEEK_SET ) != 0 )
+        return 0;
+    tsize_t nRead = VSIFReadL( buf, 1, size, psHandle->fp );
+    psHandle->nPos += nRead;
+    return nRead;
+}
 
-        // Is this a partial right edge tile?
-        if( iRow == nBlocksPerRow - 1
-            && nRasterXSize % nBlockXSize != 0 )
-            bNeedTileFill = TRUE;
+static tsize_t GTiffDecompressWriteProc( thandle_t, tdata_t, tsize_t )
+{
+    return 0;
+}
 
-        // Is this a partial bottom edge tile?
-        if( iColumn == nBlocksPerColumn - 1
-            && nRasterYSize % nBlockYSize != 0 )
-            bNeedTileFill = TRUE;
-    }
+static toff_t GTiffDecompressSeekProc( thandle_t th, toff_t off, int whence )
+{
+    GTiffDecompressHandle* psHandle = (GTiffDecompressHandle*) th;
 
-    /* 
-    ** If we need to fill out the tile, or if we want to prevent
-    ** TIFFWriteEncodedTile from altering the buffer as part of
-    ** byte swapping the data on write then we will need a temporary
-    ** working buffer.  If not, we can just do a direct write. 
-    */
-    if (bPreserveDataBuffer 
-        && (TIFFIsByteSwapped(hTIFF) || bNeedTileFill) )
+    if( whence == SEEK_SET )
+        psHandle->nPos = off;
+    else if( whence == SEEK_CUR )
+        psHandle->nPos += off;
+    else
     {
-        if (cc != nTempWriteBufferSize)
-        {
-            pabyTempWriteBuffer = CPLRealloc(pabyTempWriteBuffer, cc);
-            nTempWriteBufferSize = cc;
-        }
-        memcpy(pabyTempWriteBuffer, pabyData, cc);
-
-        pabyData = (GByte *) pabyTempWriteBuffer;
+        VSIFSeekL( psHandle->fp, 0, SEEK_END );
+        psHandle->nPos = VSIFTellL( psHandle->fp ) + off;
     }
+    return psHandle->nPos;
+}
 
-    /*
-    ** Perform tile fill if needed.
-    */
-    if( bNeedTileFill )
-    {
-        int nRightPixelsToFill = 0;
-        int nBottomPixelsToFill = 0;
-        int nPixelSize = cc / (nBlockXSize * nBlockYSize);
-        unsigned int iX, iY, iSrcX, iSrcY;
-        
-        CPLDebug( "GTiff", "Filling out jpeg edge tile on write." );
-
-        if( iColumn == nBlocksPerRow - 1 )
-            nRightPixelsToFill = nBlockXSize * (iColumn+1) - nRasterXSize;
-        if( iRow == nBlocksPerColumn - 1 )
-            nBottomPixelsToFill = nBlockYSize * (iRow+1) - nRasterYSize;
+static int GTiffDecompressCloseProc( thandle_t )
+{
+    return 0;
+}
 
-        // Fill out to the right. 
-        iSrcX = nBlockXSize - nRightPixelsToFill - 1;
+static toff_t GTiffDecompressSizeProc( thandle_t th )
+{
+    GTiffDecompressHandle* psHandle = (GTiffDecompressHandle*) th;
 
-        for( iX = iSrcX+1; iX < nBlockXSize; iX++ )
-        {
-            for( iY = 0; iY < nBlockYSize; iY++ )
-            {
-                memcpy( pabyData + (nBlockXSize * iY + iX) * nPixelSize, 
-                        pabyData + (nBlockXSize * iY + iSrcX) * nPixelSize, 
-                        nPixelSize );
-            }
-        }
+    VSIFSeekL( psHandle->fp, 0, SEEK_END );
+    return VSIFTellL( psHandle->fp );
+}
 
-        // now fill out the bottom.
-        iSrcY = nBlockYSize - nBottomPixelsToFill - 1;
-        for( iY = iSrcY+1; iY < nBlockYSize; iY++ )
-        {
-            memcpy( pabyData + nBlockXSize * nPixelSize * iY, 
-                    pabyData + nBlockXSize * nPixelSize * iSrcY, 
-                    nPixelSize * nBlockXSize );
-        }
-    }
+static int GTiffDecompressMapProc( thandle_t, tdata_t*, toff_t* )
+{
+    return 0;
+}
 
-    return TIFFWriteEncodedTile(hTIFF, tile, pabyData, cc);
+static void GTiffDecompressUnmapProc( thandle_t, tdata_t, toff_t )
+{
 }
 
 /************************************************************************/
-/*                        WriteEncodedStrip()                           */
+/*                      AcquireDecompressHandle()                       */
+/*                                                                      */
+/*      Take an idle handle, or open a new one on the same file and     */
+/*      directory.  Called from worker threads.                         */
 /************************************************************************/
 
-int  GTiffDataset::WriteEncodedStrip(uint32 strip, GByte* pabyData,
-                                     int bPreserveDataBuffer)
+GTiffDecompressHandle *GTiffDataset::AcquireDecompressHandle()
+
 {
-    int cc = TIFFStripSize( hTIFF );
-    
-/* -------------------------------------------------------------------- */
-/*      If this is the last strip in the image, and is partial, then    */
-/*      we need to trim the number of scanlines written to the          */
-/*      amount of valid data we have. (#2748)                           */
-/* -------------------------------------------------------------------- */
-    int nStripWithinBand = strip % nBlocksPerBand;
-    
-    if( (int) ((nStripWithinBand+1) * nRowsPerStrip) > GetRasterYSize() )
     {
-        cc = (cc / nRowsPerStrip)
-            * (GetRasterYSize() - nStripWithinBand * nRowsPerStrip);
-        CPLDebug( "GTiff", "Adjusted bytes to write from %d to %d.", 
-                  (int) TIFFStripSize(hTIFF), cc );
+        CPLMutexHolderD( &hDecompressMutex );
+        if( nDecompressHandles > 0 )
+            return papsDecompressHandles[--nDecompressHandles];
     }
 
-/* -------------------------------------------------------------------- */
-/*      TIFFWriteEncodedStrip can alter the passed buffer if            */
-/*      byte-swapping is necessary so we use a temporary buffer         */
-/*      before calling it.                                              */
-/* -------------------------------------------------------------------- */
-    if (bPreserveDataBuffer && TIFFIsByteSwapped(hTIFF))
+    GTiffDecompressHandle* psHandle = (GTiffDecompressHandle*)
+        CPLCalloc( 1, sizeof(GTiffDecompressHandle) );
+
+    psHandle->fp = VSIFOpenL( osDecompressFilename, "rb" );
+    if( psHandle->fp != NULL )
+        psHandle->hTIFF = XTIFFClientOpen( osDecompressFilename, "r",
+                                           (thandle_t) psHandle,
+                                           GTiffDecompressReadProc,
+                                           GTiffDecompressWriteProc,
+                                           GTiffDecompressSeekProc,
+                                           GTiffDecompressCloseProc,
+                                           GTiffDecompressSizeProc,
+                                           GTiffDecompressMapProc,
+                                           GTiffDecompressUnmapProc );
+
+    if( psHandle->hTIFF == NULL
+        || !TIFFSetSubDirectory( psHandle->hTIFF, nDirOffset ) )
     {
-        if (cc != nTempWriteBufferSize)
-        {
-            pabyTempWriteBuffer = CPLRealloc(pabyTempWriteBuffer, cc);
-            nTempWriteBufferSize = cc;
-        }
-        memcpy(pabyTempWriteBuffer, pabyData, cc);
-        return TIFFWriteEncodedStrip(hTIFF, strip, pabyTempWriteBuffer, cc);
+        if( psHandle->hTIFF != NULL )
+            XTIFFClose( psHandle->hTIFF );
+        if( psHandle->fp != NULL )
+            VSIFCloseL( psHandle->fp );
+        CPLFree( psHandle );
+        return NULL;
     }
-    else
-        return TIFFWriteEncodedStrip(hTIFF, strip, pabyData, cc);
+
+    /* Same on the fly YCbCr to RGB translation as in SetDirectory() */
+    if( nCompression == COMPRESSION_JPEG 
+        && nPhotometric == PHOTOMETRIC_YCBCR 
+        && CSLTestBoolean( CPLGetConfigOption("CONVERT_YCBCR_TO_RGB",
+                                              "YES") ) )
+        TIFFSetField( psHandle->hTIFF, TIFFTAG_JPEGCOLORMODE,
+                      JPEGCOLORMODE_RGB );
+
+    return psHandle;
 }
 
 /************************************************************************/
-/*                  WriteEncodedTileOrStrip()                           */
+/*                      ReleaseDecompressHandle()                       */
 /************************************************************************/
 
-CPLErr  GTiffDataset::WriteEncodedTileOrStrip(uint32 tile_or_strip, void* data,
-                                              int bPreserveDataBuffer)
+void GTiffDataset::ReleaseDecompressHandle( GTiffDecompressHandle* psHandle )
+
 {
-    CPLErr eErr = CE_None;
+    CPLMutexHolderD( &hDecompressMutex );
 
-    if( TIFFIsTiled( hTIFF ) )
-    {
-        if( WriteEncodedTile(tile_or_strip, (GByte*) data, 
-                             bPreserveDataBuffer) == -1 )
-        {
-            eErr = CE_Failure;
-        }
-    }
+    papsDecompressHandles = (GTiffDecompressHandle**)
+        CPLRealloc( papsDecompressHandles,
+                    (nDecompressHandles + 1) * sizeof(GTiffDecompressHandle*) );
+    papsDecompressHandles[nDecompressHandles++] = psHandle;
+}
+
+/************************************************************************/
+/*                      ThreadDecompressionFunc()                       */
+/************************************************************************/
+
+void GTiffDataset::ThreadDecompressionFunc( void* pData )
+
+{
+    GTiffDecompressionJob* psJob = (GTiffDecompressionJob*) pData;
+    GTiffDataset* poDS = psJob->poDS;
+
+    GTiffDecompressHandle* psHandle = poDS->AcquireDecompressHandle();
+    if( psHandle == NULL )
+        return;
+
+    psHandle->pabyRaw = psJob->pabyRaw;
+    psHandle->nRawOffset = psJob->nRawOffset;
+    psHandle->nRawSize = psJob->nRawSize;
+
+    if( TIFFIsTiled( psHandle->hTIFF ) )
+        psJob->bSuccess =
+            TIFFReadEncodedTile( psHandle->hTIFF, psJob->nBlockId,
+                                 psJob->pabyData,
+                                 psJob->nBlockReqSize ) != -1;
     else
-    {
-        if( WriteEncodedStrip(tile_or_strip, (GByte *) data, 
-                              bPreserveDataBuffer) == -1 )
-        {
-            eErr = CE_Failure;
-        }
-    }
+        psJob->bSuccess =
+            TIFFReadEncodedStrip( psHandle->hTIFF, psJob->nBlockId,
+                                  psJob->pabyData,
+                                  psJob->nBlockReqSize ) != -1;
 
-    return eErr;
+    psHandle->pabyRaw = NULL;
+
+    poDS->ReleaseDecompressHandle( psHandle );
 }
 
 /************************************************************************/
@@ -3472,6 +5496,11 @@ int GTiffDataset::IsBlockAvailable( int nBlockId )
 {
     toff_t *panByteCounts = NULL;
 
+    /* A block still being compressed must reach the file before it */
+    /* can be read back */
+    if( IsCompressionJobPending( nBlockId ) )
+        WaitCompressionJobs();
+
     if( ( TIFFIsTiled( hTIFF ) 
           && TIFFGetField( hTIFF, TIFFTAG_TILEBYTECOUNTS, &panByteCounts ) )
         || ( !TIFFIsTiled( hTIFF ) 
@@ -3523,6 +5552,10 @@ void GTiffDataset::FlushDirectory()
 {
     if( GetAccess() == GA_Update )
     {
+        /* This is either the active directory, or about to be left, */
+        /* so pending compressed blocks must be written out now */
+        WaitCompressionJobs();
+
         if( bMetadataChanged )
         {
             if (!SetDirectory())
@@ -3734,6 +5767,8 @@ CPLErr GTiffDataset::RegisterNewOverviewDataset(toff_t nOverviewOffset)
                         nOverviewCount * (sizeof(void*)));
         papoOverviewDS[nOverviewCount-1] = poODS;
         poODS->poBaseDS = this;
+        if( poCompressThreadPool != NULL )
+            poODS->SetupCompressionJobs( poCompressThreadPool );
         return CE_None;
     }
 }
@@ -7373,6 +9408,8 @@ GDALDataset *GTiffDataset::Create( const char * pszFilename,
     poDS->nLZMAPreset = GTiffGetLZMAPreset(papszParmList);
     poDS->nJpegQuality = GTiffGetJpegQuality(papszParmList);
 
+    poDS->InitCompressionThreads(papszParmList);
+
 /* -------------------------------------------------------------------- */
 /*      If we are writing jpeg compression we need to write some        */
 /*      imagery to force the jpegtables to get created.  This is,       */
@@ -8036,6 +10073,8 @@ GTiffDataset::CreateCopy( const char * pszFilename, GDALDataset *poSrcDS,
         }
     }
 
+    poDS->InitCompressionThreads(papszOptions);
+
     /* Precreate (internal) mask, so that the IBuildOverviews() below */
     /* has a chance to create also the overviews of the mask */
     int nMaskFlags = poSrcDS->GetRasterBand(1)->GetMaskFlags();
@@ -8783,6 +10822,9 @@ CPLErr GTiffDataset::CreateMaskBand(int nFlags)
             return CE_Failure;
         }
 
+        if( poCompressThreadPool != NULL )
+            poMaskDS->SetupCompressionJobs( poCompressThreadPool );
+
         return CE_None;
     }
     else
@@ -9147,6 +11189,7 @@ void GDALRegister_GTiff()
 "       <Value>ITULAB</Value>"
 "   </Option>"
 "   <Option name='SPARSE_OK' type='boolean' description='Can newly created files have missing blocks?' default='FALSE'/>"
+"   <Option name='NUM_THREADS' type='string' description='Number of worker threads for DEFLATE, LZW, PACKBITS or LZMA compression. Can be set to ALL_CPUS' default='1'/>"
 "   <Option name='ALPHA' type='boolean' description='Mark first extrasample as being alpha'/>"
 "   <Option name='PROFILE' type='string-select' default='GDALGeoTIFF'>"
 "       <Value>GDALGeoTIFF</Value>"
@@ -691,6 +691,114 @@ CPLErr MEMDataset::AddBand( GDALDataType eType, char **papszOptions )
     return CE_None;
 }
 
+/************************************************************************/
+/*                             IRasterIO()                              */
+/*                                                                      */
+/*      Full resolution requests are copied straight between the band   */
+/*      arrays and the caller buffer, rather than through the block     */
+/*      cache of each band, and whole pixels at once when both are      */
+/*      pixel interleaved the same way.                                 */
+/************************************************************************/
+
+CPLErr MEMDataset::IRasterIO( GDALRWFlag eRWFlag,
+                              int nXOff, int nYOff, int nXSize, int nYSize,
+                              void * pData, int nBufXSize, int nBufYSize,
+                              GDALDataType eBufType,
+                              int nBandCount, int *panBandMap,
+                              int nPixelSpace, int nLineSpace, int nBandSpace )
+
+{
+    if( nXSize != nBufXSize || nYSize != nBufYSize )
+        return GDALDataset::IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize,
+                                       pData, nBufXSize, nBufYSize,
+                                       eBufType, nBandCount, panBandMap,
+                                       nPixelSpace, nLineSpace, nBandSpace );
+
+    MEMRasterBand *poFirstBand = (MEMRasterBand *) GetRasterBand(panBandMap[0]);
+    GDALDataType eDataType = poFirstBand->GetRasterDataType();
+    int nWordSize = GDALGetDataTypeSize( eDataType ) / 8;
+    int iBand, iY;
+
+/* -------------------------------------------------------------------- */
+/*      Can whole pixels be copied?  The buffer and the band arrays     */
+/*      must hold the requested bands, in the same order and data       */
+/*      type, in consecutive words of each pixel.                       */
+/* -------------------------------------------------------------------- */
+    int bSameLayout = eBufType == eDataType
+        && nPixelSpace == poFirstBand->nPixelOffset
+        && nPixelSpace == nBandCount * nWordSize
+        && nBandSpace == nWordSize;
+
+    for( iBand = 1; iBand < nBandCount && bSameLayout; iBand++ )
+    {
+        MEMRasterBand *poBand = (MEMRasterBand *) GetRasterBand(panBandMap[iBand]);
+
+        if( poBand->GetRasterDataType() != eDataType
+            || poBand->nPixelOffset != poFirstBand->nPixelOffset
+            || poBand->nLineOffset != poFirstBand->nLineOffset
+            || poBand->pabyData != poFirstBand->pabyData + iBand * nWordSize )
+            bSameLayout = FALSE;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Write the cached lines of the window back to the arrays, and    */
+/*      drop them as they would be stale after a write.                 */
+/* -------------------------------------------------------------------- */
+    for( iBand = 0; iBand < nBandCount; iBand++ )
+    {
+        GDALRasterBand *poBand = GetRasterBand(panBandMap[iBand]);
+
+        for( iY = nYOff; iY < nYOff + nYSize; iY++ )
+        {
+            CPLErr eErr = poBand->FlushBlock( 0, iY );
+            if( eErr != CE_None )
+                return eErr;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Copy the lines.                                                 */
+/* -------------------------------------------------------------------- */
+    for( iY = 0; iY < nYSize; iY++ )
+    {
+        GByte *pabyBufLine = ((GByte *) pData) + (GIntBig) iY * nLineSpace;
+
+        if( bSameLayout )
+        {
+            GByte *pabyLine = poFirstBand->pabyData
+                + poFirstBand->nLineOffset * (size_t) (nYOff + iY)
+                + poFirstBand->nPixelOffset * (size_t) nXOff;
+
+            if( eRWFlag == GF_Read )
+                memcpy( pabyBufLine, pabyLine, (size_t) nXSize * nPixelSpace );
+            else
+                memcpy( pabyLine, pabyBufLine, (size_t) nXSize * nPixelSpace );
+            continue;
+        }
+
+        for( iBand = 0; iBand < nBandCount; iBand++ )
+        {
+            MEMRasterBand *poBand = (MEMRasterBand *) GetRasterBand(panBandMap[iBand]);
+            GByte *pabyLine = poBand->pabyData
+                + poBand->nLineOffset * (size_t) (nYOff + iY)
+                + poBand->nPixelOffset * (size_t) nXOff;
+
+            if( eRWFlag == GF_Read )
+                GDALCopyWords( pabyLine, poBand->GetRasterDataType(),
+                               poBand->nPixelOffset,
+                               pabyBufLine + (GIntBig) iBand * nBandSpace,
+                               eBufType, nPixelSpace, nXSize );
+            else
+                GDALCopyWords( pabyBufLine + (GIntBig) iBand * nBandSpace,
+                               eBufType, nPixelSpace,
+                               pabyLine, poBand->GetRasterDataType(),
+                               poBand->nPixelOffset, nXSize );
+        }
+    }
+
+    return CE_None;
+}
+
 /************************************************************************/
 /*                                Open()                                */
 /************************************************************************/
@@ -77,6 +77,10 @@ class CPL_DLL MEMDataset : public GDALDataset
     virtual CPLErr        AddBand( GDALDataType eType, 
                                    char **papszOptions=NULL );
 
+    virtual CPLErr IRasterIO( GDALRWFlag, int, int, int, int,
+                              void *, int, int, GDALDataType,
+                              int, int *, int, int, int );
+
     static GDALDataset *Open( GDALOpenInfo * );
     static GDALDataset *Create( const char * pszFilename,
                                 int nXSize, int nYSize, int nBands,
@@ -109,6 +113,9 @@ class CPL_DLL MEMRasterBand : public GDALPamRasterBand
     double         dfScale;
 
     CPLXMLNode    *psSavedHistograms;
+
+    friend class MEMDataset;
+
   public:
 
                    MEMRasterBand( GDALDataset *poDS, int nBand,
@@ -247,6 +247,59 @@ CPLErr RawRasterBand::FlushCache()
     return CE_None;
 }
 
+/************************************************************************/
+/*                         GetVirtualMemAuto()                          */
+/*                                                                      */
+/*      Map the raw file itself when the values are stored in native    */
+/*      order with non negative offsets, and leave the caching to the   */
+/*      operating system.                                               */
+/************************************************************************/
+
+CPLVirtualMem *RawRasterBand::GetVirtualMemAuto( GDALRWFlag eRWFlag,
+                                                 int *pnPixelSpace,
+                                                 GIntBig *pnLineSpace,
+                                                 char **papszOptions )
+
+{
+    if( !bIsVSIL
+        || !CPLIsVirtualMemFileMapAvailable()
+        || VSIFGetNativeFileDescriptorL( fpRawL ) == NULL
+        || (!bNativeOrder && eDataType != GDT_Byte)
+        || nPixelOffset < 0 || nLineOffset < 0
+        || CSLTestBoolean( CSLFetchNameValueDef( papszOptions,
+                                                 "USE_DEFAULT_IMPLEMENTATION",
+                                                 "NO" ) ) )
+        return GDALRasterBand::GetVirtualMemAuto( eRWFlag, pnPixelSpace,
+                                                  pnLineSpace, papszOptions );
+
+    vsi_l_offset nSize = (vsi_l_offset) (nRasterYSize - 1) * nLineOffset
+        + (vsi_l_offset) (nRasterXSize - 1) * nPixelOffset
+        + GDALGetDataTypeSize( eDataType ) / 8;
+
+    /* The mapping and the cached scanline must not diverge */
+    FlushCache();
+    nLoadedScanline = -1;
+
+    CPLPushErrorHandler( CPLQuietErrorHandler );
+    CPLVirtualMem *psVMem = CPLVirtualMemFileMapNew(
+        fpRawL, nImgOffset, nSize,
+        eRWFlag == GF_Write ? VIRTUALMEM_READWRITE : VIRTUALMEM_READONLY,
+        NULL, NULL );
+    CPLPopErrorHandler();
+
+    /* For instance if the file is not fully written yet */
+    if( psVMem == NULL )
+        return GDALRasterBand::GetVirtualMemAuto( eRWFlag, pnPixelSpace,
+                                                  pnLineSpace, papszOptions );
+
+    if( pnPixelSpace != NULL )
+        *pnPixelSpace = nPixelOffset;
+    if( pnLineSpace != NULL )
+        *pnLineSpace = nLineOffset;
+
+    return psVMem;
+}
+
 /************************************************************************/
 /*                             AccessLine()                             */
 /************************************************************************/
@@ -40,6 +40,7 @@
 #include "gdal_version.h"
 #include "cpl_port.h"
 #include "cpl_error.h"
+#include "cpl_virtualmem.h"
 #endif
 
 /* -------------------------------------------------------------------- */
@@ -256,6 +257,30 @@ const char CPL_DLL * CPL_STDCALL GDALGetDriverLongName( GDALDriverH );
 const char CPL_DLL * CPL_STDCALL GDALGetDriverHelpTopic( GDALDriverH );
 const char CPL_DLL * CPL_STDCALL GDALGetDriverCreationOptionList( GDALDriverH );
 
+/* ==================================================================== */
+/*      GDALRasterIOWindow                                              */
+/* ==================================================================== */
+
+/** Window of a batched RasterIO request, see GDALRasterIOMulti() */
+typedef struct
+{
+    /** Pixel offset of the window */
+    int         nXOff;
+    /** Line offset of the window */
+    int         nYOff;
+    /** Width of the window in pixels */
+    int         nXSize;
+    /** Height of the window in lines */
+    int         nYSize;
+
+    /** Buffer of the window */
+    void        *pData;
+    /** Width of the buffer in pixels */
+    int         nBufXSize;
+    /** Height of the buffer in lines */
+    int         nBufYSize;
+} GDALRasterIOWindow;
+
 /* ==================================================================== */
 /*      GDAL_GCP                                                        */
 /* ==================================================================== */
@@ -345,6 +370,12 @@ CPLErr CPL_DLL CPL_STDCALL GDALDatasetRasterIO(
     int nBandCount, int *panBandCount, 
     int nPixelSpace, int nLineSpace, int nBandSpace);
 
+CPLErr CPL_DLL CPL_STDCALL GDALDatasetRasterIOMulti(
+    GDALDatasetH hDS, GDALRWFlag eRWFlag,
+    int nWindowCount, GDALRasterIOWindow *pasWindows, GDALDataType eBDataType,
+    int nBandCount, int *panBandCount, 
+    int nPixelSpace, int nLineSpace, int nBandSpace);
+
 CPLErr CPL_DLL CPL_STDCALL GDALDatasetAdviseRead( GDALDatasetH hDS, 
     int nDSXOff, int nDSYOff, int nDSXSize, int nDSYSize,
     int nBXSize, int nBYSize, GDALDataType eBDataType,
@@ -440,6 +471,11 @@ GDALRasterIO( GDALRasterBandH hRBand, GDALRWFlag eRWFlag,
               int nDSXOff, int nDSYOff, int nDSXSize, int nDSYSize,
               void * pBuffer, int nBXSize, int nBYSize,GDALDataType eBDataType,
               int nPixelSpace, int nLineSpace );
+CPLErr CPL_DLL CPL_STDCALL 
+GDALRasterIOMulti( GDALRasterBandH hRBand, GDALRWFlag eRWFlag,
+                   int nWindowCount, GDALRasterIOWindow *pasWindows,
+                   GDALDataType eBDataType,
+                   int nPixelSpace, int nLineSpace );
 CPLErr CPL_DLL CPL_STDCALL GDALReadBlock( GDALRasterBandH, int, int, void * );
 CPLErr CPL_DLL CPL_STDCALL GDALWriteBlock( GDALRasterBandH, int, int, void * );
 int CPL_DLL CPL_STDCALL GDALGetRasterBandXSize( GDALRasterBandH );
@@ -533,6 +569,26 @@ CPLErr CPL_DLL CPL_STDCALL
 #define GMF_ALPHA         0x04
 #define GMF_NODATA        0x08
 
+/* -------------------------------------------------------------------- */
+/*      Virtual memory mappings of raster bands.                        */
+/* -------------------------------------------------------------------- */
+
+CPLVirtualMem CPL_DLL* GDALRasterBandGetVirtualMem( GDALRasterBandH hBand,
+                                                    GDALRWFlag eRWFlag,
+                                                    int nXOff, int nYOff,
+                                                    int nXSize, int nYSize,
+                                                    int nBufXSize, int nBufYSize,
+                                                    GDALDataType eBufType,
+                                                    size_t nCacheSize,
+                                                    size_t nPageSizeHint,
+                                                    char **papszOptions );
+
+CPLVirtualMem CPL_DLL* GDALGetVirtualMemAuto( GDALRasterBandH hBand,
+                                              GDALRWFlag eRWFlag,
+                                              int *pnPixelSpace,
+                                              GIntBig *pnLineSpace,
+                                              char **papszOptions );
+
 /* ==================================================================== */
 /*     GDALAsyncReader                                                  */
 /* ==================================================================== */
@@ -769,6 +825,28 @@ GIntBig CPL_DLL CPL_STDCALL GDALGetCacheUsed64(void);
 
 int CPL_DLL CPL_STDCALL GDALFlushCacheBlock(void);
 
+/*! Block cache statistics, as returned by GDALGetCacheStatistics() */
+typedef struct
+{
+    /*! Number of block lookups satisfied from the cache */
+    GIntBig nHits;
+    /*! Number of blocks that had to be loaded or created in the cache */
+    GIntBig nMisses;
+    /*! Number of blocks evicted to make room for other blocks */
+    GIntBig nEvictions;
+    /*! Number of dirty blocks written back */
+    GIntBig nDirtyFlushes;
+    /*! Number of bytes of block data currently cached */
+    GIntBig nBytesUsed;
+} GDALCacheStatistics;
+
+void CPL_DLL CPL_STDCALL GDALGetCacheStatistics( GDALCacheStatistics *psStats );
+void CPL_DLL CPL_STDCALL GDALResetCacheStatistics(void);
+void CPL_DLL CPL_STDCALL GDALGetDatasetCacheStatistics( GDALDatasetH hDS,
+                                                        GDALCacheStatistics *psStats );
+void CPL_DLL CPL_STDCALL GDALGetRasterBandCacheStatistics( GDALRasterBandH hBand,
+                                                           GDALCacheStatistics *psStats );
+
 CPL_C_END
 
 #endif /* ndef GDAL_H_INCLUDED */
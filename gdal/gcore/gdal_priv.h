@@ -261,6 +261,18 @@ class CPL_DLL GDALDataset : public GDALMajorObject
     friend class GDALProxyDataset;
     friend class GDALDriverManager;
 
+    /* Block cache quota bookkeeping (see gdalrasterblock.cpp) */
+    friend class GDALRasterBlock;
+    void        *hCacheQuotaMutex;
+    GIntBig     nCacheQuota;
+    GIntBig     nCacheQuotaUsed;
+
+    /* Serializes driver access with the block cache write-back thread */
+    void        *hRWMutex;
+    void        EnterReadWrite();
+    int         TryEnterReadWrite();
+    void        LeaveReadWrite();
+
   protected:
     GDALDriver  *poDriver;
     GDALAccess  eAccess;
@@ -289,6 +301,9 @@ class CPL_DLL GDALDataset : public GDALMajorObject
                               void *, int, int, GDALDataType,
                               int, int *, int, int, int );
 
+    virtual CPLErr IRasterIOMulti( GDALRWFlag, int, GDALRasterIOWindow *,
+                                   GDALDataType, int, int *, int, int, int );
+
     CPLErr BlockBasedRasterIO( GDALRWFlag, int, int, int, int,
                                void *, int, int, GDALDataType,
                                int, int *, int, int, int );
@@ -347,11 +362,15 @@ class CPL_DLL GDALDataset : public GDALMajorObject
     CPLErr      RasterIO( GDALRWFlag, int, int, int, int,
                           void *, int, int, GDALDataType,
                           int, int *, int, int, int );
+    CPLErr      RasterIOMulti( GDALRWFlag, int, GDALRasterIOWindow *,
+                               GDALDataType, int, int *, int, int, int );
 
     int           Reference();
     int           Dereference();
     GDALAccess    GetAccess() { return eAccess; }
 
+    void          GetCacheStatistics( GDALCacheStatistics *psStats );
+
     int           GetShared();
     void          MarkAsShared();
 
@@ -389,6 +408,15 @@ class CPL_DLL GDALRasterBlock
     GDALRasterBlock     *poNext;
     GDALRasterBlock     *poPrevious;
 
+    int                 nCacheShard;
+    int                 nCacheQueue;
+    int                 bCacheReferenced;
+
+    void        LinkToQueue( int );
+    void        UnlinkFromQueue();
+    static GDALRasterBlock *SelectVictim( int, GDALDataset *, int,
+                                          GDALDataset ** );
+
   public:
                 GDALRasterBlock( GDALRasterBand *, int, int );
     virtual     ~GDALRasterBlock();
@@ -417,10 +445,15 @@ class CPL_DLL GDALRasterBlock
     /// @return source raster band of the raster block.
     GDALRasterBand *GetBand() { return poBand; }
 
-    static int  FlushCacheBlock();
+    static int  FlushCacheBlock( GDALDataset *poDS = NULL );
+    static int  WriteBackCacheBlock();
     static void Verify();
 
     static int  SafeLockBlock( GDALRasterBlock ** );
+    static int  SafeLockBlock( GDALRasterBlock **, GDALRasterBand *,
+                               int, int, int bCountHit = TRUE );
+
+    static int  GetCacheShardCount();
 };
 
 /* ******************************************************************** */
@@ -463,6 +496,7 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     CPLErr eFlushBlockErr;
 
     void           SetFlushBlockErr( CPLErr eErr );
+    CPLErr         FlushCacheInternal();
 
     friend class GDALRasterBlock;
 
@@ -490,6 +524,10 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     int         nBlockReads;
     int         bForceCachedIO;
 
+    /* One set of counters per block cache shard, each updated under */
+    /* the mutex of its shard */
+    GDALCacheStatistics *pasCacheStats;
+
     GDALRasterBand *poMask;
     bool        bOwnMask;
     int         nMaskFlags;
@@ -503,13 +541,19 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     virtual CPLErr IRasterIO( GDALRWFlag, int, int, int, int,
                               void *, int, int, GDALDataType,
                               int, int );
+    virtual CPLErr IRasterIOMulti( GDALRWFlag, int, GDALRasterIOWindow *,
+                                   GDALDataType, int, int );
     CPLErr         OverviewRasterIO( GDALRWFlag, int, int, int, int,
                                      void *, int, int, GDALDataType,
                                      int, int );
+    CPLErr         RasterIOResampled( int, int, int, int,
+                                      void *, int, int, GDALDataType,
+                                      int, int, const char * );
 
     int            InitBlockInfo();
 
     CPLErr         AdoptBlock( int, int, GDALRasterBlock * );
+    int            UnreferenceBlock( GDALRasterBlock * );
     GDALRasterBlock *TryGetLockedBlockRef( int nXBlockOff, int nYBlockYOff );
 
   public:
@@ -529,6 +573,8 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     CPLErr      RasterIO( GDALRWFlag, int, int, int, int,
                           void *, int, int, GDALDataType,
                           int, int );
+    CPLErr      RasterIOMulti( GDALRWFlag, int, GDALRasterIOWindow *,
+                               GDALDataType, int, int );
     CPLErr      ReadBlock( int, int, void * );
 
     CPLErr      WriteBlock( int, int, void * );
@@ -604,6 +650,13 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     virtual int             GetMaskFlags();
     virtual CPLErr          CreateMaskBand( int nFlags );
 
+    virtual CPLVirtualMem  *GetVirtualMemAuto( GDALRWFlag eRWFlag,
+                                               int *pnPixelSpace,
+                                               GIntBig *pnLineSpace,
+                                               char **papszOptions );
+
+    void        GetCacheStatistics( GDALCacheStatistics *psStats );
+
     void ReportError(CPLErr eErrClass, int err_no, const char *fmt, ...)  CPL_PRINT_FUNC_FORMAT (4, 5);
 };
 
@@ -840,6 +893,15 @@ class CPL_DLL GDALAsyncReader
     virtual void UnlockBuffer();
 };
 
+/* ==================================================================== */
+/*      Block cache statistics reporting and write-back thread.         */
+/* ==================================================================== */
+
+/* Not public symbols for the moment */
+void GDALDumpOpenDatasetsCacheStatistics();
+int GDALIsCacheWriteBackEnabled();
+void GDALStopCacheWriteBack();
+
 /* ==================================================================== */
 /*      An assortment of overview related stuff.                        */
 /* ==================================================================== */
@@ -886,6 +948,11 @@ int CPL_DLL GDALBandGetBestOverviewLevel(GDALRasterBand* poBand,
                                          int &nXSize, int &nYSize,
                                          int nBufXSize, int nBufYSize);
 
+const char CPL_DLL *GDALGetRasterIOResampling( GDALRWFlag eRWFlag,
+                                               GDALDataType eDataType,
+                                               int nXSize, int nYSize,
+                                               int nBufXSize, int nBufYSize );
+
 int CPL_DLL GDALOvLevelAdjust( int nOvLevel, int nXSize );
 
 GDALDataset CPL_DLL *
@@ -106,6 +106,8 @@ class CPL_DLL GDALProxyRasterBand : public GDALRasterBand
         virtual CPLErr IRasterIO( GDALRWFlag, int, int, int, int,
                                 void *, int, int, GDALDataType,
                                 int, int );
+        virtual CPLErr IRasterIOMulti( GDALRWFlag, int, GDALRasterIOWindow *,
+                                       GDALDataType, int, int );
 
     public:
 
@@ -195,6 +195,21 @@ GDALDataset::GDALDataset()
     nRefCount = 1;
     bShared = FALSE;
 
+    hCacheQuotaMutex = NULL;
+    nCacheQuota = -1;
+    nCacheQuotaUsed = 0;
+
+/* -------------------------------------------------------------------- */
+/*      When the block cache write-back thread is active, driver        */
+/*      calls must be serialized with the writes it does.               */
+/* -------------------------------------------------------------------- */
+    hRWMutex = NULL;
+    if( GDALIsCacheWriteBackEnabled() )
+    {
+        hRWMutex = CPLCreateMutex();
+        CPLReleaseMutex( hRWMutex );
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Add this dataset to the open dataset list.                      */
 /* -------------------------------------------------------------------- */
@@ -309,6 +324,12 @@ GDALDataset::~GDALDataset()
     }
 
     CPLFree( papoBands );
+
+    if( hCacheQuotaMutex != NULL )
+        CPLDestroyMutex( hCacheQuotaMutex );
+
+    if( hRWMutex != NULL )
+        CPLDestroyMutex( hRWMutex );
 }
 
 /************************************************************************/
@@ -339,11 +360,15 @@ void GDALDataset::FlushCache()
     if( papoBands == NULL )
         return;
 
+    EnterReadWrite();
+
     for( i = 0; i < nBands; i++ )
     {
         if( papoBands[i] != NULL )
             papoBands[i]->FlushCache();
     }
+
+    LeaveReadWrite();
 }
 
 /************************************************************************/
@@ -409,26 +434,73 @@ void GDALDataset::BlockBasedFlushCache()
 /* -------------------------------------------------------------------- */
 /*      Now flush writable data.                                        */
 /* -------------------------------------------------------------------- */
-    for( int iY = 0; iY < poBand1->nBlocksPerColumn; iY++ )
+    CPLErr    eErr = CE_None;
+
+    EnterReadWrite();
+
+    for( int iY = 0; iY < poBand1->nBlocksPerColumn && eErr == CE_None; iY++ )
     {
-        for( int iX = 0; iX < poBand1->nBlocksPerRow; iX++ )
+        for( int iX = 0; iX < poBand1->nBlocksPerRow && eErr == CE_None; iX++ )
         {
-            for( iBand = 0; iBand < nBands; iBand++ )
+            for( iBand = 0; iBand < nBands && eErr == CE_None; iBand++ )
             {
                 GDALRasterBand *poBand = GetRasterBand( iBand+1 );
                 
                 if( poBand->papoBlocks[iX + iY*poBand1->nBlocksPerRow] != NULL)
                 {
-                    CPLErr    eErr;
-                    
                     eErr = poBand->FlushBlock( iX, iY );
-                    
-                    if( eErr != CE_None )
-                        return;
                 }
             }
         }
     }
+
+    LeaveReadWrite();
+}
+
+/************************************************************************/
+/*                           EnterReadWrite()                           */
+/*                                                                      */
+/*      When the block cache write-back thread is enabled, calls to     */
+/*      the driver (IRasterIO(), IReadBlock(), IWriteBlock(), ...)      */
+/*      are done with the mutex of the dataset held, so that they do    */
+/*      not run concurrently with the writes of the write-back thread.  */
+/*      This does nothing otherwise.                                    */
+/************************************************************************/
+
+void GDALDataset::EnterReadWrite()
+
+{
+    if( hRWMutex != NULL )
+        CPLAcquireMutex( hRWMutex, 1000.0 );
+}
+
+/************************************************************************/
+/*                         TryEnterReadWrite()                          */
+/*                                                                      */
+/*      Same as EnterReadWrite(), but fails instead of waiting if       */
+/*      another thread is using the dataset.  Used by the block cache   */
+/*      to write dirty blocks of other datasets without risking a       */
+/*      deadlock.                                                       */
+/************************************************************************/
+
+int GDALDataset::TryEnterReadWrite()
+
+{
+    if( hRWMutex != NULL )
+        return CPLTryAcquireMutex( hRWMutex );
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                           LeaveReadWrite()                           */
+/************************************************************************/
+
+void GDALDataset::LeaveReadWrite()
+
+{
+    if( hRWMutex != NULL )
+        CPLReleaseMutex( hRWMutex );
 }
 
 /************************************************************************/
@@ -1091,6 +1163,67 @@ int CPL_STDCALL GDALDereferenceDataset( GDALDatasetH hDataset )
     return ((GDALDataset *) hDataset)->Dereference();
 }
 
+/************************************************************************/
+/*                         GetCacheStatistics()                         */
+/************************************************************************/
+
+/**
+ * \brief Fetch block cache statistics of this dataset.
+ *
+ * The statistics are the sum of the block cache statistics of the bands
+ * of the dataset (see GDALRasterBand::GetCacheStatistics()).
+ *
+ * This method is the same as the C function GDALGetDatasetCacheStatistics().
+ *
+ * @param psStats the structure to fill.
+ *
+ * @since GDAL 1.9.0
+ */
+
+void GDALDataset::GetCacheStatistics( GDALCacheStatistics *psStats )
+
+{
+    memset( psStats, 0, sizeof(GDALCacheStatistics) );
+
+    for( int i = 0; i < nBands && papoBands != NULL; i++ )
+    {
+        GDALCacheStatistics sBandStats;
+
+        if( papoBands[i] == NULL )
+            continue;
+
+        papoBands[i]->GetCacheStatistics( &sBandStats );
+
+        psStats->nHits += sBandStats.nHits;
+        psStats->nMisses += sBandStats.nMisses;
+        psStats->nEvictions += sBandStats.nEvictions;
+        psStats->nDirtyFlushes += sBandStats.nDirtyFlushes;
+        psStats->nBytesUsed += sBandStats.nBytesUsed;
+    }
+}
+
+/************************************************************************/
+/*                   GDALGetDatasetCacheStatistics()                    */
+/************************************************************************/
+
+/**
+ * \brief Fetch block cache statistics of a dataset.
+ *
+ * @see GDALDataset::GetCacheStatistics()
+ *
+ * @since GDAL 1.9.0
+ */
+
+void CPL_STDCALL GDALGetDatasetCacheStatistics( GDALDatasetH hDS,
+                                                GDALCacheStatistics *psStats )
+
+{
+    VALIDATE_POINTER0( hDS, "GDALGetDatasetCacheStatistics" );
+    VALIDATE_POINTER0( psStats, "GDALGetDatasetCacheStatistics" );
+
+    ((GDALDataset *) hDS)->GetCacheStatistics( psStats );
+}
+
 /************************************************************************/
 /*                             GetShared()                              */
 /************************************************************************/
@@ -1719,11 +1852,13 @@ CPLErr GDALDataset::RasterIO( GDALRWFlag eRWFlag,
 /* -------------------------------------------------------------------- */
     if( bForceCachedIO )
     {
+        EnterReadWrite();
         eErr = 
             BlockBasedRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize,
                                 pData, nBufXSize, nBufYSize, eBufType,
                                 nBandCount, panBandMap,
                                 nPixelSpace, nLineSpace, nBandSpace );
+        LeaveReadWrite();
     }
 
 /* -------------------------------------------------------------------- */
@@ -1731,11 +1866,13 @@ CPLErr GDALDataset::RasterIO( GDALRWFlag eRWFlag,
 /* -------------------------------------------------------------------- */
     else if( eErr == CE_None )
     {
+        EnterReadWrite();
         eErr = 
             IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize,
                        pData, nBufXSize, nBufYSize, eBufType,
                        nBandCount, panBandMap,
                        nPixelSpace, nLineSpace, nBandSpace );
+        LeaveReadWrite();
     }
 
 /* -------------------------------------------------------------------- */
@@ -1775,6 +1912,231 @@ GDALDatasetRasterIO( GDALDatasetH hDS, GDALRWFlag eRWFlag,
                             nBandCount, panBandMap, 
                             nPixelSpace, nLineSpace, nBandSpace ) );
 }
+
+/************************************************************************/
+/*                           RasterIOMulti()                            */
+/************************************************************************/
+
+/**
+ * \brief Read/write several regions from/to multiple bands.
+ *
+ * This method is equivalent to calling RasterIO() for each of the windows,
+ * but lets the dataset satisfy them in a single pass.  The default
+ * implementation hands the windows to GDALRasterBand::RasterIOMulti() for
+ * each band, that processes them in block order so that a block shared by
+ * several windows is only fetched once.  Drivers may override it to
+ * coalesce the underlying reads.
+ *
+ * All the windows share the same buffer data type, band list and spacings.
+ *
+ * This method is the same as the C GDALDatasetRasterIOMulti() function.
+ *
+ * @param eRWFlag Either GF_Read to read the regions of data, or GF_Write to
+ * write them.
+ *
+ * @param nWindowCount the number of windows in pasWindows.
+ *
+ * @param pasWindows the windows to access, each one with its own region,
+ * buffer and buffer size, as would be passed to RasterIO().
+ *
+ * @param eBufType the type of the pixel values in the buffers.
+ *
+ * @param nBandCount the number of bands being read or written. 
+ *
+ * @param panBandMap the list of nBandCount band numbers being read/written.
+ * Note band numbers are 1 based. This may be NULL to select the first 
+ * nBandCount bands.
+ *
+ * @param nPixelSpace The byte offset from the start of one pixel value in
+ * a buffer to the start of the next pixel value within a scanline. If
+ * defaulted (0) the size of the datatype eBufType is used.
+ *
+ * @param nLineSpace The byte offset from the start of one scanline in
+ * a buffer to the start of the next. If defaulted (0) the pixel spacing
+ * times the buffer width of each window is used.
+ *
+ * @param nBandSpace the byte offset from the start of one bands data to the
+ * start of the next. If defaulted (0) the line spacing times the buffer
+ * height of each window is used.
+ *
+ * @return CE_Failure if the access fails, otherwise CE_None.
+ *
+ * @since GDAL 1.9.0
+ */
+
+CPLErr GDALDataset::RasterIOMulti( GDALRWFlag eRWFlag,
+                                   int nWindowCount,
+                                   GDALRasterIOWindow *pasWindows,
+                                   GDALDataType eBufType,
+                                   int nBandCount, int *panBandMap,
+                                   int nPixelSpace, int nLineSpace,
+                                   int nBandSpace )
+
+{
+    int i;
+    int bNeedToFreeBandMap = FALSE;
+    CPLErr eErr = CE_None;
+
+    if( nWindowCount < 0 || (nWindowCount > 0 && pasWindows == NULL) )
+    {
+        ReportError( CE_Failure, CPLE_IllegalArg,
+                     "Invalid window list in RasterIOMulti()." );
+        return CE_Failure;
+    }
+
+    if( eRWFlag != GF_Read && eRWFlag != GF_Write )
+    {
+        ReportError( CE_Failure, CPLE_IllegalArg,
+                  "eRWFlag = %d, only GF_Read (0) and GF_Write (1) are legal.",
+                  eRWFlag );
+        return CE_Failure;
+    }
+
+    if( nPixelSpace == 0 )
+        nPixelSpace = GDALGetDataTypeSize( eBufType ) / 8;
+
+/* -------------------------------------------------------------------- */
+/*      Validate all the windows before accessing any of them.          */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < nWindowCount; i++ )
+    {
+        GDALRasterIOWindow *psWindow = pasWindows + i;
+
+        if( psWindow->pData == NULL
+            && psWindow->nBufXSize > 0 && psWindow->nBufYSize > 0 )
+        {
+            ReportError( CE_Failure, CPLE_AppDefined,
+                      "The buffer of window %d is null", i );
+            return CE_Failure;
+        }
+
+        if( psWindow->nXOff < 0
+            || psWindow->nXOff > INT_MAX - psWindow->nXSize
+            || psWindow->nXOff + psWindow->nXSize > nRasterXSize
+            || psWindow->nYOff < 0
+            || psWindow->nYOff > INT_MAX - psWindow->nYSize
+            || psWindow->nYOff + psWindow->nYSize > nRasterYSize )
+        {
+            ReportError( CE_Failure, CPLE_IllegalArg,
+                      "Access window %d out of range in RasterIOMulti().  "
+                      "Requested\n(%d,%d) of size %dx%d on raster of %dx%d.",
+                      i, psWindow->nXOff, psWindow->nYOff,
+                      psWindow->nXSize, psWindow->nYSize,
+                      nRasterXSize, nRasterYSize );
+            return CE_Failure;
+        }
+
+        if( psWindow->nBufXSize > 0 && psWindow->nBufYSize > 0 )
+        {
+            int nWindowLineSpace = nLineSpace;
+
+            if( nWindowLineSpace == 0 )
+            {
+                if( nPixelSpace > INT_MAX / psWindow->nBufXSize )
+                {
+                    ReportError( CE_Failure, CPLE_AppDefined,
+                              "Int overflow : %d x %d",
+                              nPixelSpace, psWindow->nBufXSize );
+                    return CE_Failure;
+                }
+                nWindowLineSpace = nPixelSpace * psWindow->nBufXSize;
+            }
+
+            if( nBandSpace == 0 && nBandCount > 1
+                && nWindowLineSpace > INT_MAX / psWindow->nBufYSize )
+            {
+                ReportError( CE_Failure, CPLE_AppDefined,
+                          "Int overflow : %d x %d",
+                          nWindowLineSpace, psWindow->nBufYSize );
+                return CE_Failure;
+            }
+        }
+    }
+
+    if( panBandMap == NULL )
+    {
+        if (nBandCount > GetRasterCount())
+        {
+            ReportError( CE_Failure, CPLE_IllegalArg,
+                      "nBandCount cannot be greater than %d",
+                      GetRasterCount() );
+            return CE_Failure;
+        }
+        panBandMap = (int *) VSIMalloc2(sizeof(int), nBandCount);
+        if (panBandMap == NULL)
+        {
+            ReportError( CE_Failure, CPLE_OutOfMemory,
+                      "Out of memory while allocating band map array" );
+            return CE_Failure;
+        }
+        for( i = 0; i < nBandCount; i++ )
+            panBandMap[i] = i+1;
+
+        bNeedToFreeBandMap = TRUE;
+    }
+
+    for( i = 0; i < nBandCount && eErr == CE_None; i++ )
+    {
+        if( panBandMap[i] < 1 || panBandMap[i] > GetRasterCount()
+            || GetRasterBand( panBandMap[i] ) == NULL )
+        {
+            ReportError( CE_Failure, CPLE_IllegalArg,
+                      "panBandMap[%d] = %d, this band does not exist on dataset.",
+                      i, panBandMap[i] );
+            eErr = CE_Failure;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Call the format specific function.                              */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None && nWindowCount > 0 )
+    {
+        EnterReadWrite();
+        if( bForceCachedIO )
+            eErr = GDALDataset::IRasterIOMulti( eRWFlag, nWindowCount, pasWindows,
+                                                eBufType, nBandCount, panBandMap,
+                                                nPixelSpace, nLineSpace,
+                                                nBandSpace );
+        else
+            eErr = IRasterIOMulti( eRWFlag, nWindowCount, pasWindows,
+                                   eBufType, nBandCount, panBandMap,
+                                   nPixelSpace, nLineSpace, nBandSpace );
+        LeaveReadWrite();
+    }
+
+    if( bNeedToFreeBandMap )
+        CPLFree( panBandMap );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                      GDALDatasetRasterIOMulti()                      */
+/************************************************************************/
+
+/**
+ * \brief Read/write several regions from/to multiple bands.
+ *
+ * @see GDALDataset::RasterIOMulti()
+ */
+
+CPLErr CPL_STDCALL 
+GDALDatasetRasterIOMulti( GDALDatasetH hDS, GDALRWFlag eRWFlag,
+                          int nWindowCount, GDALRasterIOWindow *pasWindows,
+                          GDALDataType eBufType,
+                          int nBandCount, int *panBandMap,
+                          int nPixelSpace, int nLineSpace, int nBandSpace )
+    
+{
+    VALIDATE_POINTER1( hDS, "GDALDatasetRasterIOMulti", CE_Failure );
+
+    GDALDataset    *poDS = (GDALDataset *) hDS;
+    
+    return( poDS->RasterIOMulti( eRWFlag, nWindowCount, pasWindows, eBufType,
+                                 nBandCount, panBandMap, 
+                                 nPixelSpace, nLineSpace, nBandSpace ) );
+}
                      
 /************************************************************************/
 /*                          GetOpenDatasets()                           */
@@ -2508,6 +2870,56 @@ int CPL_STDCALL GDALDumpOpenDatasets( FILE *fp )
     }
 }
 
+/************************************************************************/
+/*                GDALDumpOpenDatasetsCacheStatistics()                 */
+/*                                                                      */
+/*      Emit a CPLDebug() line with the block cache statistics of       */
+/*      each band of the open datasets that use the block cache.        */
+/*      Used for the periodic reports of GDAL_CACHE_STATS_INTERVAL.     */
+/************************************************************************/
+
+static int GDALDumpOpenDatasetsCacheStatisticsForeach(void* elt, void* user_data)
+{
+    DatasetCtxt* psStruct = (DatasetCtxt*) elt;
+    GDALDataset *poDS = psStruct->poDS;
+
+    for( int iBand = 1; iBand <= poDS->GetRasterCount(); iBand++ )
+    {
+        GDALRasterBand *poBand = poDS->GetRasterBand( iBand );
+        GDALCacheStatistics sStats;
+
+        if( poBand == NULL )
+            continue;
+
+        poBand->GetCacheStatistics( &sStats );
+        if( sStats.nHits + sStats.nMisses == 0 )
+            continue;
+
+        CPLDebug( "GDAL", 
+                  "Block cache: %s, band %d: " CPL_FRMT_GIB " hits, "
+                  CPL_FRMT_GIB " misses (%.1f%% hit rate), "
+                  CPL_FRMT_GIB " evictions, " CPL_FRMT_GIB " dirty flushes, "
+                  CPL_FRMT_GIB " bytes cached",
+                  poDS->GetDescription(), iBand,
+                  sStats.nHits, sStats.nMisses, 
+                  100.0 * sStats.nHits / (sStats.nHits + sStats.nMisses),
+                  sStats.nEvictions, sStats.nDirtyFlushes, 
+                  sStats.nBytesUsed );
+    }
+
+    return TRUE;
+}
+
+void GDALDumpOpenDatasetsCacheStatistics()
+   
+{
+    CPLMutexHolderD( &hDLMutex );
+
+    if (phAllDatasetSet != NULL)
+        CPLHashSetForeach(phAllDatasetSet, 
+                          GDALDumpOpenDatasetsCacheStatisticsForeach, NULL);
+}
+
 /************************************************************************/
 /*                        BeginAsyncReader()                          */
 /************************************************************************/
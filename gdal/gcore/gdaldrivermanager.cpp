@@ -186,6 +186,12 @@ GDALDriverManager::~GDALDriverManager()
         delete papoDSList[i];
     }
 
+/* -------------------------------------------------------------------- */
+/*      Stop the block cache write-back thread, now that there is no    */
+/*      dirty block left.                                               */
+/* -------------------------------------------------------------------- */
+    GDALStopCacheWriteBack();
+
 /* -------------------------------------------------------------------- */
 /*      Destroy the existing drivers.                                   */
 /* -------------------------------------------------------------------- */
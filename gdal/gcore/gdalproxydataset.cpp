@@ -188,6 +188,14 @@ RB_PROXY_METHOD_WITH_RET(CPLErr, CE_Failure, IRasterIO,
                         (eRWFlag, nXOff, nYOff, nXSize, nYSize,
                                 pData, nBufXSize, nBufYSize, eBufType,
                                 nPixelSpace, nLineSpace ) )
+RB_PROXY_METHOD_WITH_RET(CPLErr, CE_Failure, IRasterIOMulti,
+                        ( GDALRWFlag eRWFlag,
+                                int nWindowCount, GDALRasterIOWindow *pasWindows,
+                                GDALDataType eBufType,
+                                int nPixelSpace,
+                                int nLineSpace ), 
+                        (eRWFlag, nWindowCount, pasWindows, eBufType,
+                                nPixelSpace, nLineSpace ) )
 
 RB_PROXY_METHOD_WITH_RET(char**, NULL, GetMetadata, (const char * pszDomain), (pszDomain))
 RB_PROXY_METHOD_WITH_RET(CPLErr, CE_Failure, SetMetadata,
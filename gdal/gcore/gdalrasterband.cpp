@@ -73,6 +73,10 @@ GDALRasterBand::GDALRasterBand()
     bForceCachedIO =  CSLTestBoolean( 
         CPLGetConfigOption( "GDAL_FORCE_CACHING", "NO") );
 
+    pasCacheStats = (GDALCacheStatistics *) 
+        CPLCalloc( GDALRasterBlock::GetCacheShardCount(),
+                   sizeof(GDALCacheStatistics) );
+
     eFlushBlockErr = CE_None;
 }
 
@@ -105,6 +109,8 @@ GDALRasterBand::~GDALRasterBand()
         nMaskFlags = 0;
         bOwnMask = false;
     }
+
+    CPLFree( pasCacheStats );
 }
 
 /************************************************************************/
@@ -130,6 +136,13 @@ GDALRasterBand::~GDALRasterBand()
  * Some formats may efficiently implement decimation into a buffer by
  * reading from lower resolution overview images.
  *
+ * Decimation is done by nearest neighbour sampling by default. Starting with
+ * GDAL 1.9.0, the GDAL_RASTERIO_RESAMPLING configuration option can be set to
+ * BILINEAR, CUBIC or AVERAGE to resample the region with the corresponding
+ * filter instead, from the most appropriate overview, when reading through
+ * the default implementation of the drivers.  Complex data is always
+ * decimated by nearest neighbour sampling.
+ *
  * For highest performance full resolution data access, read and write
  * on "block boundaries" as returned by GetBlockSize(), or use the
  * ReadBlock() and WriteBlock() methods.
@@ -259,14 +272,24 @@ CPLErr GDALRasterBand::RasterIO( GDALRWFlag eRWFlag,
 /* -------------------------------------------------------------------- */
 /*      Call the format specific function.                              */
 /* -------------------------------------------------------------------- */
+    CPLErr eErr;
+
+    if( poDS != NULL )
+        poDS->EnterReadWrite();
+
     if( bForceCachedIO )
-        return GDALRasterBand::IRasterIO(eRWFlag, nXOff, nYOff, nXSize, nYSize,
+        eErr = GDALRasterBand::IRasterIO(eRWFlag, nXOff, nYOff, nXSize, nYSize,
                                          pData, nBufXSize, nBufYSize, eBufType,
                                          nPixelSpace, nLineSpace );
     else
-        return IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize,
+        eErr = IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize,
                           pData, nBufXSize, nBufYSize, eBufType,
                           nPixelSpace, nLineSpace ) ;
+
+    if( poDS != NULL )
+        poDS->LeaveReadWrite();
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -295,6 +318,174 @@ GDALRasterIO( GDALRasterBandH hBand, GDALRWFlag eRWFlag,
                               pData, nBufXSize, nBufYSize, eBufType,
                               nPixelSpace, nLineSpace ) );
 }
+
+/************************************************************************/
+/*                           RasterIOMulti()                            */
+/************************************************************************/
+
+/**
+ * \brief Read/write several regions of image data for this band.
+ *
+ * This method is equivalent to calling RasterIO() for each of the windows,
+ * but lets the band satisfy them in a single pass: the default
+ * implementation reads the windows in block order, so that a block
+ * shared by several windows is only fetched once, and copies the windows
+ * that fall within a single block without going through the generic
+ * RasterIO() machinery.  Drivers may override it to coalesce the
+ * underlying reads.  This makes it appropriate for point sampling or
+ * tile services that access many small scattered windows.
+ *
+ * All the windows share the same buffer data type and pixel spacing.
+ * Windows that overlap are written in the order they are given.
+ *
+ * This method is the same as the C GDALRasterIOMulti() function.
+ *
+ * @param eRWFlag Either GF_Read to read the regions of data, or GF_Write to
+ * write them.
+ *
+ * @param nWindowCount the number of windows in pasWindows.
+ *
+ * @param pasWindows the windows to access, each one with its own region,
+ * buffer and buffer size, as would be passed to RasterIO().
+ *
+ * @param eBufType the type of the pixel values in the buffers.
+ *
+ * @param nPixelSpace The byte offset from the start of one pixel value in
+ * a buffer to the start of the next pixel value within a scanline. If
+ * defaulted (0) the size of the datatype eBufType is used.
+ *
+ * @param nLineSpace The byte offset from the start of one scanline in
+ * a buffer to the start of the next. If defaulted (0) the pixel spacing
+ * times the buffer width of each window is used.
+ *
+ * @return CE_Failure if the access fails, otherwise CE_None.
+ *
+ * @since GDAL 1.9.0
+ */
+
+CPLErr GDALRasterBand::RasterIOMulti( GDALRWFlag eRWFlag,
+                                      int nWindowCount,
+                                      GDALRasterIOWindow *pasWindows,
+                                      GDALDataType eBufType,
+                                      int nPixelSpace, int nLineSpace )
+
+{
+    if( nWindowCount < 0 || (nWindowCount > 0 && pasWindows == NULL) )
+    {
+        ReportError( CE_Failure, CPLE_IllegalArg,
+                     "Invalid window list in RasterIOMulti()." );
+        return CE_Failure;
+    }
+
+    if( eRWFlag != GF_Read && eRWFlag != GF_Write )
+    {
+        ReportError( CE_Failure, CPLE_IllegalArg,
+                  "eRWFlag = %d, only GF_Read (0) and GF_Write (1) are legal.",
+                  eRWFlag );
+        return CE_Failure;
+    }
+
+    if( eRWFlag == GF_Write && eFlushBlockErr != CE_None )
+    {
+        ReportError(eFlushBlockErr, CPLE_AppDefined,
+                 "An error occured while writing a dirty block");
+        CPLErr eErr = eFlushBlockErr;
+        eFlushBlockErr = CE_None;
+        return eErr;
+    }
+
+    if( nPixelSpace == 0 )
+        nPixelSpace = GDALGetDataTypeSize( eBufType ) / 8;
+
+/* -------------------------------------------------------------------- */
+/*      Validate all the windows before accessing any of them.          */
+/* -------------------------------------------------------------------- */
+    for( int iWindow = 0; iWindow < nWindowCount; iWindow++ )
+    {
+        GDALRasterIOWindow *psWindow = pasWindows + iWindow;
+
+        if( psWindow->pData == NULL
+            && psWindow->nBufXSize > 0 && psWindow->nBufYSize > 0 )
+        {
+            ReportError( CE_Failure, CPLE_AppDefined,
+                      "The buffer of window %d is null", iWindow );
+            return CE_Failure;
+        }
+
+        if( psWindow->nXOff < 0
+            || psWindow->nXOff > INT_MAX - psWindow->nXSize
+            || psWindow->nXOff + psWindow->nXSize > nRasterXSize
+            || psWindow->nYOff < 0
+            || psWindow->nYOff > INT_MAX - psWindow->nYSize
+            || psWindow->nYOff + psWindow->nYSize > nRasterYSize )
+        {
+            ReportError( CE_Failure, CPLE_IllegalArg,
+                      "Access window %d out of range in RasterIOMulti().  "
+                      "Requested\n(%d,%d) of size %dx%d on raster of %dx%d.",
+                      iWindow,
+                      psWindow->nXOff, psWindow->nYOff,
+                      psWindow->nXSize, psWindow->nYSize,
+                      nRasterXSize, nRasterYSize );
+            return CE_Failure;
+        }
+
+        if( nLineSpace == 0 && psWindow->nBufXSize > 0
+            && nPixelSpace > INT_MAX / psWindow->nBufXSize )
+        {
+            ReportError( CE_Failure, CPLE_AppDefined,
+                      "Int overflow : %d x %d", nPixelSpace, psWindow->nBufXSize );
+            return CE_Failure;
+        }
+    }
+
+    if( nWindowCount == 0 )
+        return CE_None;
+
+/* -------------------------------------------------------------------- */
+/*      Call the format specific function.                              */
+/* -------------------------------------------------------------------- */
+    CPLErr eErr;
+
+    if( poDS != NULL )
+        poDS->EnterReadWrite();
+
+    if( bForceCachedIO )
+        eErr = GDALRasterBand::IRasterIOMulti( eRWFlag, nWindowCount, pasWindows,
+                                               eBufType, nPixelSpace, nLineSpace );
+    else
+        eErr = IRasterIOMulti( eRWFlag, nWindowCount, pasWindows,
+                               eBufType, nPixelSpace, nLineSpace );
+
+    if( poDS != NULL )
+        poDS->LeaveReadWrite();
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         GDALRasterIOMulti()                          */
+/************************************************************************/
+
+/**
+ * \brief Read/write several regions of image data for this band.
+ *
+ * @see GDALRasterBand::RasterIOMulti()
+ */
+
+CPLErr CPL_STDCALL 
+GDALRasterIOMulti( GDALRasterBandH hBand, GDALRWFlag eRWFlag,
+                   int nWindowCount, GDALRasterIOWindow *pasWindows,
+                   GDALDataType eBufType,
+                   int nPixelSpace, int nLineSpace )
+    
+{
+    VALIDATE_POINTER1( hBand, "GDALRasterIOMulti", CE_Failure );
+
+    GDALRasterBand *poBand = static_cast<GDALRasterBand*>(hBand);
+
+    return( poBand->RasterIOMulti( eRWFlag, nWindowCount, pasWindows,
+                                   eBufType, nPixelSpace, nLineSpace ) );
+}
                      
 /************************************************************************/
 /*                             ReadBlock()                              */
@@ -418,7 +609,17 @@ CPLErr GDALRasterBand::ReadBlock( int nXBlockOff, int nYBlockOff,
 /* -------------------------------------------------------------------- */
 /*      Invoke underlying implementation method.                        */
 /* -------------------------------------------------------------------- */
-    return( IReadBlock( nXBlockOff, nYBlockOff, pImage ) );
+    CPLErr eErr;
+
+    if( poDS != NULL )
+        poDS->EnterReadWrite();
+
+    eErr = IReadBlock( nXBlockOff, nYBlockOff, pImage );
+
+    if( poDS != NULL )
+        poDS->LeaveReadWrite();
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -539,7 +740,17 @@ CPLErr GDALRasterBand::WriteBlock( int nXBlockOff, int nYBlockOff,
 /* -------------------------------------------------------------------- */
 /*      Invoke underlying implementation method.                        */
 /* -------------------------------------------------------------------- */
-    return( IWriteBlock( nXBlockOff, nYBlockOff, pImage ) );
+    CPLErr eErr;
+
+    if( poDS != NULL )
+        poDS->EnterReadWrite();
+
+    eErr = IWriteBlock( nXBlockOff, nYBlockOff, pImage );
+
+    if( poDS != NULL )
+        poDS->LeaveReadWrite();
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -869,6 +1080,56 @@ CPLErr GDALRasterBand::AdoptBlock( int nXBlockOff, int nYBlockOff,
     return CE_None;
 }
 
+/************************************************************************/
+/*                          UnreferenceBlock()                          */
+/*                                                                      */
+/*      Remove a block from the raster band's block matrix, without     */
+/*      writing or destroying it.  Returns FALSE if the block is not    */
+/*      the one referenced at its offsets.                              */
+/*                                                                      */
+/*      Used by the block cache when evicting a block.  It must be      */
+/*      called with the mutex of the block cache shard of the band      */
+/*      held, so that no other thread can lock the block once it is     */
+/*      no longer referenced.                                           */
+/*                                                                      */
+/*      This method is protected.                                       */
+/************************************************************************/
+
+int GDALRasterBand::UnreferenceBlock( GDALRasterBlock *poBlock )
+
+{
+    int nXBlockOff = poBlock->GetXOff();
+    int nYBlockOff = poBlock->GetYOff();
+    GDALRasterBlock **ppoSlot;
+
+    if( papoBlocks == NULL )
+        return FALSE;
+
+    if( !bSubBlockingActive )
+    {
+        ppoSlot = papoBlocks + nXBlockOff + nYBlockOff * nBlocksPerRow;
+    }
+    else
+    {
+        int nSubBlock = TO_SUBBLOCK(nXBlockOff)
+            + TO_SUBBLOCK(nYBlockOff) * nSubBlocksPerRow;
+
+        if( papoBlocks[nSubBlock] == NULL )
+            return FALSE;
+
+        ppoSlot = ((GDALRasterBlock **) papoBlocks[nSubBlock])
+            + WITHIN_SUBBLOCK(nXBlockOff)
+            + WITHIN_SUBBLOCK(nYBlockOff) * SUBBLOCK_SIZE;
+    }
+
+    if( *ppoSlot != poBlock )
+        return FALSE;
+
+    *ppoSlot = NULL;
+
+    return TRUE;
+}
+
 /************************************************************************/
 /*                             FlushCache()                             */
 /************************************************************************/
@@ -886,6 +1147,26 @@ CPLErr GDALRasterBand::AdoptBlock( int nXBlockOff, int nYBlockOff,
 
 CPLErr GDALRasterBand::FlushCache()
 
+{
+    CPLErr eGlobalErr;
+
+    if( poDS != NULL )
+        poDS->EnterReadWrite();
+
+    eGlobalErr = FlushCacheInternal();
+
+    if( poDS != NULL )
+        poDS->LeaveReadWrite();
+
+    return eGlobalErr;
+}
+
+/************************************************************************/
+/*                         FlushCacheInternal()                         */
+/************************************************************************/
+
+CPLErr GDALRasterBand::FlushCacheInternal()
+
 {
     CPLErr eGlobalErr = eFlushBlockErr;
 
@@ -1033,7 +1314,8 @@ CPLErr GDALRasterBand::FlushBlock( int nXBlockOff, int nYBlockOff, int bWriteDir
     {
         nBlockIndex = nXBlockOff + nYBlockOff * nBlocksPerRow;
 
-        GDALRasterBlock::SafeLockBlock( papoBlocks + nBlockIndex );
+        GDALRasterBlock::SafeLockBlock( papoBlocks + nBlockIndex, this,
+                                         nXBlockOff, nYBlockOff, FALSE );
 
         poBlock = papoBlocks[nBlockIndex];
         papoBlocks[nBlockIndex] = NULL;
@@ -1059,7 +1341,8 @@ CPLErr GDALRasterBand::FlushBlock( int nXBlockOff, int nYBlockOff, int bWriteDir
         int nBlockInSubBlock = WITHIN_SUBBLOCK(nXBlockOff)
             + WITHIN_SUBBLOCK(nYBlockOff) * SUBBLOCK_SIZE;
         
-        GDALRasterBlock::SafeLockBlock( papoSubBlockGrid + nBlockInSubBlock );
+        GDALRasterBlock::SafeLockBlock( papoSubBlockGrid + nBlockInSubBlock,
+                                         this, nXBlockOff, nYBlockOff, FALSE );
 
         poBlock = papoSubBlockGrid[nBlockInSubBlock];
         papoSubBlockGrid[nBlockInSubBlock] = NULL;
@@ -1150,7 +1433,8 @@ GDALRasterBlock *GDALRasterBand::TryGetLockedBlockRef( int nXBlockOff,
     {
         nBlockIndex = nXBlockOff + nYBlockOff * nBlocksPerRow;
         
-        GDALRasterBlock::SafeLockBlock( papoBlocks + nBlockIndex );
+        GDALRasterBlock::SafeLockBlock( papoBlocks + nBlockIndex, this,
+                                         nXBlockOff, nYBlockOff );
 
         return papoBlocks[nBlockIndex];
     }
@@ -1173,7 +1457,8 @@ GDALRasterBlock *GDALRasterBand::TryGetLockedBlockRef( int nXBlockOff,
     int nBlockInSubBlock = WITHIN_SUBBLOCK(nXBlockOff)
         + WITHIN_SUBBLOCK(nYBlockOff) * SUBBLOCK_SIZE;
 
-    GDALRasterBlock::SafeLockBlock( papoSubBlockGrid + nBlockInSubBlock );
+    GDALRasterBlock::SafeLockBlock( papoSubBlockGrid + nBlockInSubBlock, this,
+                                     nXBlockOff, nYBlockOff );
 
     return papoSubBlockGrid[nBlockInSubBlock];
 }
@@ -1276,8 +1561,20 @@ GDALRasterBlock * GDALRasterBand::GetLockedBlockRef( int nXBlockOff,
             return( NULL );
         }
 
-        if( !bJustInitialize
-         && IReadBlock(nXBlockOff,nYBlockOff,poBlock->GetDataRef()) != CE_None)
+        CPLErr eErr = CE_None;
+
+        if( !bJustInitialize )
+        {
+            if( poDS != NULL )
+                poDS->EnterReadWrite();
+
+            eErr = IReadBlock(nXBlockOff,nYBlockOff,poBlock->GetDataRef());
+
+            if( poDS != NULL )
+                poDS->LeaveReadWrite();
+        }
+
+        if( eErr != CE_None )
         {
             poBlock->DropLock();
             FlushBlock( nXBlockOff, nYBlockOff );
@@ -4943,3 +5240,69 @@ void GDALRasterBand::ReportError(CPLErr eErrClass, int err_no, const char *fmt,
     }
     va_end(args);
 }
+
+/************************************************************************/
+/*                         GetCacheStatistics()                         */
+/************************************************************************/
+
+/**
+ * \brief Fetch block cache statistics of this band.
+ *
+ * The statistics cover all the blocks of this band that went through
+ * the GDAL block cache since the band was created : number of blocks
+ * found in the cache, number of blocks loaded in the cache, number of
+ * blocks evicted because of cache pressure, number of dirty blocks
+ * written back, and number of bytes currently cached.
+ *
+ * The counters are kept separately for each shard of the block cache,
+ * and summed here without synchronization with other threads, so the
+ * returned values are a snapshot.
+ *
+ * This method is the same as the C function
+ * GDALGetRasterBandCacheStatistics().
+ *
+ * @param psStats the structure to fill.
+ *
+ * @since GDAL 1.9.0
+ */
+
+void GDALRasterBand::GetCacheStatistics( GDALCacheStatistics *psStats )
+
+{
+    int nShards = GDALRasterBlock::GetCacheShardCount();
+
+    memset( psStats, 0, sizeof(GDALCacheStatistics) );
+
+    for( int iShard = 0; iShard < nShards; iShard++ )
+    {
+        const GDALCacheStatistics *psShardStats = pasCacheStats + iShard;
+
+        psStats->nHits += psShardStats->nHits;
+        psStats->nMisses += psShardStats->nMisses;
+        psStats->nEvictions += psShardStats->nEvictions;
+        psStats->nDirtyFlushes += psShardStats->nDirtyFlushes;
+        psStats->nBytesUsed += psShardStats->nBytesUsed;
+    }
+}
+
+/************************************************************************/
+/*                  GDALGetRasterBandCacheStatistics()                  */
+/************************************************************************/
+
+/**
+ * \brief Fetch block cache statistics of a band.
+ *
+ * @see GDALRasterBand::GetCacheStatistics()
+ *
+ * @since GDAL 1.9.0
+ */
+
+void CPL_STDCALL GDALGetRasterBandCacheStatistics( GDALRasterBandH hBand,
+                                                   GDALCacheStatistics *psStats )
+
+{
+    VALIDATE_POINTER0( hBand, "GDALGetRasterBandCacheStatistics" );
+    VALIDATE_POINTER0( psStats, "GDALGetRasterBandCacheStatistics" );
+
+    ((GDALRasterBand *) hBand)->GetCacheStatistics( psStats );
+}
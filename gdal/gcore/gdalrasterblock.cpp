@@ -30,18 +30,647 @@
 
 #include "gdal_priv.h"
 #include "cpl_multiproc.h"
+#include "cpl_atomic_ops.h"
+#include "cpl_hash_set.h"
 
 CPL_CVSID("$Id$");
 
 static int bCacheMaxInitialized = FALSE;
 static GIntBig nCacheMax = 40 * 1024*1024;
-static volatile GIntBig nCacheUsed = 0;
 
-static volatile GDALRasterBlock *poOldest = NULL;    /* tail */
-static volatile GDALRasterBlock *poNewest = NULL;    /* head */
+/* -------------------------------------------------------------------- */
+/*      The block cache is partitioned into a number of shards, each    */
+/*      with its own queues of blocks, byte count and mutex.  A block   */
+/*      belongs to the shard selected by hashing its band and block     */
+/*      offsets, so threads working on different blocks (and in         */
+/*      particular on different datasets) rarely contend on the same    */
+/*      lock.  The memory limit set with GDALSetCacheMax64() applies    */
+/*      to the sum of all shards.                                       */
+/* -------------------------------------------------------------------- */
+
+#define GDAL_RB_MAX_SHARDS      64
+#define GDAL_RB_DEFAULT_SHARDS  16
+
+/* -------------------------------------------------------------------- */
+/*      Eviction policies, selected with GDAL_CACHE_POLICY.             */
+/*                                                                      */
+/*      LRU   : blocks are moved at the head of the main queue each     */
+/*              time they are used, and evicted from its tail.          */
+/*      CLOCK : using a block only sets its reference bit.  Eviction    */
+/*              scans the main queue from its tail, giving a second     */
+/*              chance to referenced blocks.                            */
+/*      2Q    : new blocks enter the A1in FIFO queue, where further     */
+/*              references are considered correlated and ignored.       */
+/*              Blocks evicted from A1in are remembered in the A1out    */
+/*              ghost list, and only blocks reloaded while still in     */
+/*              A1out enter the main (Am) LRU queue, so that a single   */
+/*              sequential scan cannot evict the hot blocks.            */
+/* -------------------------------------------------------------------- */
+
+typedef enum
+{
+    GRBP_LRU,
+    GRBP_CLOCK,
+    GRBP_2Q
+} GDALRBPolicy;
+
+#define GRBQ_MAIN       0   /* LRU list, CLOCK ring, 2Q Am queue */
+#define GRBQ_A1IN       1   /* 2Q A1in queue */
+#define GRBQ_COUNT      2
+
+typedef struct
+{
+    volatile GDALRasterBlock  *poOldest;    /* tail */
+    volatile GDALRasterBlock  *poNewest;    /* head */
+    GIntBig                    nBytes;
+} GDALRBQueue;
+
+typedef struct _GDALRBGhost
+{
+    GDALRasterBand            *poBand;      /* NULL once reused */
+    int                        nXOff;
+    int                        nYOff;
+    struct _GDALRBGhost       *psNext;      /* towards newer ghosts */
+} GDALRBGhost;
+
+typedef struct
+{
+    void                      *hMutex;
+    GDALRBQueue                asQueues[GRBQ_COUNT];
+    volatile GIntBig           nCacheUsed;
+    int                        nBlockCount;
+    volatile GIntBig           nDirtyBytes;
+
+    /* 2Q A1out ghost list */
+    CPLHashSet                *hGhostSet;
+    GDALRBGhost               *psGhostOldest;
+    GDALRBGhost               *psGhostNewest;
+    int                        nGhostCount;
+
+    GDALCacheStatistics        sStats;
+} GDALRBShard;
+
+static GDALRBShard asRBShards[GDAL_RB_MAX_SHARDS];
+static int nRBShards = 0;
+static int nRBPolicy = -1;
+
+/* Shard from which the next eviction attempt starts (round robin). */
+static volatile int nRBNextFlushShard = 0;
+
+/* -------------------------------------------------------------------- */
+/*      Optional background thread writing dirty blocks ahead of        */
+/*      eviction (GDAL_CACHE_WRITEBACK).  It is woken up when the       */
+/*      amount of dirty blocks exceeds GDAL_CACHE_WRITEBACK_HIGH and    */
+/*      writes the oldest dirty blocks until it drops below             */
+/*      GDAL_CACHE_WRITEBACK_LOW, so that evictions done by the         */
+/*      threads producing data mostly find clean blocks.                */
+/* -------------------------------------------------------------------- */
+
+static int nRBWriteBack = -1;
+static void *hRBWriteBackMutex = NULL;
+static void *hRBWriteBackCond = NULL;
+static void *hRBWriteBackThread = NULL;
+static volatile int bRBWriteBackStop = FALSE;
+
+/* Shard from which the next write-back attempt starts (round robin). */
+static volatile int nRBNextWriteBackShard = 0;
+
+/* Period, in seconds, of the statistics dump (GDAL_CACHE_STATS_INTERVAL) */
+static int nRBStatsInterval = -1;
+static volatile time_t nRBLastStatsDump = 0;
+
+/************************************************************************/
+/*                       GDALGetCacheShardCount()                       */
+/*                                                                      */
+/*      The number of shards is read once from the GDAL_CACHE_SHARDS    */
+/*      configuration option and cannot change afterwards, since        */
+/*      cached blocks remember the shard they have been assigned to.    */
+/************************************************************************/
+
+static int GDALGetCacheShardCount()
+
+{
+    if( nRBShards == 0 )
+    {
+        int nShards = atoi( CPLGetConfigOption( "GDAL_CACHE_SHARDS",
+                                                CPLSPrintf( "%d", GDAL_RB_DEFAULT_SHARDS ) ) );
+        if( nShards < 1 )
+            nShards = 1;
+        else if( nShards > GDAL_RB_MAX_SHARDS )
+            nShards = GDAL_RB_MAX_SHARDS;
+
+        nRBShards = nShards;
+    }
+
+    return nRBShards;
+}
+
+/************************************************************************/
+/*                         GDALGetCachePolicy()                         */
+/*                                                                      */
+/*      Like the number of shards, the policy is read once from the     */
+/*      GDAL_CACHE_POLICY configuration option.                         */
+/************************************************************************/
+
+static GDALRBPolicy GDALGetCachePolicy()
+
+{
+    if( nRBPolicy < 0 )
+    {
+        const char *pszPolicy = CPLGetConfigOption( "GDAL_CACHE_POLICY", "LRU" );
+
+        if( EQUAL(pszPolicy, "CLOCK") )
+            nRBPolicy = GRBP_CLOCK;
+        else if( EQUAL(pszPolicy, "2Q") )
+            nRBPolicy = GRBP_2Q;
+        else
+        {
+            if( !EQUAL(pszPolicy, "LRU") )
+                CPLError( CE_Warning, CPLE_NotSupported,
+                          "Unsupported value for GDAL_CACHE_POLICY : %s. "
+                          "Using LRU.", pszPolicy );
+            nRBPolicy = GRBP_LRU;
+        }
+    }
+
+    return (GDALRBPolicy) nRBPolicy;
+}
+
+/************************************************************************/
+/*                          GDALRBHashBlock()                           */
+/************************************************************************/
+
+static GUIntBig GDALRBHashBlock( GDALRasterBand *poBand, 
+                                 int nXOff, int nYOff )
+
+{
+    GUIntBig nHash = ((GUIntBig) (size_t) poBand) >> 4;
+
+    nHash = nHash * 31 + (GUIntBig) nXOff;
+    nHash = nHash * 31 + (GUIntBig) nYOff;
+    nHash ^= nHash >> 16;
+
+    return nHash;
+}
+
+/************************************************************************/
+/*                       GDALGetCacheShardIndex()                       */
+/************************************************************************/
+
+static int GDALGetCacheShardIndex( GDALRasterBand *poBand, 
+                                   int nXOff, int nYOff )
+
+{
+    return (int) (GDALRBHashBlock( poBand, nXOff, nYOff )
+                  % GDALGetCacheShardCount());
+}
+
+/************************************************************************/
+/*                      GDALGetCacheUsedInternal()                      */
+/*                                                                      */
+/*      Sum of the bytes held by all the shards.  The per-shard         */
+/*      counters are read without taking the shard mutexes, so the      */
+/*      result is only a snapshot when other threads are active.        */
+/************************************************************************/
+
+static GIntBig GDALGetCacheUsedInternal()
+
+{
+    GIntBig nTotal = 0;
+    int     nShards = GDALGetCacheShardCount();
+
+    for( int iShard = 0; iShard < nShards; iShard++ )
+        nTotal += asRBShards[iShard].nCacheUsed;
+
+    return nTotal;
+}
+
+/************************************************************************/
+/*                        GDALRBGetBlockBytes()                         */
+/************************************************************************/
+
+static int GDALRBGetBlockBytes( GDALRasterBlock *poBlock )
+
+{
+    return poBlock->GetXSize() * poBlock->GetYSize()
+        * (GDALGetDataTypeSize(poBlock->GetDataType()) / 8);
+}
+
+/************************************************************************/
+/*                         GDALParseCacheSize()                         */
+/*                                                                      */
+/*      Parse a cache size, either expressed as a percentage of the     */
+/*      cache maximum (e.g. "25%"), in megabytes for values below       */
+/*      100000 (as for GDAL_CACHEMAX), or in bytes otherwise.           */
+/************************************************************************/
+
+static GIntBig GDALParseCacheSize( const char *pszValue )
+
+{
+    if( strchr(pszValue, '%') != NULL )
+        return (GIntBig) (GDALGetCacheMax64() * CPLAtof(pszValue) / 100.0);
+
+    GIntBig nValue = (GIntBig) CPLScanUIntBig( pszValue, strlen(pszValue) );
+    if( nValue < 100000 )
+        nValue *= 1024 * 1024;
+
+    return nValue;
+}
+
+/************************************************************************/
+/*                        GDALGetCacheQuota()                           */
+/*                                                                      */
+/*      Fetch the maximum amount of cache memory a dataset may use.     */
+/*      GDAL_CACHE_DATASET_MAX_<driver> takes precedence over the       */
+/*      GDAL_CACHE_DATASET_MAX default.  0 means no quota.              */
+/************************************************************************/
+
+static GIntBig GDALGetCacheQuota( GDALDataset *poDS )
+
+{
+    const char *pszQuota = NULL;
+    GDALDriver *poDriver = poDS->GetDriver();
+
+    if( poDriver != NULL )
+        pszQuota = CPLGetConfigOption( 
+            CPLSPrintf( "GDAL_CACHE_DATASET_MAX_%s", 
+                        poDriver->GetDescription() ), NULL );
+
+    if( pszQuota == NULL )
+        pszQuota = CPLGetConfigOption( "GDAL_CACHE_DATASET_MAX", NULL );
+
+    if( pszQuota == NULL )
+        return 0;
+
+    return GDALParseCacheSize( pszQuota );
+}
+
+/************************************************************************/
+/*                      Ghost list (2Q A1out) helpers.                  */
+/************************************************************************/
+
+static unsigned long GDALRBGhostHash( const void *pElt )
+{
+    const GDALRBGhost *psGhost = (const GDALRBGhost *) pElt;
+
+    return (unsigned long) GDALRBHashBlock( psGhost->poBand,
+                                            psGhost->nXOff, psGhost->nYOff );
+}
+
+static int GDALRBGhostEqual( const void *pElt1, const void *pElt2 )
+{
+    const GDALRBGhost *psGhost1 = (const GDALRBGhost *) pElt1;
+    const GDALRBGhost *psGhost2 = (const GDALRBGhost *) pElt2;
+
+    return psGhost1->poBand == psGhost2->poBand
+        && psGhost1->nXOff == psGhost2->nXOff
+        && psGhost1->nYOff == psGhost2->nYOff;
+}
 
-static void *hRBMutex = NULL;
+/* Must be called with the shard mutex held. */
+static void GDALRBAddGhost( GDALRBShard *psShard, GDALRasterBlock *poBlock )
 
+{
+    if( psShard->hGhostSet == NULL )
+        psShard->hGhostSet = CPLHashSetNew( GDALRBGhostHash, 
+                                            GDALRBGhostEqual, NULL );
+
+    GDALRBGhost *psGhost = (GDALRBGhost *) CPLMalloc( sizeof(GDALRBGhost) );
+    psGhost->poBand = poBlock->GetBand();
+    psGhost->nXOff = poBlock->GetXOff();
+    psGhost->nYOff = poBlock->GetYOff();
+    psGhost->psNext = NULL;
+
+    /* Replace a possible older ghost of the same block */
+    GDALRBGhost *psOld = (GDALRBGhost *) 
+        CPLHashSetLookup( psShard->hGhostSet, psGhost );
+    if( psOld != NULL )
+    {
+        CPLHashSetRemove( psShard->hGhostSet, psOld );
+        psOld->poBand = NULL;
+    }
+
+    CPLHashSetInsert( psShard->hGhostSet, psGhost );
+
+    if( psShard->psGhostNewest != NULL )
+        psShard->psGhostNewest->psNext = psGhost;
+    else
+        psShard->psGhostOldest = psGhost;
+    psShard->psGhostNewest = psGhost;
+    psShard->nGhostCount++;
+
+/* -------------------------------------------------------------------- */
+/*      Keep A1out to about half the number of resident blocks.         */
+/* -------------------------------------------------------------------- */
+    int nGhostMax = MAX( 32, psShard->nBlockCount / 2 );
+
+    while( psShard->nGhostCount > nGhostMax )
+    {
+        GDALRBGhost *psOldest = psShard->psGhostOldest;
+
+        psShard->psGhostOldest = psOldest->psNext;
+        if( psShard->psGhostOldest == NULL )
+            psShard->psGhostNewest = NULL;
+        psShard->nGhostCount--;
+
+        if( psOldest->poBand != NULL )
+            CPLHashSetRemove( psShard->hGhostSet, psOldest );
+        CPLFree( psOldest );
+    }
+}
+
+/* Must be called with the shard mutex held. */
+static int GDALRBTakeGhost( GDALRBShard *psShard, GDALRasterBlock *poBlock )
+
+{
+    if( psShard->hGhostSet == NULL )
+        return FALSE;
+
+    GDALRBGhost sKey;
+    sKey.poBand = poBlock->GetBand();
+    sKey.nXOff = poBlock->GetXOff();
+    sKey.nYOff = poBlock->GetYOff();
+
+    GDALRBGhost *psGhost = (GDALRBGhost *) 
+        CPLHashSetLookup( psShard->hGhostSet, &sKey );
+    if( psGhost == NULL )
+        return FALSE;
+
+    /* The entry stays in the FIFO until it is trimmed */
+    CPLHashSetRemove( psShard->hGhostSet, psGhost );
+    psGhost->poBand = NULL;
+
+    return TRUE;
+}
+
+/* Must be called with the shard mutex held. */
+static void GDALRBClearGhosts( GDALRBShard *psShard )
+
+{
+    while( psShard->psGhostOldest != NULL )
+    {
+        GDALRBGhost *psNext = psShard->psGhostOldest->psNext;
+        CPLFree( psShard->psGhostOldest );
+        psShard->psGhostOldest = psNext;
+    }
+    psShard->psGhostNewest = NULL;
+    psShard->nGhostCount = 0;
+
+    if( psShard->hGhostSet != NULL )
+    {
+        CPLHashSetDestroy( psShard->hGhostSet );
+        psShard->hGhostSet = NULL;
+    }
+}
+
+/************************************************************************/
+/*                   GDALRBClearGhostsIfCacheEmpty()                    */
+/*                                                                      */
+/*      Ghosts may reference bands that have been destroyed, so we      */
+/*      release them once the cache is completely empty, which is       */
+/*      typically the case once all datasets are closed.  Must be       */
+/*      called without any shard mutex held.                            */
+/************************************************************************/
+
+static void GDALRBClearGhostsIfCacheEmpty()
+
+{
+    int nShards = GDALGetCacheShardCount();
+    int iShard;
+
+    for( iShard = 0; iShard < nShards; iShard++ )
+    {
+        if( asRBShards[iShard].nBlockCount != 0 )
+            return;
+    }
+
+    for( iShard = 0; iShard < nShards; iShard++ )
+    {
+        GDALRBShard *psShard = asRBShards + iShard;
+
+        if( psShard->psGhostOldest == NULL && psShard->hGhostSet == NULL )
+            continue;
+
+        CPLMutexHolderD( &(psShard->hMutex) );
+        if( psShard->nBlockCount == 0 )
+            GDALRBClearGhosts( psShard );
+    }
+}
+
+/************************************************************************/
+/*                    GDALRBDumpStatisticsIfNeeded()                    */
+/*                                                                      */
+/*      Emit the block cache statistics as debug messages every         */
+/*      GDAL_CACHE_STATS_INTERVAL seconds (disabled by default).        */
+/*      Must be called without any shard mutex held.                    */
+/************************************************************************/
+
+static void GDALRBDumpStatisticsIfNeeded()
+
+{
+    static void *hStatsMutex = NULL;
+
+    if( nRBStatsInterval < 0 )
+        nRBStatsInterval = 
+            MAX(0, atoi(CPLGetConfigOption( "GDAL_CACHE_STATS_INTERVAL", "0" )));
+
+    if( nRBStatsInterval == 0 )
+        return;
+
+    time_t nNow = time( NULL );
+    if( nNow - nRBLastStatsDump < nRBStatsInterval )
+        return;
+
+    {
+        CPLMutexHolderD( &hStatsMutex );
+        if( nNow - nRBLastStatsDump < nRBStatsInterval )
+            return;
+        nRBLastStatsDump = nNow;
+    }
+
+    GDALCacheStatistics sStats;
+    GIntBig nLookups;
+
+    GDALGetCacheStatistics( &sStats );
+    nLookups = sStats.nHits + sStats.nMisses;
+
+    CPLDebug( "GDAL", 
+              "Block cache: " CPL_FRMT_GIB " hits, " CPL_FRMT_GIB " misses "
+              "(%.1f%% hit rate), " CPL_FRMT_GIB " evictions, "
+              CPL_FRMT_GIB " dirty flushes, " CPL_FRMT_GIB "/" CPL_FRMT_GIB
+              " bytes used",
+              sStats.nHits, sStats.nMisses,
+              nLookups ? 100.0 * sStats.nHits / nLookups : 0.0,
+              sStats.nEvictions, sStats.nDirtyFlushes,
+              sStats.nBytesUsed, GDALGetCacheMax64() );
+
+    GDALDumpOpenDatasetsCacheStatistics();
+}
+
+/************************************************************************/
+/*                    GDALIsCacheWriteBackEnabled()                     */
+/*                                                                      */
+/*      Read once from the GDAL_CACHE_WRITEBACK configuration option,   */
+/*      since datasets create their read/write mutex according to it.   */
+/************************************************************************/
+
+int GDALIsCacheWriteBackEnabled()
+
+{
+    if( nRBWriteBack < 0 )
+        nRBWriteBack = 
+            CSLTestBoolean( CPLGetConfigOption( "GDAL_CACHE_WRITEBACK", "NO" ) )
+            && !EQUAL(CPLGetThreadingModel(), "stub");
+
+    return nRBWriteBack;
+}
+
+/************************************************************************/
+/*                         GDALRBGetDirtyBytes()                        */
+/************************************************************************/
+
+static GIntBig GDALRBGetDirtyBytes()
+
+{
+    GIntBig nTotal = 0;
+    int     nShards = GDALGetCacheShardCount();
+
+    for( int iShard = 0; iShard < nShards; iShard++ )
+        nTotal += asRBShards[iShard].nDirtyBytes;
+
+    return nTotal;
+}
+
+/************************************************************************/
+/*                    GDALRBGetWriteBackWatermarks()                    */
+/************************************************************************/
+
+static void GDALRBGetWriteBackWatermarks( GIntBig *pnHigh, GIntBig *pnLow )
+
+{
+    *pnHigh = GDALParseCacheSize( 
+        CPLGetConfigOption( "GDAL_CACHE_WRITEBACK_HIGH", "50%" ) );
+    *pnLow = GDALParseCacheSize( 
+        CPLGetConfigOption( "GDAL_CACHE_WRITEBACK_LOW", "25%" ) );
+
+    if( *pnLow > *pnHigh )
+        *pnLow = *pnHigh;
+}
+
+/************************************************************************/
+/*                        GDALRBWriteBackThread()                       */
+/************************************************************************/
+
+static void GDALRBWriteBackThread( void * )
+
+{
+    GIntBig nHigh, nLow;
+
+    CPLAcquireMutex( hRBWriteBackMutex, 1000.0 );
+
+    while( !bRBWriteBackStop )
+    {
+        GDALRBGetWriteBackWatermarks( &nHigh, &nLow );
+
+        if( GDALRBGetDirtyBytes() <= nHigh )
+        {
+            CPLCondWait( hRBWriteBackCond, hRBWriteBackMutex );
+            continue;
+        }
+
+        CPLReleaseMutex( hRBWriteBackMutex );
+
+/* -------------------------------------------------------------------- */
+/*      Write the oldest dirty blocks until we are below the low        */
+/*      watermark.  If all the dirty blocks are in use, retry a bit     */
+/*      later.                                                          */
+/* -------------------------------------------------------------------- */
+        while( !bRBWriteBackStop && GDALRBGetDirtyBytes() > nLow )
+        {
+            if( !GDALRasterBlock::WriteBackCacheBlock() )
+            {
+                CPLSleep( 0.01 );
+                break;
+            }
+        }
+
+        CPLAcquireMutex( hRBWriteBackMutex, 1000.0 );
+    }
+
+    CPLReleaseMutex( hRBWriteBackMutex );
+}
+
+/************************************************************************/
+/*                         GDALRBWakeWriteBack()                        */
+/*                                                                      */
+/*      Start the write-back thread, or wake it up, if the amount of    */
+/*      dirty blocks exceeds the high watermark.                        */
+/************************************************************************/
+
+static void GDALRBWakeWriteBack()
+
+{
+    GIntBig nHigh, nLow;
+
+    GDALRBGetWriteBackWatermarks( &nHigh, &nLow );
+    if( GDALRBGetDirtyBytes() <= nHigh )
+        return;
+
+    CPLMutexHolderD( &hRBWriteBackMutex );
+
+    if( hRBWriteBackThread == NULL && !bRBWriteBackStop )
+    {
+        if( hRBWriteBackCond == NULL )
+            hRBWriteBackCond = CPLCreateCond();
+
+        if( hRBWriteBackCond != NULL )
+            hRBWriteBackThread = 
+                CPLCreateJoinableThread( GDALRBWriteBackThread, NULL );
+
+        if( hRBWriteBackThread == NULL )
+        {
+            CPLError( CE_Warning, CPLE_AppDefined,
+                      "Cannot start the block cache write-back thread. "
+                      "Dirty blocks will be written on eviction." );
+            bRBWriteBackStop = TRUE;
+        }
+    }
+    else if( hRBWriteBackThread != NULL )
+        CPLCondSignal( hRBWriteBackCond );
+}
+
+/************************************************************************/
+/*                       GDALStopCacheWriteBack()                       */
+/*                                                                      */
+/*      Stop the write-back thread if it is running.  Called from       */
+/*      GDALDestroyDriverManager() once all datasets are closed.        */
+/************************************************************************/
+
+void GDALStopCacheWriteBack()
+
+{
+    void *hThread;
+
+    {
+        CPLMutexHolderD( &hRBWriteBackMutex );
+
+        hThread = hRBWriteBackThread;
+        if( hThread == NULL )
+            return;
+
+        bRBWriteBackStop = TRUE;
+        CPLCondBroadcast( hRBWriteBackCond );
+    }
+
+    CPLJoinThread( hThread );
+
+    {
+        CPLMutexHolderD( &hRBWriteBackMutex );
+
+        hRBWriteBackThread = NULL;
+        bRBWriteBackStop = FALSE;
+    }
+}
 
 /************************************************************************/
 /*                          GDALSetCacheMax()                           */
@@ -95,13 +724,9 @@ void CPL_STDCALL GDALSetCacheMax64( GIntBig nNewSizeInBytes )
 /*      Flush blocks till we are under the new limit or till we         */
 /*      can't seem to flush anymore.                                    */
 /* -------------------------------------------------------------------- */
-    while( nCacheUsed > nCacheMax )
+    while( GDALGetCacheUsedInternal() > nCacheMax )
     {
-        GIntBig nOldCacheUsed = nCacheUsed;
-
-        GDALFlushCacheBlock();
-
-        if( nCacheUsed == nOldCacheUsed )
+        if( !GDALFlushCacheBlock() )
             break;
     }
 }
@@ -200,6 +825,8 @@ GIntBig CPL_STDCALL GDALGetCacheMax64()
 
 int CPL_STDCALL GDALGetCacheUsed()
 {
+    GIntBig nCacheUsed = GDALGetCacheUsedInternal();
+
     if (nCacheUsed > INT_MAX)
     {
         static int bHasWarned = FALSE;
@@ -230,7 +857,7 @@ int CPL_STDCALL GDALGetCacheUsed()
 
 GIntBig CPL_STDCALL GDALGetCacheUsed64()
 {
-    return nCacheUsed;
+    return GDALGetCacheUsedInternal();
 }
 
 /************************************************************************/
@@ -248,10 +875,85 @@ GIntBig CPL_STDCALL GDALGetCacheUsed64()
  * @return TRUE if one block was flushed, FALSE if there are no cached blocks
  *         or if they are currently locked.
  */
-int CPL_STDCALL GDALFlushCacheBlock()
+int CPL_STDCALL GDALFlushCacheBlock()
+
+{
+    return GDALRasterBlock::FlushCacheBlock();
+}
+
+/************************************************************************/
+/*                       GDALGetCacheStatistics()                       */
+/************************************************************************/
+
+/**
+ * \brief Fetch block cache statistics.
+ *
+ * Returns the number of block lookups satisfied from the cache (hits),
+ * the number of blocks that had to be loaded (misses), the number of
+ * blocks evicted to make room for other blocks, the number of dirty
+ * blocks written back and the number of bytes currently cached, since
+ * the start of the process or the last call to GDALResetCacheStatistics().
+ *
+ * The counters are read without stopping other threads, so the returned
+ * values are only a snapshot when the cache is being used concurrently.
+ *
+ * Statistics for a single dataset or band can be fetched with
+ * GDALGetDatasetCacheStatistics() and GDALGetRasterBandCacheStatistics().
+ * Setting the GDAL_CACHE_STATS_INTERVAL configuration option to a number
+ * of seconds causes the global and per band statistics to be periodically
+ * emitted as debug messages.
+ *
+ * @param psStats the structure to fill (must not be NULL).
+ *
+ * @since GDAL 1.9.0
+ */
+
+void CPL_STDCALL GDALGetCacheStatistics( GDALCacheStatistics *psStats )
+
+{
+    VALIDATE_POINTER0( psStats, "GDALGetCacheStatistics" );
+
+    int nShards = GDALGetCacheShardCount();
+
+    memset( psStats, 0, sizeof(GDALCacheStatistics) );
+
+    for( int iShard = 0; iShard < nShards; iShard++ )
+    {
+        const GDALCacheStatistics *psShardStats = &(asRBShards[iShard].sStats);
+
+        psStats->nHits += psShardStats->nHits;
+        psStats->nMisses += psShardStats->nMisses;
+        psStats->nEvictions += psShardStats->nEvictions;
+        psStats->nDirtyFlushes += psShardStats->nDirtyFlushes;
+    }
+
+    psStats->nBytesUsed = GDALGetCacheUsedInternal();
+}
+
+/************************************************************************/
+/*                      GDALResetCacheStatistics()                      */
+/************************************************************************/
+
+/**
+ * \brief Reset the global block cache statistics.
+ *
+ * The hit, miss, eviction and dirty flush counters returned by
+ * GDALGetCacheStatistics() are reset to zero.  The counters of the
+ * individual bands are not affected.
+ *
+ * @since GDAL 1.9.0
+ */
+
+void CPL_STDCALL GDALResetCacheStatistics()
 
 {
-    return GDALRasterBlock::FlushCacheBlock();
+    int nShards = GDALGetCacheShardCount();
+
+    for( int iShard = 0; iShard < nShards; iShard++ )
+    {
+        CPLMutexHolderD( &(asRBShards[iShard].hMutex) );
+        memset( &(asRBShards[iShard].sStats), 0, sizeof(GDALCacheStatistics) );
+    }
 }
 
 /************************************************************************/
@@ -270,11 +972,37 @@ int CPL_STDCALL GDALFlushCacheBlock()
  * a least recently used (LRU) list and an upper cache limit (see
  * GDALSetCacheMax()) under which the cache size is normally kept. 
  *
+ * To reduce lock contention between threads, the cache is split into
+ * a number of shards (16 by default, see the GDAL_CACHE_SHARDS
+ * configuration option), each with its own LRU list and mutex.  Blocks
+ * are assigned to a shard according to their band and offsets, and the
+ * cache limit applies to the total of all shards.
+ *
+ * The eviction policy can be selected with the GDAL_CACHE_POLICY
+ * configuration option : LRU (the default), CLOCK, or 2Q.  The latter
+ * prevents a single sequential scan of a large dataset from evicting the
+ * frequently used blocks of other datasets.  The GDAL_CACHE_DATASET_MAX
+ * configuration option can also be used to limit the amount of cache a
+ * single dataset may use, either in megabytes (for values below 100000),
+ * in bytes, or as a percentage of the cache maximum (e.g. "25%").  It can
+ * be overridden for the datasets of a given driver with
+ * GDAL_CACHE_DATASET_MAX_<driver short name>.
+ *
  * Some blocks in the cache may be modified relative to the state on disk
  * (they are marked "Dirty") and must be flushed to disk before they can
  * be discarded.  Other (Clean) blocks may just be discarded if their memory
  * needs to be recovered. 
  *
+ * By default, dirty blocks are written by the thread that needs to evict
+ * them to make room for a new block.  When the GDAL_CACHE_WRITEBACK
+ * configuration option is set to YES, a background thread writes the
+ * oldest dirty blocks as soon as they exceed GDAL_CACHE_WRITEBACK_HIGH
+ * (50% of the cache maximum by default), until they drop below
+ * GDAL_CACHE_WRITEBACK_LOW (25% by default), and evictions pick clean
+ * blocks in priority.  Both thresholds accept the same syntax as
+ * GDAL_CACHE_DATASET_MAX.  Calls to the driver of a dataset are then
+ * serialized with the writes done by the background thread.
+ *
  * In normal situations applications do not interact directly with the
  * GDALRasterBlock - instead it it utilized by the RasterIO() interfaces
  * to implement caching. 
@@ -301,44 +1029,284 @@ int CPL_STDCALL GDALFlushCacheBlock()
  * for a new cache block would put cache memory use over the established
  * limit.   
  *
+ * The shards of the cache are visited in a round robin fashion, and the
+ * block selected by the eviction policy in the first shard having an
+ * unlocked block is flushed, which approximates a global policy.
+ *
+ * When the write-back thread is enabled (GDAL_CACHE_WRITEBACK=YES), clean
+ * blocks are evicted in priority, and a dirty block is only written if its
+ * dataset is not being used by another thread.
+ *
  * C++ analog to the C function GDALFlushCacheBlock().
+ *
+ * @param poDS if not NULL, only blocks belonging to this dataset are
+ * considered.  This is used to enforce per-dataset cache quotas.
  * 
  * @return TRUE if successful or FALSE if no flushable block is found.
  */
 
-int GDALRasterBlock::FlushCacheBlock()
+int GDALRasterBlock::FlushCacheBlock( GDALDataset *poDS )
 
 {
-    int nXOff, nYOff;
-    GDALRasterBand *poBand;
+    GDALRasterBlock *poTarget = NULL;
+    GDALDataset *poLockedDS = NULL;
+    int nShards = GDALGetCacheShardCount();
+    int nPasses = GDALIsCacheWriteBackEnabled() ? 2 : 1;
+    unsigned int nStartShard = (unsigned int) CPLAtomicInc( &nRBNextFlushShard );
 
+    for( int i = 0; i < nShards * nPasses && poTarget == NULL; i++ )
     {
-        CPLMutexHolderD( &hRBMutex );
-        GDALRasterBlock *poTarget = (GDALRasterBlock *) poOldest;
+        int nShard = (int) ((nStartShard + i) % nShards);
+        int bCleanOnly = (i < nShards * (nPasses - 1));
+
+        if( asRBShards[nShard].nBlockCount == 0 )
+            continue;
+
+        CPLMutexHolderD( &(asRBShards[nShard].hMutex) );
+        poTarget = SelectVictim( nShard, poDS, bCleanOnly, &poLockedDS );
 
-        while( poTarget != NULL && poTarget->GetLockCount() > 0 ) 
-            poTarget = poTarget->poPrevious;
-        
         if( poTarget == NULL )
-            return FALSE;
+            continue;
+
+/* -------------------------------------------------------------------- */
+/*      Remove the block from its band while the shard mutex is still   */
+/*      held: once released, other threads must not be able to find    */
+/*      and lock the block we are about to write and destroy.  Should   */
+/*      it have been locked meanwhile, it is kept and touched again.    */
+/* -------------------------------------------------------------------- */
+        int bReferenced = poTarget->poBand->UnreferenceBlock( poTarget );
+
+        if( poTarget->GetLockCount() != 0 )
+        {
+            if( bReferenced )
+                poTarget->poBand->AdoptBlock( poTarget->GetXOff(), 
+                                              poTarget->GetYOff(), poTarget );
+            poTarget->Touch();
+
+            if( poLockedDS != NULL )
+            {
+                poLockedDS->LeaveReadWrite();
+                poLockedDS = NULL;
+            }
+            poTarget = NULL;
+            continue;
+        }
 
         poTarget->Detach();
 
-        nXOff = poTarget->GetXOff();
-        nYOff = poTarget->GetYOff();
-        poBand = poTarget->GetBand();
+        asRBShards[nShard].sStats.nEvictions++;
+        poTarget->poBand->pasCacheStats[nShard].nEvictions++;
     }
 
-    CPLErr eErr = poBand->FlushBlock( nXOff, nYOff );
+    if( poTarget == NULL )
+        return FALSE;
+
+/* -------------------------------------------------------------------- */
+/*      Write the block if it is dirty, and destroy it.                 */
+/* -------------------------------------------------------------------- */
+    GDALRasterBand *poBand = poTarget->GetBand();
+    CPLErr eErr = poTarget->Write();
+
     if (eErr != CE_None)
     {
         /* Save the error for later reporting */
         poBand->SetFlushBlockErr(eErr);
     }
 
+    delete poTarget;
+
+    if( poLockedDS != NULL )
+    {
+        poLockedDS->LeaveReadWrite();
+        GDALRBWakeWriteBack();
+    }
+
     return TRUE;
 }
 
+/************************************************************************/
+/*                            SelectVictim()                            */
+/*                                                                      */
+/*      Select the next block to evict from a shard according to the    */
+/*      eviction policy, or NULL if all blocks are locked.  Must be     */
+/*      called with the shard mutex held.                               */
+/*                                                                      */
+/*      When the write-back thread is enabled, dirty blocks are         */
+/*      skipped if bCleanOnly is set, and otherwise only selected if    */
+/*      their dataset could be entered without waiting, in which case   */
+/*      it is returned in *ppoLockedDS and must be left by the caller   */
+/*      once the block is written.                                      */
+/************************************************************************/
+
+GDALRasterBlock *GDALRasterBlock::SelectVictim( int nShard, 
+                                                GDALDataset *poDS,
+                                                int bCleanOnly,
+                                                GDALDataset **ppoLockedDS )
+
+{
+    GDALRBShard *psShard = asRBShards + nShard;
+    GDALRBPolicy ePolicy = GDALGetCachePolicy();
+    int anQueues[GRBQ_COUNT] = { GRBQ_MAIN, GRBQ_A1IN };
+
+/* -------------------------------------------------------------------- */
+/*      2Q evicts from A1in as long as it holds more than a quarter     */
+/*      of the shard memory.                                            */
+/* -------------------------------------------------------------------- */
+    if( ePolicy == GRBP_2Q 
+        && (psShard->asQueues[GRBQ_A1IN].nBytes > psShard->nCacheUsed / 4
+            || psShard->asQueues[GRBQ_MAIN].poOldest == NULL) )
+    {
+        anQueues[0] = GRBQ_A1IN;
+        anQueues[1] = GRBQ_MAIN;
+    }
+
+    for( int iQueue = 0; iQueue < GRBQ_COUNT; iQueue++ )
+    {
+        GDALRBQueue *psQueue = psShard->asQueues + anQueues[iQueue];
+
+/* -------------------------------------------------------------------- */
+/*      CLOCK gives a second chance to referenced blocks.  They are     */
+/*      moved to the head of the queue with their bit cleared, so a     */
+/*      second pass is needed if all candidates were referenced.        */
+/* -------------------------------------------------------------------- */
+        int nPasses = (ePolicy == GRBP_CLOCK) ? 2 : 1;
+
+        for( int iPass = 0; iPass < nPasses; iPass++ )
+        {
+            GDALRasterBlock *poTarget = (GDALRasterBlock *) psQueue->poOldest;
+
+            while( poTarget != NULL )
+            {
+                GDALRasterBlock *poPrev = poTarget->poPrevious;
+
+                GDALDataset *poTargetDS = poTarget->poBand->GetDataset();
+                int bWriteBack = poTarget->bDirty && poTargetDS != NULL
+                    && GDALIsCacheWriteBackEnabled();
+
+                if( poTarget->GetLockCount() == 0
+                    && (poDS == NULL || poTargetDS == poDS)
+                    && !(bWriteBack && bCleanOnly) )
+                {
+                    if( !poTarget->bCacheReferenced )
+                    {
+                        if( bWriteBack )
+                        {
+                            if( !poTargetDS->TryEnterReadWrite() )
+                            {
+                                poTarget = poPrev;
+                                continue;
+                            }
+                            *ppoLockedDS = poTargetDS;
+                        }
+
+                        if( anQueues[iQueue] == GRBQ_A1IN )
+                            GDALRBAddGhost( psShard, poTarget );
+                        return poTarget;
+                    }
+
+                    poTarget->bCacheReferenced = FALSE;
+                    poTarget->UnlinkFromQueue();
+                    poTarget->LinkToQueue( GRBQ_MAIN );
+                }
+
+                poTarget = poPrev;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/************************************************************************/
+/*                        WriteBackCacheBlock()                         */
+/************************************************************************/
+
+/**
+ * \brief Write the oldest dirty block of the cache.
+ *
+ * This static method is used by the write-back thread (see the
+ * GDAL_CACHE_WRITEBACK configuration option) to write dirty blocks ahead
+ * of their eviction.  The block stays in the cache, and is marked clean.
+ * Blocks that are locked, or whose dataset is being used by another
+ * thread, are skipped.
+ *
+ * @return TRUE if a block was written, or FALSE if no dirty block could
+ * be written.
+ *
+ * @since GDAL 1.9.0
+ */
+
+int GDALRasterBlock::WriteBackCacheBlock()
+
+{
+    int nShards = GDALGetCacheShardCount();
+    unsigned int nStartShard = 
+        (unsigned int) CPLAtomicInc( &nRBNextWriteBackShard );
+
+    for( int i = 0; i < nShards; i++ )
+    {
+        GDALRBShard *psShard = asRBShards + (nStartShard + i) % nShards;
+        GDALRasterBlock *poTarget = NULL;
+        GDALDataset *poTargetDS = NULL;
+
+        if( psShard->nDirtyBytes == 0 )
+            continue;
+
+/* -------------------------------------------------------------------- */
+/*      Find the oldest dirty block whose dataset is available, and     */
+/*      lock it so that it cannot be evicted while we write it.         */
+/* -------------------------------------------------------------------- */
+        {
+            CPLMutexHolderD( &(psShard->hMutex) );
+
+            for( int iQueue = 0; iQueue < GRBQ_COUNT && poTarget == NULL; 
+                 iQueue++ )
+            {
+                GDALRasterBlock *poBlock = 
+                    (GDALRasterBlock *) psShard->asQueues[iQueue].poOldest;
+
+                for( ; poBlock != NULL; poBlock = poBlock->poPrevious )
+                {
+                    poTargetDS = poBlock->poBand->GetDataset();
+
+                    if( poBlock->bDirty && poBlock->GetLockCount() == 0
+                        && poTargetDS != NULL
+                        && poTargetDS->TryEnterReadWrite() )
+                    {
+                        poTarget = poBlock;
+                        poTarget->AddLock();
+                        break;
+                    }
+                }
+            }
+        }
+
+        if( poTarget == NULL )
+            continue;
+
+/* -------------------------------------------------------------------- */
+/*      Write it.                                                       */
+/* -------------------------------------------------------------------- */
+        CPLErr eErr = poTarget->Write();
+        if( eErr != CE_None )
+        {
+            /* Save the error for later reporting */
+            poTarget->poBand->SetFlushBlockErr( eErr );
+        }
+
+        {
+            CPLMutexHolderD( &(psShard->hMutex) );
+            poTarget->DropLock();
+        }
+
+        poTargetDS->LeaveReadWrite();
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
 /************************************************************************/
 /*                          GDALRasterBlock()                           */
 /************************************************************************/
@@ -376,6 +1344,10 @@ GDALRasterBlock::GDALRasterBlock( GDALRasterBand *poBandIn,
 
     nXOff = nXOffIn;
     nYOff = nYOffIn;
+
+    nCacheShard = GDALGetCacheShardIndex( poBand, nXOff, nYOff );
+    nCacheQueue = -1;
+    bCacheReferenced = FALSE;
 }
 
 /************************************************************************/
@@ -402,11 +1374,26 @@ GDALRasterBlock::~GDALRasterBlock()
         nSizeInBytes = (nXSize * nYSize * GDALGetDataTypeSize(eType)+7)/8;
 
         {
-            CPLMutexHolderD( &hRBMutex );
-            nCacheUsed -= nSizeInBytes;
+            CPLMutexHolderD( &(asRBShards[nCacheShard].hMutex) );
+            asRBShards[nCacheShard].nCacheUsed -= nSizeInBytes;
+            poBand->pasCacheStats[nCacheShard].nBytesUsed -= nSizeInBytes;
+        }
+
+        GDALDataset *poDS = poBand->GetDataset();
+        if( poDS != NULL && poDS->nCacheQuota > 0 )
+        {
+            CPLMutexHolderD( &(poDS->hCacheQuotaMutex) );
+            poDS->nCacheQuotaUsed -= nSizeInBytes;
         }
     }
 
+    if( bDirty )
+        MarkClean();
+
+    if( asRBShards[nCacheShard].nBlockCount == 0 
+        && GDALGetCachePolicy() == GRBP_2Q )
+        GDALRBClearGhostsIfCacheEmpty();
+
     CPLAssert( nLockCount == 0 );
 
 #ifdef ENABLE_DEBUG
@@ -430,14 +1417,31 @@ GDALRasterBlock::~GDALRasterBlock()
 void GDALRasterBlock::Detach()
 
 {
-    CPLMutexHolderD( &hRBMutex );
+    CPLMutexHolderD( &(asRBShards[nCacheShard].hMutex) );
+
+    if( nCacheQueue >= 0 )
+        UnlinkFromQueue();
+}
+
+/************************************************************************/
+/*                          UnlinkFromQueue()                           */
+/*                                                                      */
+/*      Remove the block from the queue of its shard it is linked in.   */
+/*      Must be called with the shard mutex held.                       */
+/************************************************************************/
+
+void GDALRasterBlock::UnlinkFromQueue()
+
+{
+    GDALRBShard *psShard = asRBShards + nCacheShard;
+    GDALRBQueue *psQueue = psShard->asQueues + nCacheQueue;
 
-    if( poOldest == this )
-        poOldest = poPrevious;
+    if( psQueue->poOldest == this )
+        psQueue->poOldest = poPrevious;
 
-    if( poNewest == this )
+    if( psQueue->poNewest == this )
     {
-        poNewest = poNext;
+        psQueue->poNewest = poNext;
     }
 
     if( poPrevious != NULL )
@@ -448,6 +1452,46 @@ void GDALRasterBlock::Detach()
 
     poPrevious = NULL;
     poNext = NULL;
+
+    psQueue->nBytes -= GDALRBGetBlockBytes( this );
+    psShard->nBlockCount--;
+    nCacheQueue = -1;
+}
+
+/************************************************************************/
+/*                            LinkToQueue()                             */
+/*                                                                      */
+/*      Insert the block at the head of one of the queues of its        */
+/*      shard.  Must be called with the shard mutex held.               */
+/************************************************************************/
+
+void GDALRasterBlock::LinkToQueue( int nQueue )
+
+{
+    GDALRBShard *psShard = asRBShards + nCacheShard;
+    GDALRBQueue *psQueue = psShard->asQueues + nQueue;
+
+    CPLAssert( nCacheQueue < 0 );
+
+    poPrevious = NULL;
+    poNext = (GDALRasterBlock *) psQueue->poNewest;
+
+    if( psQueue->poNewest != NULL )
+    {
+        CPLAssert( psQueue->poNewest->poPrevious == NULL );
+        psQueue->poNewest->poPrevious = this;
+    }
+    psQueue->poNewest = this;
+    
+    if( psQueue->poOldest == NULL )
+    {
+        CPLAssert( poNext == NULL );
+        psQueue->poOldest = this;
+    }
+
+    psQueue->nBytes += GDALRBGetBlockBytes( this );
+    psShard->nBlockCount++;
+    nCacheQueue = nQueue;
 }
 
 /************************************************************************/
@@ -462,28 +1506,43 @@ void GDALRasterBlock::Detach()
 void GDALRasterBlock::Verify()
 
 {
-    CPLMutexHolderD( &hRBMutex );
+    int nShards = GDALGetCacheShardCount();
 
-    CPLAssert( (poNewest == NULL && poOldest == NULL)
-               || (poNewest != NULL && poOldest != NULL) );
-
-    if( poNewest != NULL )
+    for( int iShard = 0; iShard < nShards; iShard++ )
     {
-        CPLAssert( poNewest->poPrevious == NULL );
-        CPLAssert( poOldest->poNext == NULL );
-        
-        for( GDALRasterBlock *poBlock = (GDALRasterBlock *) poNewest; 
-             poBlock != NULL;
-             poBlock = poBlock->poNext )
+        GDALRBShard *psShard = asRBShards + iShard;
+
+        CPLMutexHolderD( &(psShard->hMutex) );
+
+        for( int iQueue = 0; iQueue < GRBQ_COUNT; iQueue++ )
         {
-            if( poBlock->poPrevious )
-            {
-                CPLAssert( poBlock->poPrevious->poNext == poBlock );
-            }
+            GDALRBQueue *psQueue = psShard->asQueues + iQueue;
 
-            if( poBlock->poNext )
+            CPLAssert( (psQueue->poNewest == NULL && psQueue->poOldest == NULL)
+                       || (psQueue->poNewest != NULL && psQueue->poOldest != NULL) );
+
+            if( psQueue->poNewest == NULL )
+                continue;
+
+            CPLAssert( psQueue->poNewest->poPrevious == NULL );
+            CPLAssert( psQueue->poOldest->poNext == NULL );
+
+            for( GDALRasterBlock *poBlock = (GDALRasterBlock *) psQueue->poNewest; 
+                 poBlock != NULL;
+                 poBlock = poBlock->poNext )
             {
-                CPLAssert( poBlock->poNext->poPrevious == poBlock );
+                CPLAssert( poBlock->nCacheShard == iShard );
+                CPLAssert( poBlock->nCacheQueue == iQueue );
+
+                if( poBlock->poPrevious )
+                {
+                    CPLAssert( poBlock->poPrevious->poNext == poBlock );
+                }
+
+                if( poBlock->poNext )
+                {
+                    CPLAssert( poBlock->poNext->poPrevious == poBlock );
+                }
             }
         }
     }
@@ -514,10 +1573,27 @@ CPLErr GDALRasterBlock::Write()
 
     MarkClean();
 
-    if (poBand->eFlushBlockErr == CE_None)
-        return poBand->IWriteBlock( nXOff, nYOff, pData );
-    else
+    {
+        CPLMutexHolderD( &(asRBShards[nCacheShard].hMutex) );
+        asRBShards[nCacheShard].sStats.nDirtyFlushes++;
+        poBand->pasCacheStats[nCacheShard].nDirtyFlushes++;
+    }
+
+    if (poBand->eFlushBlockErr != CE_None)
         return poBand->eFlushBlockErr;
+
+    GDALDataset *poDS = poBand->GetDataset();
+    CPLErr eErr;
+
+    if( poDS != NULL )
+        poDS->EnterReadWrite();
+
+    eErr = poBand->IWriteBlock( nXOff, nYOff, pData );
+
+    if( poDS != NULL )
+        poDS->LeaveReadWrite();
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -529,40 +1605,48 @@ CPLErr GDALRasterBlock::Write()
  *
  * This method is normally called when a block is used to keep track 
  * that it has been recently used. 
+ *
+ * With the CLOCK eviction policy, this only sets the reference bit of
+ * the block.  With the 2Q policy, references to blocks that have not yet
+ * been promoted to the main queue are ignored.
  */
 
 void GDALRasterBlock::Touch()
 
 {
-    CPLMutexHolderD( &hRBMutex );
+    GDALRBShard *psShard = asRBShards + nCacheShard;
+    GDALRBPolicy ePolicy = GDALGetCachePolicy();
 
-    if( poNewest == this )
-        return;
+    CPLMutexHolderD( &(psShard->hMutex) );
 
-    if( poOldest == this )
-        poOldest = this->poPrevious;
-    
-    if( poPrevious != NULL )
-        poPrevious->poNext = poNext;
+/* -------------------------------------------------------------------- */
+/*      Block entering the cache.                                       */
+/* -------------------------------------------------------------------- */
+    if( nCacheQueue < 0 )
+    {
+        int nQueue = GRBQ_MAIN;
 
-    if( poNext != NULL )
-        poNext->poPrevious = poPrevious;
+        if( ePolicy == GRBP_2Q && !GDALRBTakeGhost( psShard, this ) )
+            nQueue = GRBQ_A1IN;
 
-    poPrevious = NULL;
-    poNext = (GDALRasterBlock *) poNewest;
+        bCacheReferenced = FALSE;
+        LinkToQueue( nQueue );
+    }
 
-    if( poNewest != NULL )
+/* -------------------------------------------------------------------- */
+/*      Block already cached.                                           */
+/* -------------------------------------------------------------------- */
+    else if( ePolicy == GRBP_CLOCK )
     {
-        CPLAssert( poNewest->poPrevious == NULL );
-        poNewest->poPrevious = this;
+        bCacheReferenced = TRUE;
     }
-    poNewest = this;
-    
-    if( poOldest == NULL )
+    else if( nCacheQueue == GRBQ_MAIN 
+             && psShard->asQueues[GRBQ_MAIN].poNewest != this )
     {
-        CPLAssert( poPrevious == NULL && poNext == NULL );
-        poOldest = this;
+        UnlinkFromQueue();
+        LinkToQueue( GRBQ_MAIN );
     }
+
 #ifdef ENABLE_DEBUG
     Verify();
 #endif
@@ -579,6 +1663,10 @@ void GDALRasterBlock::Touch()
  * blocks, if necessary, to bring the total cache size back within the limits.
  * The newly allocated block is touched and will be considered most recently
  * used in the LRU list. 
+ *
+ * No cache mutex is held while other blocks are being flushed, so that
+ * threads that need to write dirty blocks do not stall the other users
+ * of the cache.
  * 
  * @return CE_None on success or CE_Failure if memory allocation fails. 
  */
@@ -586,7 +1674,6 @@ void GDALRasterBlock::Touch()
 CPLErr GDALRasterBlock::Internalize()
 
 {
-    CPLMutexHolderD( &hRBMutex );
     void        *pNewData;
     int         nSizeInBytes;
     GIntBig     nCurCacheMax = GDALGetCacheMax64();
@@ -613,17 +1700,48 @@ CPLErr GDALRasterBlock::Internalize()
 /* -------------------------------------------------------------------- */
     AddLock(); /* don't flush this block! */
 
-    nCacheUsed += nSizeInBytes;
-    while( nCacheUsed > nCurCacheMax )
     {
-        GIntBig nOldCacheUsed = nCacheUsed;
+        CPLMutexHolderD( &(asRBShards[nCacheShard].hMutex) );
+        asRBShards[nCacheShard].nCacheUsed += nSizeInBytes;
+        asRBShards[nCacheShard].sStats.nMisses++;
+        poBand->pasCacheStats[nCacheShard].nMisses++;
+        poBand->pasCacheStats[nCacheShard].nBytesUsed += nSizeInBytes;
+    }
 
-        GDALFlushCacheBlock();
+    GDALRBDumpStatisticsIfNeeded();
 
-        if( nCacheUsed == nOldCacheUsed )
+    while( GDALGetCacheUsedInternal() > nCurCacheMax )
+    {
+        if( !GDALFlushCacheBlock() )
             break;
     }
 
+/* -------------------------------------------------------------------- */
+/*      Enforce the quota of the dataset, if any.  It is fetched when   */
+/*      the first block of the dataset is cached.                       */
+/* -------------------------------------------------------------------- */
+    GDALDataset *poDS = poBand->GetDataset();
+
+    if( poDS != NULL )
+    {
+        if( poDS->nCacheQuota < 0 )
+            poDS->nCacheQuota = GDALGetCacheQuota( poDS );
+
+        if( poDS->nCacheQuota > 0 )
+        {
+            {
+                CPLMutexHolderD( &(poDS->hCacheQuotaMutex) );
+                poDS->nCacheQuotaUsed += nSizeInBytes;
+            }
+
+            while( poDS->nCacheQuotaUsed > poDS->nCacheQuota )
+            {
+                if( !FlushCacheBlock( poDS ) )
+                    break;
+            }
+        }
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Add this block to the list.                                     */
 /* -------------------------------------------------------------------- */
@@ -647,7 +1765,21 @@ CPLErr GDALRasterBlock::Internalize()
 void GDALRasterBlock::MarkDirty()
 
 {
-    bDirty = TRUE;
+    if( bDirty )
+        return;
+
+    {
+        CPLMutexHolderD( &(asRBShards[nCacheShard].hMutex) );
+
+        if( bDirty )
+            return;
+
+        bDirty = TRUE;
+        asRBShards[nCacheShard].nDirtyBytes += GDALRBGetBlockBytes( this );
+    }
+
+    if( GDALIsCacheWriteBackEnabled() )
+        GDALRBWakeWriteBack();
 }
 
 
@@ -665,7 +1797,16 @@ void GDALRasterBlock::MarkDirty()
 void GDALRasterBlock::MarkClean()
 
 {
-    bDirty = FALSE;
+    if( !bDirty )
+        return;
+
+    CPLMutexHolderD( &(asRBShards[nCacheShard].hMutex) );
+
+    if( bDirty )
+    {
+        bDirty = FALSE;
+        asRBShards[nCacheShard].nDirtyBytes -= GDALRBGetBlockBytes( this );
+    }
 }
 
 /************************************************************************/
@@ -676,11 +1817,16 @@ void GDALRasterBlock::MarkClean()
  * \brief Safely lock block.
  *
  * This method locks a GDALRasterBlock (and touches it) in a thread-safe
- * manner.  The global block cache mutex is held while locking the block,
- * in order to avoid race conditions with other threads that might be
- * trying to expire the block at the same time.  The block pointer may be
+ * manner.  The mutexes of all the block cache shards are held while locking
+ * the block, in order to avoid race conditions with other threads that might
+ * be trying to expire the block at the same time.  The block pointer may be
  * safely NULL, in which case this method does nothing. 
  *
+ * When the band and offsets of the block are known, the
+ * SafeLockBlock( GDALRasterBlock **, GDALRasterBand *, int, int, int )
+ * variant should be preferred as it only holds the mutex of the relevant
+ * shard.
+ *
  * @param ppBlock Pointer to the block pointer to try and lock/touch.
  */
  
@@ -689,15 +1835,94 @@ int GDALRasterBlock::SafeLockBlock( GDALRasterBlock ** ppBlock )
 {
     CPLAssert( NULL != ppBlock );
 
-    CPLMutexHolderD( &hRBMutex );
+    int nShards = GDALGetCacheShardCount();
+    int iShard;
+    int bRet = FALSE;
+
+    for( iShard = 0; iShard < nShards; iShard++ )
+        CPLCreateOrAcquireMutex( &(asRBShards[iShard].hMutex), 1000.0 );
+
+    if( *ppBlock != NULL )
+    {
+        (*ppBlock)->AddLock();
+        (*ppBlock)->Touch();
+        
+        bRet = TRUE;
+    }
+
+    for( iShard = nShards - 1; iShard >= 0; iShard-- )
+        CPLReleaseMutex( asRBShards[iShard].hMutex );
+
+    return bRet;
+}
+
+/**
+ * \brief Safely lock block.
+ *
+ * This method locks a GDALRasterBlock (and touches it) in a thread-safe
+ * manner.  The mutex of the block cache shard the block belongs to is held
+ * while locking the block, in order to avoid race conditions with other
+ * threads that might be trying to expire the block at the same time.  The
+ * block pointer may be safely NULL, in which case this method does nothing. 
+ *
+ * @param ppBlock Pointer to the block pointer to try and lock/touch.
+ * @param poBand the band owning the block.
+ * @param nXBlockOff the horizontal block offset of the block.
+ * @param nYBlockOff the vertical block offset of the block.
+ * @param bCountHit whether a successful lock must be accounted as a cache
+ * hit in the block cache statistics.
+ *
+ * @since GDAL 1.9.0
+ */
+ 
+int GDALRasterBlock::SafeLockBlock( GDALRasterBlock ** ppBlock,
+                                    GDALRasterBand *poBand,
+                                    int nXBlockOff, int nYBlockOff,
+                                    int bCountHit )
+
+{
+    CPLAssert( NULL != ppBlock );
+
+    int nShard = GDALGetCacheShardIndex( poBand, nXBlockOff, nYBlockOff );
+
+    CPLMutexHolderD( &(asRBShards[nShard].hMutex) );
 
     if( *ppBlock != NULL )
     {
+        CPLAssert( (*ppBlock)->nCacheShard == nShard );
+
         (*ppBlock)->AddLock();
         (*ppBlock)->Touch();
+
+        if( bCountHit )
+        {
+            asRBShards[nShard].sStats.nHits++;
+            poBand->pasCacheStats[nShard].nHits++;
+        }
         
         return TRUE;
     }
     else
         return FALSE;
 }
+
+/************************************************************************/
+/*                         GetCacheShardCount()                         */
+/************************************************************************/
+
+/**
+ * \brief Return the number of shards of the block cache.
+ *
+ * It is read once from the GDAL_CACHE_SHARDS configuration option.
+ * Bands keep one set of cache statistics per shard.
+ *
+ * @return the number of shards, between 1 and 64.
+ *
+ * @since GDAL 1.9.0
+ */
+
+int GDALRasterBlock::GetCacheShardCount()
+
+{
+    return GDALGetCacheShardCount();
+}
@@ -0,0 +1,51 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL
+ * Purpose:  Selection of the SSE2 code paths of the raster algorithms
+ *
+ ******************************************************************************
+ * Copyright (c) 2011, The GDAL project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef GDALSSE_PRIV_H_INCLUDED
+#define GDALSSE_PRIV_H_INCLUDED
+
+/* -------------------------------------------------------------------- */
+/*      USE_SSE2 is defined when the SSE2 intrinsics can be used.       */
+/*                                                                      */
+/*      SSE2 is part of the x86_64 instruction set, so on that          */
+/*      architecture it is always available and the SSE2 code paths     */
+/*      are selected at compile time: there is no runtime CPU feature   */
+/*      detection in GDAL to select them otherwise.  On 32 bit x86,     */
+/*      where SSE2 is optional, and on other architectures, the scalar  */
+/*      code paths are used.                                            */
+/*                                                                      */
+/*      This header is private to GDAL and is not meant to be included  */
+/*      by applications.                                                */
+/* -------------------------------------------------------------------- */
+
+#if defined(__x86_64) || defined(_M_X64)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#endif /* ndef GDALSSE_PRIV_H_INCLUDED */
@@ -0,0 +1,399 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Core
+ * Purpose:  Exposition of raster bands as virtual memory mappings.
+ *
+ ******************************************************************************
+ * Copyright (c) 2012, GDAL project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "gdal_priv.h"
+#include "cpl_virtualmem.h"
+
+CPL_CVSID("$Id$");
+
+typedef struct
+{
+    GDALRasterBandH hBand;
+    int             nXOff;
+    int             nYOff;
+    int             nXSize;
+    int             nYSize;
+    int             nBufXSize;
+    int             nBufYSize;
+    GDALDataType    eBufType;
+    int             nPixelSize;
+    size_t          nLineSize;
+    GByte          *pabyLine;       /* Only used for subsampled mappings */
+} GDALVirtualMemBand;
+
+/************************************************************************/
+/*                        GDALVirtualMemBandIO()                        */
+/*                                                                      */
+/*      Transfer the bytes [nOffset, nOffset + nBytes[ of the packed    */
+/*      buffer layout of the mapping, by runs of whole lines or parts   */
+/*      of a line.                                                      */
+/************************************************************************/
+
+static void GDALVirtualMemBandIO( GDALVirtualMemBand *psParams,
+                                  GDALRWFlag eRWFlag, size_t nOffset,
+                                  GByte *pabyPage, size_t nBytes )
+
+{
+    int bSubsampled = psParams->nBufXSize != psParams->nXSize
+                   || psParams->nBufYSize != psParams->nYSize;
+    double dfSrcYInc = psParams->nYSize / (double) psParams->nBufYSize;
+
+    while( nBytes >= (size_t) psParams->nPixelSize )
+    {
+        int iBufY = (int) (nOffset / psParams->nLineSize);
+        int iBufX = (int) ((nOffset % psParams->nLineSize)
+                                                / psParams->nPixelSize);
+        int nCount = (int) MIN( (size_t) (psParams->nBufXSize - iBufX),
+                                nBytes / psParams->nPixelSize );
+        int nLines = 1;
+
+        if( iBufY >= psParams->nBufYSize )
+            break;
+
+        if( bSubsampled )
+        {
+/* -------------------------------------------------------------------- */
+/*      Read the whole buffer line, with the same nearest neighbour     */
+/*      rule as GDALRasterBand::IRasterIO(), and keep the needed part.  */
+/* -------------------------------------------------------------------- */
+            int iSrcY = (int) ((iBufY + 0.5) * dfSrcYInc + psParams->nYOff);
+
+            GDALRasterIO( psParams->hBand, GF_Read,
+                          psParams->nXOff, iSrcY, psParams->nXSize, 1,
+                          psParams->pabyLine, psParams->nBufXSize, 1,
+                          psParams->eBufType, 0, 0 );
+            memcpy( pabyPage,
+                    psParams->pabyLine + iBufX * psParams->nPixelSize,
+                    (size_t) nCount * psParams->nPixelSize );
+        }
+        else
+        {
+            if( iBufX == 0 && nCount == psParams->nBufXSize )
+                nLines = (int) MIN( nBytes / psParams->nLineSize,
+                                    (size_t) (psParams->nBufYSize - iBufY) );
+
+            GDALRasterIO( psParams->hBand, eRWFlag,
+                          psParams->nXOff + iBufX, psParams->nYOff + iBufY,
+                          nCount, nLines, pabyPage, nCount, nLines,
+                          psParams->eBufType, 0, 0 );
+        }
+
+        size_t nDone = (size_t) nCount * nLines * psParams->nPixelSize;
+        pabyPage += nDone;
+        nOffset += nDone;
+        nBytes -= nDone;
+    }
+}
+
+/************************************************************************/
+/*                     GDALVirtualMemBandCachePage()                    */
+/************************************************************************/
+
+static void GDALVirtualMemBandCachePage( CPLVirtualMem* ctxt,
+                                         size_t nOffset,
+                                         void* pPageToFill,
+                                         size_t nToFill,
+                                         void* pUserData )
+
+{
+    GDALVirtualMemBandIO( (GDALVirtualMemBand *) pUserData, GF_Read,
+                          nOffset, (GByte *) pPageToFill, nToFill );
+}
+
+/************************************************************************/
+/*                    GDALVirtualMemBandUnCachePage()                   */
+/************************************************************************/
+
+static void GDALVirtualMemBandUnCachePage( CPLVirtualMem* ctxt,
+                                           size_t nOffset,
+                                           const void* pPageToBeEvicted,
+                                           size_t nToBeEvicted,
+                                           void* pUserData )
+
+{
+    GDALVirtualMemBandIO( (GDALVirtualMemBand *) pUserData, GF_Write,
+                          nOffset, (GByte *) pPageToBeEvicted, nToBeEvicted );
+}
+
+/************************************************************************/
+/*                    GDALVirtualMemBandFreeUserData()                  */
+/************************************************************************/
+
+static void GDALVirtualMemBandFreeUserData( void* pUserData )
+
+{
+    GDALVirtualMemBand *psParams = (GDALVirtualMemBand *) pUserData;
+
+    CPLFree( psParams->pabyLine );
+    CPLFree( psParams );
+}
+
+/************************************************************************/
+/*                    GDALRasterBandGetVirtualMem()                     */
+/************************************************************************/
+
+/**
+ * \brief Create a CPLVirtualMem object from a GDAL raster band object.
+ *
+ * The returned virtual memory mapping exposes the window
+ * (nXOff,nYOff,nXSize,nYSize) of the band, resampled to nBufXSize x
+ * nBufYSize pixels of type eBufType, as a packed array: the pixel at
+ * column i and line j of the buffer is at offset
+ * (j * nBufXSize + i) * (GDALGetDataTypeSize(eBufType) / 8).
+ *
+ * Pages of the mapping are filled on demand with RasterIO() requests,
+ * and thus through the IReadBlock() method of the band, when they are
+ * accessed. At most nCacheSize bytes are kept mapped at a time. Accesses
+ * to the mapping need no explicit call to GDAL.
+ *
+ * In GF_Write mode, the modified pages are written back with RasterIO()
+ * when they are evicted or when the mapping is freed, which must happen
+ * before the dataset is closed. Writing is not supported for subsampled
+ * windows.
+ *
+ * This is only supported on Linux x86 and x86_64 currently. See
+ * CPLIsVirtualMemAvailable(). See also GDALGetVirtualMemAuto() which
+ * can directly map the file of some uncompressed formats.
+ *
+ * @param hBand Rasterband object
+ * @param eRWFlag Either GF_Read to read a region of data, or GF_Write to
+ * write a region of data.
+ * @param nXOff The pixel offset to the top left corner of the region
+ * of the band to be accessed.  This would be zero to start from the left side.
+ * @param nYOff The line offset to the top left corner of the region
+ * of the band to be accessed.  This would be zero to start from the top.
+ * @param nXSize The width of the region of the band to be accessed in pixels.
+ * @param nYSize The height of the region of the band to be accessed in lines.
+ * @param nBufXSize the width of the buffer image into which the desired region
+ * is to be read, or from which it is to be written.
+ * @param nBufYSize the height of the buffer image into which the desired
+ * region is to be read, or from which it is to be written.
+ * @param eBufType the type of the pixel values in the data buffer. The
+ * pixel values will automatically be translated to/from the
+ * GDALRasterBand data type as needed.
+ * @param nCacheSize size in bytes of the maximum memory that will be really
+ * allocated (must ideally fit into RAM).
+ * @param nPageSizeHint hint for the page size. Will be rounded up to a
+ * multiple of the system page size. Can be 0.
+ * @param papszOptions NULL terminated list of options. Unused for now.
+ *
+ * @return a virtual memory object that must be freed by CPLVirtualMemFree(),
+ *         or NULL in case of failure.
+ *
+ * @since GDAL 1.9.0
+ */
+
+CPLVirtualMem* GDALRasterBandGetVirtualMem( GDALRasterBandH hBand,
+                                            GDALRWFlag eRWFlag,
+                                            int nXOff, int nYOff,
+                                            int nXSize, int nYSize,
+                                            int nBufXSize, int nBufYSize,
+                                            GDALDataType eBufType,
+                                            size_t nCacheSize,
+                                            size_t nPageSizeHint,
+                                            char **papszOptions )
+
+{
+    VALIDATE_POINTER1( hBand, "GDALRasterBandGetVirtualMem", NULL );
+
+    GDALRasterBand *poBand = (GDALRasterBand *) hBand;
+    int nPixelSize = GDALGetDataTypeSize( eBufType ) / 8;
+
+    if( nXOff < 0 || nYOff < 0 || nXSize <= 0 || nYSize <= 0
+        || nXOff + nXSize > poBand->GetXSize()
+        || nYOff + nYSize > poBand->GetYSize() )
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "Access window out of range in "
+                  "GDALRasterBandGetVirtualMem().  Requested\n"
+                  "(%d,%d) of size %dx%d on raster of %dx%d.",
+                  nXOff, nYOff, nXSize, nYSize,
+                  poBand->GetXSize(), poBand->GetYSize() );
+        return NULL;
+    }
+
+    if( nBufXSize <= 0 || nBufYSize <= 0 || nPixelSize == 0 )
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "Illegal buffer size or type in "
+                  "GDALRasterBandGetVirtualMem()." );
+        return NULL;
+    }
+
+    if( eRWFlag == GF_Write
+        && (nBufXSize != nXSize || nBufYSize != nYSize) )
+    {
+        CPLError( CE_Failure, CPLE_NotSupported,
+                  "Writing through a subsampled virtual memory mapping "
+                  "is not supported." );
+        return NULL;
+    }
+
+    GUIntBig nSize = (GUIntBig) nBufXSize * nBufYSize * nPixelSize;
+    if( nSize != (GUIntBig) (size_t) nSize )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "Virtual memory mapping too large for the address space." );
+        return NULL;
+    }
+
+    GDALVirtualMemBand *psParams = (GDALVirtualMemBand *)
+        CPLCalloc( 1, sizeof(GDALVirtualMemBand) );
+
+    psParams->hBand = hBand;
+    psParams->nXOff = nXOff;
+    psParams->nYOff = nYOff;
+    psParams->nXSize = nXSize;
+    psParams->nYSize = nYSize;
+    psParams->nBufXSize = nBufXSize;
+    psParams->nBufYSize = nBufYSize;
+    psParams->eBufType = eBufType;
+    psParams->nPixelSize = nPixelSize;
+    psParams->nLineSize = (size_t) nBufXSize * nPixelSize;
+
+    if( nBufXSize != nXSize || nBufYSize != nYSize )
+    {
+        psParams->pabyLine = (GByte *) VSIMalloc( psParams->nLineSize );
+        if( psParams->pabyLine == NULL )
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory,
+                      "Cannot allocate %lu bytes.",
+                      (unsigned long) psParams->nLineSize );
+            CPLFree( psParams );
+            return NULL;
+        }
+    }
+
+    CPLVirtualMem *ctxt = CPLVirtualMemNew(
+        (size_t) nSize, nCacheSize, nPageSizeHint,
+        eRWFlag == GF_Write ? VIRTUALMEM_READWRITE : VIRTUALMEM_READONLY,
+        GDALVirtualMemBandCachePage,
+        eRWFlag == GF_Write ? GDALVirtualMemBandUnCachePage : NULL,
+        GDALVirtualMemBandFreeUserData, psParams );
+
+    if( ctxt == NULL )
+        GDALVirtualMemBandFreeUserData( psParams );
+
+    return ctxt;
+}
+
+/************************************************************************/
+/*                         GetVirtualMemAuto()                          */
+/************************************************************************/
+
+/**
+ * \brief Create a CPLVirtualMem object from a GDAL raster band object.
+ *
+ * Drivers of uncompressed formats can override this method to map the
+ * file itself, in which case the operating system page cache does the
+ * caching. The layout of the returned mapping is the one of the file:
+ * the pixel at column i and line j of the band is at offset
+ * j * (*pnLineSpace) + i * (*pnPixelSpace) from the start of the mapping,
+ * in the data type of the band. The values are in the native byte order.
+ *
+ * The default implementation returns the packed mapping of the whole
+ * band in its data type built by GDALRasterBandGetVirtualMem().
+ *
+ * The following options are accepted :
+ * <ul>
+ * <li>CACHE_SIZE=size_in_bytes: for the default implementation, the
+ *     maximum memory that will be really allocated. Defaults to 40 MB.</li>
+ * <li>PAGE_SIZE_HINT=size_in_bytes: for the default implementation, hint
+ *     for the page size.</li>
+ * <li>USE_DEFAULT_IMPLEMENTATION=YES/NO: whether the default
+ *     implementation should be used, even if the driver could map the
+ *     file itself. Defaults to NO.</li>
+ * </ul>
+ *
+ * With a direct file mapping in GF_Write mode, the block cache of the
+ * band is flushed when the mapping is created, and must not be used for
+ * the mapped area until the mapping is freed.
+ *
+ * @param eRWFlag Either GF_Read to read the band, or GF_Write to
+ * read/write the band.
+ * @param pnPixelSpace Output parameter receiving the byte offset from the
+ * start of one pixel value in the buffer to the start of the next pixel
+ * value within a scanline.
+ * @param pnLineSpace Output parameter receiving the byte offset from the
+ * start of one scanline in the buffer to the start of the next.
+ * @param papszOptions NULL terminated list of options.
+ *
+ * @return a virtual memory object that must be freed by CPLVirtualMemFree(),
+ *         or NULL in case of failure.
+ *
+ * @since GDAL 1.9.0
+ */
+
+CPLVirtualMem *GDALRasterBand::GetVirtualMemAuto( GDALRWFlag eRWFlag,
+                                                  int *pnPixelSpace,
+                                                  GIntBig *pnLineSpace,
+                                                  char **papszOptions )
+
+{
+    int nPixelSpace = GDALGetDataTypeSize( eDataType ) / 8;
+    size_t nCacheSize = (size_t) CPLScanUIntBig(
+        CSLFetchNameValueDef( papszOptions, "CACHE_SIZE", "40000000" ), 32 );
+    size_t nPageSizeHint = (size_t) CPLScanUIntBig(
+        CSLFetchNameValueDef( papszOptions, "PAGE_SIZE_HINT", "0" ), 32 );
+
+    if( pnPixelSpace != NULL )
+        *pnPixelSpace = nPixelSpace;
+    if( pnLineSpace != NULL )
+        *pnLineSpace = (GIntBig) nRasterXSize * nPixelSpace;
+
+    return GDALRasterBandGetVirtualMem( (GDALRasterBandH) this, eRWFlag,
+                                        0, 0, nRasterXSize, nRasterYSize,
+                                        nRasterXSize, nRasterYSize,
+                                        eDataType, nCacheSize, nPageSizeHint,
+                                        papszOptions );
+}
+
+/************************************************************************/
+/*                       GDALGetVirtualMemAuto()                        */
+/************************************************************************/
+
+/**
+ * \brief Create a CPLVirtualMem object from a GDAL raster band object.
+ *
+ * @see GDALRasterBand::GetVirtualMemAuto()
+ */
+
+CPLVirtualMem *GDALGetVirtualMemAuto( GDALRasterBandH hBand,
+                                      GDALRWFlag eRWFlag,
+                                      int *pnPixelSpace,
+                                      GIntBig *pnLineSpace,
+                                      char **papszOptions )
+
+{
+    VALIDATE_POINTER1( hBand, "GDALGetVirtualMemAuto", NULL );
+
+    return ((GDALRasterBand *) hBand)->GetVirtualMemAuto( eRWFlag,
+                                                          pnPixelSpace,
+                                                          pnLineSpace,
+                                                          papszOptions );
+}
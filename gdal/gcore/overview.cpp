@@ -28,6 +28,8 @@
  ****************************************************************************/
 
 #include "gdal_priv.h"
+#include "cpl_worker_thread_pool.h"
+#include "gdalsse_priv.h"
 
 CPL_CVSID("$Id$");
 
@@ -38,12 +40,46 @@ typedef CPLErr (*GDALDownsampleFunction)
                         GByte * pabyChunkNodataMask,
                         int nChunkXOff, int nChunkXSize,
                         int nChunkYOff, int nChunkYSize,
-                        GDALRasterBand * poOverview,
+                        int nOXSize, int nOYSize,
+                        void * pDstBuffer,
                         const char * pszResampling,
                         int bHasNoData, float fNoDataValue,
                         GDALColorTable* poColorTable,
                         GDALDataType eSrcDataType);
 
+/************************************************************************/
+/*                      GDALDownsampleDstWindow()                       */
+/*                                                                      */
+/*      Compute the window of the overview written from a chunk of      */
+/*      the source. In theory this approach should ensure that          */
+/*      every output pixel will be written if all input chunks are      */
+/*      processed.                                                      */
+/************************************************************************/
+
+static void
+GDALDownsampleDstWindow( int nSrcWidth, int nSrcHeight,
+                         int nOXSize, int nOYSize,
+                         int nChunkXOff, int nChunkXSize,
+                         int nChunkYOff, int nChunkYSize,
+                         int *pnDstXOff, int *pnDstXOff2,
+                         int *pnDstYOff, int *pnDstYOff2 )
+
+{
+    *pnDstXOff = (int) (0.5 + (nChunkXOff/(double)nSrcWidth) * nOXSize);
+    *pnDstXOff2 = (int)
+        (0.5 + ((nChunkXOff+nChunkXSize)/(double)nSrcWidth) * nOXSize);
+
+    if( nChunkXOff + nChunkXSize == nSrcWidth )
+        *pnDstXOff2 = nOXSize;
+
+    *pnDstYOff = (int) (0.5 + (nChunkYOff/(double)nSrcHeight) * nOYSize);
+    *pnDstYOff2 = (int)
+        (0.5 + ((nChunkYOff+nChunkYSize)/(double)nSrcHeight) * nOYSize);
+
+    if( nChunkYOff + nChunkYSize == nSrcHeight )
+        *pnDstYOff2 = nOYSize;
+}
+
 /************************************************************************/
 /*                     GDALDownsampleChunk32R_Near()                    */
 /************************************************************************/
@@ -56,7 +92,8 @@ GDALDownsampleChunk32R_NearT( int nSrcWidth, int nSrcHeight,
                         GByte * pabyChunkNodataMask_unused,
                         int nChunkXOff, int nChunkXSize,
                         int nChunkYOff, int nChunkYSize,
-                        GDALRasterBand * poOverview,
+                        int nOXSize, int nOYSize,
+                        void * pDstBuffer,
                         const char * pszResampling_unused,
                         int bHasNoData_unused, float fNoDataValue_unused,
                         GDALColorTable* poColorTable_unused,
@@ -65,53 +102,30 @@ GDALDownsampleChunk32R_NearT( int nSrcWidth, int nSrcHeight,
 {
     CPLErr eErr = CE_None;
 
-    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2, nOXSize, nOYSize;
-
-    nOXSize = poOverview->GetXSize();
-    nOYSize = poOverview->GetYSize();
+    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2;
 
 /* -------------------------------------------------------------------- */
-/*      Figure out the column to start writing to, and the first column */
-/*      to not write to.                                                */
+/*      Figure out the window of the overview covered by this chunk.    */
 /* -------------------------------------------------------------------- */
-    nDstXOff = (int) (0.5 + (nChunkXOff/(double)nSrcWidth) * nOXSize);
-    nDstXOff2 = (int)
-        (0.5 + ((nChunkXOff+nChunkXSize)/(double)nSrcWidth) * nOXSize);
-
-    if( nChunkXOff + nChunkXSize == nSrcWidth )
-        nDstXOff2 = nOXSize;
+    GDALDownsampleDstWindow( nSrcWidth, nSrcHeight, nOXSize, nOYSize,
+                             nChunkXOff, nChunkXSize, nChunkYOff, nChunkYSize,
+                             &nDstXOff, &nDstXOff2, &nDstYOff, &nDstYOff2 );
 
     int nDstXWidth = nDstXOff2 - nDstXOff;
 
 /* -------------------------------------------------------------------- */
-/*      Allocate scanline buffer.                                       */
+/*      Allocate source offset buffer.                                  */
 /* -------------------------------------------------------------------- */
 
-    T* pDstScanline = (T *) VSIMalloc(nDstXWidth * (GDALGetDataTypeSize(eWrkDataType) / 8));
     int* panSrcXOff = (int*)VSIMalloc(nDstXWidth * sizeof(int));
 
-    if( pDstScanline == NULL || panSrcXOff == NULL )
+    if( panSrcXOff == NULL )
     {
         CPLError( CE_Failure, CPLE_OutOfMemory,
                   "GDALDownsampleChunk32R: Out of memory for line buffer." );
-        VSIFree(pDstScanline);
-        VSIFree(panSrcXOff);
         return CE_Failure;
     }
 
-/* -------------------------------------------------------------------- */
-/*      Figure out the line to start writing to, and the first line     */
-/*      to not write to.  In theory this approach should ensure that    */
-/*      every output line will be written if all input chunks are       */
-/*      processed.                                                      */
-/* -------------------------------------------------------------------- */
-    nDstYOff = (int) (0.5 + (nChunkYOff/(double)nSrcHeight) * nOYSize);
-    nDstYOff2 = (int)
-        (0.5 + ((nChunkYOff+nChunkYSize)/(double)nSrcHeight) * nOYSize);
-
-    if( nChunkYOff + nChunkYSize == nSrcHeight )
-        nDstYOff2 = nOYSize;
-
 /* ==================================================================== */
 /*      Precompute inner loop constants.                                */
 /* ==================================================================== */
@@ -134,6 +148,7 @@ GDALDownsampleChunk32R_NearT( int nSrcWidth, int nSrcHeight,
     for( int iDstLine = nDstYOff; iDstLine < nDstYOff2 && eErr == CE_None; iDstLine++ )
     {
         T *pSrcScanline;
+        T *pDstScanline = ((T *) pDstBuffer) + (iDstLine - nDstYOff) * nDstXWidth;
         int   nSrcYOff;
 
         nSrcYOff = (int) (0.5 + (iDstLine/(double)nOYSize) * nSrcHeight);
@@ -149,13 +164,8 @@ GDALDownsampleChunk32R_NearT( int nSrcWidth, int nSrcHeight,
         {
             pDstScanline[iDstPixel] = pSrcScanline[panSrcXOff[iDstPixel]];
         }
-
-        eErr = poOverview->RasterIO( GF_Write, nDstXOff, iDstLine, nDstXWidth, 1,
-                                     pDstScanline, nDstXWidth, 1, eWrkDataType,
-                                     0, 0 );
     }
 
-    CPLFree( pDstScanline );
     CPLFree( panSrcXOff );
 
     return eErr;
@@ -168,7 +178,8 @@ GDALDownsampleChunk32R_Near( int nSrcWidth, int nSrcHeight,
                         GByte * pabyChunkNodataMask_unused,
                         int nChunkXOff, int nChunkXSize,
                         int nChunkYOff, int nChunkYSize,
-                        GDALRasterBand * poOverview,
+                        int nOXSize, int nOYSize,
+                        void * pDstBuffer,
                         const char * pszResampling_unused,
                         int bHasNoData_unused, float fNoDataValue_unused,
                         GDALColorTable* poColorTable_unused,
@@ -181,7 +192,8 @@ GDALDownsampleChunk32R_Near( int nSrcWidth, int nSrcHeight,
                         pabyChunkNodataMask_unused,
                         nChunkXOff, nChunkXSize,
                         nChunkYOff, nChunkYSize,
-                        poOverview,
+                        nOXSize, nOYSize,
+                        pDstBuffer,
                         pszResampling_unused,
                         bHasNoData_unused, fNoDataValue_unused,
                         poColorTable_unused,
@@ -193,7 +205,8 @@ GDALDownsampleChunk32R_Near( int nSrcWidth, int nSrcHeight,
                         pabyChunkNodataMask_unused,
                         nChunkXOff, nChunkXSize,
                         nChunkYOff, nChunkYSize,
-                        poOverview,
+                        nOXSize, nOYSize,
+                        pDstBuffer,
                         pszResampling_unused,
                         bHasNoData_unused, fNoDataValue_unused,
                         poColorTable_unused,
@@ -203,6 +216,270 @@ GDALDownsampleChunk32R_Near( int nSrcWidth, int nSrcHeight,
     return CE_Failure;
 }
 
+/************************************************************************/
+/*                    GDALDownsampleIsExactInFloat()                    */
+/*                                                                      */
+/*      Sums of a few weighted values of those data types are exact     */
+/*      in single precision, so that SIMD kernels working in float      */
+/*      give the same result as the generic code working in double.     */
+/************************************************************************/
+
+static int GDALDownsampleIsExactInFloat( GDALDataType eSrcDataType )
+{
+    return eSrcDataType == GDT_Byte ||
+           eSrcDataType == GDT_UInt16 ||
+           eSrcDataType == GDT_Int16;
+}
+
+#ifdef USE_SSE2
+
+/************************************************************************/
+/*                   GDALDownsampleAverage2x2SSE2()                     */
+/*                                                                      */
+/*      Average 2x2 source pixels, from two source lines, into          */
+/*      nDstWidth destination pixels, optionally ignoring the pixels    */
+/*      whose mask is 0.  Returns the number of pixels done, the        */
+/*      remaining ones being left to the generic code.                  */
+/************************************************************************/
+
+/* Sum of the pairs of adjacent bytes, as 8 16-bit values */
+static inline __m128i GDALSumBytePairsSSE2( __m128i xmm )
+{
+    return _mm_add_epi16( _mm_and_si128( xmm, _mm_set1_epi16(0x00FF) ),
+                          _mm_srli_epi16( xmm, 8 ) );
+}
+
+static int GDALDownsampleAverage2x2SSE2( const GByte* pabySrc0,
+                                         const GByte* pabySrc1,
+                                         const GByte* pabyMask0,
+                                         const GByte* pabyMask1,
+                                         GByte* pabyDst, int nDstWidth,
+                                         GByte byNoDataValue )
+{
+    int i = 0;
+
+    if( pabyMask0 == NULL )
+    {
+        const __m128i xmmTwo = _mm_set1_epi16(2);
+        for( ; i + 16 <= nDstWidth; i += 16 )
+        {
+            __m128i xmmLo = _mm_add_epi16(
+                GDALSumBytePairsSSE2( _mm_loadu_si128((const __m128i*)(pabySrc0 + 2 * i)) ),
+                GDALSumBytePairsSSE2( _mm_loadu_si128((const __m128i*)(pabySrc1 + 2 * i)) ) );
+            __m128i xmmHi = _mm_add_epi16(
+                GDALSumBytePairsSSE2( _mm_loadu_si128((const __m128i*)(pabySrc0 + 2 * i + 16)) ),
+                GDALSumBytePairsSSE2( _mm_loadu_si128((const __m128i*)(pabySrc1 + 2 * i + 16)) ) );
+
+            /* (nTotal + 2) / 4 */
+            xmmLo = _mm_srli_epi16( _mm_add_epi16( xmmLo, xmmTwo ), 2 );
+            xmmHi = _mm_srli_epi16( _mm_add_epi16( xmmHi, xmmTwo ), 2 );
+            _mm_storeu_si128( (__m128i*)(pabyDst + i), _mm_packus_epi16( xmmLo, xmmHi ) );
+        }
+        return i;
+    }
+
+    const __m128i xmmZero = _mm_setzero_si128();
+    const __m128i xmmOneByte = _mm_set1_epi8(1);
+    const __m128i xmmOne = _mm_set1_epi16(1);
+    const __m128i xmmTwo = _mm_set1_epi16(2);
+    const __m128i xmmThree = _mm_set1_epi16(3);
+    const __m128i xmmFour = _mm_set1_epi16(4);
+    const __m128i xmmNoData = _mm_set1_epi16(byNoDataValue);
+    /* (x * 21846) >> 16 == x / 3 for the x <= 1022 we can get here */
+    const __m128i xmmOneThird = _mm_set1_epi16((short)21846);
+
+    for( ; i + 8 <= nDstWidth; i += 8 )
+    {
+        __m128i xmmInvalid0 = _mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)(pabyMask0 + 2 * i)), xmmZero );
+        __m128i xmmInvalid1 = _mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)(pabyMask1 + 2 * i)), xmmZero );
+
+        __m128i xmmTotal = _mm_add_epi16(
+            GDALSumBytePairsSSE2( _mm_andnot_si128( xmmInvalid0,
+                _mm_loadu_si128((const __m128i*)(pabySrc0 + 2 * i)) ) ),
+            GDALSumBytePairsSSE2( _mm_andnot_si128( xmmInvalid1,
+                _mm_loadu_si128((const __m128i*)(pabySrc1 + 2 * i)) ) ) );
+        __m128i xmmCount = _mm_add_epi16(
+            GDALSumBytePairsSSE2( _mm_andnot_si128( xmmInvalid0, xmmOneByte ) ),
+            GDALSumBytePairsSSE2( _mm_andnot_si128( xmmInvalid1, xmmOneByte ) ) );
+
+        /* (nTotal + nCount / 2) / nCount, or the nodata value if nCount == 0 */
+        __m128i xmmVal = _mm_add_epi16( xmmTotal, _mm_srli_epi16( xmmCount, 1 ) );
+        __m128i xmmRes = _mm_and_si128( _mm_cmpeq_epi16( xmmCount, xmmZero ), xmmNoData );
+        xmmRes = _mm_or_si128( xmmRes,
+            _mm_and_si128( _mm_cmpeq_epi16( xmmCount, xmmOne ), xmmVal ) );
+        xmmRes = _mm_or_si128( xmmRes,
+            _mm_and_si128( _mm_cmpeq_epi16( xmmCount, xmmTwo ),
+                           _mm_srli_epi16( xmmVal, 1 ) ) );
+        xmmRes = _mm_or_si128( xmmRes,
+            _mm_and_si128( _mm_cmpeq_epi16( xmmCount, xmmThree ),
+                           _mm_mulhi_epu16( xmmVal, xmmOneThird ) ) );
+        xmmRes = _mm_or_si128( xmmRes,
+            _mm_and_si128( _mm_cmpeq_epi16( xmmCount, xmmFour ),
+                           _mm_srli_epi16( xmmVal, 2 ) ) );
+
+        _mm_storel_epi64( (__m128i*)(pabyDst + i), _mm_packus_epi16( xmmRes, xmmRes ) );
+    }
+
+    return i;
+}
+
+/* Expand 4 mask bytes into 4 float lanes that are all ones where the mask is 0 */
+static inline __m128 GDALLoadInvalidMask4SSE2( const GByte* pabyMask )
+{
+    int nVal;
+    memcpy( &nVal, pabyMask, 4 );
+    __m128i xmm = _mm_cmpeq_epi8( _mm_cvtsi32_si128( nVal ), _mm_setzero_si128() );
+    xmm = _mm_unpacklo_epi8( xmm, xmm );
+    return _mm_castsi128_ps( _mm_unpacklo_epi16( xmm, xmm ) );
+}
+
+static int GDALDownsampleAverage2x2SSE2( const float* pafSrc0,
+                                         const float* pafSrc1,
+                                         const GByte* pabyMask0,
+                                         const GByte* pabyMask1,
+                                         float* pafDst, int nDstWidth,
+                                         float fNoDataValue )
+{
+    const __m128 xmmQuarter = _mm_set1_ps(0.25f);
+    const __m128 xmmOne = _mm_set1_ps(1.0f);
+    const __m128 xmmZero = _mm_setzero_ps();
+    const __m128 xmmNoData = _mm_set1_ps(fNoDataValue);
+    int i = 0;
+
+    for( ; i + 4 <= nDstWidth; i += 4 )
+    {
+        __m128 xmm0Lo = _mm_loadu_ps( pafSrc0 + 2 * i );
+        __m128 xmm0Hi = _mm_loadu_ps( pafSrc0 + 2 * i + 4 );
+        __m128 xmm1Lo = _mm_loadu_ps( pafSrc1 + 2 * i );
+        __m128 xmm1Hi = _mm_loadu_ps( pafSrc1 + 2 * i + 4 );
+
+        if( pabyMask0 == NULL )
+        {
+            __m128 xmmTotal = _mm_add_ps(
+                _mm_add_ps( _mm_shuffle_ps( xmm0Lo, xmm0Hi, _MM_SHUFFLE(2,0,2,0) ),
+                            _mm_shuffle_ps( xmm0Lo, xmm0Hi, _MM_SHUFFLE(3,1,3,1) ) ),
+                _mm_add_ps( _mm_shuffle_ps( xmm1Lo, xmm1Hi, _MM_SHUFFLE(2,0,2,0) ),
+                            _mm_shuffle_ps( xmm1Lo, xmm1Hi, _MM_SHUFFLE(3,1,3,1) ) ) );
+            _mm_storeu_ps( pafDst + i, _mm_mul_ps( xmmTotal, xmmQuarter ) );
+            continue;
+        }
+
+        __m128 xmmInv0Lo = GDALLoadInvalidMask4SSE2( pabyMask0 + 2 * i );
+        __m128 xmmInv0Hi = GDALLoadInvalidMask4SSE2( pabyMask0 + 2 * i + 4 );
+        __m128 xmmInv1Lo = GDALLoadInvalidMask4SSE2( pabyMask1 + 2 * i );
+        __m128 xmmInv1Hi = GDALLoadInvalidMask4SSE2( pabyMask1 + 2 * i + 4 );
+
+        xmm0Lo = _mm_andnot_ps( xmmInv0Lo, xmm0Lo );
+        xmm0Hi = _mm_andnot_ps( xmmInv0Hi, xmm0Hi );
+        xmm1Lo = _mm_andnot_ps( xmmInv1Lo, xmm1Lo );
+        xmm1Hi = _mm_andnot_ps( xmmInv1Hi, xmm1Hi );
+        __m128 xmmTotal = _mm_add_ps(
+            _mm_add_ps( _mm_shuffle_ps( xmm0Lo, xmm0Hi, _MM_SHUFFLE(2,0,2,0) ),
+                        _mm_shuffle_ps( xmm0Lo, xmm0Hi, _MM_SHUFFLE(3,1,3,1) ) ),
+            _mm_add_ps( _mm_shuffle_ps( xmm1Lo, xmm1Hi, _MM_SHUFFLE(2,0,2,0) ),
+                        _mm_shuffle_ps( xmm1Lo, xmm1Hi, _MM_SHUFFLE(3,1,3,1) ) ) );
+
+        xmm0Lo = _mm_andnot_ps( xmmInv0Lo, xmmOne );
+        xmm0Hi = _mm_andnot_ps( xmmInv0Hi, xmmOne );
+        xmm1Lo = _mm_andnot_ps( xmmInv1Lo, xmmOne );
+        xmm1Hi = _mm_andnot_ps( xmmInv1Hi, xmmOne );
+        __m128 xmmCount = _mm_add_ps(
+            _mm_add_ps( _mm_shuffle_ps( xmm0Lo, xmm0Hi, _MM_SHUFFLE(2,0,2,0) ),
+                        _mm_shuffle_ps( xmm0Lo, xmm0Hi, _MM_SHUFFLE(3,1,3,1) ) ),
+            _mm_add_ps( _mm_shuffle_ps( xmm1Lo, xmm1Hi, _MM_SHUFFLE(2,0,2,0) ),
+                        _mm_shuffle_ps( xmm1Lo, xmm1Hi, _MM_SHUFFLE(3,1,3,1) ) ) );
+
+        __m128 xmmEmpty = _mm_cmpeq_ps( xmmCount, xmmZero );
+        __m128 xmmRes = _mm_div_ps( xmmTotal, _mm_or_ps( xmmCount,
+                                        _mm_and_ps( xmmEmpty, xmmOne ) ) );
+        xmmRes = _mm_or_ps( _mm_and_ps( xmmEmpty, xmmNoData ),
+                            _mm_andnot_ps( xmmEmpty, xmmRes ) );
+        _mm_storeu_ps( pafDst + i, xmmRes );
+    }
+
+    return i;
+}
+
+/************************************************************************/
+/*                    GDALDownsampleGauss3x3SSE2()                      */
+/*                                                                      */
+/*      Apply the 3x3 gaussian kernel to 4 destination pixels whose     */
+/*      windows start every 2 source pixels.                            */
+/************************************************************************/
+
+static void GDALDownsampleGauss3x3SSE2( const float* pafSrc,
+                                        const GByte* pabyMask,
+                                        int nLineStride,
+                                        float* pafDst,
+                                        int bHasNoData, float fNoDataValue )
+{
+    const __m128 xmmOne = _mm_set1_ps(1.0f);
+    const __m128 xmmTwo = _mm_set1_ps(2.0f);
+    __m128 xmmTotal = _mm_setzero_ps();
+    __m128 xmmCount = _mm_setzero_ps();
+
+    for( int iY = 0; iY < 3; iY++ )
+    {
+        const float* pafLine = pafSrc + iY * nLineStride;
+        __m128 xmmLo = _mm_loadu_ps( pafLine );
+        __m128 xmmHi = _mm_loadu_ps( pafLine + 4 );
+        __m128 xmmLast = _mm_load_ss( pafLine + 8 );
+        __m128 xmmOnesLo = xmmOne, xmmOnesHi = xmmOne, xmmOnesLast = xmmOne;
+
+        if( pabyMask != NULL )
+        {
+            const GByte* pabyMaskLine = pabyMask + iY * nLineStride;
+            __m128 xmmInvLo = GDALLoadInvalidMask4SSE2( pabyMaskLine );
+            __m128 xmmInvHi = GDALLoadInvalidMask4SSE2( pabyMaskLine + 4 );
+            __m128 xmmInvLast = _mm_castsi128_ps(
+                _mm_set1_epi32( pabyMaskLine[8] == 0 ? -1 : 0 ) );
+            xmmLo = _mm_andnot_ps( xmmInvLo, xmmLo );
+            xmmHi = _mm_andnot_ps( xmmInvHi, xmmHi );
+            xmmLast = _mm_andnot_ps( xmmInvLast, xmmLast );
+            xmmOnesLo = _mm_andnot_ps( xmmInvLo, xmmOne );
+            xmmOnesHi = _mm_andnot_ps( xmmInvHi, xmmOne );
+            xmmOnesLast = _mm_andnot_ps( xmmInvLast, xmmOne );
+        }
+
+        /* Columns 0,2,4,6 ; 1,3,5,7 and 2,4,6,8 of the source line */
+        __m128 xmmEven = _mm_shuffle_ps( xmmLo, xmmHi, _MM_SHUFFLE(2,0,2,0) );
+        __m128 xmmOdd = _mm_shuffle_ps( xmmLo, xmmHi, _MM_SHUFFLE(3,1,3,1) );
+        __m128 xmmNext = _mm_shuffle_ps( xmmEven,
+            _mm_shuffle_ps( xmmEven, xmmLast, _MM_SHUFFLE(0,0,3,3) ),
+            _MM_SHUFFLE(2,0,2,1) );
+        __m128 xmmLine = _mm_add_ps( _mm_add_ps( xmmEven, xmmNext ),
+                                     _mm_mul_ps( xmmOdd, xmmTwo ) );
+
+        xmmEven = _mm_shuffle_ps( xmmOnesLo, xmmOnesHi, _MM_SHUFFLE(2,0,2,0) );
+        xmmOdd = _mm_shuffle_ps( xmmOnesLo, xmmOnesHi, _MM_SHUFFLE(3,1,3,1) );
+        xmmNext = _mm_shuffle_ps( xmmEven,
+            _mm_shuffle_ps( xmmEven, xmmOnesLast, _MM_SHUFFLE(0,0,3,3) ),
+            _MM_SHUFFLE(2,0,2,1) );
+        __m128 xmmLineCount = _mm_add_ps( _mm_add_ps( xmmEven, xmmNext ),
+                                          _mm_mul_ps( xmmOdd, xmmTwo ) );
+
+        if( iY == 1 )
+        {
+            xmmLine = _mm_mul_ps( xmmLine, xmmTwo );
+            xmmLineCount = _mm_mul_ps( xmmLineCount, xmmTwo );
+        }
+        xmmTotal = _mm_add_ps( xmmTotal, xmmLine );
+        xmmCount = _mm_add_ps( xmmCount, xmmLineCount );
+    }
+
+    __m128 xmmEmpty = _mm_cmpeq_ps( xmmCount, _mm_setzero_ps() );
+    __m128 xmmRes = _mm_div_ps( xmmTotal, _mm_or_ps( xmmCount,
+                                    _mm_and_ps( xmmEmpty, xmmOne ) ) );
+    xmmRes = _mm_or_ps( _mm_and_ps( xmmEmpty,
+                            _mm_set1_ps( bHasNoData ? fNoDataValue : 0.0f ) ),
+                        _mm_andnot_ps( xmmEmpty, xmmRes ) );
+    _mm_storeu_ps( pafDst, xmmRes );
+}
+
+#endif /* USE_SSE2 */
+
 /************************************************************************/
 /*                    GDALDownsampleChunk32R_Average()                  */
 /************************************************************************/
@@ -215,7 +492,8 @@ GDALDownsampleChunk32R_AverageT( int nSrcWidth, int nSrcHeight,
                         GByte * pabyChunkNodataMask,
                         int nChunkXOff, int nChunkXSize,
                         int nChunkYOff, int nChunkYSize,
-                        GDALRasterBand * poOverview,
+                        int nOXSize, int nOYSize,
+                        void * pDstBuffer,
                         const char * pszResampling,
                         int bHasNoData, float fNoDataValue,
                         GDALColorTable* poColorTable,
@@ -228,59 +506,36 @@ GDALDownsampleChunk32R_AverageT( int nSrcWidth, int nSrcHeight,
     if (bBit2Grayscale)
         poColorTable = NULL;
 
-    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2, nOXSize, nOYSize;
+    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2;
     T    *pDstScanline;
 
     T      tNoDataValue = (T)fNoDataValue;
     if (!bHasNoData)
         tNoDataValue = 0;
 
-    nOXSize = poOverview->GetXSize();
-    nOYSize = poOverview->GetYSize();
-
 /* -------------------------------------------------------------------- */
-/*      Figure out the column to start writing to, and the first column */
-/*      to not write to.                                                */
+/*      Figure out the window of the overview covered by this chunk.    */
 /* -------------------------------------------------------------------- */
-    nDstXOff = (int) (0.5 + (nChunkXOff/(double)nSrcWidth) * nOXSize);
-    nDstXOff2 = (int)
-        (0.5 + ((nChunkXOff+nChunkXSize)/(double)nSrcWidth) * nOXSize);
-
-    if( nChunkXOff + nChunkXSize == nSrcWidth )
-        nDstXOff2 = nOXSize;
+    GDALDownsampleDstWindow( nSrcWidth, nSrcHeight, nOXSize, nOYSize,
+                             nChunkXOff, nChunkXSize, nChunkYOff, nChunkYSize,
+                             &nDstXOff, &nDstXOff2, &nDstYOff, &nDstYOff2 );
 
     int nChunkRightXOff = MIN(nSrcWidth, nChunkXOff + nChunkXSize);
     int nDstXWidth = nDstXOff2 - nDstXOff;
 
 /* -------------------------------------------------------------------- */
-/*      Allocate scanline buffer.                                       */
+/*      Allocate source offset buffer.                                  */
 /* -------------------------------------------------------------------- */
 
-    pDstScanline = (T *) VSIMalloc(nDstXWidth * (GDALGetDataTypeSize(eWrkDataType) / 8));
     int* panSrcXOffShifted = (int*)VSIMalloc(2 * nDstXWidth * sizeof(int));
 
-    if( pDstScanline == NULL || panSrcXOffShifted == NULL )
+    if( panSrcXOffShifted == NULL )
     {
         CPLError( CE_Failure, CPLE_OutOfMemory,
                   "GDALDownsampleChunk32R: Out of memory for line buffer." );
-        VSIFree(pDstScanline);
-        VSIFree(panSrcXOffShifted);
         return CE_Failure;
     }
 
-/* -------------------------------------------------------------------- */
-/*      Figure out the line to start writing to, and the first line     */
-/*      to not write to.  In theory this approach should ensure that    */
-/*      every output line will be written if all input chunks are       */
-/*      processed.                                                      */
-/* -------------------------------------------------------------------- */
-    nDstYOff = (int) (0.5 + (nChunkYOff/(double)nSrcHeight) * nOYSize);
-    nDstYOff2 = (int)
-        (0.5 + ((nChunkYOff+nChunkYSize)/(double)nSrcHeight) * nOYSize);
-
-    if( nChunkYOff + nChunkYSize == nSrcHeight )
-        nDstYOff2 = nOYSize;
-
 
     int nEntryCount = 0;
     GDALColorEntry* aEntries = NULL;
@@ -327,6 +582,8 @@ GDALDownsampleChunk32R_AverageT( int nSrcWidth, int nSrcHeight,
     {
         int   nSrcYOff, nSrcYOff2 = 0;
 
+        pDstScanline = ((T *) pDstBuffer) + (iDstLine - nDstYOff) * nDstXWidth;
+
         nSrcYOff = (int) (0.5 + (iDstLine/(double)nOYSize) * nSrcHeight);
         if ( nSrcYOff < nChunkYOff )
             nSrcYOff = nChunkYOff;
@@ -344,12 +601,30 @@ GDALDownsampleChunk32R_AverageT( int nSrcWidth, int nSrcHeight,
 /* -------------------------------------------------------------------- */
         if (poColorTable == NULL)
         {
+            int iDstPixelStart = 0;
+
+#ifdef USE_SSE2
+            /* Vectorized case : overview by a factor of 2 and regular x and y src spacing, */
+            /* with values whose sums are exact, so that the result is the same as below */
+            if (bSrcXSpacingIsTwo && nSrcYOff2 == nSrcYOff + 2 &&
+                (eWrkDataType == GDT_Byte || GDALDownsampleIsExactInFloat(eSrcDataType)))
+            {
+                int nSrcOff = panSrcXOffShifted[0] + (nSrcYOff - nChunkYOff) * nChunkXSize;
+                iDstPixelStart = GDALDownsampleAverage2x2SSE2(
+                    pChunk + nSrcOff, pChunk + nSrcOff + nChunkXSize,
+                    pabyChunkNodataMask ? pabyChunkNodataMask + nSrcOff : NULL,
+                    pabyChunkNodataMask ? pabyChunkNodataMask + nSrcOff + nChunkXSize : NULL,
+                    pDstScanline, nDstXWidth, tNoDataValue );
+            }
+#endif
+
             if (bSrcXSpacingIsTwo && nSrcYOff2 == nSrcYOff + 2 &&
                 pabyChunkNodataMask == NULL && eWrkDataType == GDT_Byte)
             {
                 /* Optimized case : no nodata, overview by a factor of 2 and regular x and y src spacing */
-                T* pSrcScanlineShifted = pChunk + panSrcXOffShifted[0] + (nSrcYOff - nChunkYOff) * nChunkXSize;
-                for( iDstPixel = 0; iDstPixel < nDstXWidth; iDstPixel++ )
+                T* pSrcScanlineShifted = pChunk + panSrcXOffShifted[0] + (nSrcYOff - nChunkYOff) * nChunkXSize
+                                         + 2 * iDstPixelStart;
+                for( iDstPixel = iDstPixelStart; iDstPixel < nDstXWidth; iDstPixel++ )
                 {
                     Tsum nTotal;
 
@@ -367,7 +642,7 @@ GDALDownsampleChunk32R_AverageT( int nSrcWidth, int nSrcHeight,
                 nSrcYOff -= nChunkYOff;
                 nSrcYOff2 -= nChunkYOff;
 
-                for( iDstPixel = 0; iDstPixel < nDstXWidth; iDstPixel++ )
+                for( iDstPixel = iDstPixelStart; iDstPixel < nDstXWidth; iDstPixel++ )
                 {
                     int  nSrcXOff = panSrcXOffShifted[2 * iDstPixel],
                          nSrcXOff2 = panSrcXOffShifted[2 * iDstPixel + 1];
@@ -455,13 +730,8 @@ GDALDownsampleChunk32R_AverageT( int nSrcWidth, int nSrcHeight,
                 }
             }
         }
-
-        eErr = poOverview->RasterIO( GF_Write, nDstXOff, iDstLine, nDstXWidth, 1,
-                                     pDstScanline, nDstXWidth, 1, eWrkDataType,
-                                     0, 0 );
     }
 
-    CPLFree( pDstScanline );
     CPLFree( aEntries );
     CPLFree( panSrcXOffShifted );
 
@@ -475,7 +745,8 @@ GDALDownsampleChunk32R_Average( int nSrcWidth, int nSrcHeight,
                         GByte * pabyChunkNodataMask,
                         int nChunkXOff, int nChunkXSize,
                         int nChunkYOff, int nChunkYSize,
-                        GDALRasterBand * poOverview,
+                        int nOXSize, int nOYSize,
+                        void * pDstBuffer,
                         const char * pszResampling,
                         int bHasNoData, float fNoDataValue,
                         GDALColorTable* poColorTable,
@@ -488,7 +759,8 @@ GDALDownsampleChunk32R_Average( int nSrcWidth, int nSrcHeight,
                         pabyChunkNodataMask,
                         nChunkXOff, nChunkXSize,
                         nChunkYOff, nChunkYSize,
-                        poOverview,
+                        nOXSize, nOYSize,
+                        pDstBuffer,
                         pszResampling,
                         bHasNoData, fNoDataValue,
                         poColorTable,
@@ -500,7 +772,8 @@ GDALDownsampleChunk32R_Average( int nSrcWidth, int nSrcHeight,
                         pabyChunkNodataMask,
                         nChunkXOff, nChunkXSize,
                         nChunkYOff, nChunkYSize,
-                        poOverview,
+                        nOXSize, nOYSize,
+                        pDstBuffer,
                         pszResampling,
                         bHasNoData, fNoDataValue,
                         poColorTable,
@@ -521,7 +794,8 @@ GDALDownsampleChunk32R_Gauss( int nSrcWidth, int nSrcHeight,
                         GByte * pabyChunkNodataMask,
                         int nChunkXOff, int nChunkXSize,
                         int nChunkYOff, int nChunkYSize,
-                        GDALRasterBand * poOverview,
+                        int nOXSize, int nOYSize,
+                        void * pDstBuffer,
                         const char * pszResampling,
                         int bHasNoData, float fNoDataValue,
                         GDALColorTable* poColorTable,
@@ -535,7 +809,7 @@ GDALDownsampleChunk32R_Gauss( int nSrcWidth, int nSrcHeight,
 /* -------------------------------------------------------------------- */
 /*      Create the filter kernel and allocate scanline buffer.          */
 /* -------------------------------------------------------------------- */
-    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2, nOXSize, nOYSize;
+    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2;
     float    *pafDstScanline;
     int nGaussMatrixDim = 3;
     const int *panGaussMatrix;
@@ -559,8 +833,6 @@ GDALDownsampleChunk32R_Gauss( int nSrcWidth, int nSrcHeight,
         6,36,90,120,90,36,6,
         1,6,15,20,15,6,1};
 
-    nOXSize = poOverview->GetXSize();
-    nOYSize = poOverview->GetYSize();
     int nResYFactor = (int) (0.5 + (double)nSrcHeight/(double)nOYSize);
 
     // matrix for gauss filter
@@ -581,37 +853,11 @@ GDALDownsampleChunk32R_Gauss( int nSrcWidth, int nSrcHeight,
     }
 
 /* -------------------------------------------------------------------- */
-/*      Figure out the column to start writing to, and the first column */
-/*      to not write to.                                                */
-/* -------------------------------------------------------------------- */
-    nDstXOff = (int) (0.5 + (nChunkXOff/(double)nSrcWidth) * nOXSize);
-    nDstXOff2 = (int)
-        (0.5 + ((nChunkXOff+nChunkXSize)/(double)nSrcWidth) * nOXSize);
-
-    if( nChunkXOff + nChunkXSize == nSrcWidth )
-        nDstXOff2 = nOXSize;
-
-
-    pafDstScanline = (float *) VSIMalloc((nDstXOff2 - nDstXOff) * sizeof(float));
-    if( pafDstScanline == NULL )
-    {
-        CPLError( CE_Failure, CPLE_OutOfMemory,
-                  "GDALDownsampleChunk32R: Out of memory for line buffer." );
-        return CE_Failure;
-    }
-
-/* -------------------------------------------------------------------- */
-/*      Figure out the line to start writing to, and the first line     */
-/*      to not write to.  In theory this approach should ensure that    */
-/*      every output line will be written if all input chunks are       */
-/*      processed.                                                      */
+/*      Figure out the window of the overview covered by this chunk.    */
 /* -------------------------------------------------------------------- */
-    nDstYOff = (int) (0.5 + (nChunkYOff/(double)nSrcHeight) * nOYSize);
-    nDstYOff2 = (int)
-        (0.5 + ((nChunkYOff+nChunkYSize)/(double)nSrcHeight) * nOYSize);
-
-    if( nChunkYOff + nChunkYSize == nSrcHeight )
-        nDstYOff2 = nOYSize;
+    GDALDownsampleDstWindow( nSrcWidth, nSrcHeight, nOXSize, nOYSize,
+                             nChunkXOff, nChunkXSize, nChunkYOff, nChunkYSize,
+                             &nDstXOff, &nDstXOff2, &nDstYOff, &nDstYOff2 );
 
 
     int nEntryCount = 0;
@@ -629,6 +875,46 @@ GDALDownsampleChunk32R_Gauss( int nSrcWidth, int nSrcHeight,
 
     int nChunkRightXOff = MIN(nSrcWidth, nChunkXOff + nChunkXSize);
 
+/* ==================================================================== */
+/*      Precompute the source columns of each destination pixel.        */
+/* ==================================================================== */
+    int iDstPixel;
+    int *panSrcXOff = (int*)VSIMalloc(2 * (nDstXOff2 - nDstXOff) * sizeof(int));
+    if( panSrcXOff == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "GDALDownsampleChunk32R: Out of memory for line buffer." );
+        CPLFree( aEntries );
+        return CE_Failure;
+    }
+
+    for( iDstPixel = nDstXOff; iDstPixel < nDstXOff2; iDstPixel++ )
+    {
+        int   nSrcXOff, nSrcXOff2;
+
+        nSrcXOff = (int) (0.5 + (iDstPixel/(double)nOXSize) * nSrcWidth);
+        nSrcXOff2 = (int)(0.5 + ((iDstPixel+1)/(double)nOXSize) * nSrcWidth) + 1;
+
+        int iSizeX = nSrcXOff2 - nSrcXOff;
+        nSrcXOff = nSrcXOff + iSizeX/2 - nGaussMatrixDim/2;
+        nSrcXOff2 = nSrcXOff + nGaussMatrixDim;
+        if(nSrcXOff < 0)
+            nSrcXOff = 0;
+
+        if( nSrcXOff2 > nChunkRightXOff || iDstPixel == nOXSize-1 )
+            nSrcXOff2 = nChunkRightXOff;
+
+        panSrcXOff[2 * (iDstPixel - nDstXOff)] = nSrcXOff;
+        panSrcXOff[2 * (iDstPixel - nDstXOff) + 1] = nSrcXOff2;
+    }
+
+#ifdef USE_SSE2
+    /* The 3x3 kernel can be vectorized when the sums are exact, */
+    /* so that the result is the same as the one of the generic code */
+    int bUseSSE2 = ( nGaussMatrixDim == 3 && poColorTable == NULL &&
+                     GDALDownsampleIsExactInFloat(eSrcDataType) );
+#endif
+
 /* ==================================================================== */
 /*      Loop over destination scanlines.                                */
 /* ==================================================================== */
@@ -636,7 +922,10 @@ GDALDownsampleChunk32R_Gauss( int nSrcWidth, int nSrcHeight,
     {
         float *pafSrcScanline;
         GByte *pabySrcScanlineNodataMask;
-        int   nSrcYOff, nSrcYOff2 = 0, iDstPixel;
+        int   nSrcYOff, nSrcYOff2 = 0;
+
+        pafDstScanline = ((float *) pDstBuffer)
+            + (iDstLine - nDstYOff) * (nDstXOff2 - nDstXOff);
 
         nSrcYOff = (int) (0.5 + (iDstLine/(double)nOYSize) * nSrcHeight);
         nSrcYOff2 = (int) (0.5 + ((iDstLine+1)/(double)nOYSize) * nSrcHeight) + 1;
@@ -668,21 +957,43 @@ GDALDownsampleChunk32R_Gauss( int nSrcWidth, int nSrcHeight,
 /* -------------------------------------------------------------------- */
 /*      Loop over destination pixels                                    */
 /* -------------------------------------------------------------------- */
+#ifdef USE_SSE2
+        int bUseSSE2Line = bUseSSE2 && nSrcYOff2 - nSrcYOff == 3;
+#endif
+
         for( iDstPixel = nDstXOff; iDstPixel < nDstXOff2; iDstPixel++ )
         {
-            int   nSrcXOff, nSrcXOff2;
-
-            nSrcXOff = (int) (0.5 + (iDstPixel/(double)nOXSize) * nSrcWidth);
-            nSrcXOff2 = (int)(0.5 + ((iDstPixel+1)/(double)nOXSize) * nSrcWidth) + 1;
-
-            int iSizeX = nSrcXOff2 - nSrcXOff;
-            nSrcXOff = nSrcXOff + iSizeX/2 - nGaussMatrixDim/2;
-            nSrcXOff2 = nSrcXOff + nGaussMatrixDim;
-            if(nSrcXOff < 0)
-                nSrcXOff = 0;
-
-            if( nSrcXOff2 > nChunkRightXOff || iDstPixel == nOXSize-1 )
-                nSrcXOff2 = nChunkRightXOff;
+            int   nSrcXOff = panSrcXOff[2 * (iDstPixel - nDstXOff)],
+                  nSrcXOff2 = panSrcXOff[2 * (iDstPixel - nDstXOff) + 1];
+
+#ifdef USE_SSE2
+            /* Process 4 pixels at once if their windows are complete */
+            /* and start every 2 source pixels */
+            if( bUseSSE2Line && iDstPixel + 4 <= nDstXOff2 &&
+                nSrcXOff >= nChunkXOff )
+            {
+                const int *panOff = panSrcXOff + 2 * (iDstPixel - nDstXOff);
+                int i;
+                for( i = 0; i < 4; i++ )
+                {
+                    if( panOff[2 * i] != nSrcXOff + 2 * i ||
+                        panOff[2 * i + 1] != nSrcXOff + 2 * i + 3 )
+                        break;
+                }
+                if( i == 4 )
+                {
+                    int nSrcOff = nSrcXOff - nChunkXOff;
+                    GDALDownsampleGauss3x3SSE2(
+                        pafSrcScanline + nSrcOff,
+                        pabySrcScanlineNodataMask ? pabySrcScanlineNodataMask + nSrcOff : NULL,
+                        nChunkXSize,
+                        pafDstScanline + iDstPixel - nDstXOff,
+                        bHasNoData, fNoDataValue );
+                    iDstPixel += 3;
+                    continue;
+                }
+            }
+#endif
 
             if (poColorTable == NULL)
             {
@@ -780,14 +1091,10 @@ GDALDownsampleChunk32R_Gauss( int nSrcWidth, int nSrcHeight,
             }
 
         }
-
-        eErr = poOverview->RasterIO( GF_Write, nDstXOff, iDstLine, nDstXOff2 - nDstXOff, 1,
-                                     pafDstScanline, nDstXOff2 - nDstXOff, 1, GDT_Float32,
-                                     0, 0 );
     }
 
-    CPLFree( pafDstScanline );
     CPLFree( aEntries );
+    CPLFree( panSrcXOff );
 
     return eErr;
 }
@@ -803,7 +1110,8 @@ GDALDownsampleChunk32R_Mode( int nSrcWidth, int nSrcHeight,
                         GByte * pabyChunkNodataMask,
                         int nChunkXOff, int nChunkXSize,
                         int nChunkYOff, int nChunkYSize,
-                        GDALRasterBand * poOverview,
+                        int nOXSize, int nOYSize,
+                        void * pDstBuffer,
                         const char * pszResampling,
                         int bHasNoData, float fNoDataValue,
                         GDALColorTable* poColorTable,
@@ -817,44 +1125,15 @@ GDALDownsampleChunk32R_Mode( int nSrcWidth, int nSrcHeight,
 /* -------------------------------------------------------------------- */
 /*      Create the filter kernel and allocate scanline buffer.          */
 /* -------------------------------------------------------------------- */
-    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2, nOXSize, nOYSize;
+    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2;
     float    *pafDstScanline;
 
-    nOXSize = poOverview->GetXSize();
-    nOYSize = poOverview->GetYSize();
-
-/* -------------------------------------------------------------------- */
-/*      Figure out the column to start writing to, and the first column */
-/*      to not write to.                                                */
-/* -------------------------------------------------------------------- */
-    nDstXOff = (int) (0.5 + (nChunkXOff/(double)nSrcWidth) * nOXSize);
-    nDstXOff2 = (int)
-        (0.5 + ((nChunkXOff+nChunkXSize)/(double)nSrcWidth) * nOXSize);
-
-    if( nChunkXOff + nChunkXSize == nSrcWidth )
-        nDstXOff2 = nOXSize;
-
-
-    pafDstScanline = (float *) VSIMalloc((nDstXOff2 - nDstXOff) * sizeof(float));
-    if( pafDstScanline == NULL )
-    {
-        CPLError( CE_Failure, CPLE_OutOfMemory,
-                  "GDALDownsampleChunk32R: Out of memory for line buffer." );
-        return CE_Failure;
-    }
-
 /* -------------------------------------------------------------------- */
-/*      Figure out the line to start writing to, and the first line     */
-/*      to not write to.  In theory this approach should ensure that    */
-/*      every output line will be written if all input chunks are       */
-/*      processed.                                                      */
+/*      Figure out the window of the overview covered by this chunk.    */
 /* -------------------------------------------------------------------- */
-    nDstYOff = (int) (0.5 + (nChunkYOff/(double)nSrcHeight) * nOYSize);
-    nDstYOff2 = (int)
-        (0.5 + ((nChunkYOff+nChunkYSize)/(double)nSrcHeight) * nOYSize);
-
-    if( nChunkYOff + nChunkYSize == nSrcHeight )
-        nDstYOff2 = nOYSize;
+    GDALDownsampleDstWindow( nSrcWidth, nSrcHeight, nOXSize, nOYSize,
+                             nChunkXOff, nChunkXSize, nChunkYOff, nChunkYSize,
+                             &nDstXOff, &nDstXOff2, &nDstYOff, &nDstYOff2 );
 
 
     int nEntryCount = 0;
@@ -885,6 +1164,9 @@ GDALDownsampleChunk32R_Mode( int nSrcWidth, int nSrcHeight,
         GByte *pabySrcScanlineNodataMask;
         int   nSrcYOff, nSrcYOff2 = 0, iDstPixel;
 
+        pafDstScanline = ((float *) pDstBuffer)
+            + (iDstLine - nDstYOff) * (nDstXOff2 - nDstXOff);
+
         nSrcYOff = (int) (0.5 + (iDstLine/(double)nOYSize) * nSrcHeight);
         if ( nSrcYOff < nChunkYOff )
             nSrcYOff = nChunkYOff;
@@ -1010,13 +1292,8 @@ GDALDownsampleChunk32R_Mode( int nSrcWidth, int nSrcHeight,
                     pafDstScanline[iDstPixel - nDstXOff] = (float)iMaxInd;
             }
         }
-
-        eErr = poOverview->RasterIO( GF_Write, nDstXOff, iDstLine, nDstXOff2 - nDstXOff, 1,
-                                     pafDstScanline, nDstXOff2 - nDstXOff, 1, GDT_Float32,
-                                     0, 0 );
     }
 
-    CPLFree( pafDstScanline );
     CPLFree( aEntries );
     CPLFree( pafVals );
     CPLFree( panSums );
@@ -1035,7 +1312,8 @@ GDALDownsampleChunk32R_Cubic( int nSrcWidth, int nSrcHeight,
                         GByte * pabyChunkNodataMask,
                         int nChunkXOff, int nChunkXSize,
                         int nChunkYOff, int nChunkYSize,
-                        GDALRasterBand * poOverview,
+                        int nOXSize, int nOYSize,
+                        void * pDstBuffer,
                         const char * pszResampling,
                         int bHasNoData, float fNoDataValue,
                         GDALColorTable* poColorTable,
@@ -1050,44 +1328,15 @@ GDALDownsampleChunk32R_Cubic( int nSrcWidth, int nSrcHeight,
 /* -------------------------------------------------------------------- */
 /*      Create the filter kernel and allocate scanline buffer.          */
 /* -------------------------------------------------------------------- */
-    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2, nOXSize, nOYSize;
+    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2;
     float    *pafDstScanline;
 
-    nOXSize = poOverview->GetXSize();
-    nOYSize = poOverview->GetYSize();
-
-/* -------------------------------------------------------------------- */
-/*      Figure out the column to start writing to, and the first column */
-/*      to not write to.                                                */
-/* -------------------------------------------------------------------- */
-    nDstXOff = (int) (0.5 + (nChunkXOff/(double)nSrcWidth) * nOXSize);
-    nDstXOff2 = (int)
-        (0.5 + ((nChunkXOff+nChunkXSize)/(double)nSrcWidth) * nOXSize);
-
-    if( nChunkXOff + nChunkXSize == nSrcWidth )
-        nDstXOff2 = nOXSize;
-
-
-    pafDstScanline = (float *) VSIMalloc((nDstXOff2 - nDstXOff) * sizeof(float));
-    if( pafDstScanline == NULL )
-    {
-        CPLError( CE_Failure, CPLE_OutOfMemory,
-                  "GDALDownsampleChunk32R: Out of memory for line buffer." );
-        return CE_Failure;
-    }
-
 /* -------------------------------------------------------------------- */
-/*      Figure out the line to start writing to, and the first line     */
-/*      to not write to.  In theory this approach should ensure that    */
-/*      every output line will be written if all input chunks are       */
-/*      processed.                                                      */
+/*      Figure out the window of the overview covered by this chunk.    */
 /* -------------------------------------------------------------------- */
-    nDstYOff = (int) (0.5 + (nChunkYOff/(double)nSrcHeight) * nOYSize);
-    nDstYOff2 = (int)
-        (0.5 + ((nChunkYOff+nChunkYSize)/(double)nSrcHeight) * nOYSize);
-
-    if( nChunkYOff + nChunkYSize == nSrcHeight )
-        nDstYOff2 = nOYSize;
+    GDALDownsampleDstWindow( nSrcWidth, nSrcHeight, nOXSize, nOYSize,
+                             nChunkXOff, nChunkXSize, nChunkYOff, nChunkYSize,
+                             &nDstXOff, &nDstXOff2, &nDstYOff, &nDstYOff2 );
 
 
     int nEntryCount = 0;
@@ -1114,6 +1363,9 @@ GDALDownsampleChunk32R_Cubic( int nSrcWidth, int nSrcHeight,
         GByte *pabySrcScanlineNodataMask;
         int   nSrcYOff, nSrcYOff2 = 0, iDstPixel;
 
+        pafDstScanline = ((float *) pDstBuffer)
+            + (iDstLine - nDstYOff) * (nDstXOff2 - nDstXOff);
+
         nSrcYOff = (int) floor(((iDstLine+0.5)/(double)nOYSize) * nSrcHeight - 0.5)-1;
         nSrcYOff2 = nSrcYOff + 4;
         if(nSrcYOff < 0)
@@ -1205,13 +1457,8 @@ GDALDownsampleChunk32R_Cubic( int nSrcWidth, int nSrcHeight,
                                         adfRowResults[3] );
             }
         }
-
-        eErr = poOverview->RasterIO( GF_Write, nDstXOff, iDstLine, nDstXOff2 - nDstXOff, 1,
-                                     pafDstScanline, nDstXOff2 - nDstXOff, 1, GDT_Float32,
-                                     0, 0 );
     }
 
-    CPLFree( pafDstScanline );
     CPLFree( aEntries );
 
     return eErr;
@@ -1224,37 +1471,21 @@ GDALDownsampleChunk32R_Cubic( int nSrcWidth, int nSrcHeight,
 static CPLErr
 GDALDownsampleChunkC32R( int nSrcWidth, int nSrcHeight, 
                          float * pafChunk, int nChunkYOff, int nChunkYSize,
-                         GDALRasterBand * poOverview,
+                         int nOXSize, int nOYSize,
+                         void * pDstBuffer,
                          const char * pszResampling )
     
 {
-    int      nDstYOff, nDstYOff2, nOXSize, nOYSize;
+    int      nDstXOff, nDstXOff2, nDstYOff, nDstYOff2;
     float    *pafDstScanline;
     CPLErr   eErr = CE_None;
 
-    nOXSize = poOverview->GetXSize();
-    nOYSize = poOverview->GetYSize();
-
-    pafDstScanline = (float *) VSIMalloc(nOXSize * sizeof(float) * 2);
-    if( pafDstScanline == NULL )
-    {
-        CPLError( CE_Failure, CPLE_OutOfMemory,
-                  "GDALDownsampleChunkC32R: Out of memory for line buffer." );
-        return CE_Failure;
-    }
-
 /* -------------------------------------------------------------------- */
-/*      Figure out the line to start writing to, and the first line     */
-/*      to not write to.  In theory this approach should ensure that    */
-/*      every output line will be written if all input chunks are       */
-/*      processed.                                                      */
+/*      Figure out the window of the overview covered by this chunk.    */
 /* -------------------------------------------------------------------- */
-    nDstYOff = (int) (0.5 + (nChunkYOff/(double)nSrcHeight) * nOYSize);
-    nDstYOff2 = (int) 
-        (0.5 + ((nChunkYOff+nChunkYSize)/(double)nSrcHeight) * nOYSize);
-
-    if( nChunkYOff + nChunkYSize == nSrcHeight )
-        nDstYOff2 = nOYSize;
+    GDALDownsampleDstWindow( nSrcWidth, nSrcHeight, nOXSize, nOYSize,
+                             0, nSrcWidth, nChunkYOff, nChunkYSize,
+                             &nDstXOff, &nDstXOff2, &nDstYOff, &nDstYOff2 );
     
 /* ==================================================================== */
 /*      Loop over destination scanlines.                                */
@@ -1264,6 +1495,9 @@ GDALDownsampleChunkC32R( int nSrcWidth, int nSrcHeight,
         float *pafSrcScanline;
         int   nSrcYOff, nSrcYOff2, iDstPixel;
 
+        pafDstScanline = ((float *) pDstBuffer)
+            + (iDstLine - nDstYOff) * nOXSize * 2;
+
         nSrcYOff = (int) (0.5 + (iDstLine/(double)nOYSize) * nSrcHeight);
         if( nSrcYOff < nChunkYOff )
             nSrcYOff = nChunkYOff;
@@ -1365,35 +1599,21 @@ GDALDownsampleChunkC32R( int nSrcWidth, int nSrcHeight,
                 }
             }
         }
-
-        eErr = poOverview->RasterIO( GF_Write, 0, iDstLine, nOXSize, 1, 
-                                     pafDstScanline, nOXSize, 1, GDT_CFloat32, 
-                                     0, 0 );
     }
 
-    CPLFree( pafDstScanline );
-
     return eErr;
 }
 
 /************************************************************************/
-/*                  GDALRegenerateCascadingOverviews()                  */
+/*                      GDALSortOverviewsBySize()                       */
 /*                                                                      */
-/*      Generate a list of overviews in order from largest to           */
-/*      smallest, computing each from the next larger.                  */
+/*      Put the overviews in order from largest to smallest.            */
 /************************************************************************/
 
-static CPLErr
-GDALRegenerateCascadingOverviews( 
-    GDALRasterBand *poSrcBand, int nOverviews, GDALRasterBand **papoOvrBands, 
-    const char * pszResampling, 
-    GDALProgressFunc pfnProgress, void * pProgressData )
+static void GDALSortOverviewsBySize( int nOverviews,
+                                     GDALRasterBand **papoOvrBands )
 
 {
-/* -------------------------------------------------------------------- */
-/*      First, we must put the overviews in order from largest to       */
-/*      smallest.                                                       */
-/* -------------------------------------------------------------------- */
     int   i, j;
 
     for( i = 0; i < nOverviews-1; i++ )
@@ -1414,6 +1634,29 @@ GDALRegenerateCascadingOverviews(
             }
         }
     }
+}
+
+/************************************************************************/
+/*                  GDALRegenerateCascadingOverviews()                  */
+/*                                                                      */
+/*      Generate a list of overviews in order from largest to           */
+/*      smallest, computing each from the next larger.                  */
+/************************************************************************/
+
+static CPLErr
+GDALRegenerateCascadingOverviews( 
+    GDALRasterBand *poSrcBand, int nOverviews, GDALRasterBand **papoOvrBands, 
+    const char * pszResampling, 
+    GDALProgressFunc pfnProgress, void * pProgressData )
+
+{
+/* -------------------------------------------------------------------- */
+/*      First, we must put the overviews in order from largest to       */
+/*      smallest.                                                       */
+/* -------------------------------------------------------------------- */
+    int   i;
+
+    GDALSortOverviewsBySize( nOverviews, papoOvrBands );
 
 /* -------------------------------------------------------------------- */
 /*      Count total pixels so we can prepare appropriate scaled         */
@@ -1513,64 +1756,410 @@ static GDALDataType GDALGetOvrWorkDataType(const char* pszResampling,
 }
 
 /************************************************************************/
-/*                      GDALRegenerateOverviews()                       */
+/*                        GDALOvrDownsampleJob                          */
+/*                                                                      */
+/*      Downsampling of one chunk of a source band into one overview    */
+/*      band. The job only touches memory buffers, so that it can be    */
+/*      run in a worker thread, while the calling thread does the       */
+/*      reading and writing of the bands.                               */
 /************************************************************************/
 
-/**
- * \brief Generate downsampled overviews.
- *
- * This function will generate one or more overview images from a base
- * image using the requested downsampling algorithm.  It's primary use
- * is for generating overviews via GDALDataset::BuildOverviews(), but it
- * can also be used to generate downsampled images in one file from another
- * outside the overview architecture.
- *
- * The output bands need to exist in advance. 
- *
- * The full set of resampling algorithms is documented in 
- * GDALDataset::BuildOverviews().
- *
- * This function will honour properly NODATA_VALUES tuples (special dataset metadata) so
- * that only a given RGB triplet (in case of a RGB image) will be considered as the
- * nodata value and not each value of the triplet independantly per band.
- *
- * @param hSrcBand the source (base level) band. 
- * @param nOverviewCount the number of downsampled bands being generated.
- * @param pahOvrBands the list of downsampled bands to be generated.
- * @param pszResampling Resampling algorithm (eg. "AVERAGE"). 
- * @param pfnProgress progress report function.
- * @param pProgressData progress function callback data.
- * @return CE_None on success or CE_Failure on failure.
- */
-CPLErr 
-GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
-                         int nOverviewCount, GDALRasterBandH *pahOvrBands, 
-                         const char * pszResampling, 
-                         GDALProgressFunc pfnProgress, void * pProgressData )
+typedef struct
+{
+    GDALDownsampleFunction pfnDownsampleFn; /* NULL for complex data */
+    int             nSrcWidth;
+    int             nSrcHeight;
+    GDALDataType    eWrkDataType;
+    void           *pChunk;
+    GByte          *pabyChunkNodataMask;
+    int             nChunkXOff;
+    int             nChunkXSize;
+    int             nChunkYOff;
+    int             nChunkYSize;
+    GDALRasterBand *poOverview;
+    int             nOXSize;
+    int             nOYSize;
+    const char     *pszResampling;
+    int             bHasNoData;
+    float           fNoDataValue;
+    GDALColorTable *poColorTable;
+    GDALDataType    eSrcDataType;
+
+    /* Result of the job */
+    int             nDstXOff;
+    int             nDstYOff;
+    int             nDstXSize;
+    int             nDstYSize;
+    void           *pDstBuffer;
+    CPLErr          eErr;
+} GDALOvrDownsampleJob;
+
+/************************************************************************/
+/*                      GDALOvrDownsampleJobInit()                      */
+/************************************************************************/
+
+static void GDALOvrDownsampleJobInit( GDALOvrDownsampleJob *psJob,
+                                      GDALDownsampleFunction pfnDownsampleFn,
+                                      int nSrcWidth, int nSrcHeight,
+                                      GDALDataType eWrkDataType,
+                                      void *pChunk,
+                                      GByte *pabyChunkNodataMask,
+                                      int nChunkXOff, int nChunkXSize,
+                                      int nChunkYOff, int nChunkYSize,
+                                      GDALRasterBand *poOverview,
+                                      const char *pszResampling,
+                                      int bHasNoData, float fNoDataValue,
+                                      GDALColorTable *poColorTable,
+                                      GDALDataType eSrcDataType )
 
 {
-    GDALRasterBand *poSrcBand = (GDALRasterBand *) hSrcBand;
-    GDALRasterBand **papoOvrBands = (GDALRasterBand **) pahOvrBands;
-    int    nFullResYChunk, nWidth;
-    int    nFRXBlockSize, nFRYBlockSize;
-    GDALDataType eType;
-    int    bHasNoData;
-    float  fNoDataValue;
-    GDALColorTable* poColorTable = NULL;
+    psJob->pfnDownsampleFn = pfnDownsampleFn;
+    psJob->nSrcWidth = nSrcWidth;
+    psJob->nSrcHeight = nSrcHeight;
+    psJob->eWrkDataType = eWrkDataType;
+    psJob->pChunk = pChunk;
+    psJob->pabyChunkNodataMask = pabyChunkNodataMask;
+    psJob->nChunkXOff = nChunkXOff;
+    psJob->nChunkXSize = nChunkXSize;
+    psJob->nChunkYOff = nChunkYOff;
+    psJob->nChunkYSize = nChunkYSize;
+    psJob->poOverview = poOverview;
+    psJob->nOXSize = poOverview->GetXSize();
+    psJob->nOYSize = poOverview->GetYSize();
+    psJob->pszResampling = pszResampling;
+    psJob->bHasNoData = bHasNoData;
+    psJob->fNoDataValue = fNoDataValue;
+    psJob->poColorTable = poColorTable;
+    psJob->eSrcDataType = eSrcDataType;
+
+    psJob->nDstXOff = 0;
+    psJob->nDstYOff = 0;
+    psJob->nDstXSize = 0;
+    psJob->nDstYSize = 0;
+    psJob->pDstBuffer = NULL;
+    psJob->eErr = CE_None;
+}
 
-    if( pfnProgress == NULL )
-        pfnProgress = GDALDummyProgress;
+/************************************************************************/
+/*                      GDALOvrDownsampleJobRun()                       */
+/************************************************************************/
 
-    if( EQUAL(pszResampling,"NONE") )
-        return CE_None;
+static void GDALOvrDownsampleJobRun( void *pData )
 
-    GDALDownsampleFunction pfnDownsampleFn = GDALGetDownsampleFunction(pszResampling);
-    if (pfnDownsampleFn == NULL)
-        return CE_Failure;
+{
+    GDALOvrDownsampleJob *psJob = (GDALOvrDownsampleJob *) pData;
+    int nDstXOff2, nDstYOff2;
+
+    GDALDownsampleDstWindow( psJob->nSrcWidth, psJob->nSrcHeight,
+                             psJob->nOXSize, psJob->nOYSize,
+                             psJob->nChunkXOff, psJob->nChunkXSize,
+                             psJob->nChunkYOff, psJob->nChunkYSize,
+                             &psJob->nDstXOff, &nDstXOff2,
+                             &psJob->nDstYOff, &nDstYOff2 );
+    psJob->nDstXSize = nDstXOff2 - psJob->nDstXOff;
+    psJob->nDstYSize = nDstYOff2 - psJob->nDstYOff;
+
+    /* The chunk may not cover any line of a small overview */
+    if( psJob->nDstXSize <= 0 || psJob->nDstYSize <= 0 )
+        return;
+
+    GDALDataType eDstType = ( psJob->pfnDownsampleFn != NULL ) ?
+                                    psJob->eWrkDataType : GDT_CFloat32;
+    psJob->pDstBuffer = VSIMalloc3( psJob->nDstXSize, psJob->nDstYSize,
+                                    GDALGetDataTypeSize(eDstType) / 8 );
+    if( psJob->pDstBuffer == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "GDALDownsampleChunk32R: Out of memory for line buffer." );
+        psJob->eErr = CE_Failure;
+        return;
+    }
+
+    if( psJob->pfnDownsampleFn != NULL )
+        psJob->eErr = psJob->pfnDownsampleFn( psJob->nSrcWidth,
+                                              psJob->nSrcHeight,
+                                              psJob->eWrkDataType,
+                                              psJob->pChunk,
+                                              psJob->pabyChunkNodataMask,
+                                              psJob->nChunkXOff,
+                                              psJob->nChunkXSize,
+                                              psJob->nChunkYOff,
+                                              psJob->nChunkYSize,
+                                              psJob->nOXSize, psJob->nOYSize,
+                                              psJob->pDstBuffer,
+                                              psJob->pszResampling,
+                                              psJob->bHasNoData,
+                                              psJob->fNoDataValue,
+                                              psJob->poColorTable,
+                                              psJob->eSrcDataType );
+    else
+        psJob->eErr = GDALDownsampleChunkC32R( psJob->nSrcWidth,
+                                               psJob->nSrcHeight,
+                                               (float *) psJob->pChunk,
+                                               psJob->nChunkYOff,
+                                               psJob->nChunkYSize,
+                                               psJob->nOXSize, psJob->nOYSize,
+                                               psJob->pDstBuffer,
+                                               psJob->pszResampling );
+}
+
+/************************************************************************/
+/*                         GDALOvrPyramidLevel                          */
+/*                                                                      */
+/*      One step of a single pass pyramid build: the lines of an        */
+/*      overview computed from the previous level are accumulated in    */
+/*      memory, and downsampled into the next smaller overview as soon  */
+/*      as a full chunk of them is available, instead of being read     */
+/*      back from disk.                                                 */
+/************************************************************************/
+
+typedef struct
+{
+    GDALRasterBand *poSrcBand;        /* overview providing the lines */
+    GDALRasterBand *poOverview;       /* overview computed from them */
+    GDALDownsampleFunction pfnDownsampleFn;
+    const char     *pszResampling;
+    GDALDataType    eWrkDataType;
+    int             bHasNoData;
+    float           fNoDataValue;
+    GDALColorTable *poColorTable;
+    int             nChunkYSize;
+
+    /* Lines [nLinesYOff, nLinesYOff + nLines[ of poSrcBand */
+    void           *pLines;
+    int             nLinesYOff;
+    int             nLines;
+    int             nLinesAlloc;
+} GDALOvrPyramidLevel;
+
+static CPLErr GDALOvrPyramidPush( GDALOvrPyramidLevel *pasLevels, int nLevels,
+                                  const void *pData, GDALDataType eDataType,
+                                  int nYOff, int nYSize );
+
+/************************************************************************/
+/*                     GDALOvrDownsampleJobWrite()                      */
+/*                                                                      */
+/*      Write the result of a completed job into its overview band,     */
+/*      and release it.  Must be called from the calling thread.        */
+/*      When building a pyramid in a single pass, the written lines     */
+/*      are also pushed to the next level.                              */
+/************************************************************************/
+
+static CPLErr GDALOvrDownsampleJobWrite( GDALOvrDownsampleJob *psJob,
+                                         GDALOvrPyramidLevel *pasLevels,
+                                         int nLevels )
+
+{
+    CPLErr eErr = psJob->eErr;
+
+    if( eErr == CE_None && psJob->pDstBuffer != NULL )
+    {
+        GDALDataType eDstType = ( psJob->pfnDownsampleFn != NULL ) ?
+                                    psJob->eWrkDataType : GDT_CFloat32;
+        eErr = psJob->poOverview->RasterIO( GF_Write,
+                                            psJob->nDstXOff, psJob->nDstYOff,
+                                            psJob->nDstXSize, psJob->nDstYSize,
+                                            psJob->pDstBuffer,
+                                            psJob->nDstXSize, psJob->nDstYSize,
+                                            eDstType, 0, 0 );
+
+        if( eErr == CE_None && nLevels > 0 )
+        {
+            CPLAssert( psJob->nDstXOff == 0 &&
+                       psJob->nDstXSize == psJob->nOXSize );
+            eErr = GDALOvrPyramidPush( pasLevels, nLevels,
+                                       psJob->pDstBuffer, eDstType,
+                                       psJob->nDstYOff, psJob->nDstYSize );
+        }
+    }
+
+    VSIFree( psJob->pDstBuffer );
+    psJob->pDstBuffer = NULL;
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         GDALOvrPyramidPush()                         */
+/*                                                                      */
+/*      Append lines of the source band of pasLevels[0], as just        */
+/*      written to it, and downsample every complete chunk of them      */
+/*      into the next overview.  The chunks and the data type round     */
+/*      trip through the overview band are the ones of a cascading      */
+/*      generation reading the lines back, so that the result is the   */
+/*      same.                                                           */
+/************************************************************************/
+
+static CPLErr GDALOvrPyramidPush( GDALOvrPyramidLevel *pasLevels, int nLevels,
+                                  const void *pData, GDALDataType eDataType,
+                                  int nYOff, int nYSize )
+
+{
+    GDALOvrPyramidLevel *psLevel = pasLevels;
+    int nWidth = psLevel->poSrcBand->GetXSize();
+    int nHeight = psLevel->poSrcBand->GetYSize();
+    GDALDataType eBandDataType = psLevel->poSrcBand->GetRasterDataType();
+    int nWrkPixelSize = GDALGetDataTypeSize(psLevel->eWrkDataType) / 8;
+    int nSrcPixelSize = GDALGetDataTypeSize(eDataType) / 8;
+
+    CPLAssert( nYOff == psLevel->nLinesYOff + psLevel->nLines );
+
+/* -------------------------------------------------------------------- */
+/*      Append the lines, converted as if they were read back from      */
+/*      the overview band.                                              */
+/* -------------------------------------------------------------------- */
+    if( psLevel->nLines + nYSize > psLevel->nLinesAlloc )
+    {
+        int nNewAlloc = MAX( psLevel->nLines + nYSize, psLevel->nChunkYSize );
+        void *pNewLines = VSIRealloc( psLevel->pLines,
+                                      (size_t) nNewAlloc * nWidth * nWrkPixelSize );
+        if( pNewLines == NULL )
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory,
+                      "Out of memory in GDALOvrPyramidPush()." );
+            return CE_Failure;
+        }
+        psLevel->pLines = pNewLines;
+        psLevel->nLinesAlloc = nNewAlloc;
+    }
+
+    GByte *pabyDstLines = ((GByte *) psLevel->pLines)
+        + (size_t) psLevel->nLines * nWidth * nWrkPixelSize;
+
+    if( eDataType == eBandDataType && eDataType == psLevel->eWrkDataType )
+    {
+        memcpy( pabyDstLines, pData, (size_t) nYSize * nWidth * nWrkPixelSize );
+    }
+    else
+    {
+        GByte *pabyBandLine = (GByte *)
+            VSIMalloc2( nWidth, GDALGetDataTypeSize(eBandDataType) / 8 );
+        if( pabyBandLine == NULL )
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory,
+                      "Out of memory in GDALOvrPyramidPush()." );
+            return CE_Failure;
+        }
+
+        for( int iLine = 0; iLine < nYSize; iLine++ )
+        {
+            GDALCopyWords( ((GByte *) pData)
+                                + (size_t) iLine * nWidth * nSrcPixelSize,
+                           eDataType, nSrcPixelSize,
+                           pabyBandLine, eBandDataType,
+                           GDALGetDataTypeSize(eBandDataType) / 8, nWidth );
+            GDALCopyWords( pabyBandLine, eBandDataType,
+                           GDALGetDataTypeSize(eBandDataType) / 8,
+                           pabyDstLines + (size_t) iLine * nWidth * nWrkPixelSize,
+                           psLevel->eWrkDataType, nWrkPixelSize, nWidth );
+        }
+
+        VSIFree( pabyBandLine );
+    }
+
+    psLevel->nLines += nYSize;
 
 /* -------------------------------------------------------------------- */
-/*      Check color tables...                                           */
+/*      Downsample the complete chunks into the next overview.          */
 /* -------------------------------------------------------------------- */
+    CPLErr eErr = CE_None;
+
+    while( eErr == CE_None
+           && ( psLevel->nLines >= psLevel->nChunkYSize
+                || ( psLevel->nLines > 0
+                     && psLevel->nLinesYOff + psLevel->nLines == nHeight ) ) )
+    {
+        int nChunkYSize = MIN( psLevel->nLines, psLevel->nChunkYSize );
+        GDALOvrDownsampleJob sJob;
+
+        GDALOvrDownsampleJobInit( &sJob,
+                                  ( psLevel->eWrkDataType == GDT_Byte ||
+                                    psLevel->eWrkDataType == GDT_Float32 ) ?
+                                        psLevel->pfnDownsampleFn : NULL,
+                                  nWidth, nHeight,
+                                  psLevel->eWrkDataType,
+                                  psLevel->pLines, NULL,
+                                  0, nWidth,
+                                  psLevel->nLinesYOff, nChunkYSize,
+                                  psLevel->poOverview, psLevel->pszResampling,
+                                  psLevel->bHasNoData, psLevel->fNoDataValue,
+                                  psLevel->poColorTable, eBandDataType );
+        GDALOvrDownsampleJobRun( &sJob );
+        eErr = GDALOvrDownsampleJobWrite( &sJob, pasLevels + 1, nLevels - 1 );
+
+        psLevel->nLines -= nChunkYSize;
+        psLevel->nLinesYOff += nChunkYSize;
+        if( psLevel->nLines > 0 )
+            memmove( psLevel->pLines,
+                     ((GByte *) psLevel->pLines)
+                        + (size_t) nChunkYSize * nWidth * nWrkPixelSize,
+                     (size_t) psLevel->nLines * nWidth * nWrkPixelSize );
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                      GDALOvrCreateThreadPool()                       */
+/*                                                                      */
+/*      Start the worker threads requested with the GDAL_NUM_THREADS    */
+/*      configuration option, and compute how many source chunks to     */
+/*      process per batch.  Returns NULL if no thread is requested.     */
+/************************************************************************/
+
+#define OVR_MAX_BATCH_MEMORY (64 * 1024 * 1024)
+
+static CPLWorkerThreadPool *GDALOvrCreateThreadPool( double dfChunkBytes,
+                                                     int *pnChunksPerBatch )
+
+{
+    *pnChunksPerBatch = 1;
+
+    const char* pszValue = CPLGetConfigOption( "GDAL_NUM_THREADS", "1" );
+    int nThreads;
+    if( EQUAL(pszValue, "ALL_CPUS") )
+        nThreads = CPLGetNumCPUs();
+    else
+        nThreads = atoi( pszValue );
+    if( nThreads > 128 )
+        nThreads = 128;
+    if( nThreads <= 1 )
+        return NULL;
+
+    CPLWorkerThreadPool *poThreadPool = new CPLWorkerThreadPool();
+    if( !poThreadPool->Setup( nThreads ) )
+    {
+        delete poThreadPool;
+        return NULL;
+    }
+
+    /* One chunk per thread, while the previous batch is being written */
+    /* and the next one is read, but keep the chunk buffers reasonable. */
+    int nChunksPerBatch = nThreads;
+    while( nChunksPerBatch > 1 &&
+           2 * nChunksPerBatch * dfChunkBytes > OVR_MAX_BATCH_MEMORY )
+        nChunksPerBatch--;
+
+    CPLDebug( "GDAL", "Using %d threads for overview computation, "
+              "%d chunks per batch.", nThreads, nChunksPerBatch );
+
+    *pnChunksPerBatch = nChunksPerBatch;
+    return poThreadPool;
+}
+
+/************************************************************************/
+/*                        GDALGetOvrColorTable()                        */
+/*                                                                      */
+/*      Return the color table to average the palette entries of a      */
+/*      band with, or NULL if the band values must be used as is.       */
+/************************************************************************/
+
+static GDALColorTable *GDALGetOvrColorTable( GDALRasterBand *poSrcBand,
+                                             const char *pszResampling )
+
+{
+    GDALColorTable* poColorTable = NULL;
+
     if ((EQUALN(pszResampling,"AVER",4)
          || EQUALN(pszResampling,"MODE",4)
          || EQUALN(pszResampling,"GAUSS",5)) &&
@@ -1596,6 +2185,52 @@ GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
         }
     }
 
+    return poColorTable;
+}
+
+static CPLErr
+GDALRegenerateSinglePassOverviews( 
+    GDALRasterBand *poSrcBand, int nOverviews, GDALRasterBand **papoOvrBands, 
+    const char * pszResampling, 
+    GDALProgressFunc pfnProgress, void * pProgressData );
+
+/************************************************************************/
+/*                  GDALRegenerateOverviewsInternal()                   */
+/*                                                                      */
+/*      Implementation of GDALRegenerateOverviews().  If pasLevels is   */
+/*      not NULL, there must be a single overview, and its lines are    */
+/*      pushed to the next levels of the pyramid as they are written.   */
+/************************************************************************/
+
+static CPLErr
+GDALRegenerateOverviewsInternal( GDALRasterBand *poSrcBand,
+                                 int nOverviewCount,
+                                 GDALRasterBand **papoOvrBands,
+                                 const char * pszResampling,
+                                 GDALProgressFunc pfnProgress,
+                                 void * pProgressData,
+                                 GDALOvrPyramidLevel *pasLevels,
+                                 int nLevels )
+
+{
+    int    nFullResYChunk, nWidth;
+    int    nFRXBlockSize, nFRYBlockSize;
+    GDALDataType eType;
+    int    bHasNoData;
+    float  fNoDataValue;
+    GDALColorTable* poColorTable = NULL;
+
+    if( pfnProgress == NULL )
+        pfnProgress = GDALDummyProgress;
+
+    if( EQUAL(pszResampling,"NONE") )
+        return CE_None;
+
+    GDALDownsampleFunction pfnDownsampleFn = GDALGetDownsampleFunction(pszResampling);
+    if (pfnDownsampleFn == NULL)
+        return CE_Failure;
+
+    poColorTable = GDALGetOvrColorTable( poSrcBand, pszResampling );
 
     /* If we have a nodata mask and we are doing something more complicated */
     /* than nearest neighbouring, we have to fetch to nodata mask */ 
@@ -1613,18 +2248,28 @@ GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
     /* of the band used for the mask band may not have yet occured (#3033) */
     if( (EQUALN(pszResampling,"AVER",4) || EQUALN(pszResampling,"GAUSS",5)) && nOverviewCount > 1
          && !(bUseNoDataMask && poSrcBand->GetMaskFlags() != GMF_NODATA))
+    {
+        /* Unless the lines must be post-processed once written (AVERAGE_MP) */
+        /* or masked, stream the base band only once for all the levels. */
+        if( !bUseNoDataMask && !EQUAL(pszResampling,"AVERAGE_MP") )
+            return GDALRegenerateSinglePassOverviews( poSrcBand, 
+                                                      nOverviewCount, papoOvrBands,
+                                                      pszResampling, 
+                                                      pfnProgress,
+                                                      pProgressData );
+
         return GDALRegenerateCascadingOverviews( poSrcBand, 
                                                  nOverviewCount, papoOvrBands,
                                                  pszResampling, 
                                                  pfnProgress,
                                                  pProgressData );
+    }
 
 /* -------------------------------------------------------------------- */
-/*      Setup one horizontal swath to read from the raw buffer.         */
+/*      Setup horizontal swaths to read from the raw buffer.  With      */
+/*      worker threads, two batches of swaths are used: one being       */
+/*      downsampled while the other one is read and written.            */
 /* -------------------------------------------------------------------- */
-    void *pChunk;
-    GByte *pabyChunkNodataMask = NULL;
-
     poSrcBand->GetBlockSize( &nFRXBlockSize, &nFRYBlockSize );
     
     if( nFRYBlockSize < 16 || nFRYBlockSize > 256 )
@@ -1638,133 +2283,206 @@ GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
         eType = GDALGetOvrWorkDataType(pszResampling, poSrcBand->GetRasterDataType());
 
     nWidth = poSrcBand->GetXSize();
-    pChunk = 
-        VSIMalloc3((GDALGetDataTypeSize(eType)/8), nFullResYChunk, nWidth );
-    if (bUseNoDataMask)
-    {
-        pabyChunkNodataMask = (GByte *) 
-            (GByte*) VSIMalloc2( nFullResYChunk, nWidth );
-    }
 
-    if( pChunk == NULL || (bUseNoDataMask && pabyChunkNodataMask == NULL))
+    int nChunksPerBatch = 1;
+    CPLWorkerThreadPool *poThreadPool =
+        GDALOvrCreateThreadPool( (double)(GDALGetDataTypeSize(eType)/8 + 1)
+                                 * nFullResYChunk * nWidth, &nChunksPerBatch );
+    int nSlots = (poThreadPool != NULL) ? 2 * nChunksPerBatch : 1;
+
+    void **papChunks = (void **) CPLCalloc(nSlots, sizeof(void*));
+    GByte **papabyChunkNodataMask = (GByte **) CPLCalloc(nSlots, sizeof(GByte*));
+    GDALOvrDownsampleJob *pasJobs = (GDALOvrDownsampleJob *)
+        CPLCalloc(nSlots * nOverviewCount, sizeof(GDALOvrDownsampleJob));
+    int iSlot;
+    CPLErr eErr = CE_None;
+
+    for( iSlot = 0; iSlot < nSlots && eErr == CE_None; iSlot++ )
     {
-        CPLFree(pChunk);
-        CPLFree(pabyChunkNodataMask);
-        CPLError( CE_Failure, CPLE_OutOfMemory, 
-                  "Out of memory in GDALRegenerateOverviews()." );
+        papChunks[iSlot] =
+            VSIMalloc3((GDALGetDataTypeSize(eType)/8), nFullResYChunk, nWidth );
+        if (bUseNoDataMask)
+        {
+            papabyChunkNodataMask[iSlot] = (GByte *) 
+                (GByte*) VSIMalloc2( nFullResYChunk, nWidth );
+        }
 
-        return CE_Failure;
+        if( papChunks[iSlot] == NULL ||
+            (bUseNoDataMask && papabyChunkNodataMask[iSlot] == NULL))
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory, 
+                      "Out of memory in GDALRegenerateOverviews()." );
+            eErr = CE_Failure;
+        }
     }
 
     fNoDataValue = (float) poSrcBand->GetNoDataValue(&bHasNoData);
 
 /* -------------------------------------------------------------------- */
-/*      Loop over image operating on chunks.                            */
+/*      Loop over image operating on batches of chunks.                 */
 /* -------------------------------------------------------------------- */
     int  nChunkYOff = 0;
-    CPLErr eErr = CE_None;
+    int  iBatch = 0;
+    int  nPrevChunks = 0;
 
-    for( nChunkYOff = 0; 
-         nChunkYOff < poSrcBand->GetYSize() && eErr == CE_None; 
-         nChunkYOff += nFullResYChunk )
+    while( eErr == CE_None )
     {
-        if( !pfnProgress( nChunkYOff / (double) poSrcBand->GetYSize(), 
-                          NULL, pProgressData ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        int iFirstSlot = (poThreadPool != NULL) ? (iBatch % 2) * nChunksPerBatch : 0;
+        int nChunks = 0;
 
-        if( nFullResYChunk + nChunkYOff > poSrcBand->GetYSize() )
-            nFullResYChunk = poSrcBand->GetYSize() - nChunkYOff;
-        
-        /* read chunk */
-        if (eErr == CE_None)
-            eErr = poSrcBand->RasterIO( GF_Read, 0, nChunkYOff, nWidth, nFullResYChunk, 
-                                pChunk, nWidth, nFullResYChunk, eType,
-                                0, 0 );
-        if (eErr == CE_None && bUseNoDataMask)
-            eErr = poSrcBand->GetMaskBand()->RasterIO( GF_Read, 0, nChunkYOff, nWidth, nFullResYChunk, 
-                                pabyChunkNodataMask, nWidth, nFullResYChunk, GDT_Byte,
-                                0, 0 );
-
-        /* special case to promote 1bit data to 8bit 0/255 values */
-        if( EQUAL(pszResampling,"AVERAGE_BIT2GRAYSCALE") )
+        for( ; nChunks < nChunksPerBatch
+               && nChunkYOff < poSrcBand->GetYSize() && eErr == CE_None;
+             nChunks++, nChunkYOff += nFullResYChunk )
         {
-            int i;
+            void *pChunk = papChunks[iFirstSlot + nChunks];
+            GByte *pabyChunkNodataMask = papabyChunkNodataMask[iFirstSlot + nChunks];
 
-            if (eType == GDT_Float32)
+            if( !pfnProgress( nChunkYOff / (double) poSrcBand->GetYSize(), 
+                              NULL, pProgressData ) )
+            {
+                CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+                eErr = CE_Failure;
+            }
+
+            if( nFullResYChunk + nChunkYOff > poSrcBand->GetYSize() )
+                nFullResYChunk = poSrcBand->GetYSize() - nChunkYOff;
+        
+            /* read chunk */
+            if (eErr == CE_None)
+                eErr = poSrcBand->RasterIO( GF_Read, 0, nChunkYOff, nWidth, nFullResYChunk, 
+                                    pChunk, nWidth, nFullResYChunk, eType,
+                                    0, 0 );
+            if (eErr == CE_None && bUseNoDataMask)
+                eErr = poSrcBand->GetMaskBand()->RasterIO( GF_Read, 0, nChunkYOff, nWidth, nFullResYChunk, 
+                                    pabyChunkNodataMask, nWidth, nFullResYChunk, GDT_Byte,
+                                    0, 0 );
+
+            /* special case to promote 1bit data to 8bit 0/255 values */
+            if( EQUAL(pszResampling,"AVERAGE_BIT2GRAYSCALE") )
             {
-                float* pafChunk = (float*)pChunk;
-                for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
+                int i;
+
+                if (eType == GDT_Float32)
                 {
-                    if( pafChunk[i] == 1.0 )
-                        pafChunk[i] = 255.0;
+                    float* pafChunk = (float*)pChunk;
+                    for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
+                    {
+                        if( pafChunk[i] == 1.0 )
+                            pafChunk[i] = 255.0;
+                    }
                 }
+                else if (eType == GDT_Byte)
+                {
+                    GByte* pabyChunk = (GByte*)pChunk;
+                    for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
+                    {
+                        if( pabyChunk[i] == 1 )
+                            pabyChunk[i] = 255;
+                    }
+                }
+                else
+                    CPLAssert(0);
             }
-            else if (eType == GDT_Byte)
+            else if( EQUAL(pszResampling,"AVERAGE_BIT2GRAYSCALE_MINISWHITE") )
             {
-                GByte* pabyChunk = (GByte*)pChunk;
-                for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
+                int i;
+
+                if (eType == GDT_Float32)
+                {
+                    float* pafChunk = (float*)pChunk;
+                    for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
+                    {
+                        if( pafChunk[i] == 1.0 )
+                            pafChunk[i] = 0.0;
+                        else if( pafChunk[i] == 0.0 )
+                            pafChunk[i] = 255.0;
+                    }
+                }
+                else if (eType == GDT_Byte)
                 {
-                    if( pabyChunk[i] == 1 )
-                        pabyChunk[i] = 255;
+                    GByte* pabyChunk = (GByte*)pChunk;
+                    for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
+                    {
+                        if( pabyChunk[i] == 1 )
+                            pabyChunk[i] = 0;
+                        else if( pabyChunk[i] == 0 )
+                            pabyChunk[i] = 255;
+                    }
                 }
+                else
+                    CPLAssert(0);
             }
-            else
-                CPLAssert(0);
-        }
-        else if( EQUAL(pszResampling,"AVERAGE_BIT2GRAYSCALE_MINISWHITE") )
-        {
-            int i;
 
-            if (eType == GDT_Float32)
+            for( int iOverview = 0; iOverview < nOverviewCount; iOverview++ )
             {
-                float* pafChunk = (float*)pChunk;
-                for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
-                {
-                    if( pafChunk[i] == 1.0 )
-                        pafChunk[i] = 0.0;
-                    else if( pafChunk[i] == 0.0 )
-                        pafChunk[i] = 255.0;
-                }
+                GDALOvrDownsampleJobInit( pasJobs + (iFirstSlot + nChunks) * nOverviewCount + iOverview,
+                                          ( eType == GDT_Byte || eType == GDT_Float32 ) ?
+                                                pfnDownsampleFn : NULL,
+                                          nWidth, poSrcBand->GetYSize(),
+                                          eType,
+                                          pChunk,
+                                          pabyChunkNodataMask,
+                                          0, nWidth,
+                                          nChunkYOff, nFullResYChunk,
+                                          papoOvrBands[iOverview], pszResampling,
+                                          bHasNoData, fNoDataValue, poColorTable,
+                                          poSrcBand->GetRasterDataType() );
             }
-            else if (eType == GDT_Byte)
+        }
+
+        if( eErr != CE_None )
+            break;
+
+        if( poThreadPool == NULL )
+        {
+            /* Downsample and write the chunk in the calling thread */
+            for( int iJob = 0; iJob < nChunks * nOverviewCount && eErr == CE_None; iJob++ )
             {
-                GByte* pabyChunk = (GByte*)pChunk;
-                for( i = nFullResYChunk*nWidth - 1; i >= 0; i-- )
-                {
-                    if( pabyChunk[i] == 1 )
-                        pabyChunk[i] = 0;
-                    else if( pabyChunk[i] == 0 )
-                        pabyChunk[i] = 255;
-                }
+                GDALOvrDownsampleJobRun( pasJobs + iJob );
+                eErr = GDALOvrDownsampleJobWrite( pasJobs + iJob,
+                                                  pasLevels, nLevels );
             }
-            else
-                CPLAssert(0);
         }
-        
-        for( int iOverview = 0; iOverview < nOverviewCount && eErr == CE_None; iOverview++ )
+        else
         {
-            if( eType == GDT_Byte || eType == GDT_Float32 )
-                eErr = pfnDownsampleFn(nWidth, poSrcBand->GetYSize(),
-                                              eType,
-                                              pChunk,
-                                              pabyChunkNodataMask,
-                                              0, nWidth,
-                                              nChunkYOff, nFullResYChunk,
-                                              papoOvrBands[iOverview], pszResampling,
-                                              bHasNoData, fNoDataValue, poColorTable,
-                                              poSrcBand->GetRasterDataType());
-            else
-                eErr = GDALDownsampleChunkC32R(nWidth, poSrcBand->GetYSize(), 
-                                               (float*)pChunk, nChunkYOff, nFullResYChunk,
-                                               papoOvrBands[iOverview], pszResampling);
+            /* Wait for the previous batch, queue the new one, and write */
+            /* the results of the previous batch while it is processed. */
+            poThreadPool->WaitCompletion();
+
+            for( int iJob = 0; iJob < nChunks * nOverviewCount; iJob++ )
+                poThreadPool->SubmitJob( GDALOvrDownsampleJobRun,
+                                         pasJobs + iFirstSlot * nOverviewCount + iJob );
+
+            int iPrevFirstSlot = ((iBatch + 1) % 2) * nChunksPerBatch;
+            for( int iJob = 0; iJob < nPrevChunks * nOverviewCount && eErr == CE_None; iJob++ )
+                eErr = GDALOvrDownsampleJobWrite(
+                            pasJobs + iPrevFirstSlot * nOverviewCount + iJob,
+                            pasLevels, nLevels );
         }
+
+        if( nChunks == 0 )
+            break;
+
+        nPrevChunks = nChunks;
+        iBatch++;
     }
 
-    VSIFree( pChunk );
-    VSIFree( pabyChunkNodataMask );
+    if( poThreadPool != NULL )
+    {
+        poThreadPool->WaitCompletion();
+        delete poThreadPool;
+    }
+
+    for( iSlot = 0; iSlot < nSlots; iSlot++ )
+    {
+        VSIFree( papChunks[iSlot] );
+        VSIFree( papabyChunkNodataMask[iSlot] );
+    }
+    for( int iJob = 0; iJob < nSlots * nOverviewCount; iJob++ )
+        VSIFree( pasJobs[iJob].pDstBuffer );
+    CPLFree( papChunks );
+    CPLFree( papabyChunkNodataMask );
+    CPLFree( pasJobs );
     
 /* -------------------------------------------------------------------- */
 /*      Renormalized overview mean / stddev if needed.                  */
@@ -1795,6 +2513,163 @@ GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
 
 
 
+
+/************************************************************************/
+/*                      GDALRegenerateOverviews()                       */
+/************************************************************************/
+
+/**
+ * \brief Generate downsampled overviews.
+ *
+ * This function will generate one or more overview images from a base
+ * image using the requested downsampling algorithm.  It's primary use
+ * is for generating overviews via GDALDataset::BuildOverviews(), but it
+ * can also be used to generate downsampled images in one file from another
+ * outside the overview architecture.
+ *
+ * The output bands need to exist in advance. 
+ *
+ * The full set of resampling algorithms is documented in 
+ * GDALDataset::BuildOverviews().
+ *
+ * This function will honour properly NODATA_VALUES tuples (special dataset metadata) so
+ * that only a given RGB triplet (in case of a RGB image) will be considered as the
+ * nodata value and not each value of the triplet independantly per band.
+ *
+ * Starting with GDAL 1.9.0, the GDAL_NUM_THREADS configuration option can be
+ * set to a number of threads, or ALL_CPUS, to downsample chunks of the source
+ * in worker threads, while the calling thread reads the next chunks and writes
+ * the completed ones.  The result is the same as without worker threads.
+ *
+ * When several overviews are generated with the AVERAGE or GAUSS methods, each
+ * one is computed from the next larger one.  Unless a mask is involved or
+ * the AVERAGE_MP method is used, this is done in a single pass over the
+ * source band, keeping the lines of each overview in memory until the next
+ * smaller one has been computed from them, rather than reading them back.
+ *
+ * @param hSrcBand the source (base level) band. 
+ * @param nOverviewCount the number of downsampled bands being generated.
+ * @param pahOvrBands the list of downsampled bands to be generated.
+ * @param pszResampling Resampling algorithm (eg. "AVERAGE"). 
+ * @param pfnProgress progress report function.
+ * @param pProgressData progress function callback data.
+ * @return CE_None on success or CE_Failure on failure.
+ */
+CPLErr 
+GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
+                         int nOverviewCount, GDALRasterBandH *pahOvrBands, 
+                         const char * pszResampling, 
+                         GDALProgressFunc pfnProgress, void * pProgressData )
+
+{
+    return GDALRegenerateOverviewsInternal( (GDALRasterBand *) hSrcBand,
+                                            nOverviewCount,
+                                            (GDALRasterBand **) pahOvrBands,
+                                            pszResampling,
+                                            pfnProgress, pProgressData,
+                                            NULL, 0 );
+}
+
+/************************************************************************/
+/*                  GDALRegenerateSinglePassOverviews()                 */
+/*                                                                      */
+/*      Same result as GDALRegenerateCascadingOverviews(), but the      */
+/*      base band is read once, and each overview is computed from      */
+/*      the lines of the next larger one kept in memory, instead of     */
+/*      being read back from disk.                                      */
+/************************************************************************/
+
+static CPLErr
+GDALRegenerateSinglePassOverviews( 
+    GDALRasterBand *poSrcBand, int nOverviews, GDALRasterBand **papoOvrBands, 
+    const char * pszResampling, 
+    GDALProgressFunc pfnProgress, void * pProgressData )
+
+{
+    int   i;
+
+    GDALSortOverviewsBySize( nOverviews, papoOvrBands );
+
+/* -------------------------------------------------------------------- */
+/*      Computing an overview from a masked one requires its mask,      */
+/*      that is only available once it is written.                      */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < nOverviews - 1; i++ )
+    {
+        if( (papoOvrBands[i]->GetMaskFlags() & GMF_ALL_VALID) == 0 )
+            return GDALRegenerateCascadingOverviews( poSrcBand, 
+                                                     nOverviews, papoOvrBands,
+                                                     pszResampling, 
+                                                     pfnProgress,
+                                                     pProgressData );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Setup the levels computed from the lines of the overviews.      */
+/* -------------------------------------------------------------------- */
+    int nLevels = nOverviews - 1;
+    GDALOvrPyramidLevel *pasLevels = (GDALOvrPyramidLevel *)
+        CPLCalloc( nLevels, sizeof(GDALOvrPyramidLevel) );
+
+    /* we only do the bit2grayscale promotion on the base band */
+    const char *pszLevelResampling = pszResampling;
+    if( EQUALN(pszResampling,"AVERAGE_BIT2GRAYSCALE",13) )
+        pszLevelResampling = "AVERAGE";
+
+    for( i = 0; i < nLevels; i++ )
+    {
+        GDALOvrPyramidLevel *psLevel = pasLevels + i;
+        GDALRasterBand *poLevelSrcBand = papoOvrBands[i];
+        int nBlockXSize, nBlockYSize;
+
+        psLevel->poSrcBand = poLevelSrcBand;
+        psLevel->poOverview = papoOvrBands[i+1];
+        psLevel->pfnDownsampleFn = GDALGetDownsampleFunction(pszLevelResampling);
+        psLevel->pszResampling = pszLevelResampling;
+
+        if( GDALDataTypeIsComplex( poLevelSrcBand->GetRasterDataType() ) )
+            psLevel->eWrkDataType = GDT_CFloat32;
+        else
+            psLevel->eWrkDataType =
+                GDALGetOvrWorkDataType( pszLevelResampling,
+                                        poLevelSrcBand->GetRasterDataType() );
+
+        psLevel->fNoDataValue = (float)
+            poLevelSrcBand->GetNoDataValue( &psLevel->bHasNoData );
+        psLevel->poColorTable =
+            GDALGetOvrColorTable( poLevelSrcBand, pszLevelResampling );
+
+        poLevelSrcBand->GetBlockSize( &nBlockXSize, &nBlockYSize );
+        if( nBlockYSize < 16 || nBlockYSize > 256 )
+            psLevel->nChunkYSize = 64;
+        else
+            psLevel->nChunkYSize = nBlockYSize;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Generate the largest overview from the base band, that feeds    */
+/*      all the others.                                                 */
+/* -------------------------------------------------------------------- */
+    CPLErr eErr = GDALRegenerateOverviewsInternal( poSrcBand,
+                                                   1, papoOvrBands,
+                                                   pszResampling,
+                                                   pfnProgress, pProgressData,
+                                                   pasLevels, nLevels );
+
+    for( i = 0; i < nLevels; i++ )
+    {
+        CPLAssert( eErr != CE_None || 
+                   pasLevels[i].nLinesYOff == pasLevels[i].poSrcBand->GetYSize() );
+        VSIFree( pasLevels[i].pLines );
+    }
+    CPLFree( pasLevels );
+
+    for( i = 1; eErr == CE_None && i < nOverviews; i++ )
+        eErr = papoOvrBands[i]->FlushCache();
+
+    return eErr;
+}
+
 /************************************************************************/
 /*            GDALRegenerateOverviewsMultiBand()                        */
 /************************************************************************/
@@ -1826,6 +2701,10 @@ GDALRegenerateOverviews( GDALRasterBandH hSrcBand,
  * that only a given RGB triplet (in case of a RGB image) will be considered as the
  * nodata value and not each value of the triplet independantly per band.
  *
+ * Starting with GDAL 1.9.0, the bands of several chunks are downsampled in
+ * worker threads if the GDAL_NUM_THREADS configuration option is set, as in
+ * GDALRegenerateOverviews().
+ *
  * @param nBands the number of bands, size of papoSrcBands and size of
  *               first dimension of papapoOverviewBands
  * @param papoSrcBands the list of source bands to downsample
@@ -1972,69 +2851,75 @@ GDALRegenerateOverviewsMultiBand(int nBands, GDALRasterBand** papoSrcBands,
         int nFullResXChunk = (nDstBlockXSize * nSrcWidth) / nDstWidth;
         int nFullResYChunk = (nDstBlockYSize * nSrcHeight) / nDstHeight;
 
-        void** papaChunk = (void**) CPLMalloc(nBands * sizeof(void*));
-        GByte* pabyChunkNoDataMask = NULL;
-        for(iBand=0;iBand<nBands;iBand++)
+        /* With worker threads, two batches of chunks are used: one being */
+        /* downsampled while the other one is read and written. */
+        int nChunksPerBatch = 1;
+        CPLWorkerThreadPool *poThreadPool =
+            GDALOvrCreateThreadPool( (double)(nBands * (GDALGetDataTypeSize(eWrkDataType) / 8) + 1)
+                                     * nFullResXChunk * nFullResYChunk,
+                                     &nChunksPerBatch );
+        int nSlots = (poThreadPool != NULL) ? 2 * nChunksPerBatch : 1;
+        int iSlot;
+
+        void** papaChunk = (void**) CPLCalloc(nSlots * nBands, sizeof(void*));
+        GByte** papabyChunkNoDataMask = (GByte**) CPLCalloc(nSlots, sizeof(GByte*));
+        GDALOvrDownsampleJob* pasJobs = (GDALOvrDownsampleJob*)
+            CPLCalloc(nSlots * nBands, sizeof(GDALOvrDownsampleJob));
+        for(iSlot=0;iSlot<nSlots && eErr == CE_None;iSlot++)
         {
-            papaChunk[iBand] = VSIMalloc3(nFullResXChunk, nFullResYChunk, GDALGetDataTypeSize(eWrkDataType) / 8);
-            if( papaChunk[iBand] == NULL )
+            for(iBand=0;iBand<nBands && eErr == CE_None;iBand++)
             {
-                while ( --iBand >= 0)
-                    CPLFree(papaChunk[iBand]);
-                CPLFree(papaChunk);
-                CPLFree(pabHasNoData);
-                CPLFree(pafNoDataValue);
-
-                CPLError( CE_Failure, CPLE_OutOfMemory,
-                        "GDALRegenerateOverviewsMultiBand: Out of memory." );
-                return CE_Failure;
+                papaChunk[iSlot * nBands + iBand] = VSIMalloc3(nFullResXChunk, nFullResYChunk, GDALGetDataTypeSize(eWrkDataType) / 8);
+                if( papaChunk[iSlot * nBands + iBand] == NULL )
+                    eErr = CE_Failure;
             }
-        }
-        if (bUseNoDataMask)
-        {
-            pabyChunkNoDataMask = (GByte*) VSIMalloc2(nFullResXChunk, nFullResYChunk);
-            if( pabyChunkNoDataMask == NULL )
+            if (bUseNoDataMask && eErr == CE_None)
             {
-                for(iBand=0;iBand<nBands;iBand++)
-                {
-                    CPLFree(papaChunk[iBand]);
-                }
-                CPLFree(papaChunk);
-                CPLFree(pabHasNoData);
-                CPLFree(pafNoDataValue);
-
-                CPLError( CE_Failure, CPLE_OutOfMemory,
-                        "GDALRegenerateOverviewsMultiBand: Out of memory." );
-                return CE_Failure;
+                papabyChunkNoDataMask[iSlot] = (GByte*) VSIMalloc2(nFullResXChunk, nFullResYChunk);
+                if( papabyChunkNoDataMask[iSlot] == NULL )
+                    eErr = CE_Failure;
             }
         }
+        if( eErr != CE_None )
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory,
+                    "GDALRegenerateOverviewsMultiBand: Out of memory." );
+        }
+
+        int nChunkXOff = 0, nChunkYOff = 0;
+        int iBatch = 0, nPrevChunks = 0;
 
-        int nChunkYOff;
         /* Iterate on destination overview, block by block */
-        for( nChunkYOff = 0; nChunkYOff < nSrcHeight && eErr == CE_None; nChunkYOff += nFullResYChunk )
+        while( eErr == CE_None )
         {
-            int nYCount;
-            if  (nChunkYOff + nFullResYChunk <= nSrcHeight)
-                nYCount = nFullResYChunk;
-            else
-                nYCount = nSrcHeight - nChunkYOff;
+            int iFirstSlot = (poThreadPool != NULL) ? (iBatch % 2) * nChunksPerBatch : 0;
+            int nChunks = 0;
 
-            if( !pfnProgress( dfCurPixelCount / dfTotalPixelCount, 
-                              NULL, pProgressData ) )
+            for( ; nChunks < nChunksPerBatch && nChunkYOff < nSrcHeight && eErr == CE_None;
+                 nChunks++ )
             {
-                CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-                eErr = CE_Failure;
-            }
+                int nYCount;
+                if  (nChunkYOff + nFullResYChunk <= nSrcHeight)
+                    nYCount = nFullResYChunk;
+                else
+                    nYCount = nSrcHeight - nChunkYOff;
+
+                if( nChunkXOff == 0 &&
+                    !pfnProgress( dfCurPixelCount / dfTotalPixelCount, 
+                                  NULL, pProgressData ) )
+                {
+                    CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+                    eErr = CE_Failure;
+                }
 
-            int nChunkXOff;
-            for( nChunkXOff = 0; nChunkXOff < nSrcWidth && eErr == CE_None; nChunkXOff += nFullResXChunk )
-            {
                 int nXCount;
                 if  (nChunkXOff + nFullResXChunk <= nSrcWidth)
                     nXCount = nFullResXChunk;
                 else
                     nXCount = nSrcWidth - nChunkXOff;
 
+                iSlot = iFirstSlot + nChunks;
+
                 /* Read the source buffers for all the bands */
                 for(iBand=0;iBand<nBands && eErr == CE_None;iBand++)
                 {
@@ -2046,7 +2931,7 @@ GDALRegenerateOverviewsMultiBand(int nBands, GDALRasterBand** papoSrcBands,
                     eErr = poSrcBand->RasterIO( GF_Read,
                                                 nChunkXOff, nChunkYOff,
                                                 nXCount, nYCount, 
-                                                papaChunk[iBand],
+                                                papaChunk[iSlot * nBands + iBand],
                                                 nXCount, nYCount,
                                                 eWrkDataType, 0, 0 );
                 }
@@ -2061,41 +2946,98 @@ GDALRegenerateOverviewsMultiBand(int nBands, GDALRasterBand** papoSrcBands,
                     eErr = poSrcBand->GetMaskBand()->RasterIO( GF_Read,
                                                                nChunkXOff, nChunkYOff,
                                                                nXCount, nYCount, 
-                                                               pabyChunkNoDataMask,
+                                                               papabyChunkNoDataMask[iSlot],
                                                                nXCount, nYCount,
                                                                GDT_Byte, 0, 0 );
                 }
 
-                /* Compute the resulting overview block */
-                for(iBand=0;iBand<nBands && eErr == CE_None;iBand++)
+                /* Prepare the computation of the resulting overview block */
+                for(iBand=0;iBand<nBands;iBand++)
+                {
+                    GDALOvrDownsampleJobInit( pasJobs + iSlot * nBands + iBand,
+                                              pfnDownsampleFn,
+                                              nSrcWidth, nSrcHeight,
+                                              eWrkDataType,
+                                              papaChunk[iSlot * nBands + iBand],
+                                              papabyChunkNoDataMask[iSlot],
+                                              nChunkXOff, nXCount,
+                                              nChunkYOff, nYCount,
+                                              papapoOverviewBands[iBand][iOverview],
+                                              pszResampling,
+                                              pabHasNoData[iBand],
+                                              pafNoDataValue[iBand],
+                                              /*poColorTable*/ NULL,
+                                              eDataType );
+                }
+
+                nChunkXOff += nFullResXChunk;
+                if( nChunkXOff >= nSrcWidth )
                 {
-                    eErr = pfnDownsampleFn(nSrcWidth, nSrcHeight,
-                                                  eWrkDataType,
-                                                  papaChunk[iBand],
-                                                  pabyChunkNoDataMask,
-                                                  nChunkXOff, nXCount,
-                                                  nChunkYOff, nYCount,
-                                                  papapoOverviewBands[iBand][iOverview],
-                                                  pszResampling,
-                                                  pabHasNoData[iBand],
-                                                  pafNoDataValue[iBand],
-                                                  /*poColorTable*/ NULL,
-                                                  eDataType);
+                    nChunkXOff = 0;
+                    nChunkYOff += nFullResYChunk;
+                    dfCurPixelCount += (double)nYCount * nSrcWidth;
                 }
             }
 
-            dfCurPixelCount += (double)nYCount * nSrcWidth;
+            if( eErr != CE_None )
+                break;
+
+            if( poThreadPool == NULL )
+            {
+                /* Compute and write the resulting overview block */
+                for(int iJob=0;iJob<nChunks * nBands && eErr == CE_None;iJob++)
+                {
+                    GDALOvrDownsampleJobRun( pasJobs + iJob );
+                    eErr = GDALOvrDownsampleJobWrite( pasJobs + iJob, NULL, 0 );
+                }
+            }
+            else
+            {
+                /* Wait for the previous batch, queue the new one, and write */
+                /* the results of the previous batch while it is processed. */
+                poThreadPool->WaitCompletion();
+
+                for(int iJob=0;iJob<nChunks * nBands;iJob++)
+                    poThreadPool->SubmitJob( GDALOvrDownsampleJobRun,
+                                             pasJobs + iFirstSlot * nBands + iJob );
+
+                int iPrevFirstSlot = ((iBatch + 1) % 2) * nChunksPerBatch;
+                for(int iJob=0;iJob<nPrevChunks * nBands && eErr == CE_None;iJob++)
+                    eErr = GDALOvrDownsampleJobWrite(
+                                pasJobs + iPrevFirstSlot * nBands + iJob,
+                                NULL, 0 );
+            }
+
+            if( nChunks == 0 )
+                break;
+
+            nPrevChunks = nChunks;
+            iBatch++;
+        }
+
+        if( poThreadPool != NULL )
+        {
+            poThreadPool->WaitCompletion();
+            delete poThreadPool;
         }
 
         /* Flush the data to overviews */
         for(iBand=0;iBand<nBands;iBand++)
         {
-            CPLFree(papaChunk[iBand]);
             papapoOverviewBands[iBand][iOverview]->FlushCache();
         }
+        for(iSlot=0;iSlot<nSlots;iSlot++)
+        {
+            for(iBand=0;iBand<nBands;iBand++)
+            {
+                CPLFree(papaChunk[iSlot * nBands + iBand]);
+                CPLFree(pasJobs[iSlot * nBands + iBand].pDstBuffer);
+            }
+            CPLFree(papabyChunkNoDataMask[iSlot]);
+        }
         CPLFree(papaChunk);
-        CPLFree(pabyChunkNoDataMask);
-
+        CPLFree(papabyChunkNoDataMask);
+        CPLFree(pasJobs);
     }
 
     CPLFree(pabHasNoData);
@@ -46,6 +46,12 @@
 #define USE_NEW_COPYWORDS 1
 #endif
 
+// The SSE2 conversions are only available with the templated
+// GDALCopyWords implementation.
+#ifdef USE_NEW_COPYWORDS
+#include "gdalsse_priv.h"
+#endif
+
 
 CPL_CVSID("$Id$");
 
@@ -169,6 +175,17 @@ CPLErr GDALRasterBand::IRasterIO( GDALRWFlag eRWFlag,
         return CE_None;
     }
     
+/* ==================================================================== */
+/*      Resample the window with a real filter if requested.            */
+/* ==================================================================== */
+    const char *pszResampling = 
+        GDALGetRasterIOResampling( eRWFlag, eDataType, nXSize, nYSize,
+                                   nBufXSize, nBufYSize );
+    if( pszResampling != NULL )
+        return RasterIOResampled( nXOff, nYOff, nXSize, nYSize,
+                                  pData, nBufXSize, nBufYSize, eBufType,
+                                  nPixelSpace, nLineSpace, pszResampling );
+
 /* ==================================================================== */
 /*      Do we have overviews that would be appropriate to satisfy       */
 /*      this request?                                                   */
@@ -500,6 +517,180 @@ CPLErr GDALRasterBand::IRasterIO( GDALRWFlag eRWFlag,
     return( CE_None );
 }
 
+/************************************************************************/
+/*                            GDALRIOWindowRef                          */
+/************************************************************************/
+
+typedef struct
+{
+    int     iWindow;
+    int     nBlockXOff;         /* first block of the window */
+    int     nBlockYOff;
+    int     bSingleBlock;       /* 1:1 window within this block */
+} GDALRIOWindowRef;
+
+static int GDALRIOWindowRefCompare( const void *a, const void *b )
+
+{
+    const GDALRIOWindowRef *psA = (const GDALRIOWindowRef *) a;
+    const GDALRIOWindowRef *psB = (const GDALRIOWindowRef *) b;
+
+    if( psA->nBlockYOff != psB->nBlockYOff )
+        return psA->nBlockYOff < psB->nBlockYOff ? -1 : 1;
+    if( psA->nBlockXOff != psB->nBlockXOff )
+        return psA->nBlockXOff < psB->nBlockXOff ? -1 : 1;
+    return psA->iWindow - psB->iWindow;
+}
+
+/************************************************************************/
+/*                           IRasterIOMulti()                           */
+/*                                                                      */
+/*      Default implementation of RasterIOMulti().  The windows are     */
+/*      read in the order of their first block, so that blocks are      */
+/*      fetched in file order and once, and the windows at full         */
+/*      resolution within a single block are copied from it while it    */
+/*      is locked, without going through IRasterIO().  Writes keep      */
+/*      the order of the windows, as they may overlap.                  */
+/************************************************************************/
+
+CPLErr GDALRasterBand::IRasterIOMulti( GDALRWFlag eRWFlag,
+                                       int nWindowCount,
+                                       GDALRasterIOWindow *pasWindows,
+                                       GDALDataType eBufType,
+                                       int nPixelSpace, int nLineSpace )
+
+{
+    int         nBandDataSize = GDALGetDataTypeSize( eDataType ) / 8;
+    int         iRef;
+
+    if( nPixelSpace == 0 )
+        nPixelSpace = GDALGetDataTypeSize( eBufType ) / 8;
+
+    GDALRIOWindowRef *pasRefs = (GDALRIOWindowRef *)
+        VSIMalloc2( nWindowCount, sizeof(GDALRIOWindowRef) );
+    if( pasRefs == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Out of memory in GDALRasterBand::IRasterIOMulti()." );
+        return CE_Failure;
+    }
+
+    for( iRef = 0; iRef < nWindowCount; iRef++ )
+    {
+        GDALRasterIOWindow *psWindow = pasWindows + iRef;
+        GDALRIOWindowRef   *psRef = pasRefs + iRef;
+
+        psRef->iWindow = iRef;
+        psRef->nBlockXOff = MAX(0, psWindow->nXOff) / nBlockXSize;
+        psRef->nBlockYOff = MAX(0, psWindow->nYOff) / nBlockYSize;
+        psRef->bSingleBlock =
+            psWindow->nXSize == psWindow->nBufXSize
+            && psWindow->nYSize == psWindow->nBufYSize
+            && psWindow->nXSize > 0 && psWindow->nYSize > 0
+            && (psWindow->nXOff + psWindow->nXSize - 1) / nBlockXSize
+                                                    == psRef->nBlockXOff
+            && (psWindow->nYOff + psWindow->nYSize - 1) / nBlockYSize
+                                                    == psRef->nBlockYOff;
+    }
+
+    if( eRWFlag == GF_Read )
+        qsort( pasRefs, nWindowCount, sizeof(GDALRIOWindowRef),
+               GDALRIOWindowRefCompare );
+
+/* -------------------------------------------------------------------- */
+/*      Process the windows.                                            */
+/* -------------------------------------------------------------------- */
+    GDALRasterBlock *poBlock = NULL;
+    CPLErr      eErr = CE_None;
+
+    for( iRef = 0; iRef < nWindowCount && eErr == CE_None; iRef++ )
+    {
+        GDALRIOWindowRef   *psRef = pasRefs + iRef;
+        GDALRasterIOWindow *psWindow = pasWindows + psRef->iWindow;
+
+        if( psWindow->nXSize < 1 || psWindow->nYSize < 1
+            || psWindow->nBufXSize < 1 || psWindow->nBufYSize < 1 )
+            continue;
+
+        int nWindowLineSpace = nLineSpace;
+        if( nWindowLineSpace == 0 )
+            nWindowLineSpace = nPixelSpace * psWindow->nBufXSize;
+
+        if( !psRef->bSingleBlock )
+        {
+            if( poBlock != NULL )
+            {
+                poBlock->DropLock();
+                poBlock = NULL;
+            }
+
+            eErr = IRasterIO( eRWFlag, psWindow->nXOff, psWindow->nYOff,
+                              psWindow->nXSize, psWindow->nYSize,
+                              psWindow->pData,
+                              psWindow->nBufXSize, psWindow->nBufYSize,
+                              eBufType, nPixelSpace, nWindowLineSpace );
+            continue;
+        }
+
+        if( poBlock == NULL
+            || poBlock->GetXOff() != psRef->nBlockXOff
+            || poBlock->GetYOff() != psRef->nBlockYOff )
+        {
+            if( poBlock != NULL )
+                poBlock->DropLock();
+
+            poBlock = GetLockedBlockRef( psRef->nBlockXOff, psRef->nBlockYOff );
+            if( poBlock == NULL )
+            {
+                CPLError( CE_Failure, CPLE_AppDefined,
+                          "GetBlockRef failed at X block offset %d, "
+                          "Y block offset %d",
+                          psRef->nBlockXOff, psRef->nBlockYOff );
+                eErr = CE_Failure;
+                break;
+            }
+
+            if( eRWFlag == GF_Write )
+                poBlock->MarkDirty();
+        }
+
+        GByte *pabyBlock = (GByte *) poBlock->GetDataRef();
+        if( pabyBlock == NULL )
+        {
+            eErr = CE_Failure;
+            break;
+        }
+
+        int nBlockXOff = psWindow->nXOff - psRef->nBlockXOff * nBlockXSize;
+        int nBlockYOff = psWindow->nYOff - psRef->nBlockYOff * nBlockYSize;
+
+        for( int iLine = 0; iLine < psWindow->nYSize; iLine++ )
+        {
+            GByte *pabyBlockLine = pabyBlock
+                + ((size_t)(nBlockYOff + iLine) * nBlockXSize + nBlockXOff)
+                                                            * nBandDataSize;
+            GByte *pabyBufLine = ((GByte *) psWindow->pData)
+                + (size_t) iLine * nWindowLineSpace;
+
+            if( eRWFlag == GF_Read )
+                GDALCopyWords( pabyBlockLine, eDataType, nBandDataSize,
+                               pabyBufLine, eBufType, nPixelSpace,
+                               psWindow->nXSize );
+            else
+                GDALCopyWords( pabyBufLine, eBufType, nPixelSpace,
+                               pabyBlockLine, eDataType, nBandDataSize,
+                               psWindow->nXSize );
+        }
+    }
+
+    if( poBlock != NULL )
+        poBlock->DropLock();
+
+    CPLFree( pasRefs );
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                           GDALSwapWords()                            */
 /************************************************************************/
@@ -834,9 +1025,9 @@ inline void CopyWord(const float fValueIn, unsigned int &nValueOut)
  */
 
 template <class Tin, class Tout>
-static void GDALCopyWordsT(const Tin* const pSrcData, int nSrcPixelOffset,
-                           Tout* const pDstData, int nDstPixelOffset,
-                           int nWordCount)
+static void GDALCopyWordsGenericT(const Tin* const pSrcData, int nSrcPixelOffset,
+                                  Tout* const pDstData, int nDstPixelOffset,
+                                  int nWordCount)
 {
     std::ptrdiff_t nDstOffset = 0;
 
@@ -853,6 +1044,223 @@ static void GDALCopyWordsT(const Tin* const pSrcData, int nSrcPixelOffset,
     }
 }
 
+template <class Tin, class Tout>
+static void GDALCopyWordsT(const Tin* const pSrcData, int nSrcPixelOffset,
+                           Tout* const pDstData, int nDstPixelOffset,
+                           int nWordCount)
+{
+    GDALCopyWordsGenericT(pSrcData, nSrcPixelOffset,
+                          pDstData, nDstPixelOffset, nWordCount);
+}
+
+#ifdef USE_SSE2
+
+/************************************************************************/
+/*                      GDALCopyWordsT() SSE2 paths                     */
+/************************************************************************/
+/*
+ * Specializations of GDALCopyWordsT for packed buffers (both offsets
+ * equal to the word size) of the most frequent conversions.  They round
+ * and clamp exactly like the CopyWord() overloads above.  Strided
+ * buffers and the last few words go through GDALCopyWordsGenericT.
+ */
+
+/* Load 8 integer words, widened to two vectors of 4 int32 */
+
+inline void GDALCopyLoad8SSE2(const unsigned char* pSrc,
+                              __m128i& xmmLo, __m128i& xmmHi)
+{
+    const __m128i xmmZero = _mm_setzero_si128();
+    __m128i xmm = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pSrc));
+    xmm = _mm_unpacklo_epi8(xmm, xmmZero);
+    xmmLo = _mm_unpacklo_epi16(xmm, xmmZero);
+    xmmHi = _mm_unpackhi_epi16(xmm, xmmZero);
+}
+
+inline void GDALCopyLoad8SSE2(const unsigned short* pSrc,
+                              __m128i& xmmLo, __m128i& xmmHi)
+{
+    const __m128i xmmZero = _mm_setzero_si128();
+    __m128i xmm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc));
+    xmmLo = _mm_unpacklo_epi16(xmm, xmmZero);
+    xmmHi = _mm_unpackhi_epi16(xmm, xmmZero);
+}
+
+inline void GDALCopyLoad8SSE2(const short* pSrc,
+                              __m128i& xmmLo, __m128i& xmmHi)
+{
+    __m128i xmm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc));
+    xmmLo = _mm_srai_epi32(_mm_unpacklo_epi16(xmm, xmm), 16);
+    xmmHi = _mm_srai_epi32(_mm_unpackhi_epi16(xmm, xmm), 16);
+}
+
+/* Store two vectors of 4 int32 as 8 real words */
+
+inline void GDALCopyStore8SSE2(float* pDst,
+                               const __m128i xmmLo, const __m128i xmmHi)
+{
+    _mm_storeu_ps(pDst, _mm_cvtepi32_ps(xmmLo));
+    _mm_storeu_ps(pDst + 4, _mm_cvtepi32_ps(xmmHi));
+}
+
+inline void GDALCopyStore8SSE2(double* pDst,
+                               const __m128i xmmLo, const __m128i xmmHi)
+{
+    _mm_storeu_pd(pDst, _mm_cvtepi32_pd(xmmLo));
+    _mm_storeu_pd(pDst + 2, _mm_cvtepi32_pd(_mm_srli_si128(xmmLo, 8)));
+    _mm_storeu_pd(pDst + 4, _mm_cvtepi32_pd(xmmHi));
+    _mm_storeu_pd(pDst + 6, _mm_cvtepi32_pd(_mm_srli_si128(xmmHi, 8)));
+}
+
+/* Integer to real: every source value is exactly representable */
+
+template <class Tin, class Tout>
+inline void GDALCopyWordsIntToRealSSE2(const Tin* const pSrcData,
+                                       int nSrcPixelOffset,
+                                       Tout* const pDstData,
+                                       int nDstPixelOffset,
+                                       int nWordCount)
+{
+    int n = 0;
+
+    if (nSrcPixelOffset == (int)sizeof(Tin) &&
+        nDstPixelOffset == (int)sizeof(Tout))
+    {
+        for (; n + 8 <= nWordCount; n += 8)
+        {
+            __m128i xmmLo, xmmHi;
+            GDALCopyLoad8SSE2(pSrcData + n, xmmLo, xmmHi);
+            GDALCopyStore8SSE2(pDstData + n, xmmLo, xmmHi);
+        }
+    }
+
+    GDALCopyWordsGenericT(
+        reinterpret_cast<const Tin*>(
+            reinterpret_cast<const char*>(pSrcData) + (std::ptrdiff_t)n * nSrcPixelOffset),
+        nSrcPixelOffset,
+        reinterpret_cast<Tout*>(
+            reinterpret_cast<char*>(pDstData) + (std::ptrdiff_t)n * nDstPixelOffset),
+        nDstPixelOffset, nWordCount - n);
+}
+
+/* Float32 to unsigned integer: add 0.5, clamp to [0,dfMax], truncate. */
+/* NaN ends up as 0, as _mm_max_ps() returns its second operand.       */
+
+inline __m128i GDALCopyRoundUnsignedSSE2(__m128 xmm, const __m128 xmmMax)
+{
+    xmm = _mm_add_ps(xmm, _mm_set1_ps(0.5f));
+    xmm = _mm_max_ps(xmm, _mm_setzero_ps());
+    xmm = _mm_min_ps(xmm, xmmMax);
+    return _mm_cvttps_epi32(xmm);
+}
+
+/* Float32 to Int16: round half away from zero, clamp, truncate. */
+
+inline __m128i GDALCopyRoundInt16SSE2(__m128 xmm)
+{
+    const __m128 xmmSign = _mm_set1_ps(-0.0f);
+
+    xmm = _mm_and_ps(xmm, _mm_cmpord_ps(xmm, xmm));
+    xmm = _mm_add_ps(xmm, _mm_or_ps(_mm_set1_ps(0.5f),
+                                    _mm_and_ps(xmm, xmmSign)));
+    xmm = _mm_max_ps(xmm, _mm_set1_ps(-32768.0f));
+    xmm = _mm_min_ps(xmm, _mm_set1_ps(32767.0f));
+    return _mm_cvttps_epi32(xmm);
+}
+
+/* Store 8 int32 known to be in the range of the output type */
+
+inline void GDALCopyStore8SSE2(unsigned char* pDst,
+                               const __m128i xmmLo, const __m128i xmmHi)
+{
+    __m128i xmm = _mm_packs_epi32(xmmLo, xmmHi);
+    xmm = _mm_packus_epi16(xmm, xmm);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(pDst), xmm);
+}
+
+inline void GDALCopyStore8SSE2(unsigned short* pDst,
+                               const __m128i xmmLo, const __m128i xmmHi)
+{
+    // There is no unsigned 32 to 16 bit pack in SSE2: bias to the signed
+    // range, pack, and flip the sign bit back.
+    const __m128i xmmBias = _mm_set1_epi32(32768);
+    __m128i xmm = _mm_packs_epi32(_mm_sub_epi32(xmmLo, xmmBias),
+                                  _mm_sub_epi32(xmmHi, xmmBias));
+    xmm = _mm_xor_si128(xmm, _mm_set1_epi16((short)0x8000));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst), xmm);
+}
+
+inline void GDALCopyStore8SSE2(short* pDst,
+                               const __m128i xmmLo, const __m128i xmmHi)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst),
+                     _mm_packs_epi32(xmmLo, xmmHi));
+}
+
+template <class Tout>
+inline void GDALCopyWordsFloatToIntSSE2(const float* const pSrcData,
+                                        int nSrcPixelOffset,
+                                        Tout* const pDstData,
+                                        int nDstPixelOffset,
+                                        int nWordCount)
+{
+    int n = 0;
+
+    if (nSrcPixelOffset == (int)sizeof(float) &&
+        nDstPixelOffset == (int)sizeof(Tout))
+    {
+        const bool bSigned = std::numeric_limits<Tout>::is_signed;
+        const __m128 xmmMax =
+            _mm_set1_ps(static_cast<float>(std::numeric_limits<Tout>::max()));
+
+        for (; n + 8 <= nWordCount; n += 8)
+        {
+            const __m128 xmm0 = _mm_loadu_ps(pSrcData + n);
+            const __m128 xmm1 = _mm_loadu_ps(pSrcData + n + 4);
+            if (bSigned)
+                GDALCopyStore8SSE2(pDstData + n,
+                                   GDALCopyRoundInt16SSE2(xmm0),
+                                   GDALCopyRoundInt16SSE2(xmm1));
+            else
+                GDALCopyStore8SSE2(pDstData + n,
+                                   GDALCopyRoundUnsignedSSE2(xmm0, xmmMax),
+                                   GDALCopyRoundUnsignedSSE2(xmm1, xmmMax));
+        }
+    }
+
+    GDALCopyWordsGenericT(
+        reinterpret_cast<const float*>(
+            reinterpret_cast<const char*>(pSrcData) + (std::ptrdiff_t)n * nSrcPixelOffset),
+        nSrcPixelOffset,
+        reinterpret_cast<Tout*>(
+            reinterpret_cast<char*>(pDstData) + (std::ptrdiff_t)n * nDstPixelOffset),
+        nDstPixelOffset, nWordCount - n);
+}
+
+#define GDAL_COPYWORDS_SSE2(Tin, Tout, func)                             \
+template <>                                                             \
+void GDALCopyWordsT(const Tin* const pSrcData, int nSrcPixelOffset,    \
+                    Tout* const pDstData, int nDstPixelOffset,          \
+                    int nWordCount)                                     \
+{                                                                       \
+    func(pSrcData, nSrcPixelOffset, pDstData, nDstPixelOffset,          \
+         nWordCount);                                                   \
+}
+
+GDAL_COPYWORDS_SSE2(unsigned char, float, GDALCopyWordsIntToRealSSE2)
+GDAL_COPYWORDS_SSE2(unsigned char, double, GDALCopyWordsIntToRealSSE2)
+GDAL_COPYWORDS_SSE2(unsigned short, float, GDALCopyWordsIntToRealSSE2)
+GDAL_COPYWORDS_SSE2(unsigned short, double, GDALCopyWordsIntToRealSSE2)
+GDAL_COPYWORDS_SSE2(short, float, GDALCopyWordsIntToRealSSE2)
+GDAL_COPYWORDS_SSE2(short, double, GDALCopyWordsIntToRealSSE2)
+GDAL_COPYWORDS_SSE2(float, unsigned char, GDALCopyWordsFloatToIntSSE2)
+GDAL_COPYWORDS_SSE2(float, unsigned short, GDALCopyWordsFloatToIntSSE2)
+GDAL_COPYWORDS_SSE2(float, short, GDALCopyWordsFloatToIntSSE2)
+
+#undef GDAL_COPYWORDS_SSE2
+
+#endif /* def USE_SSE2 */
+
 /************************************************************************/
 /*                   GDALCopyWordsComplexT()                            */
 /************************************************************************/
@@ -2202,6 +2610,14 @@ CPLErr GDALRasterBand::OverviewRasterIO( GDALRWFlag eRWFlag,
 {
     int         nOverview;
 
+    const char *pszResampling = 
+        GDALGetRasterIOResampling( eRWFlag, eDataType, nXSize, nYSize,
+                                   nBufXSize, nBufYSize );
+    if( pszResampling != NULL )
+        return RasterIOResampled( nXOff, nYOff, nXSize, nYSize,
+                                  pData, nBufXSize, nBufYSize, eBufType,
+                                  nPixelSpace, nLineSpace, pszResampling );
+
     nOverview =
         GDALBandGetBestOverviewLevel(this, nXOff, nYOff, nXSize, nYSize,
                                      nBufXSize, nBufYSize);
@@ -2220,6 +2636,438 @@ CPLErr GDALRasterBand::OverviewRasterIO( GDALRWFlag eRWFlag,
                                      nPixelSpace, nLineSpace );
 }
 
+/************************************************************************/
+/*                     GDALGetRasterIOResampling()                      */
+/*                                                                      */
+/*      Return the resampling method to apply to a RasterIO() request,  */
+/*      as set with the GDAL_RASTERIO_RESAMPLING configuration          */
+/*      option, or NULL if the request does not need resampling or      */
+/*      must use nearest neighbour decimation.                          */
+/************************************************************************/
+
+const char *GDALGetRasterIOResampling( GDALRWFlag eRWFlag,
+                                       GDALDataType eDataType,
+                                       int nXSize, int nYSize,
+                                       int nBufXSize, int nBufYSize )
+
+{
+    static int bHasWarned = FALSE;
+
+    if( eRWFlag != GF_Read
+        || (nXSize == nBufXSize && nYSize == nBufYSize)
+        || GDALDataTypeIsComplex( eDataType ) )
+        return NULL;
+
+    const char *pszResampling = 
+        CPLGetConfigOption( "GDAL_RASTERIO_RESAMPLING", NULL );
+    if( pszResampling == NULL || EQUALN(pszResampling,"NEAR",4) )
+        return NULL;
+
+    if( !EQUAL(pszResampling,"BILINEAR")
+        && !EQUAL(pszResampling,"CUBIC")
+        && !EQUAL(pszResampling,"AVERAGE") )
+    {
+        if( !bHasWarned )
+        {
+            CPLError( CE_Warning, CPLE_NotSupported,
+                      "GDAL_RASTERIO_RESAMPLING=%s not supported. "
+                      "Using NEAREST instead.", pszResampling );
+            bHasWarned = TRUE;
+        }
+        return NULL;
+    }
+
+    return pszResampling;
+}
+
+/************************************************************************/
+/*                        GDALRIOResampleWeights                        */
+/*                                                                      */
+/*      Source pixels and weights contributing to each destination      */
+/*      pixel along one axis of a resampled RasterIO() request.         */
+/************************************************************************/
+
+typedef struct
+{
+    int     nMaxCount;
+    int    *panStart;
+    int    *panCount;
+    double *padfWeights;    /* nMaxCount weights per destination pixel */
+    int     nSrcMin;
+    int     nSrcMax;
+} GDALRIOResampleWeights;
+
+static double GDALRIOResampleKernel( const char *pszResampling, double dfX )
+
+{
+    dfX = fabs(dfX);
+
+    if( EQUAL(pszResampling,"BILINEAR") )
+        return ( dfX < 1.0 ) ? 1.0 - dfX : 0.0;
+
+    /* Keys cubic convolution, with a = -0.5 */
+    if( dfX < 1.0 )
+        return (1.5 * dfX - 2.5) * dfX * dfX + 1.0;
+    else if( dfX < 2.0 )
+        return ((-0.5 * dfX + 2.5) * dfX - 4.0) * dfX + 2.0;
+    else
+        return 0.0;
+}
+
+/************************************************************************/
+/*                   GDALRIOComputeResampleWeights()                    */
+/*                                                                      */
+/*      The source window [dfSrcOff, dfSrcOff + dfSrcSize[ is mapped    */
+/*      on nDstSize pixels.  When downsampling, the kernels are         */
+/*      stretched by the downsampling factor, so that every source      */
+/*      pixel contributes to the result.                                */
+/************************************************************************/
+
+static int GDALRIOComputeResampleWeights( const char *pszResampling,
+                                          double dfSrcOff, double dfSrcSize,
+                                          int nSrcLimit, int nDstSize,
+                                          GDALRIOResampleWeights *psWeights )
+
+{
+    double dfScale = dfSrcSize / nDstSize;
+    double dfKernelScale = MAX( 1.0, dfScale );
+    double dfRadius;
+    int    bAverage = EQUAL(pszResampling,"AVERAGE");
+
+    if( bAverage )
+        dfRadius = dfScale / 2;
+    else if( EQUAL(pszResampling,"BILINEAR") )
+        dfRadius = dfKernelScale;
+    else
+        dfRadius = 2 * dfKernelScale;
+
+    psWeights->nMaxCount = (int) ceil(2 * dfRadius) + 2;
+    psWeights->panStart = (int *) VSIMalloc2( nDstSize, sizeof(int) );
+    psWeights->panCount = (int *) VSIMalloc2( nDstSize, sizeof(int) );
+    psWeights->padfWeights = (double *)
+        VSIMalloc3( nDstSize, psWeights->nMaxCount, sizeof(double) );
+    psWeights->nSrcMin = nSrcLimit;
+    psWeights->nSrcMax = 0;
+
+    if( psWeights->panStart == NULL || psWeights->panCount == NULL
+        || psWeights->padfWeights == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Out of memory in GDALRIOComputeResampleWeights()." );
+        return FALSE;
+    }
+
+    for( int iDst = 0; iDst < nDstSize; iDst++ )
+    {
+        double  dfCenter = dfSrcOff + (iDst + 0.5) * dfScale;
+        double *padfWeights = psWeights->padfWeights
+                                        + iDst * psWeights->nMaxCount;
+        int     nStart = (int) floor(dfCenter - dfRadius);
+        int     nEnd = (int) ceil(dfCenter + dfRadius);
+        double  dfWeightSum = 0.0;
+
+        nStart = MAX( 0, nStart );
+        nEnd = MIN( nSrcLimit, MIN( nEnd, nStart + psWeights->nMaxCount ) );
+
+        for( int iSrc = nStart; iSrc < nEnd; iSrc++ )
+        {
+            double dfWeight;
+
+            if( bAverage )
+                dfWeight = MIN( iSrc + 1.0, dfCenter + dfRadius )
+                         - MAX( (double) iSrc, dfCenter - dfRadius );
+            else
+                dfWeight = GDALRIOResampleKernel( pszResampling,
+                                    (iSrc + 0.5 - dfCenter) / dfKernelScale );
+
+            padfWeights[iSrc - nStart] = dfWeight;
+            dfWeightSum += padfWeights[iSrc - nStart];
+        }
+
+        /* Outside of the raster, or too small a footprint: take the */
+        /* closest source pixel. */
+        if( nEnd <= nStart || dfWeightSum <= 1e-10 )
+        {
+            nStart = MAX( 0, MIN( nSrcLimit - 1, (int) floor(dfCenter) ) );
+            nEnd = nStart + 1;
+            padfWeights[0] = 1.0;
+            dfWeightSum = 1.0;
+        }
+
+        for( int iSrc = nStart; iSrc < nEnd; iSrc++ )
+            padfWeights[iSrc - nStart] /= dfWeightSum;
+
+        psWeights->panStart[iDst] = nStart;
+        psWeights->panCount[iDst] = nEnd - nStart;
+        psWeights->nSrcMin = MIN( psWeights->nSrcMin, nStart );
+        psWeights->nSrcMax = MAX( psWeights->nSrcMax, nEnd );
+    }
+
+    return TRUE;
+}
+
+static void GDALRIOFreeResampleWeights( GDALRIOResampleWeights *psWeights )
+
+{
+    VSIFree( psWeights->panStart );
+    VSIFree( psWeights->panCount );
+    VSIFree( psWeights->padfWeights );
+}
+
+/************************************************************************/
+/*                         RasterIOResampled()                          */
+/*                                                                      */
+/*      Read a window into a buffer of a different size with a real     */
+/*      BILINEAR, CUBIC or AVERAGE filter, instead of the nearest       */
+/*      neighbour decimation of IRasterIO().  The most appropriate      */
+/*      overview is used as the source, that is processed by chunks     */
+/*      of lines: each line is first resampled horizontally, and the    */
+/*      lines are then combined vertically.  Invalid pixels, as         */
+/*      reported by the mask band, are ignored.                         */
+/************************************************************************/
+
+CPLErr GDALRasterBand::RasterIOResampled( int nXOff, int nYOff,
+                                          int nXSize, int nYSize,
+                                          void * pData,
+                                          int nBufXSize, int nBufYSize,
+                                          GDALDataType eBufType,
+                                          int nPixelSpace, int nLineSpace,
+                                          const char *pszResampling )
+
+{
+    if( nPixelSpace == 0 )
+        nPixelSpace = GDALGetDataTypeSize( eBufType ) / 8;
+    if( nLineSpace == 0 )
+        nLineSpace = nPixelSpace * nBufXSize;
+
+/* -------------------------------------------------------------------- */
+/*      Use an overview if one is appropriate, with the window          */
+/*      expressed in its (non integer) coordinates.                     */
+/* -------------------------------------------------------------------- */
+    GDALRasterBand *poSrcBand = this;
+    double dfXOff = nXOff, dfYOff = nYOff;
+    double dfXSize = nXSize, dfYSize = nYSize;
+
+    if( (nBufXSize < nXSize || nBufYSize < nYSize) && GetOverviewCount() > 0 )
+    {
+        int nOXOff = nXOff, nOYOff = nYOff, nOXSize = nXSize, nOYSize = nYSize;
+        int nOverview = 
+            GDALBandGetBestOverviewLevel( this, nOXOff, nOYOff, nOXSize, nOYSize,
+                                          nBufXSize, nBufYSize );
+        if( nOverview >= 0 && GetOverview(nOverview) != NULL )
+        {
+            poSrcBand = GetOverview(nOverview);
+
+            double dfXRes = GetXSize() / (double) poSrcBand->GetXSize();
+            double dfYRes = GetYSize() / (double) poSrcBand->GetYSize();
+
+            dfXOff = nXOff / dfXRes;
+            dfYOff = nYOff / dfYRes;
+            dfXSize = nXSize / dfXRes;
+            dfYSize = nYSize / dfYRes;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Compute the contributions of the source pixels.                 */
+/* -------------------------------------------------------------------- */
+    GDALRIOResampleWeights sXWeights, sYWeights;
+
+    memset( &sXWeights, 0, sizeof(sXWeights) );
+    memset( &sYWeights, 0, sizeof(sYWeights) );
+
+    if( !GDALRIOComputeResampleWeights( pszResampling, dfXOff, dfXSize,
+                                        poSrcBand->GetXSize(), nBufXSize,
+                                        &sXWeights )
+        || !GDALRIOComputeResampleWeights( pszResampling, dfYOff, dfYSize,
+                                           poSrcBand->GetYSize(), nBufYSize,
+                                           &sYWeights ) )
+    {
+        GDALRIOFreeResampleWeights( &sXWeights );
+        GDALRIOFreeResampleWeights( &sYWeights );
+        return CE_Failure;
+    }
+
+    int nSrcXOff = sXWeights.nSrcMin;
+    int nSrcXSize = sXWeights.nSrcMax - sXWeights.nSrcMin;
+
+    GDALRasterBand *poMaskBand = NULL;
+    int     bHasNoData = FALSE;
+    double  dfNoDataValue = GetNoDataValue( &bHasNoData );
+
+    if( (poSrcBand->GetMaskFlags() & GMF_ALL_VALID) == 0 )
+        poMaskBand = poSrcBand->GetMaskBand();
+    if( !bHasNoData )
+        dfNoDataValue = 0.0;
+
+/* -------------------------------------------------------------------- */
+/*      Source lines are read by chunks, and kept resampled             */
+/*      horizontally as long as destination lines need them.            */
+/* -------------------------------------------------------------------- */
+    int nBlockXSize, nBlockYSize, nChunkYSize;
+
+    poSrcBand->GetBlockSize( &nBlockXSize, &nBlockYSize );
+    if( nBlockYSize < 16 || nBlockYSize > 256 )
+        nChunkYSize = 64;
+    else
+        nChunkYSize = nBlockYSize;
+
+    int nCacheLines = sYWeights.nMaxCount + nChunkYSize;
+
+    double *padfChunk = (double *) 
+        VSIMalloc3( nSrcXSize, nChunkYSize, sizeof(double) );
+    GByte *pabyChunkMask = poMaskBand == NULL ? NULL : (GByte *)
+        VSIMalloc2( nSrcXSize, nChunkYSize );
+    double *padfHLines = (double *)
+        VSIMalloc3( nBufXSize, nCacheLines, sizeof(double) );
+    double *padfHWeights = poMaskBand == NULL ? NULL : (double *)
+        VSIMalloc3( nBufXSize, nCacheLines, sizeof(double) );
+    double *padfDstLine = (double *) VSIMalloc2( nBufXSize, sizeof(double) );
+    CPLErr  eErr = CE_None;
+
+    if( padfChunk == NULL || padfHLines == NULL || padfDstLine == NULL
+        || (poMaskBand != NULL && (pabyChunkMask == NULL || padfHWeights == NULL)) )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Out of memory in GDALRasterBand::RasterIOResampled()." );
+        eErr = CE_Failure;
+    }
+
+    int nNextSrcLine = sYWeights.nSrcMin;
+
+    for( int iBufYOff = 0; iBufYOff < nBufYSize && eErr == CE_None; iBufYOff++ )
+    {
+        int nStartLine = sYWeights.panStart[iBufYOff];
+        int nLineCount = sYWeights.panCount[iBufYOff];
+
+        if( nNextSrcLine < nStartLine )
+            nNextSrcLine = nStartLine;
+
+/* -------------------------------------------------------------------- */
+/*      Load and horizontally resample the missing source lines.        */
+/* -------------------------------------------------------------------- */
+        while( nNextSrcLine < nStartLine + nLineCount && eErr == CE_None )
+        {
+            int nLines = MIN( nChunkYSize, sYWeights.nSrcMax - nNextSrcLine );
+
+            eErr = poSrcBand->RasterIO( GF_Read, nSrcXOff, nNextSrcLine,
+                                        nSrcXSize, nLines,
+                                        padfChunk, nSrcXSize, nLines,
+                                        GDT_Float64, 0, 0 );
+            if( eErr == CE_None && poMaskBand != NULL )
+                eErr = poMaskBand->RasterIO( GF_Read, nSrcXOff, nNextSrcLine,
+                                             nSrcXSize, nLines,
+                                             pabyChunkMask, nSrcXSize, nLines,
+                                             GDT_Byte, 0, 0 );
+
+            for( int iLine = 0; iLine < nLines && eErr == CE_None; iLine++ )
+            {
+                int     iCacheLine = (nNextSrcLine + iLine) % nCacheLines;
+                double *padfSrc = padfChunk + (size_t) iLine * nSrcXSize - nSrcXOff;
+                double *padfHLine = padfHLines + (size_t) iCacheLine * nBufXSize;
+
+                if( poMaskBand == NULL )
+                {
+                    for( int iBufXOff = 0; iBufXOff < nBufXSize; iBufXOff++ )
+                    {
+                        const double *padfWeights = sXWeights.padfWeights
+                                        + iBufXOff * sXWeights.nMaxCount;
+                        const double *padfSrcPixels = padfSrc
+                                        + sXWeights.panStart[iBufXOff];
+                        double dfSum = 0.0;
+
+                        for( int i = sXWeights.panCount[iBufXOff] - 1; i >= 0; i-- )
+                            dfSum += padfWeights[i] * padfSrcPixels[i];
+
+                        padfHLine[iBufXOff] = dfSum;
+                    }
+                }
+                else
+                {
+                    GByte  *pabyMask = pabyChunkMask + (size_t) iLine * nSrcXSize - nSrcXOff;
+                    double *padfHWeight = padfHWeights + (size_t) iCacheLine * nBufXSize;
+
+                    for( int iBufXOff = 0; iBufXOff < nBufXSize; iBufXOff++ )
+                    {
+                        const double *padfWeights = sXWeights.padfWeights
+                                        + iBufXOff * sXWeights.nMaxCount;
+                        int    nStart = sXWeights.panStart[iBufXOff];
+                        double dfSum = 0.0, dfWeightSum = 0.0;
+
+                        for( int i = sXWeights.panCount[iBufXOff] - 1; i >= 0; i-- )
+                        {
+                            if( pabyMask[nStart + i] != 0 )
+                            {
+                                dfSum += padfWeights[i] * padfSrc[nStart + i];
+                                dfWeightSum += padfWeights[i];
+                            }
+                        }
+
+                        padfHLine[iBufXOff] = dfSum;
+                        padfHWeight[iBufXOff] = dfWeightSum;
+                    }
+                }
+            }
+
+            nNextSrcLine += nLines;
+        }
+
+        if( eErr != CE_None )
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Combine them vertically into the destination line.              */
+/* -------------------------------------------------------------------- */
+        const double *padfWeights = sYWeights.padfWeights
+                                        + iBufYOff * sYWeights.nMaxCount;
+        int iBufXOff;
+
+        for( iBufXOff = 0; iBufXOff < nBufXSize; iBufXOff++ )
+            padfDstLine[iBufXOff] = 0.0;
+
+        for( int i = 0; i < nLineCount; i++ )
+        {
+            const double *padfHLine = padfHLines
+                + (size_t) ((nStartLine + i) % nCacheLines) * nBufXSize;
+
+            for( iBufXOff = 0; iBufXOff < nBufXSize; iBufXOff++ )
+                padfDstLine[iBufXOff] += padfWeights[i] * padfHLine[iBufXOff];
+        }
+
+        if( poMaskBand != NULL )
+        {
+            for( iBufXOff = 0; iBufXOff < nBufXSize; iBufXOff++ )
+            {
+                double dfWeightSum = 0.0;
+
+                for( int i = 0; i < nLineCount; i++ )
+                    dfWeightSum += padfWeights[i] * padfHWeights[
+                        (size_t) ((nStartLine + i) % nCacheLines) * nBufXSize
+                        + iBufXOff];
+
+                if( dfWeightSum > 1e-10 )
+                    padfDstLine[iBufXOff] /= dfWeightSum;
+                else
+                    padfDstLine[iBufXOff] = dfNoDataValue;
+            }
+        }
+
+        GDALCopyWords( padfDstLine, GDT_Float64, sizeof(double),
+                       ((GByte *) pData) + (size_t) iBufYOff * nLineSpace,
+                       eBufType, nPixelSpace, nBufXSize );
+    }
+
+    VSIFree( padfChunk );
+    VSIFree( pabyChunkMask );
+    VSIFree( padfHLines );
+    VSIFree( padfHWeights );
+    VSIFree( padfDstLine );
+    GDALRIOFreeResampleWeights( &sXWeights );
+    GDALRIOFreeResampleWeights( &sYWeights );
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                        GetBestOverviewLevel()                        */
 /*                                                                      */
@@ -2301,6 +3149,66 @@ int GDALDatasetGetBestOverviewLevel(GDALDataset* poDS,
                                         nBufXSize, nBufYSize);
 }
 
+/************************************************************************/
+/*                           IRasterIOMulti()                           */
+/*                                                                      */
+/*      Default implementation of RasterIOMulti(), that hands the       */
+/*      windows to each band in turn.                                   */
+/************************************************************************/
+
+CPLErr GDALDataset::IRasterIOMulti( GDALRWFlag eRWFlag,
+                                    int nWindowCount,
+                                    GDALRasterIOWindow *pasWindows,
+                                    GDALDataType eBufType,
+                                    int nBandCount, int *panBandMap,
+                                    int nPixelSpace, int nLineSpace,
+                                    int nBandSpace )
+
+{
+    if( nPixelSpace == 0 )
+        nPixelSpace = GDALGetDataTypeSize( eBufType ) / 8;
+
+    GDALRasterIOWindow *pasBandWindows = (GDALRasterIOWindow *)
+        VSIMalloc2( nWindowCount, sizeof(GDALRasterIOWindow) );
+    if( pasBandWindows == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Out of memory in GDALDataset::IRasterIOMulti()." );
+        return CE_Failure;
+    }
+
+    CPLErr eErr = CE_None;
+
+    for( int iBand = 0; iBand < nBandCount && eErr == CE_None; iBand++ )
+    {
+        for( int iWindow = 0; iWindow < nWindowCount; iWindow++ )
+        {
+            GDALRasterIOWindow *psWindow = pasBandWindows + iWindow;
+
+            *psWindow = pasWindows[iWindow];
+            if( iBand == 0 || psWindow->pData == NULL )
+                continue;
+
+            GIntBig nWindowBandSpace = nBandSpace;
+            if( nWindowBandSpace == 0 )
+                nWindowBandSpace = (GIntBig) psWindow->nBufYSize *
+                    (nLineSpace != 0 ? nLineSpace
+                                     : nPixelSpace * psWindow->nBufXSize);
+
+            psWindow->pData = ((GByte *) psWindow->pData)
+                                        + iBand * nWindowBandSpace;
+        }
+
+        eErr = GetRasterBand( panBandMap[iBand] )->RasterIOMulti(
+                    eRWFlag, nWindowCount, pasBandWindows,
+                    eBufType, nPixelSpace, nLineSpace );
+    }
+
+    CPLFree( pasBandWindows );
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                         BlockBasedRasterIO()                         */
 /*                                                                      */
@@ -2396,6 +3304,19 @@ GDALDataset::BlockBasedRasterIO( GDALRWFlag eRWFlag,
         }
     }
 
+/* -------------------------------------------------------------------- */
+/*      Resampling with a real filter is done band per band.            */
+/* -------------------------------------------------------------------- */
+    if( GDALGetRasterIOResampling( eRWFlag, eDataType, nXSize, nYSize,
+                                   nBufXSize, nBufYSize ) != NULL )
+        return GDALDataset::IRasterIO( eRWFlag, 
+                                       nXOff, nYOff, nXSize, nYSize, 
+                                       pData, nBufXSize, nBufYSize, 
+                                       eBufType, 
+                                       nBandCount, panBandMap,
+                                       nPixelSpace, nLineSpace, 
+                                       nBandSpace );
+
 /* ==================================================================== */
 /*      In this special case at full resolution we step through in      */
 /*      blocks, turning the request over to the per-band                */
@@ -291,6 +291,65 @@ void CPLDestroyMutex( void *hMutex )
 #endif
 }
 
+/************************************************************************/
+/*                         CPLTryAcquireMutex()                         */
+/************************************************************************/
+
+int CPLTryAcquireMutex( void *hMutex )
+
+{
+    return CPLAcquireMutex( hMutex, 0.0 );
+}
+
+/************************************************************************/
+/*                            CPLCreateCond()                           */
+/*                                                                      */
+/*      Without threads, nobody could ever signal a condition we        */
+/*      would be waiting for, so conditions are not supported.          */
+/************************************************************************/
+
+void *CPLCreateCond()
+
+{
+    return NULL;
+}
+
+/************************************************************************/
+/*                             CPLCondWait()                            */
+/************************************************************************/
+
+void CPLCondWait( void *hCond, void* hMutex )
+
+{
+}
+
+/************************************************************************/
+/*                            CPLCondSignal()                           */
+/************************************************************************/
+
+void CPLCondSignal( void *hCond )
+
+{
+}
+
+/************************************************************************/
+/*                          CPLCondBroadcast()                          */
+/************************************************************************/
+
+void CPLCondBroadcast( void *hCond )
+
+{
+}
+
+/************************************************************************/
+/*                            CPLDestroyCond()                          */
+/************************************************************************/
+
+void CPLDestroyCond( void *hCond )
+
+{
+}
+
 /************************************************************************/
 /*                            CPLLockFile()                             */
 /*                                                                      */
@@ -378,6 +437,16 @@ GIntBig CPLGetPID()
     return 1;
 }
 
+/************************************************************************/
+/*                           CPLGetNumCPUs()                            */
+/************************************************************************/
+
+int CPLGetNumCPUs()
+
+{
+    return 1;
+}
+
 /************************************************************************/
 /*                          CPLCreateThread();                          */
 /************************************************************************/
@@ -390,6 +459,27 @@ int CPLCreateThread( CPLThreadFunc pfnMain, void *pArg )
     return -1;
 }
 
+/************************************************************************/
+/*                      CPLCreateJoinableThread()                       */
+/************************************************************************/
+
+void* CPLCreateJoinableThread( CPLThreadFunc pfnMain, void *pArg )
+
+{
+    CPLDebug( "CPLCreateJoinableThread", "Fails to dummy implementation" );
+
+    return NULL;
+}
+
+/************************************************************************/
+/*                            CPLJoinThread()                           */
+/************************************************************************/
+
+void CPLJoinThread( void* hJoinableThread )
+
+{
+}
+
 /************************************************************************/
 /*                              CPLSleep()                              */
 /************************************************************************/
@@ -564,6 +654,171 @@ void CPLDestroyMutex( void *hMutexIn )
 #endif
 }
 
+/************************************************************************/
+/*                         CPLTryAcquireMutex()                         */
+/************************************************************************/
+
+int CPLTryAcquireMutex( void *hMutexIn )
+
+{
+#ifdef USE_WIN32_MUTEX
+    return WaitForSingleObject( (HANDLE) hMutexIn, 0 ) != WAIT_TIMEOUT;
+#else
+    return TryEnterCriticalSection( (CRITICAL_SECTION *) hMutexIn ) != 0;
+#endif
+}
+
+/************************************************************************/
+/*                            CPLCreateCond()                           */
+/*                                                                      */
+/*      Native condition variables are not available before Windows    */
+/*      Vista, so a condition is implemented as a list of waiters,     */
+/*      each waiting on its own (per-thread) auto-reset event.          */
+/************************************************************************/
+
+typedef struct _WaiterItem
+{
+    HANDLE hEvent;
+    struct _WaiterItem* psNext;
+} WaiterItem;
+
+typedef struct
+{
+    void        *hInternalMutex;
+    WaiterItem  *psWaiterList;
+} Win32Cond;
+
+void *CPLCreateCond()
+
+{
+    Win32Cond* psCond = (Win32Cond*) malloc(sizeof(Win32Cond));
+    if (psCond == NULL)
+        return NULL;
+    psCond->hInternalMutex = CPLCreateMutex();
+    if (psCond->hInternalMutex == NULL)
+    {
+        free(psCond);
+        return NULL;
+    }
+    CPLReleaseMutex(psCond->hInternalMutex);
+    psCond->psWaiterList = NULL;
+    return (void*) psCond;
+}
+
+/************************************************************************/
+/*                             CPLCondWait()                            */
+/************************************************************************/
+
+static void CPLTLSFreeEvent(void* pData)
+{
+    CloseHandle((HANDLE)pData);
+}
+
+void CPLCondWait( void *hCond, void* hClientMutex )
+
+{
+    Win32Cond* psCond = (Win32Cond*) hCond;
+
+    HANDLE hEvent = (HANDLE) CPLGetTLS(CTLS_WIN32_COND);
+    if (hEvent == NULL)
+    {
+        hEvent = CreateEvent(NULL, /* security attributes */
+                             FALSE, /* manual reset = no */
+                             FALSE, /* initial state = unsignaled */
+                             NULL /* no name */);
+        CPLAssert(hEvent != NULL);
+
+        CPLSetTLSWithFreeFunc(CTLS_WIN32_COND, hEvent, CPLTLSFreeEvent);
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Insert the waiter into the waiter list of the condition.        */
+/* -------------------------------------------------------------------- */
+    CPLAcquireMutex(psCond->hInternalMutex, 1000.0);
+
+    WaiterItem* psItem = (WaiterItem*)malloc(sizeof(WaiterItem));
+    CPLAssert(psItem != NULL);
+
+    psItem->hEvent = hEvent;
+    psItem->psNext = psCond->psWaiterList;
+
+    psCond->psWaiterList = psItem;
+
+    CPLReleaseMutex(psCond->hInternalMutex);
+
+/* -------------------------------------------------------------------- */
+/*      Release the client mutex before waiting for the event to be     */
+/*      signaled, and reacquire it afterwards.                          */
+/* -------------------------------------------------------------------- */
+    CPLReleaseMutex(hClientMutex);
+
+    WaitForSingleObject(hEvent, INFINITE);
+
+    CPLAcquireMutex(hClientMutex, 1000.0);
+}
+
+/************************************************************************/
+/*                            CPLCondSignal()                           */
+/************************************************************************/
+
+void CPLCondSignal( void *hCond )
+
+{
+    Win32Cond* psCond = (Win32Cond*) hCond;
+
+    /* Signal the first registered event, and remove it from the list */
+    CPLAcquireMutex(psCond->hInternalMutex, 1000.0);
+
+    WaiterItem* psIter = psCond->psWaiterList;
+    if (psIter != NULL)
+    {
+        SetEvent(psIter->hEvent);
+        psCond->psWaiterList = psIter->psNext;
+        free(psIter);
+    }
+
+    CPLReleaseMutex(psCond->hInternalMutex);
+}
+
+/************************************************************************/
+/*                          CPLCondBroadcast()                          */
+/************************************************************************/
+
+void CPLCondBroadcast( void *hCond )
+
+{
+    Win32Cond* psCond = (Win32Cond*) hCond;
+
+    /* Signal all the registered events, and remove them from the list */
+    CPLAcquireMutex(psCond->hInternalMutex, 1000.0);
+
+    WaiterItem* psIter = psCond->psWaiterList;
+    while (psIter != NULL)
+    {
+        WaiterItem* psNext = psIter->psNext;
+        SetEvent(psIter->hEvent);
+        free(psIter);
+        psIter = psNext;
+    }
+    psCond->psWaiterList = NULL;
+
+    CPLReleaseMutex(psCond->hInternalMutex);
+}
+
+/************************************************************************/
+/*                            CPLDestroyCond()                          */
+/************************************************************************/
+
+void CPLDestroyCond( void *hCond )
+
+{
+    Win32Cond* psCond = (Win32Cond*) hCond;
+    CPLDestroyMutex(psCond->hInternalMutex);
+    psCond->hInternalMutex = NULL;
+    CPLAssert(psCond->psWaiterList == NULL);
+    free(psCond);
+}
+
 /************************************************************************/
 /*                            CPLLockFile()                             */
 /************************************************************************/
@@ -630,6 +885,18 @@ GIntBig CPLGetPID()
     return (GIntBig) GetCurrentThreadId();
 }
 
+/************************************************************************/
+/*                           CPLGetNumCPUs()                            */
+/************************************************************************/
+
+int CPLGetNumCPUs()
+
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (info.dwNumberOfProcessors > 0) ? (int) info.dwNumberOfProcessors : 1;
+}
+
 /************************************************************************/
 /*                       CPLStdCallThreadJacket()                       */
 /************************************************************************/
@@ -637,6 +904,8 @@ GIntBig CPLGetPID()
 typedef struct {
     void *pAppData;
     CPLThreadFunc pfnMain;
+    HANDLE hThread;
+    int bJoinable;
 } CPLStdCallThreadInfo;
 
 static DWORD WINAPI CPLStdCallThreadJacket( void *pData )
@@ -646,7 +915,9 @@ static DWORD WINAPI CPLStdCallThreadJacket( void *pData )
 
     psInfo->pfnMain( psInfo->pAppData );
 
-    CPLFree( psInfo );
+    /* Joinable threads are released by CPLJoinThread() */
+    if( !psInfo->bJoinable )
+        CPLFree( psInfo );
 
     CPLCleanupTLS();
 
@@ -683,6 +954,49 @@ int CPLCreateThread( CPLThreadFunc pfnMain, void *pThreadArg )
     return nThreadId;
 }
 
+/************************************************************************/
+/*                      CPLCreateJoinableThread()                       */
+/************************************************************************/
+
+void* CPLCreateJoinableThread( CPLThreadFunc pfnMain, void *pThreadArg )
+
+{
+    HANDLE hThread;
+    DWORD  nThreadId;
+    CPLStdCallThreadInfo *psInfo;
+
+    psInfo = (CPLStdCallThreadInfo*) CPLCalloc(sizeof(CPLStdCallThreadInfo),1);
+    psInfo->pAppData = pThreadArg;
+    psInfo->pfnMain = pfnMain;
+    psInfo->bJoinable = TRUE;
+
+    hThread = CreateThread( NULL, 0, CPLStdCallThreadJacket, psInfo, 
+                            0, &nThreadId );
+
+    if( hThread == NULL )
+    {
+        CPLFree( psInfo );
+        return NULL;
+    }
+
+    psInfo->hThread = hThread;
+    return psInfo;
+}
+
+/************************************************************************/
+/*                            CPLJoinThread()                           */
+/************************************************************************/
+
+void CPLJoinThread( void* hJoinableThread )
+
+{
+    CPLStdCallThreadInfo *psInfo = (CPLStdCallThreadInfo *) hJoinableThread;
+
+    WaitForSingleObject( psInfo->hThread, INFINITE );
+    CloseHandle( psInfo->hThread );
+    CPLFree( psInfo );
+}
+
 /************************************************************************/
 /*                              CPLSleep()                              */
 /************************************************************************/
@@ -757,6 +1071,7 @@ void CPLCleanupTLS()
 
 #include <pthread.h>
 #include <time.h>
+#include <unistd.h>
 
   /************************************************************************/
   /* ==================================================================== */
@@ -891,6 +1206,77 @@ void CPLDestroyMutex( void *hMutexIn )
     free( hMutexIn );
 }
 
+/************************************************************************/
+/*                         CPLTryAcquireMutex()                         */
+/************************************************************************/
+
+int CPLTryAcquireMutex( void *hMutexIn )
+
+{
+    return pthread_mutex_trylock( (pthread_mutex_t *) hMutexIn ) == 0;
+}
+
+/************************************************************************/
+/*                            CPLCreateCond()                           */
+/************************************************************************/
+
+void *CPLCreateCond()
+
+{
+    pthread_cond_t* pCond = (pthread_cond_t* )malloc(sizeof(pthread_cond_t));
+    if (pCond && pthread_cond_init(pCond, NULL) == 0)
+        return pCond;
+    fprintf(stderr, "CPLCreateCond() failed.\n");
+    free(pCond);
+    return NULL;
+}
+
+/************************************************************************/
+/*                             CPLCondWait()                            */
+/************************************************************************/
+
+void CPLCondWait( void *hCond, void* hMutex )
+
+{
+    pthread_cond_t* pCond = (pthread_cond_t* )hCond;
+    pthread_mutex_t * pMutex = (pthread_mutex_t *)hMutex;
+    pthread_cond_wait(pCond, pMutex);
+}
+
+/************************************************************************/
+/*                            CPLCondSignal()                           */
+/************************************************************************/
+
+void CPLCondSignal( void *hCond )
+
+{
+    pthread_cond_t* pCond = (pthread_cond_t* )hCond;
+    pthread_cond_signal(pCond);
+}
+
+/************************************************************************/
+/*                          CPLCondBroadcast()                          */
+/************************************************************************/
+
+void CPLCondBroadcast( void *hCond )
+
+{
+    pthread_cond_t* pCond = (pthread_cond_t* )hCond;
+    pthread_cond_broadcast(pCond);
+}
+
+/************************************************************************/
+/*                            CPLDestroyCond()                          */
+/************************************************************************/
+
+void CPLDestroyCond( void *hCond )
+
+{
+    pthread_cond_t* pCond = (pthread_cond_t* )hCond;
+    pthread_cond_destroy(pCond);
+    free(hCond);
+}
+
 /************************************************************************/
 /*                            CPLLockFile()                             */
 /*                                                                      */
@@ -971,6 +1357,21 @@ GIntBig CPLGetPID()
     return (GIntBig) pthread_self();
 }
 
+/************************************************************************/
+/*                           CPLGetNumCPUs()                            */
+/************************************************************************/
+
+int CPLGetNumCPUs()
+
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    int nCPUs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    return (nCPUs > 0) ? nCPUs : 1;
+#else
+    return 1;
+#endif
+}
+
 /************************************************************************/
 /*                       CPLStdCallThreadJacket()                       */
 /************************************************************************/
@@ -979,6 +1380,7 @@ typedef struct {
     void *pAppData;
     CPLThreadFunc pfnMain;
     pthread_t hThread;
+    int bJoinable;
 } CPLStdCallThreadInfo;
 
 static void *CPLStdCallThreadJacket( void *pData )
@@ -988,7 +1390,9 @@ static void *CPLStdCallThreadJacket( void *pData )
 
     psInfo->pfnMain( psInfo->pAppData );
 
-    CPLFree( psInfo );
+    /* Joinable threads are released by CPLJoinThread() */
+    if( !psInfo->bJoinable )
+        CPLFree( psInfo );
 
     return NULL;
 }
@@ -1024,6 +1428,48 @@ int CPLCreateThread( CPLThreadFunc pfnMain, void *pThreadArg )
     return 1; /* can we return the actual thread pid? */
 }
 
+/************************************************************************/
+/*                      CPLCreateJoinableThread()                       */
+/************************************************************************/
+
+void* CPLCreateJoinableThread( CPLThreadFunc pfnMain, void *pThreadArg )
+
+{
+    CPLStdCallThreadInfo *psInfo;
+    pthread_attr_t hThreadAttr;
+
+    psInfo = (CPLStdCallThreadInfo*) CPLCalloc(sizeof(CPLStdCallThreadInfo),1);
+    psInfo->pAppData = pThreadArg;
+    psInfo->pfnMain = pfnMain;
+    psInfo->bJoinable = TRUE;
+
+    pthread_attr_init( &hThreadAttr );
+    pthread_attr_setdetachstate( &hThreadAttr, PTHREAD_CREATE_JOINABLE );
+    if( pthread_create( &(psInfo->hThread), &hThreadAttr, 
+                        CPLStdCallThreadJacket, (void *) psInfo ) != 0 )
+    {
+        CPLFree( psInfo );
+        return NULL;
+    }
+
+    return psInfo;
+}
+
+/************************************************************************/
+/*                            CPLJoinThread()                           */
+/************************************************************************/
+
+void CPLJoinThread( void* hJoinableThread )
+
+{
+    CPLStdCallThreadInfo *psInfo = (CPLStdCallThreadInfo*) hJoinableThread;
+
+    void* status;
+    pthread_join( psInfo->hThread, &status);
+
+    CPLFree(psInfo);
+}
+
 /************************************************************************/
 /*                              CPLSleep()                              */
 /************************************************************************/
@@ -60,9 +60,19 @@ int   CPL_DLL CPLCreateOrAcquireMutex( void **, double dfWaitInSeconds );
 int   CPL_DLL CPLAcquireMutex( void *hMutex, double dfWaitInSeconds );
 void  CPL_DLL CPLReleaseMutex( void *hMutex );
 void  CPL_DLL CPLDestroyMutex( void *hMutex );
+int   CPL_DLL CPLTryAcquireMutex( void *hMutex );
+
+void CPL_DLL *CPLCreateCond();
+void  CPL_DLL CPLCondWait( void *hCond, void *hMutex );
+void  CPL_DLL CPLCondSignal( void *hCond );
+void  CPL_DLL CPLCondBroadcast( void *hCond );
+void  CPL_DLL CPLDestroyCond( void *hCond );
 
 GIntBig CPL_DLL CPLGetPID();
+int   CPL_DLL CPLGetNumCPUs();
 int   CPL_DLL CPLCreateThread( CPLThreadFunc pfnMain, void *pArg );
+void CPL_DLL *CPLCreateJoinableThread( CPLThreadFunc pfnMain, void *pArg );
+void  CPL_DLL CPLJoinThread( void *hJoinableThread );
 void  CPL_DLL CPLSleep( double dfWaitInSeconds );
 
 const char CPL_DLL *CPLGetThreadingModel();
@@ -108,6 +118,7 @@ class CPL_DLL CPLMutexHolder
 #define CTLS_VERSIONINFO_LICENCE       13         /* gdal_misc.cpp */
 #define CTLS_CONFIGOPTIONS             14         /* cpl_conv.cpp */
 #define CTLS_FINDFILE                  15         /* cpl_findfile.cpp */
+#define CTLS_WIN32_COND                16         /* cpl_multiproc.cpp */
 
 #define CTLS_MAX                       32         
 
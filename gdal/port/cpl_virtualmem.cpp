@@ -0,0 +1,969 @@
+/**********************************************************************
+ * $Id$
+ *
+ * Project:  CPL - Common Portability Library
+ * Purpose:  Virtual memory
+ **********************************************************************
+ * Copyright (c) 2012, GDAL project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "cpl_virtualmem.h"
+#include "cpl_error.h"
+#include "cpl_conv.h"
+#include "cpl_multiproc.h"
+
+CPL_CVSID("$Id$");
+
+/* Mappings filled on-the-fly rely on a SIGSEGV handler that needs to know */
+/* whether the faulting access was a write, which is only decoded on */
+/* Linux x86/x86_64. */
+#if defined(__linux) && (defined(__x86_64__) || defined(__i386__)) \
+    && defined(CPL_MULTIPROC_PTHREAD)
+#define HAVE_VIRTUAL_MEM_VMA
+#endif
+
+#if !defined(WIN32) && !defined(WIN32CE)
+#define HAVE_MMAP
+#endif
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#ifdef HAVE_VIRTUAL_MEM_VMA
+#include <signal.h>
+#include <ucontext.h>
+#include <pthread.h>
+#endif
+
+#define PAGE_UNMAPPED      0
+#define PAGE_MAPPED        1
+#define PAGE_MAPPED_DIRTY  2
+
+struct CPLVirtualMem
+{
+    int                         bFileMemoryMapped;
+    CPLVirtualMemAccessMode     eAccessMode;
+    size_t                      nPageSize;
+
+    GByte                      *pData;        /* start of the exposed range */
+    GByte                      *pDataToFree;  /* start of the mapping */
+    size_t                      nSize;        /* size of the exposed range */
+    size_t                      nMappedSize;  /* size of the mapping */
+
+    /* Members below are only used by mappings filled on-the-fly */
+    GByte                      *pabyPageState;
+    size_t                     *panCachedPages; /* FIFO of mapped pages */
+    size_t                      nCachedPages;
+    size_t                      iFirstCachedPage;
+    size_t                      nMaxCachedPages;
+
+    CPLVirtualMemCachePageCbk   pfnCachePage;
+    CPLVirtualMemUnCachePageCbk pfnUnCachePage;
+    CPLVirtualMemFreeUserData   pfnFreeUserData;
+    void                       *pCbkUserData;
+};
+
+/************************************************************************/
+/*                           CPLGetPageSize()                           */
+/************************************************************************/
+
+/**
+ * \brief Return the size of a page of virtual memory.
+ *
+ * @return the page size, or 0 if virtual memory is not supported.
+ * @since GDAL 1.9.0
+ */
+
+size_t CPLGetPageSize( void )
+
+{
+#ifdef HAVE_MMAP
+    return (size_t) sysconf( _SC_PAGESIZE );
+#else
+    return 0;
+#endif
+}
+
+#ifdef HAVE_VIRTUAL_MEM_VMA
+
+/* ==================================================================== */
+/*      Virtual memory manager.                                         */
+/*                                                                      */
+/*      Accesses to a page not mapped yet raise SIGSEGV. The handler    */
+/*      forwards the faulting address to a helper thread, through a     */
+/*      pipe, and waits for its answer. The helper thread runs the      */
+/*      callbacks, which are not restricted to async-signal-safe        */
+/*      functions, and atomically moves the filled page in place.       */
+/*      A third pipe holding a single token serializes the faulting     */
+/*      threads.                                                        */
+/* ==================================================================== */
+
+typedef struct
+{
+    void        *pFaultAddr;
+    int          bWriteAccess;
+} CPLVirtualMemMsgToWorkerThread;
+
+#define MAPPING_FOUND       'Y'
+#define MAPPING_NOT_FOUND   'N'
+
+typedef struct
+{
+    CPLVirtualMem     **papsVirtualMem;
+    int                 nVirtualMemCount;
+
+    int                 pipefd_to_thread[2];
+    int                 pipefd_from_thread[2];
+    int                 pipefd_wait_thread[2];
+
+    pthread_t           hHelperThreadId;
+    volatile int        bHelperThreadIdSet;
+
+    struct sigaction    oldact;
+} CPLVirtualMemManager;
+
+static CPLVirtualMemManager *psVirtualMemManager = NULL;
+static void *hVirtualMemManagerMutex = NULL;
+
+/************************************************************************/
+/*                      CPLVirtualMemPipeRead()                         */
+/*                                                                      */
+/*      Only async-signal-safe functions can be used here.              */
+/************************************************************************/
+
+static int CPLVirtualMemPipeRead( int fd, void* pData, size_t nSize )
+
+{
+    GByte* pabyData = (GByte*) pData;
+
+    while( nSize > 0 )
+    {
+        ssize_t nRead = read( fd, pabyData, nSize );
+        if( nRead < 0 && errno == EINTR )
+            continue;
+        if( nRead <= 0 )
+            return FALSE;
+        pabyData += nRead;
+        nSize -= nRead;
+    }
+    return TRUE;
+}
+
+/************************************************************************/
+/*                      CPLVirtualMemPipeWrite()                        */
+/************************************************************************/
+
+static int CPLVirtualMemPipeWrite( int fd, const void* pData, size_t nSize )
+
+{
+    const GByte* pabyData = (const GByte*) pData;
+
+    while( nSize > 0 )
+    {
+        ssize_t nWritten = write( fd, pabyData, nSize );
+        if( nWritten < 0 && errno == EINTR )
+            continue;
+        if( nWritten <= 0 )
+            return FALSE;
+        pabyData += nWritten;
+        nSize -= nWritten;
+    }
+    return TRUE;
+}
+
+/************************************************************************/
+/*                 CPLVirtualMemManagerSIGSEGVHandler()                 */
+/************************************************************************/
+
+static void CPLVirtualMemManagerSIGSEGVHandler( int nSig, siginfo_t* the_info,
+                                                void* the_ctxt )
+
+{
+    CPLVirtualMemManager *psMgr = psVirtualMemManager;
+    CPLVirtualMemMsgToWorkerThread msg;
+    char chResponse = MAPPING_NOT_FOUND;
+    char chToken;
+
+    msg.pFaultAddr = the_info->si_addr;
+    /* Bit 1 of the page fault error code is set for write accesses */
+    msg.bWriteAccess =
+        (((ucontext_t*) the_ctxt)->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+
+    /* A fault in the helper thread itself can only be serviced by the */
+    /* previous handler: waiting for the token would dead-lock. */
+    if( !(psMgr->bHelperThreadIdSet
+          && pthread_equal( pthread_self(), psMgr->hHelperThreadId )) )
+    {
+        if( CPLVirtualMemPipeRead( psMgr->pipefd_wait_thread[0],
+                                   &chToken, 1 ) )
+        {
+            if( CPLVirtualMemPipeWrite( psMgr->pipefd_to_thread[1],
+                                        &msg, sizeof(msg) ) )
+                CPLVirtualMemPipeRead( psMgr->pipefd_from_thread[0],
+                                       &chResponse, 1 );
+            CPLVirtualMemPipeWrite( psMgr->pipefd_wait_thread[1],
+                                    &chToken, 1 );
+        }
+    }
+
+    /* Return to retry the faulting instruction */
+    if( chResponse == MAPPING_FOUND )
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Not one of our pages: forward to the previous handler.  If      */
+/*      there was none, restore the default action, which will apply   */
+/*      when the faulting instruction is retried.                       */
+/* -------------------------------------------------------------------- */
+    if( psMgr->oldact.sa_flags & SA_SIGINFO )
+        psMgr->oldact.sa_sigaction( nSig, the_info, the_ctxt );
+    else if( psMgr->oldact.sa_handler == SIG_DFL
+             || psMgr->oldact.sa_handler == SIG_IGN )
+        sigaction( SIGSEGV, &(psMgr->oldact), NULL );
+    else
+        psMgr->oldact.sa_handler( nSig );
+}
+
+/************************************************************************/
+/*                        CPLVirtualMemEvictPage()                      */
+/*                                                                      */
+/*      Release the oldest mapped page, after saving it if it has been  */
+/*      written.                                                        */
+/************************************************************************/
+
+static void CPLVirtualMemEvictPage( CPLVirtualMem* ctxt )
+
+{
+    size_t iPage = ctxt->panCachedPages[ctxt->iFirstCachedPage];
+    size_t nOffset = iPage * ctxt->nPageSize;
+    GByte *pabyPage = ctxt->pData + nOffset;
+
+    ctxt->iFirstCachedPage = (ctxt->iFirstCachedPage + 1)
+                                                % ctxt->nMaxCachedPages;
+    ctxt->nCachedPages --;
+
+    if( ctxt->pabyPageState[iPage] == PAGE_MAPPED_DIRTY
+        && ctxt->pfnUnCachePage != NULL )
+    {
+        /* Writes from other threads will fault until the page is reloaded */
+        mprotect( pabyPage, ctxt->nPageSize, PROT_READ );
+        ctxt->pfnUnCachePage( ctxt, nOffset, pabyPage,
+                              MIN(ctxt->nPageSize, ctxt->nSize - nOffset),
+                              ctxt->pCbkUserData );
+    }
+
+    /* Replace by a fresh inaccessible page, which releases the memory */
+    mmap( pabyPage, ctxt->nPageSize, PROT_NONE,
+          MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0 );
+    ctxt->pabyPageState[iPage] = PAGE_UNMAPPED;
+}
+
+/************************************************************************/
+/*                        CPLVirtualMemFillPage()                       */
+/************************************************************************/
+
+static void CPLVirtualMemFillPage( CPLVirtualMem* ctxt, size_t iPage,
+                                   int bWriteAccess )
+
+{
+    size_t nOffset = iPage * ctxt->nPageSize;
+    size_t nToFill = MIN(ctxt->nPageSize, ctxt->nSize - nOffset);
+    GByte *pabyTarget = ctxt->pData + nOffset;
+    int nProt = PROT_READ;
+    GByte nState = PAGE_MAPPED;
+
+    if( ctxt->eAccessMode == VIRTUALMEM_READONLY )
+        nProt = PROT_READ | PROT_WRITE;
+    else if( ctxt->eAccessMode == VIRTUALMEM_READWRITE && bWriteAccess )
+    {
+        nProt = PROT_READ | PROT_WRITE;
+        nState = PAGE_MAPPED_DIRTY;
+    }
+
+    if( ctxt->nCachedPages == ctxt->nMaxCachedPages )
+        CPLVirtualMemEvictPage( ctxt );
+
+/* -------------------------------------------------------------------- */
+/*      Fill a temporary page and move it in place, so that other       */
+/*      threads never see a partially filled page.                      */
+/* -------------------------------------------------------------------- */
+    void *pTmp = mmap( NULL, ctxt->nPageSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    int bDone = FALSE;
+
+    if( pTmp != MAP_FAILED )
+    {
+        ctxt->pfnCachePage( ctxt, nOffset, pTmp, nToFill,
+                            ctxt->pCbkUserData );
+        mprotect( pTmp, ctxt->nPageSize, nProt );
+        if( mremap( pTmp, ctxt->nPageSize, ctxt->nPageSize,
+                    MREMAP_MAYMOVE | MREMAP_FIXED, pabyTarget ) != MAP_FAILED )
+            bDone = TRUE;
+        else
+            munmap( pTmp, ctxt->nPageSize );
+    }
+
+    if( !bDone )
+    {
+        mprotect( pabyTarget, ctxt->nPageSize, PROT_READ | PROT_WRITE );
+        ctxt->pfnCachePage( ctxt, nOffset, pabyTarget, nToFill,
+                            ctxt->pCbkUserData );
+        mprotect( pabyTarget, ctxt->nPageSize, nProt );
+    }
+
+    ctxt->pabyPageState[iPage] = nState;
+    ctxt->panCachedPages[(ctxt->iFirstCachedPage + ctxt->nCachedPages)
+                         % ctxt->nMaxCachedPages] = iPage;
+    ctxt->nCachedPages ++;
+}
+
+/************************************************************************/
+/*                   CPLVirtualMemManagerHandleFault()                  */
+/*                                                                      */
+/*      Return TRUE if the address belongs to one of our mappings and   */
+/*      the faulting instruction can be retried.                        */
+/************************************************************************/
+
+static int CPLVirtualMemManagerHandleFault( void* pAddr, int bWriteAccess )
+
+{
+    CPLMutexHolderD( &hVirtualMemManagerMutex );
+
+    for( int i = 0; i < psVirtualMemManager->nVirtualMemCount; i++ )
+    {
+        CPLVirtualMem* ctxt = psVirtualMemManager->papsVirtualMem[i];
+        GByte *pabyAddr = (GByte *) pAddr;
+
+        if( pabyAddr < ctxt->pData
+            || pabyAddr >= ctxt->pData + ctxt->nMappedSize )
+            continue;
+
+        size_t iPage = (pabyAddr - ctxt->pData) / ctxt->nPageSize;
+
+        if( bWriteAccess
+            && ctxt->eAccessMode == VIRTUALMEM_READONLY_ENFORCED )
+            return FALSE;
+
+        if( ctxt->pabyPageState[iPage] == PAGE_UNMAPPED )
+        {
+            CPLVirtualMemFillPage( ctxt, iPage, bWriteAccess );
+        }
+        else if( ctxt->pabyPageState[iPage] == PAGE_MAPPED
+                 && ctxt->eAccessMode == VIRTUALMEM_READWRITE
+                 && bWriteAccess )
+        {
+            /* First write to a page that was only read so far */
+            mprotect( ctxt->pData + iPage * ctxt->nPageSize,
+                      ctxt->nPageSize, PROT_READ | PROT_WRITE );
+            ctxt->pabyPageState[iPage] = PAGE_MAPPED_DIRTY;
+        }
+
+        /* Otherwise another thread got the page mapped in the meantime */
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/************************************************************************/
+/*                     CPLVirtualMemManagerThread()                     */
+/************************************************************************/
+
+static void CPLVirtualMemManagerThread( void* pData )
+
+{
+    CPLVirtualMemManager *psMgr = (CPLVirtualMemManager *) pData;
+
+    psMgr->hHelperThreadId = pthread_self();
+    psMgr->bHelperThreadIdSet = TRUE;
+
+    while( TRUE )
+    {
+        CPLVirtualMemMsgToWorkerThread msg;
+        char chResponse;
+
+        if( !CPLVirtualMemPipeRead( psMgr->pipefd_to_thread[0],
+                                    &msg, sizeof(msg) ) )
+            break;
+
+        chResponse = CPLVirtualMemManagerHandleFault( msg.pFaultAddr,
+                                                      msg.bWriteAccess )
+            ? MAPPING_FOUND : MAPPING_NOT_FOUND;
+
+        if( !CPLVirtualMemPipeWrite( psMgr->pipefd_from_thread[1],
+                                     &chResponse, 1 ) )
+            break;
+    }
+}
+
+/************************************************************************/
+/*                      CPLVirtualMemManagerInit()                      */
+/*                                                                      */
+/*      Lazily install the SIGSEGV handler and start the helper thread. */
+/*      Both stay alive until the end of the process.                   */
+/************************************************************************/
+
+static int CPLVirtualMemManagerInit()
+
+{
+    CPLMutexHolderD( &hVirtualMemManagerMutex );
+
+    if( psVirtualMemManager != NULL )
+        return TRUE;
+
+    CPLVirtualMemManager *psMgr = (CPLVirtualMemManager *)
+        VSICalloc( 1, sizeof(CPLVirtualMemManager) );
+    if( psMgr == NULL )
+        return FALSE;
+
+    if( pipe( psMgr->pipefd_to_thread ) != 0 )
+    {
+        VSIFree( psMgr );
+        return FALSE;
+    }
+    if( pipe( psMgr->pipefd_from_thread ) != 0 )
+    {
+        close( psMgr->pipefd_to_thread[0] );
+        close( psMgr->pipefd_to_thread[1] );
+        VSIFree( psMgr );
+        return FALSE;
+    }
+    if( pipe( psMgr->pipefd_wait_thread ) != 0 )
+    {
+        close( psMgr->pipefd_to_thread[0] );
+        close( psMgr->pipefd_to_thread[1] );
+        close( psMgr->pipefd_from_thread[0] );
+        close( psMgr->pipefd_from_thread[1] );
+        VSIFree( psMgr );
+        return FALSE;
+    }
+
+    char chToken = 'T';
+    CPLVirtualMemPipeWrite( psMgr->pipefd_wait_thread[1], &chToken, 1 );
+
+    psVirtualMemManager = psMgr;
+
+    if( CPLCreateThread( CPLVirtualMemManagerThread, psMgr ) < 0 )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "Cannot start virtual memory helper thread." );
+        psVirtualMemManager = NULL;
+        close( psMgr->pipefd_to_thread[0] );
+        close( psMgr->pipefd_to_thread[1] );
+        close( psMgr->pipefd_from_thread[0] );
+        close( psMgr->pipefd_from_thread[1] );
+        close( psMgr->pipefd_wait_thread[0] );
+        close( psMgr->pipefd_wait_thread[1] );
+        VSIFree( psMgr );
+        return FALSE;
+    }
+
+    struct sigaction act;
+    memset( &act, 0, sizeof(act) );
+    act.sa_sigaction = CPLVirtualMemManagerSIGSEGVHandler;
+    sigemptyset( &act.sa_mask );
+    act.sa_flags = SA_SIGINFO;
+    sigaction( SIGSEGV, &act, &(psMgr->oldact) );
+
+    return TRUE;
+}
+
+#endif /* HAVE_VIRTUAL_MEM_VMA */
+
+/************************************************************************/
+/*                     CPLIsVirtualMemAvailable()                       */
+/************************************************************************/
+
+/**
+ * \brief Return if virtual memory mappings filled on-the-fly, as created
+ * by CPLVirtualMemNew(), are available on this platform.
+ *
+ * @return TRUE if CPLVirtualMemNew() can be used.
+ * @since GDAL 1.9.0
+ */
+
+int CPLIsVirtualMemAvailable( void )
+
+{
+#ifdef HAVE_VIRTUAL_MEM_VMA
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/************************************************************************/
+/*                          CPLVirtualMemNew()                          */
+/************************************************************************/
+
+/**
+ * \brief Create a new virtual memory mapping.
+ *
+ * This will reserve an area of virtual memory of size nSize, whose size
+ * might be potentially much larger than the physical memory available.
+ * Initially, no physical memory will be allocated. As soon as memory pages
+ * will be accessed, they will be allocated transparently and filled with
+ * the pfnCachePage callback. When the allowed cache size is reached, the
+ * least recently mapped pages will be unallocated, after pfnUnCachePage
+ * has been called for the pages that have been written.
+ *
+ * The callbacks are run from an internal helper thread, one page at a
+ * time. They must not access any virtual memory mapping filled on-the-fly
+ * themselves.
+ *
+ * This is only supported on Linux x86 and x86_64 currently. See
+ * CPLIsVirtualMemAvailable().
+ *
+ * @param nSize size in bytes of the virtual memory mapping.
+ * @param nCacheSize size in bytes of the maximum memory that will be really
+ *                   allocated (must ideally fit into RAM). At least two
+ *                   pages are always kept mapped.
+ * @param nPageSizeHint hint for the page size. Will be rounded up to a
+ *                      multiple of the system page size. Can be 0.
+ * @param eAccessMode permission to use for the virtual memory mapping.
+ * @param pfnCachePage callback triggered when a still unmapped page of
+ *                     virtual memory is accessed.
+ * @param pfnUnCachePage callback triggered when a written page of virtual
+ *                       memory is going to be evicted. Can be NULL for
+ *                       read-only mappings.
+ * @param pfnFreeUserData callback that can be used to free pCbkUserData.
+ *                        Might be NULL.
+ * @param pCbkUserData user data passed to pfnCachePage and pfnUnCachePage.
+ *
+ * @return a virtual memory object that must be freed by CPLVirtualMemFree(),
+ *         or NULL in case of failure.
+ *
+ * @since GDAL 1.9.0
+ */
+
+CPLVirtualMem *CPLVirtualMemNew( size_t nSize,
+                                 size_t nCacheSize,
+                                 size_t nPageSizeHint,
+                                 CPLVirtualMemAccessMode eAccessMode,
+                                 CPLVirtualMemCachePageCbk pfnCachePage,
+                                 CPLVirtualMemUnCachePageCbk pfnUnCachePage,
+                                 CPLVirtualMemFreeUserData pfnFreeUserData,
+                                 void *pCbkUserData )
+
+{
+#ifdef HAVE_VIRTUAL_MEM_VMA
+    size_t nMinPageSize = CPLGetPageSize();
+    size_t nPageSize = nMinPageSize;
+
+    CPLAssert( nSize > 0 );
+    CPLAssert( pfnCachePage != NULL );
+
+    if( nPageSizeHint > nMinPageSize )
+        nPageSize = (nPageSizeHint + nMinPageSize - 1)
+                                        / nMinPageSize * nMinPageSize;
+
+    if( !CPLVirtualMemManagerInit() )
+        return NULL;
+
+    size_t nPages = (nSize + nPageSize - 1) / nPageSize;
+    void *pData = mmap( NULL, nPages * nPageSize, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    if( pData == MAP_FAILED )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "mmap() failed : %s", strerror(errno) );
+        return NULL;
+    }
+
+    CPLVirtualMem *ctxt = (CPLVirtualMem *)
+        VSICalloc( 1, sizeof(CPLVirtualMem) );
+    size_t nMaxCachedPages = MIN( nPages, MAX( 2, nCacheSize / nPageSize ) );
+
+    if( ctxt != NULL )
+    {
+        ctxt->pabyPageState = (GByte *) VSICalloc( nPages, 1 );
+        ctxt->panCachedPages = (size_t *)
+            VSIMalloc2( nMaxCachedPages, sizeof(size_t) );
+    }
+    if( ctxt == NULL || ctxt->pabyPageState == NULL
+        || ctxt->panCachedPages == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Cannot allocate virtual memory mapping state." );
+        if( ctxt != NULL )
+        {
+            VSIFree( ctxt->pabyPageState );
+            VSIFree( ctxt->panCachedPages );
+            VSIFree( ctxt );
+        }
+        munmap( pData, nPages * nPageSize );
+        return NULL;
+    }
+
+    ctxt->bFileMemoryMapped = FALSE;
+    ctxt->eAccessMode = eAccessMode;
+    ctxt->nPageSize = nPageSize;
+    ctxt->pData = (GByte *) pData;
+    ctxt->pDataToFree = (GByte *) pData;
+    ctxt->nSize = nSize;
+    ctxt->nMappedSize = nPages * nPageSize;
+    ctxt->nMaxCachedPages = nMaxCachedPages;
+    ctxt->pfnCachePage = pfnCachePage;
+    ctxt->pfnUnCachePage = pfnUnCachePage;
+    ctxt->pfnFreeUserData = pfnFreeUserData;
+    ctxt->pCbkUserData = pCbkUserData;
+
+    CPLMutexHolderD( &hVirtualMemManagerMutex );
+
+    CPLVirtualMem **papsNew = (CPLVirtualMem **)
+        VSIRealloc( psVirtualMemManager->papsVirtualMem,
+                    sizeof(CPLVirtualMem*)
+                    * (psVirtualMemManager->nVirtualMemCount + 1) );
+    if( papsNew == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Cannot register virtual memory mapping." );
+        VSIFree( ctxt->pabyPageState );
+        VSIFree( ctxt->panCachedPages );
+        VSIFree( ctxt );
+        munmap( pData, nPages * nPageSize );
+        return NULL;
+    }
+    psVirtualMemManager->papsVirtualMem = papsNew;
+    papsNew[psVirtualMemManager->nVirtualMemCount++] = ctxt;
+
+    return ctxt;
+#else
+    CPLError( CE_Failure, CPLE_NotSupported,
+              "CPLVirtualMemNew() unsupported on this operating system "
+              "or architecture." );
+    return NULL;
+#endif
+}
+
+/************************************************************************/
+/*                   CPLIsVirtualMemFileMapAvailable()                  */
+/************************************************************************/
+
+/**
+ * \brief Return if virtual memory mapping of a file is available.
+ *
+ * @return TRUE if virtual memory mapping of a file is available.
+ * @since GDAL 1.9.0
+ */
+
+int CPLIsVirtualMemFileMapAvailable( void )
+
+{
+#ifdef HAVE_MMAP
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/************************************************************************/
+/*                       CPLVirtualMemFileMapNew()                      */
+/************************************************************************/
+
+/**
+ * \brief Create a new virtual memory mapping from a file.
+ *
+ * The file must be a "real" file recognized by the operating system, and
+ * not a VSI extended virtual file.
+ *
+ * In VIRTUALMEM_READWRITE mode, updates to the memory mapping will be
+ * written in the file.
+ *
+ * On Linux AMD64 platforms, the maximum value for nLength is 128 TB.
+ * On Linux x86 platforms, the maximum value for nLength is 2 GB.
+ *
+ * Only supported on POSIX systems currently. See
+ * CPLIsVirtualMemFileMapAvailable().
+ *
+ * @param  fp       Virtual file handle.
+ * @param  nOffset  Offset in the file to start the mapping from.
+ * @param  nLength  Length of the portion of the file to map into memory.
+ * @param eAccessMode Permission to use for the virtual memory mapping. This
+ *                    must be consistent with how the file has been opened.
+ * @param pfnFreeUserData callback that is called when the object is
+ *                        destroyed.
+ * @param pCbkUserData user data passed to pfnFreeUserData.
+ * @return a virtual memory object that must be freed by CPLVirtualMemFree(),
+ *         or NULL in case of failure.
+ *
+ * @since GDAL 1.9.0
+ */
+
+CPLVirtualMem *CPLVirtualMemFileMapNew( VSILFILE* fp,
+                                        vsi_l_offset nOffset,
+                                        vsi_l_offset nLength,
+                                        CPLVirtualMemAccessMode eAccessMode,
+                                        CPLVirtualMemFreeUserData pfnFreeUserData,
+                                        void *pCbkUserData )
+
+{
+#ifdef HAVE_MMAP
+    int fd = (int) (size_t) VSIFGetNativeFileDescriptorL( fp );
+    if( fd == 0 )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "Cannot operate on a virtual file" );
+        return NULL;
+    }
+
+    size_t nPageSize = CPLGetPageSize();
+    vsi_l_offset nAlignedOffset = nOffset / nPageSize * nPageSize;
+    size_t nAlignment = (size_t) (nOffset - nAlignedOffset);
+    vsi_l_offset nMappedSize = nLength + nAlignment;
+
+    if( nLength == 0 || nMappedSize != (size_t) nMappedSize
+        || nAlignedOffset != (vsi_l_offset) (off_t) nAlignedOffset )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "Cannot map " CPL_FRMT_GUIB " bytes at offset "
+                  CPL_FRMT_GUIB " in the address space.",
+                  nLength, nOffset );
+        return NULL;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Pending buffered writes must reach the file, and the mapping    */
+/*      must not extend past its end.                                   */
+/* -------------------------------------------------------------------- */
+    VSIFFlushL( fp );
+
+    vsi_l_offset nCurPos = VSIFTellL( fp );
+    VSIFSeekL( fp, 0, SEEK_END );
+    vsi_l_offset nFileSize = VSIFTellL( fp );
+    VSIFSeekL( fp, nCurPos, SEEK_SET );
+
+    if( nFileSize < nOffset + nLength )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "Trying to map an extent outside of the file" );
+        return NULL;
+    }
+
+    void *addr = mmap( NULL, (size_t) nMappedSize,
+                       eAccessMode == VIRTUALMEM_READONLY_ENFORCED
+                       ? PROT_READ : PROT_READ | PROT_WRITE,
+                       eAccessMode == VIRTUALMEM_READWRITE
+                       ? MAP_SHARED : MAP_PRIVATE,
+                       fd, (off_t) nAlignedOffset );
+    if( addr == MAP_FAILED )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "mmap() failed : %s", strerror(errno) );
+        return NULL;
+    }
+
+    CPLVirtualMem *ctxt = (CPLVirtualMem *)
+        VSICalloc( 1, sizeof(CPLVirtualMem) );
+    if( ctxt == NULL )
+    {
+        munmap( addr, (size_t) nMappedSize );
+        return NULL;
+    }
+
+    ctxt->bFileMemoryMapped = TRUE;
+    ctxt->eAccessMode = eAccessMode;
+    ctxt->nPageSize = nPageSize;
+    ctxt->pDataToFree = (GByte *) addr;
+    ctxt->pData = (GByte *) addr + nAlignment;
+    ctxt->nSize = (size_t) nLength;
+    ctxt->nMappedSize = (size_t) nMappedSize;
+    ctxt->pfnFreeUserData = pfnFreeUserData;
+    ctxt->pCbkUserData = pCbkUserData;
+
+    return ctxt;
+#else
+    CPLError( CE_Failure, CPLE_NotSupported,
+              "CPLVirtualMemFileMapNew() unsupported on this "
+              "operating system." );
+    return NULL;
+#endif
+}
+
+/************************************************************************/
+/*                         CPLVirtualMemFree()                          */
+/************************************************************************/
+
+/**
+ * \brief Free a virtual memory mapping.
+ *
+ * The pointer returned by CPLVirtualMemGetAddr() will no longer be valid.
+ * For mappings filled on-the-fly, pfnUnCachePage is first called for the
+ * pages that have been written.
+ *
+ * @param ctxt context returned by CPLVirtualMemNew() or
+ *             CPLVirtualMemFileMapNew().
+ * @since GDAL 1.9.0
+ */
+
+void CPLVirtualMemFree( CPLVirtualMem* ctxt )
+
+{
+    if( ctxt == NULL )
+        return;
+
+#ifdef HAVE_MMAP
+    if( ctxt->bFileMemoryMapped )
+    {
+        munmap( ctxt->pDataToFree, ctxt->nMappedSize );
+    }
+#endif
+
+#ifdef HAVE_VIRTUAL_MEM_VMA
+    if( !ctxt->bFileMemoryMapped )
+    {
+        CPLMutexHolderD( &hVirtualMemManagerMutex );
+
+        for( int i = 0; i < psVirtualMemManager->nVirtualMemCount; i++ )
+        {
+            if( psVirtualMemManager->papsVirtualMem[i] == ctxt )
+            {
+                psVirtualMemManager->papsVirtualMem[i] =
+                    psVirtualMemManager->papsVirtualMem[
+                        psVirtualMemManager->nVirtualMemCount - 1];
+                psVirtualMemManager->nVirtualMemCount --;
+                break;
+            }
+        }
+
+        while( ctxt->nCachedPages > 0 )
+            CPLVirtualMemEvictPage( ctxt );
+
+        munmap( ctxt->pDataToFree, ctxt->nMappedSize );
+        VSIFree( ctxt->pabyPageState );
+        VSIFree( ctxt->panCachedPages );
+    }
+#endif
+
+    if( ctxt->pfnFreeUserData != NULL )
+        ctxt->pfnFreeUserData( ctxt->pCbkUserData );
+
+    VSIFree( ctxt );
+}
+
+/************************************************************************/
+/*                       CPLVirtualMemGetAddr()                         */
+/************************************************************************/
+
+/**
+ * \brief Return the pointer to the start of a virtual memory mapping.
+ *
+ * The bytes in the range [p:p+CPLVirtualMemGetSize()-1] where p is the
+ * pointer returned by this function will be valid, until
+ * CPLVirtualMemFree() is called.
+ *
+ * @param ctxt context returned by CPLVirtualMemNew() or
+ *             CPLVirtualMemFileMapNew().
+ * @return the pointer to the start of a virtual memory mapping.
+ * @since GDAL 1.9.0
+ */
+
+void *CPLVirtualMemGetAddr( CPLVirtualMem* ctxt )
+
+{
+    return ctxt->pData;
+}
+
+/************************************************************************/
+/*                       CPLVirtualMemGetSize()                         */
+/************************************************************************/
+
+/**
+ * \brief Return the size of the virtual memory mapping.
+ *
+ * @param ctxt context returned by CPLVirtualMemNew() or
+ *             CPLVirtualMemFileMapNew().
+ * @return the size of the virtual memory mapping.
+ * @since GDAL 1.9.0
+ */
+
+size_t CPLVirtualMemGetSize( CPLVirtualMem* ctxt )
+
+{
+    return ctxt->nSize;
+}
+
+/************************************************************************/
+/*                     CPLVirtualMemIsFileMapping()                     */
+/************************************************************************/
+
+/**
+ * \brief Return if the virtual memory mapping is a direct file mapping.
+ *
+ * @param ctxt context returned by CPLVirtualMemNew() or
+ *             CPLVirtualMemFileMapNew().
+ * @return TRUE if the virtual memory mapping is a direct file mapping.
+ * @since GDAL 1.9.0
+ */
+
+int CPLVirtualMemIsFileMapping( CPLVirtualMem* ctxt )
+
+{
+    return ctxt->bFileMemoryMapped;
+}
+
+/************************************************************************/
+/*                     CPLVirtualMemGetAccessMode()                     */
+/************************************************************************/
+
+/**
+ * \brief Return the access mode of the virtual memory mapping.
+ *
+ * @param ctxt context returned by CPLVirtualMemNew() or
+ *             CPLVirtualMemFileMapNew().
+ * @return the access mode of the virtual memory mapping.
+ * @since GDAL 1.9.0
+ */
+
+CPLVirtualMemAccessMode CPLVirtualMemGetAccessMode( CPLVirtualMem* ctxt )
+
+{
+    return ctxt->eAccessMode;
+}
+
+/************************************************************************/
+/*                      CPLVirtualMemGetPageSize()                      */
+/************************************************************************/
+
+/**
+ * \brief Return the page size associated to a virtual memory mapping.
+ *
+ * The value returned will be at least CPLGetPageSize(), but potentially
+ * larger.
+ *
+ * @param ctxt context returned by CPLVirtualMemNew() or
+ *             CPLVirtualMemFileMapNew().
+ * @return the page size
+ * @since GDAL 1.9.0
+ */
+
+size_t CPLVirtualMemGetPageSize( CPLVirtualMem* ctxt )
+
+{
+    return ctxt->nPageSize;
+}
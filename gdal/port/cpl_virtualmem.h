@@ -0,0 +1,147 @@
+/**********************************************************************
+ * $Id$
+ *
+ * Project:  CPL - Common Portability Library
+ * Purpose:  Virtual memory
+ **********************************************************************
+ * Copyright (c) 2012, GDAL project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef _CPL_VIRTUAL_MEM_INCLUDED
+#define _CPL_VIRTUAL_MEM_INCLUDED
+
+#include "cpl_port.h"
+#include "cpl_vsi.h"
+
+/**
+ * \file cpl_virtualmem.h
+ *
+ * Virtual memory management.
+ *
+ * This file provides mechanisms to define virtual memory mappings, whose
+ * content is allocated transparently and filled on-the-fly. Those virtual
+ * memory mappings can be much larger than the available RAM, but only
+ * parts of the virtual memory mapping, in the limit of the allowed
+ * cache size, will actually be physically allocated.
+ *
+ * This exploits low-level mechanisms of the operating system (virtual
+ * memory allocation, page protection and handler of virtual memory
+ * exceptions).
+ *
+ * It is also possible to create a virtual memory mapping from a file or
+ * part of a file.
+ *
+ * The current implementation is Linux only for mappings filled on-the-fly,
+ * and POSIX for file mappings.
+ *
+ * @since GDAL 1.9.0
+ */
+
+CPL_C_START
+
+/** Opaque type that represents a virtual memory mapping. */
+typedef struct CPLVirtualMem CPLVirtualMem;
+
+/** Callback triggered when a still unmapped page of virtual memory is
+ * accessed. The callback has the responsibility of filling the page with
+ * relevant values.
+ *
+ * @param ctxt virtual memory handle.
+ * @param nOffset offset of the page in the memory mapping.
+ * @param pPageToFill address of the page to fill. Note that the address
+ *                    might be a temporary location, and not at
+ *                    CPLVirtualMemGetAddr() + nOffset.
+ * @param nToFill number of bytes of the page.
+ * @param pUserData user data that was passed to CPLVirtualMemNew().
+ */
+typedef void (*CPLVirtualMemCachePageCbk)( CPLVirtualMem* ctxt,
+                                           size_t nOffset,
+                                           void* pPageToFill,
+                                           size_t nToFill,
+                                           void* pUserData );
+
+/** Callback triggered when a page of virtual memory that has been written
+ * is going to be evicted, or when the mapping is freed.
+ *
+ * @param ctxt virtual memory handle.
+ * @param nOffset offset of the page in the memory mapping.
+ * @param pPageToBeEvicted address of the page that will be flushed.
+ * @param nToBeEvicted number of bytes of the page.
+ * @param pUserData user data that was passed to CPLVirtualMemNew().
+ */
+typedef void (*CPLVirtualMemUnCachePageCbk)( CPLVirtualMem* ctxt,
+                                             size_t nOffset,
+                                             const void* pPageToBeEvicted,
+                                             size_t nToBeEvicted,
+                                             void* pUserData );
+
+/** Callback triggered when a virtual memory mapping is destroyed.
+ * @param pUserData user data that was passed to CPLVirtualMemNew().
+ */
+typedef void (*CPLVirtualMemFreeUserData)( void* pUserData );
+
+/** Access mode of a virtual memory mapping. */
+typedef enum
+{
+    /*! The mapping is meant at being read-only, but writes will not be
+        prevented. Note that any content written will be lost. */
+    VIRTUALMEM_READONLY,
+    /*! The mapping is meant at being read-only, and this will be enforced
+        through the operating system page protection mechanism. */
+    VIRTUALMEM_READONLY_ENFORCED,
+    /*! The mapping is meant at being read-write, and modified pages can be
+        saved thanks to the pfnUnCachePage callback */
+    VIRTUALMEM_READWRITE
+} CPLVirtualMemAccessMode;
+
+size_t CPL_DLL CPLGetPageSize( void );
+
+int CPL_DLL CPLIsVirtualMemAvailable( void );
+
+CPLVirtualMem CPL_DLL *CPLVirtualMemNew( size_t nSize,
+                                         size_t nCacheSize,
+                                         size_t nPageSizeHint,
+                                         CPLVirtualMemAccessMode eAccessMode,
+                                         CPLVirtualMemCachePageCbk pfnCachePage,
+                                         CPLVirtualMemUnCachePageCbk pfnUnCachePage,
+                                         CPLVirtualMemFreeUserData pfnFreeUserData,
+                                         void *pCbkUserData );
+
+int CPL_DLL CPLIsVirtualMemFileMapAvailable( void );
+
+CPLVirtualMem CPL_DLL *CPLVirtualMemFileMapNew( VSILFILE* fp,
+                                                vsi_l_offset nOffset,
+                                                vsi_l_offset nLength,
+                                                CPLVirtualMemAccessMode eAccessMode,
+                                                CPLVirtualMemFreeUserData pfnFreeUserData,
+                                                void *pCbkUserData );
+
+void CPL_DLL *CPLVirtualMemGetAddr( CPLVirtualMem* ctxt );
+size_t CPL_DLL CPLVirtualMemGetSize( CPLVirtualMem* ctxt );
+int CPL_DLL CPLVirtualMemIsFileMapping( CPLVirtualMem* ctxt );
+CPLVirtualMemAccessMode CPL_DLL CPLVirtualMemGetAccessMode( CPLVirtualMem* ctxt );
+size_t CPL_DLL CPLVirtualMemGetPageSize( CPLVirtualMem* ctxt );
+
+void CPL_DLL CPLVirtualMemFree( CPLVirtualMem* ctxt );
+
+CPL_C_END
+
+#endif /* _CPL_VIRTUAL_MEM_INCLUDED */
@@ -141,10 +141,15 @@ int CPL_DLL     VSIFSeekL( VSILFILE *, vsi_l_offset, int );
 vsi_l_offset CPL_DLL VSIFTellL( VSILFILE * );
 void CPL_DLL    VSIRewindL( VSILFILE * );
 size_t CPL_DLL  VSIFReadL( void *, size_t, size_t, VSILFILE * );
+int CPL_DLL     VSIFReadMultiRangeL( int nRanges, void ** ppData,
+                                     const vsi_l_offset* panOffsets,
+                                     const size_t* panSizes,
+                                     VSILFILE * );
 size_t CPL_DLL  VSIFWriteL( const void *, size_t, size_t, VSILFILE * );
 int CPL_DLL     VSIFEofL( VSILFILE * );
 int CPL_DLL     VSIFTruncateL( VSILFILE *, vsi_l_offset );
 int CPL_DLL     VSIFFlushL( VSILFILE * );
+void CPL_DLL   *VSIFGetNativeFileDescriptorL( VSILFILE * );
 int CPL_DLL     VSIFPrintfL( VSILFILE *, const char *, ... ) CPL_PRINT_FUNC_FORMAT(2, 3);
 int CPL_DLL     VSIFPutcL( int, VSILFILE * );
 
@@ -218,6 +223,7 @@ void VSIInstallStdinHandler(void); /* No reason to export that */
 void VSIInstallStdoutHandler(void); /* No reason to export that */
 void CPL_DLL VSIInstallSparseFileHandler(void);
 void VSIInstallTarFileHandler(void); /* No reason to export that */
+void VSIInstallCacheFileHandler(void); /* No reason to export that */
 void CPL_DLL VSICleanupFileManager(void);
 
 VSILFILE CPL_DLL *VSIFileFromMemBuffer( const char *pszFilename,
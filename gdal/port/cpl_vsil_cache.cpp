@@ -28,16 +28,23 @@
  ****************************************************************************/
 
 #include "cpl_vsi_virtual.h"
+#include "cpl_multiproc.h"
+#include "cpl_hash_set.h"
 
 CPL_CVSID("$Id$");
 
+#define DEFAULT_CHUNK_SIZE  32768
+
+/* Maximum size of a single read on the base file */
+#define MAX_LOAD_SIZE       (1024 * 1024)
+
 /************************************************************************/
 /* ==================================================================== */
 /*                             VSICacheChunk                            */
 /* ==================================================================== */
 /************************************************************************/
 
-#define CHUNK_SIZE  32768
+class VSICacheData;
 
 class VSICacheChunk
 {
@@ -45,66 +52,105 @@ public:
     VSICacheChunk() { 
         poLRUPrev = poLRUNext = NULL;
         nDataFilled = 0;
-        bDirty = FALSE;
+        pabyData = NULL;
+        poOwner = NULL;
     }
+    ~VSICacheChunk() { CPLFree( pabyData ); }
 
-    int            bDirty;
-    size_t         iBlock;
+    vsi_l_offset   iBlock;
+    VSICacheData  *poOwner;
 
     VSICacheChunk *poLRUPrev;
     VSICacheChunk *poLRUNext;
 
-    vsi_l_offset   nDataFilled;
-    GByte          abyData[CHUNK_SIZE];
+    size_t         nDataFilled;
+    GByte         *pabyData;
 };
 
+/************************************************************************/
+/*                    VSICacheChunkHash() / Equal()                     */
+/************************************************************************/
+
+static unsigned long VSICacheChunkHash( const void *elt )
+{
+    const VSICacheChunk *poBlock = (const VSICacheChunk *) elt;
+    return (unsigned long) (poBlock->iBlock ^ (poBlock->iBlock >> 32));
+}
+
+static int VSICacheChunkEqual( const void *elt1, const void *elt2 )
+{
+    return ((const VSICacheChunk *) elt1)->iBlock ==
+           ((const VSICacheChunk *) elt2)->iBlock;
+}
+
 /************************************************************************/
 /* ==================================================================== */
-/*                             VSICachedFile                            */
+/*                              VSICacheLRU                             */
+/*                                                                      */
+/*      The LRU list and byte budget shared by the caches of all the    */
+/*      files opened through /vsicache/.  Its mutex protects the        */
+/*      list and all these caches.                                      */
 /* ==================================================================== */
 /************************************************************************/
 
-class VSICachedFile : public VSIVirtualHandle
-{ 
+class VSICacheLRU
+{
   public:
-    VSICachedFile( VSIVirtualHandle * );
-    ~VSICachedFile() { Close(); }
+    VSICacheLRU();
+    ~VSICacheLRU();
 
-    void          FlushLRU();
-    int           LoadBlocks( size_t nStartBlock, size_t nBlockCount, 
-                              void *pBuffer, size_t nBufferSize );
     void          Demote( VSICacheChunk * );
+    void          Unlink( VSICacheChunk * );
+    void          FlushLRU();
 
-    VSIVirtualHandle *poBase;
-    
-    vsi_l_offset  nOffset;
-    vsi_l_offset  nFileSize;
+    void         *hMutex;
 
     GUIntBig      nCacheUsed;
     GUIntBig      nCacheMax;
 
     VSICacheChunk *poLRUStart;
     VSICacheChunk *poLRUEnd;
+};
+
+/************************************************************************/
+/* ==================================================================== */
+/*                             VSICacheData                             */
+/*                                                                      */
+/*      The cached chunks of one file.  Handles opened on the same      */
+/*      file through /vsicache/ share it, possibly from several         */
+/*      threads, so all accesses are done under the mutex of its LRU.   */
+/* ==================================================================== */
+/************************************************************************/
 
-    std::vector<VSICacheChunk*> apoCache;
+class VSICacheData
+{
+  public:
+    VSICacheData( VSICacheLRU *poLRU );
+    ~VSICacheData();
 
-    virtual int       Seek( vsi_l_offset nOffset, int nWhence );
-    virtual vsi_l_offset Tell();
-    virtual size_t    Read( void *pBuffer, size_t nSize, size_t nMemb );
-    virtual size_t    Write( const void *pBuffer, size_t nSize, size_t nMemb );
-    virtual int       Eof();
-    virtual int       Flush();
-    virtual int       Close();
+    VSICacheChunk *GetChunk( vsi_l_offset iBlock, int bTouch );
+    void          AddChunk( vsi_l_offset iBlock, const GByte *pabyData,
+                            size_t nDataFilled );
+
+    VSICacheLRU  *poLRU;
+    int           bOwnLRU;
+
+    int           nRefCount;
+    CPLString     osFilename;
+
+    size_t        nChunkSize;
+
+    CPLHashSet   *hChunks;
 };
 
 /************************************************************************/
-/*                           VSICachedFile()                            */
+/*                            VSICacheLRU()                             */
 /************************************************************************/
 
-VSICachedFile::VSICachedFile( VSIVirtualHandle *poBaseHandle )
+VSICacheLRU::VSICacheLRU()
 
 {
-    poBase = poBaseHandle;
+    hMutex = NULL;
 
     nCacheUsed = 0;
     nCacheMax = CPLScanUIntBig( 
@@ -112,243 +158,435 @@ VSICachedFile::VSICachedFile( VSIVirtualHandle *poBaseHandle )
 
     poLRUStart = NULL;
     poLRUEnd = NULL;
+}
 
-    poBase->Seek( 0, SEEK_END );
-    nFileSize = poBase->Tell();
+/************************************************************************/
+/*                            ~VSICacheLRU()                            */
+/************************************************************************/
 
-    nOffset = 0;
+VSICacheLRU::~VSICacheLRU()
+
+{
+    CPLAssert( poLRUStart == NULL );
+
+    if( hMutex != NULL )
+        CPLDestroyMutex( hMutex );
 }
 
 /************************************************************************/
-/*                               Close()                                */
+/*                               Demote()                               */
+/*                                                                      */
+/*      Demote the indicated block to the end of the LRU list.          */
+/*      Potentially integrate the link into the list if it is not       */
+/*      already there.                                                  */
 /************************************************************************/
 
-int VSICachedFile::Close()
+void VSICacheLRU::Demote( VSICacheChunk *poBlock )
 
 {
-    size_t i;
-    for( i = 0; i < apoCache.size(); i++ )
-        delete apoCache[i];
-
-    apoCache.resize( 0 );
+    // already at end?
+    if( poLRUEnd == poBlock )
+        return;
+    
+    if( poLRUStart == poBlock )
+        poLRUStart = poBlock->poLRUNext;
 
-    poLRUStart = NULL;
-    poLRUEnd = NULL;
+    if( poBlock->poLRUPrev != NULL )
+        poBlock->poLRUPrev->poLRUNext = poBlock->poLRUNext;
 
-    nCacheUsed = 0;
+    if( poBlock->poLRUNext != NULL )
+        poBlock->poLRUNext->poLRUPrev = poBlock->poLRUPrev;
 
-    if( poBase )
-    {
-        poBase->Close();
-        delete poBase;
-        poBase = NULL;
-    }
+    poBlock->poLRUNext = NULL;
+    poBlock->poLRUPrev = poLRUEnd;
 
-    return 0;
+    if( poLRUEnd != NULL )
+        poLRUEnd->poLRUNext = poBlock;
+    poLRUEnd = poBlock;
+    
+    if( poLRUStart == NULL )
+        poLRUStart = poBlock;
 }
 
 /************************************************************************/
-/*                                Seek()                                */
+/*                               Unlink()                               */
+/*                                                                      */
+/*      Remove a block from the LRU list and from the budget.           */
 /************************************************************************/
 
-int VSICachedFile::Seek( vsi_l_offset nReqOffset, int nWhence )
+void VSICacheLRU::Unlink( VSICacheChunk *poBlock )
 
 {
-    if( nWhence == SEEK_SET )
-    {
-        // use offset directly.
-    }
+    CPLAssert( nCacheUsed >= poBlock->nDataFilled );
 
-    else if( nWhence == SEEK_CUR )
-    {
-        nReqOffset += nOffset;
-    }
+    nCacheUsed -= poBlock->nDataFilled;
 
-    else if( nWhence == SEEK_END )
-    {
-        nReqOffset += nFileSize;
-    }
+    if( poLRUStart == poBlock )
+        poLRUStart = poBlock->poLRUNext;
+    if( poLRUEnd == poBlock )
+        poLRUEnd = poBlock->poLRUPrev;
 
-    nOffset = nReqOffset;
+    if( poBlock->poLRUPrev != NULL )
+        poBlock->poLRUPrev->poLRUNext = poBlock->poLRUNext;
+    if( poBlock->poLRUNext != NULL )
+        poBlock->poLRUNext->poLRUPrev = poBlock->poLRUPrev;
 
-    return 0;
+    poBlock->poLRUPrev = poBlock->poLRUNext = NULL;
 }
 
 /************************************************************************/
-/*                                Tell()                                */
+/*                              FlushLRU()                              */
+/*                                                                      */
+/*      Discard the least recently used block, whichever file it        */
+/*      belongs to.                                                     */
 /************************************************************************/
 
-vsi_l_offset VSICachedFile::Tell()
+void VSICacheLRU::FlushLRU()
 
 {
-    return nOffset;
+    CPLAssert( poLRUStart != NULL );
+
+    VSICacheChunk *poBlock = poLRUStart;
+
+    Unlink( poBlock );
+    CPLHashSetRemove( poBlock->poOwner->hChunks, poBlock );
+
+    delete poBlock;
 }
 
 /************************************************************************/
-/*                              FlushLRU()                              */
+/*                            VSICacheData()                            */
+/*                                                                      */
+/*      If poLRU is NULL, the cache gets its own LRU list and budget.   */
 /************************************************************************/
 
-void VSICachedFile::FlushLRU()
+VSICacheData::VSICacheData( VSICacheLRU *poLRUIn )
 
 {
-    CPLAssert( poLRUStart != NULL );
-
-    VSICacheChunk *poBlock = poLRUStart;
+    bOwnLRU = (poLRUIn == NULL);
+    poLRU = bOwnLRU ? new VSICacheLRU() : poLRUIn;
 
-    CPLAssert( nCacheUsed >= poBlock->nDataFilled );
+    nRefCount = 0;
 
-    nCacheUsed -= poBlock->nDataFilled;
-    
-    poLRUStart = poBlock->poLRUNext;
-    if( poLRUEnd == poBlock )
-        poLRUEnd = NULL;
+    nChunkSize = (size_t) CPLScanUIntBig(
+        CPLGetConfigOption( "VSI_CACHE_CHUNK_SIZE", "32768" ), 40 );
+    if( nChunkSize < 512 || nChunkSize > 100 * 1024 * 1024 )
+    {
+        CPLError( CE_Warning, CPLE_AppDefined,
+                  "Invalid value for VSI_CACHE_CHUNK_SIZE. Using %d instead.",
+                  DEFAULT_CHUNK_SIZE );
+        nChunkSize = DEFAULT_CHUNK_SIZE;
+    }
 
-    if( poBlock->poLRUNext != NULL )
-        poBlock->poLRUNext->poLRUPrev = NULL;
+    hChunks = CPLHashSetNew( VSICacheChunkHash, VSICacheChunkEqual, NULL );
+}
 
-    CPLAssert( !poBlock->bDirty );
+/************************************************************************/
+/*                           ~VSICacheData()                            */
+/************************************************************************/
 
-    apoCache[poBlock->iBlock] = NULL;
+static int VSICacheDataFreeChunk( void *elt, void *user_data )
+{
+    VSICacheChunk *poBlock = (VSICacheChunk *) elt;
 
+    ((VSICacheLRU *) user_data)->Unlink( poBlock );
     delete poBlock;
+
+    return TRUE;
+}
+
+VSICacheData::~VSICacheData()
+
+{
+    {
+        CPLMutexHolder oHolder( &(poLRU->hMutex) );
+
+        CPLHashSetForeach( hChunks, VSICacheDataFreeChunk, poLRU );
+        CPLHashSetDestroy( hChunks );
+    }
+
+    if( bOwnLRU )
+        delete poLRU;
 }
 
 /************************************************************************/
-/*                               Demote()                               */
+/*                              GetChunk()                              */
 /*                                                                      */
-/*      Demote the indicated block to the end of the LRU list.          */
-/*      Potentially integrate the link into the list if it is not       */
-/*      already there.                                                  */
+/*      Find a cached chunk, and if requested make it the most          */
+/*      recently used one.  Must be called under the LRU mutex.         */
 /************************************************************************/
 
-void VSICachedFile::Demote( VSICacheChunk *poBlock )
+VSICacheChunk *VSICacheData::GetChunk( vsi_l_offset iBlock, int bTouch )
 
 {
-    // already at end?
-    if( poLRUEnd == poBlock )
-        return;
-    
-    if( poLRUStart == poBlock )
-        poLRUStart = poBlock->poLRUNext;
+    VSICacheChunk oKey;
+    oKey.iBlock = iBlock;
 
-    if( poBlock->poLRUPrev != NULL )
-        poBlock->poLRUPrev->poLRUNext = poBlock->poLRUNext;
+    VSICacheChunk *poBlock = (VSICacheChunk *) CPLHashSetLookup( hChunks, &oKey );
+    if( poBlock != NULL && bTouch )
+        poLRU->Demote( poBlock );
 
-    if( poBlock->poLRUNext != NULL )
-        poBlock->poLRUNext->poLRUPrev = poBlock->poLRUPrev;
-
-    poBlock->poLRUNext = NULL;
-    poBlock->poLRUPrev = NULL;
-
-    if( poLRUEnd != NULL )
-        poLRUEnd->poLRUNext = poBlock;
-    poLRUEnd = poBlock;
-    
-    if( poLRUStart == NULL )
-        poLRUStart = poBlock;
+    return poBlock;
 }
 
 /************************************************************************/
-/*                             LoadBlocks()                             */
+/*                              AddChunk()                              */
 /*                                                                      */
-/*      Load the desired set of blocks.  Use pBuffer as a temporary     */
-/*      buffer if it would be helpful.                                  */
+/*      Cache a copy of a chunk read from the base file, unless         */
+/*      another handle has done it meanwhile, and trim the cache to     */
+/*      its budget.  Must be called under the LRU mutex.                */
 /************************************************************************/
 
-int VSICachedFile::LoadBlocks( size_t nStartBlock, size_t nBlockCount,
-                               void *pBuffer, size_t nBufferSize )
+void VSICacheData::AddChunk( vsi_l_offset iBlock, const GByte *pabyData,
+                             size_t nDataFilled )
 
 {
-    if( nBlockCount == 0 )
-        return 1;
+    if( GetChunk( iBlock, TRUE ) != NULL )
+        return;
+
+    VSICacheChunk *poBlock = new VSICacheChunk();
+
+    poBlock->iBlock = iBlock;
+    poBlock->poOwner = this;
+    poBlock->nDataFilled = nDataFilled;
+    if( nDataFilled > 0 )
+    {
+        poBlock->pabyData = (GByte *) CPLMalloc( nDataFilled );
+        memcpy( poBlock->pabyData, pabyData, nDataFilled );
+    }
+
+    CPLHashSetInsert( hChunks, poBlock );
+    poLRU->nCacheUsed += nDataFilled;
 
-    if( apoCache.size() < nStartBlock + nBlockCount )
-        apoCache.resize( nStartBlock + nBlockCount );
+    // Merges into the LRU list. 
+    poLRU->Demote( poBlock );
 
 /* -------------------------------------------------------------------- */
-/*      When we want to load only one block, we can directly load it    */
-/*      into the target buffer with no concern about intermediaries.    */
+/*      Ensure the cache is reduced to our limit.                       */
 /* -------------------------------------------------------------------- */
-    if( nBlockCount == 1 )
+    while( poLRU->nCacheUsed > poLRU->nCacheMax 
+           && poLRU->poLRUStart != poBlock )
+        poLRU->FlushLRU();
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                       VSICacheFilesystemHandler                      */
+/* ==================================================================== */
+/************************************************************************/
+
+class VSICacheFilesystemHandler : public VSIFilesystemHandler 
+{
+    void           *hMutex;
+    std::map<CPLString, VSICacheData*> oMapData;
+    VSICacheLRU    *poLRU;
+
+public:
+                     VSICacheFilesystemHandler();
+    virtual          ~VSICacheFilesystemHandler();
+
+    VSICacheData    *AcquireData( const char *pszFilename );
+    void             ReleaseData( VSICacheData *poData );
+
+    virtual VSIVirtualHandle *Open( const char *pszFilename, 
+                                    const char *pszAccess);
+    virtual int      Stat( const char *pszFilename, VSIStatBufL *pStatBuf, int nFlags );
+    virtual char   **ReadDir( const char *pszDirname );
+};
+
+/************************************************************************/
+/* ==================================================================== */
+/*                             VSICachedFile                            */
+/* ==================================================================== */
+/************************************************************************/
+
+class VSICachedFile : public VSIVirtualHandle
+{ 
+  public:
+    VSICachedFile( VSIVirtualHandle *, VSICacheData *,
+                   VSICacheFilesystemHandler * );
+    ~VSICachedFile() { Close(); }
+
+    size_t        LoadBlocks( vsi_l_offset nStartBlock, size_t nBlockCount,
+                              GByte *pabyDst, vsi_l_offset nDstOffset,
+                              size_t nDstSize );
+
+    VSIVirtualHandle *poBase;
+    VSICacheData  *poData;
+    VSICacheFilesystemHandler *poFS;
+    
+    vsi_l_offset  nOffset;
+    vsi_l_offset  nFileSize;
+
+    virtual int       Seek( vsi_l_offset nOffset, int nWhence );
+    virtual vsi_l_offset Tell();
+    virtual size_t    Read( void *pBuffer, size_t nSize, size_t nMemb );
+    virtual size_t    Write( const void *pBuffer, size_t nSize, size_t nMemb );
+    virtual int       Eof();
+    virtual int       Flush();
+    virtual int       Close();
+};
+
+/************************************************************************/
+/*                           VSICachedFile()                            */
+/************************************************************************/
+
+VSICachedFile::VSICachedFile( VSIVirtualHandle *poBaseHandle,
+                              VSICacheData *poDataIn,
+                              VSICacheFilesystemHandler *poFSIn )
+
+{
+    poBase = poBaseHandle;
+    poData = poDataIn;
+    poFS = poFSIn;
+
+    poBase->Seek( 0, SEEK_END );
+    nFileSize = poBase->Tell();
+
+    nOffset = 0;
+}
+
+/************************************************************************/
+/*                               Close()                                */
+/************************************************************************/
+
+int VSICachedFile::Close()
+
+{
+    if( poData )
     {
-        poBase->Seek( nStartBlock * CHUNK_SIZE, SEEK_SET );
+        if( poFS )
+            poFS->ReleaseData( poData );
+        else
+            delete poData;
+        poData = NULL;
+    }
 
-        apoCache[nStartBlock] = new VSICacheChunk();
+    if( poBase )
+    {
+        poBase->Close();
+        delete poBase;
+        poBase = NULL;
+    }
 
-        VSICacheChunk *poBlock = apoCache[nStartBlock];
+    return 0;
+}
 
-        poBlock->iBlock = nStartBlock;
-        poBlock->nDataFilled = poBase->Read( poBlock->abyData, 1, CHUNK_SIZE );
-        nCacheUsed += poBlock->nDataFilled;
+/************************************************************************/
+/*                                Seek()                                */
+/************************************************************************/
 
-        // Merges into the LRU list. 
-        Demote( poBlock );
+int VSICachedFile::Seek( vsi_l_offset nReqOffset, int nWhence )
 
-        return 1;
+{
+    if( nWhence == SEEK_SET )
+    {
+        // use offset directly.
     }
 
-/* -------------------------------------------------------------------- */
-/*      If the buffer is quite large but not quite large enough to      */
-/*      hold all the blocks we will take the pain of splitting the      */
-/*      io request in two in order to avoid allocating a large          */
-/*      temporary buffer.                                               */
-/* -------------------------------------------------------------------- */
-    if( nBufferSize > CHUNK_SIZE * 20 
-        && nBufferSize < nBlockCount * CHUNK_SIZE )
+    else if( nWhence == SEEK_CUR )
     {
-        if( !LoadBlocks( nStartBlock, 2, pBuffer, nBufferSize ) )
-            return 0;
+        nReqOffset += nOffset;
+    }
 
-        return LoadBlocks( nStartBlock+2, nBlockCount-2, pBuffer, nBufferSize );
+    else if( nWhence == SEEK_END )
+    {
+        nReqOffset += nFileSize;
     }
 
-/* -------------------------------------------------------------------- */
-/*      Do we need to allocate our own buffer?                          */
-/* -------------------------------------------------------------------- */
-    GByte *pabyWorkBuffer = (GByte *) pBuffer;
+    nOffset = nReqOffset;
 
-    if( nBufferSize < CHUNK_SIZE * nBlockCount )
-        pabyWorkBuffer = (GByte *) CPLMalloc(CHUNK_SIZE * nBlockCount);
+    return 0;
+}
 
-/* -------------------------------------------------------------------- */
-/*      Read the whole request into the working buffer.                 */
-/* -------------------------------------------------------------------- */
-    if( poBase->Seek( nStartBlock * CHUNK_SIZE, SEEK_SET ) != 0 )
-        return 0;
+/************************************************************************/
+/*                                Tell()                                */
+/************************************************************************/
 
-    size_t nDataRead = poBase->Read( pabyWorkBuffer, 1, nBlockCount*CHUNK_SIZE);
+vsi_l_offset VSICachedFile::Tell()
 
-    if( nBlockCount * CHUNK_SIZE > nDataRead + CHUNK_SIZE - 1 )
-        nBlockCount = (nDataRead + CHUNK_SIZE - 1) / CHUNK_SIZE;
+{
+    return nOffset;
+}
 
-    for( size_t i = 0; i < nBlockCount; i++ )
-    {
-        VSICacheChunk *poBlock = new VSICacheChunk();
+/************************************************************************/
+/*                             LoadBlocks()                             */
+/*                                                                      */
+/*      Read a run of missing blocks from the base file, copy the part  */
+/*      overlapping the request into the destination buffer and add     */
+/*      them to the cache.  The shared mutex is not held during the     */
+/*      read so that other handles can keep on serving cached data.     */
+/*      Returns the number of bytes read.                               */
+/************************************************************************/
 
-        poBlock->iBlock = nStartBlock + i;
+size_t VSICachedFile::LoadBlocks( vsi_l_offset nStartBlock, size_t nBlockCount,
+                                  GByte *pabyDst, vsi_l_offset nDstOffset,
+                                  size_t nDstSize )
 
-        CPLAssert( apoCache[i+nStartBlock] == NULL );
+{
+    const size_t nChunkSize = poData->nChunkSize;
+    const vsi_l_offset nLoadOffset = nStartBlock * nChunkSize;
 
-        apoCache[i + nStartBlock] = poBlock;
+/* -------------------------------------------------------------------- */
+/*      Read the whole run into a working buffer.  When the run lies    */
+/*      within the request we can directly read into the target         */
+/*      buffer.                                                         */
+/* -------------------------------------------------------------------- */
+    GByte *pabyWorkBuffer;
+    int    bOwnBuffer = FALSE;
+    if( nLoadOffset >= nDstOffset
+        && nLoadOffset + nBlockCount * nChunkSize <= nDstOffset + nDstSize )
+        pabyWorkBuffer = pabyDst + (size_t) (nLoadOffset - nDstOffset);
+    else
+    {
+        pabyWorkBuffer = (GByte *) VSIMalloc( nBlockCount * nChunkSize );
+        bOwnBuffer = TRUE;
+    }
 
-        if( nDataRead >= (i+1) * CHUNK_SIZE )
-            poBlock->nDataFilled = CHUNK_SIZE;
-        else
-            poBlock->nDataFilled = nDataRead - i*CHUNK_SIZE;
+    if( pabyWorkBuffer == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "Cannot allocate " CPL_FRMT_GUIB " bytes",
+                  (GUIntBig) (nBlockCount * nChunkSize) );
+        return 0;
+    }
 
-        memcpy( poBlock->abyData, pabyWorkBuffer + i*CHUNK_SIZE,
-                (size_t) poBlock->nDataFilled );
+    size_t nDataRead = 0;
+    if( poBase->Seek( nLoadOffset, SEEK_SET ) == 0 )
+        nDataRead = poBase->Read( pabyWorkBuffer, 1, nBlockCount * nChunkSize );
+
+/* -------------------------------------------------------------------- */
+/*      Copy the part of the run overlapping the request.               */
+/* -------------------------------------------------------------------- */
+    if( bOwnBuffer )
+    {
+        vsi_l_offset nCopyStart = MAX( nLoadOffset, nDstOffset );
+        vsi_l_offset nCopyEnd = MIN( nLoadOffset + nDataRead,
+                                     nDstOffset + nDstSize );
+        if( nCopyEnd > nCopyStart )
+            memcpy( pabyDst + (size_t) (nCopyStart - nDstOffset),
+                    pabyWorkBuffer + (size_t) (nCopyStart - nLoadOffset),
+                    (size_t) (nCopyEnd - nCopyStart) );
+    }
 
-        nCacheUsed += poBlock->nDataFilled;
+/* -------------------------------------------------------------------- */
+/*      Cache the blocks.                                               */
+/* -------------------------------------------------------------------- */
+    {
+        CPLMutexHolder oHolder( &(poData->poLRU->hMutex) );
 
-        // Merges into the LRU list. 
-        Demote( poBlock );
+        for( size_t i = 0; i < nBlockCount && i * nChunkSize < nDataRead; i++ )
+        {
+            size_t nDataFilled = MIN( nChunkSize, nDataRead - i * nChunkSize );
+            poData->AddChunk( nStartBlock + i, pabyWorkBuffer + i * nChunkSize,
+                              nDataFilled );
+        }
     }
 
-    if( pabyWorkBuffer != pBuffer )
+    if( bOwnBuffer )
         CPLFree( pabyWorkBuffer );
 
-    return 1;
+    return nDataRead;
 }
 
 /************************************************************************/
@@ -358,66 +596,83 @@ int VSICachedFile::LoadBlocks( size_t nStartBlock, size_t nBlockCount,
 size_t VSICachedFile::Read( void * pBuffer, size_t nSize, size_t nCount )
 
 {
-    if( nOffset >= nFileSize )
+    if( nOffset >= nFileSize || nSize == 0 || nCount == 0 )
         return 0;
 
+    GByte *pabyBuffer = (GByte *) pBuffer;
+    const size_t nToRead = nSize * nCount;
+    const size_t nChunkSize = poData->nChunkSize;
+    const size_t nMaxLoadBlocks = MAX( 1, MAX_LOAD_SIZE / nChunkSize );
+
+    vsi_l_offset iBlock = nOffset / nChunkSize;
+    const vsi_l_offset nEndBlock = (nOffset + nToRead - 1) / nChunkSize;
+    size_t nAmountCopied = 0;
+
 /* ==================================================================== */
-/*      Make sure the cache is loaded for the whole request region.     */
+/*      Walk through the blocks of the request, copying from the        */
+/*      cache, or loading runs of missing blocks.                       */
 /* ==================================================================== */
-    size_t nStartBlock = (size_t) (nOffset / CHUNK_SIZE);
-    size_t nEndBlock = (size_t) ((nOffset + nSize * nCount - 1) / CHUNK_SIZE);
-    
-    for( size_t iBlock = nStartBlock; iBlock <= nEndBlock; iBlock++ )
+    while( iBlock <= nEndBlock )
     {
-        if( apoCache.size() <= iBlock || apoCache[iBlock] == NULL )
+        const vsi_l_offset nBlockOffset = iBlock * nChunkSize;
+        size_t nBlocksToLoad = 0;
+        size_t nDataFilled = 0;
+
         {
-            size_t nBlocksToLoad = 1;
-            while( iBlock + nBlocksToLoad <= nEndBlock
-                   && (apoCache.size() <= iBlock+nBlocksToLoad 
-                       || apoCache[iBlock+nBlocksToLoad] == NULL) )
-                nBlocksToLoad++;
+            CPLMutexHolder oHolder( &(poData->poLRU->hMutex) );
+
+            VSICacheChunk *poBlock = poData->GetChunk( iBlock, TRUE );
+            if( poBlock != NULL )
+            {
+                nDataFilled = poBlock->nDataFilled;
+
+                vsi_l_offset nCopyStart = MAX( nBlockOffset, nOffset );
+                vsi_l_offset nCopyEnd = MIN( nBlockOffset + nDataFilled,
+                                             nOffset + nToRead );
+                if( nCopyEnd > nCopyStart )
+                {
+                    memcpy( pabyBuffer + (size_t) (nCopyStart - nOffset),
+                            poBlock->pabyData
+                            + (size_t) (nCopyStart - nBlockOffset),
+                            (size_t) (nCopyEnd - nCopyStart) );
+                    nAmountCopied = (size_t) (nCopyEnd - nOffset);
+                }
+            }
+            else
+            {
+                nBlocksToLoad = 1;
+                while( iBlock + nBlocksToLoad <= nEndBlock
+                       && nBlocksToLoad < nMaxLoadBlocks
+                       && poData->GetChunk( iBlock + nBlocksToLoad,
+                                            FALSE ) == NULL )
+                    nBlocksToLoad++;
+            }
+        }
 
-            LoadBlocks( iBlock, nBlocksToLoad, pBuffer, nSize * nCount );
+        if( nBlocksToLoad > 0 )
+        {
+            size_t nDataRead = LoadBlocks( iBlock, nBlocksToLoad,
+                                           pabyBuffer, nOffset, nToRead );
+            vsi_l_offset nCopyEnd = MIN( nBlockOffset + nDataRead,
+                                         nOffset + nToRead );
+            if( nCopyEnd > nOffset + nAmountCopied )
+                nAmountCopied = (size_t) (nCopyEnd - nOffset);
+
+            if( nDataRead < nBlocksToLoad * nChunkSize )
+                break;
+            iBlock += nBlocksToLoad;
+        }
+        else
+        {
+            // Short block: end of file.
+            if( nDataFilled < nChunkSize )
+                break;
+            iBlock++;
         }
     }
-    
-/* ==================================================================== */
-/*      Copy data into the target buffer to the extent possible.        */
-/* ==================================================================== */
-    size_t nAmountCopied = 0;
 
-    while( nAmountCopied < nSize * nCount )
-    {
-        size_t iBlock = (size_t) ((nOffset + nAmountCopied) / CHUNK_SIZE);
-        size_t nThisCopy;
-        VSICacheChunk *poBlock = apoCache[iBlock];
-
-        nThisCopy = (size_t)
-            ((iBlock * CHUNK_SIZE + poBlock->nDataFilled) 
-             - nAmountCopied - nOffset);
-        
-        if( nThisCopy > nSize * nCount - nAmountCopied )
-            nThisCopy = nSize * nCount - nAmountCopied;
-
-        if( nThisCopy == 0 )
-            break;
-
-        memcpy( ((GByte *) pBuffer) + nAmountCopied,
-                poBlock->abyData 
-                + (nOffset + nAmountCopied) - iBlock * CHUNK_SIZE, 
-                nThisCopy );
-
-        nAmountCopied += nThisCopy;
-    }
-    
     nOffset += nAmountCopied;
 
-/* -------------------------------------------------------------------- */
-/*      Ensure the cache is reduced to our limit.                       */
-/* -------------------------------------------------------------------- */
-    while( nCacheUsed > nCacheMax )
-        FlushLRU();
-        
     return nAmountCopied / nSize;
 }
 
@@ -454,6 +709,129 @@ int VSICachedFile::Flush()
     return 0;
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*                       VSICacheFilesystemHandler                      */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                     VSICacheFilesystemHandler()                      */
+/************************************************************************/
+
+VSICacheFilesystemHandler::VSICacheFilesystemHandler()
+
+{
+    hMutex = NULL;
+    poLRU = NULL;
+}
+
+/************************************************************************/
+/*                    ~VSICacheFilesystemHandler()                      */
+/************************************************************************/
+
+VSICacheFilesystemHandler::~VSICacheFilesystemHandler()
+
+{
+    delete poLRU;
+    poLRU = NULL;
+
+    if( hMutex != NULL )
+        CPLDestroyMutex( hMutex );
+    hMutex = NULL;
+}
+
+/************************************************************************/
+/*                            AcquireData()                             */
+/*                                                                      */
+/*      Get the cache of a file, shared by all the handles opened on    */
+/*      it.  The LRU list, and thus the VSI_CACHE_SIZE budget, is       */
+/*      created with the first cache and shared by all of them.         */
+/************************************************************************/
+
+VSICacheData *VSICacheFilesystemHandler::AcquireData( const char *pszFilename )
+
+{
+    CPLMutexHolder oHolder( &hMutex );
+
+    if( poLRU == NULL )
+        poLRU = new VSICacheLRU();
+
+    VSICacheData *poData = oMapData[pszFilename];
+    if( poData == NULL )
+    {
+        poData = new VSICacheData( poLRU );
+        poData->osFilename = pszFilename;
+        oMapData[pszFilename] = poData;
+    }
+    poData->nRefCount ++;
+
+    return poData;
+}
+
+/************************************************************************/
+/*                            ReleaseData()                             */
+/************************************************************************/
+
+void VSICacheFilesystemHandler::ReleaseData( VSICacheData *poData )
+
+{
+    CPLMutexHolder oHolder( &hMutex );
+
+    if( --poData->nRefCount == 0 )
+    {
+        oMapData.erase( poData->osFilename );
+        delete poData;
+    }
+}
+
+/************************************************************************/
+/*                                Open()                                */
+/************************************************************************/
+
+VSIVirtualHandle *
+VSICacheFilesystemHandler::Open( const char *pszFilename, 
+                                 const char *pszAccess )
+
+{
+    const char *pszBaseFilename = pszFilename + strlen("/vsicache/");
+
+/* -------------------------------------------------------------------- */
+/*      Only reading is cached.  Other accesses go to the base file.    */
+/* -------------------------------------------------------------------- */
+    VSILFILE *fp = VSIFOpenL( pszBaseFilename, pszAccess );
+    if( fp == NULL )
+        return NULL;
+
+    if( strchr(pszAccess, 'r') == NULL || strchr(pszAccess, '+') != NULL )
+        return (VSIVirtualHandle *) fp;
+
+    return new VSICachedFile( (VSIVirtualHandle *) fp,
+                              AcquireData( pszBaseFilename ), this );
+}
+
+/************************************************************************/
+/*                                Stat()                                */
+/************************************************************************/
+
+int VSICacheFilesystemHandler::Stat( const char * pszFilename, 
+                                     VSIStatBufL * psStatBuf,
+                                     int nFlags )
+    
+{
+    return VSIStatExL( pszFilename + strlen("/vsicache/"), psStatBuf, nFlags );
+}
+
+/************************************************************************/
+/*                              ReadDir()                               */
+/************************************************************************/
+
+char **VSICacheFilesystemHandler::ReadDir( const char *pszPath )
+
+{
+    return VSIReadDir( pszPath + strlen("/vsicache/") );
+}
+
 /************************************************************************/
 /*                        VSICreateCachedFile()                         */
 /************************************************************************/
@@ -462,5 +840,36 @@ VSIVirtualHandle *
 VSICreateCachedFile( VSIVirtualHandle *poBaseHandle )
 
 {
-    return new VSICachedFile( poBaseHandle );
+    return new VSICachedFile( poBaseHandle, new VSICacheData( NULL ), NULL );
+}
+
+/************************************************************************/
+/*                       VSIInstallCacheFileHandler()                   */
+/************************************************************************/
+
+/**
+ * Install /vsicache/ virtual file handler. 
+ *
+ * This virtual file system handler caches in memory the data read from
+ * files on slow storage, such as network or FUSE file systems, without
+ * requiring changes in the drivers reading them.
+ *
+ *   /vsicache/<filename>
+ *
+ * Files are read by chunks of VSI_CACHE_CHUNK_SIZE bytes (32 KB by
+ * default).  The cache size is bounded by VSI_CACHE_SIZE bytes (25 MB by
+ * default) for all the files opened through /vsicache/ together: the least
+ * recently used chunks are discarded first, whichever file they belong to.
+ * VSI_CACHE_SIZE is read when the first file is opened.  The cached chunks
+ * of a file are shared by all the handles opened on it, possibly from
+ * several threads, as long as one of them stays open.  Only files opened
+ * for reading are cached, other access modes directly operate on the file.
+ *
+ * VSIStatL() and VSIReadDir() operate on the underlying file system.
+ */
+
+void VSIInstallCacheFileHandler()
+{
+    VSIFileManager::InstallHandler( "/vsicache/", 
+                                    new VSICacheFilesystemHandler );
 }
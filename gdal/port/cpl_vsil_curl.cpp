@@ -47,13 +47,20 @@ void VSIInstallCurlFileHandler(void)
 #include <curl/curl.h>
 
 #include <map>
+#include <vector>
+#include <algorithm>
 
 #define ENABLE_DEBUG 1
 
-#define N_MAX_REGIONS       1000
-
 #define DOWNLOAD_CHUNCK_SIZE    16384
 
+/* Default byte budget of the region cache (CPL_VSIL_CURL_CACHE_SIZE) */
+#define DEFAULT_REGION_CACHE_SIZE   (1000 * DOWNLOAD_CHUNCK_SIZE)
+
+/* Minimum number of chunks fetched by each part of a read-ahead split */
+/* into concurrent requests */
+#define VSICURL_MIN_PART_BLOCKS 8
+
 typedef enum
 {
     EXIST_UNKNOWN = -1,
@@ -68,6 +75,7 @@ typedef struct
     vsi_l_offset    fileSize;
     int             bIsDirectory;
     time_t          mTime;
+    char           *pszValidator;   /* ETag, Last-Modified and size */
 } CachedFileProp;
 
 typedef struct
@@ -76,18 +84,719 @@ typedef struct
     char**          papszFileList; /* only file name without path */
 } CachedDirList;
 
-typedef struct
+typedef struct _CachedRegion CachedRegion;
+
+struct _CachedRegion
 {
-    unsigned long   pszURLHash;
+    unsigned long   nURLHash;
+    char           *pszURL;
     vsi_l_offset    nFileOffsetStart;
     size_t          nSize;
     char           *pData;
-} CachedRegion;
 
+    /* Neighbours in the LRU list, most recently used first */
+    CachedRegion   *psPrev;
+    CachedRegion   *psNext;
+};
+
+/************************************************************************/
+/*                         VSICurlRegionHash()                          */
+/************************************************************************/
+
+static unsigned long VSICurlRegionHash(const void* elt)
+{
+    const CachedRegion* psRegion = (const CachedRegion*) elt;
+    return psRegion->nURLHash ^
+        ((unsigned long)(psRegion->nFileOffsetStart / DOWNLOAD_CHUNCK_SIZE) *
+                                                            2654435761UL);
+}
+
+/************************************************************************/
+/*                         VSICurlRegionEqual()                         */
+/************************************************************************/
 
-static const char* VSICurlGetCacheFileName()
+static int VSICurlRegionEqual(const void* elt1, const void* elt2)
 {
-    return "gdal_vsicurl_cache.bin";
+    const CachedRegion* psRegion1 = (const CachedRegion*) elt1;
+    const CachedRegion* psRegion2 = (const CachedRegion*) elt2;
+    return psRegion1->nFileOffsetStart == psRegion2->nFileOffsetStart &&
+           psRegion1->nURLHash == psRegion2->nURLHash &&
+           strcmp(psRegion1->pszURL, psRegion2->pszURL) == 0;
+}
+
+/************************************************************************/
+/*                         VSICurlRegionCost()                          */
+/*                                                                      */
+/*      Number of bytes a region accounts for in the cache budget.      */
+/************************************************************************/
+
+static GIntBig VSICurlRegionCost(const CachedRegion* psRegion)
+{
+    return (GIntBig)(sizeof(CachedRegion) + strlen(psRegion->pszURL) + 1 +
+                     psRegion->nSize);
+}
+
+
+/************************************************************************/
+/*                           VSICurlDiskCache                           */
+/*                                                                      */
+/*      Persistent cache of the downloaded chunks, enabled with         */
+/*      CPL_VSIL_CURL_USE_CACHE=YES.                                    */
+/*                                                                      */
+/*      Each chunk is stored in its own file, in one of 256 shard       */
+/*      directories of CPL_VSIL_CURL_CACHE_DIR. The file starts with a  */
+/*      header holding the URL, the offset and the validator (ETag,     */
+/*      Last-Modified and size) of the remote file, so that chunks of   */
+/*      a remote file that has changed since, or of another URL with    */
+/*      the same hash, are never used. Chunks are written under a       */
+/*      temporary name and then renamed, so that a crash cannot leave   */
+/*      a truncated chunk behind.                                       */
+/*                                                                      */
+/*      An append-only journal (index.log) records the additions, uses  */
+/*      and removals of chunks, by all the processes sharing the cache. */
+/*      Each process replays the records appended by the others before  */
+/*      evicting chunks, to keep the whole cache under                  */
+/*      CPL_VSIL_CURL_CACHE_DISK_SIZE bytes in LRU order. Records are   */
+/*      terminated by a '$' so that one torn by a crash is ignored.     */
+/*                                                                      */
+/*      When it gets much longer than the number of chunks, the journal */
+/*      is compacted by the process holding index.log.lock : it is      */
+/*      rewritten under a unique temporary name, starting with a new    */
+/*      generation record so that the other processes reload it, and    */
+/*      renamed. Records appended by other processes during the         */
+/*      compaction may be lost, so the chunk files are reconciled with  */
+/*      the journal at load and compaction time : untracked chunks are  */
+/*      added as the least recently used ones, and missing ones are     */
+/*      forgotten.                                                      */
+/************************************************************************/
+
+#define VSICURL_DISK_CACHE_MAGIC        "GDALVCC1"
+#define VSICURL_DISK_CACHE_JOURNAL      "index.log"
+
+/* Age, in seconds, after which a temporary file or a lock file is */
+/* considered as left over by a crash */
+#define VSICURL_DISK_CACHE_STALE_DELAY  3600
+#define VSICURL_DISK_CACHE_LOCK_DELAY   60
+
+typedef struct
+{
+    GIntBig         nSize;
+    GIntBig         nStamp;
+} VSICurlDiskCacheEntry;
+
+class VSICurlDiskCache
+{
+    void           *hMutex;
+
+    CPLString       osDir;
+    CPLString       osJournal;
+    GIntBig         nMaxSize;
+    GIntBig         nSize;
+    int             bLoaded;
+    int             abShardCreated[256];
+    int             nTempCounter;
+
+    /* Generation of the journal, and offset up to which it has been */
+    /* replayed */
+    CPLString       osJournalGeneration;
+    vsi_l_offset    nJournalOffset;
+    int             nJournalRecords;
+
+    /* Chunk name (relative to osDir) -> size and last use stamp, */
+    /* and last use stamp -> chunk name for LRU ordering. */
+    GIntBig         nStampCounter;
+    GIntBig         nOldestStamp;
+    std::map<CPLString, VSICurlDiskCacheEntry> oMapEntries;
+    std::map<GIntBig, CPLString>    oMapLRU;
+
+    void            Load();
+    int             Replay();
+    void            ReplayRecord(const char* pszLine);
+    void            Reconcile();
+    void            Compact();
+    void            Journal(char chOp, const CPLString& osName,
+                            GIntBig nEntrySize = 0);
+
+    void            Touch(const CPLString& osName, GIntBig nEntrySize,
+                          int bOldest = FALSE);
+    void            Forget(const CPLString& osName);
+    void            Remove(const CPLString& osName);
+    void            Evict();
+
+    CPLString       GetChunkName(const char* pszURL, vsi_l_offset nOffset);
+
+  public:
+                    VSICurlDiskCache();
+                   ~VSICurlDiskCache();
+
+    int             Read(const char* pszURL, const char* pszValidator,
+                         vsi_l_offset nOffset,
+                         char** ppData, size_t* pnSize);
+    void            Write(const char* pszURL, const char* pszValidator,
+                          vsi_l_offset nOffset,
+                          const char* pData, size_t nSize);
+};
+
+/************************************************************************/
+/*                         VSICurlDiskCache()                           */
+/************************************************************************/
+
+VSICurlDiskCache::VSICurlDiskCache()
+{
+    hMutex = NULL;
+
+    const char* pszDir = CPLGetConfigOption("CPL_VSIL_CURL_CACHE_DIR", NULL);
+    if (pszDir != NULL)
+        osDir = pszDir;
+    else
+        osDir = CPLFormFilename(CPLGetConfigOption("CPL_TMPDIR", "."),
+                                "gdal_vsicurl_cache", NULL);
+    osJournal = CPLFormFilename(osDir, VSICURL_DISK_CACHE_JOURNAL, NULL);
+
+    nMaxSize = CPLScanUIntBig(
+        CPLGetConfigOption("CPL_VSIL_CURL_CACHE_DISK_SIZE", "1073741824"), 20);
+    nSize = 0;
+    bLoaded = FALSE;
+    memset(abShardCreated, 0, sizeof(abShardCreated));
+    nTempCounter = 0;
+    nJournalOffset = 0;
+    nJournalRecords = 0;
+    nStampCounter = 0;
+    nOldestStamp = 0;
+}
+
+/************************************************************************/
+/*                        ~VSICurlDiskCache()                           */
+/************************************************************************/
+
+VSICurlDiskCache::~VSICurlDiskCache()
+{
+    if( hMutex != NULL )
+        CPLDestroyMutex( hMutex );
+}
+
+/************************************************************************/
+/*                           GetChunkName()                             */
+/************************************************************************/
+
+CPLString VSICurlDiskCache::GetChunkName(const char* pszURL,
+                                         vsi_l_offset nOffset)
+{
+    unsigned long nHash = CPLHashSetHashStr(pszURL);
+    CPLString osName;
+    osName.Printf("%02x/%08lx_" CPL_FRMT_GUIB, (int)(nHash & 0xff),
+                  nHash, (GUIntBig)(nOffset / DOWNLOAD_CHUNCK_SIZE));
+    return osName;
+}
+
+/************************************************************************/
+/*                              Journal()                               */
+/*                                                                      */
+/*      The journal is reopened for each record, so that records are    */
+/*      always appended to the current journal, even after it has been  */
+/*      compacted by another process.                                   */
+/************************************************************************/
+
+void VSICurlDiskCache::Journal(char chOp, const CPLString& osName,
+                               GIntBig nEntrySize)
+{
+    VSILFILE* fp = VSIFOpenL(osJournal, "ab");
+    if (fp == NULL)
+        return;
+
+    if (chOp == 'A')
+        VSIFPrintfL(fp, "A %s " CPL_FRMT_GIB " $\n",
+                    osName.c_str(), nEntrySize);
+    else
+        VSIFPrintfL(fp, "%c %s $\n", chOp, osName.c_str());
+    VSIFCloseL(fp);
+}
+
+/************************************************************************/
+/*                               Touch()                                */
+/*                                                                      */
+/*      Record a chunk as the most recently used one, or as the least   */
+/*      recently used one if bOldest is set.                            */
+/************************************************************************/
+
+void VSICurlDiskCache::Touch(const CPLString& osName, GIntBig nEntrySize,
+                             int bOldest)
+{
+    std::map<CPLString, VSICurlDiskCacheEntry>::iterator oIter =
+        oMapEntries.find(osName);
+    if (oIter != oMapEntries.end())
+    {
+        oMapLRU.erase(oIter->second.nStamp);
+        nSize -= oIter->second.nSize;
+    }
+
+    VSICurlDiskCacheEntry& sEntry = oMapEntries[osName];
+    sEntry.nSize = nEntrySize;
+    sEntry.nStamp = bOldest ? --nOldestStamp : ++nStampCounter;
+    oMapLRU[sEntry.nStamp] = osName;
+    nSize += nEntrySize;
+}
+
+/************************************************************************/
+/*                               Forget()                               */
+/************************************************************************/
+
+void VSICurlDiskCache::Forget(const CPLString& osName)
+{
+    std::map<CPLString, VSICurlDiskCacheEntry>::iterator oIter =
+        oMapEntries.find(osName);
+    if (oIter != oMapEntries.end())
+    {
+        oMapLRU.erase(oIter->second.nStamp);
+        nSize -= oIter->second.nSize;
+        oMapEntries.erase(oIter);
+    }
+}
+
+/************************************************************************/
+/*                               Remove()                               */
+/************************************************************************/
+
+void VSICurlDiskCache::Remove(const CPLString& osName)
+{
+    VSIUnlink(CPLFormFilename(osDir, osName, NULL));
+    Journal('D', osName);
+    Forget(osName);
+}
+
+/************************************************************************/
+/*                               Evict()                                */
+/************************************************************************/
+
+void VSICurlDiskCache::Evict()
+{
+    /* Account for the chunks added and removed by other processes */
+    Replay();
+
+    while (nSize > nMaxSize && !oMapLRU.empty())
+    {
+        CPLString osName = oMapLRU.begin()->second;
+        Remove(osName);
+    }
+
+    if (nJournalRecords > 2 * (int)oMapEntries.size() + 1024)
+        Compact();
+}
+
+/************************************************************************/
+/*                               Load()                                 */
+/************************************************************************/
+
+void VSICurlDiskCache::Load()
+{
+    if (bLoaded)
+        return;
+    bLoaded = TRUE;
+
+    VSIMkdir(osDir, 0755);
+
+    int bHasJournal = Replay();
+    Reconcile();
+    if (!bHasJournal)
+        Compact();
+    Evict();
+}
+
+/************************************************************************/
+/*                            ReplayRecord()                            */
+/************************************************************************/
+
+void VSICurlDiskCache::ReplayRecord(const char* pszLine)
+{
+    char chOp = '\0';
+    char szName[64];
+    GIntBig nEntrySize = 0;
+    int nLen = strlen(pszLine);
+
+    /* Ignore records torn by a crash */
+    if (nLen < 4 || pszLine[nLen-1] != '$' || pszLine[nLen-2] != ' ')
+        return;
+
+    if (pszLine[0] == 'A' &&
+        sscanf(pszLine, "%c %63s " CPL_FRMT_GIB, &chOp, szName,
+               &nEntrySize) == 3)
+        Touch(szName, nEntrySize);
+    else if (pszLine[0] == 'U' && sscanf(pszLine, "%c %63s", &chOp, szName) == 2)
+    {
+        if (oMapEntries.find(szName) != oMapEntries.end())
+            Touch(szName, oMapEntries[szName].nSize);
+    }
+    else if (pszLine[0] == 'D' && sscanf(pszLine, "%c %63s", &chOp, szName) == 2)
+        Forget(szName);
+    nJournalRecords ++;
+}
+
+/************************************************************************/
+/*                               Replay()                               */
+/*                                                                      */
+/*      Replay the records appended to the journal since the last call, */
+/*      or the whole journal if it has been compacted since. Only       */
+/*      complete lines are consumed, so that a record being appended    */
+/*      is replayed by the next call. Returns FALSE if there is no      */
+/*      journal.                                                        */
+/************************************************************************/
+
+int VSICurlDiskCache::Replay()
+{
+    VSILFILE* fp = VSIFOpenL(osJournal, "rb");
+    if (fp == NULL)
+        return FALSE;
+
+    /* The first record of a compacted journal identifies it */
+    CPLString osGeneration;
+    const char* pszLine = CPLReadLineL(fp);
+    if (pszLine != NULL && pszLine[0] == 'G')
+        osGeneration = pszLine;
+
+    VSIFSeekL(fp, 0, SEEK_END);
+    vsi_l_offset nJournalSize = VSIFTellL(fp);
+
+    if (osGeneration != osJournalGeneration || nJournalSize < nJournalOffset)
+    {
+        oMapEntries.clear();
+        oMapLRU.clear();
+        nSize = 0;
+        nJournalRecords = 0;
+        nJournalOffset = 0;
+        osJournalGeneration = osGeneration;
+    }
+    if (nJournalSize > nJournalOffset)
+    {
+        size_t nToRead = (size_t)(nJournalSize - nJournalOffset);
+        char* pszRecords = (char*) VSIMalloc(nToRead + 1);
+        if (pszRecords != NULL)
+        {
+            VSIFSeekL(fp, nJournalOffset, SEEK_SET);
+            nToRead = VSIFReadL(pszRecords, 1, nToRead, fp);
+            pszRecords[nToRead] = '\0';
+
+            char* pszIter = pszRecords;
+            char* pszEOL;
+            while ((pszEOL = strchr(pszIter, '\n')) != NULL)
+            {
+                *pszEOL = '\0';
+                ReplayRecord(pszIter);
+                pszIter = pszEOL + 1;
+            }
+            nJournalOffset += (vsi_l_offset)(pszIter - pszRecords);
+            CPLFree(pszRecords);
+        }
+    }
+    VSIFCloseL(fp);
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                             Reconcile()                              */
+/*                                                                      */
+/*      Make the chunks known from the journal match the chunk files.   */
+/************************************************************************/
+
+void VSICurlDiskCache::Reconcile()
+{
+    std::vector< std::pair<time_t, CPLString> > aoUntracked;
+    std::map<CPLString, GIntBig> oMapSizes;
+    std::map<CPLString, int> oMapFound;
+    time_t nNow = time(NULL);
+    VSIStatBufL sStat;
+
+    /* Journals left over by a crash during a compaction */
+    char** papszFiles = VSIReadDir(osDir);
+    for(int i = 0; papszFiles != NULL && papszFiles[i] != NULL; i++)
+    {
+        CPLString osPath = CPLFormFilename(osDir, papszFiles[i], NULL);
+        if (EQUALN(papszFiles[i], VSICURL_DISK_CACHE_JOURNAL ".",
+                   strlen(VSICURL_DISK_CACHE_JOURNAL) + 1) &&
+            EQUAL(CPLGetExtension(papszFiles[i]), "tmp") &&
+            VSIStatL(osPath, &sStat) == 0 &&
+            nNow - sStat.st_mtime > VSICURL_DISK_CACHE_STALE_DELAY)
+            VSIUnlink(osPath);
+    }
+    CSLDestroy(papszFiles);
+
+    for(int iShard = 0; iShard < 256; iShard++)
+    {
+        CPLString osShard;
+        osShard.Printf("%02x", iShard);
+        papszFiles = VSIReadDir(CPLFormFilename(osDir, osShard, NULL));
+        for(int i = 0; papszFiles != NULL && papszFiles[i] != NULL; i++)
+        {
+            if (papszFiles[i][0] == '.')
+                continue;
+
+            CPLString osName = osShard + "/" + papszFiles[i];
+            CPLString osPath = CPLFormFilename(osDir, osName, NULL);
+
+            if (VSIStatL(osPath, &sStat) != 0)
+                continue;
+
+            /* Being written by another process, or left over by a crash */
+            if (EQUAL(CPLGetExtension(papszFiles[i]), "tmp"))
+            {
+                if (nNow - sStat.st_mtime > VSICURL_DISK_CACHE_STALE_DELAY)
+                    VSIUnlink(osPath);
+                continue;
+            }
+
+            oMapFound[osName] = TRUE;
+            if (oMapEntries.find(osName) == oMapEntries.end())
+            {
+                aoUntracked.push_back(
+                    std::pair<time_t, CPLString>(sStat.st_mtime, osName));
+                oMapSizes[osName] = sStat.st_size;
+            }
+        }
+        CSLDestroy(papszFiles);
+    }
+
+    /* Forget the chunks whose file has been removed */
+    std::vector<CPLString> aosMissing;
+    std::map<CPLString, VSICurlDiskCacheEntry>::const_iterator oIter;
+    for(oIter = oMapEntries.begin(); oIter != oMapEntries.end(); ++oIter)
+    {
+        if (oMapFound.find(oIter->first) == oMapFound.end())
+            aosMissing.push_back(oIter->first);
+    }
+    for(size_t i = 0; i < aosMissing.size(); i++)
+        Forget(aosMissing[i]);
+
+    /* Add the untracked chunks as the least recently used ones, */
+    /* the most recent first */
+    std::sort(aoUntracked.begin(), aoUntracked.end());
+    for(size_t i = aoUntracked.size(); i > 0; i--)
+        Touch(aoUntracked[i-1].second, oMapSizes[aoUntracked[i-1].second],
+              TRUE);
+}
+
+/************************************************************************/
+/*                              Compact()                               */
+/*                                                                      */
+/*      Rewrite the journal with one record per chunk, in LRU order,    */
+/*      and atomically replace the current one. Only one process        */
+/*      compacts at a time; the others keep appending to the journal.   */
+/************************************************************************/
+
+void VSICurlDiskCache::Compact()
+{
+    CPLString osLock = osJournal + ".lock";
+    VSIStatBufL sStat;
+    if (VSIStatL(osLock, &sStat) == 0 &&
+        time(NULL) - sStat.st_mtime > VSICURL_DISK_CACHE_LOCK_DELAY)
+        VSIUnlink(osLock);
+
+    void* hLock = CPLLockFile(osJournal, 0.0);
+    if (hLock == NULL)
+        return;
+
+    /* Merge what the other processes have done in the meantime */
+    Replay();
+    Reconcile();
+
+    CPLString osTmpJournal;
+    osTmpJournal.Printf("%s.%d_%d.tmp", osJournal.c_str(),
+                        (int)CPLGetPID(), nTempCounter++);
+    CPLString osGeneration;
+    osGeneration.Printf("G %d_%ld_%d $", (int)CPLGetPID(),
+                        (long)time(NULL), nTempCounter++);
+
+    VSILFILE* fp = VSIFOpenL(osTmpJournal, "wb");
+    if (fp != NULL)
+    {
+        VSIFPrintfL(fp, "%s\n", osGeneration.c_str());
+        std::map<GIntBig, CPLString>::const_iterator oIter;
+        for(oIter = oMapLRU.begin(); oIter != oMapLRU.end(); ++oIter)
+        {
+            VSIFPrintfL(fp, "A %s " CPL_FRMT_GIB " $\n",
+                        oIter->second.c_str(),
+                        oMapEntries[oIter->second].nSize);
+        }
+        vsi_l_offset nJournalSize = VSIFTellL(fp);
+        if (VSIFCloseL(fp) == 0 && VSIRename(osTmpJournal, osJournal) == 0)
+        {
+            osJournalGeneration = osGeneration;
+            nJournalOffset = nJournalSize;
+            nJournalRecords = (int)oMapEntries.size() + 1;
+        }
+        else
+            VSIUnlink(osTmpJournal);
+    }
+
+    CPLUnlockFile(hLock);
+}
+
+/************************************************************************/
+/*                                Read()                                */
+/*                                                                      */
+/*      Return in *ppData (to free with CPLFree()) the data of the      */
+/*      chunk at nOffset of pszURL, if it is cached and was fetched     */
+/*      from the same version of the remote file.                       */
+/************************************************************************/
+
+int VSICurlDiskCache::Read(const char* pszURL, const char* pszValidator,
+                           vsi_l_offset nOffset,
+                           char** ppData, size_t* pnSize)
+{
+    CPLMutexHolder oHolder( &hMutex );
+
+    Load();
+
+    *ppData = NULL;
+    *pnSize = 0;
+
+    /* The chunk may also have been added by another process since */
+    /* we loaded the journal. */
+    CPLString osName = GetChunkName(pszURL, nOffset);
+    VSILFILE* fp = VSIFOpenL(CPLFormFilename(osDir, osName, NULL), "rb");
+    if (fp == NULL)
+    {
+        Forget(osName);
+        return FALSE;
+    }
+
+    char szMagic[8];
+    GUInt32 nURLLen = 0, nValidatorLen = 0;
+    GUIntBig nChunkOffset = 0, nDataSize = 0;
+    int bOK = VSIFReadL(szMagic, 8, 1, fp) == 1 &&
+              memcmp(szMagic, VSICURL_DISK_CACHE_MAGIC, 8) == 0 &&
+              VSIFReadL(&nURLLen, sizeof(nURLLen), 1, fp) == 1 &&
+              VSIFReadL(&nValidatorLen, sizeof(nValidatorLen), 1, fp) == 1 &&
+              VSIFReadL(&nChunkOffset, sizeof(nChunkOffset), 1, fp) == 1 &&
+              VSIFReadL(&nDataSize, sizeof(nDataSize), 1, fp) == 1 &&
+              nURLLen < 65536 && nValidatorLen < 65536 &&
+              nDataSize <= DOWNLOAD_CHUNCK_SIZE;
+
+    CPLString osChunkURL, osChunkValidator;
+    if (bOK)
+    {
+        osChunkURL.resize(nURLLen);
+        osChunkValidator.resize(nValidatorLen);
+        bOK = (nURLLen == 0 || VSIFReadL(&osChunkURL[0], nURLLen, 1, fp) == 1) &&
+              (nValidatorLen == 0 ||
+               VSIFReadL(&osChunkValidator[0], nValidatorLen, 1, fp) == 1);
+    }
+
+    /* Chunk of another URL with the same hash : leave it alone */
+    if (bOK && (osChunkURL != pszURL || nChunkOffset != nOffset))
+    {
+        VSIFCloseL(fp);
+        return FALSE;
+    }
+
+    if (bOK && osChunkValidator == pszValidator)
+    {
+        *ppData = (char*) VSIMalloc(MAX(1, (size_t)nDataSize));
+        bOK = *ppData != NULL &&
+            VSIFReadL(*ppData, 1, (size_t)nDataSize, fp) == (size_t)nDataSize;
+        if (bOK)
+        {
+            *pnSize = (size_t)nDataSize;
+            VSIFCloseL(fp);
+
+            if (ENABLE_DEBUG)
+                CPLDebug("VSICURL", "Got data at offset " CPL_FRMT_GUIB " from disk",
+                         nOffset);
+
+            if (oMapEntries.find(osName) != oMapEntries.end())
+            {
+                Touch(osName, oMapEntries[osName].nSize);
+                Journal('U', osName);
+            }
+            else
+            {
+                GIntBig nEntrySize = 8 + sizeof(nURLLen) + sizeof(nValidatorLen) +
+                    sizeof(nChunkOffset) + sizeof(nDataSize) +
+                    nURLLen + nValidatorLen + nDataSize;
+                Touch(osName, nEntrySize);
+                Journal('A', osName, nEntrySize);
+                Evict();
+            }
+            return TRUE;
+        }
+        CPLFree(*ppData);
+        *ppData = NULL;
+    }
+
+    /* Corrupted, or from an older version of the remote file */
+    VSIFCloseL(fp);
+    Remove(osName);
+
+    return FALSE;
+}
+
+/************************************************************************/
+/*                               Write()                                */
+/************************************************************************/
+
+void VSICurlDiskCache::Write(const char* pszURL, const char* pszValidator,
+                             vsi_l_offset nOffset,
+                             const char* pData, size_t nSize)
+{
+    CPLMutexHolder oHolder( &hMutex );
+
+    Load();
+
+    CPLString osName = GetChunkName(pszURL, nOffset);
+    int iShard = (int)(CPLHashSetHashStr(pszURL) & 0xff);
+    if (!abShardCreated[iShard])
+    {
+        VSIMkdir(CPLFormFilename(osDir, CPLGetPath(osName), NULL), 0755);
+        abShardCreated[iShard] = TRUE;
+    }
+
+    CPLString osPath = CPLFormFilename(osDir, osName, NULL);
+    CPLString osTmpPath;
+    osTmpPath.Printf("%s.%d_%d.tmp", osPath.c_str(),
+                     (int)CPLGetPID(), nTempCounter++);
+
+    VSILFILE* fp = VSIFOpenL(osTmpPath, "wb");
+    if (fp == NULL)
+        return;
+
+    GUInt32 nURLLen = strlen(pszURL);
+    GUInt32 nValidatorLen = strlen(pszValidator);
+    GUIntBig nChunkOffset = nOffset;
+    GUIntBig nDataSize = nSize;
+    int bOK = VSIFWriteL(VSICURL_DISK_CACHE_MAGIC, 8, 1, fp) == 1 &&
+              VSIFWriteL(&nURLLen, sizeof(nURLLen), 1, fp) == 1 &&
+              VSIFWriteL(&nValidatorLen, sizeof(nValidatorLen), 1, fp) == 1 &&
+              VSIFWriteL(&nChunkOffset, sizeof(nChunkOffset), 1, fp) == 1 &&
+              VSIFWriteL(&nDataSize, sizeof(nDataSize), 1, fp) == 1 &&
+              VSIFWriteL(pszURL, 1, nURLLen, fp) == nURLLen &&
+              VSIFWriteL(pszValidator, 1, nValidatorLen, fp) == nValidatorLen &&
+              VSIFWriteL(pData, 1, nSize, fp) == nSize;
+    if (VSIFCloseL(fp) != 0)
+        bOK = FALSE;
+
+    GIntBig nEntrySize = 8 + sizeof(nURLLen) + sizeof(nValidatorLen) +
+        sizeof(nChunkOffset) + sizeof(nDataSize) + nURLLen + nValidatorLen + nSize;
+
+    /* The journal record goes first, so that a crash cannot leave a */
+    /* chunk file that would never be evicted. */
+    if (bOK)
+    {
+        Journal('A', osName, nEntrySize);
+        bOK = VSIRename(osTmpPath, osPath) == 0;
+        if (!bOK)
+            Journal('D', osName);
+    }
+    if (!bOK)
+    {
+        VSIUnlink(osTmpPath);
+        return;
+    }
+
+    if (ENABLE_DEBUG)
+         CPLDebug("VSICURL", "Write data at offset " CPL_FRMT_GUIB " to disk",
+                  nOffset);
+
+    Touch(osName, nEntrySize);
+    Evict();
 }
 
 /************************************************************************/
@@ -166,6 +875,7 @@ typedef struct
 {
     CPLString       osURL;
     CURL           *hCurlHandle;
+    CURLM          *hCurlMultiHandle;
 } CachedConnection;
 
 
@@ -173,13 +883,25 @@ class VSICurlFilesystemHandler : public VSIFilesystemHandler
 {
     void           *hMutex;
 
-    CachedRegion  **papsRegions;
-    int             nRegions;
+    /* Downloaded regions of all the files, indexed by (URL, offset) */
+    /* and chained from the most to the least recently used one. */
+    CPLHashSet     *hRegionSet;
+    CachedRegion   *psRegionLRUHead;
+    CachedRegion   *psRegionLRUTail;
+    GIntBig         nRegionCacheSize;
+    GIntBig         nRegionCacheMaxSize;
+
+    void            UnlinkRegion(CachedRegion* psRegion);
+    void            LinkRegionAtHead(CachedRegion* psRegion);
+    void            AddRegionToMemory(const char*     pszURL,
+                                      vsi_l_offset    nFileOffsetStart,
+                                      size_t          nSize,
+                                      const char     *pData);
 
     std::map<CPLString, CachedFileProp*>   cacheFileSize;
     std::map<CPLString, CachedDirList*>        cacheDirList;
 
-    int             bUseCacheDisk;
+    VSICurlDiskCache *poDiskCache;
 
     /* Per-thread Curl connection cache */
     std::map<GIntBig, CachedConnection*> mapConnections;
@@ -204,8 +926,11 @@ public:
     virtual char   **ReadDir( const char *pszDirname, int* pbGotFileList );
 
 
-    const CachedRegion* GetRegion(const char*     pszURL,
-                                  vsi_l_offset    nFileOffsetStart);
+    int                 GetRegion(const char*     pszURL,
+                                  vsi_l_offset    nOffset,
+                                  void           *pBuffer = NULL,
+                                  size_t          nSize = 0,
+                                  size_t         *pnCopied = NULL);
 
     void                AddRegion(const char*     pszURL,
                                   vsi_l_offset    nFileOffsetStart,
@@ -214,24 +939,29 @@ public:
 
     CachedFileProp*     GetCachedFileProp(const char*     pszURL);
 
-    void                AddRegionToCacheDisk(CachedRegion* psRegion);
-    const CachedRegion* GetRegionFromCacheDisk(const char*     pszURL,
-                                               vsi_l_offset nFileOffsetStart);
+    GIntBig             GetRegionCacheMaxSize() const { return nRegionCacheMaxSize; }
+
+    CPLString           GetValidator(const char* pszURL);
+    void                SetValidator(const char* pszURL,
+                                     const char* pszValidator);
 
     CURL               *GetCurlHandleFor(CPLString osURL);
+    CURLM              *GetCurlMultiHandleFor(CPLString osURL);
 };
 
 /************************************************************************/
 /*                           VSICurlHandle                              */
 /************************************************************************/
 
+typedef struct _VSICurlRangeRequest VSICurlRangeRequest;
+
 class VSICurlHandle : public VSIVirtualHandle
 {
   private:
     VSICurlFilesystemHandler* poFS;
 
     char*           pszURL;
-    unsigned long   pszURLHash;
+    unsigned long   nURLHash;
 
     vsi_l_offset    curOffset;
     vsi_l_offset    fileSize;
@@ -245,6 +975,12 @@ class VSICurlHandle : public VSIVirtualHandle
     int             bEOF;
 
     int             DownloadRegion(vsi_l_offset startOffset, int nBlocks);
+    int             DownloadRegions(int nRequests,
+                                    VSICurlRangeRequest* pasRequests);
+    void            PrepareRangeRequest(VSICurlRangeRequest* psRequest,
+                                        CURL* hCurlHandle);
+    int             FinishRangeRequest(VSICurlRangeRequest* psRequest);
+    int             GetMaxReadAheadBlocks();
 
   public:
 
@@ -254,6 +990,9 @@ class VSICurlHandle : public VSIVirtualHandle
     virtual int          Seek( vsi_l_offset nOffset, int nWhence );
     virtual vsi_l_offset Tell();
     virtual size_t       Read( void *pBuffer, size_t nSize, size_t nMemb );
+    virtual int          ReadMultiRange( int nRanges, void ** ppData,
+                                         const vsi_l_offset* panOffsets,
+                                         const size_t* panSizes );
     virtual size_t       Write( const void *pBuffer, size_t nSize, size_t nMemb );
     virtual int          Eof();
     virtual int          Flush();
@@ -415,6 +1154,55 @@ static void VSICURLInitWriteFuncStruct(WriteFuncStruct* psStruct)
     psStruct->bError = FALSE;
 }
 
+/************************************************************************/
+/*                         VSICurlRangeRequest                          */
+/************************************************************************/
+
+struct _VSICurlRangeRequest
+{
+    vsi_l_offset    nStartOffset;   /* multiple of DOWNLOAD_CHUNCK_SIZE */
+    int             nBlocks;
+    CURL           *hCurlHandle;
+    WriteFuncStruct sWriteFuncData;
+    WriteFuncStruct sWriteFuncHeaderData;
+    char            szRange[128];
+    char            szCurlErrBuf[CURL_ERROR_SIZE+1];
+};
+
+/************************************************************************/
+/*                      VSICurlGetMaxConnections()                      */
+/************************************************************************/
+
+static int VSICurlGetMaxConnections()
+{
+    int nMaxConnections =
+        atoi(CPLGetConfigOption("CPL_VSIL_CURL_MAX_CONNECTIONS", "8"));
+    if (nMaxConnections < 1)
+        nMaxConnections = 1;
+    else if (nMaxConnections > 64)
+        nMaxConnections = 64;
+    return nMaxConnections;
+}
+
+/************************************************************************/
+/*                       GetMaxReadAheadBlocks()                        */
+/*                                                                      */
+/*      Maximum number of chunks the sequential read-ahead may grow     */
+/*      to, bounded by a quarter of the region cache.                   */
+/************************************************************************/
+
+int VSICurlHandle::GetMaxReadAheadBlocks()
+{
+    GIntBig nMaxReadAhead = CPLScanUIntBig(
+        CPLGetConfigOption("CPL_VSIL_CURL_MAX_READAHEAD", "2097152"), 20);
+    int nMaxBlocks = (int) MIN(nMaxReadAhead,
+                               poFS->GetRegionCacheMaxSize() / 4) /
+                                                        DOWNLOAD_CHUNCK_SIZE;
+    if (nMaxBlocks < 1)
+        nMaxBlocks = 1;
+    return nMaxBlocks;
+}
+
 /************************************************************************/
 /*                       VSICurlHandleWriteFunc()                       */
 /************************************************************************/
@@ -477,6 +1265,37 @@ static int VSICurlHandleWriteFunc(void *buffer, size_t count, size_t nmemb, void
     }
 }
 
+/************************************************************************/
+/*                        VSICurlGetValidator()                         */
+/*                                                                      */
+/*      Build the string identifying the version of a remote file       */
+/*      from the ETag and Last-Modified response headers and the file   */
+/*      size.                                                           */
+/************************************************************************/
+
+static CPLString VSICurlGetValidator(const char* pszHeaders,
+                                     vsi_l_offset nFileSize)
+{
+    CPLString osETag, osLastModified;
+
+    if (pszHeaders != NULL)
+    {
+        char** papszLines = CSLTokenizeString2(pszHeaders, "\r\n", 0);
+        for (int i = 0; papszLines != NULL && papszLines[i] != NULL; i++)
+        {
+            const char* pszLine = papszLines[i];
+            /* With redirections, the headers of the last response win */
+            if (EQUALN(pszLine, "ETag:", 5))
+                osETag = CPLString(pszLine + 5).Trim();
+            else if (EQUALN(pszLine, "Last-Modified:", 14))
+                osLastModified = CPLString(pszLine + 14).Trim();
+        }
+        CSLDestroy(papszLines);
+    }
+
+    return osETag + "|" + osLastModified + "|" +
+           CPLSPrintf(CPL_FRMT_GUIB, nFileSize);
+}
 
 /************************************************************************/
 /*                           GetFileSize()                              */
@@ -573,6 +1392,10 @@ vsi_l_offset VSICurlHandle::GetFileSize()
             bIsDirectory = TRUE;
         }
 
+        if (eExists == EXIST_YES && !bIsDirectory)
+            poFS->SetValidator(pszURL,
+                               VSICurlGetValidator(sWriteFuncData.pBuffer, fileSize));
+
         if (ENABLE_DEBUG)
             CPLDebug("VSICURL", "GetFileSize(%s)=" CPL_FRMT_GUIB "  response_code=%d",
                     pszURL, fileSize, (int)response_code);
@@ -610,59 +1433,67 @@ vsi_l_offset VSICurlHandle::Tell()
 }
 
 /************************************************************************/
-/*                          DownloadRegion()                            */
+/*                        PrepareRangeRequest()                         */
 /************************************************************************/
 
-int VSICurlHandle::DownloadRegion(vsi_l_offset startOffset, int nBlocks)
+void VSICurlHandle::PrepareRangeRequest(VSICurlRangeRequest* psRequest,
+                                        CURL* hCurlHandle)
 {
-    WriteFuncStruct sWriteFuncData;
-    WriteFuncStruct sWriteFuncHeaderData;
+    psRequest->hCurlHandle = hCurlHandle;
 
-    CachedFileProp* cachedFileProp = poFS->GetCachedFileProp(pszURL);
-    if (cachedFileProp->eExists == EXIST_NO)
-        return FALSE;
-
-    CURL* hCurlHandle = poFS->GetCurlHandleFor(pszURL);
     VSICurlSetOptions(hCurlHandle, pszURL);
 
-    VSICURLInitWriteFuncStruct(&sWriteFuncData);
-    curl_easy_setopt(hCurlHandle, CURLOPT_WRITEDATA, &sWriteFuncData);
+    VSICURLInitWriteFuncStruct(&psRequest->sWriteFuncData);
+    curl_easy_setopt(hCurlHandle, CURLOPT_WRITEDATA, &psRequest->sWriteFuncData);
     curl_easy_setopt(hCurlHandle, CURLOPT_WRITEFUNCTION, VSICurlHandleWriteFunc);
 
-    VSICURLInitWriteFuncStruct(&sWriteFuncHeaderData);
-    curl_easy_setopt(hCurlHandle, CURLOPT_HEADERDATA, &sWriteFuncHeaderData);
+    VSICURLInitWriteFuncStruct(&psRequest->sWriteFuncHeaderData);
+    curl_easy_setopt(hCurlHandle, CURLOPT_HEADERDATA, &psRequest->sWriteFuncHeaderData);
     curl_easy_setopt(hCurlHandle, CURLOPT_HEADERFUNCTION, VSICurlHandleWriteFunc);
-    sWriteFuncHeaderData.bIsHTTP = strncmp(pszURL, "http", 4) == 0;
-    sWriteFuncHeaderData.nStartOffset = startOffset;
-    sWriteFuncHeaderData.nEndOffset = startOffset + nBlocks * DOWNLOAD_CHUNCK_SIZE - 1;
+    psRequest->sWriteFuncHeaderData.bIsHTTP = strncmp(pszURL, "http", 4) == 0;
+    psRequest->sWriteFuncHeaderData.nStartOffset = psRequest->nStartOffset;
+    psRequest->sWriteFuncHeaderData.nEndOffset = psRequest->nStartOffset +
+        (vsi_l_offset)psRequest->nBlocks * DOWNLOAD_CHUNCK_SIZE - 1;
 
-    char rangeStr[512];
-    sprintf(rangeStr, CPL_FRMT_GUIB "-" CPL_FRMT_GUIB, startOffset, startOffset + nBlocks * DOWNLOAD_CHUNCK_SIZE - 1);
+    sprintf(psRequest->szRange, CPL_FRMT_GUIB "-" CPL_FRMT_GUIB,
+            psRequest->sWriteFuncHeaderData.nStartOffset,
+            psRequest->sWriteFuncHeaderData.nEndOffset);
 
     if (ENABLE_DEBUG)
-        CPLDebug("VSICURL", "Downloading %s (%s)...", rangeStr, pszURL);
+        CPLDebug("VSICURL", "Downloading %s (%s)...", psRequest->szRange, pszURL);
 
-    curl_easy_setopt(hCurlHandle, CURLOPT_RANGE, rangeStr);
+    curl_easy_setopt(hCurlHandle, CURLOPT_RANGE, psRequest->szRange);
 
-    char szCurlErrBuf[CURL_ERROR_SIZE+1];
-    szCurlErrBuf[0] = '\0';
-    curl_easy_setopt(hCurlHandle, CURLOPT_ERRORBUFFER, szCurlErrBuf );
+    psRequest->szCurlErrBuf[0] = '\0';
+    curl_easy_setopt(hCurlHandle, CURLOPT_ERRORBUFFER, psRequest->szCurlErrBuf );
+}
 
-    curl_easy_perform(hCurlHandle);
+/************************************************************************/
+/*                         FinishRangeRequest()                         */
+/*                                                                      */
+/*      Check the result of a completed range request and add the       */
+/*      received data to the region cache. The received data is left    */
+/*      in sWriteFuncData for the caller to free.                       */
+/************************************************************************/
+
+int VSICurlHandle::FinishRangeRequest(VSICurlRangeRequest* psRequest)
+{
+    CURL* hCurlHandle = psRequest->hCurlHandle;
+    CachedFileProp* cachedFileProp = poFS->GetCachedFileProp(pszURL);
 
     curl_easy_setopt(hCurlHandle, CURLOPT_WRITEDATA, NULL);
     curl_easy_setopt(hCurlHandle, CURLOPT_WRITEFUNCTION, NULL);
     curl_easy_setopt(hCurlHandle, CURLOPT_HEADERDATA, NULL);
     curl_easy_setopt(hCurlHandle, CURLOPT_HEADERFUNCTION, NULL);
+    curl_easy_setopt(hCurlHandle, CURLOPT_ERRORBUFFER, NULL);
 
     long response_code = 0;
     curl_easy_getinfo(hCurlHandle, CURLINFO_HTTP_CODE, &response_code);
 
-    char *content_type = 0;
-    curl_easy_getinfo(hCurlHandle, CURLINFO_CONTENT_TYPE, &content_type);
-
+    const char* szCurlErrBuf = psRequest->szCurlErrBuf;
     if ((response_code != 200 && response_code != 206 &&
-        response_code != 226 && response_code != 426) || sWriteFuncHeaderData.bError)
+        response_code != 226 && response_code != 426) ||
+        psRequest->sWriteFuncHeaderData.bError)
     {
         if (response_code >= 400 && szCurlErrBuf[0] != '\0')
         {
@@ -676,16 +1507,24 @@ int VSICurlHandle::DownloadRegion(vsi_l_offset startOffset, int nBlocks)
         bHastComputedFileSize = cachedFileProp->bHastComputedFileSize = TRUE;
         cachedFileProp->fileSize = 0;
         cachedFileProp->eExists = EXIST_NO;
-        CPLFree(sWriteFuncData.pBuffer);
-        CPLFree(sWriteFuncHeaderData.pBuffer);
         return FALSE;
     }
 
-    if (!bHastComputedFileSize && sWriteFuncHeaderData.pBuffer)
+    char* pszHeader = psRequest->sWriteFuncHeaderData.pBuffer;
+
+    /* Keep the headers identifying the version of the file for the */
+    /* disk cache, if not already known. They are altered below. */
+    CPLString osValidatorHeaders;
+    int bNeedValidator = (pszHeader != NULL &&
+                          poFS->GetValidator(pszURL).size() == 0);
+    if (bNeedValidator)
+        osValidatorHeaders = pszHeader;
+
+    if (!bHastComputedFileSize && pszHeader)
     {
         /* Try to retrieve the filesize from the HTTP headers */
         /* if in the form : "Content-Range: bytes x-y/filesize" */
-        char* pszContentRange = strstr(sWriteFuncHeaderData.pBuffer, "Content-Range: bytes ");
+        char* pszContentRange = strstr(pszHeader, "Content-Range: bytes ");
         if (pszContentRange)
         {
             char* pszEOL = strchr(pszContentRange, '\n');
@@ -706,7 +1545,7 @@ int VSICurlHandle::DownloadRegion(vsi_l_offset startOffset, int nBlocks)
         else if (strncmp(pszURL, "ftp", 3) == 0)
         {
             /* Parse 213 answer for FTP protocol */
-            char* pszSize = strstr(sWriteFuncHeaderData.pBuffer, "213 ");
+            char* pszSize = strstr(pszHeader, "213 ");
             if (pszSize)
             {
                 pszSize += 4;
@@ -737,34 +1576,215 @@ int VSICurlHandle::DownloadRegion(vsi_l_offset startOffset, int nBlocks)
         }
     }
 
-    lastDownloadedOffset = startOffset + nBlocks * DOWNLOAD_CHUNCK_SIZE;
+    if (bNeedValidator && bHastComputedFileSize && fileSize != 0)
+        poFS->SetValidator(pszURL,
+                           VSICurlGetValidator(osValidatorHeaders, fileSize));
 
-    char* pBuffer = sWriteFuncData.pBuffer;
-    int nSize = sWriteFuncData.nSize;
+    vsi_l_offset startOffset = psRequest->nStartOffset;
+    char* pBuffer = psRequest->sWriteFuncData.pBuffer;
+    size_t nSize = psRequest->sWriteFuncData.nSize;
 
-    if (nSize > nBlocks * DOWNLOAD_CHUNCK_SIZE)
+    if (nSize > (size_t)psRequest->nBlocks * DOWNLOAD_CHUNCK_SIZE)
     {
         if (ENABLE_DEBUG)
             CPLDebug("VSICURL", "Got more data than expected : %d instead of %d",
-                     nSize, nBlocks * DOWNLOAD_CHUNCK_SIZE);
+                     (int)nSize, psRequest->nBlocks * DOWNLOAD_CHUNCK_SIZE);
     }
-    
+
     while(nSize > 0)
     {
+        size_t nChunkSize = MIN(DOWNLOAD_CHUNCK_SIZE, nSize);
         //if (ENABLE_DEBUG)
-        //    CPLDebug("VSICURL", "Add region %d - %d", startOffset, MIN(DOWNLOAD_CHUNCK_SIZE, nSize));
-        poFS->AddRegion(pszURL, startOffset, MIN(DOWNLOAD_CHUNCK_SIZE, nSize), pBuffer);
+        //    CPLDebug("VSICURL", "Add region %d - %d", startOffset, nChunkSize);
+        poFS->AddRegion(pszURL, startOffset, nChunkSize, pBuffer);
         startOffset += DOWNLOAD_CHUNCK_SIZE;
-        pBuffer += DOWNLOAD_CHUNCK_SIZE;
-        nSize -= DOWNLOAD_CHUNCK_SIZE;
+        pBuffer += nChunkSize;
+        nSize -= nChunkSize;
     }
 
-    CPLFree(sWriteFuncData.pBuffer);
-    CPLFree(sWriteFuncHeaderData.pBuffer);
-
     return TRUE;
 }
 
+/************************************************************************/
+/*                          DownloadRegions()                           */
+/*                                                                      */
+/*      Run a set of range requests. A single request goes through      */
+/*      the per-thread connection, several requests are run             */
+/*      concurrently, at most CPL_VSIL_CURL_MAX_CONNECTIONS at a time,  */
+/*      through the per-thread multi handle.                            */
+/************************************************************************/
+
+int VSICurlHandle::DownloadRegions(int nRequests,
+                                   VSICurlRangeRequest* pasRequests)
+{
+    int i;
+
+    for(i=0;i<nRequests;i++)
+    {
+        pasRequests[i].hCurlHandle = NULL;
+        VSICURLInitWriteFuncStruct(&pasRequests[i].sWriteFuncData);
+        VSICURLInitWriteFuncStruct(&pasRequests[i].sWriteFuncHeaderData);
+    }
+
+    CachedFileProp* cachedFileProp = poFS->GetCachedFileProp(pszURL);
+    if (cachedFileProp->eExists == EXIST_NO)
+        return FALSE;
+
+    if (nRequests == 1)
+    {
+        PrepareRangeRequest(pasRequests, poFS->GetCurlHandleFor(pszURL));
+        curl_easy_perform(pasRequests[0].hCurlHandle);
+        return FinishRangeRequest(pasRequests);
+    }
+
+    CURLM* hCurlMultiHandle = poFS->GetCurlMultiHandleFor(pszURL);
+    int nMaxConnections = VSICurlGetMaxConnections();
+    int nNextRequest = 0;
+    int nActiveRequests = 0;
+
+    while (nNextRequest < nRequests || nActiveRequests > 0)
+    {
+        while (nNextRequest < nRequests && nActiveRequests < nMaxConnections)
+        {
+            PrepareRangeRequest(&pasRequests[nNextRequest], curl_easy_init());
+            curl_multi_add_handle(hCurlMultiHandle,
+                                  pasRequests[nNextRequest].hCurlHandle);
+            nNextRequest ++;
+            nActiveRequests ++;
+        }
+
+        int nStillRunning = 0;
+        while (curl_multi_perform(hCurlMultiHandle, &nStillRunning) ==
+               CURLM_CALL_MULTI_PERFORM) {}
+
+        int nMsgsInQueue;
+        CURLMsg* psMsg;
+        int bRequestCompleted = FALSE;
+        while ((psMsg = curl_multi_info_read(hCurlMultiHandle,
+                                             &nMsgsInQueue)) != NULL)
+        {
+            if (psMsg->msg == CURLMSG_DONE)
+            {
+                curl_multi_remove_handle(hCurlMultiHandle, psMsg->easy_handle);
+                nActiveRequests --;
+                bRequestCompleted = TRUE;
+            }
+        }
+
+        if (nStillRunning > 0 && !bRequestCompleted)
+        {
+#if LIBCURL_VERSION_NUM >= 0x071C00
+            curl_multi_wait(hCurlMultiHandle, NULL, 0, 1000, NULL);
+#else
+            fd_set fdread, fdwrite, fdexcep;
+            int nMaxFD = -1;
+            FD_ZERO(&fdread);
+            FD_ZERO(&fdwrite);
+            FD_ZERO(&fdexcep);
+            curl_multi_fdset(hCurlMultiHandle, &fdread, &fdwrite, &fdexcep,
+                             &nMaxFD);
+            struct timeval sTimeout;
+            sTimeout.tv_sec = 0;
+            sTimeout.tv_usec = (nMaxFD < 0) ? 10000 : 1000000;
+            select(nMaxFD + 1, &fdread, &fdwrite, &fdexcep, &sTimeout);
+#endif
+        }
+    }
+
+    int bRet = TRUE;
+    for(i=0;i<nRequests;i++)
+    {
+        if (bRet && !FinishRangeRequest(&pasRequests[i]))
+            bRet = FALSE;
+        curl_easy_cleanup(pasRequests[i].hCurlHandle);
+        pasRequests[i].hCurlHandle = NULL;
+    }
+
+    return bRet;
+}
+
+/************************************************************************/
+/*                      VSICurlFreeRangeRequests()                      */
+/************************************************************************/
+
+static void VSICurlFreeRangeRequests(std::vector<VSICurlRangeRequest>& asRequests)
+{
+    for(size_t i=0;i<asRequests.size();i++)
+    {
+        CPLFree(asRequests[i].sWriteFuncData.pBuffer);
+        CPLFree(asRequests[i].sWriteFuncHeaderData.pBuffer);
+    }
+    asRequests.clear();
+}
+
+/************************************************************************/
+/*                      VSICurlSplitRangeRequests()                     */
+/*                                                                      */
+/*      Split the largest requests in halves until there are enough     */
+/*      of them to use all the allowed connections, so that a large     */
+/*      contiguous range is fetched concurrently. Parts are kept of     */
+/*      at least VSICURL_MIN_PART_BLOCKS chunks.                        */
+/************************************************************************/
+
+static void VSICurlSplitRangeRequests(std::vector<VSICurlRangeRequest>& asRequests)
+{
+    int nMaxConnections = VSICurlGetMaxConnections();
+
+    while ((int)asRequests.size() < nMaxConnections)
+    {
+        size_t iLargest = 0;
+        for(size_t i=1;i<asRequests.size();i++)
+        {
+            if (asRequests[i].nBlocks > asRequests[iLargest].nBlocks)
+                iLargest = i;
+        }
+        if (asRequests.empty() ||
+            asRequests[iLargest].nBlocks < 2 * VSICURL_MIN_PART_BLOCKS)
+            break;
+
+        VSICurlRangeRequest sSecondHalf = asRequests[iLargest];
+        int nFirstHalfBlocks = asRequests[iLargest].nBlocks / 2;
+        asRequests[iLargest].nBlocks = nFirstHalfBlocks;
+        sSecondHalf.nStartOffset +=
+            (vsi_l_offset)nFirstHalfBlocks * DOWNLOAD_CHUNCK_SIZE;
+        sSecondHalf.nBlocks -= nFirstHalfBlocks;
+        asRequests.insert(asRequests.begin() + iLargest + 1, sSecondHalf);
+    }
+}
+
+/************************************************************************/
+/*                          DownloadRegion()                            */
+/************************************************************************/
+
+int VSICurlHandle::DownloadRegion(vsi_l_offset startOffset, int nBlocks)
+{
+    /* Large HTTP read-aheads are split into parts fetched concurrently. */
+    /* This is only done when the file size is known, so that no part */
+    /* starts beyond the end of file. */
+    int bSplit = strncmp(pszURL, "http", 4) == 0 && bHastComputedFileSize;
+    if (bSplit &&
+        startOffset + (vsi_l_offset)nBlocks * DOWNLOAD_CHUNCK_SIZE > fileSize &&
+        startOffset < fileSize)
+    {
+        nBlocks = (int)((fileSize - startOffset + DOWNLOAD_CHUNCK_SIZE - 1) /
+                                                    DOWNLOAD_CHUNCK_SIZE);
+    }
+
+    std::vector<VSICurlRangeRequest> asRequests(1);
+    asRequests[0].nStartOffset = startOffset;
+    asRequests[0].nBlocks = nBlocks;
+    if (bSplit)
+        VSICurlSplitRangeRequests(asRequests);
+
+    int bRet = DownloadRegions((int)asRequests.size(), &asRequests[0]);
+    VSICurlFreeRangeRequests(asRequests);
+
+    if (bRet)
+        lastDownloadedOffset = startOffset + (vsi_l_offset)nBlocks * DOWNLOAD_CHUNCK_SIZE;
+
+    return bRet;
+}
+
 /************************************************************************/
 /*                                Read()                                */
 /************************************************************************/
@@ -778,10 +1798,12 @@ size_t VSICurlHandle::Read( void *pBuffer, size_t nSize, size_t nMemb )
     //CPLDebug("VSICURL", "offset=%d, size=%d", (int)curOffset, (int)nBufferRequestSize);
 
     vsi_l_offset iterOffset = curOffset;
+    int nRetries = 0;
     while (nBufferRequestSize)
     {
-        const CachedRegion* psRegion = poFS->GetRegion(pszURL, iterOffset);
-        if (psRegion == NULL)
+        size_t nCopied = 0;
+        if (!poFS->GetRegion(pszURL, iterOffset, pBuffer,
+                             nBufferRequestSize, &nCopied))
         {
             vsi_l_offset nOffsetToDownload =
                 (iterOffset / DOWNLOAD_CHUNCK_SIZE) * DOWNLOAD_CHUNCK_SIZE;
@@ -792,8 +1814,9 @@ size_t VSICurlHandle::Read( void *pBuffer, size_t nSize, size_t nMemb )
                 /* heuristic that we will read the file sequentially, so */
                 /* we double the requested size to decrease the number of */
                 /* client/server roundtrips. */
-                if (nBlocksToDownload < 100)
-                    nBlocksToDownload *= 2;
+                int nMaxBlocks = GetMaxReadAheadBlocks();
+                if (nBlocksToDownload < nMaxBlocks)
+                    nBlocksToDownload = MIN(nBlocksToDownload * 2, nMaxBlocks);
             }
             else
             {
@@ -809,12 +1832,19 @@ size_t VSICurlHandle::Read( void *pBuffer, size_t nSize, size_t nMemb )
                 ((nEndOffsetToDownload - nOffsetToDownload) / DOWNLOAD_CHUNCK_SIZE);
             if (nBlocksToDownload < nMinBlocksToDownload)
                 nBlocksToDownload = nMinBlocksToDownload;
+
+            /* But no more than what the region cache can hold, since the */
+            /* data is copied from it. Larger reads loop over downloads. */
+            int nMaxCachedBlocks = (int)
+                (poFS->GetRegionCacheMaxSize() / 2 / DOWNLOAD_CHUNCK_SIZE);
+            if (nBlocksToDownload > MAX(1, nMaxCachedBlocks))
+                nBlocksToDownload = MAX(1, nMaxCachedBlocks);
                 
             int i;
             /* Avoid reading already cached data */
             for(i=1;i<nBlocksToDownload;i++)
             {
-                if (poFS->GetRegion(pszURL, nOffsetToDownload + i * DOWNLOAD_CHUNCK_SIZE) != NULL)
+                if (poFS->GetRegion(pszURL, nOffsetToDownload + i * DOWNLOAD_CHUNCK_SIZE))
                 {
                     nBlocksToDownload = i;
                     break;
@@ -826,20 +1856,23 @@ size_t VSICurlHandle::Read( void *pBuffer, size_t nSize, size_t nMemb )
                 bEOF = TRUE;
                 return 0;
             }
-            psRegion = poFS->GetRegion(pszURL, iterOffset);
-        }
-        if (psRegion == NULL || psRegion->pData == NULL)
-        {
-            bEOF = TRUE;
-            return 0;
+            if (!poFS->GetRegion(pszURL, iterOffset, pBuffer,
+                                 nBufferRequestSize, &nCopied))
+            {
+                /* Evicted by other threads in the meantime ? */
+                if (++nRetries < 3)
+                    continue;
+                bEOF = TRUE;
+                return 0;
+            }
         }
-        int nToCopy = (int) MIN(nBufferRequestSize, psRegion->nSize - (iterOffset - psRegion->nFileOffsetStart));
-        memcpy(pBuffer, psRegion->pData + iterOffset - psRegion->nFileOffsetStart,
-                nToCopy);
-        pBuffer = (char*) pBuffer + nToCopy;
-        iterOffset += nToCopy;
-        nBufferRequestSize -= nToCopy;
-        if (psRegion->nSize != DOWNLOAD_CHUNCK_SIZE && nBufferRequestSize != 0)
+        if (nCopied == 0)
+            break;
+        pBuffer = (char*) pBuffer + nCopied;
+        iterOffset += nCopied;
+        nBufferRequestSize -= nCopied;
+        /* A short chunk is the last one of the file */
+        if ((iterOffset % DOWNLOAD_CHUNCK_SIZE) != 0 && nBufferRequestSize != 0)
         {
             break;
         }
@@ -854,6 +1887,188 @@ size_t VSICurlHandle::Read( void *pBuffer, size_t nSize, size_t nMemb )
     return ret;
 }
 
+/************************************************************************/
+/*                           ReadMultiRange()                           */
+/************************************************************************/
+
+int VSICurlHandle::ReadMultiRange( int nRanges, void ** ppData,
+                                   const vsi_l_offset* panOffsets,
+                                   const size_t* panSizes )
+{
+    if (nRanges <= 1 || strncmp(pszURL, "http", 4) != 0)
+        return VSIVirtualHandle::ReadMultiRange(nRanges, ppData,
+                                                panOffsets, panSizes);
+
+/* -------------------------------------------------------------------- */
+/*      Collect the chunks that are not already cached.                 */
+/* -------------------------------------------------------------------- */
+    std::vector<vsi_l_offset> anMissingBlocks;
+    int i;
+
+    for(i=0;i<nRanges;i++)
+    {
+        if (panSizes[i] == 0)
+            continue;
+
+        vsi_l_offset nFirstBlock = panOffsets[i] / DOWNLOAD_CHUNCK_SIZE;
+        vsi_l_offset nLastBlock =
+            (panOffsets[i] + panSizes[i] - 1) / DOWNLOAD_CHUNCK_SIZE;
+        if (bHastComputedFileSize && fileSize > 0 &&
+            nLastBlock > (fileSize - 1) / DOWNLOAD_CHUNCK_SIZE)
+            nLastBlock = (fileSize - 1) / DOWNLOAD_CHUNCK_SIZE;
+
+        for(vsi_l_offset nBlock = nFirstBlock; nBlock <= nLastBlock; nBlock++)
+        {
+            if (!anMissingBlocks.empty() && anMissingBlocks.back() == nBlock)
+                continue;
+            if (!poFS->GetRegion(pszURL, nBlock * DOWNLOAD_CHUNCK_SIZE))
+                anMissingBlocks.push_back(nBlock);
+        }
+    }
+
+    std::sort(anMissingBlocks.begin(), anMissingBlocks.end());
+    anMissingBlocks.erase(std::unique(anMissingBlocks.begin(),
+                                      anMissingBlocks.end()),
+                          anMissingBlocks.end());
+
+/* -------------------------------------------------------------------- */
+/*      Successive multi-range reads that continue where the previous   */
+/*      download stopped get the same growing read-ahead as Read().     */
+/*      This is only done when the file size is known, so that we do    */
+/*      not request ranges beyond the end of file.                      */
+/* -------------------------------------------------------------------- */
+    if (!anMissingBlocks.empty() && bHastComputedFileSize && fileSize > 0)
+    {
+        if (anMissingBlocks[0] * DOWNLOAD_CHUNCK_SIZE == lastDownloadedOffset)
+        {
+            int nMaxBlocks = GetMaxReadAheadBlocks();
+            if (nBlocksToDownload < nMaxBlocks)
+                nBlocksToDownload = MIN(nBlocksToDownload * 2, nMaxBlocks);
+
+            vsi_l_offset nLastFileBlock = (fileSize - 1) / DOWNLOAD_CHUNCK_SIZE;
+            vsi_l_offset nBlock = anMissingBlocks.back() + 1;
+            for(i=0;i<nBlocksToDownload && nBlock <= nLastFileBlock;i++,nBlock++)
+                anMissingBlocks.push_back(nBlock);
+        }
+        else
+            nBlocksToDownload = 1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Merge them into requests. Missing chunks separated by less      */
+/*      than CPL_VSIL_CURL_MERGE_GAP bytes are fetched by the same      */
+/*      request, since a round trip costs more than a few extra bytes.  */
+/* -------------------------------------------------------------------- */
+    vsi_l_offset nMergeGapBlocks = CPLScanUIntBig(
+        CPLGetConfigOption("CPL_VSIL_CURL_MERGE_GAP", "65536"), 20) /
+                                                        DOWNLOAD_CHUNCK_SIZE;
+    int nMaxRequestBlocks = GetMaxReadAheadBlocks();
+
+    std::vector<VSICurlRangeRequest> asRequests;
+    size_t iBlock = 0;
+    while (iBlock < anMissingBlocks.size())
+    {
+        vsi_l_offset nStartBlock = anMissingBlocks[iBlock];
+        vsi_l_offset nEndBlock = nStartBlock;
+        iBlock ++;
+        while (iBlock < anMissingBlocks.size() &&
+               anMissingBlocks[iBlock] - nEndBlock - 1 <= nMergeGapBlocks &&
+               anMissingBlocks[iBlock] - nStartBlock < (vsi_l_offset)nMaxRequestBlocks)
+        {
+            nEndBlock = anMissingBlocks[iBlock];
+            iBlock ++;
+        }
+
+        VSICurlRangeRequest sRequest;
+        sRequest.nStartOffset = nStartBlock * DOWNLOAD_CHUNCK_SIZE;
+        sRequest.nBlocks = (int)(nEndBlock - nStartBlock + 1);
+        asRequests.push_back(sRequest);
+    }
+
+    if (bHastComputedFileSize)
+        VSICurlSplitRangeRequests(asRequests);
+
+    int nRequests = (int)asRequests.size();
+    VSICurlRangeRequest* pasRequests = (nRequests) ? &asRequests[0] : NULL;
+    if (nRequests && !DownloadRegions(nRequests, pasRequests))
+    {
+        VSICurlFreeRangeRequests(asRequests);
+        return -1;
+    }
+    if (nRequests)
+        lastDownloadedOffset = (anMissingBlocks.back() + 1) * DOWNLOAD_CHUNCK_SIZE;
+
+/* -------------------------------------------------------------------- */
+/*      Copy the data to the output buffers, directly from the          */
+/*      received data so that we do not depend on it staying in the     */
+/*      region cache. Chunks that were already cached are read          */
+/*      through Read().                                                 */
+/* -------------------------------------------------------------------- */
+    vsi_l_offset nSavedOffset = curOffset;
+    int bSavedEOF = bEOF;
+    int nRet = 0;
+
+    for(i=0;i<nRanges && nRet == 0;i++)
+    {
+        vsi_l_offset nOffset = panOffsets[i];
+        size_t nRemaining = panSizes[i];
+        char* pabyDst = (char*) ppData[i];
+
+        while (nRemaining > 0)
+        {
+            /* Find the last request starting at or before nOffset */
+            int nLow = 0, nHigh = nRequests - 1, iReq = -1;
+            while (nLow <= nHigh)
+            {
+                int nMid = (nLow + nHigh) / 2;
+                if (pasRequests[nMid].nStartOffset <= nOffset)
+                {
+                    iReq = nMid;
+                    nLow = nMid + 1;
+                }
+                else
+                    nHigh = nMid - 1;
+            }
+
+            size_t nToCopy;
+            if (iReq >= 0 && nOffset < pasRequests[iReq].nStartOffset +
+                                    pasRequests[iReq].sWriteFuncData.nSize)
+            {
+                VSICurlRangeRequest* psRequest = &pasRequests[iReq];
+                size_t nOffsetInRequest =
+                    (size_t)(nOffset - psRequest->nStartOffset);
+                nToCopy = MIN(nRemaining,
+                    psRequest->sWriteFuncData.nSize - nOffsetInRequest);
+                memcpy(pabyDst,
+                       psRequest->sWriteFuncData.pBuffer + nOffsetInRequest,
+                       nToCopy);
+            }
+            else
+            {
+                nToCopy = (size_t) MIN((vsi_l_offset)nRemaining,
+                    DOWNLOAD_CHUNCK_SIZE - nOffset % DOWNLOAD_CHUNCK_SIZE);
+                Seek(nOffset, SEEK_SET);
+                if (Read(pabyDst, 1, nToCopy) != nToCopy)
+                {
+                    nRet = -1;
+                    break;
+                }
+            }
+
+            pabyDst += nToCopy;
+            nOffset += nToCopy;
+            nRemaining -= nToCopy;
+        }
+    }
+
+    curOffset = nSavedOffset;
+    bEOF = bSavedEOF;
+
+    VSICurlFreeRangeRequests(asRequests);
+
+    return nRet;
+}
+
 /************************************************************************/
 /*                               Write()                                */
 /************************************************************************/
@@ -901,9 +2116,18 @@ int       VSICurlHandle::Close()
 VSICurlFilesystemHandler::VSICurlFilesystemHandler()
 {
     hMutex = NULL;
-    papsRegions = NULL;
-    nRegions = 0;
-    bUseCacheDisk = CSLTestBoolean(CPLGetConfigOption("CPL_VSIL_CURL_USE_CACHE", "NO"));
+    hRegionSet = CPLHashSetNew(VSICurlRegionHash, VSICurlRegionEqual, NULL);
+    psRegionLRUHead = NULL;
+    psRegionLRUTail = NULL;
+    nRegionCacheSize = 0;
+    nRegionCacheMaxSize = CPLScanUIntBig(
+        CPLGetConfigOption("CPL_VSIL_CURL_CACHE_SIZE",
+                           CPLSPrintf("%d", DEFAULT_REGION_CACHE_SIZE)), 20);
+    if (nRegionCacheMaxSize < DOWNLOAD_CHUNCK_SIZE)
+        nRegionCacheMaxSize = DOWNLOAD_CHUNCK_SIZE;
+    poDiskCache = NULL;
+    if (CSLTestBoolean(CPLGetConfigOption("CPL_VSIL_CURL_USE_CACHE", "NO")))
+        poDiskCache = new VSICurlDiskCache();
 }
 
 /************************************************************************/
@@ -912,18 +2136,24 @@ VSICurlFilesystemHandler::VSICurlFilesystemHandler()
 
 VSICurlFilesystemHandler::~VSICurlFilesystemHandler()
 {
-    int i;
-    for(i=0;i<nRegions;i++)
+    CachedRegion* psRegion = psRegionLRUHead;
+    while (psRegion != NULL)
     {
-        CPLFree(papsRegions[i]->pData);
-        CPLFree(papsRegions[i]);
+        CachedRegion* psNext = psRegion->psNext;
+        CPLFree(psRegion->pszURL);
+        CPLFree(psRegion->pData);
+        CPLFree(psRegion);
+        psRegion = psNext;
     }
-    CPLFree(papsRegions);
+    CPLHashSetDestroy(hRegionSet);
+
+    delete poDiskCache;
 
     std::map<CPLString, CachedFileProp*>::const_iterator iterCacheFileSize;
 
     for( iterCacheFileSize = cacheFileSize.begin(); iterCacheFileSize != cacheFileSize.end(); iterCacheFileSize++ )
     {
+        CPLFree(iterCacheFileSize->second->pszValidator);
         CPLFree(iterCacheFileSize->second);
     }
 
@@ -939,6 +2169,8 @@ VSICurlFilesystemHandler::~VSICurlFilesystemHandler()
     for( iterConnections = mapConnections.begin(); iterConnections != mapConnections.end(); iterConnections++ )
     {
         curl_easy_cleanup(iterConnections->second->hCurlHandle);
+        if (iterConnections->second->hCurlMultiHandle)
+            curl_multi_cleanup(iterConnections->second->hCurlMultiHandle);
         delete iterConnections->second;
     }
 
@@ -964,6 +2196,7 @@ CURL* VSICurlFilesystemHandler::GetCurlHandleFor(CPLString osURL)
         CachedConnection* psCachedConnection = new CachedConnection;
         psCachedConnection->osURL = osURL;
         psCachedConnection->hCurlHandle = hCurlHandle;
+        psCachedConnection->hCurlMultiHandle = NULL;
         mapConnections[CPLGetPID()] = psCachedConnection;
         return hCurlHandle;
     }
@@ -996,135 +2229,139 @@ CURL* VSICurlFilesystemHandler::GetCurlHandleFor(CPLString osURL)
 
 
 /************************************************************************/
-/*                   GetRegionFromCacheDisk()                           */
+/*                      GetCurlMultiHandleFor()                         */
+/*                                                                      */
+/*      Per-thread multi handle used to run concurrent range requests.  */
+/*      It is kept alive so that its connections can be reused.        */
 /************************************************************************/
 
-const CachedRegion* 
-VSICurlFilesystemHandler::GetRegionFromCacheDisk(const char* pszURL,
-                                                 vsi_l_offset nFileOffsetStart)
+CURLM* VSICurlFilesystemHandler::GetCurlMultiHandleFor(CPLString osURL)
 {
-    nFileOffsetStart = (nFileOffsetStart / DOWNLOAD_CHUNCK_SIZE) * DOWNLOAD_CHUNCK_SIZE;
-    VSILFILE* fp = VSIFOpenL(VSICurlGetCacheFileName(), "rb");
-    if (fp)
-    {
-        unsigned long   pszURLHash = CPLHashSetHashStr(pszURL);
-        unsigned long   pszURLHashCached;
-        vsi_l_offset    nFileOffsetStartCached;
-        size_t          nSizeCached;
-        while(TRUE)
-        {
-            if (VSIFReadL(&pszURLHashCached, 1, sizeof(unsigned long), fp) == 0)
-                break;
-            VSIFReadL(&nFileOffsetStartCached, 1, sizeof(vsi_l_offset), fp);
-            VSIFReadL(&nSizeCached, 1, sizeof(size_t), fp);
-            if (pszURLHash == pszURLHashCached &&
-                nFileOffsetStart == nFileOffsetStartCached)
-            {
-                if (ENABLE_DEBUG)
-                    CPLDebug("VSICURL", "Got data at offset " CPL_FRMT_GUIB " from disk" , nFileOffsetStart);
-                if (nSizeCached)
-                {
-                    char* pBuffer = (char*) CPLMalloc(nSizeCached);
-                    VSIFReadL(pBuffer, 1, nSizeCached, fp);
-                    AddRegion(pszURL, nFileOffsetStart, nSizeCached, pBuffer);
-                    CPLFree(pBuffer);
-                }
-                else
-                {
-                    AddRegion(pszURL, nFileOffsetStart, 0, NULL);
-                }
-                VSIFCloseL(fp);
-                return GetRegion(pszURL, nFileOffsetStart);
-            }
-            else
-            {
-                VSIFSeekL(fp, nSizeCached, SEEK_CUR);
-            }
-        }
-        VSIFCloseL(fp);
-    }
-    return NULL;
+    GetCurlHandleFor(osURL);
+
+    CPLMutexHolder oHolder( &hMutex );
+
+    CachedConnection* psCachedConnection = mapConnections[CPLGetPID()];
+    if (psCachedConnection->hCurlMultiHandle == NULL)
+        psCachedConnection->hCurlMultiHandle = curl_multi_init();
+
+    return psCachedConnection->hCurlMultiHandle;
 }
 
 
 /************************************************************************/
-/*                  AddRegionToCacheDisk()                                */
+/*                           UnlinkRegion()                             */
+/************************************************************************/
+
+void VSICurlFilesystemHandler::UnlinkRegion(CachedRegion* psRegion)
+{
+    if (psRegion->psPrev)
+        psRegion->psPrev->psNext = psRegion->psNext;
+    else
+        psRegionLRUHead = psRegion->psNext;
+    if (psRegion->psNext)
+        psRegion->psNext->psPrev = psRegion->psPrev;
+    else
+        psRegionLRUTail = psRegion->psPrev;
+    psRegion->psPrev = psRegion->psNext = NULL;
+}
+
+/************************************************************************/
+/*                         LinkRegionAtHead()                           */
 /************************************************************************/
 
-void VSICurlFilesystemHandler::AddRegionToCacheDisk(CachedRegion* psRegion)
+void VSICurlFilesystemHandler::LinkRegionAtHead(CachedRegion* psRegion)
+{
+    psRegion->psPrev = NULL;
+    psRegion->psNext = psRegionLRUHead;
+    if (psRegionLRUHead)
+        psRegionLRUHead->psPrev = psRegion;
+    else
+        psRegionLRUTail = psRegion;
+    psRegionLRUHead = psRegion;
+}
+
+/************************************************************************/
+/*                          GetRegion()                                 */
+/*                                                                      */
+/*      Look for the cached chunk containing nOffset, and copy up to    */
+/*      nSize bytes from nOffset to the end of that chunk into          */
+/*      pBuffer. The copy is done under the mutex since another thread  */
+/*      may evict the chunk as soon as it is released. Returns FALSE if */
+/*      the chunk is not cached. With the default arguments, only      */
+/*      checks that the chunk is cached.                                */
+/************************************************************************/
+
+int VSICurlFilesystemHandler::GetRegion(const char* pszURL,
+                                        vsi_l_offset nOffset,
+                                        void* pBuffer, size_t nSize,
+                                        size_t* pnCopied)
 {
-    VSILFILE* fp = VSIFOpenL(VSICurlGetCacheFileName(), "r+b");
-    if (fp)
+    if (pnCopied)
+        *pnCopied = 0;
+
+    vsi_l_offset nFileOffsetStart =
+        (nOffset / DOWNLOAD_CHUNCK_SIZE) * DOWNLOAD_CHUNCK_SIZE;
+    size_t nOffsetInRegion = (size_t)(nOffset - nFileOffsetStart);
+
     {
-        unsigned long   pszURLHashCached;
-        vsi_l_offset    nFileOffsetStartCached;
-        size_t          nSizeCached;
-        while(TRUE)
+        CPLMutexHolder oHolder( &hMutex );
+
+        CachedRegion sKey;
+        sKey.nURLHash = CPLHashSetHashStr(pszURL);
+        sKey.pszURL = (char*) pszURL;
+        sKey.nFileOffsetStart = nFileOffsetStart;
+
+        CachedRegion* psRegion = (CachedRegion*) CPLHashSetLookup(hRegionSet, &sKey);
+        if (psRegion != NULL)
         {
-            if (VSIFReadL(&pszURLHashCached, 1, sizeof(unsigned long), fp) == 0)
-                break;
-            VSIFReadL(&nFileOffsetStartCached, 1, sizeof(vsi_l_offset), fp);
-            VSIFReadL(&nSizeCached, 1, sizeof(size_t), fp);
-            if (psRegion->pszURLHash == pszURLHashCached &&
-                psRegion->nFileOffsetStart == nFileOffsetStartCached)
+            if (psRegion != psRegionLRUHead)
             {
-                CPLAssert(psRegion->nSize == nSizeCached);
-                VSIFCloseL(fp);
-                return;
+                UnlinkRegion(psRegion);
+                LinkRegionAtHead(psRegion);
             }
-            else
+
+            if (nSize > 0 && nOffsetInRegion < psRegion->nSize)
             {
-                VSIFSeekL(fp, nSizeCached, SEEK_CUR);
+                size_t nToCopy = MIN(nSize, psRegion->nSize - nOffsetInRegion);
+                memcpy(pBuffer, psRegion->pData + nOffsetInRegion, nToCopy);
+                if (pnCopied)
+                    *pnCopied = nToCopy;
             }
-        }
-    }
-    else
-    {
-        fp = VSIFOpenL(VSICurlGetCacheFileName(), "wb");
-    }
-    if (fp)
-    {
-        if (ENABLE_DEBUG)
-             CPLDebug("VSICURL", "Write data at offset " CPL_FRMT_GUIB " to disk" , psRegion->nFileOffsetStart);
-        VSIFWriteL(&psRegion->pszURLHash, 1, sizeof(unsigned long), fp);
-        VSIFWriteL(&psRegion->nFileOffsetStart, 1, sizeof(vsi_l_offset), fp);
-        VSIFWriteL(&psRegion->nSize, 1, sizeof(size_t), fp);
-        if (psRegion->nSize)
-            VSIFWriteL(psRegion->pData, 1, psRegion->nSize, fp);
 
-        VSIFCloseL(fp);
+            return TRUE;
+        }
     }
-    return;
-}
 
+/* -------------------------------------------------------------------- */
+/*      Then in the disk cache, for chunks of the same version of the   */
+/*      remote file.                                                    */
+/* -------------------------------------------------------------------- */
+    if (poDiskCache == NULL)
+        return FALSE;
 
-/************************************************************************/
-/*                          GetRegion()                                 */
-/************************************************************************/
+    CPLString osValidator = GetValidator(pszURL);
+    if (osValidator.size() == 0)
+        return FALSE;
 
-const CachedRegion* VSICurlFilesystemHandler::GetRegion(const char* pszURL,
-                                                        vsi_l_offset nFileOffsetStart)
-{
-    CPLMutexHolder oHolder( &hMutex );
+    char* pData = NULL;
+    size_t nDataSize = 0;
+    if (!poDiskCache->Read(pszURL, osValidator, nFileOffsetStart,
+                           &pData, &nDataSize))
+        return FALSE;
 
-    unsigned long   pszURLHash = CPLHashSetHashStr(pszURL);
+    AddRegionToMemory(pszURL, nFileOffsetStart, nDataSize, pData);
 
-    nFileOffsetStart = (nFileOffsetStart / DOWNLOAD_CHUNCK_SIZE) * DOWNLOAD_CHUNCK_SIZE;
-    int i;
-    for(i=0;i<nRegions;i++)
+    if (nSize > 0 && nOffsetInRegion < nDataSize)
     {
-        CachedRegion* psRegion = papsRegions[i];
-        if (psRegion->pszURLHash == pszURLHash &&
-            nFileOffsetStart == psRegion->nFileOffsetStart)
-        {
-            memmove(papsRegions + 1, papsRegions, i * sizeof(CachedRegion*));
-            papsRegions[0] = psRegion;
-            return psRegion;
-        }
+        size_t nToCopy = MIN(nSize, nDataSize - nOffsetInRegion);
+        memcpy(pBuffer, pData + nOffsetInRegion, nToCopy);
+        if (pnCopied)
+            *pnCopied = nToCopy;
     }
-    if (bUseCacheDisk)
-        return GetRegionFromCacheDisk(pszURL, nFileOffsetStart);
-    return NULL;
+    CPLFree(pData);
+
+    return TRUE;
 }
 
 /************************************************************************/
@@ -1136,36 +2373,102 @@ void  VSICurlFilesystemHandler::AddRegion(const char* pszURL,
                                           size_t          nSize,
                                           const char     *pData)
 {
-    CPLMutexHolder oHolder( &hMutex );
-
-    unsigned long   pszURLHash = CPLHashSetHashStr(pszURL);
+    AddRegionToMemory(pszURL, nFileOffsetStart, nSize, pData);
 
-    CachedRegion* psRegion;
-    if (nRegions == N_MAX_REGIONS)
+    if (poDiskCache != NULL)
     {
-        psRegion = papsRegions[N_MAX_REGIONS-1];
-        memmove(papsRegions + 1, papsRegions, (N_MAX_REGIONS-1) * sizeof(CachedRegion*));
-        papsRegions[0] = psRegion;
-        CPLFree(psRegion->pData);
+        CPLString osValidator = GetValidator(pszURL);
+        if (osValidator.size() != 0)
+            poDiskCache->Write(pszURL, osValidator, nFileOffsetStart,
+                               pData, nSize);
     }
-    else
+}
+
+/************************************************************************/
+/*                        AddRegionToMemory()                           */
+/************************************************************************/
+
+void  VSICurlFilesystemHandler::AddRegionToMemory(const char* pszURL,
+                                                  vsi_l_offset    nFileOffsetStart,
+                                                  size_t          nSize,
+                                                  const char     *pData)
+{
+    CPLMutexHolder oHolder( &hMutex );
+
+    CachedRegion sKey;
+    sKey.nURLHash = CPLHashSetHashStr(pszURL);
+    sKey.pszURL = (char*) pszURL;
+    sKey.nFileOffsetStart = nFileOffsetStart;
+
+    /* Already fetched, for example by another thread */
+    CachedRegion* psRegion = (CachedRegion*) CPLHashSetLookup(hRegionSet, &sKey);
+    if (psRegion != NULL)
     {
-        papsRegions = (CachedRegion**) CPLRealloc(papsRegions, (nRegions + 1) * sizeof(CachedRegion*));
-        if (nRegions)
-            memmove(papsRegions + 1, papsRegions, nRegions * sizeof(CachedRegion*));
-        nRegions ++;
-        papsRegions[0] = psRegion = (CachedRegion*) CPLMalloc(sizeof(CachedRegion));
+        if (psRegion != psRegionLRUHead)
+        {
+            UnlinkRegion(psRegion);
+            LinkRegionAtHead(psRegion);
+        }
+        return;
     }
 
-    psRegion->pszURLHash = pszURLHash;
+    psRegion = (CachedRegion*) CPLMalloc(sizeof(CachedRegion));
+    psRegion->nURLHash = sKey.nURLHash;
+    psRegion->pszURL = CPLStrdup(pszURL);
     psRegion->nFileOffsetStart = nFileOffsetStart;
     psRegion->nSize = nSize;
     psRegion->pData = (nSize) ? (char*) CPLMalloc(nSize) : NULL;
     if (nSize)
         memcpy(psRegion->pData, pData, nSize);
 
-    if (bUseCacheDisk)
-        AddRegionToCacheDisk(psRegion);
+    CPLHashSetInsert(hRegionSet, psRegion);
+    LinkRegionAtHead(psRegion);
+    nRegionCacheSize += VSICurlRegionCost(psRegion);
+
+/* -------------------------------------------------------------------- */
+/*      Evict the least recently used regions to fit in the budget.     */
+/* -------------------------------------------------------------------- */
+    while (nRegionCacheSize > nRegionCacheMaxSize &&
+           psRegionLRUTail != psRegion)
+    {
+        CachedRegion* psVictim = psRegionLRUTail;
+        UnlinkRegion(psVictim);
+        CPLHashSetRemove(hRegionSet, psVictim);
+        nRegionCacheSize -= VSICurlRegionCost(psVictim);
+        CPLFree(psVictim->pszURL);
+        CPLFree(psVictim->pData);
+        CPLFree(psVictim);
+    }
+}
+
+/************************************************************************/
+/*                           GetValidator()                             */
+/*                                                                      */
+/*      String identifying the version of the remote file, used to      */
+/*      check that chunks of the disk cache are still up to date.      */
+/*      Empty until it has been retrieved from the server.              */
+/************************************************************************/
+
+CPLString VSICurlFilesystemHandler::GetValidator(const char* pszURL)
+{
+    CPLMutexHolder oHolder( &hMutex );
+
+    CachedFileProp* cachedFileProp = GetCachedFileProp(pszURL);
+    return (cachedFileProp->pszValidator) ? cachedFileProp->pszValidator : "";
+}
+
+/************************************************************************/
+/*                           SetValidator()                             */
+/************************************************************************/
+
+void VSICurlFilesystemHandler::SetValidator(const char* pszURL,
+                                            const char* pszValidator)
+{
+    CPLMutexHolder oHolder( &hMutex );
+
+    CachedFileProp* cachedFileProp = GetCachedFileProp(pszURL);
+    if (cachedFileProp->pszValidator == NULL)
+        cachedFileProp->pszValidator = CPLStrdup(pszValidator);
 }
 
 /************************************************************************/
@@ -1184,6 +2487,8 @@ CachedFileProp*  VSICurlFilesystemHandler::GetCachedFileProp(const char* pszURL)
         cachedFileProp->bHastComputedFileSize = FALSE;
         cachedFileProp->fileSize = 0;
         cachedFileProp->bIsDirectory = FALSE;
+        cachedFileProp->mTime = 0;
+        cachedFileProp->pszValidator = NULL;
         cacheFileSize[pszURL] = cachedFileProp;
     }
 
@@ -2107,6 +3412,14 @@ char** VSICurlFilesystemHandler::ReadDir( const char *pszDirname )
  * it will progressively increase the chunk size up to 2 MB to improve download
  * performance.
  *
+ * Setting the CPL_VSIL_CURL_USE_CACHE configuration option to YES keeps the
+ * downloaded chunks in a persistent disk cache, in the CPL_VSIL_CURL_CACHE_DIR
+ * directory (gdal_vsicurl_cache in the temporary directory by default), limited
+ * to CPL_VSIL_CURL_CACHE_DISK_SIZE bytes (1 GB by default). Cached chunks are
+ * only used while the ETag, Last-Modified date and size of the remote file are
+ * unchanged. The cache can be shared by several processes, the size limit
+ * applying to the whole cache.
+ *
  * The GDAL_HTTP_PROXY and GDAL_HTTP_PROXYUSERPWD configuration options can be
  * used to define a proxy server. The syntax to use is the one of Curl CURLOPT_PROXY
  * and CURLOPT_PROXYUSERPWD options.
@@ -70,6 +70,13 @@
    a .gz.properties file, so that we don't need to seek at the end of the file
    each time a Stat() is done.
 
+   When CPL_VSIL_GZIP_SEEK_INDEX=YES, the first full decompression of a .gz file
+   also writes a .gz.idx seek index, reused by later opens, even by other processes.
+   It holds access points at deflate block boundaries, every
+   CPL_VSIL_GZIP_SEEK_INDEX_SPACING uncompressed bytes (1 MB by default), with
+   the last 32 KB of uncompressed data needed to restart decompression from
+   there (same principle as examples/zran.c of zlib).
+
    For .zip and .gz, both reading and writing are supported, but just one mode at a time
    (read-only or write-only)
 */
@@ -83,6 +90,8 @@
 #include <zlib.h>
 #include "cpl_minizip_unzip.h"
 #include "cpl_time.h"
+#include "cpl_atomic_ops.h"
+#include <algorithm>
 
 CPL_CVSID("$Id$");
 
@@ -105,6 +114,18 @@ static int const gz_magic[2] = {0x1f, 0x8b}; /* gzip magic header */
 
 #define ENABLE_DEBUG 0
 
+/* Size of the deflate window, i.e. maximum distance of a back-reference */
+#define GZIP_WINDOW_SIZE        32768
+
+#define GZIP_INDEX_MAGIC        "GDALGZX1"
+#define GZIP_INDEX_ENTRY_SIZE   48
+#define GZIP_INDEX_TRAILER_SIZE 48
+
+/* Minimum amount of compressed data between two access points : they are */
+/* at least GZIP_WINDOW_SIZE uncompressed bytes apart, and deflate does   */
+/* not compress more than 1032:1 */
+#define GZIP_INDEX_MIN_SPAN     (GZIP_WINDOW_SIZE / 1032)
+
 /************************************************************************/
 /* ==================================================================== */
 /*                       VSIGZipHandle                                  */
@@ -121,6 +142,28 @@ typedef struct
     vsi_l_offset  out;
 } GZipSnapshot;
 
+typedef struct
+{
+    vsi_l_offset  nFilePos;      /* offset in the .gz of the first compressed byte to read */
+    int           nBits;         /* number of bits of the previous byte still to read */
+    uLong         crc;
+    vsi_l_offset  in;
+    vsi_l_offset  out;
+    vsi_l_offset  nWindowOffset; /* offset of the window in the index file */
+    int           nWindowSize;
+} GZipIndexPoint;
+
+/* Order access points by uncompressed offset */
+struct GZipIndexPointLess
+{
+    bool operator()(const GZipIndexPoint& a, const GZipIndexPoint& b) const
+        { return a.out < b.out; }
+    bool operator()(vsi_l_offset a, const GZipIndexPoint& b) const
+        { return a < b.out; }
+    bool operator()(const GZipIndexPoint& a, vsi_l_offset b) const
+        { return a.out < b; }
+};
+
 class VSIGZipHandle : public VSIVirtualHandle
 {
     VSIVirtualHandle* poBaseHandle;
@@ -147,6 +190,30 @@ class VSIGZipHandle : public VSIVirtualHandle
     GZipSnapshot* snapshots;
     vsi_l_offset snapshot_byte_interval; /* number of compressed bytes at which we create a "snapshot" */
 
+    /* Persistent seek index */
+    std::vector<GZipIndexPoint> aoIndexPoints;
+    int           bIndexLoaded;     /* aoIndexPoints cover the whole stream */
+    int           bIndexBuilding;
+    vsi_l_offset  nIndexSpacing;
+    vsi_l_offset  nIndexRunStart;   /* out when decompression last started from a snapshot */
+    vsi_l_offset  nIndexCovered;    /* out up to which access points have been searched */
+    GByte        *pabyIndexWindow;  /* last uncompressed bytes when building */
+    int           nIndexWindowFill;
+    int           bIndexWindowValid;
+    VSILFILE     *fpIndex;          /* temporary file when building, index file otherwise */
+    CPLString     osIndexTmpFilename;
+    vsi_l_offset  nIndexTmpSize;
+
+    CPLString     GetIndexFilename();
+    int           GetIndexFileTime(GIntBig* pnMTime);
+    void          LoadIndex();
+    void          UpdateIndex(const Bytef* pabyOut, const Bytef* pStart);
+    int           CreateIndexFile();
+    void          AddIndexPoint(const Bytef* pStart);
+    void          FinishIndex();
+    void          AbortIndex();
+    int           RestoreIndexPoint(const GZipIndexPoint* psPoint);
+
     void check_header();
     int get_byte();
     int gzseek( vsi_l_offset nOffset, int nWhence );
@@ -335,6 +402,32 @@ VSIGZipHandle::VSIGZipHandle(VSIVirtualHandle* poBaseHandle,
     {
         snapshots = NULL;
     }
+
+    bIndexLoaded = FALSE;
+    bIndexBuilding = FALSE;
+    nIndexSpacing = CPLScanUIntBig(
+        CPLGetConfigOption("CPL_VSIL_GZIP_SEEK_INDEX_SPACING", "1048576"), 20);
+    if (nIndexSpacing < GZIP_WINDOW_SIZE)
+        nIndexSpacing = GZIP_WINDOW_SIZE;
+    nIndexRunStart = 0;
+    nIndexCovered = 0;
+    pabyIndexWindow = NULL;
+    nIndexWindowFill = 0;
+    bIndexWindowValid = TRUE;
+    fpIndex = NULL;
+    nIndexTmpSize = 0;
+
+    /* Only for whole .gz files opened through /vsigzip/ */
+    if (this->transparent == 0 && this->pszBaseFileName != NULL && offset == 0 &&
+        CSLTestBoolean(CPLGetConfigOption("CPL_VSIL_GZIP_SEEK_INDEX", "NO")))
+    {
+        LoadIndex();
+        if (!bIndexLoaded)
+        {
+            bIndexBuilding = TRUE;
+            pabyIndexWindow = (GByte*) CPLMalloc(GZIP_WINDOW_SIZE);
+        }
+    }
 }
 
 /************************************************************************/
@@ -343,7 +436,12 @@ VSIGZipHandle::VSIGZipHandle(VSIVirtualHandle* poBaseHandle,
 
 VSIGZipHandle::~VSIGZipHandle()
 {
-    
+    if (bIndexBuilding)
+        AbortIndex();
+    if (fpIndex != NULL)
+        VSIFCloseL(fpIndex);
+    CPLFree(pabyIndexWindow);
+
     if (pszBaseFileName)
     {
         VSIFilesystemHandler *poFSHandler = 
@@ -497,6 +595,9 @@ int VSIGZipHandle::gzrewind ()
     if (!transparent) (void)inflateReset(&stream);
     in = 0;
     out = 0;
+    nIndexRunStart = 0;
+    nIndexWindowFill = 0;
+    bIndexWindowValid = TRUE;
     return VSIFSeekL((VSILFILE*)poBaseHandle, startOff, SEEK_SET);
 }
 
@@ -626,6 +727,21 @@ int VSIGZipHandle::gzseek( vsi_l_offset offset, int whence )
             return -1L;
     }
     
+    /* The persistent seek index may get us closer to the target than */
+    /* the snapshots */
+    const vsi_l_offset nTarget = out + offset;
+    const GZipIndexPoint* psIndexPoint = NULL;
+    if (bIndexLoaded && offset > 0)
+    {
+        std::vector<GZipIndexPoint>::const_iterator oIter =
+            std::upper_bound(aoIndexPoints.begin(), aoIndexPoints.end(),
+                             nTarget, GZipIndexPointLess());
+        /* Not worth it for a short skip */
+        if (oIter != aoIndexPoints.begin() &&
+            (oIter - 1)->out > out + GZIP_WINDOW_SIZE)
+            psIndexPoint = &(*(oIter - 1));
+    }
+
     unsigned int i;
     for(i=0;i<compressed_size / snapshot_byte_interval + 1;i++)
     {
@@ -636,6 +752,8 @@ int VSIGZipHandle::gzseek( vsi_l_offset offset, int whence )
         {
             if (out >= snapshots[i].out)
                 break;
+            if (psIndexPoint != NULL && psIndexPoint->out >= snapshots[i].out)
+                break;
 
             if (ENABLE_DEBUG)
                 CPLDebug("SNAPSHOT", "using snapshot %d : uncompressed_pos(snapshot)=" CPL_FRMT_GUIB
@@ -652,10 +770,19 @@ int VSIGZipHandle::gzseek( vsi_l_offset offset, int whence )
             transparent = snapshots[i].transparent;
             in = snapshots[i].in;
             out = snapshots[i].out;
+
+            /* The window preceding the snapshot is unknown */
+            nIndexRunStart = out;
+            nIndexWindowFill = 0;
+            bIndexWindowValid = FALSE;
             break;
         }
     }
 
+    if (psIndexPoint != NULL && psIndexPoint->out > out &&
+        RestoreIndexPoint(psIndexPoint))
+        offset = nTarget - out;
+
     /* offset is now the number of bytes to skip. */
 
     if (offset != 0 && outbuf == Z_NULL) {
@@ -846,11 +973,17 @@ size_t VSIGZipHandle::Read( void *buf, size_t nSize, size_t nMemb )
             }
             stream.next_in = inbuf;
         }
+        Bytef* pabyOutBefore = stream.next_out;
         in += stream.avail_in;
         out += stream.avail_out;
-        z_err = inflate(& (stream), Z_NO_FLUSH);
+        /* When building the seek index, stop at the end of each deflate */
+        /* block to check if an access point is due */
+        z_err = inflate(& (stream), (bIndexBuilding) ? Z_BLOCK : Z_NO_FLUSH);
         in -= stream.avail_in;
         out -= stream.avail_out;
+
+        if (bIndexBuilding)
+            UpdateIndex(pabyOutBefore, pStart);
         
         if  (z_err == Z_STREAM_END) {
             /* Check CRC and original size */
@@ -884,6 +1017,8 @@ size_t VSIGZipHandle::Read( void *buf, size_t nSize, size_t nMemb )
                     if  (z_err == Z_OK) {
                         inflateReset(& (stream));
                         crc = crc32(0L, Z_NULL, 0);
+                        nIndexWindowFill = 0;
+                        bIndexWindowValid = TRUE;
                     }
                 }
             }
@@ -892,6 +1027,9 @@ size_t VSIGZipHandle::Read( void *buf, size_t nSize, size_t nMemb )
     }
     crc = crc32 (crc, pStart, (uInt) (stream.next_out - pStart));
 
+    if (bIndexBuilding && z_err == Z_STREAM_END)
+        FinishIndex();
+
     if (len == stream.avail_out &&
             (z_err == Z_DATA_ERROR || z_err == Z_ERRNO))
     {
@@ -904,6 +1042,443 @@ size_t VSIGZipHandle::Read( void *buf, size_t nSize, size_t nMemb )
     return (int)(len - stream.avail_out) / nSize;
 }
 
+/************************************************************************/
+/*                     VSIGZipPutUInt64() / GetUInt64()                 */
+/************************************************************************/
+
+static void VSIGZipPutUInt64(GByte* pabyDst, GUIntBig nVal)
+{
+    CPL_LSBPTR64(&nVal);
+    memcpy(pabyDst, &nVal, 8);
+}
+
+static void VSIGZipPutUInt32(GByte* pabyDst, GUInt32 nVal)
+{
+    CPL_LSBPTR32(&nVal);
+    memcpy(pabyDst, &nVal, 4);
+}
+
+static GUIntBig VSIGZipGetUInt64(const GByte* pabySrc)
+{
+    GUIntBig nVal;
+    memcpy(&nVal, pabySrc, 8);
+    CPL_LSBPTR64(&nVal);
+    return nVal;
+}
+
+static GUInt32 VSIGZipGetUInt32(const GByte* pabySrc)
+{
+    GUInt32 nVal;
+    memcpy(&nVal, pabySrc, 4);
+    CPL_LSBPTR32(&nVal);
+    return nVal;
+}
+
+/************************************************************************/
+/*                          GetIndexFilename()                          */
+/************************************************************************/
+
+CPLString VSIGZipHandle::GetIndexFilename()
+{
+    CPLString osIndexFilename(pszBaseFileName);
+    osIndexFilename += ".idx";
+    return osIndexFilename;
+}
+
+/************************************************************************/
+/*                          GetIndexFileTime()                          */
+/*                                                                      */
+/*      Modification time of the .gz file, recorded in the index to     */
+/*      detect that it has been replaced.                               */
+/************************************************************************/
+
+int VSIGZipHandle::GetIndexFileTime(GIntBig* pnMTime)
+{
+    VSIStatBufL sStat;
+    if (VSIStatL(pszBaseFileName, &sStat) != 0)
+        return FALSE;
+    *pnMTime = (GIntBig) sStat.st_mtime;
+    return TRUE;
+}
+
+/************************************************************************/
+/*                             LoadIndex()                              */
+/*                                                                      */
+/*      The index file holds the windows of the access points, then     */
+/*      a table of GZIP_INDEX_ENTRY_SIZE bytes per access point, and    */
+/*      a trailer of GZIP_INDEX_TRAILER_SIZE bytes with the size and    */
+/*      modification time of the .gz file and the CRC of the table.     */
+/*      All integers are LSB.                                           */
+/************************************************************************/
+
+void VSIGZipHandle::LoadIndex()
+{
+    GIntBig nMTime;
+    if (!GetIndexFileTime(&nMTime))
+        return;
+
+    CPLString osIndexFilename = GetIndexFilename();
+    VSILFILE* fp = VSIFOpenL(osIndexFilename, "rb");
+    if (fp == NULL)
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Read and check the trailer.                                     */
+/* -------------------------------------------------------------------- */
+    GByte abyTrailer[GZIP_INDEX_TRAILER_SIZE];
+    VSIFSeekL(fp, 0, SEEK_END);
+    vsi_l_offset nIndexSize = VSIFTellL(fp);
+    if (nIndexSize < GZIP_INDEX_TRAILER_SIZE ||
+        VSIFSeekL(fp, nIndexSize - GZIP_INDEX_TRAILER_SIZE, SEEK_SET) != 0 ||
+        VSIFReadL(abyTrailer, 1, GZIP_INDEX_TRAILER_SIZE, fp) != GZIP_INDEX_TRAILER_SIZE ||
+        memcmp(abyTrailer, GZIP_INDEX_MAGIC, 8) != 0)
+    {
+        CPLDebug("GZIP", "%s is not a valid seek index", osIndexFilename.c_str());
+        VSIFCloseL(fp);
+        return;
+    }
+
+    GUIntBig nIndexCompressedSize = VSIGZipGetUInt64(abyTrailer + 8);
+    GIntBig nIndexMTime = (GIntBig) VSIGZipGetUInt64(abyTrailer + 16);
+    GUIntBig nIndexUncompressedSize = VSIGZipGetUInt64(abyTrailer + 24);
+    GUIntBig nTableOffset = VSIGZipGetUInt64(abyTrailer + 32);
+    GUInt32 nPoints = VSIGZipGetUInt32(abyTrailer + 40);
+    GUInt32 nTableCRC = VSIGZipGetUInt32(abyTrailer + 44);
+
+    GUIntBig nTableSize = (GUIntBig)nPoints * GZIP_INDEX_ENTRY_SIZE;
+
+    if (nIndexCompressedSize != compressed_size || nIndexMTime != nMTime ||
+        nTableOffset + nTableSize + GZIP_INDEX_TRAILER_SIZE != nIndexSize)
+    {
+        CPLDebug("GZIP", "%s is out of date", osIndexFilename.c_str());
+        VSIFCloseL(fp);
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Read the access points, after checking that there cannot be     */
+/*      more of them than the size of the .gz file allows, and that     */
+/*      the table fits in memory and in a single crc32() call.          */
+/* -------------------------------------------------------------------- */
+    if (nTableOffset > nIndexSize ||
+        (GUIntBig)nPoints > compressed_size / GZIP_INDEX_MIN_SPAN + 1 ||
+        (GUIntBig)(uInt)nTableSize != nTableSize ||
+        (GUIntBig)(size_t)nTableSize != nTableSize)
+    {
+        CPLDebug("GZIP", "%s is corrupted", osIndexFilename.c_str());
+        VSIFCloseL(fp);
+        return;
+    }
+
+    GByte* pabyTable = (GByte*) VSIMalloc((size_t)nTableSize + 1);
+    if (pabyTable == NULL ||
+        VSIFSeekL(fp, nTableOffset, SEEK_SET) != 0 ||
+        VSIFReadL(pabyTable, GZIP_INDEX_ENTRY_SIZE, nPoints, fp) != nPoints ||
+        crc32(0L, pabyTable, (uInt)nTableSize) != nTableCRC)
+    {
+        CPLDebug("GZIP", "%s is corrupted", osIndexFilename.c_str());
+        CPLFree(pabyTable);
+        VSIFCloseL(fp);
+        return;
+    }
+
+    aoIndexPoints.resize(nPoints);
+    for(GUInt32 i = 0; i < nPoints; i++)
+    {
+        const GByte* pabyEntry = pabyTable + (size_t)i * GZIP_INDEX_ENTRY_SIZE;
+        GZipIndexPoint& sPoint = aoIndexPoints[i];
+
+        sPoint.nFilePos = VSIGZipGetUInt64(pabyEntry);
+        sPoint.in = VSIGZipGetUInt64(pabyEntry + 8);
+        sPoint.out = VSIGZipGetUInt64(pabyEntry + 16);
+        sPoint.nWindowOffset = VSIGZipGetUInt64(pabyEntry + 24);
+        sPoint.crc = VSIGZipGetUInt32(pabyEntry + 32);
+        sPoint.nWindowSize = (int) VSIGZipGetUInt32(pabyEntry + 36);
+        sPoint.nBits = (int) VSIGZipGetUInt32(pabyEntry + 40);
+
+        if (sPoint.nWindowSize < 0 || sPoint.nWindowSize > GZIP_WINDOW_SIZE ||
+            sPoint.nBits < 0 || sPoint.nBits > 7 ||
+            (sPoint.nBits > 0 && sPoint.nFilePos == 0) ||
+            sPoint.nWindowOffset + sPoint.nWindowSize > nTableOffset ||
+            (i > 0 && sPoint.out <= aoIndexPoints[i-1].out))
+        {
+            CPLDebug("GZIP", "%s is corrupted", osIndexFilename.c_str());
+            aoIndexPoints.resize(0);
+            CPLFree(pabyTable);
+            VSIFCloseL(fp);
+            return;
+        }
+    }
+    CPLFree(pabyTable);
+
+    if (uncompressed_size == 0)
+        uncompressed_size = nIndexUncompressedSize;
+
+    fpIndex = fp;
+    bIndexLoaded = TRUE;
+}
+
+/************************************************************************/
+/*                            UpdateIndex()                             */
+/*                                                                      */
+/*      Called after each inflate() call when building the seek index, */
+/*      with the uncompressed data it produced.                         */
+/************************************************************************/
+
+void VSIGZipHandle::UpdateIndex(const Bytef* pabyOut, const Bytef* pStart)
+{
+    int nOutSize = (int) (stream.next_out - pabyOut);
+
+/* -------------------------------------------------------------------- */
+/*      Keep the last GZIP_WINDOW_SIZE uncompressed bytes.              */
+/* -------------------------------------------------------------------- */
+    if (nOutSize >= GZIP_WINDOW_SIZE)
+    {
+        memcpy(pabyIndexWindow, pabyOut + nOutSize - GZIP_WINDOW_SIZE,
+               GZIP_WINDOW_SIZE);
+        nIndexWindowFill = GZIP_WINDOW_SIZE;
+    }
+    else if (nOutSize > 0)
+    {
+        int nKeep = MIN(nIndexWindowFill, GZIP_WINDOW_SIZE - nOutSize);
+        memmove(pabyIndexWindow, pabyIndexWindow + nIndexWindowFill - nKeep, nKeep);
+        memcpy(pabyIndexWindow + nKeep, pabyOut, nOutSize);
+        nIndexWindowFill = nKeep + nOutSize;
+    }
+    if (nIndexWindowFill == GZIP_WINDOW_SIZE)
+        bIndexWindowValid = TRUE;
+
+    /* Extend the part of the stream searched for access points if we */
+    /* started from within it */
+    if (nIndexRunStart <= nIndexCovered && out > nIndexCovered)
+        nIndexCovered = out;
+
+/* -------------------------------------------------------------------- */
+/*      At the end of a deflate block which is not the last one, add    */
+/*      an access point if the previous one is far enough.              */
+/* -------------------------------------------------------------------- */
+    if (z_err != Z_OK || (stream.data_type & 128) == 0 ||
+        (stream.data_type & 64) != 0 || !bIndexWindowValid || out == 0)
+        return;
+
+    std::vector<GZipIndexPoint>::const_iterator oIter =
+        std::upper_bound(aoIndexPoints.begin(), aoIndexPoints.end(),
+                         out, GZipIndexPointLess());
+    vsi_l_offset nPreviousOut = 0;
+    if (oIter != aoIndexPoints.begin())
+    {
+        --oIter;
+        nPreviousOut = oIter->out;
+    }
+    if (out >= nPreviousOut + nIndexSpacing)
+        AddIndexPoint(pStart);
+}
+
+/************************************************************************/
+/*                          CreateIndexFile()                           */
+/*                                                                      */
+/*      The index is written under a temporary name, and renamed once   */
+/*      complete.                                                       */
+/************************************************************************/
+
+int VSIGZipHandle::CreateIndexFile()
+{
+    static volatile int nTempCounter = 0;
+
+    osIndexTmpFilename.Printf("%s.%d_%d.tmp", GetIndexFilename().c_str(),
+                              (int)CPLGetPID(), CPLAtomicInc(&nTempCounter));
+    fpIndex = VSIFOpenL(osIndexTmpFilename, "wb");
+    if (fpIndex == NULL)
+    {
+        CPLDebug("GZIP", "Cannot create %s", osIndexTmpFilename.c_str());
+        AbortIndex();
+        return FALSE;
+    }
+    nIndexTmpSize = 0;
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                           AddIndexPoint()                            */
+/************************************************************************/
+
+void VSIGZipHandle::AddIndexPoint(const Bytef* pStart)
+{
+    if (fpIndex == NULL && !CreateIndexFile())
+        return;
+
+    GZipIndexPoint sPoint;
+    sPoint.nFilePos = VSIFTellL((VSILFILE*)poBaseHandle) - stream.avail_in;
+    sPoint.nBits = stream.data_type & 7;
+    sPoint.crc = crc32 (crc, pStart, (uInt) (stream.next_out - pStart));
+    sPoint.in = in;
+    sPoint.out = out;
+    sPoint.nWindowOffset = nIndexTmpSize;
+    sPoint.nWindowSize = nIndexWindowFill;
+
+    if ((int)VSIFWriteL(pabyIndexWindow, 1, nIndexWindowFill, fpIndex) != nIndexWindowFill)
+    {
+        AbortIndex();
+        return;
+    }
+    nIndexTmpSize += nIndexWindowFill;
+
+    aoIndexPoints.insert(
+        std::upper_bound(aoIndexPoints.begin(), aoIndexPoints.end(),
+                         sPoint, GZipIndexPointLess()), sPoint);
+}
+
+/************************************************************************/
+/*                            FinishIndex()                             */
+/*                                                                      */
+/*      Called at the end of the stream. If all of it has been          */
+/*      searched for access points, write the table and install the     */
+/*      index file.                                                     */
+/************************************************************************/
+
+void VSIGZipHandle::FinishIndex()
+{
+    if (nIndexRunStart > nIndexCovered)
+        return;
+
+    GIntBig nMTime;
+    if (!GetIndexFileTime(&nMTime))
+    {
+        AbortIndex();
+        return;
+    }
+
+    /* Small file without access points */
+    if (fpIndex == NULL && !CreateIndexFile())
+        return;
+
+    int bOK = TRUE;
+    uLong nTableCRC = crc32(0L, Z_NULL, 0);
+    for(size_t i = 0; i < aoIndexPoints.size() && bOK; i++)
+    {
+        const GZipIndexPoint& sPoint = aoIndexPoints[i];
+        GByte abyEntry[GZIP_INDEX_ENTRY_SIZE];
+
+        memset(abyEntry, 0, GZIP_INDEX_ENTRY_SIZE);
+        VSIGZipPutUInt64(abyEntry, sPoint.nFilePos);
+        VSIGZipPutUInt64(abyEntry + 8, sPoint.in);
+        VSIGZipPutUInt64(abyEntry + 16, sPoint.out);
+        VSIGZipPutUInt64(abyEntry + 24, sPoint.nWindowOffset);
+        VSIGZipPutUInt32(abyEntry + 32, (GUInt32) sPoint.crc);
+        VSIGZipPutUInt32(abyEntry + 36, (GUInt32) sPoint.nWindowSize);
+        VSIGZipPutUInt32(abyEntry + 40, (GUInt32) sPoint.nBits);
+        bOK = VSIFWriteL(abyEntry, 1, GZIP_INDEX_ENTRY_SIZE, fpIndex) == GZIP_INDEX_ENTRY_SIZE;
+        nTableCRC = crc32(nTableCRC, abyEntry, GZIP_INDEX_ENTRY_SIZE);
+    }
+
+    GByte abyTrailer[GZIP_INDEX_TRAILER_SIZE];
+    memset(abyTrailer, 0, GZIP_INDEX_TRAILER_SIZE);
+    memcpy(abyTrailer, GZIP_INDEX_MAGIC, 8);
+    VSIGZipPutUInt64(abyTrailer + 8, compressed_size);
+    VSIGZipPutUInt64(abyTrailer + 16, (GUIntBig) nMTime);
+    VSIGZipPutUInt64(abyTrailer + 24, out);
+    VSIGZipPutUInt64(abyTrailer + 32, nIndexTmpSize);
+    VSIGZipPutUInt32(abyTrailer + 40, (GUInt32) aoIndexPoints.size());
+    VSIGZipPutUInt32(abyTrailer + 44, (GUInt32) nTableCRC);
+    if (bOK)
+        bOK = VSIFWriteL(abyTrailer, 1, GZIP_INDEX_TRAILER_SIZE, fpIndex) == GZIP_INDEX_TRAILER_SIZE;
+
+    if (VSIFCloseL(fpIndex) != 0)
+        bOK = FALSE;
+    fpIndex = NULL;
+
+    /* The rename is atomic, so that other processes never see a */
+    /* partially written index */
+    if (!bOK || VSIRename(osIndexTmpFilename, GetIndexFilename()) != 0)
+    {
+        CPLDebug("GZIP", "Cannot write %s", GetIndexFilename().c_str());
+        VSIUnlink(osIndexTmpFilename);
+        aoIndexPoints.resize(0);
+    }
+    else
+    {
+        bIndexLoaded = TRUE;
+        if (uncompressed_size == 0)
+            uncompressed_size = out;
+    }
+
+    bIndexBuilding = FALSE;
+    CPLFree(pabyIndexWindow);
+    pabyIndexWindow = NULL;
+}
+
+/************************************************************************/
+/*                             AbortIndex()                             */
+/************************************************************************/
+
+void VSIGZipHandle::AbortIndex()
+{
+    if (fpIndex != NULL)
+    {
+        VSIFCloseL(fpIndex);
+        fpIndex = NULL;
+        VSIUnlink(osIndexTmpFilename);
+    }
+    aoIndexPoints.resize(0);
+    bIndexBuilding = FALSE;
+}
+
+/************************************************************************/
+/*                         RestoreIndexPoint()                          */
+/*                                                                      */
+/*      Restart decompression from an access point of the seek index.   */
+/************************************************************************/
+
+int VSIGZipHandle::RestoreIndexPoint(const GZipIndexPoint* psPoint)
+{
+    if (fpIndex == NULL)
+    {
+        fpIndex = VSIFOpenL(GetIndexFilename(), "rb");
+        if (fpIndex == NULL)
+            return FALSE;
+    }
+
+    if (pabyIndexWindow == NULL)
+        pabyIndexWindow = (GByte*) CPLMalloc(GZIP_WINDOW_SIZE);
+
+    if (VSIFSeekL(fpIndex, psPoint->nWindowOffset, SEEK_SET) != 0 ||
+        (int)VSIFReadL(pabyIndexWindow, 1, psPoint->nWindowSize, fpIndex) != psPoint->nWindowSize)
+        return FALSE;
+
+    /* The first bits to decompress may be in the previous byte */
+    vsi_l_offset nSavedPos = VSIFTellL((VSILFILE*)poBaseHandle);
+    GByte byBits = 0;
+    if ((psPoint->nBits > 0 &&
+         (VSIFSeekL((VSILFILE*)poBaseHandle, psPoint->nFilePos - 1, SEEK_SET) != 0 ||
+          VSIFReadL(&byBits, 1, 1, (VSILFILE*)poBaseHandle) != 1)) ||
+        (psPoint->nBits == 0 &&
+         VSIFSeekL((VSILFILE*)poBaseHandle, psPoint->nFilePos, SEEK_SET) != 0))
+    {
+        VSIFSeekL((VSILFILE*)poBaseHandle, nSavedPos, SEEK_SET);
+        return FALSE;
+    }
+
+    if (ENABLE_DEBUG)
+        CPLDebug("GZIP", "using index point : in=" CPL_FRMT_GUIB " out=" CPL_FRMT_GUIB,
+                 psPoint->in, psPoint->out);
+
+    inflateReset(&stream);
+    if (psPoint->nBits > 0)
+        inflatePrime(&stream, psPoint->nBits, byBits >> (8 - psPoint->nBits));
+    inflateSetDictionary(&stream, pabyIndexWindow, psPoint->nWindowSize);
+
+    stream.avail_in = 0;
+    stream.next_in = inbuf;
+    z_err = Z_OK;
+    z_eof = 0;
+    crc = psPoint->crc;
+    in = psPoint->in;
+    out = psPoint->out;
+
+    return TRUE;
+}
+
 /************************************************************************/
 /*                              getLong()                               */
 /************************************************************************/
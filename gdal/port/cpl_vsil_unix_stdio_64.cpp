@@ -136,6 +136,7 @@ class VSIUnixStdioHandle : public VSIVirtualHandle
     virtual int       Flush();
     virtual int       Close();
     virtual int       Truncate( vsi_l_offset nNewSize );
+    virtual void     *GetNativeFileDescriptor();
 };
 
 /************************************************************************/
@@ -355,6 +356,15 @@ int VSIUnixStdioHandle::Truncate( vsi_l_offset nNewSize )
     return nRet;
 }
 
+/************************************************************************/
+/*                      GetNativeFileDescriptor()                       */
+/************************************************************************/
+
+void *VSIUnixStdioHandle::GetNativeFileDescriptor()
+{
+    return (void *) (size_t) fileno(fp);
+}
+
 
 /************************************************************************/
 /* ==================================================================== */
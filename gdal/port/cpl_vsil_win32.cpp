@@ -92,6 +92,7 @@ class VSIWin32Handle : public VSIVirtualHandle
     virtual int       Flush();
     virtual int       Close();
     virtual int       Truncate( vsi_l_offset nNewSize );
+    virtual void     *GetNativeFileDescriptor() { return (void*) hFile; }
 };
 
 /************************************************************************/
@@ -0,0 +1,236 @@
+/**********************************************************************
+ * $Id$
+ *
+ * Project:  CPL - Common Portability Library
+ * Purpose:  CPL worker thread pool
+ **********************************************************************
+ * Copyright (c) 2012, GDAL project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "cpl_worker_thread_pool.h"
+#include "cpl_conv.h"
+
+CPL_CVSID("$Id$");
+
+/************************************************************************/
+/*                         CPLWorkerThreadPool()                        */
+/************************************************************************/
+
+/** Instantiate a new pool of worker threads.
+ *
+ * The pool is in an uninitialized state after this call. The Setup() method
+ * must be called.
+ */
+CPLWorkerThreadPool::CPLWorkerThreadPool()
+
+{
+    pasWorkerThreads = NULL;
+    nThreads = 0;
+    psJobQueue = NULL;
+    psJobQueueTail = NULL;
+    nPendingJobs = 0;
+    bStop = FALSE;
+    hMutex = NULL;
+    hCond = NULL;
+    hCondDone = NULL;
+}
+
+/************************************************************************/
+/*                          ~CPLWorkerThreadPool()                      */
+/************************************************************************/
+
+/** Destroys a pool of worker threads.
+ *
+ * Any still pending job will be completed before the destructor returns.
+ */
+CPLWorkerThreadPool::~CPLWorkerThreadPool()
+
+{
+    int i;
+
+    if( hMutex != NULL )
+    {
+        WaitCompletion();
+
+        CPLAcquireMutex( hMutex, 1000.0 );
+        bStop = TRUE;
+        CPLCondBroadcast( hCond );
+        CPLReleaseMutex( hMutex );
+    }
+
+    for( i = 0; i < nThreads; i++ )
+        CPLJoinThread( pasWorkerThreads[i].hThread );
+
+    CPLFree( pasWorkerThreads );
+
+    if( hCond != NULL )
+        CPLDestroyCond( hCond );
+    if( hCondDone != NULL )
+        CPLDestroyCond( hCondDone );
+    if( hMutex != NULL )
+        CPLDestroyMutex( hMutex );
+}
+
+/************************************************************************/
+/*                       WorkerThreadFunction()                         */
+/************************************************************************/
+
+void CPLWorkerThreadPool::WorkerThreadFunction( void* user_data )
+
+{
+    CPLWorkerThreadPool *poTP = ((CPLWorkerThread *) user_data)->poTP;
+
+    CPLAcquireMutex( poTP->hMutex, 1000.0 );
+    while( TRUE )
+    {
+        while( poTP->psJobQueue == NULL && !poTP->bStop )
+            CPLCondWait( poTP->hCond, poTP->hMutex );
+
+        if( poTP->psJobQueue == NULL )
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Pop the oldest job and run it without holding the mutex.        */
+/* -------------------------------------------------------------------- */
+        CPLList *psNode = poTP->psJobQueue;
+        CPLWorkerThreadJob *psJob = (CPLWorkerThreadJob *) psNode->pData;
+
+        poTP->psJobQueue = psNode->psNext;
+        if( poTP->psJobQueue == NULL )
+            poTP->psJobQueueTail = NULL;
+        CPLFree( psNode );
+
+        CPLReleaseMutex( poTP->hMutex );
+
+        psJob->pfnFunc( psJob->pData );
+        CPLFree( psJob );
+
+        CPLAcquireMutex( poTP->hMutex, 1000.0 );
+        poTP->nPendingJobs --;
+        if( poTP->nPendingJobs == 0 )
+            CPLCondBroadcast( poTP->hCondDone );
+    }
+    CPLReleaseMutex( poTP->hMutex );
+}
+
+/************************************************************************/
+/*                               Setup()                                */
+/************************************************************************/
+
+/** Setup the pool.
+ *
+ * @param nThreadsIn Number of threads to launch (> 0)
+ * @return TRUE if successful, FALSE otherwise, for example when the
+ * threading model in use does not support threads, in which case the
+ * caller is expected to do the work itself.
+ */
+int CPLWorkerThreadPool::Setup( int nThreadsIn )
+
+{
+    int i;
+
+    CPLAssert( nThreadsIn > 0 );
+    CPLAssert( hMutex == NULL );
+
+    hMutex = CPLCreateMutex();
+    if( hMutex == NULL )
+        return FALSE;
+    CPLReleaseMutex( hMutex );
+
+    hCond = CPLCreateCond();
+    hCondDone = CPLCreateCond();
+    if( hCond == NULL || hCondDone == NULL )
+        return FALSE;
+
+    pasWorkerThreads = (CPLWorkerThread *)
+        CPLCalloc( sizeof(CPLWorkerThread), nThreadsIn );
+
+    for( i = 0; i < nThreadsIn; i++ )
+    {
+        pasWorkerThreads[i].poTP = this;
+        pasWorkerThreads[i].hThread =
+            CPLCreateJoinableThread( WorkerThreadFunction,
+                                     &(pasWorkerThreads[i]) );
+        if( pasWorkerThreads[i].hThread == NULL )
+            break;
+        nThreads ++;
+    }
+
+    return nThreads == nThreadsIn;
+}
+
+/************************************************************************/
+/*                             SubmitJob()                              */
+/************************************************************************/
+
+/** Queue a new job.
+ *
+ * @param pfnFunc Function to run for the job.
+ * @param pData User data to pass to the job function.
+ * @return TRUE in case of success.
+ */
+int CPLWorkerThreadPool::SubmitJob( CPLThreadFunc pfnFunc, void* pData )
+
+{
+    if( nThreads == 0 )
+        return FALSE;
+
+    CPLWorkerThreadJob *psJob = (CPLWorkerThreadJob *)
+        CPLMalloc( sizeof(CPLWorkerThreadJob) );
+    psJob->pfnFunc = pfnFunc;
+    psJob->pData = pData;
+
+    CPLList *psNode = (CPLList *) CPLMalloc( sizeof(CPLList) );
+    psNode->pData = psJob;
+    psNode->psNext = NULL;
+
+    CPLAcquireMutex( hMutex, 1000.0 );
+
+    if( psJobQueueTail == NULL )
+        psJobQueue = psNode;
+    else
+        psJobQueueTail->psNext = psNode;
+    psJobQueueTail = psNode;
+    nPendingJobs ++;
+
+    CPLCondSignal( hCond );
+    CPLReleaseMutex( hMutex );
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                            WaitCompletion()                          */
+/************************************************************************/
+
+/** Wait for completion of all the jobs submitted so far.
+ */
+void CPLWorkerThreadPool::WaitCompletion()
+
+{
+    if( hMutex == NULL )
+        return;
+
+    CPLAcquireMutex( hMutex, 1000.0 );
+    while( nPendingJobs > 0 )
+        CPLCondWait( hCondDone, hMutex );
+    CPLReleaseMutex( hMutex );
+}
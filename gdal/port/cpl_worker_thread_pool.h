@@ -0,0 +1,82 @@
+/**********************************************************************
+ * $Id$
+ *
+ * Project:  CPL - Common Portability Library
+ * Purpose:  CPL worker thread pool
+ **********************************************************************
+ * Copyright (c) 2012, GDAL project contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#ifndef _CPL_WORKER_THREAD_POOL_H_INCLUDED_
+#define _CPL_WORKER_THREAD_POOL_H_INCLUDED_
+
+#include "cpl_multiproc.h"
+#include "cpl_list.h"
+
+/**
+ * \file cpl_worker_thread_pool.h
+ *
+ * Class to manage a pool of worker threads.
+ * @since GDAL 1.9.0
+ */
+
+class CPLWorkerThreadPool;
+
+typedef struct
+{
+    CPLThreadFunc        pfnFunc;
+    void                *pData;
+} CPLWorkerThreadJob;
+
+typedef struct
+{
+    CPLWorkerThreadPool *poTP;
+    void                *hThread;
+} CPLWorkerThread;
+
+class CPL_DLL CPLWorkerThreadPool
+{
+        CPLWorkerThread *pasWorkerThreads;
+        int              nThreads;
+
+        CPLList         *psJobQueue;
+        CPLList         *psJobQueueTail;
+        int              nPendingJobs;
+        int              bStop;
+
+        void            *hMutex;
+        void            *hCond;
+        void            *hCondDone;
+
+        static void      WorkerThreadFunction(void* user_data);
+
+    public:
+                         CPLWorkerThreadPool();
+                        ~CPLWorkerThreadPool();
+
+        int              Setup( int nThreads );
+        int              SubmitJob( CPLThreadFunc pfnFunc, void* pData );
+        void             WaitCompletion();
+
+        int              GetThreadCount() const { return nThreads; }
+};
+
+#endif /* _CPL_WORKER_THREAD_POOL_H_INCLUDED_ */